@@ -0,0 +1,438 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_BENCH_HARNESS_HPP
+#define CAPRICORN_BENCH_HARNESS_HPP
+
+#include "capricorn/base/types.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace cc::bench
+{
+	using clock = std::chrono::steady_clock;
+
+	struct sample_summary
+	{
+		std::string name;
+		std::string unit;
+		u64 count = 0;
+		f64 min   = 0.0;
+		f64 mean  = 0.0;
+		f64 p50   = 0.0;
+		f64 p90   = 0.0;
+		f64 p99   = 0.0;
+		f64 max   = 0.0;
+	};
+
+	// Percentile with linear interpolation between the two nearest ranks.
+	inline f64 percentile(const std::vector<f64>& sorted, f64 fraction)
+	{
+		if (sorted.empty())
+		{
+			return 0.0;
+		}
+
+		const f64 rank          = fraction * static_cast<f64>(sorted.size() - 1);
+		const auto lower        = static_cast<std::size_t>(std::floor(rank));
+		const std::size_t upper = std::min(lower + 1, sorted.size() - 1);
+
+		return sorted[lower] + (sorted[upper] - sorted[lower]) * (rank - static_cast<f64>(lower));
+	}
+
+	class sample_set
+	{
+	public:
+		explicit sample_set(std::string name, std::string unit = "ms")
+		    : m_name(std::move(name)),
+		      m_unit(std::move(unit))
+		{
+		}
+
+		void add(f64 value)
+		{
+			m_samples.push_back(value);
+		}
+
+		cc_nodiscard sample_summary summarize() const
+		{
+			std::vector<f64> sorted = m_samples;
+			std::sort(sorted.begin(), sorted.end());
+
+			sample_summary summary = { .name = m_name, .unit = m_unit, .count = sorted.size() };
+
+			if (sorted.empty())
+			{
+				return summary;
+			}
+
+			f64 sum = 0.0;
+			for (const f64 sample: sorted)
+			{
+				sum += sample;
+			}
+
+			summary.min  = sorted.front();
+			summary.mean = sum / static_cast<f64>(sorted.size());
+			summary.p50  = percentile(sorted, 0.50);
+			summary.p90  = percentile(sorted, 0.90);
+			summary.p99  = percentile(sorted, 0.99);
+			summary.max  = sorted.back();
+
+			return summary;
+		}
+
+	private:
+		std::string m_name;
+		std::string m_unit;
+		std::vector<f64> m_samples;
+	};
+
+	template<typename Function>
+	f64 measure_milliseconds(Function&& function)
+	{
+		const clock::time_point start = clock::now();
+		function();
+		return std::chrono::duration<f64, std::milli>(clock::now() - start).count();
+	}
+
+	constexpr u32 default_repetitions = 9;
+
+	template<typename Function>
+	sample_set measure_repeated(std::string name, u32 repetitions, Function&& function)
+	{
+		sample_set samples(std::move(name));
+
+		for (u32 repetition = 0; repetition < repetitions; ++repetition)
+		{
+			samples.add(measure_milliseconds(function));
+		}
+
+		return samples;
+	}
+
+	/**
+	 * @brief Writes and reads the benchmark report format.
+	 *
+	 * @details Every benchmark is written as a single-line JSON object so that baselines can be
+	 * read back without a JSON library; read_baseline() only understands files written by
+	 * write_json().
+	 */
+	class report
+	{
+	public:
+		void set_configuration(std::string key, std::string json_value)
+		{
+			m_configuration.emplace_back(std::move(key), std::move(json_value));
+		}
+
+		void add(const sample_summary& summary)
+		{
+			m_summaries.push_back(summary);
+		}
+
+		cc_nodiscard const std::vector<sample_summary>& get_summaries() const
+		{
+			return m_summaries;
+		}
+
+		void write_json(std::FILE* p_file) const
+		{
+			std::fprintf(p_file, "{\n  \"schema\": 1,\n  \"configuration\": {");
+
+			for (std::size_t index = 0; index < m_configuration.size(); ++index)
+			{
+				std::fprintf(p_file, "%s\"%s\": %s", index == 0 ? "" : ", ", m_configuration[index].first.c_str(), m_configuration[index].second.c_str());
+			}
+
+			std::fprintf(p_file, "},\n  \"benchmarks\": [\n");
+
+			for (std::size_t index = 0; index < m_summaries.size(); ++index)
+			{
+				const sample_summary& summary = m_summaries[index];
+
+				std::fprintf(p_file,
+				             "    {\"name\": \"%s\", \"unit\": \"%s\", \"samples\": %llu, \"min\": %.6f, \"mean\": %.6f, \"p50\": %.6f, \"p90\": %.6f, \"p99\": %.6f, \"max\": %.6f}%s\n",
+				             summary.name.c_str(),
+				             summary.unit.c_str(),
+				             static_cast<unsigned long long>(summary.count),
+				             summary.min,
+				             summary.mean,
+				             summary.p50,
+				             summary.p90,
+				             summary.p99,
+				             summary.max,
+				             index + 1 == m_summaries.size() ? "" : ",");
+			}
+
+			std::fprintf(p_file, "  ]\n}\n");
+		}
+
+		static std::vector<sample_summary> read_baseline(const char* p_path)
+		{
+			std::ifstream file(p_path);
+			if (!file)
+			{
+				std::fprintf(stderr, "Failed to open baseline %s.\n", p_path);
+				std::exit(2);
+			}
+
+			std::vector<sample_summary> summaries;
+			std::string line;
+
+			while (std::getline(file, line))
+			{
+				const std::size_t name = line.find("\"name\": \"");
+				if (name == std::string::npos)
+				{
+					continue;
+				}
+
+				const std::size_t name_begin = name + std::strlen("\"name\": \"");
+				const std::size_t name_end   = line.find('"', name_begin);
+
+				sample_summary summary;
+				summary.name = line.substr(name_begin, name_end - name_begin);
+				summary.p50  = read_number(line, "p50");
+				summary.p90  = read_number(line, "p90");
+				summary.p99  = read_number(line, "p99");
+
+				summaries.push_back(std::move(summary));
+			}
+
+			return summaries;
+		}
+
+		// Flags benchmarks whose median got slower than the baseline by more than the relative
+		// threshold. The absolute floor keeps sub-microsecond jitter on tiny phases from failing a run.
+		cc_nodiscard u32 compare(const std::vector<sample_summary>& baseline, f64 threshold, f64 min_delta) const
+		{
+			u32 regressions = 0;
+
+			std::fprintf(stderr, "%-32s %12s %12s %9s\n", "benchmark", "baseline p50", "current p50", "change");
+
+			for (const sample_summary& current: m_summaries)
+			{
+				const auto previous = std::find_if(baseline.begin(), baseline.end(), [&current](const sample_summary& summary) {
+					return summary.name == current.name;
+				});
+
+				if (previous == baseline.end())
+				{
+					std::fprintf(stderr, "%-32s %12s %12.4f %9s\n", current.name.c_str(), "-", current.p50, "new");
+					continue;
+				}
+
+				const f64 delta     = current.p50 - previous->p50;
+				const f64 change    = previous->p50 > 0.0 ? delta / previous->p50 : 0.0;
+				const b8 regression = change > threshold && delta > min_delta;
+
+				regressions += regression ? 1 : 0;
+
+				std::fprintf(stderr, "%-32s %12.4f %12.4f %+8.1f%%%s\n", current.name.c_str(), previous->p50, current.p50, change * 100.0, regression ? "  REGRESSION" : "");
+			}
+
+			return regressions;
+		}
+
+	private:
+		static f64 read_number(const std::string& line, const char* p_key)
+		{
+			const std::string key    = std::string("\"") + p_key + "\": ";
+			const std::size_t offset = line.find(key);
+
+			return offset != std::string::npos ? std::strtod(line.c_str() + offset + key.size(), nullptr) : 0.0;
+		}
+
+		std::vector<std::pair<std::string, std::string>> m_configuration;
+		std::vector<sample_summary> m_summaries;
+	};
+
+	inline void set_build_configuration(report& results)
+	{
+#ifdef NDEBUG
+		results.set_configuration("build", "\"release\"");
+#else
+		results.set_configuration("build", "\"debug\"");
+#endif
+	}
+
+	struct report_options
+	{
+		const char* p_output   = nullptr;
+		const char* p_baseline = nullptr;
+		f64 threshold          = 0.10;
+		f64 min_delta_ms       = 0.05;
+	};
+
+	constexpr const char* report_usage = "[--output report.json] [--baseline baseline.json] [--threshold 0.10] [--min-delta-ms 0.05]";
+
+	// Consumes argv[index], and its value, when it is one of the report options.
+	inline b8 parse_report_option(int argc, char** argv, int& index, report_options& options)
+	{
+		const std::string argument = argv[index];
+		const b8 has_value         = index + 1 < argc;
+
+		if (argument == "--output" && has_value)
+			options.p_output = argv[++index];
+		else if (argument == "--baseline" && has_value)
+			options.p_baseline = argv[++index];
+		else if (argument == "--threshold" && has_value)
+			options.threshold = std::stod(argv[++index]);
+		else if (argument == "--min-delta-ms" && has_value)
+			options.min_delta_ms = std::stod(argv[++index]);
+		else
+			return false;
+
+		return true;
+	}
+
+	// Writes the report to --output, or to p_default_file when there is none and it is set, and compares it
+	// against --baseline. Returns the exit code for main().
+	inline int finish_report(const report& results, const report_options& options, std::FILE* p_default_file)
+	{
+		if (options.p_output != nullptr)
+		{
+			std::FILE* p_file = std::fopen(options.p_output, "w");
+			if (p_file == nullptr)
+			{
+				std::fprintf(stderr, "Failed to open %s for writing.\n", options.p_output);
+				return 2;
+			}
+
+			results.write_json(p_file);
+			std::fclose(p_file);
+		}
+		else if (p_default_file != nullptr)
+		{
+			results.write_json(p_default_file);
+		}
+
+		if (options.p_baseline != nullptr)
+		{
+			const u32 regressions = results.compare(report::read_baseline(options.p_baseline), options.threshold, options.min_delta_ms);
+
+			if (regressions != 0)
+			{
+				std::fprintf(stderr, "%u benchmark(s) regressed by more than %.0f%%.\n", regressions, options.threshold * 100.0);
+				return 1;
+			}
+		}
+
+		return 0;
+	}
+
+	/**
+	 * @brief Runs the cases of a microbenchmark and reports them.
+	 *
+	 * @details Every case is run get_repetitions() times and added to a report, which finish() writes
+	 * and compares against a baseline like capricorn_bench does. The console shows the median run of
+	 * each case, with the throughput it measures. Besides the report options, the command line takes
+	 * --repetitions N and whatever flags the benchmark asks for.
+	 */
+	class suite
+	{
+	public:
+		suite(const char* p_program, int argc, char** argv, std::initializer_list<const char*> flags = {})
+		{
+			for (int index = 1; index < argc; ++index)
+			{
+				if (parse_report_option(argc, argv, index, m_options))
+				{
+					continue;
+				}
+
+				const std::string argument = argv[index];
+
+				if (argument == "--repetitions" && index + 1 < argc)
+				{
+					m_repetitions = std::max(1U, static_cast<u32>(std::stoul(argv[++index])));
+				}
+				else if (std::find(flags.begin(), flags.end(), argument) != flags.end())
+				{
+					m_flags.push_back(argument);
+				}
+				else
+				{
+					std::fprintf(stderr, "usage: %s [--repetitions N] %s", p_program, report_usage);
+					for (const char* p_flag: flags)
+					{
+						std::fprintf(stderr, " [%s]", p_flag);
+					}
+					std::fprintf(stderr, "\n");
+					std::exit(2);
+				}
+			}
+
+			m_report.set_configuration("repetitions", std::to_string(m_repetitions));
+			set_build_configuration(m_report);
+		}
+
+		cc_nodiscard u32 get_repetitions() const noexcept
+		{
+			return m_repetitions;
+		}
+
+		cc_nodiscard b8 has_flag(const char* p_flag) const
+		{
+			return std::find(m_flags.begin(), m_flags.end(), p_flag) != m_flags.end();
+		}
+
+		void set_configuration(std::string key, std::string json_value)
+		{
+			m_report.set_configuration(std::move(key), std::move(json_value));
+		}
+
+		template<typename Function>
+		sample_summary run(std::string name, Function&& function)
+		{
+			return add(measure_repeated(std::move(name), m_repetitions, std::forward<Function>(function)));
+		}
+
+		// For cases that are timed some other way, interleaved with others or by the engine itself.
+		sample_summary add(const sample_set& samples)
+		{
+			const sample_summary summary = samples.summarize();
+			m_report.add(summary);
+			return summary;
+		}
+
+		static void print_operations(const sample_summary& summary, u64 operations)
+		{
+			const f64 seconds = summary.p50 / 1000.0;
+			std::printf("%-40s %12.3f ms %14.0f ops/s %10.1f ns/op\n", summary.name.c_str(), summary.p50, static_cast<f64>(operations) / seconds, seconds * 1e9 / static_cast<f64>(operations));
+		}
+
+		static void print_bytes(const sample_summary& summary, u64 bytes)
+		{
+			std::printf("%-40s %12.3f ms %12.1f MB/s\n", summary.name.c_str(), summary.p50, static_cast<f64>(bytes) / (1000.0 * summary.p50));
+		}
+
+		static void print_speedup(const sample_summary& summary, u64 operations, const sample_summary& baseline)
+		{
+			std::printf("%-40s %12.3f ms %10.1f ns/op %8.2fx\n", summary.name.c_str(), summary.p50, summary.p50 * 1e6 / static_cast<f64>(operations), baseline.p50 / summary.p50);
+		}
+
+		cc_nodiscard int finish() const
+		{
+			return finish_report(m_report, m_options, nullptr);
+		}
+
+	private:
+		report_options m_options;
+		u32 m_repetitions = default_repetitions;
+		std::vector<std::string> m_flags;
+		report m_report;
+	};
+} // namespace cc::bench
+
+#endif //CAPRICORN_BENCH_HARNESS_HPP
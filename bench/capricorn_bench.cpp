@@ -0,0 +1,233 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "bench_harness.hpp"
+
+#include "capricorn/base/application.hpp"
+#include "capricorn/base/window.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+
+namespace cc::bench
+{
+	struct options
+	{
+		b8 headless            = false;
+		u32 startup_iterations = 10;
+		u32 startup_warmup     = 1;
+		u32 frames             = 600;
+		u32 frame_warmup       = 60;
+		b8 validation          = false; // Also runs the frame loop once per validation profile.
+		report_options reporting;
+	};
+
+	options parse_options(int argc, char** argv)
+	{
+		options options;
+
+		for (int index = 1; index < argc; ++index)
+		{
+			if (parse_report_option(argc, argv, index, options.reporting))
+			{
+				continue;
+			}
+
+			const std::string argument = argv[index];
+			const b8 has_value         = index + 1 < argc;
+
+			if (argument == "--headless")
+				options.headless = true;
+			else if (argument == "--iterations" && has_value)
+				options.startup_iterations = static_cast<u32>(std::stoul(argv[++index]));
+			else if (argument == "--frames" && has_value)
+				options.frames = static_cast<u32>(std::stoul(argv[++index]));
+			else if (argument == "--validation")
+				options.validation = true;
+			else
+			{
+				std::fprintf(stderr, "usage: capricorn_bench [--headless] [--iterations N] [--frames N] [--validation]\n                       %s\n", report_usage);
+				std::exit(2);
+			}
+		}
+
+		return options;
+	}
+
+	constexpr f64 to_milliseconds(f64 seconds)
+	{
+		return seconds * 1000.0;
+	}
+
+	constexpr const char* capability_cache_path = "capricorn_bench_capabilities.cache";
+
+	// Brings the engine up to its first frame and back down, once per iteration, timing every phase. Cold
+	// runs delete the capability cache first, warm runs reuse the one the previous iteration wrote.
+	void measure_startup(const options& options, b8 cold, report& results)
+	{
+		const std::string prefix = cold ? "startup.cold." : "startup.warm.";
+
+		sample_set log_initialize(prefix + "log_initialize");
+		sample_set glfw_init(prefix + "glfw_init");
+		sample_set window_creation(prefix + "window_creation");
+		sample_set instance_creation(prefix + "instance_creation");
+		sample_set device_discovery(prefix + "device_discovery");
+		sample_set startup_wait(prefix + "startup_wait");
+		sample_set surface_creation(prefix + "surface_creation");
+		sample_set device_selection(prefix + "device_selection");
+		sample_set device_creation(prefix + "device_creation");
+		sample_set time_to_first_frame(prefix + "time_to_first_frame");
+
+		const application_create_info application_create_info = {
+		        .headless                = options.headless,
+		        .max_frames              = 1,
+		        .p_capability_cache_path = capability_cache_path,
+		};
+
+		for (u32 iteration = 0; iteration < options.startup_warmup + options.startup_iterations; ++iteration)
+		{
+			if (cold)
+			{
+				std::filesystem::remove(capability_cache_path);
+			}
+
+			auto application = std::make_shared<cc::application>(application_create_info);
+			application->initialize();
+			application->execute();
+
+			const application_startup_timing timing = application->get_startup_timing();
+
+			application->shutdown();
+			application.reset();
+
+			if (!options.headless)
+			{
+				// Otherwise every iteration after the first would measure an already initialized GLFW.
+				glfwTerminate();
+			}
+
+			if (iteration < options.startup_warmup)
+			{
+				continue;
+			}
+
+			log_initialize.add(to_milliseconds(timing.log_initialize_seconds));
+			glfw_init.add(to_milliseconds(timing.window.glfw_init_seconds));
+			window_creation.add(to_milliseconds(timing.window.window_creation_seconds));
+			instance_creation.add(to_milliseconds(timing.window.graphics.instance_seconds));
+			device_discovery.add(to_milliseconds(timing.window.graphics.device_discovery_seconds));
+			startup_wait.add(to_milliseconds(timing.window.graphics.startup_wait_seconds));
+			surface_creation.add(to_milliseconds(timing.window.graphics.surface_seconds));
+			device_selection.add(to_milliseconds(timing.window.graphics.device_selection_seconds));
+			device_creation.add(to_milliseconds(timing.window.graphics.device_creation_seconds));
+			time_to_first_frame.add(to_milliseconds(timing.time_to_first_frame_seconds));
+		}
+
+		for (const sample_set* p_samples: { &log_initialize, &glfw_init, &window_creation, &instance_creation, &device_discovery, &startup_wait, &surface_creation, &device_selection, &device_creation, &time_to_first_frame })
+		{
+			results.add(p_samples->summarize());
+		}
+	}
+
+	// Runs the real main loop with immediate presentation and records how long each frame took. Returns the frame work summary.
+	sample_summary measure_frames(const options& options, report& results, const std::string& prefix = "", vk::validation_profile validation = vk::default_validation_profile)
+	{
+		sample_set frame_time(prefix + "frame.delta");
+		sample_set frame_work(prefix + "frame.work");
+
+		const application_create_info application_create_info = {
+		        .headless                = options.headless,
+		        .max_frames              = options.frame_warmup + options.frames,
+		        .p_capability_cache_path = capability_cache_path,
+		        .present_policy          = vk::present_policy::uncapped,
+		        .validation              = validation,
+		};
+
+		application application(application_create_info);
+		application.initialize();
+		application.set_frame_rate_cap(0.0);
+
+		application.set_update_callback([&application, &options, &frame_time, &frame_work](cc_unused f64 delta_time, cc_unused f64 alpha) {
+			const frame_timing& timing = application.get_frame_timing();
+
+			// Both describe the previous frame, which is complete by the time this one updates.
+			if (timing.frame_index > options.frame_warmup)
+			{
+				frame_time.add(to_milliseconds(timing.delta_time));
+				frame_work.add(to_milliseconds(timing.work_time));
+			}
+		});
+
+		application.execute();
+		application.shutdown();
+
+		const sample_summary work = frame_work.summarize();
+
+		results.add(frame_time.summarize());
+		results.add(work);
+
+		return work;
+	}
+
+	// The frame loop under every validation profile, with the median frame work of each compared to running without.
+	void measure_validation_overhead(const options& options, report& results)
+	{
+		if (std::getenv("CAPRICORN_VALIDATION") != nullptr)
+		{
+			std::fprintf(stderr, "CAPRICORN_VALIDATION is set and would override every profile, skipping the validation overhead report.\n");
+			return;
+		}
+
+		f64 baseline_ms = 0.0;
+
+		for (const vk::validation_profile profile: { vk::validation_profile::off, vk::validation_profile::errors, vk::validation_profile::full, vk::validation_profile::gpu_assisted, vk::validation_profile::synchronization })
+		{
+			const char* p_name = vk::get_validation_profile_name(profile);
+
+			try
+			{
+				const sample_summary work = measure_frames(options, results, std::string("validation.") + p_name + ".", profile);
+
+				if (profile == vk::validation_profile::off)
+				{
+					baseline_ms = work.p50;
+					std::fprintf(stderr, "validation %-16s %8.3f ms frame work (p50)\n", p_name, work.p50);
+				}
+				else
+				{
+					const f64 overhead = baseline_ms > 0.0 ? (work.p50 - baseline_ms) / baseline_ms * 100.0 : 0.0;
+					std::fprintf(stderr, "validation %-16s %8.3f ms frame work (p50), %+7.1f%% over off\n", p_name, work.p50, overhead);
+				}
+			}
+			catch (const std::exception& exception)
+			{
+				// The dedicated profiles need a recent validation layer, a missing one should not end the report.
+				std::fprintf(stderr, "validation %-16s skipped: %s\n", p_name, exception.what());
+			}
+		}
+	}
+} // namespace cc::bench
+
+int main(int argc, char** argv)
+{
+	using namespace cc::bench;
+
+	const options options = parse_options(argc, argv);
+
+	report results;
+	results.set_configuration("headless", options.headless ? "true" : "false");
+	results.set_configuration("startup_iterations", std::to_string(options.startup_iterations));
+	results.set_configuration("frames", std::to_string(options.frames));
+	set_build_configuration(results);
+
+	measure_startup(options, true, results);
+	measure_startup(options, false, results);
+	measure_frames(options, results);
+
+	if (options.validation)
+	{
+		measure_validation_overhead(options, results);
+	}
+
+	return finish_report(results, options.reporting, stdout);
+}
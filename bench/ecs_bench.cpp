@@ -0,0 +1,308 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "bench_harness.hpp"
+
+#include "capricorn/base/log.hpp"
+#include "capricorn/ecs/command_buffer.hpp"
+#include "capricorn/ecs/system_scheduler.hpp"
+#include "capricorn/ecs/world.hpp"
+#include "capricorn/jobs/job_system.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace cc::bench
+{
+	struct position
+	{
+		f32 x, y, z;
+	};
+
+	struct velocity
+	{
+		f32 x, y, z;
+	};
+
+	struct health
+	{
+		f32 value;
+	};
+
+	struct frozen
+	{
+	};
+
+	// What the entities would be without an ECS: every component of an entity side by side, whether a loop needs it or not.
+	struct game_object
+	{
+		bench::position position;
+		bench::velocity velocity;
+		bench::health health;
+		u8 unused[36];
+	};
+
+	constexpr f32 timestep = 1.0F / 60.0F;
+
+	void integrate(position& position, const velocity& velocity) noexcept
+	{
+		position.x += velocity.x * timestep;
+		position.y += velocity.y * timestep;
+		position.z += velocity.z * timestep;
+	}
+
+	void populate(ecs::world& world, u32 count)
+	{
+		for (u32 index = 0; index < count; ++index)
+		{
+			const auto value = static_cast<f32>(index);
+			(void)world.create(position{ value, 0.0F, 0.0F }, velocity{ 1.0F, value, 0.0F }, health{ 100.0F });
+		}
+	}
+
+	void iteration(suite& suite, u32 count, job_system& job_system)
+	{
+		std::vector<game_object> objects(count);
+
+		for (u32 index = 0; index < count; ++index)
+		{
+			objects[index].velocity = { 1.0F, static_cast<f32>(index), 0.0F };
+		}
+
+		const sample_summary objects_loop = suite.run("iterate, array of objects", [&objects] {
+			for (game_object& object: objects)
+			{
+				integrate(object.position, object.velocity);
+			}
+		});
+		suite.print_operations(objects_loop, count);
+
+		ecs::world world;
+		populate(world, count);
+
+		const ecs::query<position, const velocity> moving = world.query<position, const velocity>();
+
+		const sample_summary for_each = suite.run("iterate, for_each", [&moving] {
+			moving.for_each([](position& position, const velocity& velocity) { integrate(position, velocity); });
+		});
+		suite.print_operations(for_each, count);
+
+		const sample_summary for_each_chunk = suite.run("iterate, for_each_chunk", [&moving] {
+			moving.for_each_chunk([](u32 chunk_count, const ecs::entity* /*p_entities*/, position* p_positions, const velocity* p_velocities) {
+				for (u32 row = 0; row < chunk_count; ++row)
+				{
+					integrate(p_positions[row], p_velocities[row]);
+				}
+			});
+		});
+		suite.print_operations(for_each_chunk, count);
+
+		const sample_summary parallel_for_each = suite.run("iterate, parallel_for_each", [&moving, &job_system] {
+			moving.parallel_for_each(job_system, [](position& position, const velocity& velocity) { integrate(position, velocity); });
+		});
+		suite.print_operations(parallel_for_each, count);
+	}
+
+	void lifetime(suite& suite, u32 count)
+	{
+		std::vector<ecs::entity> entities(count);
+
+		const sample_summary empty = suite.run("create + destroy, empty", [&entities] {
+			ecs::world world;
+
+			for (ecs::entity& entity: entities)
+			{
+				entity = world.create();
+			}
+
+			for (const ecs::entity entity: entities)
+			{
+				world.destroy(entity);
+			}
+		});
+		suite.print_operations(empty, static_cast<u64>(count) * 2);
+
+		const sample_summary components = suite.run("create + destroy, 3 components", [&entities] {
+			ecs::world world;
+
+			for (ecs::entity& entity: entities)
+			{
+				entity = world.create(position{}, velocity{}, health{});
+			}
+
+			for (const ecs::entity entity: entities)
+			{
+				world.destroy(entity);
+			}
+		});
+		suite.print_operations(components, static_cast<u64>(count) * 2);
+	}
+
+	void churn(suite& suite, u32 count)
+	{
+		ecs::world world;
+		populate(world, count);
+
+		std::vector<ecs::entity> entities;
+		entities.reserve(count);
+		world.query<const position>().for_each([&entities](ecs::entity entity, const position& /*position*/) { entities.push_back(entity); });
+
+		// Both transitions are cached archetype edges after the first run.
+		const sample_summary tagging = suite.run("add + remove tag", [&world, &entities] {
+			for (const ecs::entity entity: entities)
+			{
+				world.add<frozen>(entity);
+			}
+
+			for (const ecs::entity entity: entities)
+			{
+				world.remove<frozen>(entity);
+			}
+		});
+		suite.print_operations(tagging, static_cast<u64>(count) * 2);
+	}
+
+	template<u32 Index>
+	struct marker
+	{
+	};
+
+	template<u32... Indices>
+	void fan_out(ecs::world& world, std::integer_sequence<u32, Indices...> /*indices*/)
+	{
+		// One archetype per subset of the markers, every one of them matching the query below.
+		for (u32 subset = 0; subset < (1U << sizeof...(Indices)); ++subset)
+		{
+			const ecs::entity entity = world.create(position{}, velocity{});
+			((subset & (1U << Indices) ? (void)world.add<marker<Indices>>(entity) : (void)0), ...);
+		}
+	}
+
+	void matching(suite& suite)
+	{
+		ecs::world world;
+		fan_out(world, std::make_integer_sequence<u32, 10>{});
+
+		const u32 archetypes = world.get_archetype_count();
+
+		const sample_summary cached = suite.run("1000 queries, cached", [&world] {
+			for (u32 index = 0; index < 1000; ++index)
+			{
+				(void)world.query<position, const velocity>().count();
+			}
+		});
+		suite.print_operations(cached, static_cast<u64>(archetypes) * 1000);
+
+		// What every query costs without the cache: testing each archetype's mask.
+		const ecs::component_mask required = ecs::make_component_mask<position, velocity>();
+
+		const sample_summary scanned = suite.run("1000 queries, scanned", [&world, &required] {
+			for (u32 index = 0; index < 1000; ++index)
+			{
+				u32 matched = 0;
+
+				for (u32 archetype = 0; archetype < world.get_archetype_count(); ++archetype)
+				{
+					matched += (world.get_archetype(archetype).get_mask() & required) == required ? 1 : 0;
+				}
+
+				(void)matched;
+			}
+		});
+		suite.print_operations(scanned, static_cast<u64>(archetypes) * 1000);
+
+		std::printf("%-40s %12u\n", "  archetypes", archetypes);
+	}
+
+	void playback(suite& suite, u32 count)
+	{
+		ecs::world world;
+		populate(world, count);
+
+		std::vector<ecs::entity> entities;
+		entities.reserve(count);
+		world.query<const position>().for_each([&entities](ecs::entity entity, const position& /*position*/) { entities.push_back(entity); });
+
+		ecs::command_buffer commands(world);
+
+		const sample_summary recording = suite.run("command buffer, record + playback", [&] {
+			for (const ecs::entity entity: entities)
+			{
+				commands.add(entity, frozen{});
+			}
+
+			for (const ecs::entity entity: entities)
+			{
+				commands.remove<frozen>(entity);
+			}
+
+			for (u32 index = 0; index < count; ++index)
+			{
+				commands.destroy(commands.create());
+			}
+
+			commands.playback();
+		});
+		suite.print_operations(recording, static_cast<u64>(count) * 3);
+	}
+
+	void scheduling(suite& suite, u32 count, const std::shared_ptr<job_system>& p_job_system)
+	{
+		const auto p_world = ecs::world::create({});
+		populate(*p_world, count);
+
+		const auto p_scheduler = ecs::system_scheduler::create({ .p_world = p_world, .p_job_system = p_job_system });
+
+		// Neither writes what the other touches, so they share a wave.
+		std::optional<ecs::query<position, const velocity>> movement;
+		p_scheduler->add_system(
+		        "movement",
+		        [&movement](ecs::system_builder& builder) { movement = builder.query<position, const velocity>(); },
+		        [&movement](ecs::system_context& /*context*/) {
+			        movement->for_each([](position& position, const velocity& velocity) { integrate(position, velocity); });
+		        });
+
+		std::optional<ecs::query<health>> regeneration;
+		p_scheduler->add_system(
+		        "regeneration",
+		        [&regeneration](ecs::system_builder& builder) { regeneration = builder.query<health>(); },
+		        [&regeneration](ecs::system_context& context) {
+			        regeneration->for_each([&context](health& health) { health.value = std::min(100.0F, health.value + static_cast<f32>(context.delta_time)); });
+		        });
+
+		suite.print_operations(suite.run("scheduler, 2 systems", [&p_scheduler] { p_scheduler->run(timestep); }), count);
+
+		const ecs::system_scheduler_statistics statistics = p_scheduler->get_statistics();
+		std::printf("%-40s %12u waves, widest %u\n", "  schedule", statistics.waves, statistics.widest_wave);
+	}
+} // namespace cc::bench
+
+int main(int argc, char** argv)
+{
+	using namespace cc;
+
+	bench::suite suite("capricorn_ecs_bench", argc, argv);
+
+	log::initialize();
+
+	constexpr u32 entities = 1'000'000;
+
+	std::printf("ECS microbenchmarks, median of %u runs\n", suite.get_repetitions());
+
+	const auto p_job_system = job_system::create({});
+
+	bench::iteration(suite, entities, *p_job_system);
+	bench::lifetime(suite, entities);
+	bench::churn(suite, entities);
+	bench::matching(suite);
+	bench::playback(suite, entities / 4);
+	bench::scheduling(suite, entities, p_job_system);
+
+	log::shutdown();
+
+	return suite.finish();
+}
@@ -0,0 +1,463 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/graphics_context.hpp"
+#include "capricorn/graphics/vulkan/gpu_culler.hpp"
+#include "capricorn/graphics/vulkan/memory_allocator.hpp"
+#include "capricorn/math/culling.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cc::bench
+{
+	using clock = std::chrono::steady_clock;
+
+	constexpr VkFormat color_format = VK_FORMAT_R8G8B8A8_UNORM;
+	constexpr VkExtent2D extent     = { 256, 256 };
+
+	// gl_Position = vec4(0.0), hand-assembled so the benchmark needs no shader compiler.
+	constexpr std::array<u32, 55> vertex_shader = {
+	        0x07230203, 0x00010000, 0x00000000, 10, 0,
+	        (2 << 16) | 17, 1,                                // OpCapability Shader
+	        (3 << 16) | 14, 0, 1,                             // OpMemoryModel Logical GLSL450
+	        (6 << 16) | 15, 0, 8, 0x6E69616D, 0x00000000, 6, // OpEntryPoint Vertex %8 "main" %6
+	        (4 << 16) | 71, 6, 11, 0,                         // OpDecorate %6 BuiltIn Position
+	        (2 << 16) | 19, 1,                                // %1 = OpTypeVoid
+	        (3 << 16) | 33, 2, 1,                             // %2 = OpTypeFunction %1
+	        (3 << 16) | 22, 3, 32,                            // %3 = OpTypeFloat 32
+	        (4 << 16) | 23, 4, 3, 4,                          // %4 = OpTypeVector %3 4
+	        (4 << 16) | 32, 5, 3, 4,                          // %5 = OpTypePointer Output %4
+	        (4 << 16) | 59, 5, 6, 3,                          // %6 = OpVariable %5 Output
+	        (3 << 16) | 46, 4, 7,                             // %7 = OpConstantNull %4
+	        (5 << 16) | 54, 1, 8, 0, 2,                       // %8 = OpFunction %1 None %2
+	        (2 << 16) | 248, 9,                               // %9 = OpLabel
+	        (3 << 16) | 62, 6, 7,                             // OpStore %6 %7
+	        (1 << 16) | 253,                                  // OpReturn
+	        (1 << 16) | 56,                                   // OpFunctionEnd
+	};
+
+	// An empty fragment shader.
+	constexpr std::array<u32, 32> fragment_shader = {
+	        0x07230203, 0x00010000, 0x00000000, 5, 0,
+	        (2 << 16) | 17, 1,                             // OpCapability Shader
+	        (3 << 16) | 14, 0, 1,                          // OpMemoryModel Logical GLSL450
+	        (5 << 16) | 15, 4, 3, 0x6E69616D, 0x00000000, // OpEntryPoint Fragment %3 "main"
+	        (3 << 16) | 16, 3, 7,                          // OpExecutionMode %3 OriginUpperLeft
+	        (2 << 16) | 19, 1,                             // %1 = OpTypeVoid
+	        (3 << 16) | 33, 2, 1,                          // %2 = OpTypeFunction %1
+	        (5 << 16) | 54, 1, 3, 0, 2,                    // %3 = OpFunction %1 None %2
+	        (2 << 16) | 248, 4,                            // %4 = OpLabel
+	        (1 << 16) | 253,                               // OpReturn
+	        (1 << 16) | 56,                                // OpFunctionEnd
+	};
+
+	struct options
+	{
+		u32 objects = 131'072;
+		u32 frames  = 60;
+		u32 warmup  = 10;
+	};
+
+	// A render pass, target, pipeline and a one-triangle index buffer, so draws cost what they cost in a real frame.
+	class draw_target
+	{
+	public:
+		explicit draw_target(const std::shared_ptr<vk::logical_device>& p_device)
+		    : m_device(p_device)
+		{
+			const VkDevice device                               = *m_device;
+			const vk::device_dispatch& dispatch                 = m_device->get_dispatch();
+			const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+
+			VkAttachmentDescription attachment = {};
+			attachment.format                  = color_format;
+			attachment.samples                 = VK_SAMPLE_COUNT_1_BIT;
+			attachment.loadOp                  = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachment.storeOp                 = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.stencilLoadOp           = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp          = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachment.finalLayout             = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+			VkAttachmentReference const color_reference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+			VkSubpassDescription subpass = {};
+			subpass.pipelineBindPoint    = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpass.colorAttachmentCount = 1;
+			subpass.pColorAttachments    = &color_reference;
+
+			VkRenderPassCreateInfo render_pass_create_info = {};
+			render_pass_create_info.sType                  = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+			render_pass_create_info.attachmentCount        = 1;
+			render_pass_create_info.pAttachments           = &attachment;
+			render_pass_create_info.subpassCount           = 1;
+			render_pass_create_info.pSubpasses             = &subpass;
+
+			vk::vk_ensure(dispatch.vkCreateRenderPass(device, &render_pass_create_info, p_allocation_callbacks, &m_render_pass), "Failed to create benchmark render pass!");
+
+			VkImageCreateInfo image_create_info = {};
+			image_create_info.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			image_create_info.imageType         = VK_IMAGE_TYPE_2D;
+			image_create_info.format            = color_format;
+			image_create_info.extent            = { extent.width, extent.height, 1 };
+			image_create_info.mipLevels         = 1;
+			image_create_info.arrayLayers       = 1;
+			image_create_info.samples           = VK_SAMPLE_COUNT_1_BIT;
+			image_create_info.tiling            = VK_IMAGE_TILING_OPTIMAL;
+			image_create_info.usage             = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			image_create_info.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+			image_create_info.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			m_image = m_device->get_memory_allocator().lock()->create_image({
+			        .image    = image_create_info,
+			        .category = vk::allocation_category::render_target,
+			        .p_name   = "culling benchmark target",
+			});
+
+			VkImageViewCreateInfo view_create_info = {};
+			view_create_info.sType                 = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			view_create_info.image                 = m_image->get_handle();
+			view_create_info.viewType              = VK_IMAGE_VIEW_TYPE_2D;
+			view_create_info.format                = color_format;
+			view_create_info.subresourceRange      = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+			vk::vk_ensure(dispatch.vkCreateImageView(device, &view_create_info, p_allocation_callbacks, &m_view), "Failed to create benchmark image view!");
+
+			VkFramebufferCreateInfo framebuffer_create_info = {};
+			framebuffer_create_info.sType                   = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebuffer_create_info.renderPass              = m_render_pass;
+			framebuffer_create_info.attachmentCount         = 1;
+			framebuffer_create_info.pAttachments            = &m_view;
+			framebuffer_create_info.width                   = extent.width;
+			framebuffer_create_info.height                  = extent.height;
+			framebuffer_create_info.layers                  = 1;
+
+			vk::vk_ensure(dispatch.vkCreateFramebuffer(device, &framebuffer_create_info, p_allocation_callbacks, &m_framebuffer), "Failed to create benchmark framebuffer!");
+
+			create_pipeline();
+
+			m_indices = m_device->get_memory_allocator().lock()->create_buffer({
+			        .size   = sizeof(u32) * 3,
+			        .usage  = VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			        .memory = vk::memory_usage::dynamic,
+			        .p_name = "culling benchmark indices",
+			});
+
+			const std::array<u32, 3> indices = { 0, 1, 2 };
+			std::memcpy(m_indices->get_mapped_data(), indices.data(), sizeof(indices));
+			m_device->get_memory_allocator().lock()->flush(*m_indices);
+		}
+
+		~draw_target()
+		{
+			const VkDevice device                               = *m_device;
+			const vk::device_dispatch& dispatch                 = m_device->get_dispatch();
+			const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+
+			dispatch.vkDeviceWaitIdle(device);
+			dispatch.vkDestroyPipeline(device, m_pipeline, p_allocation_callbacks);
+			dispatch.vkDestroyPipelineLayout(device, m_pipeline_layout, p_allocation_callbacks);
+			dispatch.vkDestroyFramebuffer(device, m_framebuffer, p_allocation_callbacks);
+			dispatch.vkDestroyImageView(device, m_view, p_allocation_callbacks);
+			dispatch.vkDestroyRenderPass(device, m_render_pass, p_allocation_callbacks);
+		}
+
+		draw_target(const draw_target& other)                = delete;
+		draw_target(draw_target&& other) noexcept            = delete;
+		draw_target& operator=(const draw_target& other)     = delete;
+		draw_target& operator=(draw_target&& other) noexcept = delete;
+
+		// Begins the render pass and binds what every draw uses.
+		void begin(VkCommandBuffer command_buffer) const
+		{
+			const vk::device_dispatch& dispatch = m_device->get_dispatch();
+			VkClearValue const clear            = { .color = { { 0.0F, 0.0F, 0.0F, 1.0F } } };
+
+			VkRenderPassBeginInfo begin_info = {};
+			begin_info.sType                 = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			begin_info.renderPass            = m_render_pass;
+			begin_info.framebuffer           = m_framebuffer;
+			begin_info.renderArea            = { { 0, 0 }, extent };
+			begin_info.clearValueCount       = 1;
+			begin_info.pClearValues          = &clear;
+
+			dispatch.vkCmdBeginRenderPass(command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+			dispatch.vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+			dispatch.vkCmdBindIndexBuffer(command_buffer, m_indices->get_handle(), 0, VK_INDEX_TYPE_UINT32);
+		}
+
+	private:
+		void create_pipeline()
+		{
+			const VkDevice device                               = *m_device;
+			const vk::device_dispatch& dispatch                 = m_device->get_dispatch();
+			const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+
+			const auto create_module = [device, &dispatch, p_allocation_callbacks](std::span<const u32> code) {
+				VkShaderModuleCreateInfo create_info = {};
+				create_info.sType                    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+				create_info.codeSize                 = code.size_bytes();
+				create_info.pCode                    = code.data();
+
+				VkShaderModule module = VK_NULL_HANDLE;
+				vk::vk_ensure(dispatch.vkCreateShaderModule(device, &create_info, p_allocation_callbacks, &module), "Failed to create benchmark shader module!");
+				return module;
+			};
+
+			const VkShaderModule vertex   = create_module(vertex_shader);
+			const VkShaderModule fragment = create_module(fragment_shader);
+
+			std::array<VkPipelineShaderStageCreateInfo, 2> stages = {};
+			stages[0].sType                                       = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			stages[0].stage                                       = VK_SHADER_STAGE_VERTEX_BIT;
+			stages[0].module                                      = vertex;
+			stages[0].pName                                       = "main";
+			stages[1].sType                                       = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			stages[1].stage                                       = VK_SHADER_STAGE_FRAGMENT_BIT;
+			stages[1].module                                      = fragment;
+			stages[1].pName                                       = "main";
+
+			VkPipelineLayoutCreateInfo layout_create_info = {};
+			layout_create_info.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+
+			vk::vk_ensure(dispatch.vkCreatePipelineLayout(device, &layout_create_info, p_allocation_callbacks, &m_pipeline_layout), "Failed to create benchmark pipeline layout!");
+
+			VkPipelineVertexInputStateCreateInfo vertex_input = {};
+			vertex_input.sType                                = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+			VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+			input_assembly.sType                                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+			input_assembly.topology                               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+			VkViewport const viewport = { 0.0F, 0.0F, static_cast<f32>(extent.width), static_cast<f32>(extent.height), 0.0F, 1.0F };
+			VkRect2D const scissor    = { { 0, 0 }, extent };
+
+			VkPipelineViewportStateCreateInfo viewport_state = {};
+			viewport_state.sType                             = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+			viewport_state.viewportCount                     = 1;
+			viewport_state.pViewports                        = &viewport;
+			viewport_state.scissorCount                      = 1;
+			viewport_state.pScissors                         = &scissor;
+
+			VkPipelineRasterizationStateCreateInfo rasterization = {};
+			rasterization.sType                                  = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+			rasterization.polygonMode                            = VK_POLYGON_MODE_FILL;
+			rasterization.cullMode                               = VK_CULL_MODE_NONE;
+			rasterization.frontFace                              = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+			rasterization.lineWidth                              = 1.0F;
+
+			VkPipelineMultisampleStateCreateInfo multisample = {};
+			multisample.sType                                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+			multisample.rasterizationSamples                 = VK_SAMPLE_COUNT_1_BIT;
+
+			VkPipelineColorBlendAttachmentState blend_attachment = {};
+			blend_attachment.colorWriteMask                      = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+			VkPipelineColorBlendStateCreateInfo blend = {};
+			blend.sType                               = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+			blend.attachmentCount                     = 1;
+			blend.pAttachments                        = &blend_attachment;
+
+			VkGraphicsPipelineCreateInfo pipeline_create_info = {};
+			pipeline_create_info.sType                        = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+			pipeline_create_info.stageCount                   = static_cast<u32>(stages.size());
+			pipeline_create_info.pStages                      = stages.data();
+			pipeline_create_info.pVertexInputState            = &vertex_input;
+			pipeline_create_info.pInputAssemblyState          = &input_assembly;
+			pipeline_create_info.pViewportState               = &viewport_state;
+			pipeline_create_info.pRasterizationState          = &rasterization;
+			pipeline_create_info.pMultisampleState            = &multisample;
+			pipeline_create_info.pColorBlendState             = &blend;
+			pipeline_create_info.layout                       = m_pipeline_layout;
+			pipeline_create_info.renderPass                   = m_render_pass;
+
+			vk::vk_ensure(dispatch.vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, p_allocation_callbacks, &m_pipeline), "Failed to create benchmark pipeline!");
+
+			dispatch.vkDestroyShaderModule(device, vertex, p_allocation_callbacks);
+			dispatch.vkDestroyShaderModule(device, fragment, p_allocation_callbacks);
+		}
+
+		std::shared_ptr<vk::logical_device> m_device;
+		std::shared_ptr<vk::gpu_image> m_image;
+		std::shared_ptr<vk::gpu_buffer> m_indices;
+		VkImageView m_view                 = VK_NULL_HANDLE;
+		VkRenderPass m_render_pass         = VK_NULL_HANDLE;
+		VkFramebuffer m_framebuffer        = VK_NULL_HANDLE;
+		VkPipelineLayout m_pipeline_layout = VK_NULL_HANDLE;
+		VkPipeline m_pipeline              = VK_NULL_HANDLE;
+	};
+
+	// Cheap and deterministic, so every run sees the same scene.
+	struct xorshift
+	{
+		u32 state;
+
+		cc_nodiscard f32 next(f32 minimum, f32 maximum) noexcept
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return minimum + (maximum - minimum) * static_cast<f32>(state >> 8) / static_cast<f32>(1U << 24);
+		}
+	};
+
+	// The camera turns a little every frame, so what is visible keeps changing.
+	math::frustum camera_frustum(u32 step)
+	{
+		const glm::mat4 projection = glm::perspective(glm::radians(90.0F), 16.0F / 9.0F, 0.1F, 500.0F);
+		const glm::vec3 forward    = glm::vec3(glm::sin(static_cast<f32>(step) * 0.05F), 0.0F, -glm::cos(static_cast<f32>(step) * 0.05F));
+		const glm::mat4 view       = glm::lookAt(glm::vec3(0.0F), forward, glm::vec3(0.0F, 1.0F, 0.0F));
+
+		return math::frustum::from_matrix(projection * view);
+	}
+
+	struct frame_times
+	{
+		f64 record_seconds = 0.0; // CPU time from culling to the end of the render pass.
+		f64 frame_seconds  = 0.0; // Between successive frames, which includes waiting for the GPU.
+	};
+
+	// Medians over the measured frames. record gets the frame and how many frames came before it, to place the camera by.
+	template<typename Function>
+	frame_times measure(graphics_context& context, const options& options, Function&& record)
+	{
+		std::vector<f64> record_samples;
+		std::vector<f64> frame_samples;
+
+		clock::time_point previous = clock::now();
+
+		for (u32 frame_index = 0; frame_index < options.warmup + options.frames; frame_index++)
+		{
+			const std::optional<graphics_frame> frame = context.begin_frame();
+			ensure(frame.has_value(), "Benchmark frame was skipped!");
+
+			const clock::time_point start = clock::now();
+			record(*frame, frame_index);
+			const clock::time_point end = clock::now();
+
+			context.end_frame(*frame);
+
+			if (frame_index >= options.warmup)
+			{
+				record_samples.push_back(std::chrono::duration<f64>(end - start).count());
+				frame_samples.push_back(std::chrono::duration<f64>(end - previous).count());
+			}
+
+			previous = end;
+		}
+
+		std::sort(record_samples.begin(), record_samples.end());
+		std::sort(frame_samples.begin(), frame_samples.end());
+
+		return { .record_seconds = record_samples[record_samples.size() / 2], .frame_seconds = frame_samples[frame_samples.size() / 2] };
+	}
+
+	void report(const char* p_name, const frame_times& times, const frame_times& baseline)
+	{
+		std::printf("%-28s %14.3f %12.3f %9.2fx\n", p_name, times.record_seconds * 1000.0, times.frame_seconds * 1000.0, baseline.frame_seconds / times.frame_seconds);
+	}
+} // namespace cc::bench
+
+int main(int argc, char** argv)
+{
+	using namespace cc;
+
+	bench::options options;
+
+	for (int index = 1; index < argc; ++index)
+	{
+		const std::string argument = argv[index];
+		const b8 has_value         = index + 1 < argc;
+
+		if (argument == "--objects" && has_value)
+			options.objects = std::max(1U, static_cast<u32>(std::stoul(argv[++index])));
+		else if (argument == "--frames" && has_value)
+			options.frames = std::max(1U, static_cast<u32>(std::stoul(argv[++index])));
+	}
+
+	log::initialize();
+
+	{
+		const auto context = graphics_context::create({ .headless = true });
+		context->initialize({});
+
+		const auto p_device = context->get_logical_device().lock();
+		const bench::draw_target target(p_device);
+		const vk::device_dispatch& dispatch = p_device->get_dispatch();
+
+		// Objects spread around the camera, as in the math benchmark.
+		bench::xorshift generator = { 0x9E3779B9U };
+		math::bounds_array bounds;
+		bounds.reserve(options.objects);
+
+		for (u32 index = 0; index < options.objects; index++)
+		{
+			const glm::vec3 center  = glm::vec3(generator.next(-500.0F, 500.0F), generator.next(-100.0F, 100.0F), generator.next(-500.0F, 500.0F));
+			const glm::vec3 extents = glm::vec3(generator.next(0.5F, 4.0F), generator.next(0.5F, 4.0F), generator.next(0.5F, 4.0F));
+			(void)bounds.add(center, extents);
+		}
+
+		std::printf("Culling and drawing %u objects per frame, median of %u frames\n", options.objects, options.frames);
+		std::printf("%-28s %14s %12s %10s\n", "submission", "cpu ms/frame", "ms/frame", "speedup");
+
+		// Culled with the SIMD kernels, then a draw recorded per visible object.
+		std::vector<u32> visible(options.objects);
+		u32 cpu_visible = 0;
+
+		const bench::frame_times cpu = bench::measure(*context, options, [&](const graphics_frame& frame, u32 step) {
+			cpu_visible = math::cull_spheres(bench::camera_frustum(step), bounds, visible.data());
+
+			target.begin(frame.command_buffer);
+
+			for (u32 index = 0; index < cpu_visible; index++)
+			{
+				dispatch.vkCmdDrawIndexed(frame.command_buffer, 3, 1, 0, 0, visible[index]);
+			}
+
+			dispatch.vkCmdEndRenderPass(frame.command_buffer);
+		});
+
+		bench::report("cpu cull, draw per object", cpu, cpu);
+
+		if (!vk::gpu_culler::is_supported(*p_device))
+		{
+			std::printf("%-28s device lacks multiDrawIndirect or drawIndirectCount\n", "gpu cull, indirect count");
+		}
+		else
+		{
+			const auto p_culler = vk::gpu_culler::create({ .p_device = p_device, .capacity = options.objects });
+
+			for (u32 index = 0; index < options.objects; index++)
+			{
+				(void)p_culler->add({ .center = bounds.get_center(index), .radius = bounds.get_radius(index), .index_count = 3 });
+			}
+
+			const bench::frame_times gpu = bench::measure(*context, options, [&](const graphics_frame& frame, u32 step) {
+				p_culler->cull(frame.command_buffer, frame.frame_index, bench::camera_frustum(step));
+
+				target.begin(frame.command_buffer);
+				p_culler->draw(frame.command_buffer);
+				dispatch.vkCmdEndRenderPass(frame.command_buffer);
+			});
+
+			bench::report("gpu cull, indirect count", gpu, cpu);
+
+			dispatch.vkDeviceWaitIdle(*p_device);
+		}
+
+		std::printf("%-28s %14u of %u, last frame\n", "  visible", cpu_visible, options.objects);
+	}
+
+	log::shutdown();
+
+	return 0;
+}
@@ -0,0 +1,189 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "bench_harness.hpp"
+
+#include "capricorn/base/log.hpp"
+#include "capricorn/graphics/vulkan/host_allocator.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace cc::bench
+{
+	// What a driver does without callbacks. Every request below asks for at most the alignment malloc guarantees.
+	void* VKAPI_CALL system_allocation(void* /*p_user_data*/, std::size_t size, std::size_t /*alignment*/, VkSystemAllocationScope /*scope*/)
+	{
+		return std::malloc(size);
+	}
+
+	void* VKAPI_CALL system_reallocation(void* /*p_user_data*/, void* p_original, std::size_t size, std::size_t /*alignment*/, VkSystemAllocationScope /*scope*/)
+	{
+		return std::realloc(p_original, size);
+	}
+
+	void VKAPI_CALL system_free(void* /*p_user_data*/, void* p_memory)
+	{
+		std::free(p_memory);
+	}
+
+	constexpr VkAllocationCallbacks system_callbacks = {
+	        .pUserData       = nullptr,
+	        .pfnAllocation   = &system_allocation,
+	        .pfnReallocation = &system_reallocation,
+	        .pfnFree         = &system_free,
+	};
+
+	// Cheap and deterministic, so every run and both allocators see the same sequence.
+	struct xorshift
+	{
+		u32 state;
+
+		cc_nodiscard u32 next() noexcept
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+	};
+
+	// Mostly small command-scope allocations, as pipeline and descriptor creation make them, with the odd large object.
+	cc_nodiscard std::size_t driver_size(xorshift& generator) noexcept
+	{
+		const u32 roll = generator.next() % 100;
+
+		if (roll < 70)
+		{
+			return 16 + generator.next() % 240;
+		}
+
+		if (roll < 95)
+		{
+			return 256 + generator.next() % 1792;
+		}
+
+		return 2048 + generator.next() % 30720;
+	}
+
+	cc_nodiscard VkSystemAllocationScope driver_scope(xorshift& generator) noexcept
+	{
+		const u32 roll = generator.next() % 10;
+		return roll < 6 ? VK_SYSTEM_ALLOCATION_SCOPE_COMMAND : roll < 9 ? VK_SYSTEM_ALLOCATION_SCOPE_OBJECT : VK_SYSTEM_ALLOCATION_SCOPE_DEVICE;
+	}
+
+	// Keeps live_count allocations alive and replaces a random one per operation.
+	void churn(const VkAllocationCallbacks& callbacks, u32 seed, u32 operations, u32 live_count)
+	{
+		xorshift generator = { seed };
+		std::vector<void*> live(live_count, nullptr);
+
+		for (u32 operation = 0; operation < operations; ++operation)
+		{
+			void*& p_slot = live[generator.next() % live_count];
+
+			callbacks.pfnFree(callbacks.pUserData, p_slot);
+			p_slot = callbacks.pfnAllocation(callbacks.pUserData, driver_size(generator), 16, driver_scope(generator));
+		}
+
+		for (void* p_memory: live)
+		{
+			callbacks.pfnFree(callbacks.pUserData, p_memory);
+		}
+	}
+
+	// Arrays grown by doubling, how drivers build up lists of unknown length.
+	void growth(const VkAllocationCallbacks& callbacks, u32 arrays)
+	{
+		for (u32 array = 0; array < arrays; ++array)
+		{
+			void* p_memory = callbacks.pfnAllocation(callbacks.pUserData, 48, 8, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+
+			for (std::size_t size = 96; size <= 6144; size *= 2)
+			{
+				p_memory = callbacks.pfnReallocation(callbacks.pUserData, p_memory, size, 8, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+			}
+
+			callbacks.pfnFree(callbacks.pUserData, p_memory);
+		}
+	}
+
+	void threaded_churn(const VkAllocationCallbacks& callbacks, u32 thread_count, u32 operations, u32 live_count)
+	{
+		std::vector<std::thread> threads;
+		threads.reserve(thread_count);
+
+		for (u32 thread = 0; thread < thread_count; ++thread)
+		{
+			threads.emplace_back([&callbacks, thread, operations, live_count] {
+				churn(callbacks, 0x9E3779B9U + thread, operations, live_count);
+			});
+		}
+
+		for (std::thread& thread: threads)
+		{
+			thread.join();
+		}
+	}
+
+	void compare(suite& suite, const char* p_name, u64 operations, const vk::host_allocator& allocator, const auto& workload)
+	{
+		char name[64] = {};
+
+		std::snprintf(name, sizeof(name), "%s, malloc", p_name);
+		const sample_summary unpooled = suite.run(name, [&workload] {
+			workload(system_callbacks);
+		});
+
+		std::snprintf(name, sizeof(name), "%s, host allocator", p_name);
+		const sample_summary pooled = suite.run(name, [&workload, &allocator] {
+			workload(*allocator.get_callbacks());
+		});
+
+		suite.print_operations(unpooled, operations);
+		suite.print_operations(pooled, operations);
+	}
+} // namespace cc::bench
+
+int main(int argc, char** argv)
+{
+	using namespace cc;
+
+	bench::suite suite("capricorn_host_allocator_bench", argc, argv);
+
+	log::initialize();
+
+	constexpr u32 operations = 1'000'000;
+	constexpr u32 live_count = 4096;
+	constexpr u32 arrays     = 100'000;
+	const u32 thread_count   = std::max(2U, std::min(8U, std::thread::hardware_concurrency()));
+
+	suite.set_configuration("threads", std::to_string(thread_count));
+
+	std::printf("Vulkan host allocator microbenchmarks, median of %u runs\n", suite.get_repetitions());
+
+	const auto p_allocator = vk::host_allocator::create({});
+
+	bench::compare(suite, "churn, 1 thread", operations, *p_allocator, [](const VkAllocationCallbacks& callbacks) {
+		bench::churn(callbacks, 0x9E3779B9U, operations, live_count);
+	});
+
+	bench::compare(suite, "churn, all threads", static_cast<u64>(operations) * thread_count, *p_allocator, [thread_count](const VkAllocationCallbacks& callbacks) {
+		bench::threaded_churn(callbacks, thread_count, operations, live_count);
+	});
+
+	bench::compare(suite, "doubling reallocation", static_cast<u64>(arrays) * 9, *p_allocator, [](const VkAllocationCallbacks& callbacks) {
+		bench::growth(callbacks, arrays);
+	});
+
+	std::printf("%-40s %12u\n", "  threads", thread_count);
+
+	p_allocator->log_statistics();
+
+	log::shutdown();
+
+	return suite.finish();
+}
@@ -0,0 +1,153 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "bench_harness.hpp"
+
+#include "capricorn/jobs/job_system.hpp"
+
+#include <cstdio>
+
+namespace cc::bench
+{
+	// Main thread spawns empty jobs and helps run them until they are all done.
+	void spawn_throughput(suite& suite, job_system& jobs)
+	{
+		constexpr u32 job_count = 100'000;
+
+		const sample_summary spawn = suite.run("spawn + wait (empty jobs)", [&jobs] {
+			job_counter counter;
+			for (u32 index = 0; index < job_count; ++index)
+			{
+				jobs.run([] {}, &counter);
+			}
+			jobs.wait(counter);
+		});
+
+		suite.print_operations(spawn, job_count);
+	}
+
+	// A single job fans out children from a worker's deque, which the other threads have to steal.
+	void steal_throughput(suite& suite, job_system& jobs)
+	{
+		constexpr u32 job_count = 100'000;
+
+		const job_system_statistics before = jobs.get_statistics();
+
+		const sample_summary fan_out = suite.run("fan-out from worker (small jobs)", [&jobs] {
+			job_counter children;
+			job_counter root;
+
+			jobs.run([&jobs, &children] {
+				for (u32 index = 0; index < job_count; ++index)
+				{
+					jobs.run([] {
+						volatile u32 work = 0;
+						for (u32 step = 0; step < 64; ++step)
+						{
+							work = work + step;
+						}
+					},
+					         &children);
+				}
+			},
+			         &root);
+
+			jobs.wait(root);
+			jobs.wait(children);
+		});
+
+		const job_system_statistics after = jobs.get_statistics();
+		const u64 stolen                  = after.stolen - before.stolen;
+
+		suite.print_operations(fan_out, job_count);
+		std::printf("%-40s %12.1f %%\n", "  stolen", 100.0 * static_cast<f64>(stolen) / static_cast<f64>(static_cast<u64>(job_count) * suite.get_repetitions()));
+	}
+
+	u64 fibonacci(job_system& jobs, u32 n)
+	{
+		if (n < 16)
+		{
+			return n < 2 ? n : fibonacci(jobs, n - 1) + fibonacci(jobs, n - 2);
+		}
+
+		u64 left = 0;
+		job_counter counter;
+		jobs.run([&jobs, &left, n] {
+			left = fibonacci(jobs, n - 1);
+		},
+		         &counter);
+
+		const u64 right = fibonacci(jobs, n - 2);
+		jobs.wait(counter);
+
+		return left + right;
+	}
+
+	// Recursive task tree, the classic work-stealing stress test.
+	void recursive_tree(suite& suite, job_system& jobs)
+	{
+		u64 result = 0;
+
+		const job_system_statistics before = jobs.get_statistics();
+
+		const sample_summary tree = suite.run("recursive fib(32) tree", [&jobs, &result] {
+			result = fibonacci(jobs, 32);
+		});
+
+		const u64 executed = (jobs.get_statistics().executed - before.executed) / suite.get_repetitions();
+
+		suite.print_operations(tree, executed);
+		std::printf("%-40s %12llu\n", "  result", static_cast<unsigned long long>(result));
+	}
+
+	void parallel_for_throughput(suite& suite, job_system& jobs)
+	{
+		constexpr u32 element_count = 4'000'000;
+
+		std::vector<f32> values(element_count, 1.0F);
+
+		const sample_summary serial = suite.run("serial loop (4M floats)", [&values] {
+			for (auto& value: values)
+			{
+				value = value * 1.0001F + 0.5F;
+			}
+		});
+
+		const sample_summary parallel = suite.run("parallel_for (4M floats)", [&jobs, &values] {
+			jobs.parallel_for(element_count, 16'384, [&values](u32 begin, u32 end) {
+				for (u32 index = begin; index < end; ++index)
+				{
+					values[index] = values[index] * 1.0001F + 0.5F;
+				}
+			});
+		});
+
+		suite.print_operations(serial, element_count);
+		suite.print_operations(parallel, element_count);
+		std::printf("%-40s %12.2f x\n", "  speedup", serial.p50 / parallel.p50);
+	}
+} // namespace cc::bench
+
+int main(int argc, char** argv)
+{
+	cc::bench::suite suite("capricorn_jobs_bench", argc, argv);
+
+	cc::log::initialize();
+
+	{
+		const auto jobs = cc::job_system::create({});
+
+		suite.set_configuration("threads", std::to_string(jobs->get_thread_count()));
+
+		std::printf("Job system microbenchmarks, %u threads, median of %u runs\n", jobs->get_thread_count(), suite.get_repetitions());
+
+		cc::bench::spawn_throughput(suite, *jobs);
+		cc::bench::steal_throughput(suite, *jobs);
+		cc::bench::recursive_tree(suite, *jobs);
+		cc::bench::parallel_for_throughput(suite, *jobs);
+	}
+
+	cc::log::shutdown();
+
+	return suite.finish();
+}
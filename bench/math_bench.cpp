@@ -0,0 +1,238 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "bench_harness.hpp"
+
+#include "capricorn/base/log.hpp"
+#include "capricorn/jobs/job_system.hpp"
+#include "capricorn/math/culling.hpp"
+#include "capricorn/math/simd.hpp"
+#include "capricorn/math/transform_hierarchy.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <array>
+#include <cstdio>
+#include <vector>
+
+namespace cc::bench
+{
+	constexpr std::array<math::simd_level, 4> simd_levels = { math::simd_level::scalar, math::simd_level::sse4, math::simd_level::avx2, math::simd_level::avx512 };
+
+	// Cheap and deterministic, so every run sees the same scene.
+	struct xorshift
+	{
+		u32 state;
+
+		cc_nodiscard f32 next(f32 minimum, f32 maximum) noexcept
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return minimum + (maximum - minimum) * static_cast<f32>(state >> 8) / static_cast<f32>(1U << 24);
+		}
+	};
+
+	// What culling looks like written against glm directly: an array of objects, each tested plane by plane.
+	struct object_bounds
+	{
+		glm::vec3 center;
+		glm::vec3 extents;
+		f32 radius;
+	};
+
+	u32 cull_glm(const math::frustum& frustum, const std::vector<object_bounds>& objects, u32* p_visible, b8 boxes)
+	{
+		u32 visible = 0;
+
+		for (u32 index = 0; index < objects.size(); ++index)
+		{
+			const object_bounds& object = objects[index];
+			b8 inside                   = true;
+
+			for (const glm::vec4& plane: frustum.planes)
+			{
+				const glm::vec3 normal = glm::vec3(plane.x, plane.y, plane.z);
+				const f32 reach        = boxes ? glm::dot(glm::abs(normal), object.extents) : object.radius;
+
+				if (glm::dot(normal, object.center) + plane.w + reach < 0.0F)
+				{
+					inside = false;
+					break;
+				}
+			}
+
+			if (inside)
+			{
+				p_visible[visible++] = index;
+			}
+		}
+
+		return visible;
+	}
+
+	void culling(suite& suite, u32 count)
+	{
+		// Objects spread around a camera at the origin looking down -z with a 90 degree field of view.
+		const glm::mat4 projection  = glm::perspective(glm::radians(90.0F), 16.0F / 9.0F, 0.1F, 500.0F);
+		const glm::mat4 view        = glm::lookAt(glm::vec3(0.0F), glm::vec3(0.0F, 0.0F, -1.0F), glm::vec3(0.0F, 1.0F, 0.0F));
+		const math::frustum frustum = math::frustum::from_matrix(projection * view);
+
+		xorshift generator = { 0x9E3779B9U };
+
+		std::vector<object_bounds> objects(count);
+		math::bounds_array bounds;
+		bounds.reserve(count);
+
+		for (object_bounds& object: objects)
+		{
+			object.center  = glm::vec3(generator.next(-500.0F, 500.0F), generator.next(-100.0F, 100.0F), generator.next(-500.0F, 500.0F));
+			object.extents = glm::vec3(generator.next(0.5F, 4.0F), generator.next(0.5F, 4.0F), generator.next(0.5F, 4.0F));
+			object.radius  = glm::length(object.extents);
+
+			(void)bounds.add(object.center, object.extents);
+		}
+
+		std::vector<u32> visible(count);
+
+		for (const b8 boxes: { false, true })
+		{
+			u32 glm_visible = 0;
+
+			const sample_summary baseline = suite.run(boxes ? "cull boxes, glm" : "cull spheres, glm", [&] { glm_visible = cull_glm(frustum, objects, visible.data(), boxes); });
+			suite.print_speedup(baseline, count, baseline);
+
+			for (const math::simd_level level: simd_levels)
+			{
+				if (math::clamp_simd_level(level) != level)
+				{
+					continue;
+				}
+
+				u32 kernel_visible = 0;
+
+				char name[64];
+				std::snprintf(name, sizeof(name), "cull %s, %s", boxes ? "boxes" : "spheres", math::get_simd_level_name(level));
+
+				const sample_summary kernel = suite.run(name, [&] {
+					kernel_visible = boxes ? math::cull_boxes(frustum, bounds, visible.data(), level) : math::cull_spheres(frustum, bounds, visible.data(), level);
+				});
+				suite.print_speedup(kernel, count, baseline);
+
+				if (kernel_visible != glm_visible)
+				{
+					std::printf("%-40s %12u visible, glm found %u\n", "  mismatch", kernel_visible, glm_visible);
+				}
+			}
+
+			std::printf("%-40s %12u of %u\n", "  visible", glm_visible, count);
+		}
+	}
+
+	// A forest: every 8192 nodes are parented to random nodes of the 8192 before them, the odd one is a new root.
+	void build_hierarchy(math::transform_hierarchy& hierarchy, u32 count)
+	{
+		xorshift generator = { 0x85EBCA6BU };
+
+		std::vector<u32> previous_depth;
+		std::vector<u32> current_depth;
+
+		while (hierarchy.get_count() < count)
+		{
+			const glm::mat4 local = glm::rotate(glm::translate(glm::mat4(1.0F), glm::vec3(generator.next(-10.0F, 10.0F), generator.next(-10.0F, 10.0F), generator.next(-10.0F, 10.0F))), generator.next(0.0F, 6.28F), glm::vec3(0.0F, 1.0F, 0.0F));
+
+			if (previous_depth.empty() || generator.next(0.0F, 1.0F) < 0.05F)
+			{
+				current_depth.push_back(hierarchy.add(math::no_transform, local));
+			}
+			else
+			{
+				const auto pick = static_cast<std::size_t>(generator.next(0.0F, static_cast<f32>(previous_depth.size()) - 1.0F));
+				current_depth.push_back(hierarchy.add(previous_depth[pick], local));
+			}
+
+			if (current_depth.size() == 8192)
+			{
+				previous_depth.swap(current_depth);
+				current_depth.clear();
+			}
+		}
+	}
+
+	void transforms(suite& suite, u32 count, job_system& job_system)
+	{
+		const auto p_hierarchy = math::transform_hierarchy::create({ .capacity = count });
+		build_hierarchy(*p_hierarchy, count);
+		p_hierarchy->update();
+
+		// The same propagation written against glm directly, over the hierarchy's own depth order.
+		const u32* p_nodes = p_hierarchy->get_sorted_nodes();
+
+		std::vector<u32> positions(count);
+		std::vector<u32> parents(count);
+		std::vector<glm::mat4> locals(count);
+		std::vector<glm::mat4> worlds(count);
+
+		for (u32 position = 0; position < count; ++position)
+		{
+			positions[p_nodes[position]] = position;
+		}
+
+		for (u32 position = 0; position < count; ++position)
+		{
+			const u32 parent = p_hierarchy->get_parent(p_nodes[position]);
+
+			parents[position] = parent == math::no_transform ? math::no_transform : positions[parent];
+			locals[position]  = p_hierarchy->get_local(p_nodes[position]);
+		}
+
+		const sample_summary baseline = suite.run("propagate, glm", [&] {
+			for (u32 index = 0; index < count; ++index)
+			{
+				worlds[index] = parents[index] == math::no_transform ? locals[index] : worlds[parents[index]] * locals[index];
+			}
+		});
+		suite.print_speedup(baseline, count, baseline);
+
+		for (const math::simd_level level: simd_levels)
+		{
+			if (math::clamp_simd_level(level) != level)
+			{
+				continue;
+			}
+
+			char name[64];
+			std::snprintf(name, sizeof(name), "propagate, %s", math::get_simd_level_name(level));
+			suite.print_speedup(suite.run(name, [&] { math::propagate_transforms(parents.data(), locals.data(), worlds.data(), 0, count, level); }), count, baseline);
+		}
+
+		suite.print_speedup(suite.run("hierarchy update", [&p_hierarchy] { p_hierarchy->update(); }), count, baseline);
+		suite.print_speedup(suite.run("hierarchy update, job system", [&p_hierarchy, &job_system] { p_hierarchy->update(&job_system); }), count, baseline);
+
+		std::printf("%-40s %12u\n", "  depths", p_hierarchy->get_depth_count());
+	}
+} // namespace cc::bench
+
+int main(int argc, char** argv)
+{
+	using namespace cc;
+
+	bench::suite suite("capricorn_math_bench", argc, argv);
+	suite.set_configuration("simd", std::string("\"") + math::get_simd_level_name(math::get_simd_level()) + "\"");
+
+	log::initialize();
+
+	constexpr u32 bounds     = 1'000'000;
+	constexpr u32 transforms = 262'144;
+
+	std::printf("Math microbenchmarks, median of %u runs, widest kernels %s\n", suite.get_repetitions(), math::get_simd_level_name(math::get_simd_level()));
+
+	const auto p_job_system = job_system::create({});
+
+	bench::culling(suite, bounds);
+	bench::transforms(suite, transforms, *p_job_system);
+
+	log::shutdown();
+
+	return suite.finish();
+}
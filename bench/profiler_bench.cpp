@@ -0,0 +1,145 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "bench_harness.hpp"
+
+#include "capricorn/base/log.hpp"
+#include "capricorn/base/profiler.hpp"
+
+#include <cstdio>
+#include <filesystem>
+
+namespace cc::bench
+{
+	// Roughly the cost of a small system's update, so zones sit at the granularity an engine uses them at.
+	cc_nodiscard u32 work(u32 seed, u32 steps)
+	{
+		u32 state = seed;
+		for (u32 step = 0; step < steps; ++step)
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+		}
+
+		return state;
+	}
+
+	void empty_zones(u32 frames, u32 zones_per_frame)
+	{
+		for (u32 frame = 0; frame < frames; ++frame)
+		{
+			for (u32 zone = 0; zone < zones_per_frame; ++zone)
+			{
+				cc_profile_zone("empty");
+			}
+
+			profiler::end_frame();
+		}
+	}
+
+	// Every zone is entered, left and aggregated by end_frame().
+	void zone_cost(suite& suite)
+	{
+		constexpr u32 frames          = 100;
+		constexpr u32 zones_per_frame = 10'000;
+
+		profiler::initialize({ .ring_size = zones_per_frame });
+
+		const sample_summary active = suite.run("empty zone, recording", [] {
+			empty_zones(frames, zones_per_frame);
+		});
+
+		const profiler_statistics statistics = profiler::get_statistics();
+		profiler::shutdown();
+
+		const sample_summary inactive = suite.run("empty zone, not initialized", [] {
+			empty_zones(frames, zones_per_frame);
+		});
+
+		suite.print_operations(active, static_cast<u64>(frames) * zones_per_frame);
+		suite.print_operations(inactive, static_cast<u64>(frames) * zones_per_frame);
+		std::printf("%-40s %12llu\n", "  dropped", static_cast<unsigned long long>(statistics.dropped));
+	}
+
+	// A frame of 250 zones around ~20 us of work each, about 5 ms. Runs alternate between the profiler off and on, so drift affects both.
+	void frame_overhead(suite& suite)
+	{
+		constexpr u32 frames          = 20;
+		constexpr u32 zones_per_frame = 250;
+		constexpr u32 steps           = 20'000;
+
+		u32 sink = 0;
+
+		const auto run = [&sink] {
+			for (u32 frame = 0; frame < frames; ++frame)
+			{
+				cc_profile_zone("frame body");
+
+				for (u32 zone = 0; zone < zones_per_frame; ++zone)
+				{
+					cc_profile_zone("system");
+					sink += work(zone + 1, steps);
+				}
+
+				profiler::end_frame();
+			}
+		};
+
+		sample_set baseline("frame, profiler off");
+		sample_set recording("frame, recording");
+		sample_set capturing("frame, capturing");
+		sample_set trace_export("trace export");
+
+		const std::filesystem::path trace_path = std::filesystem::temp_directory_path() / "capricorn_profiler_bench.json";
+
+		for (u32 repetition = 0; repetition < suite.get_repetitions(); ++repetition)
+		{
+			baseline.add(measure_milliseconds(run));
+
+			profiler::initialize({});
+			recording.add(measure_milliseconds(run));
+
+			profiler::begin_capture();
+			capturing.add(measure_milliseconds(run));
+
+			trace_export.add(measure_milliseconds([&trace_path] { profiler::end_capture(trace_path); }));
+
+			profiler::shutdown();
+		}
+
+		std::filesystem::remove(trace_path);
+
+		const sample_summary baseline_summary  = suite.add(baseline);
+		const sample_summary recording_summary = suite.add(recording);
+		const sample_summary capturing_summary = suite.add(capturing);
+		const sample_summary export_summary    = suite.add(trace_export);
+
+		const u64 zones = static_cast<u64>(frames) * (zones_per_frame + 1);
+
+		suite.print_operations(baseline_summary, zones);
+		suite.print_operations(recording_summary, zones);
+		suite.print_operations(capturing_summary, zones);
+		std::printf("%-40s %12.3f %%\n", "  recording overhead", (recording_summary.p50 / baseline_summary.p50 - 1.0) * 100.0);
+		std::printf("%-40s %12.3f %%\n", "  capturing overhead", (capturing_summary.p50 / baseline_summary.p50 - 1.0) * 100.0);
+		suite.print_operations(export_summary, zones);
+		std::printf("%-40s %12u\n", "  sink", sink);
+	}
+} // namespace cc::bench
+
+int main(int argc, char** argv)
+{
+	cc::bench::suite suite("capricorn_profiler_bench", argc, argv);
+	suite.set_configuration("zones", cc::profiler_enabled ? "true" : "false");
+
+	cc::log::initialize();
+
+	std::printf("Profiler microbenchmarks, median of %u runs, zones %s\n", suite.get_repetitions(), cc::profiler_enabled ? "compiled in" : "compiled out");
+
+	cc::bench::zone_cost(suite);
+	cc::bench::frame_overhead(suite);
+
+	cc::log::shutdown();
+
+	return suite.finish();
+}
@@ -0,0 +1,434 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/graphics_context.hpp"
+#include "capricorn/graphics/vulkan/command_recorder.hpp"
+#include "capricorn/graphics/vulkan/memory_allocator.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace cc::bench
+{
+	using clock = std::chrono::steady_clock;
+
+	constexpr VkFormat color_format = VK_FORMAT_R8G8B8A8_UNORM;
+	constexpr VkExtent2D extent     = { 256, 256 };
+
+	// gl_Position = vec4(0.0), hand-assembled so the benchmark needs no shader compiler.
+	constexpr std::array<u32, 55> vertex_shader = {
+	        0x07230203, 0x00010000, 0x00000000, 10, 0,
+	        (2 << 16) | 17, 1,                                // OpCapability Shader
+	        (3 << 16) | 14, 0, 1,                             // OpMemoryModel Logical GLSL450
+	        (6 << 16) | 15, 0, 8, 0x6E69616D, 0x00000000, 6, // OpEntryPoint Vertex %8 "main" %6
+	        (4 << 16) | 71, 6, 11, 0,                         // OpDecorate %6 BuiltIn Position
+	        (2 << 16) | 19, 1,                                // %1 = OpTypeVoid
+	        (3 << 16) | 33, 2, 1,                             // %2 = OpTypeFunction %1
+	        (3 << 16) | 22, 3, 32,                            // %3 = OpTypeFloat 32
+	        (4 << 16) | 23, 4, 3, 4,                          // %4 = OpTypeVector %3 4
+	        (4 << 16) | 32, 5, 3, 4,                          // %5 = OpTypePointer Output %4
+	        (4 << 16) | 59, 5, 6, 3,                          // %6 = OpVariable %5 Output
+	        (3 << 16) | 46, 4, 7,                             // %7 = OpConstantNull %4
+	        (5 << 16) | 54, 1, 8, 0, 2,                       // %8 = OpFunction %1 None %2
+	        (2 << 16) | 248, 9,                               // %9 = OpLabel
+	        (3 << 16) | 62, 6, 7,                             // OpStore %6 %7
+	        (1 << 16) | 253,                                  // OpReturn
+	        (1 << 16) | 56,                                   // OpFunctionEnd
+	};
+
+	// An empty fragment shader.
+	constexpr std::array<u32, 32> fragment_shader = {
+	        0x07230203, 0x00010000, 0x00000000, 5, 0,
+	        (2 << 16) | 17, 1,                             // OpCapability Shader
+	        (3 << 16) | 14, 0, 1,                          // OpMemoryModel Logical GLSL450
+	        (5 << 16) | 15, 4, 3, 0x6E69616D, 0x00000000, // OpEntryPoint Fragment %3 "main"
+	        (3 << 16) | 16, 3, 7,                          // OpExecutionMode %3 OriginUpperLeft
+	        (2 << 16) | 19, 1,                             // %1 = OpTypeVoid
+	        (3 << 16) | 33, 2, 1,                          // %2 = OpTypeFunction %1
+	        (5 << 16) | 54, 1, 3, 0, 2,                    // %3 = OpFunction %1 None %2
+	        (2 << 16) | 248, 4,                            // %4 = OpLabel
+	        (1 << 16) | 253,                               // OpReturn
+	        (1 << 16) | 56,                                // OpFunctionEnd
+	};
+
+	struct options
+	{
+		u32 draws      = 100'000;
+		u32 batch_size = 512; // Draws per secondary command buffer.
+		u32 frames     = 60;
+		u32 warmup     = 10;
+	};
+
+	// A render pass, target and pipeline that draws cost what they cost in a real frame.
+	class draw_target
+	{
+	public:
+		explicit draw_target(const std::shared_ptr<vk::logical_device>& p_device)
+		    : m_device(p_device)
+		{
+			const VkDevice device                               = *m_device;
+			const vk::device_dispatch& dispatch                 = m_device->get_dispatch();
+			const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+
+			VkAttachmentDescription attachment = {};
+			attachment.format                  = color_format;
+			attachment.samples                 = VK_SAMPLE_COUNT_1_BIT;
+			attachment.loadOp                  = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachment.storeOp                 = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.stencilLoadOp           = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp          = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachment.finalLayout             = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+			VkAttachmentReference const color_reference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+			VkSubpassDescription subpass = {};
+			subpass.pipelineBindPoint    = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpass.colorAttachmentCount = 1;
+			subpass.pColorAttachments    = &color_reference;
+
+			VkRenderPassCreateInfo render_pass_create_info = {};
+			render_pass_create_info.sType                  = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+			render_pass_create_info.attachmentCount        = 1;
+			render_pass_create_info.pAttachments           = &attachment;
+			render_pass_create_info.subpassCount           = 1;
+			render_pass_create_info.pSubpasses             = &subpass;
+
+			vk::vk_ensure(dispatch.vkCreateRenderPass(device, &render_pass_create_info, p_allocation_callbacks, &m_render_pass), "Failed to create benchmark render pass!");
+
+			VkImageCreateInfo image_create_info = {};
+			image_create_info.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			image_create_info.imageType         = VK_IMAGE_TYPE_2D;
+			image_create_info.format            = color_format;
+			image_create_info.extent            = { extent.width, extent.height, 1 };
+			image_create_info.mipLevels         = 1;
+			image_create_info.arrayLayers       = 1;
+			image_create_info.samples           = VK_SAMPLE_COUNT_1_BIT;
+			image_create_info.tiling            = VK_IMAGE_TILING_OPTIMAL;
+			image_create_info.usage             = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			image_create_info.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+			image_create_info.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			m_image = m_device->get_memory_allocator().lock()->create_image({
+			        .image    = image_create_info,
+			        .category = vk::allocation_category::render_target,
+			        .p_name   = "recording benchmark target",
+			});
+
+			VkImageViewCreateInfo view_create_info = {};
+			view_create_info.sType                 = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			view_create_info.image                 = m_image->get_handle();
+			view_create_info.viewType              = VK_IMAGE_VIEW_TYPE_2D;
+			view_create_info.format                = color_format;
+			view_create_info.subresourceRange      = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+			vk::vk_ensure(dispatch.vkCreateImageView(device, &view_create_info, p_allocation_callbacks, &m_view), "Failed to create benchmark image view!");
+
+			VkFramebufferCreateInfo framebuffer_create_info = {};
+			framebuffer_create_info.sType                   = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebuffer_create_info.renderPass              = m_render_pass;
+			framebuffer_create_info.attachmentCount         = 1;
+			framebuffer_create_info.pAttachments            = &m_view;
+			framebuffer_create_info.width                   = extent.width;
+			framebuffer_create_info.height                  = extent.height;
+			framebuffer_create_info.layers                  = 1;
+
+			vk::vk_ensure(dispatch.vkCreateFramebuffer(device, &framebuffer_create_info, p_allocation_callbacks, &m_framebuffer), "Failed to create benchmark framebuffer!");
+
+			create_pipeline();
+		}
+
+		~draw_target()
+		{
+			const VkDevice device                               = *m_device;
+			const vk::device_dispatch& dispatch                 = m_device->get_dispatch();
+			const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+
+			dispatch.vkDeviceWaitIdle(device);
+			dispatch.vkDestroyPipeline(device, m_pipeline, p_allocation_callbacks);
+			dispatch.vkDestroyPipelineLayout(device, m_pipeline_layout, p_allocation_callbacks);
+			dispatch.vkDestroyFramebuffer(device, m_framebuffer, p_allocation_callbacks);
+			dispatch.vkDestroyImageView(device, m_view, p_allocation_callbacks);
+			dispatch.vkDestroyRenderPass(device, m_render_pass, p_allocation_callbacks);
+		}
+
+		draw_target(const draw_target& other)                = delete;
+		draw_target(draw_target&& other) noexcept            = delete;
+		draw_target& operator=(const draw_target& other)     = delete;
+		draw_target& operator=(draw_target&& other) noexcept = delete;
+
+		void begin(VkCommandBuffer command_buffer) const
+		{
+			VkClearValue const clear = { .color = { { 0.0F, 0.0F, 0.0F, 1.0F } } };
+
+			VkRenderPassBeginInfo begin_info = {};
+			begin_info.sType                 = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			begin_info.renderPass            = m_render_pass;
+			begin_info.framebuffer           = m_framebuffer;
+			begin_info.renderArea            = { { 0, 0 }, extent };
+			begin_info.clearValueCount       = 1;
+			begin_info.pClearValues          = &clear;
+
+			m_device->get_dispatch().vkCmdBeginRenderPass(command_buffer, &begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		}
+
+		// One object's worth of state and a draw, the way a scene would issue it.
+		void draw(VkCommandBuffer command_buffer, u32 index) const
+		{
+			const f32 offset = static_cast<f32>(index % 1024) / 1024.0F;
+
+			const std::array<f32, 16> transform = {
+			        1.0F, 0.0F, 0.0F, 0.0F,
+			        0.0F, 1.0F, 0.0F, 0.0F,
+			        0.0F, 0.0F, 1.0F, 0.0F,
+			        offset, -offset, 0.5F, 1.0F,
+			};
+
+			m_device->get_dispatch().vkCmdPushConstants(command_buffer, m_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(transform), transform.data());
+			m_device->get_dispatch().vkCmdDraw(command_buffer, 3, 1, 0, index);
+		}
+
+		cc_nodiscard VkCommandBufferInheritanceInfo get_inheritance() const
+		{
+			VkCommandBufferInheritanceInfo inheritance = {};
+			inheritance.sType                          = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+			inheritance.renderPass                     = m_render_pass;
+			inheritance.subpass                        = 0;
+			inheritance.framebuffer                    = m_framebuffer;
+
+			return inheritance;
+		}
+
+		cc_nodiscard VkPipeline get_pipeline() const noexcept
+		{
+			return m_pipeline;
+		}
+
+	private:
+		void create_pipeline()
+		{
+			const VkDevice device                               = *m_device;
+			const vk::device_dispatch& dispatch                 = m_device->get_dispatch();
+			const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+
+			const auto create_module = [device, &dispatch, p_allocation_callbacks](std::span<const u32> code) {
+				VkShaderModuleCreateInfo create_info = {};
+				create_info.sType                    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+				create_info.codeSize                 = code.size_bytes();
+				create_info.pCode                    = code.data();
+
+				VkShaderModule module = VK_NULL_HANDLE;
+				vk::vk_ensure(dispatch.vkCreateShaderModule(device, &create_info, p_allocation_callbacks, &module), "Failed to create benchmark shader module!");
+				return module;
+			};
+
+			const VkShaderModule vertex   = create_module(vertex_shader);
+			const VkShaderModule fragment = create_module(fragment_shader);
+
+			std::array<VkPipelineShaderStageCreateInfo, 2> stages = {};
+			stages[0].sType                                       = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			stages[0].stage                                       = VK_SHADER_STAGE_VERTEX_BIT;
+			stages[0].module                                      = vertex;
+			stages[0].pName                                       = "main";
+			stages[1].sType                                       = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			stages[1].stage                                       = VK_SHADER_STAGE_FRAGMENT_BIT;
+			stages[1].module                                      = fragment;
+			stages[1].pName                                       = "main";
+
+			VkPushConstantRange const push_constants = { VK_SHADER_STAGE_VERTEX_BIT, 0, 64 };
+
+			VkPipelineLayoutCreateInfo layout_create_info = {};
+			layout_create_info.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+			layout_create_info.pushConstantRangeCount     = 1;
+			layout_create_info.pPushConstantRanges        = &push_constants;
+
+			vk::vk_ensure(dispatch.vkCreatePipelineLayout(device, &layout_create_info, p_allocation_callbacks, &m_pipeline_layout), "Failed to create benchmark pipeline layout!");
+
+			VkPipelineVertexInputStateCreateInfo vertex_input = {};
+			vertex_input.sType                                = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+			VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+			input_assembly.sType                                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+			input_assembly.topology                               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+			VkViewport const viewport = { 0.0F, 0.0F, static_cast<f32>(extent.width), static_cast<f32>(extent.height), 0.0F, 1.0F };
+			VkRect2D const scissor    = { { 0, 0 }, extent };
+
+			VkPipelineViewportStateCreateInfo viewport_state = {};
+			viewport_state.sType                             = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+			viewport_state.viewportCount                     = 1;
+			viewport_state.pViewports                        = &viewport;
+			viewport_state.scissorCount                      = 1;
+			viewport_state.pScissors                         = &scissor;
+
+			VkPipelineRasterizationStateCreateInfo rasterization = {};
+			rasterization.sType                                  = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+			rasterization.polygonMode                            = VK_POLYGON_MODE_FILL;
+			rasterization.cullMode                               = VK_CULL_MODE_NONE;
+			rasterization.frontFace                              = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+			rasterization.lineWidth                              = 1.0F;
+
+			VkPipelineMultisampleStateCreateInfo multisample = {};
+			multisample.sType                                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+			multisample.rasterizationSamples                 = VK_SAMPLE_COUNT_1_BIT;
+
+			VkPipelineColorBlendAttachmentState blend_attachment = {};
+			blend_attachment.colorWriteMask                      = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+			VkPipelineColorBlendStateCreateInfo blend = {};
+			blend.sType                               = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+			blend.attachmentCount                     = 1;
+			blend.pAttachments                        = &blend_attachment;
+
+			VkGraphicsPipelineCreateInfo pipeline_create_info = {};
+			pipeline_create_info.sType                        = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+			pipeline_create_info.stageCount                   = static_cast<u32>(stages.size());
+			pipeline_create_info.pStages                      = stages.data();
+			pipeline_create_info.pVertexInputState            = &vertex_input;
+			pipeline_create_info.pInputAssemblyState          = &input_assembly;
+			pipeline_create_info.pViewportState               = &viewport_state;
+			pipeline_create_info.pRasterizationState          = &rasterization;
+			pipeline_create_info.pMultisampleState            = &multisample;
+			pipeline_create_info.pColorBlendState             = &blend;
+			pipeline_create_info.layout                       = m_pipeline_layout;
+			pipeline_create_info.renderPass                   = m_render_pass;
+
+			vk::vk_ensure(dispatch.vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, p_allocation_callbacks, &m_pipeline), "Failed to create benchmark pipeline!");
+
+			dispatch.vkDestroyShaderModule(device, vertex, p_allocation_callbacks);
+			dispatch.vkDestroyShaderModule(device, fragment, p_allocation_callbacks);
+		}
+
+		std::shared_ptr<vk::logical_device> m_device;
+		std::shared_ptr<vk::gpu_image> m_image;
+		VkImageView m_view                 = VK_NULL_HANDLE;
+		VkRenderPass m_render_pass         = VK_NULL_HANDLE;
+		VkFramebuffer m_framebuffer        = VK_NULL_HANDLE;
+		VkPipelineLayout m_pipeline_layout = VK_NULL_HANDLE;
+		VkPipeline m_pipeline              = VK_NULL_HANDLE;
+	};
+
+	// Median CPU time from the first recorded command to the last secondary executed into the frame.
+	f64 measure(graphics_context& context, const draw_target& target, u32 thread_count, const options& options)
+	{
+		// The job system counts the creating thread, a single thread runs the batches on it without workers.
+		const auto jobs     = job_system::create({ .worker_count = std::max(thread_count, 2U) - 1 });
+		const auto recorder = vk::command_recorder::create({
+		        .p_device     = context.get_logical_device(),
+		        .p_job_system = jobs,
+		});
+
+		const auto p_device                              = context.get_logical_device().lock();
+		const vk::device_dispatch& dispatch              = p_device->get_dispatch();
+		const VkCommandBufferInheritanceInfo inheritance = target.get_inheritance();
+
+		const auto record_batch = [&target, &dispatch](VkCommandBuffer command_buffer, u32 begin, u32 end) {
+			dispatch.vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, target.get_pipeline());
+
+			for (u32 index = begin; index < end; index++)
+			{
+				target.draw(command_buffer, index);
+			}
+		};
+
+		std::vector<f64> samples;
+
+		for (u32 frame_index = 0; frame_index < options.warmup + options.frames; frame_index++)
+		{
+			const std::optional<graphics_frame> frame = context.begin_frame();
+			ensure(frame.has_value(), "Benchmark frame was skipped!");
+
+			recorder->begin_frame(frame->frame_index);
+
+			const clock::time_point start = clock::now();
+
+			target.begin(frame->command_buffer);
+
+			if (thread_count == 1)
+			{
+				const u32 first_order = recorder->reserve_orders((options.draws + options.batch_size - 1) / options.batch_size);
+
+				for (u32 begin = 0; begin < options.draws; begin += options.batch_size)
+				{
+					const VkCommandBuffer command_buffer = recorder->begin(inheritance);
+					record_batch(command_buffer, begin, std::min(begin + options.batch_size, options.draws));
+					recorder->submit(command_buffer, first_order + begin / options.batch_size);
+				}
+			}
+			else
+			{
+				recorder->record(options.draws, options.batch_size, inheritance, record_batch);
+			}
+
+			recorder->execute(frame->command_buffer);
+			dispatch.vkCmdEndRenderPass(frame->command_buffer);
+
+			const f64 seconds = std::chrono::duration<f64>(clock::now() - start).count();
+
+			context.end_frame(*frame);
+
+			if (frame_index >= options.warmup)
+			{
+				samples.push_back(seconds);
+			}
+		}
+
+		std::sort(samples.begin(), samples.end());
+		return samples[samples.size() / 2];
+	}
+} // namespace cc::bench
+
+int main(int argc, char** argv)
+{
+	cc::bench::options options;
+
+	for (int index = 1; index < argc; ++index)
+	{
+		const std::string argument = argv[index];
+		const b8 has_value         = index + 1 < argc;
+
+		if (argument == "--draws" && has_value)
+			options.draws = static_cast<u32>(std::stoul(argv[++index]));
+		else if (argument == "--batch" && has_value)
+			options.batch_size = std::max(1U, static_cast<u32>(std::stoul(argv[++index])));
+		else if (argument == "--frames" && has_value)
+			options.frames = std::max(1U, static_cast<u32>(std::stoul(argv[++index])));
+	}
+
+	cc::log::initialize();
+
+	{
+		const auto context = cc::graphics_context::create({ .headless = true });
+		context->initialize({});
+
+		const cc::bench::draw_target target(context->get_logical_device().lock());
+
+		const u32 hardware_threads = std::max(std::thread::hardware_concurrency(), 1U);
+
+		std::vector<u32> thread_counts;
+		for (u32 thread_count = 1; thread_count < hardware_threads; thread_count *= 2)
+		{
+			thread_counts.push_back(thread_count);
+		}
+		thread_counts.push_back(hardware_threads);
+
+		std::printf("Recording %u draws per frame in secondaries of %u, median of %u frames\n", options.draws, options.batch_size, options.frames);
+		std::printf("%8s %12s %16s %10s\n", "threads", "ms/frame", "draws/s", "speedup");
+
+		f64 baseline = 0.0;
+
+		for (const u32 thread_count: thread_counts)
+		{
+			const f64 seconds = cc::bench::measure(*context, target, thread_count, options);
+			baseline          = baseline == 0.0 ? seconds : baseline;
+
+			std::printf("%8u %12.3f %16.0f %9.2fx\n", thread_count, seconds * 1000.0, static_cast<f64>(options.draws) / seconds, baseline / seconds);
+		}
+	}
+
+	cc::log::shutdown();
+
+	return 0;
+}
@@ -0,0 +1,221 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "bench_harness.hpp"
+
+#include "capricorn/base/application.hpp"
+#include "capricorn/base/hash.hpp"
+#include "capricorn/graphics/texture/block_compression.hpp"
+
+#include <cstdio>
+
+namespace cc::bench
+{
+	constexpr const char* p_texture = "assets/textures/texture.png";
+	constexpr const char* p_pack    = "assets.ccpack";
+
+	std::vector<u8> read_file(const char* p_path)
+	{
+		std::ifstream file(p_path, std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			std::fprintf(stderr, "Failed to open %s, run from the directory the assets were copied to.\n", p_path);
+			std::exit(2);
+		}
+
+		std::vector<u8> contents(static_cast<std::size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+
+		return contents;
+	}
+
+	// Each stage on its own, on one thread. Throughput is in bytes produced: texels for decode and mips, blocks for transcoding.
+	void cpu_stages(suite& suite, const std::vector<u8>& file)
+	{
+		texture_data decoded;
+		const sample_summary decode = suite.run("png decode", [&file, &decoded] { decoded = *decode_png(file); });
+
+		texture_data chain;
+		const sample_summary mips = suite.run("mip chain (sRGB box filter)", [&decoded, &chain] {
+			chain = decoded;
+			generate_mips(chain, true);
+		});
+
+		texture_data bc1;
+		const sample_summary bc1_summary = suite.run("bc1 transcode", [&chain, &bc1] { bc1 = compress_texture(chain, texture_encoding::bc1); });
+
+		texture_data bc7;
+		const sample_summary bc7_summary = suite.run("bc7 transcode (mode 6)", [&chain, &bc7] { bc7 = compress_texture(chain, texture_encoding::bc7); });
+
+		suite.print_bytes(decode, decoded.bytes.size());
+		suite.print_bytes(mips, chain.bytes.size() - decoded.bytes.size());
+		suite.print_bytes(bc1_summary, bc1.bytes.size());
+		suite.print_bytes(bc7_summary, bc7.bytes.size());
+	}
+
+	// The worker half of a load, for many textures at once.
+	void parallel_loads(suite& suite, job_system& jobs, const std::vector<u8>& file, u32 texture_count)
+	{
+		std::vector<texture_data> textures(texture_count);
+
+		const sample_summary summary = suite.run("parallel decode + mips, texels", [&jobs, &file, &textures] {
+			jobs.parallel_for(static_cast<u32>(textures.size()), 1, [&file, &textures](u32 begin, u32 end) {
+				for (u32 index = begin; index < end; index++)
+				{
+					textures[index] = *decode_png(file);
+					generate_mips(textures[index], true);
+				}
+			});
+		});
+
+		const u64 decoded = textures.front().levels.front().size * texture_count;
+
+		std::printf("%-40s %12u textures on %u threads\n", "parallel decode + mips", texture_count, jobs.get_thread_count());
+		suite.print_bytes(summary, decoded);
+	}
+
+	// What a load costs from the pack instead: lookup, decompression if the entry needs it, and the layout. Uncompressed
+	// entries are then read from the mapping once, as the upload would, so the page faults are part of the measurement.
+	void packed_loads(suite& suite, job_system& jobs, u32 texture_count)
+	{
+		if (!std::filesystem::exists(p_pack))
+		{
+			std::printf("%-40s skipped, %s not found\n", "packed loads", p_pack);
+			return;
+		}
+
+		std::shared_ptr<asset_pack> p_assets;
+		const f64 open_milliseconds = measure_milliseconds([&p_assets] { p_assets = asset_pack::create({ .path = p_pack }); });
+
+		const std::optional<asset_entry> entry = p_assets->find("textures/texture.png");
+		if (!entry.has_value())
+		{
+			std::printf("%-40s skipped, %s holds no textures/texture.png\n", "packed loads", p_pack);
+			return;
+		}
+
+		std::vector<texture_data> textures(texture_count);
+		std::vector<u64> checksums(texture_count);
+
+		const sample_summary summary = suite.run("packed loads, texels ready for upload", [&jobs, &p_assets, &entry, &textures, &checksums] {
+			jobs.parallel_for(static_cast<u32>(textures.size()), 1, [&p_assets, &entry, &textures, &checksums](u32 begin, u32 end) {
+				for (u32 index = begin; index < end; index++)
+				{
+					texture_data& texture       = textures[index];
+					std::span<const u8> payload = entry->stored;
+
+					if (entry->is_compressed())
+					{
+						texture.bytes.resize(entry->size);
+						ensure(p_assets->read(*entry, texture.bytes), "Failed to decompress the packed texture!");
+						payload = texture.bytes;
+					}
+
+					b8 srgb = false;
+					ensure(parse_texture(payload, texture, srgb), "Packed texture is corrupt!");
+
+					checksums[index] = fnv1a(payload.data(), payload.size());
+				}
+			});
+		});
+
+		std::printf("%-40s %12.3f ms to map %s (%s)\n", "packed loads", open_milliseconds, p_pack, entry->is_compressed() ? "compressed" : "in place");
+		suite.print_bytes(summary, entry->size * texture_count);
+	}
+
+	// Loads copies of the texture through the running engine and keeps them wanted at full size until they are resident.
+	// A single run, so every figure goes into the report as one sample.
+	void streaming(suite& suite, u32 texture_count, u32 max_frames)
+	{
+		application_create_info create_info = {
+		        .headless   = true,
+		        .max_frames = max_frames,
+		};
+
+		application application(create_info);
+		application.initialize();
+
+		const std::weak_ptr<texture_streamer> p_textures = application.get_texture_streamer();
+
+		const clock::time_point start = clock::now();
+		f64 resident_seconds          = 0.0;
+		texture_streaming_statistics statistics;
+
+		std::vector<texture_handle> handles;
+		for (u32 index = 0; index < texture_count; index++)
+		{
+			handles.push_back(p_textures.lock()->load(p_texture));
+		}
+
+		application.set_update_callback([&](f64, f64) {
+			const auto p_streamer = p_textures.lock();
+
+			b8 resident = true;
+			for (const texture_handle handle: handles)
+			{
+				p_streamer->request(handle, 4096.0F);
+				resident = resident && p_streamer->is_resident(handle) && p_streamer->get_resident_mip(handle) == 0;
+			}
+
+			if (resident && resident_seconds == 0.0)
+			{
+				resident_seconds = std::chrono::duration<f64>(clock::now() - start).count();
+				statistics       = p_streamer->get_statistics();
+			}
+		});
+
+		application.execute();
+
+		if (resident_seconds == 0.0)
+		{
+			std::printf("%-40s not resident after %u frames\n", "streaming", max_frames);
+		}
+		else
+		{
+			const auto add_once = [&suite](const char* p_name, f64 seconds) {
+				sample_set samples(p_name);
+				samples.add(seconds * 1000.0);
+				return suite.add(samples);
+			};
+
+			add_once("streaming, resident", resident_seconds);
+
+			std::printf("%-40s %12u textures resident after %.3f ms\n", "streaming", texture_count, resident_seconds * 1000.0);
+			suite.print_bytes(add_once("streaming, decode (per worker)", statistics.decode_seconds), statistics.decoded_bytes);
+			suite.print_bytes(add_once("streaming, mips (per worker)", statistics.mip_seconds), statistics.mip_bytes);
+			suite.print_bytes(add_once("streaming, upload", statistics.upload_seconds), statistics.uploaded_bytes);
+		}
+
+		application.shutdown();
+	}
+} // namespace cc::bench
+
+int main(int argc, char** argv)
+{
+	cc::bench::suite suite("capricorn_texture_bench", argc, argv, { "--cpu-only" });
+
+	const std::vector<u8> file = cc::bench::read_file(cc::bench::p_texture);
+
+	cc::log::initialize();
+
+	{
+		const auto jobs = cc::job_system::create({});
+
+		std::printf("Texture pipeline benchmarks on %s, median of %u runs\n", cc::bench::p_texture, suite.get_repetitions());
+
+		cc::bench::cpu_stages(suite, file);
+		cc::bench::parallel_loads(suite, *jobs, file, 64);
+		cc::bench::packed_loads(suite, *jobs, 64);
+	}
+
+	cc::log::shutdown();
+
+	// Owns its log and job system.
+	if (!suite.has_flag("--cpu-only"))
+	{
+		cc::bench::streaming(suite, 64, 600);
+	}
+
+	return suite.finish();
+}
@@ -0,0 +1,25 @@
+# Wraps the SPIR-V words glslc writes with -mfmt=num into a header, so shaders are compiled into the engine.
+#
+# cmake -DINPUT=<words> -DOUTPUT=<header> -DNAME=<symbol> -DSOURCE=<shader> -P embed_spirv.cmake
+
+file(READ ${INPUT} CAPRICORN_SPIRV_WORDS)
+string(STRIP "${CAPRICORN_SPIRV_WORDS}" CAPRICORN_SPIRV_WORDS)
+string(TOUPPER ${NAME} CAPRICORN_SPIRV_GUARD)
+
+file(WRITE ${OUTPUT}
+        "// Generated from ${SOURCE} at build time, do not edit.\n"
+        "\n"
+        "#ifndef CAPRICORN_${CAPRICORN_SPIRV_GUARD}_HPP\n"
+        "#define CAPRICORN_${CAPRICORN_SPIRV_GUARD}_HPP\n"
+        "\n"
+        "#include <array>\n"
+        "#include <cstdint>\n"
+        "\n"
+        "namespace cc::shaders\n"
+        "{\n"
+        "\tinline constexpr auto ${NAME} = std::to_array<std::uint32_t>({\n"
+        "${CAPRICORN_SPIRV_WORDS}\n"
+        "\t});\n"
+        "} // namespace cc::shaders\n"
+        "\n"
+        "#endif //CAPRICORN_${CAPRICORN_SPIRV_GUARD}_HPP\n")
@@ -0,0 +1,90 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_ASSET_PACK_HPP
+#define CAPRICORN_ASSET_PACK_HPP
+
+#include "capricorn/assets/asset_pack_format.hpp"
+#include "capricorn/base/types.hpp"
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace cc
+{
+	struct asset_pack_create_info
+	{
+		std::filesystem::path path = "assets.ccpack";
+		b8 verify_checksum         = true; // Reads the whole table once at open.
+	};
+
+	struct asset_entry
+	{
+		std::string_view name;
+		asset_pack_format::entry_kind kind         = asset_pack_format::entry_kind::raw;
+		asset_pack_format::compression compression = asset_pack_format::compression::none;
+		std::span<const u8> stored; // Points into the mapping, valid for as long as the pack is.
+		u64 size = 0;               // After decompression.
+
+		cc_nodiscard b8 is_compressed() const noexcept { return compression != asset_pack_format::compression::none; }
+	};
+
+	/**
+	 * @brief Read-only view of a pack baked by capricorn_bake, mapped into memory as a whole.
+	 *
+	 * @details Opening a pack maps the file and validates its header and tables, nothing is read
+	 * beyond that until an entry is touched. find() hashes the name and probes the slot table, so
+	 * lookups do not depend on the number of entries. Entries stored uncompressed are used in
+	 * place; their pages are faulted in by whoever reads them and can be dropped again by the OS.
+	 *
+	 * Any thread may call the const members concurrently.
+	 */
+	class asset_pack
+	{
+	public:
+		asset_pack() = default;
+		~asset_pack();
+
+		explicit asset_pack(const asset_pack_create_info& create_info);
+
+		asset_pack(const asset_pack& other)                = delete;
+		asset_pack(asset_pack&& other) noexcept            = delete;
+		asset_pack& operator=(const asset_pack& other)     = delete;
+		asset_pack& operator=(asset_pack&& other) noexcept = delete;
+
+		static std::shared_ptr<asset_pack> create(const asset_pack_create_info& create_info);
+
+		cc_nodiscard std::optional<asset_entry> find(std::string_view name) const;
+
+		// Decompresses, or copies for uncompressed entries, into destination, which has to hold entry.size bytes.
+		cc_nodiscard b8 read(const asset_entry& entry, std::span<u8> destination) const;
+
+		cc_nodiscard u32 get_entry_count() const noexcept;
+		cc_nodiscard u64 get_size() const noexcept;
+		cc_nodiscard const std::filesystem::path& get_path() const noexcept;
+
+	private:
+		void map(const std::filesystem::path& path);
+		void unmap() noexcept;
+		void validate(b8 verify_checksum);
+
+		cc_nodiscard asset_entry get_entry(u32 index) const;
+
+		asset_pack_create_info m_create_info;
+
+		const u8* m_p_data = nullptr;
+		u64 m_size         = 0;
+		void* m_file       = nullptr; // HANDLE on Windows, unused elsewhere.
+		void* m_mapping    = nullptr; // HANDLE on Windows, unused elsewhere.
+
+		const asset_pack_format::file_header* m_p_header = nullptr;
+		std::span<const asset_pack_format::entry> m_entries;
+		std::span<const u32> m_slots;
+		std::string_view m_names;
+	};
+} // namespace cc
+
+#endif //CAPRICORN_ASSET_PACK_HPP
@@ -0,0 +1,95 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_ASSET_PACK_FORMAT_HPP
+#define CAPRICORN_ASSET_PACK_FORMAT_HPP
+
+#include <array>
+#include <cstdint>
+
+/**
+ * On-disk layout of an asset pack, shared by the engine and capricorn_bake.
+ *
+ * A pack starts with a file_header, followed by the payloads, each starting at a multiple of
+ * payload_alignment. After the payloads come the entry table, the slot table and the names.
+ * Entries are sorted by name. The slot table is an open-addressing hash table with a power of
+ * two slots; a name is looked up by probing linearly from its FNV-1a hash modulo the slot count
+ * until the slot holding its entry index or an empty_slot is found.
+ *
+ * A texture payload starts with a texture_header and level_count texture_level entries,
+ * followed by the levels in the layout the GPU copies them from, largest first. Level offsets
+ * are relative to the payload and multiples of 16.
+ *
+ * All integers are stored in the byte order of the machine that baked the pack;
+ * file_header::byte_order_mark lets the engine detect a mismatch.
+ */
+namespace cc::asset_pack_format
+{
+	constexpr std::array<char, 8> magic         = { 'C', 'C', 'P', 'A', 'C', 'K', '\r', '\n' };
+	constexpr std::uint32_t version             = 1;
+	constexpr std::uint32_t byte_order          = 0x01020304;
+	constexpr std::uint64_t payload_alignment   = 256; // Covers optimalBufferCopyOffsetAlignment on current hardware.
+	constexpr std::uint32_t empty_slot          = 0xFFFFFFFF;
+
+	enum class entry_kind : std::uint8_t
+	{
+		raw = 0,
+		texture,
+	};
+
+	enum class compression : std::uint8_t
+	{
+		none = 0, // The payload can be used in place.
+		lz4,
+		zstd,
+	};
+
+	struct file_header
+	{
+		std::array<char, 8> magic;
+		std::uint32_t version;
+		std::uint32_t byte_order_mark;
+		std::uint32_t entry_count;
+		std::uint32_t slot_count;
+		std::uint64_t entries_offset;
+		std::uint64_t slots_offset;
+		std::uint64_t names_offset;
+		std::uint64_t names_size;
+		std::uint64_t table_checksum; // FNV-1a over the entries, slots and names, in that order.
+	};
+
+	struct entry
+	{
+		std::uint64_t name_hash;
+		std::uint64_t offset;
+		std::uint64_t stored_size;
+		std::uint64_t size; // After decompression.
+		std::uint32_t name_offset;
+		std::uint32_t name_length;
+		entry_kind kind;
+		asset_pack_format::compression compression;
+		std::array<std::uint8_t, 6> reserved;
+	};
+
+	struct texture_header
+	{
+		std::uint32_t width;
+		std::uint32_t height;
+		std::uint32_t level_count;
+		std::uint8_t encoding; // cc::texture_encoding
+		std::uint8_t srgb;
+		std::array<std::uint8_t, 2> reserved;
+	};
+
+	struct texture_level
+	{
+		std::uint64_t offset;
+		std::uint64_t size;
+	};
+
+	static_assert(sizeof(file_header) == 64, "The file header is part of the on-disk format.");
+	static_assert(sizeof(entry) == 48, "Entries are part of the on-disk format.");
+	static_assert(sizeof(texture_header) == 16, "The texture header is part of the on-disk format.");
+} // namespace cc::asset_pack_format
+
+#endif //CAPRICORN_ASSET_PACK_FORMAT_HPP
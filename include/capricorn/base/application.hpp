@@ -4,8 +4,19 @@
 #ifndef CAPRICORN_APPLICATION_HPP
 #define CAPRICORN_APPLICATION_HPP
 
+#include "capricorn/base/frame_scheduler.hpp"
+#include "capricorn/base/profiler.hpp"
 #include "capricorn/base/types.hpp"
 #include "capricorn/base/window.hpp"
+#include "capricorn/ecs/system_scheduler.hpp"
+#include "capricorn/ecs/world.hpp"
+#include "capricorn/graphics/render_graph.hpp"
+#include "capricorn/graphics/vulkan/command_recorder.hpp"
+#include "capricorn/graphics/texture/texture_streamer.hpp"
+#include "capricorn/jobs/job_system.hpp"
+#include "capricorn/memory/frame_allocator.hpp"
+
+#include <functional>
 
 namespace cc
 {
@@ -17,12 +28,43 @@ namespace cc
 		shutdown
 	};
 
+	struct application_create_info
+	{
+		b8 headless    = false;
+		u64 max_frames = 0; // Zero runs until the window closes; headless runs need a limit to finish.
+
+		const char* p_capability_cache_path = "capricorn_capabilities.cache";
+		vk::present_policy present_policy   = vk::present_policy::power_saving;
+		u32 frames_in_flight                = 2;
+		const char* p_preferred_device      = nullptr;         // Name or UUID of the GPU to use, null selects the best scoring one.
+		const char* p_asset_pack_path       = "assets.ccpack"; // Baked by capricorn_bake, optional.
+		vk::validation_profile validation   = vk::default_validation_profile;
+
+		texture_streamer_create_info texture_streaming; // The context and job system are filled in by the application.
+
+		profiler_create_info profiler;
+		const char* p_trace_path      = nullptr; // Captures every frame and writes a Chrome trace there on shutdown. Null captures nothing.
+		const char* p_binary_log_path = nullptr; // Streams the cc_log_* macros there for capricorn_logdecode. Null formats them into the text log.
+	};
+
+	struct application_startup_timing
+	{
+		f64 log_initialize_seconds      = 0.0;
+		f64 time_to_first_frame_seconds = 0.0; // From initialize() until the first frame's work is done, before any pacing.
+		window_startup_timing window;
+	};
+
 	class application
 	{
 	public:
+		using fixed_update_callback = std::function<void(f64 timestep)>;
+		using update_callback       = std::function<void(f64 delta_time, f64 alpha)>;
+
 		application();
 		~application();
 
+		explicit application(const application_create_info& create_info);
+
 		application(const application& other)                = delete;
 		application(application&& other) noexcept            = delete;
 		application& operator=(const application& other)     = delete;
@@ -32,8 +74,41 @@ namespace cc
 		void execute();
 		void shutdown();
 
+		void set_fixed_update_callback(fixed_update_callback callback);
+		void set_update_callback(update_callback callback);
+		void set_frame_rate_cap(f64 frame_rate);
+
+		cc_nodiscard const frame_timing& get_frame_timing() const;
+		cc_nodiscard const application_startup_timing& get_startup_timing() const noexcept;
+		cc_nodiscard std::weak_ptr<job_system> get_job_system() const;
+		cc_nodiscard std::weak_ptr<frame_allocator> get_frame_allocator() const;
+		cc_nodiscard std::weak_ptr<texture_streamer> get_texture_streamer() const;
+		cc_nodiscard std::weak_ptr<vk::command_recorder> get_command_recorder() const;
+		cc_nodiscard std::weak_ptr<render_graph> get_render_graph() const; // Takes passes during the update callback while is_recording().
+		cc_nodiscard std::weak_ptr<const asset_pack> get_asset_pack() const; // Expired when none was found.
+		cc_nodiscard std::weak_ptr<ecs::world> get_world() const;
+		cc_nodiscard std::weak_ptr<ecs::system_scheduler> get_system_scheduler() const; // Runs every frame right before the update callback.
+
 	private:
+		application_create_info m_create_info;
+
+		std::shared_ptr<job_system> m_job_system;
 		std::shared_ptr<window> m_window;
+		std::shared_ptr<graphics_context> m_graphics_context;
+		std::shared_ptr<frame_scheduler> m_frame_scheduler;
+		std::shared_ptr<frame_allocator> m_frame_allocator;
+		std::shared_ptr<texture_streamer> m_texture_streamer;
+		std::shared_ptr<vk::command_recorder> m_command_recorder;
+		std::shared_ptr<render_graph> m_render_graph;
+		std::shared_ptr<asset_pack> m_asset_pack;
+		std::shared_ptr<ecs::world> m_world;
+		std::shared_ptr<ecs::system_scheduler> m_system_scheduler;
+
+		fixed_update_callback m_fixed_update_callback;
+		update_callback m_update_callback;
+
+		application_startup_timing m_startup_timing;
+		std::chrono::steady_clock::time_point m_initialize_start;
 
 		application_state m_state;
 	};
@@ -0,0 +1,139 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_ASYNC_LOG_SINK_HPP
+#define CAPRICORN_ASYNC_LOG_SINK_HPP
+
+#include "capricorn/base/log.hpp"
+#include "capricorn/base/log_writer.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <spdlog/sinks/sink.h>
+#include <vector>
+
+namespace cc
+{
+	namespace details
+	{
+		struct log_record
+		{
+			spdlog::level::level_enum level = spdlog::level::off;
+			spdlog::log_clock::time_point time;
+			std::size_t thread_id = 0;
+			spdlog::string_view_t logger_name;
+			fmt::memory_buffer payload;
+		};
+
+		/**
+		 * @brief Bounded lock-free ring of log records owned by a single producer thread.
+		 *
+		 * @details Based on Vyukov's bounded queue: every slot carries a sequence number that
+		 * hands exclusive ownership of the slot to whoever wins it. Only the owning thread
+		 * pushes, but both the writer thread and the owning thread may pop, the latter to
+		 * discard the oldest record under log_overflow_policy::drop_oldest.
+		 */
+		class log_ring
+		{
+		public:
+			explicit log_ring(std::size_t capacity);
+			~log_ring() = default;
+
+			log_ring(const log_ring& other)                = delete;
+			log_ring(log_ring&& other) noexcept            = delete;
+			log_ring& operator=(const log_ring& other)     = delete;
+			log_ring& operator=(log_ring&& other) noexcept = delete;
+
+			bool try_push(const spdlog::details::log_msg& message);
+			bool try_pop(log_record& out);
+			bool try_discard();
+
+			[[nodiscard]] b8 empty() const noexcept;
+			[[nodiscard]] std::size_t size() const noexcept;
+			[[nodiscard]] std::size_t capacity() const noexcept;
+			[[nodiscard]] std::size_t pushed() const noexcept;
+
+			std::atomic<bool> orphaned = false;
+
+		private:
+			struct slot
+			{
+				std::atomic<std::size_t> sequence = 0;
+				log_record record;
+			};
+
+			template<typename Consumer>
+			bool pop(Consumer&& consumer);
+
+			std::unique_ptr<slot[]> m_slots;
+			std::size_t m_mask = 0;
+
+			alignas(64) std::atomic<std::size_t> m_enqueue_position = 0;
+			alignas(64) std::atomic<std::size_t> m_dequeue_position = 0;
+		};
+	} // namespace details
+
+	/**
+	 * @brief spdlog sink that moves formatting and I/O of the wrapped sinks onto a background writer thread.
+	 *
+	 * @details Every producing thread gets its own lock-free ring, so the calling thread only
+	 * copies the message payload. The writer drains all rings, orders the batch by timestamp,
+	 * forwards it to the wrapped sinks and flushes them once the unflushed byte count exceeds
+	 * log_create_info::flush_batch_size, once log_create_info::flush_interval has elapsed, or
+	 * immediately after an error or critical message.
+	 *
+	 * When a ring is full, log_create_info::overflow_policy decides what happens:
+	 * - block:       the caller wakes the writer and yields until a slot frees up. Nothing is lost.
+	 * - drop_oldest: the caller discards the oldest queued record of its own ring.
+	 * - drop_newest: the caller discards the message it was about to queue.
+	 * Dropped records are counted and reported through log::get_statistics().
+	 */
+	class async_log_sink final : public spdlog::sinks::sink, private details::log_writer<async_log_sink, details::log_ring>
+	{
+	public:
+		async_log_sink(std::vector<spdlog::sink_ptr> sinks, const log_create_info& create_info);
+		~async_log_sink() override;
+
+		async_log_sink(const async_log_sink& other)                = delete;
+		async_log_sink(async_log_sink&& other) noexcept            = delete;
+		async_log_sink& operator=(const async_log_sink& other)     = delete;
+		async_log_sink& operator=(async_log_sink&& other) noexcept = delete;
+
+		void log(const spdlog::details::log_msg& message) override;
+		void flush() override;
+		void set_pattern(const std::string& pattern) override;
+		void set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) override;
+
+		void stop();
+
+		using log_writer::get_statistics;
+
+	private:
+		friend class details::log_writer<async_log_sink, details::log_ring>;
+
+		std::size_t drain();
+		void flush_if_due();
+		void flush_output();
+
+		// Writes out whatever is left once the writer has stopped, or is about to without having seen it.
+		void drain_remaining();
+
+		// Callers hold m_output_mutex.
+		std::size_t write_rings();
+		void flush_sinks();
+
+		std::vector<spdlog::sink_ptr> m_sinks;
+		log_create_info m_create_info;
+
+		std::vector<details::log_record> m_batch;
+		std::vector<details::log_record*> m_ordered_batch;
+
+		std::mutex m_output_mutex; // Held whenever m_sinks or the batch are written, by the writer or a producer after stop().
+		std::atomic<bool> m_flush_requested = false;
+
+		std::size_t m_unflushed_bytes = 0;
+		std::chrono::steady_clock::time_point m_last_flush;
+	};
+} // namespace cc
+
+#endif //CAPRICORN_ASYNC_LOG_SINK_HPP
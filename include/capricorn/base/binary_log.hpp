@@ -0,0 +1,346 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_BINARY_LOG_HPP
+#define CAPRICORN_BINARY_LOG_HPP
+
+#include "capricorn/base/binary_log_format.hpp"
+#include "capricorn/base/log.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+#ifndef CAPRICORN_LOG_ACTIVE_LEVEL
+	#ifdef NDEBUG
+		#define CAPRICORN_LOG_ACTIVE_LEVEL SPDLOG_LEVEL_INFO
+	#else
+		#define CAPRICORN_LOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+	#endif
+#endif
+
+/**
+ * Deferred-format logging macros.
+ *
+ * A call site only records the address of its compile-time binary_log_site, a timestamp and the
+ * raw bytes of its arguments. Formatting happens offline in capricorn_logdecode. Calls below
+ * CAPRICORN_LOG_ACTIVE_LEVEL compile to nothing. When no binary stream has been opened, the
+ * call is formatted and forwarded to the regular text log instead. Either way the format string
+ * is checked against the arguments at compile time, like log::info() and friends.
+ */
+#define cc_log_binary(level, source, format, ...)                                                                                                                         \
+	do                                                                                                                                                                    \
+	{                                                                                                                                                                     \
+		if constexpr (::cc::binary_log::is_level_enabled(level))                                                                                                          \
+		{                                                                                                                                                                 \
+			[](const auto&... cc_log_arguments) {                                                                                                                         \
+				static constexpr ::cc::binary_log_site cc_log_site = ::cc::details::make_binary_log_site<std::decay_t<decltype(cc_log_arguments)>...>(level, source, format, __FILE__, __LINE__); \
+				::cc::binary_log::write(cc_log_site, ::cc::binary_log_format_string<std::decay_t<decltype(cc_log_arguments)>...>(format), cc_log_arguments...);           \
+			}(__VA_ARGS__);                                                                                                                                               \
+		}                                                                                                                                                                 \
+	} while (false)
+
+#define cc_log_trace(source, format, ...) cc_log_binary(::spdlog::level::trace, source, format __VA_OPT__(, ) __VA_ARGS__)
+#define cc_log_info(source, format, ...) cc_log_binary(::spdlog::level::info, source, format __VA_OPT__(, ) __VA_ARGS__)
+#define cc_log_warning(source, format, ...) cc_log_binary(::spdlog::level::warn, source, format __VA_OPT__(, ) __VA_ARGS__)
+#define cc_log_error(source, format, ...) cc_log_binary(::spdlog::level::err, source, format __VA_OPT__(, ) __VA_ARGS__)
+#define cc_log_critical(source, format, ...) cc_log_binary(::spdlog::level::critical, source, format __VA_OPT__(, ) __VA_ARGS__)
+
+namespace cc
+{
+	struct binary_log_site
+	{
+		spdlog::level::level_enum level;
+		log_source source;
+		const char* p_format;
+		const char* p_file;
+		std::uint32_t line;
+		std::uint8_t argument_count;
+		std::array<binary_log_format::argument_type, binary_log_format::max_arguments> argument_types;
+	};
+
+	namespace details
+	{
+		class binary_log_backend;
+
+		template<typename>
+		constexpr bool binary_log_unsupported_argument = false;
+
+		template<typename T>
+		constexpr binary_log_format::argument_type binary_log_argument_type_of()
+		{
+			using argument_type = binary_log_format::argument_type;
+
+			if constexpr (std::is_same_v<T, bool>)
+				return argument_type::boolean;
+			else if constexpr (std::is_same_v<T, char>)
+				return argument_type::character;
+			else if constexpr (std::is_enum_v<T>)
+				return binary_log_argument_type_of<std::underlying_type_t<T>>();
+			else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+				return sizeof(T) == 1 ? argument_type::int8 : sizeof(T) == 2 ? argument_type::int16 : sizeof(T) == 4 ? argument_type::int32 : argument_type::int64;
+			else if constexpr (std::is_integral_v<T>)
+				return sizeof(T) == 1 ? argument_type::uint8 : sizeof(T) == 2 ? argument_type::uint16 : sizeof(T) == 4 ? argument_type::uint32 : argument_type::uint64;
+			else if constexpr (std::is_same_v<T, float>)
+				return argument_type::float32;
+			else if constexpr (std::is_same_v<T, double>)
+				return argument_type::float64;
+			else if constexpr (std::is_convertible_v<T, std::string_view>)
+				return argument_type::string;
+			else if constexpr (std::is_pointer_v<T>)
+				return argument_type::pointer;
+			else
+				static_assert(binary_log_unsupported_argument<T>, "Type cannot be stored in a binary log record, format it into a string first.");
+		}
+
+		template<typename... Args>
+		consteval binary_log_site make_binary_log_site(spdlog::level::level_enum level, log_source source, const char* p_format, const char* p_file, std::uint32_t line)
+		{
+			static_assert(sizeof...(Args) <= binary_log_format::max_arguments, "Too many arguments for a binary log record.");
+
+			return {
+			        .level          = level,
+			        .source         = source,
+			        .p_format       = p_format,
+			        .p_file         = p_file,
+			        .line           = line,
+			        .argument_count = static_cast<std::uint8_t>(sizeof...(Args)),
+			        .argument_types = { binary_log_argument_type_of<Args>()... },
+			};
+		}
+
+		template<typename T>
+		std::string_view binary_log_string_of(const T& value)
+		{
+			if constexpr (std::is_pointer_v<T>)
+			{
+				return value != nullptr ? std::string_view(value) : std::string_view("(null)");
+			}
+			else
+			{
+				return std::string_view(value);
+			}
+		}
+
+		template<typename T>
+		std::size_t binary_log_encoded_size(const T& value)
+		{
+			constexpr auto type = binary_log_argument_type_of<std::decay_t<T>>();
+
+			if constexpr (type == binary_log_format::argument_type::string)
+				return sizeof(std::uint32_t) + binary_log_string_of(value).size();
+			else if constexpr (type == binary_log_format::argument_type::pointer)
+				return sizeof(std::uint64_t);
+			else
+				return sizeof(T);
+		}
+
+		template<typename T>
+		std::byte* binary_log_encode(std::byte* p_destination, const T& value)
+		{
+			constexpr auto type = binary_log_argument_type_of<std::decay_t<T>>();
+
+			if constexpr (type == binary_log_format::argument_type::string)
+			{
+				const std::string_view string = binary_log_string_of(value);
+				const auto length             = static_cast<std::uint32_t>(string.size());
+				std::memcpy(p_destination, &length, sizeof(length));
+				std::memcpy(p_destination + sizeof(length), string.data(), string.size());
+				return p_destination + sizeof(length) + string.size();
+			}
+			else if constexpr (type == binary_log_format::argument_type::pointer)
+			{
+				const auto address = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(value));
+				std::memcpy(p_destination, &address, sizeof(address));
+				return p_destination + sizeof(address);
+			}
+			else
+			{
+				std::memcpy(p_destination, &value, sizeof(T));
+				return p_destination + sizeof(T);
+			}
+		}
+
+		// Mirrors what the decoder sees, so the text fallback prints enums and pointers the same way.
+		template<typename T>
+		decltype(auto) binary_log_text_argument(const T& value)
+		{
+			constexpr auto type = binary_log_argument_type_of<std::decay_t<T>>();
+
+			if constexpr (std::is_enum_v<T>)
+				return static_cast<std::underlying_type_t<T>>(value);
+			else if constexpr (type == binary_log_format::argument_type::pointer)
+				return static_cast<const void*>(value);
+			else
+				return (value);
+		}
+
+		// The text arguments are temporaries, bound here so fmt only ever stores references to lvalues.
+		template<typename... Args>
+		std::string binary_log_format_text(fmt::string_view format, const Args&... args)
+		{
+			return fmt::vformat(format, fmt::make_format_args(args...));
+		}
+
+		template<typename T>
+		using binary_log_text_type = std::decay_t<decltype(binary_log_text_argument(std::declval<const T&>()))>;
+
+		// Layout of a record inside a thread's ring, ahead of the argument bytes.
+		struct binary_log_record_header
+		{
+			const binary_log_site* p_site;
+			std::int64_t timestamp_ns;
+		};
+
+		std::byte* binary_log_reserve(std::size_t size);
+		void binary_log_commit();
+
+		// Set by its own thread for as long as it may touch the backend, see binary_log::shutdown().
+		struct binary_log_writer_flag
+		{
+			alignas(64) std::atomic<bool> writing = false;
+			std::atomic<bool> orphaned            = false;
+		};
+
+		// The calling thread's flag, registered on its first call.
+		binary_log_writer_flag& binary_log_thread_flag();
+
+		// Waits until no thread that may have seen the stream open is still writing to it.
+		void binary_log_wait_for_writers();
+
+		class binary_log_writer_scope
+		{
+		public:
+			binary_log_writer_scope() noexcept
+			    : m_flag(binary_log_thread_flag())
+			{
+				m_flag.writing.store(true, std::memory_order_seq_cst);
+			}
+
+			~binary_log_writer_scope()
+			{
+				m_flag.writing.store(false, std::memory_order_release);
+			}
+
+			binary_log_writer_scope(const binary_log_writer_scope& other)                = delete;
+			binary_log_writer_scope(binary_log_writer_scope&& other) noexcept            = delete;
+			binary_log_writer_scope& operator=(const binary_log_writer_scope& other)     = delete;
+			binary_log_writer_scope& operator=(binary_log_writer_scope&& other) noexcept = delete;
+
+		private:
+			binary_log_writer_flag& m_flag;
+		};
+	} // namespace details
+
+	// Checked against what the text fallback and the decoder format, enums as their underlying type and pointers as addresses.
+	template<typename... Args>
+	using binary_log_format_string = fmt::format_string<details::binary_log_text_type<Args>...>;
+
+	class binary_log final
+	{
+	public:
+		static void initialize(const log_create_info& create_info);
+		static void shutdown();
+
+		static log_statistics get_statistics();
+
+		static constexpr bool is_level_enabled(spdlog::level::level_enum level)
+		{
+			return static_cast<int>(level) >= CAPRICORN_LOG_ACTIVE_LEVEL;
+		}
+
+		static bool is_active() noexcept
+		{
+			return s_active.load(std::memory_order_relaxed);
+		}
+
+		template<typename... Args>
+		static void write(const binary_log_site& site, binary_log_format_string<Args...> format, const Args&... args);
+
+	private:
+		friend std::byte* details::binary_log_reserve(std::size_t size);
+		friend void details::binary_log_commit();
+
+		template<typename... Args>
+		static void write_binary(const binary_log_site& site, const Args&... args);
+
+		template<typename... Args>
+		static void write_text(const binary_log_site& site, binary_log_format_string<Args...> format, const Args&... args);
+
+		static std::atomic<bool> s_active;
+		static std::unique_ptr<details::binary_log_backend> s_backend;
+	};
+
+	template<typename... Args>
+	void binary_log::write(const binary_log_site& site, binary_log_format_string<Args...> format, const Args&... args)
+	{
+		{
+			// Flagged before looking at s_active, so shutdown() either waits for this writer or this writer sees the stream closed.
+			// The flag belongs to this thread alone, the hot path shares no cache line with other producers.
+			const details::binary_log_writer_scope scope;
+
+			if (s_active.load(std::memory_order_seq_cst)) [[likely]]
+			{
+				write_binary(site, args...);
+				return;
+			}
+		}
+
+		write_text(site, format, args...);
+	}
+
+	template<typename... Args>
+	void binary_log::write_binary(const binary_log_site& site, const Args&... args)
+	{
+		const std::size_t size = sizeof(details::binary_log_record_header) + (std::size_t{ 0 } + ... + details::binary_log_encoded_size(args));
+
+		std::byte* p_record = details::binary_log_reserve(size);
+		if (p_record == nullptr)
+		{
+			return;
+		}
+
+		const details::binary_log_record_header header = {
+		        .p_site       = &site,
+		        .timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(),
+		};
+
+		std::memcpy(p_record, &header, sizeof(header));
+		p_record += sizeof(header);
+
+		((p_record = details::binary_log_encode(p_record, args)), ...);
+
+		details::binary_log_commit();
+	}
+
+	template<typename... Args>
+	void binary_log::write_text(const binary_log_site& site, binary_log_format_string<Args...> format, const Args&... args)
+	{
+		const std::string message = details::binary_log_format_text(format, details::binary_log_text_argument(args)...);
+
+		switch (site.level)
+		{
+			case spdlog::level::trace:
+			case spdlog::level::debug:
+				log::trace(site.source, message);
+				break;
+			case spdlog::level::info:
+				log::info(site.source, message);
+				break;
+			case spdlog::level::warn:
+				log::warn(site.source, message);
+				break;
+			case spdlog::level::err:
+				log::error(site.source, message);
+				break;
+			case spdlog::level::critical:
+				log::critical(site.source, message);
+				break;
+			default:
+				break;
+		}
+	}
+} // namespace cc
+
+#endif //CAPRICORN_BINARY_LOG_HPP
@@ -0,0 +1,65 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_BINARY_LOG_FORMAT_HPP
+#define CAPRICORN_BINARY_LOG_FORMAT_HPP
+
+#include <array>
+#include <cstdint>
+
+/**
+ * On-disk layout of a binary log stream, shared by the engine and capricorn_logdecode.
+ *
+ * A stream starts with a file_header, followed by a sequence of entries. Every entry starts with
+ * an entry_tag byte. All integers are stored in the byte order of the machine that wrote the
+ * stream; file_header::byte_order_mark lets the decoder detect a mismatch.
+ *
+ * site entry:   u32 site id, u8 level, u8 log_source, u32 line, u8 argument count,
+ *               u8 argument type per argument, u32 file length, file, u32 format length, format.
+ * record entry: u32 site id, u64 nanoseconds since file_header::start_time_ns,
+ *               u32 argument byte count, the raw argument bytes.
+ *
+ * Arguments are stored back to back in declaration order. Arithmetic arguments are stored as
+ * their raw bytes, strings as a u32 length followed by the characters.
+ */
+namespace cc::binary_log_format
+{
+	constexpr std::array<char, 8> magic = { 'C', 'C', 'B', 'L', 'O', 'G', '\r', '\n' };
+	constexpr std::uint32_t version     = 1;
+	constexpr std::uint32_t byte_order  = 0x01020304;
+	constexpr std::size_t max_arguments = 16;
+
+	enum class entry_tag : std::uint8_t
+	{
+		site   = 1,
+		record = 2,
+	};
+
+	enum class argument_type : std::uint8_t
+	{
+		boolean = 0,
+		character,
+		int8,
+		int16,
+		int32,
+		int64,
+		uint8,
+		uint16,
+		uint32,
+		uint64,
+		float32,
+		float64,
+		string,
+		pointer,
+	};
+
+	struct file_header
+	{
+		std::array<char, 8> magic;
+		std::uint32_t version;
+		std::uint32_t byte_order_mark;
+		std::int64_t start_time_ns; // Wall clock time, in nanoseconds since the Unix epoch, at which the stream was opened.
+	};
+} // namespace cc::binary_log_format
+
+#endif //CAPRICORN_BINARY_LOG_FORMAT_HPP
@@ -3,11 +3,53 @@
 
 #include "capricorn/base/application.hpp"
 
-int main()
+#include <cstring>
+#include <string>
+
+int main(int argc, char** argv)
 {
-	auto* application = new cc::application();
+	cc::application_create_info create_info = {};
+
+	for (int index = 1; index < argc; ++index)
+	{
+		if (std::strcmp(argv[index], "--headless") == 0)
+		{
+			create_info.headless = true;
+		}
+		else if (std::strcmp(argv[index], "--frames") == 0 && index + 1 < argc)
+		{
+			create_info.max_frames = std::stoull(argv[++index]);
+		}
+		else if (std::strcmp(argv[index], "--device") == 0 && index + 1 < argc)
+		{
+			create_info.p_preferred_device = argv[++index];
+		}
+		else if (std::strcmp(argv[index], "--trace") == 0 && index + 1 < argc)
+		{
+			create_info.p_trace_path = argv[++index];
+		}
+		else if (std::strcmp(argv[index], "--binary-log") == 0 && index + 1 < argc)
+		{
+			create_info.p_binary_log_path = argv[++index];
+		}
+	}
+
+	auto* application = new cc::application(create_info);
 
 	application->initialize();
+
+	// Nothing samples it yet, requesting it at the window's height keeps the streaming path exercised.
+	const std::weak_ptr<cc::texture_streamer> p_textures = application->get_texture_streamer();
+	const std::shared_ptr<const cc::asset_pack> p_pack   = application->get_asset_pack().lock();
+
+	const cc::texture_handle texture = p_pack != nullptr ? p_textures.lock()->load(p_pack, "textures/texture.png") : p_textures.lock()->load("assets/textures/texture.png");
+
+	application->set_update_callback([p_textures, texture](f64, f64) {
+		if (const auto p_streamer = p_textures.lock())
+		{
+			p_streamer->request(texture, 720.0F);
+		}
+	});
 	application->execute();
 	application->shutdown();
 
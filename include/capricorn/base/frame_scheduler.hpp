@@ -0,0 +1,99 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_FRAME_SCHEDULER_HPP
+#define CAPRICORN_FRAME_SCHEDULER_HPP
+
+#include "capricorn/base/types.hpp"
+
+#include <array>
+#include <chrono>
+
+namespace cc
+{
+	class window;
+
+	struct frame_scheduler_create_info
+	{
+		f64 fixed_timestep            = 1.0 / 60.0;
+		u32 max_fixed_steps_per_frame = 8;  // Excess simulation time is dropped instead of spiralling.
+		f64 max_frame_delta           = 0.25;
+
+		f64 frame_rate_cap         = 0.0;   // Zero leaves the foreground frame rate uncapped.
+		f64 background_frame_rate  = 10.0;  // Used while the window is unfocused.
+		f64 minimized_frame_rate   = 2.0;   // Used while the window is minimized.
+		b8 throttle_in_background  = true;
+		f64 spin_threshold_seconds = 0.002; // The tail of a wait that is spun instead of slept.
+	};
+
+	struct frame_timing
+	{
+		u64 frame_index = 0;
+
+		f64 delta_time  = 0.0; // Wall time between the start of this frame and the previous one.
+		f64 work_time   = 0.0; // Time spent between begin_frame() and end_frame().
+		f64 wait_time   = 0.0; // Time spent pacing in end_frame().
+		f64 alpha       = 0.0; // Interpolation factor between the last two fixed steps.
+		u32 fixed_steps = 0;
+
+		f64 average_delta_time  = 0.0; // Over the last frame_scheduler::history_size frames.
+		f64 max_delta_time      = 0.0;
+		f64 average_work_time   = 0.0;
+		u64 dropped_fixed_steps = 0;
+	};
+
+	/**
+	 * @brief Paces the main loop and hands out fixed simulation steps.
+	 *
+	 * @details Usage per frame: begin_frame(), then consume every step with step_fixed(),
+	 * render using get_alpha() to interpolate, and finish with end_frame(), which waits until
+	 * the frame budget of the active frame-rate cap has passed. Waiting sleeps in
+	 * glfwWaitEventsTimeout so input is still processed, and spins for the last
+	 * spin_threshold_seconds because OS sleeps overshoot.
+	 */
+	class frame_scheduler
+	{
+	public:
+		static constexpr u32 history_size = 128;
+
+		frame_scheduler()  = default;
+		~frame_scheduler() = default;
+
+		explicit frame_scheduler(const frame_scheduler_create_info& create_info);
+
+		frame_scheduler(const frame_scheduler& other)                = delete;
+		frame_scheduler(frame_scheduler&& other) noexcept            = delete;
+		frame_scheduler& operator=(const frame_scheduler& other)     = delete;
+		frame_scheduler& operator=(frame_scheduler&& other) noexcept = delete;
+
+		void begin_frame();
+		b8 step_fixed();
+		void end_frame(window& window);
+
+		cc_nodiscard f64 get_fixed_timestep() const noexcept;
+		cc_nodiscard f64 get_alpha() const noexcept;
+		cc_nodiscard const frame_timing& get_timing() const noexcept;
+
+		void set_frame_rate_cap(f64 frame_rate) noexcept;
+
+	private:
+		using clock = std::chrono::steady_clock;
+
+		void wait_until(clock::time_point deadline, window& window) const;
+		void record_history();
+
+		frame_scheduler_create_info m_create_info;
+		frame_timing m_timing;
+
+		clock::time_point m_frame_start;
+		b8 m_first_frame       = true;
+		f64 m_accumulator      = 0.0;
+		u32 m_steps_this_frame = 0;
+
+		std::array<f64, history_size> m_delta_history = {};
+		std::array<f64, history_size> m_work_history  = {};
+		u32 m_history_count                           = 0;
+	};
+} // namespace cc
+
+#endif //CAPRICORN_FRAME_SCHEDULER_HPP
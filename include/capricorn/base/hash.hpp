@@ -0,0 +1,27 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_HASH_HPP
+#define CAPRICORN_HASH_HPP
+
+#include "capricorn/base/types.hpp"
+
+namespace cc
+{
+	constexpr u64 fnv1a_offset_basis = 0xCBF29CE484222325ULL;
+
+	// 64-bit FNV-1a, for cache keys and checksums of files we write ourselves. Not for anything adversarial.
+	inline u64 fnv1a(const void* p_data, std::size_t size, u64 hash = fnv1a_offset_basis) noexcept
+	{
+		const auto* p_bytes = static_cast<const u8*>(p_data);
+
+		for (std::size_t index = 0; index < size; ++index)
+		{
+			hash = (hash ^ p_bytes[index]) * 0x100000001B3ULL;
+		}
+
+		return hash;
+	}
+} // namespace cc
+
+#endif //CAPRICORN_HASH_HPP
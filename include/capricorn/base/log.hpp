@@ -4,6 +4,8 @@
 #ifndef CAPRICORN_LOG_HPP
 #define CAPRICORN_LOG_HPP
 
+#include <chrono>
+#include <cstdint>
 #include <spdlog/fmt/ostr.h>
 #include <spdlog/spdlog.h>
 
@@ -31,10 +33,53 @@ namespace cc
 		}
 	}
 
+	enum class log_mode
+	{
+		synchronous = 0,
+		asynchronous,
+	};
+
+	enum class log_overflow_policy
+	{
+		block = 0,
+		drop_oldest,
+		drop_newest,
+	};
+
+	struct log_create_info
+	{
+		log_mode mode = log_mode::synchronous;
+
+		// Only used in asynchronous mode, see async_log_sink for the exact semantics.
+		log_overflow_policy overflow_policy      = log_overflow_policy::block;
+		std::size_t ring_capacity                = 1024;
+		std::size_t flush_batch_size             = 64 * 1024;
+		std::chrono::milliseconds flush_interval = std::chrono::milliseconds(100);
+
+		const char* p_file_name = "Capricorn.log";
+
+		// Opens a binary stream for the cc_log_* macros when set, see binary_log.hpp.
+		const char* p_binary_file_name = nullptr;
+		std::size_t binary_ring_size   = 256 * 1024;
+	};
+
+	struct log_statistics
+	{
+		std::uint64_t enqueued = 0;
+		std::uint64_t written  = 0;
+		std::uint64_t dropped  = 0;
+		std::uint64_t flushes  = 0;
+	};
+
+	class async_log_sink;
+
 	class log final
 	{
 	public:
-		static void initialize();
+		static void initialize(const log_create_info& create_info = {});
+		static void shutdown();
+
+		static log_statistics get_statistics();
 
 		template<typename T>
 		constexpr static void trace(log_source source, const T& message);
@@ -68,6 +113,7 @@ namespace cc
 
 	private:
 		static std::shared_ptr<spdlog::logger> s_logger;
+		static std::shared_ptr<async_log_sink> s_async_sink;
 	};
 
 	template<typename T>
@@ -0,0 +1,284 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_LOG_WRITER_HPP
+#define CAPRICORN_LOG_WRITER_HPP
+
+#include "capricorn/base/log.hpp"
+#include "capricorn/base/types.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cc::details
+{
+	/**
+	 * @brief Per-thread producer rings and the background thread draining them.
+	 *
+	 * @details Shared by async_log_sink and the binary log stream. Every producing thread lazily gets
+	 * its own Ring, registered here and marked orphaned when the thread exits, so the writer retires
+	 * it once it is drained. The writer calls Derived::drain() until it finds nothing, giving
+	 * Derived::flush_if_due() a chance to flush after every pass, and otherwise sleeps for up to the
+	 * flush interval or until woken. Derived::flush_output() runs one last time once stop() has been called.
+	 *
+	 * Ring has to be constructible from a capacity and provide empty(), pushed() and an atomic orphaned flag.
+	 */
+	template<typename Derived, typename Ring>
+	class log_writer
+	{
+	public:
+		[[nodiscard]] log_statistics get_statistics() const noexcept;
+
+	protected:
+		log_writer(std::size_t ring_capacity, std::chrono::milliseconds flush_interval);
+		~log_writer() = default;
+
+		log_writer(const log_writer& other)                = delete;
+		log_writer(log_writer&& other) noexcept            = delete;
+		log_writer& operator=(const log_writer& other)     = delete;
+		log_writer& operator=(log_writer&& other) noexcept = delete;
+
+		// Called by the derived constructor once everything drain() touches exists.
+		void start();
+
+		// Returns whether this call was the one that stopped the writer.
+		b8 stop();
+
+		[[nodiscard]] b8 is_running() const noexcept;
+		[[nodiscard]] b8 is_writer_sleeping() const noexcept;
+
+		Ring& get_thread_ring();
+		void wake_writer();
+
+		// Visits every ring under the registry lock, then retires the orphaned ones that are empty.
+		template<typename Visitor>
+		void for_each_ring(Visitor&& visitor);
+
+		std::atomic<std::uint64_t> m_written = 0;
+		std::atomic<std::uint64_t> m_dropped = 0;
+		std::atomic<std::uint64_t> m_flushes = 0;
+
+	private:
+		struct thread_ring_handle
+		{
+			std::uint64_t owner = 0;
+			std::shared_ptr<Ring> ring;
+
+			~thread_ring_handle()
+			{
+				if (ring)
+				{
+					ring->orphaned.store(true, std::memory_order_release);
+				}
+			}
+		};
+
+		void run();
+		b8 has_pending() const;
+
+		static inline thread_local thread_ring_handle t_ring_handle;
+		static inline std::atomic<std::uint64_t> s_next_id = 1;
+
+		std::size_t m_ring_capacity = 0;
+		std::chrono::milliseconds m_flush_interval;
+		std::uint64_t m_id = 0;
+
+		mutable std::mutex m_rings_mutex;
+		std::vector<std::shared_ptr<Ring>> m_rings;
+		std::atomic<std::uint64_t> m_retired_enqueued = 0;
+
+		std::mutex m_writer_mutex;
+		std::condition_variable m_writer_condition;
+		bool m_wake_requested               = false;
+		std::atomic<bool> m_writer_sleeping = false;
+		std::atomic<bool> m_running         = true;
+		std::thread m_writer;
+	};
+
+	template<typename Derived, typename Ring>
+	log_writer<Derived, Ring>::log_writer(std::size_t ring_capacity, std::chrono::milliseconds flush_interval)
+	    : m_ring_capacity(ring_capacity),
+	      m_flush_interval(flush_interval),
+	      m_id(s_next_id.fetch_add(1, std::memory_order_relaxed))
+	{
+	}
+
+	template<typename Derived, typename Ring>
+	log_statistics log_writer<Derived, Ring>::get_statistics() const noexcept
+	{
+		std::uint64_t enqueued = m_retired_enqueued.load(std::memory_order_relaxed);
+
+		{
+			std::lock_guard const lock(m_rings_mutex);
+			for (const auto& ring: m_rings)
+			{
+				enqueued += ring->pushed();
+			}
+		}
+
+		return {
+		        .enqueued = enqueued,
+		        .written  = m_written.load(std::memory_order_relaxed),
+		        .dropped  = m_dropped.load(std::memory_order_relaxed),
+		        .flushes  = m_flushes.load(std::memory_order_relaxed),
+		};
+	}
+
+	template<typename Derived, typename Ring>
+	void log_writer<Derived, Ring>::start()
+	{
+		m_writer = std::thread(&log_writer::run, this);
+	}
+
+	template<typename Derived, typename Ring>
+	b8 log_writer<Derived, Ring>::stop()
+	{
+		if (!m_running.exchange(false))
+		{
+			return false;
+		}
+
+		wake_writer();
+
+		if (m_writer.joinable())
+		{
+			m_writer.join();
+		}
+
+		return true;
+	}
+
+	template<typename Derived, typename Ring>
+	b8 log_writer<Derived, Ring>::is_running() const noexcept
+	{
+		return m_running.load(std::memory_order_acquire);
+	}
+
+	template<typename Derived, typename Ring>
+	b8 log_writer<Derived, Ring>::is_writer_sleeping() const noexcept
+	{
+		return m_writer_sleeping.load();
+	}
+
+	template<typename Derived, typename Ring>
+	Ring& log_writer<Derived, Ring>::get_thread_ring()
+	{
+		thread_ring_handle& handle = t_ring_handle;
+
+		if (handle.owner != m_id)
+		{
+			if (handle.ring)
+			{
+				handle.ring->orphaned.store(true, std::memory_order_release);
+			}
+
+			handle.owner = m_id;
+			handle.ring  = std::make_shared<Ring>(m_ring_capacity);
+
+			std::lock_guard const lock(m_rings_mutex);
+			m_rings.push_back(handle.ring);
+		}
+
+		return *handle.ring;
+	}
+
+	template<typename Derived, typename Ring>
+	void log_writer<Derived, Ring>::wake_writer()
+	{
+		{
+			std::lock_guard const lock(m_writer_mutex);
+			m_wake_requested = true;
+		}
+
+		m_writer_condition.notify_one();
+	}
+
+	template<typename Derived, typename Ring>
+	template<typename Visitor>
+	void log_writer<Derived, Ring>::for_each_ring(Visitor&& visitor)
+	{
+		std::lock_guard const lock(m_rings_mutex);
+
+		for (auto it = m_rings.begin(); it != m_rings.end();)
+		{
+			Ring& ring = **it;
+
+			// Check before visiting, so records pushed right before the owner exited still get drained below.
+			const b8 orphaned = ring.orphaned.load(std::memory_order_acquire);
+
+			visitor(ring);
+
+			if (orphaned && ring.empty())
+			{
+				m_retired_enqueued.fetch_add(ring.pushed(), std::memory_order_relaxed);
+				it = m_rings.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	template<typename Derived, typename Ring>
+	void log_writer<Derived, Ring>::run()
+	{
+		Derived& derived = static_cast<Derived&>(*this);
+
+		while (true)
+		{
+			const b8 running          = m_running.load(std::memory_order_acquire);
+			const std::size_t drained = derived.drain();
+
+			derived.flush_if_due();
+
+			if (drained > 0)
+			{
+				continue;
+			}
+
+			if (!running)
+			{
+				break;
+			}
+
+			// Announce the nap before looking one last time, so a producer either sees the flag or we see its record.
+			m_writer_sleeping.store(true);
+
+			if (has_pending())
+			{
+				m_writer_sleeping.store(false);
+				continue;
+			}
+
+			std::unique_lock lock(m_writer_mutex);
+			m_writer_condition.wait_for(lock, m_flush_interval, [this] {
+				return m_wake_requested;
+			});
+			m_wake_requested = false;
+			lock.unlock();
+
+			m_writer_sleeping.store(false);
+		}
+
+		derived.flush_output();
+	}
+
+	template<typename Derived, typename Ring>
+	b8 log_writer<Derived, Ring>::has_pending() const
+	{
+		std::lock_guard const lock(m_rings_mutex);
+
+		return std::any_of(m_rings.begin(), m_rings.end(), [](const auto& ring) {
+			return !ring->empty();
+		});
+	}
+} // namespace cc::details
+
+#endif //CAPRICORN_LOG_WRITER_HPP
@@ -0,0 +1,199 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_PROFILER_HPP
+#define CAPRICORN_PROFILER_HPP
+
+#include "capricorn/base/types.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+// Zero compiles every zone macro to nothing and keeps the engine from creating GPU query pools.
+#ifndef CAPRICORN_PROFILER_ENABLED
+	#define CAPRICORN_PROFILER_ENABLED 1
+#endif
+
+// Zones read the time stamp counter where the CPU has an invariant one, which is cheaper than the steady clock.
+#ifndef CAPRICORN_PROFILER_TSC
+	#if defined(__x86_64__) || defined(_M_X64)
+		#define CAPRICORN_PROFILER_TSC 1
+	#else
+		#define CAPRICORN_PROFILER_TSC 0
+	#endif
+#endif
+
+#if CAPRICORN_PROFILER_TSC
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <x86intrin.h>
+	#endif
+#endif
+
+#define cc_profile_concat_inner(left, right) left##right
+#define cc_profile_concat(left, right) cc_profile_concat_inner(left, right)
+
+/**
+ * Scoped CPU zones.
+ *
+ * A zone records its site, which is a compile-time constant, and the time it was entered and
+ * left into the calling thread's ring when the scope ends. Nothing is recorded while the
+ * profiler is not initialized, which costs one relaxed load per zone.
+ */
+#if CAPRICORN_PROFILER_ENABLED
+	#define cc_profile_zone(name)                                                                                              \
+		static constexpr ::cc::profile_zone_site cc_profile_concat(cc_profile_site_, __LINE__) = { name, __FILE__, __LINE__ }; \
+		const ::cc::profile_scope cc_profile_concat(cc_profile_scope_, __LINE__)(cc_profile_concat(cc_profile_site_, __LINE__))
+#else
+	#define cc_profile_zone(name) static_cast<void>(0)
+#endif
+
+namespace cc
+{
+	constexpr b8 profiler_enabled = CAPRICORN_PROFILER_ENABLED != 0;
+
+	struct profile_zone_site
+	{
+		const char* p_name = nullptr;
+		const char* p_file = nullptr;
+		u32 line           = 0;
+	};
+
+	struct profiler_create_info
+	{
+		u32 ring_size          = 16384;   // Zones per thread that may be recorded between two end_frame() calls.
+		u32 history_frames     = 120;     // Frames the rolling summary covers.
+		u32 max_capture_events = 1 << 20; // Zones a capture keeps, later ones are dropped.
+		u32 summary_interval   = 0;       // Frames between summaries written to the log, zero never writes one.
+	};
+
+	struct profile_zone_summary
+	{
+		const char* p_name  = nullptr;
+		b8 gpu              = false;
+		f64 average_ms      = 0.0; // Time spent in the zone per frame, summed over calls and threads.
+		f64 max_ms          = 0.0; // Of a single frame.
+		f64 calls_per_frame = 0.0;
+	};
+
+	struct profiler_statistics
+	{
+		u64 frames        = 0;
+		u64 window        = 0; // Frames the summary covers.
+		u64 zones         = 0;
+		u64 dropped       = 0; // Zones a full ring had no room for.
+		u64 captured      = 0;
+		u64 capture_drops = 0;
+		u32 threads       = 0; // Rings currently registered.
+	};
+
+	namespace details
+	{
+		class profiler_backend;
+	}
+
+	/**
+	 * @brief Collects CPU and GPU zones, aggregates them per frame and exports captures as Chrome trace JSON.
+	 *
+	 * @details Every thread records into a ring of its own, registered the first time it enters a
+	 * zone. Rings have a single producer and are drained by end_frame() on the thread that
+	 * submits frames, so recording never takes a lock; a full ring drops the zone and counts it.
+	 * GPU zones arrive through record_gpu() once the gpu_profiler resolved their timestamps.
+	 *
+	 * end_frame() adds each zone's time to a rolling window of history_frames frames that
+	 * get_summary() reports from. Between begin_capture() and end_capture() the zones are kept
+	 * as well, and end_capture() writes them in the trace event format that chrome://tracing
+	 * and Perfetto open, one track per thread plus one for the GPU and one for frames.
+	 *
+	 * initialize() and shutdown() have to be called while no other thread records zones.
+	 */
+	class profiler final
+	{
+	public:
+		static void initialize(const profiler_create_info& create_info);
+		static void shutdown();
+
+		cc_nodiscard static b8 is_active() noexcept
+		{
+			return s_active.load(std::memory_order_relaxed);
+		}
+
+		// Nanoseconds of the steady clock, which zones are reported in.
+		cc_nodiscard static i64 now() noexcept
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		// What CPU zones are timed with, converted to now() when end_frame() drains them.
+		cc_nodiscard static i64 ticks() noexcept
+		{
+#if CAPRICORN_PROFILER_TSC
+			if (s_tsc)
+			{
+				return static_cast<i64>(__rdtsc());
+			}
+#endif
+
+			return now();
+		}
+
+		static void record(const profile_zone_site& site, i64 begin_ticks, i64 end_ticks) noexcept;
+		static void record_gpu(const profile_zone_site& site, i64 begin_ns, i64 end_ns) noexcept; // From the thread that submits frames.
+
+		// A site for a name known only at runtime, e.g. a render graph pass. The name has to outlive the profiler.
+		cc_nodiscard static const profile_zone_site& intern(const char* p_name);
+
+		// Names the calling thread's track in captures.
+		static void set_thread_name(const char* p_name);
+
+		// Once per frame on the thread that submits frames, after the frame was submitted.
+		static void end_frame();
+
+		static void begin_capture();
+		static b8 end_capture(const std::filesystem::path& path); // Returns whether the trace was written.
+
+		cc_nodiscard static std::vector<profile_zone_summary> get_summary(); // Slowest first.
+		cc_nodiscard static profiler_statistics get_statistics();
+
+		static void log_summary(u32 max_zones = 16);
+
+	private:
+		static std::atomic<b8> s_active;
+		static b8 s_tsc; // Decided by initialize(), before any thread records.
+		static std::unique_ptr<details::profiler_backend> s_backend;
+	};
+
+	// Records a zone from construction to destruction, see cc_profile_zone.
+	class profile_scope
+	{
+	public:
+		explicit profile_scope(const profile_zone_site& site) noexcept
+		    : m_p_site(&site),
+		      m_begin(profiler::is_active() ? profiler::ticks() : 0)
+		{
+		}
+
+		~profile_scope()
+		{
+			if (m_begin != 0)
+			{
+				profiler::record(*m_p_site, m_begin, profiler::ticks());
+			}
+		}
+
+		profile_scope(const profile_scope& other)                = delete;
+		profile_scope(profile_scope&& other) noexcept            = delete;
+		profile_scope& operator=(const profile_scope& other)     = delete;
+		profile_scope& operator=(profile_scope&& other) noexcept = delete;
+
+	private:
+		const profile_zone_site* m_p_site;
+		i64 m_begin;
+	};
+} // namespace cc
+
+#endif //CAPRICORN_PROFILER_HPP
@@ -9,6 +9,32 @@
 
 namespace cc
 {
+	struct window_create_info
+	{
+		const char* p_title = "Capricorn Engine";
+		u32 width           = 1280;
+		u32 height          = 720;
+
+		// Skips GLFW entirely, for batch servers, CI and software drivers such as lavapipe.
+		b8 headless = false;
+
+		b8 resizable = true;
+
+		// Forwarded to graphics_context_create_info, null disables the capability cache.
+		const char* p_capability_cache_path = "capricorn_capabilities.cache";
+		vk::present_policy present_policy   = vk::present_policy::power_saving;
+		u32 frames_in_flight                = 2;
+		const char* p_preferred_device      = nullptr;
+		vk::validation_profile validation   = vk::default_validation_profile;
+	};
+
+	struct window_startup_timing
+	{
+		f64 glfw_init_seconds       = 0.0;
+		f64 window_creation_seconds = 0.0;
+		graphics_context_timing graphics;
+	};
+
 	class window
 	{
 	public:
@@ -16,6 +42,7 @@ namespace cc
 		~window() = default;
 
 		window(const char* title, u32 width, u32 height);
+		explicit window(const window_create_info& create_info);
 
 		window(const window& other)                = delete;
 		window(window&& other) noexcept            = delete;
@@ -23,18 +50,31 @@ namespace cc
 		window& operator=(window&& other) noexcept = delete;
 
 		void tick();
+		void wait_events(f64 timeout_seconds);
+		void request_close();
 
 		cc_nodiscard b8 should_close() const;
+		cc_nodiscard b8 is_focused() const;
+		cc_nodiscard b8 is_minimized() const;
+		cc_nodiscard b8 is_headless() const;
 
 		cc_nodiscard std::weak_ptr<GLFWwindow> get_native_window() const;
+		cc_nodiscard std::weak_ptr<graphics_context> get_graphics_context() const;
+		cc_nodiscard const window_startup_timing& get_startup_timing() const noexcept;
 
 	private:
+		void on_framebuffer_resized(i32 width, i32 height);
+
 		std::shared_ptr<GLFWwindow> m_window;
 		std::shared_ptr<graphics_context> m_graphics_context;
 
 		const char* m_p_title = nullptr;
 		u32 m_width = 0;
 		u32 m_height = 0;
+		b8 m_headless = false;
+		b8 m_close_requested = false;
+
+		window_startup_timing m_startup_timing;
 	};
 } // namespace cc
 
@@ -0,0 +1,126 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_ARCHETYPE_HPP
+#define CAPRICORN_ARCHETYPE_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/ecs/component.hpp"
+#include "capricorn/ecs/entity.hpp"
+
+#include <array>
+#include <vector>
+
+namespace cc::ecs
+{
+	constexpr std::size_t chunk_size      = 16 * 1024;
+	constexpr std::size_t chunk_alignment = 64;
+
+	// A block of chunk_size bytes: the entities of its rows, then one column per component, each aligned to a cache line.
+	struct chunk
+	{
+		std::byte* p_data = nullptr;
+		u32 count         = 0;
+	};
+
+	struct entity_location
+	{
+		u32 chunk = 0;
+		u32 row   = 0;
+	};
+
+	/**
+	 * @brief Stores every entity that has exactly one set of components.
+	 *
+	 * @details Components are laid out as structure of arrays within chunks of chunk_size bytes,
+	 * so a system reading positions touches nothing but positions. The capacity of a chunk
+	 * follows from the summed size of the components. Rows are dense: every chunk but the last
+	 * is full, and removing a row moves the archetype's last row into the hole, which keeps
+	 * iteration free of gaps at the price of entities changing place.
+	 *
+	 * Archetypes link to the archetype one component away, so adding or removing a component
+	 * finds its target without hashing after the first time.
+	 */
+	class archetype
+	{
+	public:
+		static constexpr u16 no_column = 0xFFFF;
+
+		~archetype();
+
+		archetype(u32 index, const component_mask& mask);
+
+		archetype(const archetype& other)                = delete;
+		archetype(archetype&& other) noexcept            = delete;
+		archetype& operator=(const archetype& other)     = delete;
+		archetype& operator=(archetype&& other) noexcept = delete;
+
+		cc_nodiscard u32 get_index() const noexcept;
+		cc_nodiscard const component_mask& get_mask() const noexcept;
+		cc_nodiscard const std::vector<component_id>& get_components() const noexcept; // In id order, which is also column order.
+		cc_nodiscard u32 get_capacity() const noexcept;                                // Rows per chunk.
+		cc_nodiscard u32 get_chunk_count() const noexcept;
+		cc_nodiscard u32 get_entity_count() const noexcept;
+		cc_nodiscard const chunk& get_chunk(u32 index) const noexcept;
+
+		// The column a component is stored in, no_column when the archetype does not have it.
+		cc_nodiscard u16 get_column(component_id component) const noexcept
+		{
+			return m_columns[component];
+		}
+
+		cc_nodiscard entity* get_entities(const chunk& chunk) const noexcept
+		{
+			return reinterpret_cast<entity*>(chunk.p_data);
+		}
+
+		cc_nodiscard void* get_column_data(const chunk& chunk, u16 column) const noexcept
+		{
+			return chunk.p_data + m_offsets[column];
+		}
+
+		cc_nodiscard void* get_component(entity_location location, u16 column) const noexcept;
+
+		// Appends a row for the entity. Its components are left unconstructed.
+		cc_nodiscard entity_location allocate(entity entity);
+
+		// Removes a row, destroying its components unless they were relocated already. The last row
+		// takes its place, the entity that moved is returned so its location can be updated.
+		entity remove(entity_location location, b8 destroy) noexcept;
+
+		// Moves the components both archetypes have from a row of this one into a row allocated in the target.
+		void relocate(entity_location location, archetype& target, entity_location target_location) noexcept;
+
+		cc_nodiscard archetype* get_add_edge(component_id component) const noexcept;
+		cc_nodiscard archetype* get_remove_edge(component_id component) const noexcept;
+		void set_add_edge(component_id component, archetype* p_archetype);
+		void set_remove_edge(component_id component, archetype* p_archetype);
+
+	private:
+		struct edge
+		{
+			component_id component = 0;
+			archetype* p_archetype  = nullptr;
+		};
+
+		void destroy_row(const chunk& chunk, u32 row) noexcept;
+
+		u32 m_index = 0;
+		component_mask m_mask;
+		std::vector<component_id> m_components;
+		std::vector<const component_info*> m_infos; // Per column.
+		std::vector<u32> m_offsets;                 // Per column, from the start of a chunk.
+		std::array<u16, max_components> m_columns = {};
+		u32 m_capacity                            = 0;
+		b8 m_trivial                              = true; // Every column is trivially relocatable.
+
+		std::vector<chunk> m_chunks;
+		std::byte* m_p_spare_chunk = nullptr; // The last chunk that emptied, kept so an entity bouncing across a chunk boundary does not allocate.
+		u32 m_entity_count         = 0;
+
+		std::vector<edge> m_add_edges;
+		std::vector<edge> m_remove_edges;
+	};
+} // namespace cc::ecs
+
+#endif //CAPRICORN_ARCHETYPE_HPP
@@ -0,0 +1,120 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_COMMAND_BUFFER_HPP
+#define CAPRICORN_COMMAND_BUFFER_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/ecs/component.hpp"
+#include "capricorn/ecs/entity.hpp"
+
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace cc::ecs
+{
+	class world;
+
+	/**
+	 * @brief Structural changes recorded while queries iterate, applied to the world later.
+	 *
+	 * @details Commands are applied by playback() in the order they were recorded. Component
+	 * values are moved into pages of the buffer when they are recorded and relocated into
+	 * their chunk on playback, pages are kept across playbacks so a buffer that is reused
+	 * every frame stops allocating. Entities created through the buffer are reserved in the
+	 * world right away, so later commands and other systems can refer to them, and become
+	 * alive on playback. Commands for entities that died in the meantime are dropped.
+	 *
+	 * A buffer belongs to one thread at a time.
+	 */
+	class command_buffer
+	{
+	public:
+		static constexpr std::size_t page_size = 16 * 1024;
+
+		command_buffer() = default;
+		~command_buffer();
+
+		explicit command_buffer(world& world);
+
+		command_buffer(const command_buffer& other)                = delete;
+		command_buffer(command_buffer&& other) noexcept            = delete;
+		command_buffer& operator=(const command_buffer& other)     = delete;
+		command_buffer& operator=(command_buffer&& other) noexcept = delete;
+
+		cc_nodiscard entity create();
+		void destroy(entity entity);
+
+		template<typename T>
+		void add(entity entity, T&& component);
+
+		template<typename T>
+		void remove(entity entity);
+
+		void playback();
+		void clear(); // Drops the commands without applying them.
+
+		cc_nodiscard b8 is_empty() const noexcept;
+		cc_nodiscard u32 get_command_count() const noexcept;
+		cc_nodiscard u64 get_dropped_count() const noexcept; // Across every playback.
+
+	private:
+		enum class command_type : u8
+		{
+			destroy,
+			add,
+			remove,
+		};
+
+		struct command
+		{
+			command_type type      = command_type::destroy;
+			component_id component = 0;
+			entity target;
+			void* p_payload = nullptr;
+		};
+
+		struct alignas(16) page
+		{
+			std::byte data[page_size];
+		};
+
+		cc_nodiscard void* allocate_payload(std::size_t size);
+
+		world* m_p_world = nullptr;
+
+		std::vector<command> m_commands;
+		std::vector<std::unique_ptr<page>> m_pages;
+		u32 m_page      = 0; // The page payloads are allocated from.
+		u32 m_page_used = 0;
+		u64 m_dropped   = 0;
+	};
+
+	template<typename T>
+	void command_buffer::add(entity entity, T&& component)
+	{
+		using value_type = std::remove_cvref_t<T>;
+
+		static_assert(alignof(value_type) <= 16, "Components recorded into a command buffer are aligned to at most 16 bytes.");
+		static_assert(sizeof(value_type) <= page_size, "Component is too large to be recorded into a command buffer.");
+
+		const component_id id = component_registry::get_id<value_type>();
+		void* p_payload       = nullptr;
+
+		if constexpr (!std::is_empty_v<value_type>)
+		{
+			p_payload = new (allocate_payload(sizeof(value_type))) value_type(std::forward<T>(component));
+		}
+
+		m_commands.push_back({ .type = command_type::add, .component = id, .target = entity, .p_payload = p_payload });
+	}
+
+	template<typename T>
+	void command_buffer::remove(entity entity)
+	{
+		m_commands.push_back({ .type = command_type::remove, .component = component_registry::get_id<T>(), .target = entity });
+	}
+} // namespace cc::ecs
+
+#endif //CAPRICORN_COMMAND_BUFFER_HPP
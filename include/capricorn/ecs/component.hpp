@@ -0,0 +1,110 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_COMPONENT_HPP
+#define CAPRICORN_COMPONENT_HPP
+
+#include "capricorn/base/types.hpp"
+
+#include <bitset>
+#include <new>
+#include <type_traits>
+#include <typeinfo>
+
+namespace cc::ecs
+{
+	using component_id = u16;
+
+	constexpr u32 max_components = 256;
+
+	// Which components an archetype stores, or a query requires, indexed by component_id.
+	using component_mask = std::bitset<max_components>;
+
+	struct component_info
+	{
+		const char* p_name = nullptr;
+		u32 size           = 0; // Zero for tags, which take no storage.
+		u32 alignment      = 1;
+		b8 trivial         = true; // Moved with memcpy and never destroyed.
+
+		// Move-constructs the destination from the source and destroys the source.
+		void (*p_relocate)(void* p_destination, void* p_source) noexcept = nullptr;
+		void (*p_destroy)(void* p_memory) noexcept                       = nullptr;
+	};
+
+	/**
+	 * @brief Process-wide numbering of component types.
+	 *
+	 * @details A type is registered the first time get_id() is asked for it and keeps its id
+	 * until the process exits, so ids can index masks and tables without hashing. Components
+	 * have to be nothrow move constructible, archetypes relocate them whenever an entity
+	 * changes archetype or a removal fills the hole it left.
+	 */
+	class component_registry final
+	{
+	public:
+		template<typename T>
+		cc_nodiscard static component_id get_id();
+
+		cc_nodiscard static const component_info& get_info(component_id id) noexcept;
+		cc_nodiscard static u32 get_count() noexcept;
+
+	private:
+		template<typename T>
+		static component_id register_type();
+
+		static component_id register_component(const component_info& info);
+	};
+
+	template<typename T>
+	component_id component_registry::get_id()
+	{
+		using component = std::remove_cvref_t<T>;
+
+		// Every qualified spelling shares the id of the plain type, instead of a static of its own.
+		if constexpr (!std::is_same_v<T, component>)
+		{
+			return get_id<component>();
+		}
+		else
+		{
+			static const component_id id = register_type<component>();
+			return id;
+		}
+	}
+
+	template<typename T>
+	component_id component_registry::register_type()
+	{
+		static_assert(std::is_nothrow_move_constructible_v<T>, "Components are relocated between chunks and have to be nothrow move constructible.");
+		static_assert(std::is_nothrow_destructible_v<T>, "Components have to be nothrow destructible.");
+		static_assert(alignof(T) <= 64, "Chunk columns are aligned to at most a cache line.");
+
+		constexpr b8 trivial = std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>;
+
+		return register_component({
+		        .p_name     = typeid(T).name(),
+		        .size       = std::is_empty_v<T> ? 0U : static_cast<u32>(sizeof(T)),
+		        .alignment  = static_cast<u32>(alignof(T)),
+		        .trivial    = trivial,
+		        .p_relocate = [](void* p_destination, void* p_source) noexcept {
+			        auto* p_value = std::launder(static_cast<T*>(p_source));
+			        new (p_destination) T(std::move(*p_value));
+			        p_value->~T();
+		        },
+		        .p_destroy = [](void* p_memory) noexcept {
+			        std::launder(static_cast<T*>(p_memory))->~T();
+		        },
+		});
+	}
+
+	template<typename... Components>
+	cc_nodiscard component_mask make_component_mask()
+	{
+		component_mask mask;
+		(mask.set(component_registry::get_id<Components>()), ...);
+		return mask;
+	}
+} // namespace cc::ecs
+
+#endif //CAPRICORN_COMPONENT_HPP
@@ -0,0 +1,48 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_ENTITY_HPP
+#define CAPRICORN_ENTITY_HPP
+
+#include "capricorn/base/types.hpp"
+
+#include <functional>
+
+namespace cc::ecs
+{
+	/**
+	 * @brief Handle of an entity in a world.
+	 *
+	 * @details The index names a slot in the world's entity table, which is reused once the
+	 * entity is destroyed. The generation is bumped on every destruction, so a handle that
+	 * outlived its entity no longer matches the slot and is_alive() reports it as dead instead
+	 * of silently referring to whatever took the slot over.
+	 */
+	struct entity
+	{
+		static constexpr u32 invalid_index = ~0U;
+
+		u32 index      = invalid_index;
+		u32 generation = 0;
+
+		cc_nodiscard constexpr b8 is_null() const noexcept
+		{
+			return index == invalid_index;
+		}
+
+		friend constexpr bool operator==(const entity& lhs, const entity& rhs) noexcept = default;
+	};
+
+	constexpr entity null_entity = {};
+} // namespace cc::ecs
+
+template<>
+struct std::hash<cc::ecs::entity>
+{
+	std::size_t operator()(const cc::ecs::entity& entity) const noexcept
+	{
+		return std::hash<u64>()(static_cast<u64>(entity.generation) << 32 | entity.index);
+	}
+};
+
+#endif //CAPRICORN_ENTITY_HPP
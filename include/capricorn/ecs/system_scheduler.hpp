@@ -0,0 +1,165 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_SYSTEM_SCHEDULER_HPP
+#define CAPRICORN_SYSTEM_SCHEDULER_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/ecs/command_buffer.hpp"
+#include "capricorn/ecs/world.hpp"
+#include "capricorn/jobs/job_system.hpp"
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace cc::ecs
+{
+	class system_scheduler;
+
+	// Handed to a system every time it runs.
+	struct system_context
+	{
+		ecs::world& world;
+		command_buffer& commands; // Played back once every system of the run finished, in the order the systems were added.
+		job_system* p_job_system = nullptr;
+		f64 delta_time           = 0.0;
+	};
+
+	// Handed to a system's setup function, which declares everything the system touches through it.
+	class system_builder
+	{
+	public:
+		template<typename T>
+		system_builder& read();
+
+		template<typename T>
+		system_builder& write();
+
+		// Declares the components' access from their constness and returns the query to keep for execution.
+		template<typename... Components>
+		cc_nodiscard ecs::query<Components...> query(const component_mask& excluded = {});
+
+		// Runs alone, e.g. to make structural changes on the world directly.
+		system_builder& set_exclusive();
+
+	private:
+		friend class system_scheduler;
+
+		system_builder(system_scheduler& scheduler, u32 system);
+
+		system_scheduler& m_scheduler;
+		u32 m_system;
+	};
+
+	struct system_scheduler_create_info
+	{
+		std::weak_ptr<world> p_world;
+		std::weak_ptr<job_system> p_job_system; // Expired runs every system on the calling thread.
+	};
+
+	// Of the last run.
+	struct system_scheduler_statistics
+	{
+		u32 systems          = 0;
+		u32 waves            = 0;
+		u32 widest_wave      = 0; // Systems that could run at the same time.
+		u32 commands         = 0; // Played back from the systems' command buffers.
+		f64 run_seconds      = 0.0;
+		f64 playback_seconds = 0.0;
+	};
+
+	/**
+	 * @brief Runs systems in parallel where their declared component access allows it.
+	 *
+	 * @details Systems are run in waves. A system joins the wave after the last earlier system
+	 * it conflicts with, i.e. one that writes a component it reads or writes or reads a
+	 * component it writes, and exclusive systems conflict with everything. Systems of a wave
+	 * run as jobs and the wave waits for all of them before the next starts, so conflicting
+	 * systems always observe each other in the order they were added. Inside a system queries
+	 * may spread over the job system once more, wait() helps with other jobs meanwhile.
+	 *
+	 * Every system records structural changes into a command buffer of its own. The buffers
+	 * are played back after the last wave, in the order the systems were added, so the result
+	 * does not depend on which system happened to finish first.
+	 *
+	 * Every system gets a CPU zone named after it.
+	 */
+	class system_scheduler
+	{
+	public:
+		using setup_function   = std::function<void(system_builder& builder)>;
+		using execute_function = std::function<void(system_context& context)>;
+
+		system_scheduler()  = default;
+		~system_scheduler() = default;
+
+		explicit system_scheduler(const system_scheduler_create_info& create_info);
+
+		system_scheduler(const system_scheduler& other)                = delete;
+		system_scheduler(system_scheduler&& other) noexcept            = delete;
+		system_scheduler& operator=(const system_scheduler& other)     = delete;
+		system_scheduler& operator=(system_scheduler&& other) noexcept = delete;
+
+		static std::shared_ptr<system_scheduler> create(const system_scheduler_create_info& create_info);
+
+		// Calls setup right away.
+		void add_system(const char* p_name, const setup_function& setup, execute_function execute);
+
+		void run(f64 delta_time);
+
+		cc_nodiscard u32 get_system_count() const noexcept;
+		cc_nodiscard system_scheduler_statistics get_statistics() const noexcept;
+
+	private:
+		friend class system_builder;
+
+		struct system_node
+		{
+			const char* p_name = nullptr;
+			component_mask reads;
+			component_mask writes;
+			b8 exclusive = false;
+			execute_function execute;
+			std::unique_ptr<command_buffer> p_commands;
+		};
+
+		cc_nodiscard static b8 conflicts(const system_node& lhs, const system_node& rhs) noexcept;
+
+		void build_waves();
+		void run_system(system_node& system, f64 delta_time);
+
+		std::shared_ptr<world> m_world;
+		std::shared_ptr<job_system> m_job_system;
+
+		std::vector<system_node> m_systems;
+		std::vector<std::vector<u32>> m_waves;
+		b8 m_waves_dirty = false;
+
+		system_scheduler_statistics m_statistics;
+	};
+
+	template<typename T>
+	system_builder& system_builder::read()
+	{
+		m_scheduler.m_systems[m_system].reads.set(component_registry::get_id<T>());
+		return *this;
+	}
+
+	template<typename T>
+	system_builder& system_builder::write()
+	{
+		m_scheduler.m_systems[m_system].writes.set(component_registry::get_id<T>());
+		return *this;
+	}
+
+	template<typename... Components>
+	ecs::query<Components...> system_builder::query(const component_mask& excluded)
+	{
+		((std::is_const_v<Components> ? read<Components>() : write<Components>()), ...);
+		return m_scheduler.m_world->query<Components...>(excluded);
+	}
+} // namespace cc::ecs
+
+#endif //CAPRICORN_SYSTEM_SCHEDULER_HPP
@@ -0,0 +1,402 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_WORLD_HPP
+#define CAPRICORN_WORLD_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/ecs/archetype.hpp"
+#include "capricorn/ecs/component.hpp"
+#include "capricorn/ecs/entity.hpp"
+#include "capricorn/jobs/job_system.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cc::ecs
+{
+	template<typename... Components>
+	class query;
+
+	struct world_create_info
+	{
+		u32 entity_capacity = 0; // Entity slots reserved up front.
+	};
+
+	struct world_statistics
+	{
+		u32 entities   = 0;
+		u32 archetypes = 0;
+		u32 chunks     = 0;
+		u32 queries    = 0;
+		u64 moves      = 0; // Entities that changed archetype because a component was added or removed.
+	};
+
+	// The archetypes a query matches, shared by every query object with the same components.
+	struct query_state
+	{
+		component_mask required;
+		component_mask excluded;
+
+		std::vector<archetype*> archetypes;
+		std::atomic<u32> examined = 0; // Archetypes of the world matched against so far, newer ones are matched on the next iteration.
+	};
+
+	/**
+	 * @brief Entities and their components, stored by archetype.
+	 *
+	 * @details Every entity lives in the archetype of its exact set of components, entities
+	 * without any in the empty archetype. Adding or removing a component moves the entity's
+	 * row to the neighbouring archetype, which is why pointers returned by get() only stay
+	 * valid until the next structural change.
+	 *
+	 * Structural changes, i.e. creating and destroying entities and adding and removing
+	 * components, must not happen while a query iterates. Systems record them into a
+	 * command_buffer instead, which the scheduler plays back once every system ran. The only
+	 * call that is safe from several threads is reserve(), which hands out entity handles
+	 * that become alive on the next structural change or flush().
+	 *
+	 * Queries are cached: query() returns a view of the query_state for its components,
+	 * which remembers the matching archetypes and only looks at archetypes created since it
+	 * last iterated.
+	 */
+	class world
+	{
+	public:
+		world();
+		~world();
+
+		explicit world(const world_create_info& create_info);
+
+		world(const world& other)                = delete;
+		world(world&& other) noexcept            = delete;
+		world& operator=(const world& other)     = delete;
+		world& operator=(world&& other) noexcept = delete;
+
+		static std::shared_ptr<world> create(const world_create_info& create_info);
+
+		cc_nodiscard entity create();
+
+		template<typename... Components>
+		entity create(Components&&... components);
+
+		void destroy(entity entity);
+		cc_nodiscard b8 is_alive(entity entity) const noexcept;
+
+		// Replaces the component when the entity already has it.
+		template<typename T, typename... Args>
+		T& add(entity entity, Args&&... args);
+
+		template<typename T>
+		void remove(entity entity);
+
+		// Null when the entity does not have the component.
+		template<typename T>
+		cc_nodiscard T* get(entity entity) const noexcept;
+
+		template<typename T>
+		cc_nodiscard b8 has(entity entity) const noexcept;
+
+		// Storage for the component, constructed by the caller. A component the entity already has is destroyed first.
+		cc_nodiscard void* add_uninitialized(entity entity, component_id component);
+		void remove(entity entity, component_id component);
+		cc_nodiscard void* get(entity entity, component_id component) const noexcept;
+
+		// Matches entities that have every component and none of the excluded ones. Const components are only read.
+		template<typename... Components>
+		cc_nodiscard ecs::query<Components...> query(const component_mask& excluded = {});
+
+		cc_nodiscard query_state& get_query_state(const component_mask& required, const component_mask& excluded);
+		void update_query(query_state& state);
+
+		// Thread-safe. The entity becomes alive, without components, on the next structural change or flush().
+		cc_nodiscard entity reserve() noexcept;
+		void flush();
+
+		cc_nodiscard u32 get_entity_count() const noexcept;
+		cc_nodiscard u32 get_archetype_count() const noexcept;
+		cc_nodiscard const archetype& get_archetype(u32 index) const noexcept;
+		cc_nodiscard world_statistics get_statistics() const;
+
+	private:
+		template<typename... Components>
+		friend class ecs::query;
+
+		struct entity_record
+		{
+			archetype* p_archetype = nullptr; // Null while the slot is free.
+			entity_location location;
+			u32 generation = 0;
+		};
+
+		struct query_key
+		{
+			component_mask required;
+			component_mask excluded;
+
+			bool operator==(const query_key& other) const noexcept = default;
+		};
+
+		struct query_key_hash
+		{
+			std::size_t operator()(const query_key& key) const noexcept
+			{
+				return std::hash<component_mask>()(key.required) * 31 + std::hash<component_mask>()(key.excluded);
+			}
+		};
+
+		// Queries hold one while they iterate, structural changes check that none is held.
+		class iteration_scope
+		{
+		public:
+			explicit iteration_scope(world& world) noexcept : m_world(world)
+			{
+				m_world.m_iterating.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			~iteration_scope()
+			{
+				m_world.m_iterating.fetch_sub(1, std::memory_order_relaxed);
+			}
+
+			iteration_scope(const iteration_scope& other)                = delete;
+			iteration_scope(iteration_scope&& other) noexcept            = delete;
+			iteration_scope& operator=(const iteration_scope& other)     = delete;
+			iteration_scope& operator=(iteration_scope&& other) noexcept = delete;
+
+		private:
+			world& m_world;
+		};
+
+		void begin_structural_change();
+		cc_nodiscard entity allocate_entity();
+		void place(entity entity, archetype& target);
+		void move(entity_record& record, archetype& target);
+
+		cc_nodiscard archetype& find_or_create_archetype(const component_mask& mask);
+		cc_nodiscard archetype& get_add_target(archetype& source, component_id component);
+		cc_nodiscard archetype& get_remove_target(archetype& source, component_id component);
+
+		std::vector<std::unique_ptr<archetype>> m_archetypes;
+		std::unordered_map<component_mask, archetype*> m_archetype_lookup;
+		archetype* m_p_empty_archetype = nullptr;
+
+		std::vector<entity_record> m_records;
+		std::vector<u32> m_free_indices;
+		std::atomic<i64> m_free_cursor = 0; // Free indices below it are not reserved yet, a negative cursor reserved new slots too.
+
+		std::mutex m_query_mutex;
+		std::unordered_map<query_key, std::unique_ptr<query_state>, query_key_hash> m_queries;
+
+		std::atomic<u32> m_iterating = 0;
+		u64 m_moves                  = 0;
+	};
+
+	/**
+	 * @brief Iterates the entities of a world that have a set of components.
+	 *
+	 * @details A const component is read, anything else is written, which is what the system
+	 * scheduler derives a system's access from. Iteration walks chunk by chunk and hands out
+	 * each chunk's columns as plain arrays, so the per-entity functions compile down to loops
+	 * over contiguous memory. Queries are cheap to copy and stay valid as long as their world.
+	 */
+	template<typename... Components>
+	class query
+	{
+	public:
+		query(world& world, query_state& state) noexcept : m_p_world(&world), m_p_state(&state)
+		{
+		}
+
+		// Calls function(components&...), or function(entity, components&...), for every entity.
+		template<typename Function>
+		void for_each(Function&& function) const;
+
+		// Calls function(count, p_entities, p_components...) for every chunk, each pointer the start of a column.
+		template<typename Function>
+		void for_each_chunk(Function&& function) const;
+
+		// As for_each, spread over the job system chunks_per_job chunks at a time. The function is called concurrently.
+		template<typename Function>
+		void parallel_for_each(job_system& job_system, Function&& function, u32 chunks_per_job = 4) const;
+
+		template<typename Function>
+		void parallel_for_each_chunk(job_system& job_system, Function&& function, u32 chunks_per_job = 4) const;
+
+		cc_nodiscard u32 count() const;
+
+	private:
+		using column_array = std::array<u16, sizeof...(Components)>;
+
+		struct chunk_reference
+		{
+			const archetype* p_archetype = nullptr;
+			const chunk* p_chunk         = nullptr;
+			column_array columns         = {};
+		};
+
+		cc_nodiscard static column_array get_columns(const archetype& archetype)
+		{
+			return { archetype.get_column(component_registry::get_id<Components>())... };
+		}
+
+		template<typename Function, std::size_t... Indices>
+		static void invoke(Function& function, const archetype& archetype, const chunk& chunk, const column_array& columns, std::index_sequence<Indices...> /*indices*/)
+		{
+			function(chunk.count, static_cast<const entity*>(archetype.get_entities(chunk)), static_cast<Components*>(archetype.get_column_data(chunk, columns[Indices]))...);
+		}
+
+		template<typename Function>
+		static auto make_row_function(Function& function)
+		{
+			return [&function](u32 count, const entity* p_entities, Components*... p_columns) {
+				for (u32 row = 0; row < count; ++row)
+				{
+					if constexpr (std::is_invocable_v<Function&, entity, Components&...>)
+					{
+						function(p_entities[row], p_columns[row]...);
+					}
+					else
+					{
+						function(p_columns[row]...);
+					}
+				}
+			};
+		}
+
+		world* m_p_world       = nullptr;
+		query_state* m_p_state = nullptr;
+	};
+
+	template<typename... Components>
+	entity world::create(Components&&... components)
+	{
+		begin_structural_change();
+
+		const entity entity = allocate_entity();
+		archetype& target   = sizeof...(Components) == 0 ? *m_p_empty_archetype : find_or_create_archetype(make_component_mask<Components...>());
+
+		place(entity, target);
+
+		const entity_location location = m_records[entity.index].location;
+
+		(new (target.get_component(location, target.get_column(component_registry::get_id<Components>()))) std::remove_cvref_t<Components>(std::forward<Components>(components)), ...);
+
+		return entity;
+	}
+
+	template<typename T, typename... Args>
+	T& world::add(entity entity, Args&&... args)
+	{
+		void* p_component = add_uninitialized(entity, component_registry::get_id<T>());
+		return *new (p_component) T(std::forward<Args>(args)...);
+	}
+
+	template<typename T>
+	void world::remove(entity entity)
+	{
+		remove(entity, component_registry::get_id<T>());
+	}
+
+	template<typename T>
+	T* world::get(entity entity) const noexcept
+	{
+		return static_cast<T*>(get(entity, component_registry::get_id<T>()));
+	}
+
+	template<typename T>
+	b8 world::has(entity entity) const noexcept
+	{
+		return get(entity, component_registry::get_id<T>()) != nullptr;
+	}
+
+	template<typename... Components>
+	ecs::query<Components...> world::query(const component_mask& excluded)
+	{
+		return ecs::query<Components...>(*this, get_query_state(make_component_mask<Components...>(), excluded));
+	}
+
+	template<typename... Components>
+	template<typename Function>
+	void query<Components...>::for_each(Function&& function) const
+	{
+		for_each_chunk(make_row_function(function));
+	}
+
+	template<typename... Components>
+	template<typename Function>
+	void query<Components...>::for_each_chunk(Function&& function) const
+	{
+		m_p_world->update_query(*m_p_state);
+
+		const world::iteration_scope scope(*m_p_world);
+
+		for (const archetype* p_archetype: m_p_state->archetypes)
+		{
+			const column_array columns = get_columns(*p_archetype);
+
+			for (u32 index = 0; index < p_archetype->get_chunk_count(); ++index)
+			{
+				invoke(function, *p_archetype, p_archetype->get_chunk(index), columns, std::index_sequence_for<Components...>());
+			}
+		}
+	}
+
+	template<typename... Components>
+	template<typename Function>
+	void query<Components...>::parallel_for_each(job_system& job_system, Function&& function, u32 chunks_per_job) const
+	{
+		parallel_for_each_chunk(job_system, make_row_function(function), chunks_per_job);
+	}
+
+	template<typename... Components>
+	template<typename Function>
+	void query<Components...>::parallel_for_each_chunk(job_system& job_system, Function&& function, u32 chunks_per_job) const
+	{
+		m_p_world->update_query(*m_p_state);
+
+		const world::iteration_scope scope(*m_p_world);
+
+		std::vector<chunk_reference> chunks;
+
+		for (const archetype* p_archetype: m_p_state->archetypes)
+		{
+			const column_array columns = get_columns(*p_archetype);
+
+			for (u32 index = 0; index < p_archetype->get_chunk_count(); ++index)
+			{
+				chunks.push_back({ .p_archetype = p_archetype, .p_chunk = &p_archetype->get_chunk(index), .columns = columns });
+			}
+		}
+
+		job_system.parallel_for(static_cast<u32>(chunks.size()), chunks_per_job, [&chunks, &function](u32 begin, u32 end) {
+			for (u32 index = begin; index < end; ++index)
+			{
+				const chunk_reference& reference = chunks[index];
+				invoke(function, *reference.p_archetype, *reference.p_chunk, reference.columns, std::index_sequence_for<Components...>());
+			}
+		});
+	}
+
+	template<typename... Components>
+	u32 query<Components...>::count() const
+	{
+		m_p_world->update_query(*m_p_state);
+
+		u32 count = 0;
+
+		for (const archetype* p_archetype: m_p_state->archetypes)
+		{
+			count += p_archetype->get_entity_count();
+		}
+
+		return count;
+	}
+} // namespace cc::ecs
+
+#endif //CAPRICORN_WORLD_HPP
@@ -4,21 +4,91 @@
 #ifndef CAPRICORN_GRAPHICS_CONTEXT_HPP
 #define CAPRICORN_GRAPHICS_CONTEXT_HPP
 
+#include "capricorn/graphics/vulkan/bindless_heap.hpp"
+#include "capricorn/graphics/vulkan/capability_cache.hpp"
+#include "capricorn/graphics/vulkan/gpu_profiler.hpp"
+#include "capricorn/graphics/vulkan/host_allocator.hpp"
 #include "capricorn/graphics/vulkan/instance.hpp"
 #include "capricorn/graphics/vulkan/logical_device.hpp"
+#include "capricorn/graphics/vulkan/offscreen_target.hpp"
+#include "capricorn/graphics/vulkan/swapchain.hpp"
+#include "capricorn/graphics/vulkan/upload_service.hpp"
+#include "capricorn/graphics/vulkan/validation.hpp"
+
+#include <optional>
 
 namespace cc
 {
 	struct graphics_context_create_info
 	{
-		std::weak_ptr<GLFWwindow> p_window;
+		// Without a window the context renders into a VK_EXT_headless_surface, or into offscreen images when the driver lacks it.
+		b8 headless       = false;
+		VkExtent2D extent = { 1280, 720 };
+
+		// Where layer, extension and queue family queries are cached between runs. Null disables the cache.
+		const char* p_capability_cache_path = "capricorn_capabilities.cache";
+
+		// Name or UUID of the GPU to use, see vk::device_create_info. Null selects the best scoring one.
+		const char* p_preferred_device = nullptr;
+
+		// Hands the driver's host allocations to a vk::host_allocator, whose statistics are logged on shutdown. Off lets the driver allocate for itself.
+		b8 host_allocator = true;
+
+		// Overridden by the CAPRICORN_VALIDATION environment variable, see vk::resolve_validation_profile().
+		vk::validation_profile validation = vk::default_validation_profile;
+
+		vk::present_policy present_policy = vk::present_policy::power_saving;
+		u32 swapchain_image_count         = 3;
+		u32 frames_in_flight              = 2;
+		VkClearColorValue clear_color     = { { 0.0F, 0.0F, 0.0F, 1.0F } };
+	};
+
+	// A frame between begin_frame() and end_frame().
+	struct graphics_frame
+	{
+		VkCommandBuffer command_buffer = VK_NULL_HANDLE; // Recording, the image is cleared and in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
+		VkImage image                  = VK_NULL_HANDLE;
+		VkImageView image_view         = VK_NULL_HANDLE;
+		VkFormat format                = VK_FORMAT_UNDEFINED;
+		VkExtent2D extent              = {};
+		u32 image_index                = 0;
+		u32 frame_index                = 0; // Which of the frames in flight, for indexing per-frame resources.
+		u64 frame_number               = 0;
+	};
+
+	struct graphics_context_timing
+	{
+		f64 instance_seconds         = 0.0; // Including layer and extension enumeration, on the startup thread.
+		f64 device_discovery_seconds = 0.0; // Physical device enumeration and capability queries, on the startup thread.
+		f64 startup_wait_seconds     = 0.0; // How long initialize() blocked on the startup thread, the part that did not overlap.
+		f64 surface_seconds          = 0.0;
+		f64 device_selection_seconds = 0.0;
+		f64 device_creation_seconds  = 0.0;
+
+		u32 capability_cache_hits   = 0;
+		u32 capability_cache_misses = 0;
 	};
 
+	/**
+	 * @brief Owns the Vulkan instance, surface and device.
+	 *
+	 * @details Construction only starts instance creation and physical device discovery on a
+	 * background thread, so the caller can create its window in the meantime. initialize()
+	 * then waits for that work, creates the surface and the device. Nothing but the destructor
+	 * may be called before initialize().
+	 *
+	 * Up to graphics_context_create_info::frames_in_flight frames are recorded ahead of the GPU,
+	 * each with its own fence, acquire semaphore and command pool. begin_frame() blocks on the
+	 * fence of the frame that used the same slot before.
+	 *
+	 * Where the graphics queue writes timestamps, the context owns the gpu_profiler and opens a
+	 * GPU zone around each frame's command buffer.
+	 */
 	class graphics_context
 	{
 	public:
-		graphics_context()  = default;
-		~graphics_context() = default;
+		graphics_context() = default;
+		~graphics_context();
 
 		explicit graphics_context(const graphics_context_create_info& create_info);
 
@@ -29,14 +99,78 @@ namespace cc
 
 		static std::shared_ptr<graphics_context> create(const graphics_context_create_info& create_info);
 
+		// Pass an empty window when headless.
+		void initialize(std::weak_ptr<GLFWwindow> p_window);
+
+		// Once per frame, for housekeeping such as saving the pipeline cache periodically.
+		void update();
+
+		// Returns nothing when the frame has to be skipped, e.g. while the window is minimized.
+		cc_nodiscard std::optional<graphics_frame> begin_frame();
+		void end_frame(const graphics_frame& frame);
+
+		// Makes the frame's commands wait for the upload, on the GPU where timeline semaphores are available.
+		void wait_for_upload(const graphics_frame& frame, vk::upload_token token);
+
+		// Makes the frame's submission wait for a binary semaphore that is signaled by a submission made before end_frame().
+		void wait_for_semaphore(const graphics_frame& frame, VkSemaphore semaphore, VkPipelineStageFlags stages);
+
+		// Called by the window when its framebuffer changed size.
+		void resize(u32 width, u32 height);
+
 		cc_nodiscard std::weak_ptr<GLFWwindow> get_window() const;
 		cc_nodiscard std::weak_ptr<vk::instance> get_instance() const;
+		cc_nodiscard std::weak_ptr<VkSurfaceKHR> get_surface() const;
+		cc_nodiscard std::weak_ptr<vk::logical_device> get_logical_device() const;
+		cc_nodiscard std::weak_ptr<vk::offscreen_target> get_offscreen_target() const;
+		cc_nodiscard std::weak_ptr<vk::swapchain> get_swapchain() const;
+		cc_nodiscard std::weak_ptr<vk::upload_service> get_upload_service() const;
+		cc_nodiscard std::weak_ptr<vk::bindless_heap> get_bindless_heap() const; // Empty when the device lacks descriptor indexing.
+		cc_nodiscard std::weak_ptr<vk::gpu_profiler> get_gpu_profiler() const; // Empty when the graphics queue lacks timestamps or the profiler is compiled out.
+		cc_nodiscard const vk::host_allocator* get_host_allocator() const noexcept; // Null when disabled.
+		cc_nodiscard b8 is_headless() const noexcept;
+		cc_nodiscard const graphics_context_timing& get_timing() const noexcept;
 
 	private:
+		struct frame_resources
+		{
+			VkFence in_flight              = VK_NULL_HANDLE;
+			VkSemaphore image_available    = VK_NULL_HANDLE;
+			VkCommandPool command_pool     = VK_NULL_HANDLE;
+			VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+		};
+
+		void create_instance();
+		void create_headless_surface();
+		void create_frame_resources();
+		void destroy_frame_resources();
+
+		graphics_context_create_info m_create_info;
+
+		std::future<void> m_startup;
+		std::unique_ptr<vk::host_allocator> m_host_allocator; // Declared first, the instance and everything created from it allocate from it until they are gone.
+		std::shared_ptr<vk::capability_cache> m_capability_cache;
+		std::vector<vk::physical_device_candidate> m_candidates;
+
 		std::weak_ptr<GLFWwindow> m_window;
 		std::shared_ptr<vk::instance> m_instance;
 		std::shared_ptr<VkSurfaceKHR> m_surface;
 		std::shared_ptr<vk::logical_device> m_logical_device;
+		std::shared_ptr<vk::offscreen_target> m_offscreen_target;
+		std::shared_ptr<vk::swapchain> m_swapchain;
+		std::shared_ptr<vk::upload_service> m_upload_service;
+		std::shared_ptr<vk::bindless_heap> m_bindless_heap;
+		std::shared_ptr<vk::gpu_profiler> m_gpu_profiler;
+
+		std::vector<frame_resources> m_frames;
+		u64 m_frame_number                           = 0;
+		vk::upload_token m_upload_wait               = 0; // Highest upload the frame being recorded depends on.
+		VkSemaphore m_semaphore_wait                 = VK_NULL_HANDLE;
+		VkPipelineStageFlags m_semaphore_wait_stages = 0;
+		vk::gpu_zone m_frame_zone                    = vk::invalid_gpu_zone; // Spans the frame's command buffer on the GPU.
+
+		graphics_context_timing m_timing;
+		b8 m_headless = false;
 	};
 } // namespace cc
 
@@ -0,0 +1,316 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_RENDER_GRAPH_HPP
+#define CAPRICORN_RENDER_GRAPH_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/graphics/graphics_context.hpp"
+#include "capricorn/graphics/vulkan/memory_allocator.hpp"
+
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace cc
+{
+	class render_graph;
+
+	enum class render_queue : u8
+	{
+		graphics,
+		compute, // Runs on the async compute queue when the pass qualifies, see render_graph.
+	};
+
+	// How a pass accesses an image, which decides the stages, access mask and layout barriers use.
+	enum class resource_usage : u8
+	{
+		color_attachment, // Written.
+		depth_attachment, // Written.
+		depth_read,       // Depth testing without depth writes.
+		sampled,
+		storage_read,
+		storage_write, // Written.
+		transfer_src,
+		transfer_dst, // Written.
+	};
+
+	using render_resource = u32;
+
+	constexpr render_resource invalid_render_resource = std::numeric_limits<u32>::max();
+
+	struct render_image_desc
+	{
+		VkFormat format               = VK_FORMAT_R8G8B8A8_UNORM;
+		VkExtent2D extent             = {}; // Zero uses the extent of the frame.
+		u32 mip_levels                = 1;
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+		const char* p_name            = nullptr;
+	};
+
+	// Handed to a pass's setup function, which declares everything the pass touches through it.
+	class render_pass_builder
+	{
+	public:
+		// A transient image that lives for this frame only. Its contents are undefined until a pass writes it.
+		cc_nodiscard render_resource create_image(const render_image_desc& desc);
+
+		void read(render_resource resource, resource_usage usage);
+		void write(render_resource resource, resource_usage usage);
+
+		// Keeps the pass even when nothing reads what it writes, e.g. for readbacks.
+		void set_side_effect();
+
+	private:
+		friend class render_graph;
+
+		render_pass_builder(render_graph& graph, u32 pass);
+
+		render_graph& m_graph;
+		u32 m_pass;
+	};
+
+	// Handed to a pass's execute function while the graph records it.
+	class render_pass_context
+	{
+	public:
+		cc_nodiscard VkCommandBuffer get_command_buffer() const noexcept;
+		cc_nodiscard VkImage get_image(render_resource resource) const;
+		cc_nodiscard VkImageView get_image_view(render_resource resource) const;
+		cc_nodiscard VkExtent2D get_extent(render_resource resource) const;
+		cc_nodiscard b8 is_async() const noexcept; // Whether the pass runs on the async compute queue.
+
+	private:
+		friend class render_graph;
+
+		render_pass_context(const render_graph& graph, VkCommandBuffer command_buffer, b8 async);
+
+		const render_graph& m_graph;
+		VkCommandBuffer m_command_buffer;
+		b8 m_async;
+	};
+
+	struct render_graph_create_info
+	{
+		std::weak_ptr<graphics_context> p_context;
+
+		b8 async_compute = true; // Runs qualifying compute passes on the async compute queue where the device has one.
+		b8 aliasing      = true; // Lets transient images whose lifetimes do not overlap share memory.
+	};
+
+	// Of the last frame that was executed.
+	struct render_graph_statistics
+	{
+		u32 passes           = 0;
+		u32 culled_passes    = 0;
+		u32 async_passes     = 0;
+		u32 barriers         = 0; // vkCmdPipelineBarrier calls, at most one per pass plus the final transitions.
+		u32 image_barriers   = 0;
+		u32 transient_images = 0;
+
+		VkDeviceSize transient_bytes = 0; // What the transient images would take without aliasing.
+		VkDeviceSize allocated_bytes = 0; // What they take, per frame in flight.
+		u64 placements               = 0; // Times the transient images had to be created anew, across all frames.
+	};
+
+	/**
+	 * @brief Builds the frame out of passes that declare which images they read and write.
+	 *
+	 * @details The graph is rebuilt every frame between begin() and execute(). Passes are set up
+	 * immediately by add_pass(), their execute functions run during execute(), in the order the
+	 * passes were added. Before recording, execute() compiles the graph:
+	 *
+	 * - Passes are culled when nothing that outlives the frame depends on them: a pass is kept
+	 *   when it has a side effect, writes an imported image, or writes an image a kept pass
+	 *   accesses later.
+	 * - Barriers are derived from the state each image was left in. A pass gets at most one
+	 *   vkCmdPipelineBarrier, and none when its accesses are already ordered, e.g. reads of an
+	 *   image that a previous barrier already made visible to the same stages.
+	 * - Transient images are placed by their lifetimes in the order of execution. Images whose
+	 *   lifetimes do not overlap share memory, and the first pass using an image waits for the
+	 *   last ones that used the memory before it. The placement is kept per frame in flight and
+	 *   only redone when the set of transient images or their lifetimes change.
+	 * - Compute passes run on the async compute queue when their inputs are produced there as
+	 *   well: they may not touch imported images, nor images a graphics pass accessed earlier
+	 *   in the frame. They are submitted by execute(), and the frame's submission waits for them
+	 *   at the stages of the first graphics pass that uses their results, which takes the
+	 *   images over with a queue family ownership transfer. Other compute passes run on the
+	 *   graphics queue.
+	 *
+	 * Every pass that was recorded gets a CPU zone named after it, and a GPU zone unless it runs
+	 * on the async compute queue, which is submitted ahead of the frame's timestamp queries.
+	 *
+	 * begin() follows graphics_context::begin_frame(), which already waited for the frame slot
+	 * whose transient images are reused. All calls belong to the thread that submits frames.
+	 */
+	class render_graph
+	{
+	public:
+		using setup_function   = std::function<void(render_pass_builder& builder)>;
+		using execute_function = std::function<void(const render_pass_context& context)>;
+
+		render_graph() = default;
+		~render_graph();
+
+		explicit render_graph(const render_graph_create_info& create_info);
+
+		render_graph(const render_graph& other)                = delete;
+		render_graph(render_graph&& other) noexcept            = delete;
+		render_graph& operator=(const render_graph& other)     = delete;
+		render_graph& operator=(render_graph&& other) noexcept = delete;
+
+		static std::shared_ptr<render_graph> create(const render_graph_create_info& create_info);
+
+		// Starts the frame's graph and imports its image, which is cleared and left in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL again.
+		void begin(const graphics_frame& frame);
+
+		// An image owned elsewhere, in the state initial_usage left it in. execute() leaves it as final_usage expects.
+		cc_nodiscard render_resource import_image(VkImage image, VkImageView image_view, VkFormat format, VkExtent2D extent, resource_usage initial_usage, resource_usage final_usage);
+
+		// Calls setup right away.
+		void add_pass(const char* p_name, render_queue queue, const setup_function& setup, execute_function execute);
+
+		// Compiles the graph and records its passes into the frame, submitting the async compute ones.
+		void execute();
+
+		cc_nodiscard b8 is_recording() const noexcept; // Between begin() and execute().
+		cc_nodiscard render_resource get_backbuffer() const noexcept;
+		cc_nodiscard render_graph_statistics get_statistics() const;
+
+	private:
+		friend class render_pass_builder;
+		friend class render_pass_context;
+
+		struct image_state
+		{
+			VkImageLayout layout         = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags stages  = 0; // Of the last write or layout transition.
+			VkAccessFlags access         = 0;
+			VkPipelineStageFlags readers = 0; // Stages that read since then.
+			VkPipelineStageFlags visible = 0; // Stages the last write was made visible to, along with visible_access.
+			VkAccessFlags visible_access = 0;
+			b8 initialized               = false;
+		};
+
+		struct resource_node
+		{
+			render_image_desc desc;
+			VkImage image                 = VK_NULL_HANDLE;
+			VkImageView image_view        = VK_NULL_HANDLE;
+			VkImageUsageFlags usage_flags = 0;
+			resource_usage initial_usage  = resource_usage::transfer_dst;
+			resource_usage final_usage    = resource_usage::transfer_dst;
+			resource_usage handoff_usage  = resource_usage::sampled; // Of the first graphics pass after async compute ones.
+			b8 imported                   = false;
+			b8 used                       = false; // By a pass that survived culling.
+			b8 async                      = false; // Accessed by an async compute pass.
+			b8 graphics                   = false; // Accessed by a pass on the graphics queue.
+			u32 first                     = 0;     // Lifetime, in positions of passes on the graphics queue.
+			u32 last                      = 0;
+			u32 physical                  = invalid_render_resource; // Index into the frame slot's images, for transient ones.
+			image_state state;
+			image_state async_state;
+		};
+
+		struct resource_access
+		{
+			render_resource resource = invalid_render_resource;
+			resource_usage usage     = resource_usage::sampled;
+			b8 write                 = false;
+		};
+
+		struct pass_node
+		{
+			const char* p_name = nullptr;
+			render_queue queue = render_queue::graphics;
+			execute_function execute;
+			std::vector<resource_access> accesses;
+			b8 side_effect = false;
+			b8 culled      = false;
+			b8 async       = false;
+		};
+
+		// What a frame slot's transient images were created for, the placement is reused while it matches.
+		struct transient_key
+		{
+			VkFormat format               = VK_FORMAT_UNDEFINED;
+			VkExtent2D extent             = {};
+			u32 mip_levels                = 1;
+			VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+			VkImageUsageFlags usage_flags = 0;
+			b8 async                      = false;
+			u32 first                     = 0;
+			u32 last                      = 0;
+
+			b8 operator==(const transient_key& other) const noexcept;
+		};
+
+		struct transient_image
+		{
+			VkImage image          = VK_NULL_HANDLE;
+			VkImageView image_view = VK_NULL_HANDLE;
+			u32 memory             = 0;
+			VkDeviceSize offset    = 0;
+			VkDeviceSize size      = 0;
+			std::vector<u32> predecessors; // Images placed in the same memory that are done with it before this one starts.
+		};
+
+		struct frame_slot
+		{
+			std::vector<transient_key> keys;
+			std::vector<transient_image> images;
+			std::vector<std::shared_ptr<vk::gpu_memory>> memory;
+
+			VkCommandPool compute_pool       = VK_NULL_HANDLE;
+			VkCommandBuffer compute_commands = VK_NULL_HANDLE;
+			VkSemaphore compute_finished     = VK_NULL_HANDLE;
+		};
+
+		struct barrier_batch
+		{
+			VkPipelineStageFlags source      = 0;
+			VkPipelineStageFlags destination = 0;
+			std::vector<VkImageMemoryBarrier> image_barriers;
+		};
+
+		void cull_passes();
+		void assign_queues();
+		void compute_lifetimes();
+		void place_transient_images();
+		void destroy_transient_images(frame_slot& slot);
+
+		void add_access(u32 pass, render_resource resource, resource_usage usage, b8 write);
+		void transition(barrier_batch& batch, resource_node& resource, image_state& state, resource_usage usage, render_queue queue, b8 async);
+		void flush(VkCommandBuffer command_buffer, barrier_batch& batch);
+		void record(VkCommandBuffer command_buffer, const pass_node& pass, barrier_batch& batch, b8 async);
+
+		cc_nodiscard const resource_node& get_resource(render_resource resource) const;
+
+		render_graph_create_info m_create_info;
+		std::shared_ptr<graphics_context> m_context;
+		std::shared_ptr<vk::logical_device> m_device;
+		std::shared_ptr<vk::memory_allocator> m_memory_allocator;
+		std::shared_ptr<vk::gpu_profiler> m_gpu_profiler;
+
+		std::vector<frame_slot> m_slots;
+		std::vector<resource_node> m_resources;
+		std::vector<pass_node> m_passes;
+		std::vector<render_resource> m_transients; // The used transient images, by their index in the frame slot.
+
+		graphics_frame m_frame;
+		render_resource m_backbuffer       = invalid_render_resource;
+		VkPipelineStageFlags m_wait_stages = 0; // Where the frame's submission waits for async compute.
+		b8 m_recording                     = false;
+		b8 m_async_compute                 = false;
+
+		render_graph_statistics m_current;
+		mutable std::mutex m_statistics_mutex;
+		render_graph_statistics m_statistics;
+	};
+} // namespace cc
+
+#endif //CAPRICORN_RENDER_GRAPH_HPP
@@ -0,0 +1,27 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_BLOCK_COMPRESSION_HPP
+#define CAPRICORN_BLOCK_COMPRESSION_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/graphics/texture/texture_data.hpp"
+
+namespace cc
+{
+	// Both take 16 RGBA8 texels in row order. BC1 ignores alpha.
+	void encode_bc1_block(const u8* p_texels, u8* p_block);
+	void encode_bc7_block(const u8* p_texels, u8* p_block);
+
+	/**
+	 * @brief Transcodes every level of an RGBA8 texture to a block-compressed encoding.
+	 *
+	 * @details Endpoints come from the principal axis of each block's colours and are refined
+	 * once by least squares. BC7 only uses mode 6, one subset with RGBA endpoints and 4-bit
+	 * indices, which handles smooth content and alpha well but is weaker than a full mode
+	 * search on blocks with several distinct colours. Edge blocks repeat the last row and column.
+	 */
+	cc_nodiscard texture_data compress_texture(const texture_data& texture, texture_encoding encoding);
+} // namespace cc
+
+#endif //CAPRICORN_BLOCK_COMPRESSION_HPP
@@ -0,0 +1,61 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_TEXTURE_DATA_HPP
+#define CAPRICORN_TEXTURE_DATA_HPP
+
+#include "capricorn/base/types.hpp"
+
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace cc
+{
+	enum class texture_encoding : u8
+	{
+		rgba8 = 0,
+		bc1, // 4 bits per texel, opaque.
+		bc7, // 8 bits per texel, with alpha.
+	};
+
+	struct texture_level
+	{
+		u32 width          = 0;
+		u32 height         = 0;
+		std::size_t offset = 0; // Into texture_data::bytes, a multiple of 16 so every level can be copied to the GPU as is.
+		std::size_t size   = 0;
+	};
+
+	// Mip levels stored back to back, largest first.
+	struct texture_data
+	{
+		texture_encoding encoding = texture_encoding::rgba8;
+		std::vector<texture_level> levels;
+		std::vector<u8> bytes;
+
+		cc_nodiscard std::span<const u8> get_level(u32 level) const;
+		cc_nodiscard std::span<u8> get_level(u32 level);
+	};
+
+	cc_nodiscard u32 get_block_size(texture_encoding encoding) noexcept; // Bytes per 4x4 block, zero for uncompressed encodings.
+	cc_nodiscard std::size_t get_level_size(texture_encoding encoding, u32 width, u32 height) noexcept;
+	cc_nodiscard u32 get_mip_count(u32 width, u32 height) noexcept;
+
+	// Decodes any PNG to 8-bit RGBA. Returns nothing for files libpng cannot read.
+	cc_nodiscard std::optional<texture_data> decode_png(std::span<const u8> file);
+
+	// Replaces everything below level 0 with a box-filtered chain down to 1x1. RGB is averaged in linear space when srgb is set.
+	void generate_mips(texture_data& texture, b8 srgb);
+
+	cc_nodiscard b8 is_opaque(const texture_data& texture);
+
+	// The payload of a texture entry in an asset pack, laid out as asset_pack_format describes.
+	cc_nodiscard std::vector<u8> serialize_texture(const texture_data& texture, b8 srgb);
+
+	// Fills in the encoding and levels of a serialized texture without copying it, leaving bytes empty. Level offsets are
+	// then relative to payload. Returns false for payloads that are truncated or inconsistent.
+	cc_nodiscard b8 parse_texture(std::span<const u8> payload, texture_data& texture, b8& srgb);
+} // namespace cc
+
+#endif //CAPRICORN_TEXTURE_DATA_HPP
@@ -0,0 +1,230 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_TEXTURE_STREAMER_HPP
+#define CAPRICORN_TEXTURE_STREAMER_HPP
+
+#include "capricorn/assets/asset_pack.hpp"
+#include "capricorn/graphics/graphics_context.hpp"
+#include "capricorn/graphics/texture/texture_data.hpp"
+#include "capricorn/jobs/job_system.hpp"
+
+#include <chrono>
+#include <deque>
+#include <filesystem>
+
+namespace cc
+{
+	namespace vk
+	{
+		class gpu_image;
+	}
+
+	using texture_handle = u32;
+
+	enum class texture_compression : u8
+	{
+		none = 0,
+		bc1,
+		bc7,
+		automatic, // BC1 for opaque textures, BC7 for the rest.
+	};
+
+	enum class mip_source : u8
+	{
+		cpu = 0, // Box-filtered on the worker that decoded the texture, required for compression.
+		gpu,     // Blitted on the graphics queue, only level 0 is kept and uploaded.
+	};
+
+	struct texture_streamer_create_info
+	{
+		std::weak_ptr<graphics_context> p_context;
+		std::weak_ptr<job_system> p_job_system;
+
+		VkDeviceSize memory_budget      = 256ULL * 1024 * 1024; // Device memory all resident mips together may use.
+		texture_compression compression = texture_compression::none;
+		mip_source mips                 = mip_source::cpu;
+		b8 srgb                         = true;
+
+		u32 tail_size                    = 64; // Mips this size and smaller stay resident for as long as the texture is loaded.
+		u32 max_transitions_per_frame    = 8;
+		VkDeviceSize max_bytes_per_frame = 32ULL * 1024 * 1024; // Bytes staged per frame for mips streaming in.
+		u32 stream_out_delay             = 30;                  // Frames a texture has to be wanted at a lower resolution before it drops mips.
+	};
+
+	struct texture_streaming_statistics
+	{
+		u64 decoded_bytes  = 0; // RGBA8 texels out of the PNG decoder.
+		f64 decode_seconds = 0.0; // Summed over workers.
+		u64 mip_bytes      = 0;
+		f64 mip_seconds    = 0.0;
+		u64 encoded_bytes  = 0; // Block-compressed output.
+		f64 encode_seconds = 0.0;
+		u64 unpacked_bytes = 0; // Taken from asset packs, in place or decompressed.
+		f64 unpack_seconds = 0.0;
+		u64 uploaded_bytes = 0;
+		f64 upload_seconds = 0.0; // Wall time during which at least one upload was in flight.
+
+		u32 loaded         = 0;
+		u32 loading        = 0;
+		u32 failed         = 0;
+		u32 streamed_in    = 0;
+		u32 streamed_out   = 0;
+		u64 resident_bytes = 0;
+		u64 wanted_bytes   = 0; // What the current demand would need without a budget.
+	};
+
+	/**
+	 * @brief Loads PNG textures on the job system and keeps as many of their mips resident as the budget allows.
+	 *
+	 * @details load() returns at once; a job reads and decodes the file, builds the mip chain and
+	 * optionally transcodes it, keeping the result in host memory. Textures baked into an asset
+	 * pack skip all of that: uncompressed entries are uploaded straight from the mapping, the
+	 * rest are only decompressed. update() then makes the texture resident from its tail up, as
+	 * far as the screen-space size reported through request() warrants. When the wanted mips
+	 * exceed memory_budget, the textures that lose the least by dropping a level are cut back first.
+	 *
+	 * Streaming a texture in allocates an image with the new top level and uploads it through
+	 * the upload service, staged on a worker.
+	 * Streaming out copies the remaining levels on the GPU. The previous image is swapped for
+	 * the new one once that finished and destroyed after frames_in_flight frames, so a view
+	 * returned by get_image_view() is only valid for the frame it was fetched in. With the
+	 * context's bindless heap, a texture keeps one index from its first resident mip until it
+	 * is unloaded, and every swap rewrites the descriptor behind it.
+	 *
+	 * Everything but the jobs runs on the thread that submits frames.
+	 */
+	class texture_streamer
+	{
+	public:
+		texture_streamer() = default;
+		~texture_streamer();
+
+		explicit texture_streamer(const texture_streamer_create_info& create_info);
+
+		texture_streamer(const texture_streamer& other)                = delete;
+		texture_streamer(texture_streamer&& other) noexcept            = delete;
+		texture_streamer& operator=(const texture_streamer& other)     = delete;
+		texture_streamer& operator=(texture_streamer&& other) noexcept = delete;
+
+		static std::shared_ptr<texture_streamer> create(const texture_streamer_create_info& create_info);
+
+		cc_nodiscard texture_handle load(const std::filesystem::path& path);
+		cc_nodiscard texture_handle load(std::shared_ptr<const asset_pack> p_pack, std::string_view name); // As baked, whatever the create info asks for.
+		void unload(texture_handle texture);
+
+		// Texels the texture covers on screen along its larger axis, for this frame. Unrequested textures fall back to their tail.
+		void request(texture_handle texture, f32 screen_size);
+
+		// Once per frame after begin_frame(), finishes loads and transitions and starts new ones.
+		void update(const graphics_frame& frame);
+
+		cc_nodiscard b8 is_loaded(texture_handle texture) const;
+		cc_nodiscard b8 is_resident(texture_handle texture) const;
+		cc_nodiscard VkImageView get_image_view(texture_handle texture) const;
+		cc_nodiscard vk::bindless_index get_bindless_index(texture_handle texture) const; // Invalid until resident, or without a bindless heap.
+		cc_nodiscard u32 get_resident_mip(texture_handle texture) const; // Relative to the full chain.
+		cc_nodiscard texture_streaming_statistics get_statistics() const;
+
+		void log_statistics() const;
+
+	private:
+		using clock = std::chrono::steady_clock;
+
+		enum class load_state : u8
+		{
+			loading = 0,
+			ready,
+			failed,
+		};
+
+		enum class transition_kind : u8
+		{
+			upload = 0, // Levels copied from host memory.
+			blit,       // Level 0 uploaded, the rest generated on the GPU.
+			copy,       // Levels taken from the resident image.
+		};
+
+		struct transition
+		{
+			transition_kind kind = transition_kind::upload;
+			u32 mip              = 0;
+			std::shared_ptr<vk::gpu_image> p_image;
+			std::shared_ptr<vk::gpu_image> p_source; // Full chain that blits write to, when it is not the image itself.
+			vk::upload_token token = 0;
+			VkDeviceSize bytes     = 0;
+		};
+
+		struct texture_record
+		{
+			std::filesystem::path path; // The entry name for packed textures.
+			std::shared_ptr<const asset_pack> p_pack;
+			job_counter loading;
+			job_counter staging;
+			std::atomic<load_state> state = load_state::loading;
+			texture_data data;         // Written by the load job until state leaves loading.
+			std::span<const u8> bytes; // What uploads copy from: data.bytes, or the mapped pack entry.
+			VkFormat format = VK_FORMAT_UNDEFINED;
+
+			u32 level_count       = 0;
+			u32 tail_mip          = 0;
+			u32 wanted_mip        = 0;
+			f32 demand            = 0.0F;
+			u32 stream_out_frames = 0;
+			b8 counted            = false;
+			b8 unloading          = false;
+
+			std::shared_ptr<vk::gpu_image> p_image;
+			VkImageView view            = VK_NULL_HANDLE;
+			u32 resident_mip            = 0; // Equal to the level count while nothing is resident.
+			vk::bindless_index bindless = vk::invalid_bindless_index;
+
+			std::optional<transition> pending;
+		};
+
+		struct retired_image
+		{
+			std::shared_ptr<vk::gpu_image> p_image;
+			VkImageView view = VK_NULL_HANDLE;
+			u64 frame_number = 0;
+		};
+
+		cc_nodiscard texture_handle add_record(std::unique_ptr<texture_record> p_record);
+		void load_texture(texture_record& record);
+		void load_packed_texture(texture_record& record);
+		cc_nodiscard b8 balance_residency(); // True while the resident mips exceed the budget.
+		void start_transition(const graphics_frame& frame, texture_record& record);
+		void stage_upload(texture_record& record);
+		void finish_transition(const graphics_frame& frame, texture_record& record);
+		void record_blits(VkCommandBuffer command_buffer, const texture_record& record, const vk::gpu_image& image, VkImageLayout final_layout) const;
+		void record_copy(VkCommandBuffer command_buffer, const vk::gpu_image& source, VkImageLayout source_layout, u32 first_level, const vk::gpu_image& destination) const;
+		void end_upload(VkDeviceSize bytes);
+		void retire(texture_record& record, u64 frame_number);
+		void release_retired(u64 frame_number, b8 all);
+
+		cc_nodiscard std::shared_ptr<vk::gpu_image> create_image(const texture_record& record, u32 mip, u32 level_count, VkImageUsageFlags usage) const;
+		cc_nodiscard VkDeviceSize get_resident_size(const texture_record& record, u32 mip) const;
+		cc_nodiscard VkDeviceSize get_staging_size(const texture_record& record) const; // For the transition to the wanted mip.
+		cc_nodiscard texture_record* find(texture_handle texture) const;
+
+		texture_streamer_create_info m_create_info;
+		std::shared_ptr<graphics_context> m_context;
+		std::shared_ptr<job_system> m_job_system;
+		std::shared_ptr<vk::logical_device> m_device;
+		std::shared_ptr<vk::upload_service> m_upload_service;
+		std::shared_ptr<vk::bindless_heap> m_bindless_heap;
+		b8 m_bc_supported = false;
+
+		std::vector<std::unique_ptr<texture_record>> m_textures; // Indexed by handle, freed slots are null.
+		std::vector<texture_handle> m_free_handles;
+		std::deque<retired_image> m_retired;
+
+		u32 m_uploads_in_flight = 0;
+		clock::time_point m_upload_start;
+
+		mutable std::mutex m_statistics_mutex;
+		texture_streaming_statistics m_statistics;
+	};
+} // namespace cc
+
+#endif //CAPRICORN_TEXTURE_STREAMER_HPP
@@ -0,0 +1,151 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_BINDLESS_HEAP_HPP
+#define CAPRICORN_BINDLESS_HEAP_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/graphics/vulkan/logical_device.hpp"
+
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace cc::vk
+{
+	// Index into one of the heap's arrays, shaders use it as is.
+	using bindless_index = u32;
+
+	constexpr bindless_index invalid_bindless_index = std::numeric_limits<u32>::max();
+
+	struct bindless_heap_create_info
+	{
+		std::weak_ptr<logical_device> p_device;
+
+		u32 max_textures       = 16384; // Clamped to what the device allows for update-after-bind descriptors.
+		u32 max_buffers        = 4096;
+		u32 push_constant_size = 128; // Of the shared pipeline layout, 128 bytes is the least every device offers.
+	};
+
+	struct bindless_heap_statistics
+	{
+		u32 textures       = 0; // Registered right now.
+		u32 buffers        = 0;
+		u32 texture_peak   = 0; // Highest index handed out plus one.
+		u32 buffer_peak    = 0;
+		u64 writes         = 0; // Descriptors written, counting every frame slot.
+		u32 pending_writes = 0; // Waiting for their frame slot to come around.
+		u32 texture_limit  = 0;
+		u32 buffer_limit   = 0;
+	};
+
+	/**
+	 * @brief One descriptor set with every texture and storage buffer in it, indexed from shaders by bindless_index.
+	 *
+	 * @details Binding 0 is an array of combined image samplers, binding 1 an array of storage
+	 * buffers. Both are update-after-bind and partially bound, so entries may be written while
+	 * the set is bound and entries no shader reaches do not have to be valid. Every pipeline
+	 * is created with get_pipeline_layout(), which adds a push constant range for per-draw
+	 * indices, and the set is bound once per command buffer instead of per draw.
+	 *
+	 * There is one set per frame in flight. Writes go to the current frame's set right away
+	 * and to the others once begin_frame() reaches their slot, whose previous frame has then
+	 * finished, so a descriptor is never rewritten while a submitted frame may read it. An
+	 * index stays with its resource until it is released; released indices are handed out
+	 * again only after frames_in_flight frames. A resource that replaces its view or buffer
+	 * has to keep the old one alive for frames_in_flight frames as well.
+	 *
+	 * All calls belong to the thread that submits frames.
+	 */
+	class bindless_heap
+	{
+	public:
+		bindless_heap() = default;
+		~bindless_heap();
+
+		explicit bindless_heap(const bindless_heap_create_info& create_info);
+
+		bindless_heap(const bindless_heap& other)                = delete;
+		bindless_heap(bindless_heap&& other) noexcept            = delete;
+		bindless_heap& operator=(const bindless_heap& other)     = delete;
+		bindless_heap& operator=(bindless_heap&& other) noexcept = delete;
+
+		static std::shared_ptr<bindless_heap> create(const bindless_heap_create_info& create_info);
+
+		// From graphics_context::begin_frame(), after the frame slot's fence was waited for.
+		void begin_frame(u32 frame_index, u64 frame_number);
+
+		// A null sampler uses the heap's default, trilinear and repeating.
+		cc_nodiscard bindless_index add_texture(VkImageView image_view, VkSampler sampler = VK_NULL_HANDLE, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		void update_texture(bindless_index index, VkImageView image_view, VkSampler sampler = VK_NULL_HANDLE, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		void remove_texture(bindless_index index);
+
+		cc_nodiscard bindless_index add_buffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		void update_buffer(bindless_index index, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		void remove_buffer(bindless_index index);
+
+		// Binds the current frame's set as set 0.
+		void bind(VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point) const;
+
+		cc_nodiscard VkDescriptorSetLayout get_set_layout() const noexcept;
+		cc_nodiscard VkPipelineLayout get_pipeline_layout() const noexcept;
+		cc_nodiscard VkDescriptorSet get_set() const noexcept; // Of the current frame.
+		cc_nodiscard bindless_heap_statistics get_statistics() const;
+
+	private:
+		enum binding : u32
+		{
+			texture_binding = 0,
+			buffer_binding  = 1,
+		};
+
+		struct pending_write
+		{
+			u32 binding                   = texture_binding;
+			bindless_index index          = invalid_bindless_index;
+			VkDescriptorImageInfo image   = {};
+			VkDescriptorBufferInfo buffer = {};
+			u32 slots                     = 0; // Frame slots still to write, one bit each.
+		};
+
+		struct index_pool
+		{
+			std::vector<bindless_index> free;
+			std::deque<std::pair<bindless_index, u64>> released; // With the frame they were released in.
+			u32 next  = 0;
+			u32 limit = 0;
+			u32 used  = 0;
+		};
+
+		cc_nodiscard bindless_index allocate(index_pool& pool);
+		void release(index_pool& pool, bindless_index index);
+		void write(pending_write entry);
+		void write_set(VkDescriptorSet set, const pending_write& entry) const;
+
+		bindless_heap_create_info m_create_info;
+		std::shared_ptr<logical_device> m_device;
+
+		VkDescriptorSetLayout m_set_layout = VK_NULL_HANDLE;
+		VkPipelineLayout m_pipeline_layout = VK_NULL_HANDLE;
+		VkDescriptorPool m_descriptor_pool = VK_NULL_HANDLE;
+		VkSampler m_default_sampler        = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSet> m_sets; // Per frame in flight.
+
+		u32 m_frame_index  = 0;
+		u64 m_frame_number = 0;
+		b8 m_frame_begun   = false; // Until the first begin_frame() no set is current and every write waits for its slot.
+
+		index_pool m_textures;
+		index_pool m_buffers;
+		std::vector<pending_write> m_pending;
+
+		mutable std::mutex m_statistics_mutex;
+		bindless_heap_statistics m_statistics;
+	};
+} // namespace cc::vk
+
+#endif //CAPRICORN_BINDLESS_HEAP_HPP
@@ -0,0 +1,100 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_CAPABILITY_CACHE_HPP
+#define CAPRICORN_CAPABILITY_CACHE_HPP
+
+#include "capricorn/base/types.hpp"
+
+#include <array>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace cc::vk
+{
+	struct instance_capabilities
+	{
+		u64 key = 0; // Loader version and the environment that steers driver and layer discovery.
+		std::vector<std::string> layers;
+		std::vector<std::string> extensions;
+	};
+
+	struct device_capabilities
+	{
+		u32 vendor_id                                    = 0;
+		u32 device_id                                    = 0;
+		u32 driver_version                               = 0;
+		std::array<u8, VK_UUID_SIZE> pipeline_cache_uuid = {};
+
+		std::vector<VkQueueFamilyProperties> queue_families;
+		std::vector<std::string> extensions;
+
+		cc_nodiscard b8 matches(const VkPhysicalDeviceProperties& properties) const noexcept;
+	};
+
+	struct capability_cache_create_info
+	{
+		const char* p_path = "capricorn_capabilities.cache";
+	};
+
+	struct capability_cache_statistics
+	{
+		u32 hits   = 0;
+		u32 misses = 0;
+	};
+
+	/**
+	 * @brief On-disk cache of what the Vulkan loader and each physical device support.
+	 *
+	 * @details Devices are keyed by vendor, device ID, driver version and pipeline cache UUID,
+	 * so a driver update invalidates its entry. The instance entry is keyed by the loader
+	 * version and the VK_ICD_FILENAMES / VK_LAYER_PATH family of variables, because those
+	 * decide which drivers and layers the loader finds. Unreadable or outdated files are
+	 * ignored; save() writes to a temporary file and renames it over the old one. Not
+	 * thread-safe; startup hands it from the discovery thread to the main thread.
+	 */
+	class capability_cache
+	{
+	public:
+		capability_cache()  = default;
+		~capability_cache() = default;
+
+		explicit capability_cache(const capability_cache_create_info& create_info);
+
+		capability_cache(const capability_cache& other)                = delete;
+		capability_cache(capability_cache&& other) noexcept            = delete;
+		capability_cache& operator=(const capability_cache& other)     = delete;
+		capability_cache& operator=(capability_cache&& other) noexcept = delete;
+
+		static std::shared_ptr<capability_cache> create(const capability_cache_create_info& create_info);
+
+		static u64 compute_instance_key();
+
+		cc_nodiscard const instance_capabilities* find_instance(u64 key);
+		void store_instance(instance_capabilities capabilities);
+
+		cc_nodiscard const device_capabilities* find_device(const VkPhysicalDeviceProperties& properties);
+		void store_device(device_capabilities capabilities);
+
+		void invalidate();
+		void save();
+
+		cc_nodiscard capability_cache_statistics get_statistics() const noexcept;
+
+	private:
+		void load();
+
+		capability_cache_create_info m_create_info;
+
+		std::optional<instance_capabilities> m_instance;
+		std::vector<device_capabilities> m_devices;
+
+		capability_cache_statistics m_statistics;
+		b8 m_dirty = false;
+	};
+} // namespace cc::vk
+
+#endif //CAPRICORN_CAPABILITY_CACHE_HPP
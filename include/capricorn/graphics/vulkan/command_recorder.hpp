@@ -0,0 +1,141 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_COMMAND_RECORDER_HPP
+#define CAPRICORN_COMMAND_RECORDER_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/graphics/vulkan/logical_device.hpp"
+#include "capricorn/jobs/job_system.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace cc::vk
+{
+	struct command_recorder_create_info
+	{
+		std::weak_ptr<logical_device> p_device;
+		std::weak_ptr<job_system> p_job_system; // Every thread of it gets pools of its own.
+
+		u32 max_recordings_per_frame = 4096; // Secondary command buffers submitted between two execute() calls.
+		u32 allocation_batch         = 16;   // Command buffers a pool allocates at once when it runs out.
+	};
+
+	struct command_recorder_statistics
+	{
+		u64 recorded       = 0;
+		u64 executed       = 0; // Calls to execute() that had anything to execute.
+		u32 allocated      = 0; // Across all pools; they are reset with their pool and reused, never freed.
+		u32 peak_per_frame = 0; // Most recordings one execute() stitched together.
+	};
+
+	/**
+	 * @brief Records secondary command buffers on the job system for the thread that submits frames to stitch together.
+	 *
+	 * @details Each job system thread owns one transient command pool per frame in flight, so
+	 * recording never takes a lock and never shares a pool between threads. begin_frame() resets
+	 * the pools of the frame slot being reused, which keeps their command buffers allocated
+	 * for the next round instead of freeing them.
+	 *
+	 * A finished command buffer is handed over through submit(), which claims an entry of a
+	 * fixed array with a single atomic increment and publishes it with a release store. The
+	 * submitting thread waits for the recording jobs, then execute() sorts the entries by the
+	 * order they were submitted with and records them into its primary command buffer. Orders
+	 * come from reserve_orders(), so the result does not depend on which worker finished first.
+	 *
+	 * begin_frame() and execute() belong to the thread that submits frames, begin() and
+	 * submit() may be called from any thread of the job system in between.
+	 */
+	class command_recorder
+	{
+	public:
+		command_recorder() = default;
+		~command_recorder();
+
+		explicit command_recorder(const command_recorder_create_info& create_info);
+
+		command_recorder(const command_recorder& other)                = delete;
+		command_recorder(command_recorder&& other) noexcept            = delete;
+		command_recorder& operator=(const command_recorder& other)     = delete;
+		command_recorder& operator=(command_recorder&& other) noexcept = delete;
+
+		static std::shared_ptr<command_recorder> create(const command_recorder_create_info& create_info);
+
+		// After graphics_context::begin_frame(), which waited for the GPU to finish with this frame slot.
+		void begin_frame(u32 frame_index);
+
+		// A secondary command buffer from the calling thread's pool, already begun. A render pass in the inheritance info continues it.
+		cc_nodiscard VkCommandBuffer begin(const VkCommandBufferInheritanceInfo& inheritance);
+
+		// Ends the command buffer and hands it to the submitting thread.
+		void submit(VkCommandBuffer command_buffer, u32 order);
+
+		// The first of count consecutive orders, valid until the next execute().
+		cc_nodiscard u32 reserve_orders(u32 count);
+
+		// Records function(command_buffer, begin, end) for every batch of [0, count) in parallel and waits for all of them.
+		template<typename Function>
+		void record(u32 count, u32 batch_size, const VkCommandBufferInheritanceInfo& inheritance, const Function& function);
+
+		// Executes everything submitted since the last call into primary, in order. Returns how many command buffers that was.
+		u32 execute(VkCommandBuffer primary);
+
+		cc_nodiscard command_recorder_statistics get_statistics() const;
+
+	private:
+		struct alignas(64) thread_pool
+		{
+			VkCommandPool command_pool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> command_buffers;
+			u32 used = 0;
+		};
+
+		struct recording
+		{
+			VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+			u32 order                      = 0;
+			std::atomic<b8> ready          = false;
+		};
+
+		cc_nodiscard thread_pool& get_thread_pool();
+
+		command_recorder_create_info m_create_info;
+		std::shared_ptr<logical_device> m_device;
+		std::shared_ptr<job_system> m_job_system;
+
+		std::vector<thread_pool> m_pools; // Per frame in flight, then per thread.
+		u32 m_thread_count = 0;
+		u32 m_frame_index  = 0;
+
+		std::unique_ptr<recording[]> m_recordings;
+		std::atomic<u32> m_recording_count = 0;
+		u32 m_next_order                   = 0;
+		std::atomic<u32> m_allocated       = 0;
+
+		mutable std::mutex m_statistics_mutex;
+		command_recorder_statistics m_statistics;
+	};
+
+	template<typename Function>
+	void command_recorder::record(u32 count, u32 batch_size, const VkCommandBufferInheritanceInfo& inheritance, const Function& function)
+	{
+		batch_size = std::max(batch_size, 1U);
+
+		const u32 first_order                               = reserve_orders((count + batch_size - 1) / batch_size);
+		const VkCommandBufferInheritanceInfo* p_inheritance = &inheritance;
+
+		// Batches start at multiples of batch_size, which gives each one its own order.
+		m_job_system->parallel_for(count, batch_size, [this, first_order, batch_size, p_inheritance, &function](u32 begin, u32 end) {
+			const VkCommandBuffer command_buffer = this->begin(*p_inheritance);
+			function(command_buffer, begin, end);
+			submit(command_buffer, first_order + begin / batch_size);
+		});
+	}
+} // namespace cc::vk
+
+#endif //CAPRICORN_COMMAND_RECORDER_HPP
@@ -0,0 +1,193 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_DISPATCH_TABLE_HPP
+#define CAPRICORN_DISPATCH_TABLE_HPP
+
+#include "capricorn/base/types.hpp"
+
+#include <vulkan/vulkan.h>
+
+/**
+ * The Vulkan functions the engine calls, from which the dispatch tables below are generated.
+ * A function the engine starts using has to be added to one of these lists first.
+ */
+
+// Core Vulkan 1.0 instance functions, every loader has them.
+#define cc_vk_instance_functions(function)             \
+	function(vkDestroyInstance)                        \
+	function(vkEnumeratePhysicalDevices)               \
+	function(vkEnumerateDeviceExtensionProperties)     \
+	function(vkGetPhysicalDeviceProperties)            \
+	function(vkGetPhysicalDeviceFeatures)              \
+	function(vkGetPhysicalDeviceMemoryProperties)      \
+	function(vkGetPhysicalDeviceFormatProperties)      \
+	function(vkGetPhysicalDeviceQueueFamilyProperties) \
+	function(vkCreateDevice)                           \
+	function(vkGetDeviceProcAddr)
+
+// From instance extensions, only valid when the extension was enabled.
+#define cc_vk_instance_extension_functions(function)    \
+	function(vkDestroySurfaceKHR)                       \
+	function(vkGetPhysicalDeviceSurfaceSupportKHR)      \
+	function(vkGetPhysicalDeviceSurfaceCapabilitiesKHR) \
+	function(vkGetPhysicalDeviceSurfaceFormatsKHR)      \
+	function(vkGetPhysicalDeviceSurfacePresentModesKHR) \
+	function(vkCreateHeadlessSurfaceEXT)                \
+	function(vkCreateDebugUtilsMessengerEXT)            \
+	function(vkDestroyDebugUtilsMessengerEXT)           \
+	function(vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)
+
+// Promoted to core in the given version, loaded under the extension's name before it.
+#define cc_vk_instance_promoted_functions(function)                 \
+	function(vkGetPhysicalDeviceFeatures2, KHR, VK_API_VERSION_1_1) \
+	function(vkGetPhysicalDeviceProperties2, KHR, VK_API_VERSION_1_1)
+
+// Core Vulkan 1.0 device functions.
+#define cc_vk_device_functions(function)     \
+	function(vkDestroyDevice)                \
+	function(vkGetDeviceQueue)               \
+	function(vkDeviceWaitIdle)               \
+	function(vkQueueSubmit)                  \
+	function(vkQueueWaitIdle)                \
+	function(vkCreateFence)                  \
+	function(vkDestroyFence)                 \
+	function(vkResetFences)                  \
+	function(vkGetFenceStatus)               \
+	function(vkWaitForFences)                \
+	function(vkCreateSemaphore)              \
+	function(vkDestroySemaphore)             \
+	function(vkAllocateMemory)               \
+	function(vkFreeMemory)                   \
+	function(vkMapMemory)                    \
+	function(vkUnmapMemory)                  \
+	function(vkFlushMappedMemoryRanges)      \
+	function(vkInvalidateMappedMemoryRanges) \
+	function(vkBindBufferMemory)             \
+	function(vkBindImageMemory)              \
+	function(vkCreateBuffer)                 \
+	function(vkDestroyBuffer)                \
+	function(vkCreateImage)                  \
+	function(vkDestroyImage)                 \
+	function(vkGetBufferMemoryRequirements)  \
+	function(vkGetImageMemoryRequirements)   \
+	function(vkCreateImageView)              \
+	function(vkDestroyImageView)             \
+	function(vkCreateSampler)                \
+	function(vkDestroySampler)               \
+	function(vkCreateQueryPool)              \
+	function(vkDestroyQueryPool)             \
+	function(vkGetQueryPoolResults)          \
+	function(vkCreateShaderModule)           \
+	function(vkDestroyShaderModule)          \
+	function(vkCreatePipelineCache)          \
+	function(vkDestroyPipelineCache)         \
+	function(vkGetPipelineCacheData)         \
+	function(vkMergePipelineCaches)          \
+	function(vkCreateGraphicsPipelines)      \
+	function(vkCreateComputePipelines)       \
+	function(vkDestroyPipeline)              \
+	function(vkCreatePipelineLayout)         \
+	function(vkDestroyPipelineLayout)        \
+	function(vkCreateDescriptorSetLayout)    \
+	function(vkDestroyDescriptorSetLayout)   \
+	function(vkCreateDescriptorPool)         \
+	function(vkDestroyDescriptorPool)        \
+	function(vkAllocateDescriptorSets)       \
+	function(vkUpdateDescriptorSets)         \
+	function(vkCreateRenderPass)             \
+	function(vkDestroyRenderPass)            \
+	function(vkCreateFramebuffer)            \
+	function(vkDestroyFramebuffer)           \
+	function(vkCreateCommandPool)            \
+	function(vkDestroyCommandPool)           \
+	function(vkResetCommandPool)             \
+	function(vkAllocateCommandBuffers)       \
+	function(vkFreeCommandBuffers)           \
+	function(vkBeginCommandBuffer)           \
+	function(vkEndCommandBuffer)             \
+	function(vkResetCommandBuffer)           \
+	function(vkCmdBindPipeline)              \
+	function(vkCmdBindDescriptorSets)        \
+	function(vkCmdBindVertexBuffers)         \
+	function(vkCmdBindIndexBuffer)           \
+	function(vkCmdPushConstants)             \
+	function(vkCmdSetViewport)               \
+	function(vkCmdSetScissor)                \
+	function(vkCmdDraw)                      \
+	function(vkCmdDrawIndexed)               \
+	function(vkCmdDrawIndexedIndirect)       \
+	function(vkCmdDispatch)                  \
+	function(vkCmdBeginRenderPass)           \
+	function(vkCmdEndRenderPass)             \
+	function(vkCmdExecuteCommands)           \
+	function(vkCmdPipelineBarrier)           \
+	function(vkCmdCopyBuffer)                \
+	function(vkCmdCopyImage)                 \
+	function(vkCmdCopyBufferToImage)         \
+	function(vkCmdBlitImage)                 \
+	function(vkCmdClearColorImage)           \
+	function(vkCmdFillBuffer)                \
+	function(vkCmdResetQueryPool)            \
+	function(vkCmdWriteTimestamp)
+
+// From device extensions, null unless the extension was enabled.
+#define cc_vk_device_extension_functions(function) \
+	function(vkCreateSwapchainKHR)                 \
+	function(vkDestroySwapchainKHR)                \
+	function(vkGetSwapchainImagesKHR)              \
+	function(vkAcquireNextImageKHR)                \
+	function(vkQueuePresentKHR)                    \
+	function(vkGetCalibratedTimestampsEXT)
+
+// Promoted to core in the given version, loaded under the extension's name before it.
+#define cc_vk_device_promoted_functions(function)                     \
+	function(vkWaitSemaphores, KHR, VK_API_VERSION_1_2)               \
+	function(vkCmdDrawIndexedIndirectCount, KHR, VK_API_VERSION_1_2)  \
+	function(vkGetBufferMemoryRequirements2, KHR, VK_API_VERSION_1_1) \
+	function(vkGetImageMemoryRequirements2, KHR, VK_API_VERSION_1_1)  \
+	function(vkBindBufferMemory2, KHR, VK_API_VERSION_1_1)            \
+	function(vkBindImageMemory2, KHR, VK_API_VERSION_1_1)
+
+#define cc_vk_dispatch_member(name, ...) PFN_##name name = nullptr;
+
+namespace cc::vk
+{
+	/**
+	 * @brief Instance-level functions, resolved for one VkInstance.
+	 *
+	 * @details Functions taking a VkPhysicalDevice go through the loader's trampoline either
+	 * way, the table spares the engine a second one in the statically linked loader library.
+	 * vkGetDeviceProcAddr from here returns the driver's own entry points.
+	 */
+	struct instance_dispatch
+	{
+		cc_vk_instance_functions(cc_vk_dispatch_member)
+		cc_vk_instance_extension_functions(cc_vk_dispatch_member)
+		cc_vk_instance_promoted_functions(cc_vk_dispatch_member)
+
+		// api_version is the one the instance was created with, it decides under which name promoted functions are loaded.
+		void load(VkInstance instance, u32 api_version);
+	};
+
+	/**
+	 * @brief Device-level functions, resolved for one VkDevice.
+	 *
+	 * @details Loaded straight from the driver through vkGetDeviceProcAddr, so calls skip the
+	 * loader's dispatch on the device handle, and tables of different devices never mix. Every
+	 * logical_device has one, see logical_device::get_dispatch().
+	 */
+	struct device_dispatch
+	{
+		cc_vk_device_functions(cc_vk_dispatch_member)
+		cc_vk_device_extension_functions(cc_vk_dispatch_member)
+		cc_vk_device_promoted_functions(cc_vk_dispatch_member)
+
+		// api_version is the device's usable version, functions of extensions that were not enabled stay null.
+		void load(PFN_vkGetDeviceProcAddr get_device_proc_addr, VkDevice device, u32 api_version);
+	};
+} // namespace cc::vk
+
+#undef cc_vk_dispatch_member
+
+#endif //CAPRICORN_DISPATCH_TABLE_HPP
@@ -0,0 +1,125 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_GPU_CULLER_HPP
+#define CAPRICORN_GPU_CULLER_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/graphics/vulkan/logical_device.hpp"
+#include "capricorn/math/culling.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace cc::vk
+{
+	class gpu_buffer;
+
+	struct gpu_culler_create_info
+	{
+		std::weak_ptr<logical_device> p_device;
+
+		u32 capacity = 131'072; // Objects, the device buffers are sized for it up front.
+	};
+
+	// What the culler knows of an object: the sphere it is tested with and the indexed draw it issues when visible.
+	struct gpu_cull_object
+	{
+		glm::vec3 center  = glm::vec3(0.0F);
+		f32 radius        = 0.0F;
+		u32 index_count   = 0;
+		u32 first_index   = 0;
+		i32 vertex_offset = 0;
+	};
+
+	/**
+	 * @brief Frustum culls objects on the GPU and draws the survivors with a single indirect draw.
+	 *
+	 * @details Bounding spheres and the objects' draws live in device-local storage buffers. Each
+	 * frame, cull() records a compute dispatch testing every object against the frustum and
+	 * appending the draws of the visible ones to an indirect buffer, counted atomically, and
+	 * draw() submits them with vkCmdDrawIndexedIndirectCount. Recording is then the same few
+	 * commands however many objects there are, where CPU submission pays for one draw each.
+	 *
+	 * Objects changed since the last frame are copied from a per-frame staging buffer at the
+	 * start of cull(), in the frame's own command buffer, so no frame in flight sees a half
+	 * written buffer. The buffers are movable: once defragmentation has moved them, each frame's
+	 * descriptor set is rewritten when the frame comes around again, and the objects are
+	 * uploaded in full to their new place. The draws carry the object's index as their first instance, for the
+	 * vertex shader to fetch per-object data by gl_InstanceIndex, where drawIndirectFirstInstance
+	 * is supported; otherwise it is zero. Survivors are drawn in no particular order.
+	 *
+	 * Requires multiDrawIndirect and drawIndirectCount, see is_supported().
+	 */
+	class gpu_culler
+	{
+	public:
+		static constexpr u32 workgroup_size = 64; // The cull shader's local size.
+
+		gpu_culler() = default;
+		~gpu_culler();
+
+		explicit gpu_culler(const gpu_culler_create_info& create_info);
+
+		gpu_culler(const gpu_culler& other)                = delete;
+		gpu_culler(gpu_culler&& other) noexcept            = delete;
+		gpu_culler& operator=(const gpu_culler& other)     = delete;
+		gpu_culler& operator=(gpu_culler&& other) noexcept = delete;
+
+		static std::shared_ptr<gpu_culler> create(const gpu_culler_create_info& create_info);
+
+		cc_nodiscard static b8 is_supported(const logical_device& device) noexcept;
+
+		cc_nodiscard u32 add(const gpu_cull_object& object);
+		void set(u32 index, const gpu_cull_object& object);
+		void clear() noexcept;
+
+		// Outside a render pass. Uploads what changed and culls into the indirect buffer.
+		void cull(VkCommandBuffer command_buffer, u32 frame_index, const math::frustum& frustum);
+
+		// Inside the render pass, after cull() and with the pipeline and index buffer bound.
+		void draw(VkCommandBuffer command_buffer) const;
+
+		cc_nodiscard u32 get_count() const noexcept;
+		cc_nodiscard u32 get_capacity() const noexcept;
+
+	private:
+		void create_pipeline();
+		void create_descriptors();
+		void update_descriptors(u32 frame_index);
+		void upload(VkCommandBuffer command_buffer, u32 frame_index);
+
+		gpu_culler_create_info m_create_info;
+		std::shared_ptr<logical_device> m_device;
+
+		std::shared_ptr<gpu_buffer> m_bounds;               // Spheres as center and radius.
+		std::shared_ptr<gpu_buffer> m_draws;                // VkDrawIndexedIndirectCommand per object.
+		std::shared_ptr<gpu_buffer> m_visible;              // The draws of the visible objects, compacted.
+		std::shared_ptr<gpu_buffer> m_counter;              // How many of them there are.
+		std::vector<std::shared_ptr<gpu_buffer>> m_staging; // Per frame in flight, grown to fit the largest upload.
+
+		VkDescriptorSetLayout m_set_layout = VK_NULL_HANDLE;
+		VkDescriptorPool m_descriptor_pool = VK_NULL_HANDLE;
+		VkPipelineLayout m_pipeline_layout = VK_NULL_HANDLE;
+		VkPipeline m_pipeline              = VK_NULL_HANDLE;
+
+		// Per frame in flight, with the buffer handles each was last written with.
+		std::vector<VkDescriptorSet> m_sets;
+		std::vector<std::array<VkBuffer, 4>> m_set_buffers;
+
+		// CPU copies, the range that changed is uploaded on the next cull().
+		std::vector<glm::vec4> m_spheres;
+		std::vector<VkDrawIndexedIndirectCommand> m_commands;
+		u32 m_dirty_begin          = 0;
+		u32 m_dirty_end            = 0;
+		VkBuffer m_uploaded_bounds = VK_NULL_HANDLE; // Where the CPU copies were uploaded to, they move with defragmentation.
+		VkBuffer m_uploaded_draws  = VK_NULL_HANDLE;
+		b8 m_first_instance        = false;
+	};
+} // namespace cc::vk
+
+#endif //CAPRICORN_GPU_CULLER_HPP
@@ -0,0 +1,166 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_GPU_PROFILER_HPP
+#define CAPRICORN_GPU_PROFILER_HPP
+
+#include "capricorn/base/profiler.hpp"
+#include "capricorn/base/types.hpp"
+#include "capricorn/graphics/vulkan/logical_device.hpp"
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+/**
+ * Scoped GPU zones, timed with timestamps written into command_buffer. A null profiler records
+ * nothing, e.g. on devices without timestamp support.
+ */
+#if CAPRICORN_PROFILER_ENABLED
+	#define cc_profile_gpu_zone(p_profiler, command_buffer, name)                                                                     \
+		static constexpr ::cc::profile_zone_site cc_profile_concat(cc_profile_gpu_site_, __LINE__) = { name, __FILE__, __LINE__ }; \
+		const ::cc::vk::gpu_profile_scope cc_profile_concat(cc_profile_gpu_scope_, __LINE__)(p_profiler, command_buffer, cc_profile_concat(cc_profile_gpu_site_, __LINE__))
+#else
+	#define cc_profile_gpu_zone(p_profiler, command_buffer, name) static_cast<void>(0)
+#endif
+
+namespace cc::vk
+{
+	using gpu_zone = u32;
+
+	constexpr gpu_zone invalid_gpu_zone = std::numeric_limits<u32>::max();
+
+	struct gpu_profiler_create_info
+	{
+		std::weak_ptr<logical_device> p_device;
+
+		u32 max_zones_per_frame = 512; // Later zones of a frame are not timed.
+	};
+
+	struct gpu_profiler_statistics
+	{
+		u64 resolved         = 0; // Zones handed to the profiler.
+		u64 overflowed       = 0; // Zones beyond max_zones_per_frame.
+		u64 unavailable      = 0; // Zones whose timestamps were never written, e.g. because they were not submitted.
+		b8 calibrated        = false; // Whether VK_EXT_calibrated_timestamps lines the GPU clock up with the CPU's.
+		f64 max_deviation_us = 0.0;   // Of the last calibration.
+	};
+
+	/**
+	 * @brief Times GPU work with timestamp queries and hands the zones to cc::profiler.
+	 *
+	 * @details Every frame in flight has a query pool with two queries per zone. begin_frame()
+	 * reads the results of the frame that used the slot before, which its fence has finished,
+	 * and resets the pool in the frame's command buffer. Zones take their queries from an
+	 * atomic counter, so they may be recorded into secondary command buffers on any thread, as
+	 * long as those execute on the graphics queue within the frame's submission; work on other
+	 * queues may run before the reset and cannot be timed.
+	 *
+	 * GPU timestamps are converted to the CPU clock cc::profiler uses. With
+	 * VK_EXT_calibrated_timestamps both clocks are sampled together on every resolve. Without
+	 * it the first zone of the frame, which graphics_context opens around the whole frame, is
+	 * taken to start when the frame was submitted, so GPU zones may appear somewhat early.
+	 *
+	 * begin_frame() and end_frame() belong to the thread that submits frames.
+	 */
+	class gpu_profiler
+	{
+	public:
+		gpu_profiler() = default;
+		~gpu_profiler();
+
+		explicit gpu_profiler(const gpu_profiler_create_info& create_info);
+
+		gpu_profiler(const gpu_profiler& other)                = delete;
+		gpu_profiler(gpu_profiler&& other) noexcept            = delete;
+		gpu_profiler& operator=(const gpu_profiler& other)     = delete;
+		gpu_profiler& operator=(gpu_profiler&& other) noexcept = delete;
+
+		static std::shared_ptr<gpu_profiler> create(const gpu_profiler_create_info& create_info);
+
+		// Whether the graphics queue writes timestamps.
+		cc_nodiscard static b8 is_supported(const logical_device& device);
+
+		// From graphics_context::begin_frame(), after the frame slot's fence was waited for, into the frame's command buffer.
+		void begin_frame(VkCommandBuffer command_buffer, u32 frame_index);
+
+		// Right before the frame is submitted.
+		void end_frame();
+
+		cc_nodiscard gpu_zone begin_zone(VkCommandBuffer command_buffer, const profile_zone_site& site);
+		void end_zone(VkCommandBuffer command_buffer, gpu_zone zone);
+
+		cc_nodiscard gpu_profiler_statistics get_statistics() const;
+
+	private:
+		struct frame_slot
+		{
+			VkQueryPool query_pool = VK_NULL_HANDLE;
+			std::vector<const profile_zone_site*> sites;
+			u32 zone_count         = 0;
+			i64 submit_ns          = 0; // When the slot's last frame was submitted.
+			b8 submitted           = false;
+		};
+
+		b8 calibrate();
+		void resolve(frame_slot& slot);
+
+		cc_nodiscard i64 to_host_ns(u64 timestamp) const noexcept;
+
+		gpu_profiler_create_info m_create_info;
+		std::shared_ptr<logical_device> m_device;
+
+		std::vector<frame_slot> m_slots;
+		std::vector<u64> m_results; // Value and availability of every query of a slot.
+		u32 m_frame_index             = 0;
+		std::atomic<u32> m_zone_count = 0;
+
+		f64 m_timestamp_period = 1.0; // Nanoseconds per tick.
+		u64 m_timestamp_mask   = std::numeric_limits<u64>::max();
+		u64 m_reference_ticks  = 0; // A GPU timestamp and the CPU time it corresponds to, in nanoseconds.
+		i64 m_reference_ns     = 0;
+
+		PFN_vkGetCalibratedTimestampsEXT m_get_calibrated_timestamps = nullptr;
+		VkTimeDomainEXT m_host_domain                                = VK_TIME_DOMAIN_DEVICE_EXT;
+		i64 m_host_ticks_per_second                                  = 1'000'000'000;
+
+		mutable std::mutex m_statistics_mutex;
+		gpu_profiler_statistics m_statistics;
+	};
+
+	// Times a zone from construction to destruction, see cc_profile_gpu_zone.
+	class gpu_profile_scope
+	{
+	public:
+		gpu_profile_scope(gpu_profiler* p_profiler, VkCommandBuffer command_buffer, const profile_zone_site& site)
+		    : m_p_profiler(p_profiler),
+		      m_command_buffer(command_buffer),
+		      m_zone(p_profiler != nullptr ? p_profiler->begin_zone(command_buffer, site) : invalid_gpu_zone)
+		{
+		}
+
+		~gpu_profile_scope()
+		{
+			if (m_zone != invalid_gpu_zone)
+			{
+				m_p_profiler->end_zone(m_command_buffer, m_zone);
+			}
+		}
+
+		gpu_profile_scope(const gpu_profile_scope& other)                = delete;
+		gpu_profile_scope(gpu_profile_scope&& other) noexcept            = delete;
+		gpu_profile_scope& operator=(const gpu_profile_scope& other)     = delete;
+		gpu_profile_scope& operator=(gpu_profile_scope&& other) noexcept = delete;
+
+	private:
+		gpu_profiler* m_p_profiler;
+		VkCommandBuffer m_command_buffer;
+		gpu_zone m_zone;
+	};
+} // namespace cc::vk
+
+#endif //CAPRICORN_GPU_PROFILER_HPP
@@ -0,0 +1,165 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_HOST_ALLOCATOR_HPP
+#define CAPRICORN_HOST_ALLOCATOR_HPP
+
+#include "capricorn/base/types.hpp"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace cc::vk
+{
+	// One per VkSystemAllocationScope, which the enum's values index.
+	constexpr u32 allocation_scope_count = 5;
+
+	struct host_allocator_create_info
+	{
+		u32 chunk_size       = 64 * 1024; // Carved into blocks of one size class at a time.
+		u32 cache_batch_size = 32;        // Blocks a thread cache takes from or returns to the shared pool at once.
+	};
+
+	struct host_scope_statistics
+	{
+		u64 current          = 0; // Bytes the driver holds.
+		u64 peak             = 0;
+		u64 allocations      = 0;
+		u64 reallocations    = 0;
+		u64 frees            = 0;
+		u64 internal_current = 0; // Reported through the internal allocation notifications, e.g. executable memory.
+		u64 internal_peak    = 0;
+	};
+
+	struct host_allocator_statistics
+	{
+		std::array<host_scope_statistics, allocation_scope_count> scopes = {};
+
+		u64 reserved          = 0; // Chunks and large allocations taken from the system.
+		u64 large_allocations = 0; // Too big for the largest size class.
+		u64 in_place_reallocs = 0; // Reallocations the block already had room for.
+		u64 cache_refills     = 0; // Trips of a thread cache to the shared pool, each under its lock.
+		u32 threads           = 0; // Thread caches created.
+	};
+
+	/**
+	 * @brief Host memory for the Vulkan driver, handed to it through VkAllocationCallbacks.
+	 *
+	 * @details Requests up to max_pooled_size bytes come from power-of-two size classes, carved
+	 * from chunks that are only returned when the allocator is destroyed. Every thread keeps a
+	 * cache of free blocks per class, so the driver allocating and freeing from its threads
+	 * only takes the shared lock once per cache_batch_size blocks. Larger requests go straight
+	 * to aligned operator new.
+	 *
+	 * Each block starts with a header that records its class, the requested size and scope, so
+	 * frees need no size and a reallocation that still fits its pooled block, at the requested
+	 * alignment, happens in place. Bytes, peaks and counts are kept per
+	 * VkSystemAllocationScope, which tells apart what pipeline and descriptor creation churn
+	 * through (command and object scope) from what the device keeps for its lifetime.
+	 *
+	 * The allocator has to outlive the instance, every device and every object created with
+	 * its callbacks.
+	 */
+	class host_allocator
+	{
+	public:
+		static constexpr std::size_t min_block_size  = 32;
+		static constexpr std::size_t max_pooled_size = 16 * 1024;
+		static constexpr u32 size_class_count        = 10; // 32 bytes to max_pooled_size.
+
+		host_allocator();
+		~host_allocator();
+
+		explicit host_allocator(const host_allocator_create_info& create_info);
+
+		host_allocator(const host_allocator& other)                = delete;
+		host_allocator(host_allocator&& other) noexcept            = delete;
+		host_allocator& operator=(const host_allocator& other)     = delete;
+		host_allocator& operator=(host_allocator&& other) noexcept = delete;
+
+		static std::unique_ptr<host_allocator> create(const host_allocator_create_info& create_info);
+
+		// Points back at this allocator, pass it wherever Vulkan takes a pAllocator.
+		cc_nodiscard const VkAllocationCallbacks* get_callbacks() const noexcept;
+
+		cc_nodiscard void* allocate(std::size_t size, std::size_t alignment, VkSystemAllocationScope scope) noexcept;
+		cc_nodiscard void* reallocate(void* p_original, std::size_t size, std::size_t alignment, VkSystemAllocationScope scope) noexcept;
+		void free(void* p_memory) noexcept;
+
+		cc_nodiscard host_allocator_statistics get_statistics() const;
+		void log_statistics() const;
+
+		static const char* get_scope_name(VkSystemAllocationScope scope) noexcept;
+
+	private:
+		struct free_block
+		{
+			free_block* p_next;
+		};
+
+		struct thread_cache
+		{
+			std::array<free_block*, size_class_count> free_lists = {};
+			std::array<u32, size_class_count> counts             = {};
+		};
+
+		struct alignas(64) scope_counters
+		{
+			std::atomic<u64> current          = 0;
+			std::atomic<u64> peak             = 0;
+			std::atomic<u64> allocations      = 0;
+			std::atomic<u64> reallocations    = 0;
+			std::atomic<u64> frees            = 0;
+			std::atomic<u64> internal_current = 0;
+			std::atomic<u64> internal_peak    = 0;
+		};
+
+		static VKAPI_ATTR void* VKAPI_CALL allocation_callback(void* p_user_data, std::size_t size, std::size_t alignment, VkSystemAllocationScope scope);
+		static VKAPI_ATTR void* VKAPI_CALL reallocation_callback(void* p_user_data, void* p_original, std::size_t size, std::size_t alignment, VkSystemAllocationScope scope);
+		static VKAPI_ATTR void VKAPI_CALL free_callback(void* p_user_data, void* p_memory);
+		static VKAPI_ATTR void VKAPI_CALL internal_allocation_callback(void* p_user_data, std::size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+		static VKAPI_ATTR void VKAPI_CALL internal_free_callback(void* p_user_data, std::size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+		static void raise_peak(std::atomic<u64>& peak, u64 value) noexcept;
+
+		// Neither counts, allocate(), reallocate() and free() do.
+		cc_nodiscard void* allocate_block(std::size_t size, std::size_t alignment, VkSystemAllocationScope scope) noexcept;
+		void release_block(void* p_memory) noexcept;
+
+		cc_nodiscard thread_cache* get_thread_cache() noexcept;
+		cc_nodiscard void* pop_block(u32 size_class) noexcept;
+		void push_block(u32 size_class, void* p_block) noexcept;
+		void refill(thread_cache& cache, u32 size_class) noexcept;
+		void drain(thread_cache& cache, u32 size_class, u32 count) noexcept;
+		cc_nodiscard b8 grow(u32 size_class) noexcept;
+
+		void count_allocation(VkSystemAllocationScope scope, u64 size) noexcept;
+		void count_free(VkSystemAllocationScope scope, u64 size) noexcept;
+		void count_reallocation(VkSystemAllocationScope original_scope, u64 original_size, VkSystemAllocationScope scope, u64 size) noexcept;
+
+		host_allocator_create_info m_create_info;
+		VkAllocationCallbacks m_callbacks = {};
+		u64 m_id                          = 0; // Tells the thread caches of different allocators apart.
+
+		// The shared pool, behind m_mutex.
+		mutable std::mutex m_mutex;
+		std::array<free_block*, size_class_count> m_free_lists = {};
+		std::vector<std::byte*> m_chunks;
+		std::unordered_map<std::thread::id, std::unique_ptr<thread_cache>> m_thread_caches;
+		u64 m_cache_refills = 0;
+
+		std::array<scope_counters, allocation_scope_count> m_scopes;
+		std::atomic<u64> m_reserved          = 0;
+		std::atomic<u64> m_large_allocations = 0;
+		std::atomic<u64> m_in_place_reallocs = 0;
+	};
+} // namespace cc::vk
+
+#endif //CAPRICORN_HOST_ALLOCATOR_HPP
@@ -5,18 +5,14 @@
 #define CAPRICORN_INSTANCE_HPP
 
 #include "capricorn/base/types.hpp"
+#include "capricorn/graphics/vulkan/dispatch_table.hpp"
+#include "capricorn/graphics/vulkan/validation.hpp"
 
 #include <vulkan/vulkan.h>
 
 namespace cc::vk
 {
-	namespace details
-	{
-		VKAPI_ATTR VkBool32 VKAPI_CALL default_debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
-		                                                      VkDebugUtilsMessageTypeFlagsEXT message_type,
-		                                                      const VkDebugUtilsMessengerCallbackDataEXT* p_callback_data,
-		                                                      void* p_user_data);
-	}
+	class capability_cache;
 
 	enum class instance_create_flags
 	{
@@ -30,14 +26,14 @@ namespace cc::vk
 		const char* p_engine_name;
 		u32 application_version;
 		u32 engine_version;
-		u32 api_version;
+		u32 api_version; // The highest version the engine asks for, the instance uses what the loader supports up to it.
 
 		// Vulkan instance information.
 		std::vector<const char*> enabled_layers;
 		std::vector<const char*> enabled_extensions;
 		instance_create_flags flags = static_cast<instance_create_flags>(0);
 
-		// Validation features.
+		// Validation features, chained into the instance through VK_EXT_validation_features when any is set.
 		std::vector<VkValidationCheckEXT> disabled_validation_checks;
 		std::vector<VkValidationFeatureEnableEXT> enabled_validation_features;
 		std::vector<VkValidationFeatureDisableEXT> disabled_validation_features;
@@ -46,22 +42,29 @@ namespace cc::vk
 		VkDebugUtilsMessageSeverityFlagsEXT message_severity          = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
 		VkDebugUtilsMessageTypeFlagsEXT message_type                  = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
 		VkDebugUtilsMessengerCallbackDataFlagsEXT callback_data_flags = 0;
-		PFN_vkDebugUtilsMessengerCallbackEXT debug_callback           = details::default_debug_callback;
+		PFN_vkDebugUtilsMessengerCallbackEXT debug_callback           = nullptr; // Null logs through a debug_message_filter the instance owns.
 		void* p_user_data                                             = nullptr;
+		debug_message_filter_create_info message_filter;
 
 		b8 validation_layers_enabled   = false;
 		b8 validation_layers_requested = false;
 		b8 debug_messenger_enabled     = false;
 
-		// Custom allocator.
-		VkAllocationCallbacks* p_allocator = nullptr;
+		// Skips the window-system extensions GLFW asks for and enables VK_EXT_headless_surface when the driver offers it.
+		b8 headless = false;
+
+		// Host memory callbacks, used for the instance and everything created from it. Have to outlive the instance.
+		const VkAllocationCallbacks* p_allocator = nullptr;
+
+		// Answers layer and extension queries from disk when the loader environment has not changed.
+		capability_cache* p_capability_cache = nullptr;
 	};
 
 	class instance
 	{
 	public:
-		instance()  = default;
-		~instance() = default;
+		instance() = default;
+		~instance();
 
 		explicit instance(const instance_create_info& params);
 
@@ -76,18 +79,25 @@ namespace cc::vk
 
 		cc_nodiscard std::weak_ptr<VkInstance> get_handle() const noexcept;
 		cc_nodiscard b8 validation_layers_enabled() const noexcept;
+		cc_nodiscard b8 headless_surface_enabled() const noexcept;
+		cc_nodiscard b8 properties2_enabled() const noexcept; // Through the extension, or in core since Vulkan 1.1.
+		cc_nodiscard u32 get_api_version() const noexcept;  // Negotiated with the loader.
+		cc_nodiscard const instance_dispatch& get_dispatch() const noexcept;
+		cc_nodiscard const VkAllocationCallbacks* get_allocation_callbacks() const noexcept; // Null when the driver allocates for itself.
+		cc_nodiscard const debug_message_filter* get_message_filter() const noexcept;       // Null without a messenger or with a callback of the caller's.
 
 	private:
 		std::shared_ptr<VkInstance> m_instance                      = VK_NULL_HANDLE;
 		std::shared_ptr<VkDebugUtilsMessengerEXT> m_debug_messenger = VK_NULL_HANDLE;
 		std::shared_ptr<VkAllocationCallbacks> m_allocator          = VK_NULL_HANDLE;
-		PFN_vkGetInstanceProcAddr m_get_instance_proc_addr          = VK_NULL_HANDLE;
-		PFN_vkGetDeviceProcAddr m_get_device_proc_addr              = VK_NULL_HANDLE;
+		std::unique_ptr<debug_message_filter> m_message_filter;
+		instance_dispatch m_dispatch;
 
 		b8 m_validation_layers_enabled = false;
-		b8 properties2_ext_supported   = false;
-		u32 instance_version           = VK_API_VERSION_1_0;
-		u32 api_version                = VK_API_VERSION_1_0;
+		b8 m_headless_surface_enabled  = false;
+		b8 m_properties2_ext_supported = false;
+		u32 m_instance_version         = VK_API_VERSION_1_0;
+		u32 m_api_version              = VK_API_VERSION_1_0;
 	};
 } // namespace cc::vk
 
@@ -45,8 +45,9 @@ namespace cc::vk
 		instance_configurator& set_validation_layers_enabled(b8 enabled);
 		instance_configurator& set_validation_layers_requested(b8 requested);
 		instance_configurator& set_debug_messenger_enabled(b8 enabled);
+		instance_configurator& set_headless(b8 headless);
 
-		instance_configurator& set_allocator(VkAllocationCallbacks* allocator);
+		instance_configurator& set_allocator(const VkAllocationCallbacks* allocator);
 
 	private:
 		instance_create_info m_info;
@@ -5,26 +5,151 @@
 #define CAPRICORN_LOGICAL_DEVICE_HPP
 
 #include "capricorn/base/types.hpp"
+#include "capricorn/graphics/vulkan/dispatch_table.hpp"
 #include "instance.hpp"
 
-#include <vk_mem_alloc.h>
+#include <array>
+#include <memory_resource>
+#include <span>
+#include <string_view>
 #include <vulkan/vulkan.h>
 
 namespace cc::vk
 {
+	class capability_cache;
+	class memory_allocator;
+	class pipeline_cache;
+
+	namespace details
+	{
+		struct swap_chain_support_details
+		{
+			explicit swap_chain_support_details(std::pmr::memory_resource* p_resource)
+			    : formats(p_resource),
+			      present_modes(p_resource)
+			{
+			}
+
+			VkSurfaceCapabilitiesKHR capabilities = {};
+			std::pmr::vector<VkSurfaceFormatKHR> formats;
+			std::pmr::vector<VkPresentModeKHR> present_modes;
+		};
+
+		swap_chain_support_details query_swap_chain_support(const instance_dispatch& dispatch, const VkPhysicalDevice& physical_device, const VkSurfaceKHR& surface, std::pmr::memory_resource* p_resource);
+	} // namespace details
+
+	// Everything device selection needs to know that does not depend on a surface.
+	struct physical_device_candidate
+	{
+		VkPhysicalDevice handle                            = VK_NULL_HANDLE;
+		VkPhysicalDeviceProperties properties              = {};
+		VkPhysicalDeviceFeatures features                  = {};
+		VkPhysicalDeviceMemoryProperties memory_properties = {};
+		std::array<u8, VK_UUID_SIZE> device_uuid           = {}; // Zero unless the instance and the device have Vulkan 1.1.
+		std::vector<VkQueueFamilyProperties> queue_families;
+		std::vector<std::string> extensions;
+	};
+
+	// Enumerates the physical devices, answering the queue family and extension queries from the cache where possible.
+	std::vector<physical_device_candidate> discover_physical_devices(const instance& instance, capability_cache* p_capability_cache = nullptr);
+
+	// How a suitable device ranks against the others, the highest total is selected.
+	struct physical_device_score
+	{
+		u32 type        = 0; // Discrete over integrated over virtual over CPU, by more than the other terms can add up to.
+		u32 memory      = 0; // The largest device-local heap, up to 16 GiB.
+		u32 api_version = 0; // The lower of the instance's and the device's.
+		u32 features    = 0; // Optional capabilities the engine makes use of.
+
+		cc_nodiscard u32 total() const noexcept
+		{
+			return type + memory + api_version + features;
+		}
+	};
+
+	cc_nodiscard physical_device_score score_physical_device(const physical_device_candidate& candidate, u32 instance_api_version);
+
+	// Whether name is the device's UUID, as 32 hex digits with or without dashes, or part of its name. Both ignore case.
+	cc_nodiscard b8 matches_physical_device(const physical_device_candidate& candidate, std::string_view name);
+
+	enum class queue_role : u8
+	{
+		graphics,
+		compute,
+		transfer
+	};
+
+	// Feature structs chained behind core, which ones depends on the API version and the enabled extensions.
+	struct device_features
+	{
+		VkPhysicalDeviceFeatures2 core                                    = {};
+		VkPhysicalDeviceVulkan11Features vulkan11                         = {}; // Vulkan 1.2 and later.
+		VkPhysicalDeviceVulkan12Features vulkan12                         = {}; // Likewise.
+		VkPhysicalDeviceVulkan13Features vulkan13                         = {}; // Vulkan 1.3 and later.
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_indexing = {}; // Before Vulkan 1.2, with VK_EXT_descriptor_indexing.
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_semaphore   = {}; // Before Vulkan 1.2, with VK_KHR_timeline_semaphore.
+
+		// Sets the structure types and builds the pNext chain, which points into this object: link again after copying it.
+		void link(u32 api_version, b8 descriptor_indexing_extension, b8 timeline_semaphore_extension);
+	};
+
 	struct device_create_info
 	{
 		std::weak_ptr<instance> instance;
-		std::weak_ptr<VkSurfaceKHR> surface;
+		std::weak_ptr<VkSurfaceKHR> surface; // Empty for offscreen rendering, presentation is then not required.
 		std::vector<const char*> required_device_extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 		std::vector<const char*> required_validation_layers = { "VK_LAYER_KHRONOS_validation" };
+
+		// Enabled when the selected device offers them, query with logical_device::is_extension_enabled().
+		std::vector<const char*> optional_device_extensions = {
+		        VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME,
+		        VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+		        VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME,
+		        VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
+		        VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
+		        VK_KHR_MAINTENANCE_3_EXTENSION_NAME,
+		        VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+		        VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME,
+		        VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+		};
+
+		const char* p_pipeline_cache_path = "capricorn_pipelines.cache"; // Null keeps compiled pipelines in memory only.
+		u32 frames_in_flight              = 2;                           // How long defragmentation keeps the old place of a moved buffer alive.
+
+		// Result of discover_physical_devices(), possibly gathered ahead of time. Empty enumerates during construction.
+		std::vector<physical_device_candidate> candidates;
+
+		// Name or UUID of the device to use whenever it is suitable, however it scores. Null lets the score decide.
+		const char* p_preferred_device = nullptr;
+
+		// Queues per role, so several threads can submit at once. Capped at what the family offers; roles sharing a family take
+		// distinct queues while there are enough and share the last ones otherwise.
+		u32 graphics_queue_count = 1;
+		u32 compute_queue_count  = 1;
+		u32 transfer_queue_count = 1;
+	};
+
+	struct device_creation_timing
+	{
+		f64 selection_seconds = 0.0; // Physical device enumeration, unless candidates were passed in, and suitability checks.
+		f64 creation_seconds  = 0.0; // vkCreateDevice and queue retrieval.
 	};
 
+	/**
+	 * @brief The selected physical device and the logical device created on it.
+	 *
+	 * @details Of the candidates that have the required extensions and queues, the preferred
+	 * device is taken when it is among them, otherwise the one with the highest
+	 * physical_device_score. Graphics goes to a family that can also present where there is one.
+	 * Async compute goes to a compute family without graphics, and transfers to a transfer-only
+	 * family, or else to a compute family that has a queue left for them. Roles without a family
+	 * of their own fall back to the graphics family, on a queue of their own when it has one.
+	 */
 	class logical_device
 	{
 	public:
 		logical_device() = default;
-		~logical_device() = default;
+		~logical_device();
 
 		explicit logical_device(const device_create_info& create_info);
 
@@ -38,15 +163,62 @@ namespace cc::vk
 		static std::shared_ptr<logical_device> create(const device_create_info& create_info);
 
 		cc_nodiscard const device_create_info get_create_info() const;
+		cc_nodiscard VkPhysicalDevice get_physical_device() const noexcept;
+		cc_nodiscard const VkPhysicalDeviceProperties& get_properties() const noexcept;
+		cc_nodiscard const VkPhysicalDeviceMemoryProperties& get_memory_properties() const noexcept;
+		cc_nodiscard std::pair<VkQueue, u32> get_graphics_queue() const noexcept;
+		cc_nodiscard std::pair<VkQueue, u32> get_present_queue() const noexcept;
+		cc_nodiscard std::pair<VkQueue, u32> get_transfer_queue() const noexcept; // In the graphics family when there is no dedicated one.
+		cc_nodiscard std::pair<VkQueue, u32> get_compute_queue() const noexcept; // In the graphics family when there is no async compute one.
+		cc_nodiscard std::span<const VkQueue> get_queues(queue_role role) const noexcept; // Starting with the one the getter above returns.
+		cc_nodiscard b8 has_dedicated_transfer_queue() const noexcept;
+		cc_nodiscard b8 has_async_compute_queue() const noexcept;
+		cc_nodiscard b8 can_present() const noexcept;
+		cc_nodiscard b8 is_extension_enabled(const char* p_extension) const noexcept;
+		cc_nodiscard const VkPhysicalDeviceFeatures& get_enabled_features() const noexcept;
+		cc_nodiscard const device_features& get_supported_features() const noexcept; // As the device reported them.
+		cc_nodiscard const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& get_descriptor_indexing_properties() const noexcept;
+		cc_nodiscard u32 get_api_version() const noexcept; // The lower of the instance's and the device's.
+		cc_nodiscard b8 has_timeline_semaphore() const noexcept;
+		cc_nodiscard b8 has_descriptor_indexing() const noexcept; // Everything bindless_heap needs, enabled.
+		cc_nodiscard b8 has_draw_indirect_count() const noexcept; // vkCmdDrawIndexedIndirectCount may be recorded.
+		cc_nodiscard std::weak_ptr<pipeline_cache> get_pipeline_cache() const noexcept;
+		cc_nodiscard std::weak_ptr<memory_allocator> get_memory_allocator() const noexcept;
+		cc_nodiscard const device_creation_timing& get_creation_timing() const noexcept;
+
+		// What the engine calls device functions through, straight into the driver.
+		cc_nodiscard const device_dispatch& get_dispatch() const noexcept;
+
+		// The instance's host memory callbacks, pass them to every object created from and destroyed with the device.
+		cc_nodiscard const VkAllocationCallbacks* get_allocation_callbacks() const noexcept;
 
 	private:
 		device_create_info m_create_info;
 
-		VkDevice m_device = VK_NULL_HANDLE;
-		VkPhysicalDevice m_physical_device = VK_NULL_HANDLE;
-		std::pair<VkQueue, u32> m_graphics_queue;
-		std::pair<VkQueue, u32> m_present_queue;
-		VmaAllocation m_allocator = VK_NULL_HANDLE;
+		VkDevice m_device                                    = VK_NULL_HANDLE;
+		VkPhysicalDevice m_physical_device                   = VK_NULL_HANDLE;
+		VkPhysicalDeviceProperties m_properties              = {};
+		VkPhysicalDeviceMemoryProperties m_memory_properties = {};
+		device_dispatch m_dispatch;
+		const VkAllocationCallbacks* m_p_allocation_callbacks = nullptr;
+		std::pair<VkQueue, u32> m_graphics_queue = { VK_NULL_HANDLE, 0 };
+		std::pair<VkQueue, u32> m_present_queue  = { VK_NULL_HANDLE, 0 };
+		std::pair<VkQueue, u32> m_transfer_queue = { VK_NULL_HANDLE, 0 };
+		std::pair<VkQueue, u32> m_compute_queue  = { VK_NULL_HANDLE, 0 };
+		std::array<std::vector<VkQueue>, 3> m_queues; // Indexed by queue_role.
+
+		std::vector<const char*> m_enabled_extensions;
+		device_features m_supported_features;
+		device_features m_enabled_features;
+		VkPhysicalDeviceDescriptorIndexingPropertiesEXT m_descriptor_indexing_properties = {};
+		u32 m_api_version                                                                = VK_API_VERSION_1_0;
+		b8 m_timeline_semaphore                                                          = false;
+		b8 m_descriptor_indexing                                                         = false;
+		b8 m_draw_indirect_count                                                         = false;
+		std::shared_ptr<pipeline_cache> m_pipeline_cache;
+		std::shared_ptr<memory_allocator> m_memory_allocator;
+
+		device_creation_timing m_creation_timing;
 	};
 } // namespace cc::vk
 
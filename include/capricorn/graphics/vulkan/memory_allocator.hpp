@@ -0,0 +1,317 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_MEMORY_ALLOCATOR_HPP
+#define CAPRICORN_MEMORY_ALLOCATOR_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/graphics/vulkan/dispatch_table.hpp"
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+namespace cc::vk
+{
+	class memory_allocator;
+
+	enum class allocation_category : u8
+	{
+		texture,
+		buffer,
+		staging,
+		render_target,
+		count
+	};
+
+	enum class memory_usage : u8
+	{
+		gpu_only, // Device-local, filled through transfers.
+		upload,   // Host-visible and persistently mapped, written sequentially by the CPU; staging buffers.
+		dynamic,  // Written by the CPU every frame and read by the GPU; device-local if the device can map it (ReBAR).
+		readback, // Host-visible and cached, for reading results back.
+	};
+
+	struct gpu_buffer_create_info
+	{
+		VkDeviceSize size            = 0;
+		VkBufferUsageFlags usage     = 0;
+		memory_usage memory          = memory_usage::gpu_only;
+		allocation_category category = allocation_category::buffer;
+		b8 dedicated                 = false; // Forces its own VkDeviceMemory, large buffers get one anyway.
+		b8 movable                   = false; // Defragmentation may move it, see memory_allocator.
+		const char* p_name           = nullptr;
+	};
+
+	struct gpu_image_create_info
+	{
+		VkImageCreateInfo image      = {};
+		memory_usage memory          = memory_usage::gpu_only;
+		allocation_category category = allocation_category::texture;
+		b8 dedicated                 = false;
+		const char* p_name           = nullptr;
+	};
+
+	struct gpu_memory_create_info
+	{
+		VkMemoryRequirements requirements = {}; // Size, alignment and memory types every resource bound to it accepts.
+		memory_usage memory               = memory_usage::gpu_only;
+		allocation_category category      = allocation_category::render_target;
+		const char* p_name                = nullptr;
+	};
+
+	class gpu_buffer
+	{
+	public:
+		gpu_buffer() = default;
+		~gpu_buffer();
+
+		gpu_buffer(const gpu_buffer& other)                = delete;
+		gpu_buffer(gpu_buffer&& other) noexcept            = delete;
+		gpu_buffer& operator=(const gpu_buffer& other)     = delete;
+		gpu_buffer& operator=(gpu_buffer&& other) noexcept = delete;
+
+		// Movable buffers may get a new handle after defragmentation, fetch it every frame instead of caching it.
+		cc_nodiscard VkBuffer get_handle() const noexcept;
+		cc_nodiscard VkDeviceSize get_size() const noexcept;
+		cc_nodiscard void* get_mapped_data() const noexcept; // Null unless the memory is host-visible.
+		cc_nodiscard allocation_category get_category() const noexcept;
+		cc_nodiscard b8 is_dedicated() const noexcept;
+
+	private:
+		friend class memory_allocator;
+
+		memory_allocator* m_p_allocator = nullptr;
+		VkBuffer m_buffer               = VK_NULL_HANDLE;
+		VmaAllocation m_allocation      = VK_NULL_HANDLE;
+		VkDeviceSize m_size             = 0;
+		VkDeviceSize m_allocation_size  = 0;
+		VkBufferUsageFlags m_usage      = 0;
+		void* m_p_mapped                = nullptr;
+		allocation_category m_category  = allocation_category::buffer;
+		b8 m_dedicated                  = false;
+	};
+
+	class gpu_image
+	{
+	public:
+		gpu_image() = default;
+		~gpu_image();
+
+		gpu_image(const gpu_image& other)                = delete;
+		gpu_image(gpu_image&& other) noexcept            = delete;
+		gpu_image& operator=(const gpu_image& other)     = delete;
+		gpu_image& operator=(gpu_image&& other) noexcept = delete;
+
+		cc_nodiscard VkImage get_handle() const noexcept;
+		cc_nodiscard const VkExtent3D& get_extent() const noexcept;
+		cc_nodiscard VkFormat get_format() const noexcept;
+		cc_nodiscard u32 get_mip_levels() const noexcept;
+		cc_nodiscard allocation_category get_category() const noexcept;
+		cc_nodiscard b8 is_dedicated() const noexcept;
+
+	private:
+		friend class memory_allocator;
+
+		memory_allocator* m_p_allocator = nullptr;
+		VkImage m_image                 = VK_NULL_HANDLE;
+		VmaAllocation m_allocation      = VK_NULL_HANDLE;
+		VkDeviceSize m_allocation_size  = 0;
+		VkExtent3D m_extent             = {};
+		VkFormat m_format               = VK_FORMAT_UNDEFINED;
+		u32 m_mip_levels                = 1;
+		allocation_category m_category  = allocation_category::texture;
+		b8 m_dedicated                  = false;
+	};
+
+	// Memory without a resource of its own; resources are bound into it at offsets, where those whose lifetimes do not overlap may alias.
+	class gpu_memory
+	{
+	public:
+		gpu_memory() = default;
+		~gpu_memory();
+
+		gpu_memory(const gpu_memory& other)                = delete;
+		gpu_memory(gpu_memory&& other) noexcept            = delete;
+		gpu_memory& operator=(const gpu_memory& other)     = delete;
+		gpu_memory& operator=(gpu_memory&& other) noexcept = delete;
+
+		cc_nodiscard VkDeviceSize get_size() const noexcept;
+		cc_nodiscard allocation_category get_category() const noexcept;
+
+	private:
+		friend class memory_allocator;
+
+		memory_allocator* m_p_allocator = nullptr;
+		VmaAllocation m_allocation      = VK_NULL_HANDLE;
+		VkDeviceSize m_size             = 0;
+		allocation_category m_category  = allocation_category::render_target;
+	};
+
+	struct memory_allocator_create_info
+	{
+		VkInstance instance               = VK_NULL_HANDLE;
+		VkPhysicalDevice physical_device  = VK_NULL_HANDLE;
+		VkDevice device                                     = VK_NULL_HANDLE;
+		const device_dispatch* p_dispatch                   = nullptr;              // The device's, has to outlive the allocator.
+		const VkAllocationCallbacks* p_allocation_callbacks = nullptr;              // The device's, VMA also uses them for its own bookkeeping.
+		std::pair<VkQueue, u32> queue                       = { VK_NULL_HANDLE, 0 }; // Where defragmentation copies are submitted.
+
+		// Set according to the extensions logical_device managed to enable.
+		b8 memory_budget        = false; // VK_EXT_memory_budget
+		b8 dedicated_allocation = false; // VK_KHR_dedicated_allocation and VK_KHR_get_memory_requirements2
+
+		VkDeviceSize dedicated_threshold = 32ULL * 1024 * 1024; // Resources at least this large get their own VkDeviceMemory.
+		VkDeviceSize block_size          = 0;                   // Zero uses VMA's default of 256 MiB.
+		f32 budget_warning_fraction      = 0.9F;
+
+		// Defragmentation moves at most this much per pass so a pass fits in a frame.
+		VkDeviceSize defragmentation_bytes_per_pass = 64ULL * 1024 * 1024;
+		u32 defragmentation_moves_per_pass          = 64;
+
+		// Defragmentation starts by itself once this much of the allocated blocks is unused, or near maxMemoryAllocationCount.
+		VkDeviceSize defragmentation_min_unused_bytes = 64ULL * 1024 * 1024;
+		f32 defragmentation_threshold                 = 0.25F; // Fraction of the blocks' bytes.
+		u32 defragmentation_interval                  = 600;   // Frames between two automatic starts.
+
+		u32 frames_in_flight = 2;
+		u32 api_version      = VK_API_VERSION_1_0; // The device's, VMA uses the core entry points it allows.
+	};
+
+	struct heap_budget
+	{
+		u32 heap_index                = 0;
+		b8 device_local               = false;
+		VkDeviceSize usage            = 0; // Everything the process uses on the heap, as reported by the driver.
+		VkDeviceSize budget           = 0; // How much the process can use before the OS starts evicting or failing allocations.
+		VkDeviceSize block_bytes      = 0; // VkDeviceMemory allocated by us.
+		VkDeviceSize allocation_bytes = 0; // The part of it handed out to resources.
+		u32 block_count               = 0;
+	};
+
+	struct memory_category_statistics
+	{
+		u64 allocations = 0;
+		u64 dedicated   = 0;
+		u64 bytes       = 0;
+		u64 peak_bytes  = 0;
+	};
+
+	struct defragmentation_statistics
+	{
+		u64 passes      = 0;
+		u64 moves       = 0;
+		u64 bytes_moved = 0;
+		u64 bytes_freed = 0;
+	};
+
+	/**
+	 * @brief Engine-level GPU memory allocator on top of VMA.
+	 *
+	 * @details Resources are sub-allocated from large blocks chosen by memory_usage, so a dense
+	 * scene stays far below maxMemoryAllocationCount; resources above dedicated_threshold get
+	 * their own allocation instead of fragmenting the shared blocks. update() runs once per
+	 * frame: it refreshes the heap budgets, starts defragmentation once the blocks have become
+	 * fragmented, and advances it by at most one pass. Only buffers created as movable are
+	 * relocated. Their new handle is published once the copy has completed, and the old memory
+	 * is released frames_in_flight frames later, when no frame can still reference it. Writes
+	 * to the old buffer after the copy was submitted are not carried over, so owners of movable
+	 * buffers rewrite what they changed meanwhile when the handle changes. Resources have to be released before the
+	 * allocator is destroyed, i.e. before the logical device.
+	 */
+	class memory_allocator
+	{
+	public:
+		memory_allocator() = default;
+		~memory_allocator();
+
+		explicit memory_allocator(const memory_allocator_create_info& create_info);
+
+		memory_allocator(const memory_allocator& other)                = delete;
+		memory_allocator(memory_allocator&& other) noexcept            = delete;
+		memory_allocator& operator=(const memory_allocator& other)     = delete;
+		memory_allocator& operator=(memory_allocator&& other) noexcept = delete;
+
+		operator VmaAllocator() const noexcept; // NOLINT(hicpp-explicit-conversions)
+
+		static std::shared_ptr<memory_allocator> create(const memory_allocator_create_info& create_info);
+
+		cc_nodiscard std::shared_ptr<gpu_buffer> create_buffer(const gpu_buffer_create_info& create_info);
+		cc_nodiscard std::shared_ptr<gpu_image> create_image(const gpu_image_create_info& create_info);
+
+		// Always a dedicated allocation, so defragmentation never moves what is bound to it.
+		cc_nodiscard std::shared_ptr<gpu_memory> allocate_memory(const gpu_memory_create_info& create_info);
+
+		// The image has to be destroyed before the memory is released.
+		void bind_image(const gpu_memory& memory, VkImage image, VkDeviceSize offset);
+
+		// Needed after CPU writes when the memory turned out not to be host-coherent.
+		void flush(const gpu_buffer& buffer, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+		void update(u64 frame_number);
+
+		void begin_defragmentation();
+		cc_nodiscard b8 is_defragmenting() const noexcept;
+
+		cc_nodiscard std::vector<heap_budget> get_budgets() const;
+		cc_nodiscard memory_category_statistics get_statistics(allocation_category category) const;
+		cc_nodiscard defragmentation_statistics get_defragmentation_statistics() const;
+		void log_statistics() const;
+
+		static const char* get_category_name(allocation_category category);
+
+	private:
+		friend class gpu_buffer;
+		friend class gpu_image;
+		friend class gpu_memory;
+
+		enum class defragmentation_stage : u8
+		{
+			idle,    // No pass in progress.
+			copying, // Copies were submitted, waiting for the fence.
+			swapped, // Buffers point to their new place, waiting for frames in flight to let go of the old one.
+		};
+
+		void release(gpu_buffer& buffer);
+		void release(gpu_image& image);
+		void release(gpu_memory& memory);
+		void record_allocation(allocation_category category, VkDeviceSize size, b8 dedicated);
+		void record_release(allocation_category category, VkDeviceSize size, b8 dedicated);
+
+		void check_budgets(u64 frame_number);
+		void step_defragmentation(u64 frame_number);
+		void begin_defragmentation_pass();
+		void swap_moved_buffers();
+		void end_defragmentation_pass();
+		cc_nodiscard VmaDefragmentationMove* find_move(VmaAllocation allocation);
+
+		memory_allocator_create_info m_create_info;
+		VmaAllocator m_allocator   = VK_NULL_HANDLE;
+		u32 m_max_allocation_count = 0;
+
+		mutable std::mutex m_statistics_mutex;
+		std::array<memory_category_statistics, static_cast<std::size_t>(allocation_category::count)> m_statistics = {};
+		std::vector<b8> m_over_budget;
+		b8 m_near_allocation_limit = false;
+
+		// Defragmentation state, guarded because resources may be released from any thread.
+		mutable std::mutex m_defragmentation_mutex;
+		VmaDefragmentationContext m_defragmentation = VK_NULL_HANDLE;
+		VmaDefragmentationPassMoveInfo m_pass       = {};
+		defragmentation_stage m_stage               = defragmentation_stage::idle;
+		u64 m_swap_frame                            = 0;
+		u64 m_next_defragmentation_frame            = 0;
+		std::vector<VkBuffer> m_old_buffers; // Parallel to m_pass.pMoves.
+		std::vector<VkBuffer> m_new_buffers;
+		defragmentation_statistics m_defragmentation_statistics;
+
+		VkCommandPool m_command_pool     = VK_NULL_HANDLE;
+		VkCommandBuffer m_command_buffer = VK_NULL_HANDLE;
+		VkFence m_fence                  = VK_NULL_HANDLE;
+	};
+} // namespace cc::vk
+
+#endif //CAPRICORN_MEMORY_ALLOCATOR_HPP
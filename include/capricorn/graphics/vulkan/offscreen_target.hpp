@@ -0,0 +1,62 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_OFFSCREEN_TARGET_HPP
+#define CAPRICORN_OFFSCREEN_TARGET_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/graphics/vulkan/logical_device.hpp"
+
+namespace cc::vk
+{
+	class gpu_image;
+
+	struct offscreen_target_create_info
+	{
+		std::weak_ptr<logical_device> p_device;
+		VkExtent2D extent = { 1280, 720 };
+		VkFormat format   = VK_FORMAT_R8G8B8A8_UNORM;
+		u32 image_count   = 2;
+	};
+
+	/**
+	 * @brief Set of device-local colour images that stand in for swapchain images.
+	 *
+	 * @details Used when the engine runs headless and the driver offers no
+	 * VK_EXT_headless_surface, for example on CI machines or under lavapipe. Images can be
+	 * rendered to and copied from, and acquire_next_image() cycles through them the way a
+	 * swapchain would, so frame code does not need to know which of the two it is driving.
+	 */
+	class offscreen_target
+	{
+	public:
+		offscreen_target() = default;
+		~offscreen_target();
+
+		explicit offscreen_target(const offscreen_target_create_info& create_info);
+
+		offscreen_target(const offscreen_target& other)                = delete;
+		offscreen_target(offscreen_target&& other) noexcept            = delete;
+		offscreen_target& operator=(const offscreen_target& other)     = delete;
+		offscreen_target& operator=(offscreen_target&& other) noexcept = delete;
+
+		static std::shared_ptr<offscreen_target> create(const offscreen_target_create_info& create_info);
+
+		cc_nodiscard u32 acquire_next_image() noexcept;
+
+		cc_nodiscard const std::vector<VkImage>& get_images() const;
+		cc_nodiscard const std::vector<VkImageView>& get_image_views() const;
+		cc_nodiscard const VkExtent2D& get_extent() const;
+		cc_nodiscard const VkFormat& get_format() const;
+
+	private:
+		offscreen_target_create_info m_create_info;
+
+		std::vector<VkImage> m_images;
+		std::vector<std::shared_ptr<gpu_image>> m_allocations;
+		std::vector<VkImageView> m_image_views;
+		u32 m_current_image = 0;
+	};
+} // namespace cc::vk
+
+#endif //CAPRICORN_OFFSCREEN_TARGET_HPP
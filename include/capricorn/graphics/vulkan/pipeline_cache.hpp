@@ -0,0 +1,112 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_PIPELINE_CACHE_HPP
+#define CAPRICORN_PIPELINE_CACHE_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/graphics/vulkan/dispatch_table.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace cc::vk
+{
+	struct pipeline_cache_create_info
+	{
+		VkDevice device                                     = VK_NULL_HANDLE;
+		const device_dispatch* p_dispatch                   = nullptr; // The device's, has to outlive the cache.
+		const VkAllocationCallbacks* p_allocation_callbacks = nullptr; // The device's, also used for every pipeline.
+		VkPhysicalDeviceProperties properties               = {};      // Of the device's physical device, a cache file is only loaded when it matches them.
+
+		const char* p_path            = "capricorn_pipelines.cache"; // Null keeps the cache in memory only.
+		f64 autosave_interval_seconds = 60.0;                        // Zero only saves on destruction.
+
+		// Set when VK_EXT_pipeline_creation_feedback is enabled, without it hits and misses cannot be told apart.
+		b8 creation_feedback = false;
+	};
+
+	struct pipeline_cache_statistics
+	{
+		u64 pipelines = 0;
+		u64 hits      = 0;
+		u64 misses    = 0; // Only counted with creation feedback, everything else ends up in neither.
+
+		f64 compile_seconds     = 0.0; // Summed over every vkCreate*Pipelines call.
+		f64 max_compile_seconds = 0.0; // The worst single call, i.e. the biggest hitch.
+
+		u64 loaded_bytes = 0;
+		u64 saved_bytes  = 0;
+		u32 merges       = 0;
+	};
+
+	/**
+	 * @brief VkPipelineCache that persists across runs.
+	 *
+	 * @details The blob on disk is wrapped in a small header of our own with a checksum, and the
+	 * Vulkan header inside it is checked against the vendor ID, device ID and pipeline cache
+	 * UUID before it goes anywhere near the driver; drivers are not required to survive a
+	 * corrupted or foreign blob. Threads that compile many pipelines can take a worker cache
+	 * to avoid contending on the main one, merge_worker_caches() folds them back in. Saving
+	 * writes a temporary file and renames it over the old one. The autosave in update() also
+	 * saves what the worker caches hold so far, without releasing them.
+	 */
+	class pipeline_cache
+	{
+	public:
+		pipeline_cache() = default;
+		~pipeline_cache();
+
+		explicit pipeline_cache(const pipeline_cache_create_info& create_info);
+
+		pipeline_cache(const pipeline_cache& other)                = delete;
+		pipeline_cache(pipeline_cache&& other) noexcept            = delete;
+		pipeline_cache& operator=(const pipeline_cache& other)     = delete;
+		pipeline_cache& operator=(pipeline_cache&& other) noexcept = delete;
+
+		operator VkPipelineCache() const noexcept; // NOLINT(hicpp-explicit-conversions)
+
+		static std::shared_ptr<pipeline_cache> create(const pipeline_cache_create_info& create_info);
+
+		// A null cache creates into the main cache.
+		cc_nodiscard VkPipeline create_graphics_pipeline(const VkGraphicsPipelineCreateInfo& create_info, VkPipelineCache cache = VK_NULL_HANDLE);
+		cc_nodiscard VkPipeline create_compute_pipeline(const VkComputePipelineCreateInfo& create_info, VkPipelineCache cache = VK_NULL_HANDLE);
+
+		// Seeded with what was loaded from disk, owned by this object until merged.
+		cc_nodiscard VkPipelineCache create_worker_cache();
+		void merge_worker_caches();
+
+		// Saves when the autosave interval has passed and anything new was compiled since the last save.
+		void update();
+		void save();
+
+		cc_nodiscard pipeline_cache_statistics get_statistics() const;
+
+	private:
+		using clock = std::chrono::steady_clock;
+
+		void load();
+		cc_nodiscard b8 is_compatible(const std::vector<u8>& data) const;
+
+		template<typename CreateInfo, typename Function>
+		VkPipeline create_pipeline(CreateInfo create_info, VkPipelineCache cache, Function function);
+
+		pipeline_cache_create_info m_create_info;
+
+		VkPipelineCache m_cache = VK_NULL_HANDLE;
+		std::vector<u8> m_initial_data;
+
+		std::mutex m_worker_mutex;
+		std::vector<VkPipelineCache> m_worker_caches;
+
+		mutable std::mutex m_statistics_mutex;
+		pipeline_cache_statistics m_statistics;
+		u64 m_saved_pipelines         = 0;
+		clock::time_point m_last_save = clock::now();
+	};
+} // namespace cc::vk
+
+#endif //CAPRICORN_PIPELINE_CACHE_HPP
@@ -6,6 +6,9 @@
 
 #include "instance.hpp"
 #include "logical_device.hpp"
+
+#include <optional>
+
 namespace cc::vk
 {
 	template<class T>
@@ -34,18 +37,39 @@ namespace cc::vk
 		T m_object;
 	};
 
+	enum class present_policy
+	{
+		low_latency,  // MAILBOX, falls back to FIFO.
+		power_saving, // FIFO, always supported and blocks on the display's refresh rate.
+		uncapped,     // IMMEDIATE for benchmarks, may tear. Falls back to MAILBOX, then FIFO.
+	};
+
 	struct swapchain_create_info
 	{
 		std::weak_ptr<instance> p_instance;
 		std::weak_ptr<logical_device> p_device;
 		std::weak_ptr<VkSurfaceKHR> p_surface;
+
+		VkExtent2D extent             = { 1280, 720 }; // Used when the surface leaves the extent up to the swapchain.
+		present_policy policy         = present_policy::power_saving;
+		u32 image_count               = 3; // Clamped to what the surface supports.
+		VkImageUsageFlags image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 	};
 
+	/**
+	 * @brief Presentable images for a surface, recreated in place when the surface changes.
+	 *
+	 * @details Recreation passes the current swapchain as oldSwapchain instead of idling the
+	 * device. The retired swapchain stays alive until the caller reports, through
+	 * release_retired(), that every frame submitted before the recreation has completed.
+	 * Every image has its own render-finished semaphore because a semaphore waited on by a
+	 * present can only be reused once its image has been acquired again.
+	 */
 	class swapchain
 	{
 	public:
-		swapchain()  = default;
-		~swapchain() = default;
+		swapchain() = default;
+		~swapchain();
 
 		explicit swapchain(const swapchain_create_info& create_info);
 
@@ -54,20 +78,58 @@ namespace cc::vk
 		swapchain& operator=(const swapchain& other)     = delete;
 		swapchain& operator=(swapchain&& other) noexcept = delete;
 
-		static std::shared_ptr<swapchain> create(std::weak_ptr<instance> instance, std::weak_ptr<logical_device> device, std::weak_ptr<VkSurfaceKHR> surface);
+		static std::shared_ptr<swapchain> create(const swapchain_create_info& create_info);
+
+		// Returns nothing when the frame has to be skipped, because the swapchain was just recreated or the window is minimized.
+		cc_nodiscard std::optional<u32> acquire_next_image(VkSemaphore image_available, u64 frame_number);
+
+		// Waits on get_render_finished_semaphore(image_index), which the frame's submission has to signal.
+		void present(VkQueue queue, u32 image_index);
+
+		// Recreates on the next acquire, e.g. after the window was resized.
+		void request_recreate(VkExtent2D extent) noexcept;
+
+		// Destroys swapchains retired before completed_frame, whose presents have finished by now.
+		void release_retired(u64 completed_frame);
 
 		[[nodiscard]] const std::vector<VkImage>& get_images() const;
 		[[nodiscard]] const std::vector<VkImageView>& get_image_views() const;
 		[[nodiscard]] const VkExtent2D& get_extent() const;
 		[[nodiscard]] const VkFormat& get_format() const;
 		[[nodiscard]] const VkSwapchainKHR& get_swapchain() const;
+		[[nodiscard]] VkPresentModeKHR get_present_mode() const noexcept;
+		[[nodiscard]] VkSemaphore get_render_finished_semaphore(u32 image_index) const;
+		[[nodiscard]] u32 get_recreation_count() const noexcept;
 
 	private:
+		struct retired_swapchain
+		{
+			VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+			std::vector<VkImageView> image_views;
+			std::vector<VkSemaphore> render_finished;
+			u64 frame_number = 0;
+		};
+
+		void recreate();
+		void destroy_resources(VkSwapchainKHR swapchain, const std::vector<VkImageView>& image_views, const std::vector<VkSemaphore>& render_finished) const;
+
+		swapchain_create_info m_create_info;
+		VkDevice m_device                                     = VK_NULL_HANDLE;
+		const device_dispatch* m_p_dispatch                   = nullptr; // The device's, which outlives the swapchain.
+		const VkAllocationCallbacks* m_p_allocation_callbacks = nullptr;
+
 		VkSwapchainKHR m_swapchain = VK_NULL_HANDLE;
 		std::vector<VkImage> m_swapchain_images;
 		std::vector<VkImageView> m_swapchain_image_views;
+		std::vector<VkSemaphore> m_render_finished;
 		VkExtent2D m_swapchain_extent     = {};
 		VkFormat m_swapchain_image_format = VK_FORMAT_UNDEFINED;
+		VkPresentModeKHR m_present_mode   = VK_PRESENT_MODE_FIFO_KHR;
+
+		std::vector<retired_swapchain> m_retired;
+		u64 m_frame_number      = 0;
+		u32 m_recreation_count  = 0;
+		b8 m_recreate_requested = false;
 	};
 } // namespace cc::vk
 
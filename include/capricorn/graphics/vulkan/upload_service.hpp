@@ -0,0 +1,169 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_UPLOAD_SERVICE_HPP
+#define CAPRICORN_UPLOAD_SERVICE_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/graphics/vulkan/logical_device.hpp"
+
+#include <deque>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace cc::vk
+{
+	class gpu_buffer;
+	class gpu_image;
+	class memory_allocator;
+
+	// Value the upload service's timeline semaphore reaches once the upload has landed. Zero is always complete.
+	using upload_token = u64;
+
+	struct upload_service_create_info
+	{
+		std::weak_ptr<logical_device> p_device;
+
+		VkDeviceSize ring_size  = 64ULL * 1024 * 1024;
+		VkDeviceSize batch_size = 16ULL * 1024 * 1024; // Staged bytes after which a batch is submitted without waiting for flush().
+
+		// Stages the resources are first used in after an upload, acquires are recorded against them.
+		VkPipelineStageFlags destination_stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkAccessFlags destination_access        = VK_ACCESS_MEMORY_READ_BIT;
+	};
+
+	struct upload_statistics
+	{
+		u64 uploads         = 0;
+		u64 bytes           = 0;
+		u64 batches         = 0;
+		u64 ring_stalls     = 0; // Uploads that had to wait for the GPU to free ring space.
+		u64 oversized       = 0; // Uploads too large for the ring, staged through a buffer of their own.
+		u64 ownership_moves = 0; // Queue family ownership transfers, zero without a dedicated transfer queue.
+	};
+
+	/**
+	 * @brief Streams data into device-local buffers and images on the transfer queue.
+	 *
+	 * @details Data is copied into a persistently mapped staging ring and the copies are
+	 * recorded into the current batch, which is submitted by flush() or once batch_size bytes
+	 * are staged. Each batch signals the timeline semaphore with its token, so the renderer can
+	 * wait for exactly the uploads it needs, on the GPU through get_timeline_semaphore() or on
+	 * the CPU through wait(). Ring space is reclaimed as batches complete.
+	 *
+	 * With a dedicated transfer queue the resources are released to the graphics family after
+	 * the copy; acquire() records the matching acquire barriers into a graphics command buffer.
+	 * Without one, batches go to the graphics queue, end in a barrier that orders them before
+	 * the frames submitted afterwards, and acquire() has nothing to do. In that case only flush()
+	 * submits, and it must be called from the thread that submits frames; wait() only waits for
+	 * flushed uploads. Uploads themselves may come from any thread: one that finds the ring full
+	 * of the batch still recording is staged through a buffer of its own rather than submitting.
+	 *
+	 * Without timeline semaphores, core since Vulkan 1.2, the tokens are tracked with fences, which only allows
+	 * waiting on the CPU.
+	 */
+	class upload_service
+	{
+	public:
+		upload_service() = default;
+		~upload_service();
+
+		explicit upload_service(const upload_service_create_info& create_info);
+
+		upload_service(const upload_service& other)                = delete;
+		upload_service(upload_service&& other) noexcept            = delete;
+		upload_service& operator=(const upload_service& other)     = delete;
+		upload_service& operator=(upload_service&& other) noexcept = delete;
+
+		static std::shared_ptr<upload_service> create(const upload_service_create_info& create_info);
+
+		cc_nodiscard upload_token upload_buffer(const gpu_buffer& destination, VkDeviceSize offset, const void* p_data, VkDeviceSize size);
+
+		// Replaces the whole image. Buffer offsets in the regions are relative to p_data; the image ends up in final_layout.
+		cc_nodiscard upload_token upload_image(const gpu_image& destination, const void* p_data, VkDeviceSize size, std::span<const VkBufferImageCopy> regions, VkImageLayout final_layout);
+
+		// Submits the current batch, returns the token of the last upload in it.
+		upload_token flush();
+
+		// Reclaims the ring space of completed batches, once per frame.
+		void update();
+
+		cc_nodiscard b8 is_complete(upload_token token);
+		void wait(upload_token token);
+		cc_nodiscard upload_token get_completed_token();
+
+		// Records the barriers that hand the uploaded resources to the graphics queue, for every upload up to the token.
+		void acquire(VkCommandBuffer command_buffer, upload_token token);
+
+		cc_nodiscard b8 has_timeline_semaphore() const noexcept;
+		cc_nodiscard VkSemaphore get_timeline_semaphore() const noexcept;
+		cc_nodiscard upload_statistics get_statistics() const;
+
+	private:
+		struct batch
+		{
+			VkCommandPool command_pool     = VK_NULL_HANDLE;
+			VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+			VkFence fence                  = VK_NULL_HANDLE;
+			upload_token token             = 0;
+			u64 ring_end                   = 0; // Ring position after the last byte staged for this batch.
+			VkDeviceSize staged_bytes      = 0;
+			std::vector<std::shared_ptr<gpu_buffer>> oversized;
+		};
+
+		struct staging_allocation
+		{
+			VkBuffer buffer     = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			u8* p_data          = nullptr;
+			std::shared_ptr<gpu_buffer> p_owner; // Set for uploads too large for the ring.
+		};
+
+		// Barriers recorded on the graphics queue once the batch with the token is waited for.
+		struct pending_acquire
+		{
+			upload_token token = 0;
+			std::vector<VkBufferMemoryBarrier> buffers;
+			std::vector<VkImageMemoryBarrier> images;
+		};
+
+		// Everything below expects m_mutex to be held.
+		cc_nodiscard staging_allocation allocate(VkDeviceSize size);
+		cc_nodiscard staging_allocation allocate_dedicated(VkDeviceSize size);
+		batch& get_recording_batch();
+		pending_acquire& get_pending_acquire();
+		upload_token finish_upload(batch& batch, VkDeviceSize size);
+		upload_token submit();
+		void collect_completed();
+		void wait_for_oldest();
+
+		upload_service_create_info m_create_info;
+		std::shared_ptr<logical_device> m_device;
+		std::shared_ptr<memory_allocator> m_allocator;
+		std::pair<VkQueue, u32> m_transfer_queue = { VK_NULL_HANDLE, 0 };
+		u32 m_graphics_family                    = 0;
+		b8 m_ownership_transfer                  = false;
+		VkDeviceSize m_alignment                 = 16;
+
+		VkSemaphore m_timeline = VK_NULL_HANDLE;
+
+		mutable std::mutex m_mutex;
+		std::shared_ptr<gpu_buffer> m_ring;
+		u64 m_ring_head = 0; // Monotonic positions, the offset into the ring is the position modulo its size.
+		u64 m_ring_tail = 0;
+
+		std::optional<batch> m_recording;
+		std::deque<batch> m_in_flight;
+		std::vector<batch> m_free_batches;
+		std::deque<pending_acquire> m_pending_acquires;
+		upload_token m_next_token      = 1;
+		upload_token m_completed_token = 0;
+
+		upload_statistics m_statistics;
+	};
+} // namespace cc::vk
+
+#endif //CAPRICORN_UPLOAD_SERVICE_HPP
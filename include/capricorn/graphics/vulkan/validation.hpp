@@ -0,0 +1,125 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_VALIDATION_HPP
+#define CAPRICORN_VALIDATION_HPP
+
+#include "capricorn/base/types.hpp"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <vulkan/vulkan.h>
+
+// The profile used unless the CAPRICORN_VALIDATION environment variable names another, set through the CMake option of the same name.
+#ifndef CAPRICORN_VALIDATION_PROFILE
+	#define CAPRICORN_VALIDATION_PROFILE full
+#endif
+
+namespace cc::vk
+{
+	class instance_configurator;
+
+	enum class validation_profile : u8
+	{
+		off,             // No layer and no messenger, nothing is paid.
+		errors,          // The validation layer, reporting errors only.
+		full,            // Errors, warnings and performance warnings.
+		gpu_assisted,    // Full, plus shader instrumentation that checks descriptor indexing and buffer accesses. For dedicated runs.
+		synchronization, // Full, plus hazard tracking for barriers and submissions. For dedicated runs.
+	};
+
+	constexpr validation_profile default_validation_profile = validation_profile::CAPRICORN_VALIDATION_PROFILE;
+
+	cc_nodiscard const char* get_validation_profile_name(validation_profile profile) noexcept;
+	cc_nodiscard std::optional<validation_profile> parse_validation_profile(std::string_view name) noexcept;
+
+	// The profile named by the CAPRICORN_VALIDATION environment variable, or requested when it is unset or unknown.
+	cc_nodiscard validation_profile resolve_validation_profile(validation_profile requested);
+
+	// Enables the layer, validation features and messenger severities the profile calls for.
+	void apply_validation_profile(instance_configurator& configurator, validation_profile profile);
+
+	struct debug_message_filter_create_info
+	{
+		u32 max_repeats             = 3;  // Times a message id is logged, after that it is only counted.
+		u32 max_messages_per_second = 20; // Across all ids. Errors are never held back by it, only by max_repeats.
+	};
+
+	struct debug_message_statistics
+	{
+		u64 verbose      = 0;
+		u64 info         = 0;
+		u64 warnings     = 0;
+		u64 errors       = 0;
+		u64 logged       = 0;
+		u64 repeats      = 0; // Held back because their id had been logged max_repeats times.
+		u64 rate_limited = 0; // Held back because the second's budget was spent.
+		u32 unique_ids   = 0;
+	};
+
+	/**
+	 * @brief Receives the debug messenger's messages and decides which of them reach the log.
+	 *
+	 * @details Validation repeats the same message for every draw or submission that
+	 * triggers it, and formatting and writing each one costs more than the check that
+	 * produced it. Messages are keyed by messageIdNumber, or by a hash of pMessageIdName for
+	 * the few that leave it zero, and each id is logged max_repeats times. On top of that at
+	 * most max_messages_per_second warnings and infos are logged per second. Everything is
+	 * counted, log_statistics() reports the totals and the most frequent ids.
+	 *
+	 * The messenger may call from any thread the application calls Vulkan from.
+	 */
+	class debug_message_filter
+	{
+	public:
+		debug_message_filter() = default;
+		~debug_message_filter() = default;
+
+		explicit debug_message_filter(const debug_message_filter_create_info& create_info);
+
+		debug_message_filter(const debug_message_filter& other)                = delete;
+		debug_message_filter(debug_message_filter&& other) noexcept            = delete;
+		debug_message_filter& operator=(const debug_message_filter& other)     = delete;
+		debug_message_filter& operator=(debug_message_filter&& other) noexcept = delete;
+
+		static std::unique_ptr<debug_message_filter> create(const debug_message_filter_create_info& create_info);
+
+		// Registered as the messenger's callback, with the filter as its user data.
+		static VKAPI_ATTR VkBool32 VKAPI_CALL callback(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
+		                                               VkDebugUtilsMessageTypeFlagsEXT message_type,
+		                                               const VkDebugUtilsMessengerCallbackDataEXT* p_callback_data,
+		                                               void* p_user_data);
+
+		// Returns whether the message was logged.
+		b8 submit(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity, i32 message_id, const char* p_message_id_name, const char* p_message);
+
+		cc_nodiscard debug_message_statistics get_statistics() const;
+		void log_statistics() const;
+
+	private:
+		using clock = std::chrono::steady_clock;
+
+		struct message_record
+		{
+			u64 count  = 0;
+			u32 logged = 0;      // A rate limited message does not use up one of its id's repeats.
+			std::string id_name; // Copied once per id, the callback data only lives as long as the callback.
+		};
+
+		debug_message_filter_create_info m_create_info;
+
+		mutable std::mutex m_mutex;
+		std::unordered_map<i32, message_record> m_records;
+		debug_message_statistics m_statistics;
+		clock::time_point m_window_start = {};
+		u32 m_window_messages            = 0;
+	};
+} // namespace cc::vk
+
+#endif //CAPRICORN_VALIDATION_HPP
@@ -0,0 +1,234 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_JOB_SYSTEM_HPP
+#define CAPRICORN_JOB_SYSTEM_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/jobs/work_stealing_deque.hpp"
+
+#include <array>
+#include <mutex>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+namespace cc
+{
+	struct job;
+
+	/**
+	 * @brief Counts the jobs of a batch that have not finished yet.
+	 *
+	 * @details A counter is both the handle job_system::wait() blocks on and the dependency
+	 * that job_system::run_after() chains on, which is how task graphs are built. A counter
+	 * must not be reused for a new batch until the previous one has been waited on.
+	 */
+	class job_counter
+	{
+	public:
+		job_counter()  = default;
+		~job_counter() = default;
+
+		job_counter(const job_counter& other)                = delete;
+		job_counter(job_counter&& other) noexcept            = delete;
+		job_counter& operator=(const job_counter& other)     = delete;
+		job_counter& operator=(job_counter&& other) noexcept = delete;
+
+		cc_nodiscard b8 is_done() const noexcept;
+		cc_nodiscard u32 get_pending() const noexcept;
+
+	private:
+		friend class job_system;
+
+		// The low half counts pending jobs. The finalizing bit keeps the counter busy while the last
+		// job hands off continuations, so a waiter cannot destroy it while it is still being used.
+		static constexpr u64 pending_mask   = 0xFFFFFFFFULL;
+		static constexpr u64 finalizing_bit = 1ULL << 32;
+
+		std::atomic<u64> m_state = 0;
+
+		std::mutex m_continuations_mutex;
+		std::vector<job*> m_continuations;
+	};
+
+	struct alignas(64) job
+	{
+		using function = void (*)(job& job);
+
+		static constexpr std::size_t payload_size = 40;
+
+		function p_function    = nullptr;
+		job_counter* p_counter = nullptr;
+		alignas(16) std::array<std::byte, payload_size> payload;
+		std::atomic<b8> in_use = false;
+	};
+
+	static_assert(sizeof(job) == 64, "A job should occupy exactly one cache line.");
+
+	struct job_system_create_info
+	{
+		u32 worker_count   = 0; // Zero uses one worker per hardware thread, minus the main thread.
+		u32 deque_capacity = 4096;
+		u32 job_pool_size  = 8192; // Per thread; bounds the number of jobs a thread may have in flight.
+		u32 spin_count     = 64;   // Failed steal rounds before an idle worker goes to sleep.
+	};
+
+	struct job_system_statistics
+	{
+		u64 executed = 0;
+		u64 stolen   = 0;
+		u64 inlined  = 0; // Jobs run on the submitting thread because its deque was full.
+	};
+
+	/**
+	 * @brief Fixed pool of worker threads that share work through per-thread Chase-Lev deques.
+	 *
+	 * @details The thread that creates the job system becomes thread 0 and gets a deque of its
+	 * own, so it can submit work and help execute it in wait() instead of blocking. Jobs are
+	 * carved from a per-thread ring of job_system_create_info::job_pool_size entries, skipping
+	 * entries that are still in flight, so submitting never touches the heap. Callables are
+	 * stored inline in the job and must fit in job::payload_size bytes; capture larger state
+	 * by reference.
+	 */
+	class job_system
+	{
+	public:
+		~job_system();
+
+		explicit job_system(const job_system_create_info& create_info);
+
+		job_system(const job_system& other)                = delete;
+		job_system(job_system&& other) noexcept            = delete;
+		job_system& operator=(const job_system& other)     = delete;
+		job_system& operator=(job_system&& other) noexcept = delete;
+
+		static std::shared_ptr<job_system> create(const job_system_create_info& create_info);
+
+		template<typename Function>
+		void run(Function&& function, job_counter* p_counter = nullptr);
+
+		template<typename Function>
+		void run_after(job_counter& dependency, Function&& function, job_counter* p_counter = nullptr);
+
+		template<typename Function>
+		void parallel_for(u32 count, u32 batch_size, const Function& function);
+
+		void wait(job_counter& counter);
+
+		cc_nodiscard u32 get_thread_count() const noexcept;
+		cc_nodiscard u32 get_thread_index() const noexcept;
+		cc_nodiscard job_system_statistics get_statistics() const noexcept;
+
+	private:
+		struct alignas(64) worker
+		{
+			explicit worker(const job_system_create_info& create_info);
+
+			work_stealing_deque<job*> deque;
+			std::unique_ptr<job[]> job_pool;
+			u32 job_pool_mask  = 0;
+			u32 job_pool_index = 0;
+			u32 random_state   = 0;
+
+			std::atomic<u64> executed = 0;
+			std::atomic<u64> stolen   = 0;
+			std::atomic<u64> inlined  = 0;
+		};
+
+		template<typename Function>
+		job* make_job(Function&& function, job_counter* p_counter);
+
+		worker& get_current_worker();
+		job* allocate_job();
+		void submit(job* p_job);
+		void execute(job* p_job);
+		b8 try_execute_one(u32 thread_index);
+		job* find_work(u32 thread_index);
+		void worker_main(u32 thread_index);
+
+		job_system_create_info m_create_info;
+		std::vector<std::unique_ptr<worker>> m_workers;
+		std::vector<std::thread> m_threads;
+
+		std::atomic<b8> m_running   = false;
+		std::atomic<u32> m_sleeping = 0;
+		std::counting_semaphore<> m_wake{ 0 };
+
+		u64 m_id = 0;
+	};
+
+	template<typename Function>
+	job* job_system::make_job(Function&& function, job_counter* p_counter)
+	{
+		using callable = std::decay_t<Function>;
+
+		static_assert(sizeof(callable) <= job::payload_size, "Job callable is too large, capture by reference instead.");
+		static_assert(alignof(callable) <= 16, "Job callable is over-aligned.");
+
+		job* p_job = allocate_job();
+
+		new (p_job->payload.data()) callable(std::forward<Function>(function));
+
+		p_job->p_counter  = p_counter;
+		p_job->p_function = [](job& job) {
+			auto* p_callable = std::launder(reinterpret_cast<callable*>(job.payload.data()));
+			(*p_callable)();
+			p_callable->~callable();
+		};
+
+		if (p_counter != nullptr)
+		{
+			p_counter->m_state.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		return p_job;
+	}
+
+	template<typename Function>
+	void job_system::run(Function&& function, job_counter* p_counter)
+	{
+		submit(make_job(std::forward<Function>(function), p_counter));
+	}
+
+	template<typename Function>
+	void job_system::run_after(job_counter& dependency, Function&& function, job_counter* p_counter)
+	{
+		job* p_job = make_job(std::forward<Function>(function), p_counter);
+
+		{
+			std::lock_guard const lock(dependency.m_continuations_mutex);
+
+			if ((dependency.m_state.load(std::memory_order_acquire) & job_counter::pending_mask) != 0)
+			{
+				dependency.m_continuations.push_back(p_job);
+				return;
+			}
+		}
+
+		submit(p_job);
+	}
+
+	template<typename Function>
+	void job_system::parallel_for(u32 count, u32 batch_size, const Function& function)
+	{
+		batch_size = std::max(batch_size, 1U);
+
+		job_counter counter;
+
+		for (u32 begin = 0; begin < count; begin += batch_size)
+		{
+			const u32 end = std::min(begin + batch_size, count);
+
+			const auto batch = [&function, begin, end] {
+				function(begin, end);
+			};
+
+			run(batch, &counter);
+		}
+
+		wait(counter);
+	}
+} // namespace cc
+
+#endif //CAPRICORN_JOB_SYSTEM_HPP
@@ -0,0 +1,123 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_WORK_STEALING_DEQUE_HPP
+#define CAPRICORN_WORK_STEALING_DEQUE_HPP
+
+#include "capricorn/base/types.hpp"
+
+#include <atomic>
+#include <bit>
+#include <memory>
+
+namespace cc
+{
+	/**
+	 * @brief Fixed-capacity Chase-Lev work-stealing deque.
+	 *
+	 * @details The owning thread pushes and pops at the bottom, any other thread steals from
+	 * the top. Memory orderings follow Lê, Pop, Cohen and Zappa Nardelli, "Correct and Efficient
+	 * Work-Stealing for Weak Memory Models" (PPoPP 2013). The buffer does not grow; push()
+	 * fails when the deque is full and the caller is expected to run the item inline.
+	 *
+	 * @tparam T A pointer or other trivially copyable type that fits in a lock-free atomic.
+	 */
+	template<typename T>
+	class work_stealing_deque
+	{
+	public:
+		explicit work_stealing_deque(u32 capacity)
+		    : m_capacity(std::bit_ceil(capacity)),
+		      m_items(std::make_unique<std::atomic<T>[]>(m_capacity))
+		{
+		}
+
+		~work_stealing_deque() = default;
+
+		work_stealing_deque(const work_stealing_deque& other)                = delete;
+		work_stealing_deque(work_stealing_deque&& other) noexcept            = delete;
+		work_stealing_deque& operator=(const work_stealing_deque& other)     = delete;
+		work_stealing_deque& operator=(work_stealing_deque&& other) noexcept = delete;
+
+		// Owner only.
+		b8 push(T item)
+		{
+			const i64 bottom = m_bottom.load(std::memory_order_relaxed);
+			const i64 top    = m_top.load(std::memory_order_acquire);
+
+			if (bottom - top >= static_cast<i64>(m_capacity))
+			{
+				return false;
+			}
+
+			m_items[bottom & (m_capacity - 1)].store(item, std::memory_order_relaxed);
+			m_bottom.store(bottom + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		// Owner only.
+		b8 pop(T& item)
+		{
+			const i64 bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+			m_bottom.store(bottom, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			i64 top = m_top.load(std::memory_order_relaxed);
+
+			if (top > bottom)
+			{
+				m_bottom.store(bottom + 1, std::memory_order_relaxed);
+				return false;
+			}
+
+			item = m_items[bottom & (m_capacity - 1)].load(std::memory_order_relaxed);
+
+			if (top != bottom)
+			{
+				return true;
+			}
+
+			// Last item: race thieves for it.
+			const b8 won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+
+			return won;
+		}
+
+		// Any thread.
+		b8 steal(T& item)
+		{
+			i64 top = m_top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const i64 bottom = m_bottom.load(std::memory_order_acquire);
+
+			if (top >= bottom)
+			{
+				return false;
+			}
+
+			item = m_items[top & (m_capacity - 1)].load(std::memory_order_relaxed);
+
+			return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		}
+
+		cc_nodiscard b8 empty() const noexcept
+		{
+			return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+		}
+
+		cc_nodiscard u32 capacity() const noexcept
+		{
+			return m_capacity;
+		}
+
+	private:
+		u32 m_capacity = 0;
+		std::unique_ptr<std::atomic<T>[]> m_items;
+
+		alignas(64) std::atomic<i64> m_top    = 0;
+		alignas(64) std::atomic<i64> m_bottom = 0;
+	};
+} // namespace cc
+
+#endif //CAPRICORN_WORK_STEALING_DEQUE_HPP
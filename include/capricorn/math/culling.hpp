@@ -0,0 +1,81 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_CULLING_HPP
+#define CAPRICORN_CULLING_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/math/simd.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+
+namespace cc::math
+{
+	// Planes face inwards, a point is on the inner side of a plane when dot(plane.xyz, point) + plane.w >= 0.
+	struct frustum
+	{
+		std::array<glm::vec4, 6> planes = {}; // Left, right, bottom, top, near, far.
+
+		// Of a view-projection matrix mapping depth to [0, 1], as Vulkan does, with normalized planes.
+		cc_nodiscard static frustum from_matrix(const glm::mat4& view_projection) noexcept;
+	};
+
+	/**
+	 * @brief Bounds in structure-of-arrays order, which is what the culling kernels stream through.
+	 *
+	 * @details Every bounds is a box given by its center and half extents. Sphere culling uses
+	 * the sphere around the box, which is kept next to it so neither test has to derive it.
+	 */
+	class bounds_array
+	{
+	public:
+		cc_nodiscard u32 add(const glm::vec3& center, const glm::vec3& extents);
+		cc_nodiscard u32 add_sphere(const glm::vec3& center, f32 radius);
+		void set(u32 index, const glm::vec3& center, const glm::vec3& extents);
+
+		void reserve(u32 capacity);
+		void clear() noexcept;
+
+		cc_nodiscard u32 get_count() const noexcept;
+		cc_nodiscard glm::vec3 get_center(u32 index) const noexcept;
+		cc_nodiscard glm::vec3 get_extents(u32 index) const noexcept;
+		cc_nodiscard f32 get_radius(u32 index) const noexcept;
+
+		cc_nodiscard const f32* get_center_x() const noexcept;
+		cc_nodiscard const f32* get_center_y() const noexcept;
+		cc_nodiscard const f32* get_center_z() const noexcept;
+		cc_nodiscard const f32* get_extent_x() const noexcept;
+		cc_nodiscard const f32* get_extent_y() const noexcept;
+		cc_nodiscard const f32* get_extent_z() const noexcept;
+		cc_nodiscard const f32* get_radii() const noexcept;
+
+	private:
+		std::vector<f32> m_center_x;
+		std::vector<f32> m_center_y;
+		std::vector<f32> m_center_z;
+		std::vector<f32> m_extent_x;
+		std::vector<f32> m_extent_y;
+		std::vector<f32> m_extent_z;
+		std::vector<f32> m_radii;
+	};
+
+	/**
+	 * Frustum culling.
+	 *
+	 * Both write the indices of the bounds that intersect the frustum to p_visible, in ascending
+	 * order, and return how many there are. p_visible needs room for every bounds, the wider
+	 * kernels store whole registers of indices and only advance past the visible ones. The
+	 * tests are conservative: a bounds outside the frustum but not entirely behind one of its
+	 * planes, near a corner, is reported visible.
+	 *
+	 * The level is clamped to what the CPU supports. Every level reports the same indices, up to
+	 * rounding for bounds that touch a plane.
+	 */
+	cc_nodiscard u32 cull_spheres(const frustum& frustum, const bounds_array& bounds, u32* p_visible, simd_level level = get_simd_level());
+	cc_nodiscard u32 cull_boxes(const frustum& frustum, const bounds_array& bounds, u32* p_visible, simd_level level = get_simd_level());
+} // namespace cc::math
+
+#endif //CAPRICORN_CULLING_HPP
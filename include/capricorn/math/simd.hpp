@@ -0,0 +1,57 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_SIMD_HPP
+#define CAPRICORN_SIMD_HPP
+
+#include "capricorn/base/types.hpp"
+
+// Kernels for wider instruction sets are compiled next to the scalar ones and picked at runtime.
+#ifndef CAPRICORN_SIMD_X86
+	#if defined(__x86_64__) || defined(_M_X64)
+		#define CAPRICORN_SIMD_X86 1
+	#else
+		#define CAPRICORN_SIMD_X86 0
+	#endif
+#endif
+
+#if CAPRICORN_SIMD_X86
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <immintrin.h>
+	#endif
+#endif
+
+// MSVC emits any intrinsic as is, GCC and Clang only inside functions compiled for its instruction set.
+#if CAPRICORN_SIMD_X86 && !defined(_MSC_VER)
+	#define cc_simd_target(instruction_sets) __attribute__((target(instruction_sets)))
+#else
+	#define cc_simd_target(instruction_sets)
+#endif
+
+namespace cc::math
+{
+	enum class simd_level : u8
+	{
+		scalar,
+		sse4,   // SSE4.1 and POPCNT.
+		avx2,   // AVX2 and FMA.
+		avx512, // AVX-512F.
+	};
+
+	cc_nodiscard const char* get_simd_level_name(simd_level level) noexcept;
+
+	/**
+	 * @brief The widest level both the CPU and the OS support, detected on the first call.
+	 *
+	 * @details The CAPRICORN_SIMD environment variable, set to the name of a level, caps it,
+	 * which is how a machine is made to run the narrower kernels. Unknown names are ignored.
+	 */
+	cc_nodiscard simd_level get_simd_level() noexcept;
+
+	// The requested level, or the widest supported one below it.
+	cc_nodiscard simd_level clamp_simd_level(simd_level level) noexcept;
+} // namespace cc::math
+
+#endif //CAPRICORN_SIMD_HPP
@@ -0,0 +1,104 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_TRANSFORM_HIERARCHY_HPP
+#define CAPRICORN_TRANSFORM_HIERARCHY_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/jobs/job_system.hpp"
+#include "capricorn/math/simd.hpp"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace cc::math
+{
+	constexpr u32 no_transform = ~0U;
+
+	/**
+	 * @brief Computes world[i] = world[parents[i]] * locals[i] for i in [begin, end), or locals[i] for roots.
+	 *
+	 * @details Parents are indices into the same arrays and have to be outside [begin, end) with
+	 * their world matrices computed already. The level is clamped to what the CPU supports.
+	 */
+	void propagate_transforms(const u32* p_parents, const glm::mat4* p_locals, glm::mat4* p_worlds, u32 begin, u32 end, simd_level level = get_simd_level());
+
+	struct transform_hierarchy_create_info
+	{
+		u32 capacity = 0;
+	};
+
+	/**
+	 * @brief Local and world matrices of a forest of transforms.
+	 *
+	 * @details Nodes are kept sorted by depth, so every parent precedes its children and each
+	 * depth is a contiguous range whose world matrices only depend on the range before it.
+	 * update() walks those ranges in order and hands each to propagate_transforms(), spread
+	 * over the job system when it is wide enough. Parents, locals and worlds are separate
+	 * arrays, so the kernels stream through exactly what they use.
+	 *
+	 * Node ids stay the same for as long as the node exists. Adding a node shallower than the
+	 * deepest one, or removing any, re-sorts on the next update().
+	 */
+	class transform_hierarchy
+	{
+	public:
+		static constexpr u32 parallel_threshold = 4096; // Narrower depths are propagated on the calling thread.
+
+		transform_hierarchy()  = default;
+		~transform_hierarchy() = default;
+
+		explicit transform_hierarchy(const transform_hierarchy_create_info& create_info);
+
+		transform_hierarchy(const transform_hierarchy& other)                = delete;
+		transform_hierarchy(transform_hierarchy&& other) noexcept            = delete;
+		transform_hierarchy& operator=(const transform_hierarchy& other)     = delete;
+		transform_hierarchy& operator=(transform_hierarchy&& other) noexcept = delete;
+
+		static std::shared_ptr<transform_hierarchy> create(const transform_hierarchy_create_info& create_info);
+
+		// The parent has to exist, no_transform adds a root.
+		cc_nodiscard u32 add(u32 parent, const glm::mat4& local);
+
+		// Its children have to be removed first.
+		void remove(u32 node);
+
+		void set_local(u32 node, const glm::mat4& local);
+		cc_nodiscard const glm::mat4& get_local(u32 node) const;
+		cc_nodiscard const glm::mat4& get_world(u32 node) const; // As of the last update().
+		cc_nodiscard u32 get_parent(u32 node) const;
+
+		void update(job_system* p_job_system = nullptr, simd_level level = get_simd_level());
+
+		cc_nodiscard u32 get_count() const noexcept;
+		cc_nodiscard u32 get_depth_count() const noexcept; // As of the last update().
+
+		// In depth order as of the last update(), for handing the world matrices on without a lookup per node.
+		// Nodes removed since read no_transform.
+		cc_nodiscard const u32* get_sorted_nodes() const noexcept;
+		cc_nodiscard const glm::mat4* get_sorted_worlds() const noexcept;
+
+	private:
+		void sort();
+
+		// Per node id.
+		std::vector<u32> m_positions; // In depth order, no_transform while the id is free.
+		std::vector<u32> m_child_counts;
+		std::vector<u32> m_free_nodes;
+
+		// In depth order.
+		std::vector<u32> m_nodes; // no_transform where a removed node waits for the next sort.
+		std::vector<u32> m_parents;
+		std::vector<u32> m_depths;
+		std::vector<glm::mat4> m_locals;
+		std::vector<glm::mat4> m_worlds;
+
+		std::vector<u32> m_depth_starts = { 0 }; // Plus the end of the last depth.
+		u32 m_count   = 0;
+		b8 m_unsorted = false;
+	};
+} // namespace cc::math
+
+#endif //CAPRICORN_TRANSFORM_HIERARCHY_HPP
@@ -0,0 +1,69 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_FRAME_ALLOCATOR_HPP
+#define CAPRICORN_FRAME_ALLOCATOR_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/memory/linear_arena.hpp"
+
+#include <array>
+
+namespace cc
+{
+	struct frame_allocator_create_info
+	{
+		std::size_t capacity_per_frame = 4 * 1024 * 1024;
+	};
+
+	/**
+	 * @brief Double-buffered pair of linear arenas, one per frame.
+	 *
+	 * @details Memory handed out during frame N stays valid through frame N + 1, so data built
+	 * on the CPU one frame can still be read while the next one is recorded. begin_frame()
+	 * flips to the other arena and resets it in O(1). Only the main thread may allocate from
+	 * it; jobs should use scratch_arena instead.
+	 */
+	class frame_allocator
+	{
+	public:
+		static constexpr u32 frame_count = 2;
+
+		frame_allocator()  = default;
+		~frame_allocator() = default;
+
+		explicit frame_allocator(const frame_allocator_create_info& create_info);
+
+		frame_allocator(const frame_allocator& other)                = delete;
+		frame_allocator(frame_allocator&& other) noexcept            = delete;
+		frame_allocator& operator=(const frame_allocator& other)     = delete;
+		frame_allocator& operator=(frame_allocator&& other) noexcept = delete;
+
+		static std::shared_ptr<frame_allocator> create(const frame_allocator_create_info& create_info);
+
+		void begin_frame() noexcept;
+
+		cc_nodiscard linear_arena& get_current() noexcept;
+		cc_nodiscard std::pmr::memory_resource* get_resource() noexcept;
+
+		template<typename T>
+		cc_nodiscard T* allocate(std::size_t count = 1);
+
+		cc_nodiscard std::size_t get_peak() const noexcept;
+		cc_nodiscard u64 get_overflow_count() const noexcept;
+
+	private:
+		std::array<std::unique_ptr<linear_arena>, frame_count> m_arenas;
+		u32 m_current = 0;
+	};
+
+	template<typename T>
+	T* frame_allocator::allocate(std::size_t count)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "Frame memory is released without running destructors.");
+
+		return static_cast<T*>(get_current().allocate(sizeof(T) * count, alignof(T)));
+	}
+} // namespace cc
+
+#endif //CAPRICORN_FRAME_ALLOCATOR_HPP
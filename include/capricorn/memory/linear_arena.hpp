@@ -0,0 +1,88 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_LINEAR_ARENA_HPP
+#define CAPRICORN_LINEAR_ARENA_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/memory/memory_tracker.hpp"
+
+#include <memory_resource>
+
+namespace cc
+{
+	struct linear_arena_create_info
+	{
+		std::size_t capacity = 1024 * 1024;
+		memory_tag tag       = memory_tag::general;
+	};
+
+	/**
+	 * @brief Bump allocator that releases everything it handed out at once.
+	 *
+	 * @details Allocating moves an offset forward and deallocating does nothing; reset() and
+	 * rewind() give the memory back in O(1). When the buffer runs out, allocations spill into
+	 * separately heap-allocated blocks that are freed on the next reset, so running over is slow
+	 * but never fatal; get_overflow_count() tells you the capacity needs raising. Being a
+	 * std::pmr::memory_resource, an arena can back any std::pmr container. Not thread-safe.
+	 */
+	class linear_arena final : public std::pmr::memory_resource
+	{
+	public:
+		struct marker
+		{
+			std::size_t offset     = 0;
+			std::size_t overflowed = 0;
+			void* p_overflow       = nullptr;
+			u64 allocations        = 0;
+		};
+
+		linear_arena() = default;
+		~linear_arena() override;
+
+		explicit linear_arena(const linear_arena_create_info& create_info);
+
+		linear_arena(const linear_arena& other)                = delete;
+		linear_arena(linear_arena&& other) noexcept            = delete;
+		linear_arena& operator=(const linear_arena& other)     = delete;
+		linear_arena& operator=(linear_arena&& other) noexcept = delete;
+
+		void reset() noexcept;
+
+		cc_nodiscard marker get_marker() const noexcept;
+		void rewind(const marker& marker) noexcept;
+
+		cc_nodiscard std::size_t get_used() const noexcept;
+		cc_nodiscard std::size_t get_capacity() const noexcept;
+		cc_nodiscard std::size_t get_peak() const noexcept;
+		cc_nodiscard u64 get_overflow_count() const noexcept;
+
+	private:
+		struct overflow_block
+		{
+			overflow_block* p_next;
+			std::size_t size;
+			std::size_t alignment;
+		};
+
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+		void do_deallocate(void* p_memory, std::size_t bytes, std::size_t alignment) override;
+		cc_nodiscard b8 do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+		void* allocate_overflow(std::size_t bytes, std::size_t alignment);
+		void release_overflow(const overflow_block* p_until) noexcept;
+		void publish_usage(std::size_t used, u64 allocations) noexcept;
+
+		linear_arena_create_info m_create_info = { .capacity = 0 };
+
+		std::byte* m_buffer        = nullptr;
+		std::size_t m_offset       = 0;
+		std::size_t m_peak         = 0;
+		std::size_t m_overflowed   = 0; // Bytes currently held in overflow blocks.
+		overflow_block* m_overflow = nullptr;
+		u64 m_allocations          = 0;
+		u64 m_overflow_count       = 0;
+	};
+} // namespace cc
+
+#endif //CAPRICORN_LINEAR_ARENA_HPP
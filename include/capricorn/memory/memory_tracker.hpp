@@ -0,0 +1,63 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_MEMORY_TRACKER_HPP
+#define CAPRICORN_MEMORY_TRACKER_HPP
+
+#include "capricorn/base/types.hpp"
+
+#include <array>
+#include <atomic>
+
+namespace cc
+{
+	enum class memory_tag : u8
+	{
+		general = 0,
+		frame,
+		scratch,
+		ecs,
+		count
+	};
+
+	struct memory_tag_statistics
+	{
+		u64 current     = 0; // Bytes handed out and not yet returned.
+		u64 peak        = 0; // High-water mark of current.
+		u64 allocations = 0;
+	};
+
+	/**
+	 * @brief Process-wide per-subsystem allocation counters.
+	 *
+	 * @details Pools report every block they hand out. Linear arenas do not pay for an atomic per
+	 * allocation; they report how far they got when they are reset or rewound, so the high-water
+	 * mark of an arena-backed tag is exact while its current figure stays at zero.
+	 */
+	class memory_tracker final
+	{
+	public:
+		static void allocated(memory_tag tag, u64 size) noexcept;
+		static void freed(memory_tag tag, u64 size) noexcept;
+		static void record_transient(memory_tag tag, u64 size, u64 allocations) noexcept;
+
+		static memory_tag_statistics get_statistics(memory_tag tag) noexcept;
+		static const char* get_name(memory_tag tag) noexcept;
+
+		static void log_statistics();
+
+	private:
+		struct alignas(64) counters
+		{
+			std::atomic<u64> current     = 0;
+			std::atomic<u64> peak        = 0;
+			std::atomic<u64> allocations = 0;
+		};
+
+		static void raise_peak(counters& counters, u64 value) noexcept;
+
+		static std::array<counters, static_cast<std::size_t>(memory_tag::count)> s_counters;
+	};
+} // namespace cc
+
+#endif //CAPRICORN_MEMORY_TRACKER_HPP
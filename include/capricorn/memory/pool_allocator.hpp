@@ -0,0 +1,77 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_POOL_ALLOCATOR_HPP
+#define CAPRICORN_POOL_ALLOCATOR_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/memory/memory_tracker.hpp"
+
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+namespace cc
+{
+	struct pool_allocator_create_info
+	{
+		std::size_t block_size      = 64;
+		std::size_t block_alignment = alignof(std::max_align_t);
+		u32 blocks_per_chunk        = 256;
+		memory_tag tag              = memory_tag::general;
+		b8 thread_safe              = false;
+	};
+
+	/**
+	 * @brief Fixed-size block allocator backed by an intrusive free list.
+	 *
+	 * @details Blocks are carved from chunks of blocks_per_chunk blocks that are only returned
+	 * when the pool is destroyed, so allocation and deallocation are a pointer swap. Requests
+	 * that do not fit a block are forwarded to the default resource, which lets the pool back
+	 * node-based std::pmr containers and std::allocate_shared for long-lived engine objects.
+	 */
+	class pool_allocator final : public std::pmr::memory_resource
+	{
+	public:
+		pool_allocator() = default;
+		~pool_allocator() override;
+
+		explicit pool_allocator(const pool_allocator_create_info& create_info);
+
+		pool_allocator(const pool_allocator& other)                = delete;
+		pool_allocator(pool_allocator&& other) noexcept            = delete;
+		pool_allocator& operator=(const pool_allocator& other)     = delete;
+		pool_allocator& operator=(pool_allocator&& other) noexcept = delete;
+
+		cc_nodiscard std::size_t get_block_size() const noexcept;
+		cc_nodiscard u64 get_blocks_in_use() const noexcept;
+		cc_nodiscard u64 get_peak_blocks_in_use() const noexcept;
+		cc_nodiscard std::size_t get_reserved() const noexcept;
+
+	private:
+		struct free_block
+		{
+			free_block* p_next;
+		};
+
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+		void do_deallocate(void* p_memory, std::size_t bytes, std::size_t alignment) override;
+		cc_nodiscard b8 do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+		cc_nodiscard b8 fits(std::size_t bytes, std::size_t alignment) const noexcept;
+		void* pop_block();
+		void push_block(void* p_memory) noexcept;
+		void grow();
+
+		pool_allocator_create_info m_create_info = { .block_size = 0 };
+
+		std::vector<std::byte*> m_chunks;
+		free_block* m_free_list = nullptr;
+		u64 m_blocks_in_use      = 0;
+		u64 m_peak_blocks_in_use = 0;
+
+		std::mutex m_mutex;
+	};
+} // namespace cc
+
+#endif //CAPRICORN_POOL_ALLOCATOR_HPP
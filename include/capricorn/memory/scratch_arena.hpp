@@ -0,0 +1,44 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#ifndef CAPRICORN_SCRATCH_ARENA_HPP
+#define CAPRICORN_SCRATCH_ARENA_HPP
+
+#include "capricorn/base/types.hpp"
+#include "capricorn/memory/linear_arena.hpp"
+
+namespace cc
+{
+	/**
+	 * @brief Scope over the calling thread's scratch arena.
+	 *
+	 * @details Every thread lazily gets a linear arena of scratch_arena::capacity bytes.
+	 * A scratch_arena records the arena's position on construction and rewinds to it on
+	 * destruction, so scopes nest and temporaries never outlive the function that made them:
+	 *
+	 *     scratch_arena scratch;
+	 *     std::pmr::vector<VkExtensionProperties> extensions(count, scratch.get_resource());
+	 */
+	class scratch_arena
+	{
+	public:
+		static constexpr std::size_t capacity = 256 * 1024;
+
+		scratch_arena();
+		~scratch_arena();
+
+		scratch_arena(const scratch_arena& other)                = delete;
+		scratch_arena(scratch_arena&& other) noexcept            = delete;
+		scratch_arena& operator=(const scratch_arena& other)     = delete;
+		scratch_arena& operator=(scratch_arena&& other) noexcept = delete;
+
+		cc_nodiscard std::pmr::memory_resource* get_resource() const noexcept;
+		cc_nodiscard linear_arena& get_arena() const noexcept;
+
+	private:
+		linear_arena& m_arena;
+		linear_arena::marker m_marker;
+	};
+} // namespace cc
+
+#endif //CAPRICORN_SCRATCH_ARENA_HPP
@@ -0,0 +1,266 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/assets/asset_pack.hpp"
+
+#include "capricorn/base/hash.hpp"
+
+#include <lz4.h>
+#include <zstd.h>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace cc
+{
+	namespace details
+	{
+		b8 is_inside(u64 offset, u64 size, u64 file_size) noexcept
+		{
+			return offset <= file_size && size <= file_size - offset;
+		}
+	} // namespace details
+
+	asset_pack::asset_pack(const asset_pack_create_info& create_info) // NOLINT(modernize-pass-by-value)
+	    : m_create_info(create_info)
+	{
+		map(m_create_info.path);
+		validate(m_create_info.verify_checksum);
+
+		log::info(log_source::application, "Mapped asset pack {} with {} entries ({:.1f} MiB).", m_create_info.path.string(), m_entries.size(), static_cast<f64>(m_size) / (1024.0 * 1024.0));
+	}
+
+	asset_pack::~asset_pack()
+	{
+		unmap();
+	}
+
+	std::shared_ptr<asset_pack> asset_pack::create(const asset_pack_create_info& create_info)
+	{
+		return std::make_shared<asset_pack>(create_info);
+	}
+
+	std::optional<asset_entry> asset_pack::find(std::string_view name) const
+	{
+		if (m_slots.empty())
+		{
+			return std::nullopt;
+		}
+
+		const u64 hash = fnv1a(name.data(), name.size());
+		const u32 mask = static_cast<u32>(m_slots.size()) - 1;
+
+		// The bake keeps the table at most half full, so probes end quickly.
+		for (u32 slot = static_cast<u32>(hash) & mask;; slot = (slot + 1) & mask)
+		{
+			const u32 index = m_slots[slot];
+
+			if (index == asset_pack_format::empty_slot)
+			{
+				return std::nullopt;
+			}
+
+			const asset_pack_format::entry& entry = m_entries[index];
+
+			if (entry.name_hash == hash && m_names.substr(entry.name_offset, entry.name_length) == name)
+			{
+				return get_entry(index);
+			}
+		}
+	}
+
+	b8 asset_pack::read(const asset_entry& entry, std::span<u8> destination) const
+	{
+		if (destination.size() < entry.size)
+		{
+			return false;
+		}
+
+		switch (entry.compression)
+		{
+			case asset_pack_format::compression::none:
+				std::memcpy(destination.data(), entry.stored.data(), entry.stored.size());
+				return true;
+			case asset_pack_format::compression::lz4:
+			{
+				const int size = LZ4_decompress_safe(reinterpret_cast<const char*>(entry.stored.data()),
+				                                     reinterpret_cast<char*>(destination.data()),
+				                                     static_cast<int>(entry.stored.size()),
+				                                     static_cast<int>(entry.size));
+				return size >= 0 && static_cast<u64>(size) == entry.size;
+			}
+			case asset_pack_format::compression::zstd:
+			{
+				const std::size_t size = ZSTD_decompress(destination.data(), entry.size, entry.stored.data(), entry.stored.size());
+				return ZSTD_isError(size) == 0 && size == entry.size;
+			}
+			default:
+				return false;
+		}
+	}
+
+	u32 asset_pack::get_entry_count() const noexcept
+	{
+		return static_cast<u32>(m_entries.size());
+	}
+
+	u64 asset_pack::get_size() const noexcept
+	{
+		return m_size;
+	}
+
+	const std::filesystem::path& asset_pack::get_path() const noexcept
+	{
+		return m_create_info.path;
+	}
+
+#ifdef _WIN32
+	void asset_pack::map(const std::filesystem::path& path)
+	{
+		const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		ensure(file != INVALID_HANDLE_VALUE, "Failed to open asset pack!");
+		m_file = file;
+
+		LARGE_INTEGER size = {};
+		ensure(GetFileSizeEx(file, &size) != 0 && size.QuadPart > 0, "Failed to query the size of the asset pack!");
+		m_size = static_cast<u64>(size.QuadPart);
+
+		m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		ensure(m_mapping != nullptr, "Failed to create a mapping of the asset pack!");
+
+		m_p_data = static_cast<const u8*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+		ensure(m_p_data != nullptr, "Failed to map the asset pack!");
+	}
+
+	void asset_pack::unmap() noexcept
+	{
+		if (m_p_data != nullptr)
+		{
+			UnmapViewOfFile(m_p_data);
+		}
+
+		if (m_mapping != nullptr)
+		{
+			CloseHandle(m_mapping);
+		}
+
+		if (m_file != nullptr)
+		{
+			CloseHandle(m_file);
+		}
+
+		m_p_data  = nullptr;
+		m_mapping = nullptr;
+		m_file    = nullptr;
+	}
+#else
+	void asset_pack::map(const std::filesystem::path& path)
+	{
+		const int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		ensure(file >= 0, "Failed to open asset pack!");
+
+		struct stat status = {};
+		const b8 sized     = fstat(file, &status) == 0 && status.st_size > 0;
+
+		if (sized)
+		{
+			m_size       = static_cast<u64>(status.st_size);
+			void* p_data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+			m_p_data     = p_data != MAP_FAILED ? static_cast<const u8*>(p_data) : nullptr;
+		}
+
+		// The mapping keeps the file alive on its own.
+		close(file);
+
+		ensure(sized, "Failed to query the size of the asset pack!");
+		ensure(m_p_data != nullptr, "Failed to map the asset pack!");
+
+		// Entries are read front to back by whoever loads them; the table at the end is needed right away.
+		madvise(const_cast<u8*>(m_p_data), m_size, MADV_RANDOM);
+	}
+
+	void asset_pack::unmap() noexcept
+	{
+		if (m_p_data != nullptr)
+		{
+			munmap(const_cast<u8*>(m_p_data), m_size);
+		}
+
+		m_p_data = nullptr;
+	}
+#endif
+
+	void asset_pack::validate(b8 verify_checksum)
+	{
+		using namespace asset_pack_format;
+
+		ensure(m_size >= sizeof(file_header), "Asset pack is truncated!");
+		m_p_header = reinterpret_cast<const file_header*>(m_p_data);
+
+		ensure(m_p_header->magic == magic, "File is not a Capricorn asset pack!");
+		ensure(m_p_header->byte_order_mark == byte_order, "Asset pack was baked with a different byte order!");
+		ensure(m_p_header->version == version, "Asset pack was baked by an incompatible version of capricorn_bake!");
+
+		const u64 entries_size = static_cast<u64>(m_p_header->entry_count) * sizeof(entry);
+		const u64 slots_size   = static_cast<u64>(m_p_header->slot_count) * sizeof(u32);
+
+		ensure(details::is_inside(m_p_header->entries_offset, entries_size, m_size) &&
+		               details::is_inside(m_p_header->slots_offset, slots_size, m_size) &&
+		               details::is_inside(m_p_header->names_offset, m_p_header->names_size, m_size),
+		       "Asset pack tables lie outside the file!");
+
+		ensure(m_p_header->entries_offset % alignof(entry) == 0 && m_p_header->slots_offset % alignof(u32) == 0, "Asset pack tables are misaligned!");
+		ensure(m_p_header->slot_count == 0 || std::has_single_bit(m_p_header->slot_count), "Asset pack slot count is not a power of two!");
+		ensure(m_p_header->slot_count > m_p_header->entry_count || m_p_header->entry_count == 0, "Asset pack slot table is too small!");
+
+		if (verify_checksum)
+		{
+			u64 checksum = fnv1a(m_p_data + m_p_header->entries_offset, entries_size);
+			checksum     = fnv1a(m_p_data + m_p_header->slots_offset, slots_size, checksum);
+			checksum     = fnv1a(m_p_data + m_p_header->names_offset, m_p_header->names_size, checksum);
+
+			ensure(checksum == m_p_header->table_checksum, "Asset pack tables are corrupt!");
+		}
+
+		m_entries = { reinterpret_cast<const entry*>(m_p_data + m_p_header->entries_offset), m_p_header->entry_count };
+		m_slots   = { reinterpret_cast<const u32*>(m_p_data + m_p_header->slots_offset), m_p_header->slot_count };
+		m_names   = { reinterpret_cast<const char*>(m_p_data + m_p_header->names_offset), m_p_header->names_size };
+
+		// Checked once here so that find() and the views it hands out never have to.
+		for (const entry& entry: m_entries)
+		{
+			ensure(details::is_inside(entry.offset, entry.stored_size, m_size) && details::is_inside(entry.name_offset, entry.name_length, m_names.size()),
+			       "Asset pack entry lies outside the file!");
+			ensure(entry.compression != compression::none || entry.stored_size == entry.size, "Asset pack entry has inconsistent sizes!");
+		}
+
+		for (const u32 index: m_slots)
+		{
+			ensure(index == empty_slot || index < m_entries.size(), "Asset pack slot refers to a missing entry!");
+		}
+
+		ensure(m_entries.empty() || std::find(m_slots.begin(), m_slots.end(), empty_slot) != m_slots.end(), "Asset pack slot table has no empty slot!");
+	}
+
+	asset_entry asset_pack::get_entry(u32 index) const
+	{
+		const asset_pack_format::entry& entry = m_entries[index];
+
+		return {
+		        .name        = m_names.substr(entry.name_offset, entry.name_length),
+		        .kind        = entry.kind,
+		        .compression = entry.compression,
+		        .stored      = { m_p_data + entry.offset, entry.stored_size },
+		        .size        = entry.size,
+		};
+	}
+} // namespace cc
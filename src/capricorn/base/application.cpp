@@ -4,11 +4,29 @@
 #include "capricorn/base/application.hpp"
 
 #include "capricorn/base/log.hpp"
+#include "capricorn/math/simd.hpp"
+#include "capricorn/memory/memory_tracker.hpp"
 
 namespace cc
 {
 	application::application()
-	    : m_window(),
+	    : application(application_create_info{})
+	{
+	}
+
+	application::application(const application_create_info& create_info)
+	    : m_create_info(create_info),
+	      m_job_system(),
+	      m_window(),
+	      m_graphics_context(),
+	      m_frame_scheduler(),
+	      m_frame_allocator(),
+	      m_texture_streamer(),
+	      m_command_recorder(),
+	      m_render_graph(),
+	      m_asset_pack(),
+	      m_world(),
+	      m_system_scheduler(),
 	      m_state(application_state::none)
 	{
 	}
@@ -19,11 +37,90 @@ namespace cc
 
 	void application::initialize()
 	{
-		log::initialize();
+		using clock = std::chrono::steady_clock;
+
+		m_initialize_start = clock::now();
+
+		log_create_info const log_create_info = {
+		        .mode               = log_mode::asynchronous,
+		        .overflow_policy    = log_overflow_policy::block,
+		        .p_binary_file_name = m_create_info.p_binary_log_path,
+		};
+
+		log::initialize(log_create_info);
+
+		m_startup_timing.log_initialize_seconds = std::chrono::duration<f64>(clock::now() - m_initialize_start).count();
 
 		log::info(log_source::application, "Initializing Capricorn Engine...");
+		log::info(log_source::application, "Math kernels use {}.", math::get_simd_level_name(math::get_simd_level()));
+
+		// Before the job system, so its workers register their threads by name.
+		if constexpr (profiler_enabled)
+		{
+			profiler::initialize(m_create_info.profiler);
+			profiler::set_thread_name("Main");
+
+			if (m_create_info.p_trace_path != nullptr)
+			{
+				profiler::begin_capture();
+			}
+		}
+
+		m_job_system       = job_system::create({});
+		m_world            = ecs::world::create({});
+		m_system_scheduler = ecs::system_scheduler::create({ .p_world = m_world, .p_job_system = m_job_system });
+
+		if (m_create_info.p_asset_pack_path != nullptr && std::filesystem::exists(m_create_info.p_asset_pack_path))
+		{
+			m_asset_pack = asset_pack::create({ .path = m_create_info.p_asset_pack_path });
+		}
+		else if (m_create_info.p_asset_pack_path != nullptr)
+		{
+			log::warning(log_source::application, "Asset pack {} not found, run capricorn_bake to create it.", m_create_info.p_asset_pack_path);
+		}
+
+		window_create_info const window_create_info = {
+		        .p_title                 = "Capricorn Engine",
+		        .width                   = 1280,
+		        .height                  = 720,
+		        .headless                = m_create_info.headless,
+		        .p_capability_cache_path = m_create_info.p_capability_cache_path,
+		        .present_policy          = m_create_info.present_policy,
+		        .frames_in_flight        = m_create_info.frames_in_flight,
+		        .p_preferred_device      = m_create_info.p_preferred_device,
+		        .validation              = m_create_info.validation,
+		};
+
+		m_window = std::make_shared<window>(window_create_info);
+
+		m_startup_timing.window = m_window->get_startup_timing();
+		m_graphics_context      = m_window->get_graphics_context().lock();
+
+		// FIFO already paces the loop to the display. Mailbox never blocks, so cap it to keep an idle engine
+		// from pinning a core. Uncapped and headless runs exist to be measured and are left alone.
+		const b8 needs_cap = !m_create_info.headless && m_create_info.present_policy == vk::present_policy::low_latency;
+
+		frame_scheduler_create_info const frame_scheduler_create_info = {
+		        .fixed_timestep = 1.0 / 60.0,
+		        .frame_rate_cap = needs_cap ? 240.0 : 0.0,
+		};
+
+		m_frame_scheduler = std::make_shared<frame_scheduler>(frame_scheduler_create_info);
+		m_frame_allocator = frame_allocator::create({});
+
+		texture_streamer_create_info texture_streamer_create_info = m_create_info.texture_streaming;
+		texture_streamer_create_info.p_context                    = m_graphics_context;
+		texture_streamer_create_info.p_job_system                 = m_job_system;
+
+		m_texture_streamer = texture_streamer::create(texture_streamer_create_info);
 
-		m_window = std::make_shared<window>("Capricorn Engine", 1280, 720);
+		vk::command_recorder_create_info const command_recorder_create_info = {
+		        .p_device     = m_graphics_context->get_logical_device(),
+		        .p_job_system = m_job_system,
+		};
+
+		m_command_recorder = vk::command_recorder::create(command_recorder_create_info);
+		m_render_graph     = render_graph::create({ .p_context = m_graphics_context });
 
 		m_state = application_state::initialized;
 	}
@@ -42,12 +139,171 @@ namespace cc
 				continue;
 			}
 
+			m_frame_scheduler->begin_frame();
+			m_frame_allocator->begin_frame();
+
 			m_window->tick();
+			m_graphics_context->update();
+
+			while (m_frame_scheduler->step_fixed())
+			{
+				if (m_fixed_update_callback)
+				{
+					cc_profile_zone("application::fixed_update");
+					m_fixed_update_callback(m_frame_scheduler->get_fixed_timestep());
+				}
+			}
+
+			// Blocks while the GPU is frames_in_flight frames behind, which is what paces a FIFO swapchain.
+			const std::optional<graphics_frame> frame = m_graphics_context->begin_frame();
+
+			// Before the callback, so it sees this frame's views. Its requests take effect in the next frame.
+			if (frame.has_value())
+			{
+				m_command_recorder->begin_frame(frame->frame_index);
+				m_texture_streamer->update(*frame);
+				m_render_graph->begin(*frame);
+			}
+
+			m_system_scheduler->run(m_frame_scheduler->get_timing().delta_time);
+
+			if (m_update_callback)
+			{
+				cc_profile_zone("application::update");
+				m_update_callback(m_frame_scheduler->get_timing().delta_time, m_frame_scheduler->get_alpha());
+			}
+
+			if (frame.has_value())
+			{
+				m_render_graph->execute();
+				m_graphics_context->end_frame(*frame);
+			}
+
+			if (m_frame_scheduler->get_timing().frame_index == 0)
+			{
+				// Taken before pacing, which would otherwise add the frame rate cap to startup.
+				m_startup_timing.time_to_first_frame_seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - m_initialize_start).count();
+				log::info(log_source::application, "First frame after {:.3f} ms.", m_startup_timing.time_to_first_frame_seconds * 1000.0);
+			}
+
+			m_frame_scheduler->end_frame(*m_window);
+
+			// After pacing, so the frame track spans the whole iteration.
+			profiler::end_frame();
+
+			if (m_create_info.max_frames != 0 && m_frame_scheduler->get_timing().frame_index + 1 >= m_create_info.max_frames)
+			{
+				m_window->request_close();
+			}
+		}
+
+		const frame_timing& timing = m_frame_scheduler->get_timing();
+		log::info(log_source::application, "Ran {} frames, average frame time {:.3f} ms, worst {:.3f} ms.", timing.frame_index + 1, timing.average_delta_time * 1000.0, timing.max_delta_time * 1000.0);
+
+		if (m_frame_allocator->get_overflow_count() != 0)
+		{
+			log::warning(log_source::application, "Frame arenas overflowed {} times, peak frame usage was {} bytes.", m_frame_allocator->get_overflow_count(), m_frame_allocator->get_peak());
 		}
 	}
 
 	void application::shutdown()
 	{
 		log::info(log_source::application, "Shutting down Capricorn Engine...");
+
+		m_texture_streamer->log_statistics();
+
+		m_render_graph.reset();
+		m_command_recorder.reset();
+		m_texture_streamer.reset();
+		m_asset_pack.reset();
+		m_frame_allocator.reset();
+
+		// The window owns the context, which only goes, with the device and everything on it, together with the window.
+		m_graphics_context.reset();
+		m_window.reset();
+
+		m_system_scheduler.reset();
+		m_world.reset();
+		m_job_system.reset();
+
+		memory_tracker::log_statistics();
+
+		if constexpr (profiler_enabled)
+		{
+			if (m_create_info.p_trace_path != nullptr)
+			{
+				profiler::end_capture(m_create_info.p_trace_path);
+			}
+
+			profiler::log_summary();
+			profiler::shutdown();
+		}
+
+		log::shutdown();
+	}
+
+	void application::set_fixed_update_callback(fixed_update_callback callback)
+	{
+		m_fixed_update_callback = std::move(callback);
+	}
+
+	void application::set_update_callback(update_callback callback)
+	{
+		m_update_callback = std::move(callback);
+	}
+
+	void application::set_frame_rate_cap(f64 frame_rate)
+	{
+		m_frame_scheduler->set_frame_rate_cap(frame_rate);
+	}
+
+	const frame_timing& application::get_frame_timing() const
+	{
+		return m_frame_scheduler->get_timing();
+	}
+
+	const application_startup_timing& application::get_startup_timing() const noexcept
+	{
+		return m_startup_timing;
+	}
+
+	std::weak_ptr<job_system> application::get_job_system() const
+	{
+		return m_job_system;
+	}
+
+	std::weak_ptr<frame_allocator> application::get_frame_allocator() const
+	{
+		return m_frame_allocator;
+	}
+
+	std::weak_ptr<texture_streamer> application::get_texture_streamer() const
+	{
+		return m_texture_streamer;
+	}
+
+	std::weak_ptr<vk::command_recorder> application::get_command_recorder() const
+	{
+		return m_command_recorder;
+	}
+
+	std::weak_ptr<render_graph> application::get_render_graph() const
+	{
+		return m_render_graph;
+	}
+
+	std::weak_ptr<const asset_pack> application::get_asset_pack() const
+	{
+		return m_asset_pack;
+	}
+
+	std::weak_ptr<ecs::world> application::get_world() const
+	{
+		return m_world;
+	}
+
+	std::weak_ptr<ecs::system_scheduler> application::get_system_scheduler() const
+	{
+		return m_system_scheduler;
 	}
 } // namespace cc
\ No newline at end of file
@@ -0,0 +1,355 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/base/async_log_sink.hpp"
+
+#include "capricorn/base/types.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace cc
+{
+	namespace details
+	{
+		void copy_record(log_record& destination, const log_record& source)
+		{
+			destination.level       = source.level;
+			destination.time        = source.time;
+			destination.thread_id   = source.thread_id;
+			destination.logger_name = source.logger_name;
+			destination.payload.clear();
+			destination.payload.append(source.payload.data(), source.payload.data() + source.payload.size());
+		}
+
+		log_ring::log_ring(std::size_t capacity)
+		{
+			capacity = std::bit_ceil(std::max<std::size_t>(capacity, 2));
+
+			m_slots = std::make_unique<slot[]>(capacity);
+			m_mask  = capacity - 1;
+
+			for (std::size_t index = 0; index < capacity; ++index)
+			{
+				m_slots[index].sequence.store(index, std::memory_order_relaxed);
+			}
+		}
+
+		bool log_ring::try_push(const spdlog::details::log_msg& message)
+		{
+			// Only the owning thread pushes, so the enqueue position never races.
+			const std::size_t position = m_enqueue_position.load(std::memory_order_relaxed);
+			slot& target               = m_slots[position & m_mask];
+
+			if (target.sequence.load(std::memory_order_acquire) != position)
+			{
+				return false;
+			}
+
+			target.record.level       = message.level;
+			target.record.time        = message.time;
+			target.record.thread_id   = message.thread_id;
+			target.record.logger_name = message.logger_name;
+			target.record.payload.clear();
+			target.record.payload.append(message.payload.begin(), message.payload.end());
+
+			target.sequence.store(position + 1, std::memory_order_release);
+			m_enqueue_position.store(position + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		template<typename Consumer>
+		bool log_ring::pop(Consumer&& consumer)
+		{
+			std::size_t position = m_dequeue_position.load(std::memory_order_relaxed);
+
+			while (true)
+			{
+				slot& source                = m_slots[position & m_mask];
+				const std::size_t sequence  = source.sequence.load(std::memory_order_acquire);
+				const std::ptrdiff_t offset = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+
+				if (offset == 0)
+				{
+					if (m_dequeue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					{
+						consumer(source.record);
+						source.sequence.store(position + m_mask + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (offset < 0)
+				{
+					return false;
+				}
+				else
+				{
+					position = m_dequeue_position.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		bool log_ring::try_pop(log_record& out)
+		{
+			return pop([&out](const log_record& record) {
+				copy_record(out, record);
+			});
+		}
+
+		bool log_ring::try_discard()
+		{
+			return pop([](const log_record&) {});
+		}
+
+		b8 log_ring::empty() const noexcept
+		{
+			return size() == 0;
+		}
+
+		std::size_t log_ring::size() const noexcept
+		{
+			const std::size_t enqueued = m_enqueue_position.load(std::memory_order_acquire);
+			const std::size_t dequeued = m_dequeue_position.load(std::memory_order_acquire);
+			return enqueued >= dequeued ? enqueued - dequeued : 0;
+		}
+
+		std::size_t log_ring::capacity() const noexcept
+		{
+			return m_mask + 1;
+		}
+
+		std::size_t log_ring::pushed() const noexcept
+		{
+			return m_enqueue_position.load(std::memory_order_relaxed);
+		}
+	} // namespace details
+
+	async_log_sink::async_log_sink(std::vector<spdlog::sink_ptr> sinks, const log_create_info& create_info)
+	    : log_writer(create_info.ring_capacity, create_info.flush_interval),
+	      m_sinks(std::move(sinks)),
+	      m_create_info(create_info),
+	      m_last_flush(std::chrono::steady_clock::now())
+	{
+		start();
+	}
+
+	async_log_sink::~async_log_sink()
+	{
+		stop();
+	}
+
+	void async_log_sink::log(const spdlog::details::log_msg& message)
+	{
+		// Once the writer is gone nothing drains the rings anymore, so write straight through.
+		if (!is_running())
+		{
+			std::lock_guard const lock(m_output_mutex);
+			for (const auto& sink: m_sinks)
+			{
+				if (sink->should_log(message.level))
+				{
+					sink->log(message);
+				}
+			}
+			return;
+		}
+
+		details::log_ring& ring = get_thread_ring();
+
+		if (!ring.try_push(message))
+		{
+			switch (m_create_info.overflow_policy)
+			{
+				case log_overflow_policy::block:
+					while (!ring.try_push(message))
+					{
+						if (!is_running())
+						{
+							m_dropped.fetch_add(1, std::memory_order_relaxed);
+							return;
+						}
+
+						wake_writer();
+						std::this_thread::yield();
+					}
+					break;
+				case log_overflow_policy::drop_oldest:
+					while (!ring.try_push(message))
+					{
+						if (ring.try_discard())
+						{
+							m_dropped.fetch_add(1, std::memory_order_relaxed);
+						}
+					}
+					break;
+				case log_overflow_policy::drop_newest:
+					m_dropped.fetch_add(1, std::memory_order_relaxed);
+					return;
+			}
+		}
+
+		// stop() may have begun after the check above and the writer may already have done its last pass. Either the
+		// running flag reads false here, or the drain in stop(), which follows clearing it, sees the record just pushed.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!is_running())
+		{
+			drain_remaining();
+			return;
+		}
+
+		if (message.level >= spdlog::level::err)
+		{
+			m_flush_requested.store(true, std::memory_order_relaxed);
+			wake_writer();
+		}
+		else if (ring.size() >= ring.capacity() / 2 && is_writer_sleeping())
+		{
+			wake_writer();
+		}
+	}
+
+	void async_log_sink::flush()
+	{
+		m_flush_requested.store(true, std::memory_order_relaxed);
+		wake_writer();
+	}
+
+	void async_log_sink::set_pattern(const std::string& pattern)
+	{
+		for (const auto& sink: m_sinks)
+		{
+			sink->set_pattern(pattern);
+		}
+	}
+
+	void async_log_sink::set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter)
+	{
+		for (const auto& sink: m_sinks)
+		{
+			sink->set_formatter(sink_formatter->clone());
+		}
+	}
+
+	void async_log_sink::stop()
+	{
+		if (log_writer::stop())
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			drain_remaining();
+		}
+	}
+
+	std::size_t async_log_sink::drain()
+	{
+		std::lock_guard const lock(m_output_mutex);
+		return write_rings();
+	}
+
+	void async_log_sink::flush_if_due()
+	{
+		const b8 flush_requested = m_flush_requested.exchange(false, std::memory_order_relaxed);
+
+		std::lock_guard const lock(m_output_mutex);
+
+		const b8 budget_exceeded = m_unflushed_bytes >= m_create_info.flush_batch_size;
+		const b8 interval_passed = m_unflushed_bytes > 0 && std::chrono::steady_clock::now() - m_last_flush >= m_create_info.flush_interval;
+
+		if (flush_requested || budget_exceeded || interval_passed)
+		{
+			flush_sinks();
+		}
+	}
+
+	void async_log_sink::flush_output()
+	{
+		std::lock_guard const lock(m_output_mutex);
+		flush_sinks();
+	}
+
+	void async_log_sink::drain_remaining()
+	{
+		std::lock_guard const lock(m_output_mutex);
+
+		if (write_rings() > 0)
+		{
+			flush_sinks();
+		}
+	}
+
+	std::size_t async_log_sink::write_rings()
+	{
+		std::size_t count = 0;
+
+		for_each_ring([this, &count](details::log_ring& ring) {
+			const std::size_t available = ring.size();
+			for (std::size_t index = 0; index < available; ++index)
+			{
+				if (count == m_batch.size())
+				{
+					m_batch.emplace_back();
+				}
+
+				if (!ring.try_pop(m_batch[count]))
+				{
+					break;
+				}
+
+				++count;
+			}
+		});
+
+		if (count == 0)
+		{
+			return 0;
+		}
+
+		// Rings are drained one after the other, so restore the global order before writing.
+		m_ordered_batch.clear();
+		for (std::size_t index = 0; index < count; ++index)
+		{
+			m_ordered_batch.push_back(&m_batch[index]);
+		}
+
+		std::stable_sort(m_ordered_batch.begin(), m_ordered_batch.end(), [](const details::log_record* lhs, const details::log_record* rhs) {
+			return lhs->time < rhs->time;
+		});
+
+		for (const details::log_record* record: m_ordered_batch)
+		{
+			spdlog::details::log_msg message(record->time,
+			                                 spdlog::source_loc{},
+			                                 record->logger_name,
+			                                 record->level,
+			                                 spdlog::string_view_t(record->payload.data(), record->payload.size()));
+			message.thread_id = record->thread_id;
+
+			for (const auto& sink: m_sinks)
+			{
+				if (sink->should_log(message.level))
+				{
+					sink->log(message);
+				}
+			}
+
+			m_unflushed_bytes += record->payload.size();
+		}
+
+		m_written.fetch_add(count, std::memory_order_relaxed);
+
+		return count;
+	}
+
+	void async_log_sink::flush_sinks()
+	{
+		for (const auto& sink: m_sinks)
+		{
+			sink->flush();
+		}
+
+		m_unflushed_bytes = 0;
+		m_last_flush      = std::chrono::steady_clock::now();
+
+		m_flushes.fetch_add(1, std::memory_order_relaxed);
+	}
+} // namespace cc
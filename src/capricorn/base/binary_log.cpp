@@ -0,0 +1,497 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/base/binary_log.hpp"
+
+#include "capricorn/base/log_writer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace cc
+{
+	namespace details
+	{
+		/**
+		 * @brief Single-producer single-consumer ring of variable sized byte records.
+		 *
+		 * @details Every block starts with an 8 byte header holding the payload size and whether
+		 * the block is padding. A record that does not fit before the end of the buffer is preceded
+		 * by a padding block that fills the remainder, so records are always contiguous.
+		 */
+		class binary_log_ring
+		{
+		public:
+			explicit binary_log_ring(std::size_t capacity)
+			    : m_capacity(std::bit_ceil(std::max<std::size_t>(capacity, 4096)))
+			{
+				m_buffer = std::make_unique<std::byte[]>(m_capacity);
+			}
+
+			std::byte* reserve(std::size_t size)
+			{
+				const std::size_t total = sizeof(block_header) + align(size);
+
+				std::size_t head         = m_head.load(std::memory_order_relaxed);
+				const std::size_t tail   = m_tail.load(std::memory_order_acquire);
+				std::size_t offset       = head & (m_capacity - 1);
+				const std::size_t remain = m_capacity - offset;
+
+				if (total > remain)
+				{
+					if (head - tail + remain + total > m_capacity)
+					{
+						return nullptr;
+					}
+
+					write_header(offset, remain - sizeof(block_header), true);
+					head += remain;
+					offset = 0;
+				}
+				else if (head - tail + total > m_capacity)
+				{
+					return nullptr;
+				}
+
+				write_header(offset, size, false);
+				m_reserved_head = head + total;
+
+				return m_buffer.get() + offset + sizeof(block_header);
+			}
+
+			void commit()
+			{
+				m_head.store(m_reserved_head, std::memory_order_release);
+				m_pushed.store(m_pushed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+
+			bool peek(std::span<const std::byte>& record)
+			{
+				std::size_t tail       = m_tail.load(std::memory_order_relaxed);
+				const std::size_t head = m_head.load(std::memory_order_acquire);
+
+				while (tail != head)
+				{
+					const std::size_t offset = tail & (m_capacity - 1);
+
+					block_header header = {};
+					std::memcpy(&header, m_buffer.get() + offset, sizeof(header));
+
+					if (header.padding != 0)
+					{
+						tail += sizeof(block_header) + header.size;
+						m_tail.store(tail, std::memory_order_release);
+						continue;
+					}
+
+					record       = std::span<const std::byte>(m_buffer.get() + offset + sizeof(block_header), header.size);
+					m_peek_total = sizeof(block_header) + align(header.size);
+					return true;
+				}
+
+				return false;
+			}
+
+			void release()
+			{
+				m_tail.store(m_tail.load(std::memory_order_relaxed) + m_peek_total, std::memory_order_release);
+			}
+
+			[[nodiscard]] bool empty() const noexcept
+			{
+				return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+			}
+
+			[[nodiscard]] std::size_t used() const noexcept
+			{
+				return m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_relaxed);
+			}
+
+			[[nodiscard]] std::size_t capacity() const noexcept
+			{
+				return m_capacity;
+			}
+
+			// Anything larger might never fit once padding at the wrap point is accounted for.
+			[[nodiscard]] std::size_t max_record_size() const noexcept
+			{
+				return m_capacity / 2 - sizeof(block_header);
+			}
+
+			[[nodiscard]] std::uint64_t pushed() const noexcept
+			{
+				return m_pushed.load(std::memory_order_relaxed);
+			}
+
+			std::atomic<bool> orphaned = false;
+
+		private:
+			struct block_header
+			{
+				std::uint32_t size;
+				std::uint32_t padding;
+			};
+
+			static constexpr std::size_t align(std::size_t size)
+			{
+				return (size + sizeof(block_header) - 1) & ~(sizeof(block_header) - 1);
+			}
+
+			void write_header(std::size_t offset, std::size_t size, bool padding)
+			{
+				const block_header header = { static_cast<std::uint32_t>(size), padding ? 1U : 0U };
+				std::memcpy(m_buffer.get() + offset, &header, sizeof(header));
+			}
+
+			std::unique_ptr<std::byte[]> m_buffer;
+			std::size_t m_capacity = 0;
+
+			alignas(64) std::atomic<std::size_t> m_head = 0;
+			std::size_t m_reserved_head                 = 0;
+			std::atomic<std::uint64_t> m_pushed         = 0;
+
+			alignas(64) std::atomic<std::size_t> m_tail = 0;
+			std::size_t m_peek_total                    = 0;
+		};
+
+		/**
+		 * @brief Owns the binary log stream that log_writer drains every thread's ring into.
+		 *
+		 * @details The writer replaces the site address of each record with a small id, and emits the
+		 * site's format string, source location and argument types the first time it sees it, so
+		 * the stream is self-describing.
+		 */
+		class binary_log_backend final : private log_writer<binary_log_backend, binary_log_ring>
+		{
+		public:
+			explicit binary_log_backend(const log_create_info& create_info)
+			    : log_writer(create_info.binary_ring_size, create_info.flush_interval),
+			      m_create_info(create_info)
+			{
+				m_file = std::fopen(create_info.p_binary_file_name, "wb");
+				if (m_file == nullptr)
+				{
+					log::error(log_source::none, "Failed to open binary log stream {}.", create_info.p_binary_file_name);
+					throw std::runtime_error("Failed to open binary log stream.");
+				}
+
+				m_start_steady_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+				m_last_flush      = std::chrono::steady_clock::now();
+
+				const binary_log_format::file_header header = {
+				        .magic           = binary_log_format::magic,
+				        .version         = binary_log_format::version,
+				        .byte_order_mark = binary_log_format::byte_order,
+				        .start_time_ns   = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count(),
+				};
+
+				append(&header, sizeof(header));
+
+				start();
+			}
+
+			~binary_log_backend()
+			{
+				stop();
+			}
+
+			binary_log_backend(const binary_log_backend& other)                = delete;
+			binary_log_backend(binary_log_backend&& other) noexcept            = delete;
+			binary_log_backend& operator=(const binary_log_backend& other)     = delete;
+			binary_log_backend& operator=(binary_log_backend&& other) noexcept = delete;
+
+			std::byte* reserve(std::size_t size)
+			{
+				binary_log_ring& ring = get_thread_ring();
+
+				if (size > ring.max_record_size())
+				{
+					m_dropped.fetch_add(1, std::memory_order_relaxed);
+					return nullptr;
+				}
+
+				std::byte* p_record = ring.reserve(size);
+
+				if (p_record == nullptr)
+				{
+					// Records cannot be discarded from the producer side of a byte ring, so drop_oldest behaves like drop_newest.
+					if (m_create_info.overflow_policy != log_overflow_policy::block)
+					{
+						m_dropped.fetch_add(1, std::memory_order_relaxed);
+						return nullptr;
+					}
+
+					while ((p_record = ring.reserve(size)) == nullptr)
+					{
+						if (!is_running())
+						{
+							m_dropped.fetch_add(1, std::memory_order_relaxed);
+							return nullptr;
+						}
+
+						wake_writer();
+						std::this_thread::yield();
+					}
+				}
+
+				return p_record;
+			}
+
+			void commit()
+			{
+				binary_log_ring& ring = get_thread_ring();
+				ring.commit();
+
+				if (ring.used() >= ring.capacity() / 2 && is_writer_sleeping())
+				{
+					wake_writer();
+				}
+			}
+
+			void stop()
+			{
+				if (log_writer::stop())
+				{
+					std::fclose(m_file);
+					m_file = nullptr;
+				}
+			}
+
+			using log_writer::get_statistics;
+
+		private:
+			friend class log_writer<binary_log_backend, binary_log_ring>;
+
+			std::size_t drain()
+			{
+				std::size_t count = 0;
+
+				for_each_ring([this, &count](binary_log_ring& ring) {
+					std::span<const std::byte> record;
+					while (ring.peek(record))
+					{
+						encode_record(record);
+						ring.release();
+						++count;
+					}
+				});
+
+				m_written.fetch_add(count, std::memory_order_relaxed);
+
+				return count;
+			}
+
+			void flush_if_due()
+			{
+				if (m_output.size() >= m_create_info.flush_batch_size || (!m_output.empty() && std::chrono::steady_clock::now() - m_last_flush >= m_create_info.flush_interval))
+				{
+					flush_output();
+				}
+			}
+
+			void flush_output()
+			{
+				m_last_flush = std::chrono::steady_clock::now();
+
+				if (m_output.empty())
+				{
+					return;
+				}
+
+				std::fwrite(m_output.data(), 1, m_output.size(), m_file);
+				std::fflush(m_file);
+				m_output.clear();
+
+				m_flushes.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			void encode_record(std::span<const std::byte> record)
+			{
+				binary_log_record_header header = {};
+				std::memcpy(&header, record.data(), sizeof(header));
+
+				const std::uint32_t site_id = get_site_id(header.p_site);
+				const auto timestamp_ns     = static_cast<std::uint64_t>(std::max<std::int64_t>(header.timestamp_ns - m_start_steady_ns, 0));
+				const auto argument_bytes   = static_cast<std::uint32_t>(record.size() - sizeof(header));
+
+				append_value(binary_log_format::entry_tag::record);
+				append_value(site_id);
+				append_value(timestamp_ns);
+				append_value(argument_bytes);
+				append(record.data() + sizeof(header), argument_bytes);
+			}
+
+			std::uint32_t get_site_id(const binary_log_site* p_site)
+			{
+				const auto it = m_site_ids.find(p_site);
+				if (it != m_site_ids.end())
+				{
+					return it->second;
+				}
+
+				const auto site_id = static_cast<std::uint32_t>(m_site_ids.size());
+				m_site_ids.emplace(p_site, site_id);
+
+				const std::string_view file   = p_site->p_file;
+				const std::string_view format = p_site->p_format;
+
+				append_value(binary_log_format::entry_tag::site);
+				append_value(site_id);
+				append_value(static_cast<std::uint8_t>(p_site->level));
+				append_value(static_cast<std::uint8_t>(p_site->source));
+				append_value(p_site->line);
+				append_value(p_site->argument_count);
+				append(p_site->argument_types.data(), p_site->argument_count);
+				append_value(static_cast<std::uint32_t>(file.size()));
+				append(file.data(), file.size());
+				append_value(static_cast<std::uint32_t>(format.size()));
+				append(format.data(), format.size());
+
+				return site_id;
+			}
+
+			template<typename T>
+			void append_value(const T& value)
+			{
+				append(&value, sizeof(T));
+			}
+
+			void append(const void* p_data, std::size_t size)
+			{
+				const auto* p_bytes = static_cast<const char*>(p_data);
+				m_output.insert(m_output.end(), p_bytes, p_bytes + size);
+			}
+
+			log_create_info m_create_info;
+
+			std::FILE* m_file              = nullptr;
+			std::int64_t m_start_steady_ns = 0;
+			std::vector<char> m_output;
+			std::unordered_map<const binary_log_site*, std::uint32_t> m_site_ids;
+			std::chrono::steady_clock::time_point m_last_flush;
+		};
+	} // namespace details
+
+	std::atomic<bool> binary_log::s_active                             = false;
+	std::unique_ptr<details::binary_log_backend> binary_log::s_backend = nullptr;
+
+	namespace details
+	{
+		struct binary_log_writer_registry
+		{
+			std::mutex mutex;
+			std::vector<std::shared_ptr<binary_log_writer_flag>> flags;
+		};
+
+		// Function-local, so threads logging during static initialization find it constructed.
+		binary_log_writer_registry& get_writer_registry()
+		{
+			static binary_log_writer_registry registry;
+			return registry;
+		}
+
+		struct binary_log_thread_flag_handle
+		{
+			std::shared_ptr<binary_log_writer_flag> flag;
+
+			~binary_log_thread_flag_handle()
+			{
+				if (flag)
+				{
+					flag->orphaned.store(true, std::memory_order_release);
+				}
+			}
+		};
+
+		binary_log_writer_flag& binary_log_thread_flag()
+		{
+			thread_local binary_log_thread_flag_handle handle;
+
+			if (!handle.flag) [[unlikely]]
+			{
+				handle.flag = std::make_shared<binary_log_writer_flag>();
+
+				binary_log_writer_registry& registry = get_writer_registry();
+				std::lock_guard const lock(registry.mutex);
+				registry.flags.push_back(handle.flag);
+			}
+
+			return *handle.flag;
+		}
+
+		void binary_log_wait_for_writers()
+		{
+			binary_log_writer_registry& registry = get_writer_registry();
+			std::lock_guard const lock(registry.mutex);
+
+			// A thread registering after this lock was taken already sees the stream closed.
+			for (const auto& flag: registry.flags)
+			{
+				while (flag->writing.load(std::memory_order_seq_cst))
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			std::erase_if(registry.flags, [](const auto& flag) {
+				return flag->orphaned.load(std::memory_order_acquire);
+			});
+		}
+
+		std::byte* binary_log_reserve(std::size_t size)
+		{
+			return binary_log::s_backend->reserve(size);
+		}
+
+		void binary_log_commit()
+		{
+			binary_log::s_backend->commit();
+		}
+	} // namespace details
+
+	void binary_log::initialize(const log_create_info& create_info)
+	{
+		shutdown();
+
+		s_backend = std::make_unique<details::binary_log_backend>(create_info);
+		s_active.store(true, std::memory_order_release);
+
+		log::info(log_source::none, "Binary log stream opened at {}.", create_info.p_binary_file_name);
+	}
+
+	void binary_log::shutdown()
+	{
+		if (!s_backend)
+		{
+			return;
+		}
+
+		s_active.store(false, std::memory_order_seq_cst);
+
+		// Producers that saw the stream open may still be writing into their ring, wait for them before tearing it down.
+		details::binary_log_wait_for_writers();
+
+		s_backend->stop();
+
+		const log_statistics statistics = s_backend->get_statistics();
+		log::info(log_source::none, "Binary log stream closed, {} records written, {} dropped.", statistics.written, statistics.dropped);
+
+		s_backend.reset();
+	}
+
+	log_statistics binary_log::get_statistics()
+	{
+		if (s_backend)
+		{
+			return s_backend->get_statistics();
+		}
+
+		return {};
+	}
+} // namespace cc
@@ -0,0 +1,171 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/base/frame_scheduler.hpp"
+
+#include "capricorn/base/profiler.hpp"
+#include "capricorn/base/window.hpp"
+
+namespace cc
+{
+	namespace details
+	{
+		f64 to_seconds(std::chrono::steady_clock::duration duration)
+		{
+			return std::chrono::duration<f64>(duration).count();
+		}
+	} // namespace details
+
+	frame_scheduler::frame_scheduler(const frame_scheduler_create_info& create_info)
+	    : m_create_info(create_info)
+	{
+		ensure(m_create_info.fixed_timestep > 0.0, "Fixed timestep must be positive!");
+	}
+
+	void frame_scheduler::begin_frame()
+	{
+		const clock::time_point now = clock::now();
+
+		if (m_first_frame)
+		{
+			m_timing.delta_time = m_create_info.fixed_timestep;
+			m_first_frame       = false;
+		}
+		else
+		{
+			m_timing.delta_time = details::to_seconds(now - m_frame_start);
+			++m_timing.frame_index;
+		}
+
+		m_frame_start = now;
+
+		m_accumulator += std::min(m_timing.delta_time, m_create_info.max_frame_delta);
+		m_steps_this_frame = 0;
+	}
+
+	b8 frame_scheduler::step_fixed()
+	{
+		if (m_accumulator < m_create_info.fixed_timestep)
+		{
+			return false;
+		}
+
+		if (m_steps_this_frame == m_create_info.max_fixed_steps_per_frame)
+		{
+			// We cannot keep up, so drop whole steps and keep only the fractional remainder for interpolation.
+			const auto dropped = static_cast<u64>(m_accumulator / m_create_info.fixed_timestep);
+			m_timing.dropped_fixed_steps += dropped;
+			m_accumulator -= static_cast<f64>(dropped) * m_create_info.fixed_timestep;
+			return false;
+		}
+
+		m_accumulator -= m_create_info.fixed_timestep;
+		++m_steps_this_frame;
+
+		return true;
+	}
+
+	void frame_scheduler::end_frame(window& window)
+	{
+		cc_profile_zone("frame_scheduler::end_frame");
+
+		const clock::time_point work_end = clock::now();
+
+		m_timing.work_time   = details::to_seconds(work_end - m_frame_start);
+		m_timing.fixed_steps = m_steps_this_frame;
+		m_timing.alpha       = m_accumulator / m_create_info.fixed_timestep;
+
+		f64 frame_rate = m_create_info.frame_rate_cap;
+
+		if (m_create_info.throttle_in_background)
+		{
+			if (window.is_minimized())
+			{
+				frame_rate = m_create_info.minimized_frame_rate;
+			}
+			else if (!window.is_focused())
+			{
+				frame_rate = frame_rate > 0.0 ? std::min(frame_rate, m_create_info.background_frame_rate) : m_create_info.background_frame_rate;
+			}
+		}
+
+		if (frame_rate > 0.0)
+		{
+			const auto budget = std::chrono::duration_cast<clock::duration>(std::chrono::duration<f64>(1.0 / frame_rate));
+			wait_until(m_frame_start + budget, window);
+		}
+
+		m_timing.wait_time = details::to_seconds(clock::now() - work_end);
+
+		record_history();
+	}
+
+	f64 frame_scheduler::get_fixed_timestep() const noexcept
+	{
+		return m_create_info.fixed_timestep;
+	}
+
+	f64 frame_scheduler::get_alpha() const noexcept
+	{
+		return m_accumulator / m_create_info.fixed_timestep;
+	}
+
+	const frame_timing& frame_scheduler::get_timing() const noexcept
+	{
+		return m_timing;
+	}
+
+	void frame_scheduler::set_frame_rate_cap(f64 frame_rate) noexcept
+	{
+		m_create_info.frame_rate_cap = std::max(frame_rate, 0.0);
+	}
+
+	void frame_scheduler::wait_until(clock::time_point deadline, window& window) const
+	{
+		const auto spin_threshold = std::chrono::duration_cast<clock::duration>(std::chrono::duration<f64>(m_create_info.spin_threshold_seconds));
+
+		while (true)
+		{
+			const clock::duration remaining = deadline - clock::now();
+
+			if (remaining <= clock::duration::zero())
+			{
+				return;
+			}
+
+			if (remaining > spin_threshold)
+			{
+				// Returns early whenever an event arrives, which also keeps input latency low while throttled.
+				window.wait_events(details::to_seconds(remaining - spin_threshold));
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void frame_scheduler::record_history()
+	{
+		const u32 slot = static_cast<u32>(m_timing.frame_index % history_size);
+
+		m_delta_history[slot] = m_timing.delta_time;
+		m_work_history[slot]  = m_timing.work_time;
+		m_history_count       = std::min(m_history_count + 1, history_size);
+
+		f64 delta_sum = 0.0;
+		f64 work_sum  = 0.0;
+		f64 delta_max = 0.0;
+
+		for (u32 index = 0; index < m_history_count; ++index)
+		{
+			delta_sum += m_delta_history[index];
+			work_sum += m_work_history[index];
+			delta_max = std::max(delta_max, m_delta_history[index]);
+		}
+
+		m_timing.average_delta_time = delta_sum / static_cast<f64>(m_history_count);
+		m_timing.average_work_time  = work_sum / static_cast<f64>(m_history_count);
+		m_timing.max_delta_time     = delta_max;
+	}
+} // namespace cc
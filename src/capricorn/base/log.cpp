@@ -3,27 +3,77 @@
 
 #include "capricorn/base/log.hpp"
 
+#include "capricorn/base/async_log_sink.hpp"
+#include "capricorn/base/binary_log.hpp"
+
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 
 namespace cc
 {
-	std::shared_ptr<spdlog::logger> log::s_logger = nullptr;
+	std::shared_ptr<spdlog::logger> log::s_logger      = nullptr;
+	std::shared_ptr<async_log_sink> log::s_async_sink = nullptr;
 
-	void log::initialize()
+	void log::initialize(const log_create_info& create_info)
 	{
 		std::vector<spdlog::sink_ptr> log_sinks{};
 		log_sinks.emplace_back(std::make_shared<spdlog::sinks::stdout_color_sink_mt>());
-		log_sinks.emplace_back(std::make_shared<spdlog::sinks::basic_file_sink_mt>("Capricorn.log", true));
+		log_sinks.emplace_back(std::make_shared<spdlog::sinks::basic_file_sink_mt>(create_info.p_file_name, true));
 
 		log_sinks[0]->set_pattern("[%T] [%^%l%$] %v");
 		log_sinks[1]->set_pattern("[%T] [%l] %v");
 
-		s_logger = std::make_shared<spdlog::logger>("Capricorn", begin(log_sinks), end(log_sinks));
+		if (create_info.mode == log_mode::asynchronous)
+		{
+			// The writer thread owns flushing, so the front logger must not flush on every call.
+			s_async_sink = std::make_shared<async_log_sink>(std::move(log_sinks), create_info);
+			s_logger     = std::make_shared<spdlog::logger>("Capricorn", s_async_sink);
+			s_logger->set_level(spdlog::level::trace);
+			s_logger->flush_on(spdlog::level::off);
+		}
+		else
+		{
+			s_logger = std::make_shared<spdlog::logger>("Capricorn", begin(log_sinks), end(log_sinks));
+			s_logger->set_level(spdlog::level::trace);
+			s_logger->flush_on(spdlog::level::trace);
+		}
+
 		register_logger(s_logger);
-		s_logger->set_level(spdlog::level::trace);
-		s_logger->flush_on(spdlog::level::trace);
 
 		log::info(log_source::none, "Capricorn logging initialized and ready to start logging!");
+
+		if (create_info.p_binary_file_name != nullptr)
+		{
+			binary_log::initialize(create_info);
+		}
+	}
+
+	void log::shutdown()
+	{
+		binary_log::shutdown();
+
+		if (s_async_sink)
+		{
+			const log_statistics statistics = s_async_sink->get_statistics();
+			log::info(log_source::none, "Capricorn logging shutting down, {} messages written, {} dropped.", statistics.written, statistics.dropped);
+
+			s_async_sink->stop();
+		}
+
+		if (s_logger)
+		{
+			s_logger->flush();
+			spdlog::drop(s_logger->name());
+		}
+	}
+
+	log_statistics log::get_statistics()
+	{
+		if (s_async_sink)
+		{
+			return s_async_sink->get_statistics();
+		}
+
+		return {};
 	}
-} // namespace cc
\ No newline at end of file
+} // namespace cc
@@ -0,0 +1,741 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/base/profiler.hpp"
+#include "capricorn/base/log.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#if CAPRICORN_PROFILER_TSC && !defined(_MSC_VER)
+	#include <cpuid.h>
+#endif
+
+namespace cc
+{
+	namespace details
+	{
+		// In ticks in the rings of threads, in nanoseconds in the GPU ring.
+		struct profile_event
+		{
+			const profile_zone_site* p_site = nullptr;
+			i64 begin                       = 0;
+			i64 end                         = 0;
+		};
+
+		b8 has_invariant_tsc()
+		{
+#if CAPRICORN_PROFILER_TSC
+	#ifdef _MSC_VER
+			std::array<int, 4> registers = {};
+			__cpuid(registers.data(), 0x80000000);
+
+			if (static_cast<u32>(registers[0]) < 0x80000007)
+			{
+				return false;
+			}
+
+			__cpuid(registers.data(), 0x80000007);
+			return (registers[3] & (1 << 8)) != 0;
+	#else
+			u32 eax = 0;
+			u32 ebx = 0;
+			u32 ecx = 0;
+			u32 edx = 0;
+
+			return __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) != 0 && (edx & (1U << 8)) != 0;
+	#endif
+#else
+			return false;
+#endif
+		}
+
+		// Single-producer single-consumer ring of zones, the owning thread pushes and end_frame() drains.
+		class profile_ring
+		{
+		public:
+			profile_ring(u32 capacity, u32 track)
+			    : track(track),
+			      m_capacity(std::bit_ceil(std::max<u32>(capacity, 256)))
+			{
+				m_events = std::make_unique<profile_event[]>(m_capacity);
+			}
+
+			void push(const profile_event& event) noexcept
+			{
+				const u64 head = m_head.load(std::memory_order_relaxed);
+				const u64 tail = m_tail.load(std::memory_order_acquire);
+
+				if (head - tail >= m_capacity)
+				{
+					m_dropped.store(m_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+					return;
+				}
+
+				m_events[head & (m_capacity - 1)] = event;
+				m_head.store(head + 1, std::memory_order_release);
+			}
+
+			template<typename Function>
+			u64 drain(Function&& function)
+			{
+				const u64 tail = m_tail.load(std::memory_order_relaxed);
+				const u64 head = m_head.load(std::memory_order_acquire);
+
+				for (u64 position = tail; position != head; ++position)
+				{
+					function(m_events[position & (m_capacity - 1)]);
+				}
+
+				m_tail.store(head, std::memory_order_release);
+
+				return head - tail;
+			}
+
+			cc_nodiscard u64 dropped() const noexcept
+			{
+				return m_dropped.load(std::memory_order_relaxed);
+			}
+
+			const u32 track;
+			std::atomic<b8> orphaned = false;
+
+		private:
+			std::unique_ptr<profile_event[]> m_events;
+			u32 m_capacity = 0;
+
+			alignas(64) std::atomic<u64> m_head = 0;
+			std::atomic<u64> m_dropped          = 0;
+
+			alignas(64) std::atomic<u64> m_tail = 0;
+		};
+
+		/**
+		 * @brief Owns the rings, the rolling per-zone history and the capture.
+		 *
+		 * @details Tracks are numbered in the order threads registered, after the frame and GPU
+		 * tracks. A thread that exits leaves its ring behind until end_frame() drained it.
+		 */
+		class profiler_backend
+		{
+		public:
+			profiler_backend(const profiler_create_info& create_info, b8 tsc)
+			    : m_create_info(create_info),
+			      m_id(s_next_backend_id.fetch_add(1, std::memory_order_relaxed)),
+			      m_gpu_ring(create_info.ring_size, gpu_track),
+			      m_tsc(tsc)
+			{
+				m_create_info.history_frames = std::max(m_create_info.history_frames, 1U);
+
+				m_track_names.emplace_back("Frames");
+				m_track_names.emplace_back("GPU");
+
+				if (m_tsc)
+				{
+					// A first estimate of the counter's rate, end_frame() refines it over a longer interval.
+					m_calibration_ticks = profiler::ticks();
+					m_calibration_ns    = profiler::now();
+
+					while (profiler::now() - m_calibration_ns < calibration_spin_ns)
+					{
+					}
+
+					calibrate();
+				}
+
+				m_frame_begin = profiler::now();
+			}
+
+			void record(const profile_event& event) noexcept
+			{
+				get_thread_ring().push(event);
+			}
+
+			void record_gpu(const profile_event& event) noexcept
+			{
+				m_gpu_ring.push(event);
+			}
+
+			const profile_zone_site& intern(const char* p_name)
+			{
+				std::lock_guard const lock(m_sites_mutex);
+
+				auto& p_site = m_interned_sites[std::string_view(p_name)];
+				if (!p_site)
+				{
+					p_site = std::make_unique<profile_zone_site>(profile_zone_site {
+					        .p_name = p_name,
+					        .p_file = "",
+					        .line   = 0,
+					});
+				}
+
+				return *p_site;
+			}
+
+			void set_thread_name(const char* p_name)
+			{
+				const profile_ring& ring = get_thread_ring();
+
+				std::lock_guard const lock(m_rings_mutex);
+				m_track_names[ring.track] = p_name;
+			}
+
+			void end_frame()
+			{
+				static constexpr profile_zone_site frame_site = { "frame", __FILE__, __LINE__ };
+
+				const i64 now  = profiler::now();
+				b8 log_summary = false;
+
+				{
+					std::lock_guard const statistics_lock(m_statistics_mutex);
+
+					if (m_tsc)
+					{
+						calibrate();
+					}
+
+					{
+						std::lock_guard const lock(m_rings_mutex);
+
+						for (auto it = m_rings.begin(); it != m_rings.end();)
+						{
+							profile_ring& ring = **it;
+							const b8 orphaned  = ring.orphaned.load(std::memory_order_acquire);
+
+							m_zone_count += ring.drain([&](const profile_event& event) {
+								accumulate({ event.p_site, to_ns(event.begin), to_ns(event.end) }, false, ring.track);
+							});
+
+							if (orphaned)
+							{
+								m_retired_dropped += ring.dropped();
+								it = m_rings.erase(it);
+							}
+							else
+							{
+								++it;
+							}
+						}
+					}
+
+					m_zone_count += m_gpu_ring.drain([&](const profile_event& event) {
+						accumulate(event, true, gpu_track);
+					});
+
+					accumulate({ &frame_site, m_frame_begin, now }, false, frame_track);
+
+					const u64 slot = m_frames % m_create_info.history_frames;
+					for (zone_history& zone: m_zones)
+					{
+						zone.totals[slot] = zone.frame_total;
+						zone.calls[slot]  = zone.frame_calls;
+						zone.frame_total  = 0;
+						zone.frame_calls  = 0;
+					}
+
+					++m_frames;
+					m_frame_begin = now;
+
+					log_summary = m_create_info.summary_interval != 0 && m_frames % m_create_info.summary_interval == 0;
+				}
+
+				if (log_summary)
+				{
+					profiler::log_summary();
+				}
+			}
+
+			void begin_capture()
+			{
+				std::lock_guard const lock(m_statistics_mutex);
+
+				m_capture.clear();
+				m_capture.reserve(std::min<u32>(m_create_info.max_capture_events, 1 << 16));
+				m_capture_begin = profiler::now();
+				m_capturing     = true;
+			}
+
+			b8 end_capture(const std::filesystem::path& path)
+			{
+				std::vector<captured_zone> capture;
+				i64 capture_begin = 0;
+
+				{
+					std::lock_guard const lock(m_statistics_mutex);
+
+					if (!m_capturing)
+					{
+						log::warning(log_source::none, "Profiler capture ended without having begun.");
+						return false;
+					}
+
+					m_capturing   = false;
+					capture       = std::move(m_capture);
+					capture_begin = m_capture_begin;
+					m_capture     = {};
+				}
+
+				std::vector<std::string> track_names;
+
+				{
+					std::lock_guard const lock(m_rings_mutex);
+					track_names = m_track_names;
+				}
+
+				fmt::memory_buffer output;
+				auto out = std::back_inserter(output);
+
+				fmt::format_to(out, R"({{"displayTimeUnit":"ms","traceEvents":[)");
+				fmt::format_to(out, R"({{"name":"process_name","ph":"M","pid":1,"tid":0,"args":{{"name":"capricorn"}}}})");
+
+				for (u32 track = 0; track < track_names.size(); ++track)
+				{
+					const std::string name = track_names[track].empty() ? fmt::format("Thread {}", track - first_thread_track + 1) : escape(track_names[track]);
+
+					fmt::format_to(out, R"(,{{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"{}"}}}})", track, name);
+					fmt::format_to(out, R"(,{{"name":"thread_sort_index","ph":"M","pid":1,"tid":{},"args":{{"sort_index":{}}}}})", track, track);
+				}
+
+				for (const captured_zone& zone: capture)
+				{
+					const f64 begin_us    = static_cast<f64>(zone.begin_ns - capture_begin) / 1000.0;
+					const f64 duration_us = static_cast<f64>(std::max<i64>(zone.end_ns - zone.begin_ns, 0)) / 1000.0;
+
+					fmt::format_to(out, R"(,{{"name":"{}","cat":"{}","ph":"X","ts":{:.3f},"dur":{:.3f},"pid":1,"tid":{})", escape(zone.p_site->p_name), zone.track == gpu_track ? "gpu" : "cpu", begin_us, duration_us, zone.track);
+
+					if (zone.p_site->line != 0)
+					{
+						fmt::format_to(out, R"(,"args":{{"file":"{}","line":{}}})", escape(zone.p_site->p_file), zone.p_site->line);
+					}
+
+					fmt::format_to(out, "}}");
+				}
+
+				fmt::format_to(out, "]}}\n");
+
+				std::FILE* p_file = std::fopen(path.string().c_str(), "wb");
+				if (p_file == nullptr)
+				{
+					log::error(log_source::none, "Failed to open profiler capture {}.", path.string());
+					return false;
+				}
+
+				const std::size_t written = std::fwrite(output.data(), 1, output.size(), p_file);
+				std::fclose(p_file);
+
+				if (written != output.size())
+				{
+					log::error(log_source::none, "Failed to write profiler capture {}.", path.string());
+					return false;
+				}
+
+				log::info(log_source::none, "Profiler capture with {} zones written to {}.", capture.size(), path.string());
+
+				return true;
+			}
+
+			std::vector<profile_zone_summary> get_summary() const
+			{
+				std::lock_guard const lock(m_statistics_mutex);
+
+				std::vector<profile_zone_summary> summary;
+
+				const u64 frames = std::min<u64>(m_frames, m_create_info.history_frames);
+				if (frames == 0)
+				{
+					return summary;
+				}
+
+				summary.reserve(m_zones.size());
+
+				for (const zone_history& zone: m_zones)
+				{
+					i64 total   = 0;
+					i64 maximum = 0;
+					u64 calls   = 0;
+
+					for (u64 slot = 0; slot < frames; ++slot)
+					{
+						total += zone.totals[slot];
+						maximum = std::max(maximum, zone.totals[slot]);
+						calls += zone.calls[slot];
+					}
+
+					if (calls == 0)
+					{
+						continue;
+					}
+
+					summary.push_back({
+					        .p_name          = zone.p_site->p_name,
+					        .gpu             = zone.gpu,
+					        .average_ms      = static_cast<f64>(total) / static_cast<f64>(frames) / 1e6,
+					        .max_ms          = static_cast<f64>(maximum) / 1e6,
+					        .calls_per_frame = static_cast<f64>(calls) / static_cast<f64>(frames),
+					});
+				}
+
+				std::sort(summary.begin(), summary.end(), [](const profile_zone_summary& lhs, const profile_zone_summary& rhs) {
+					return lhs.average_ms > rhs.average_ms;
+				});
+
+				return summary;
+			}
+
+			profiler_statistics get_statistics() const
+			{
+				profiler_statistics statistics = {};
+
+				{
+					std::lock_guard const lock(m_statistics_mutex);
+
+					statistics.frames        = m_frames;
+					statistics.window        = std::min<u64>(m_frames, m_create_info.history_frames);
+					statistics.zones         = m_zone_count;
+					statistics.captured      = m_capture.size();
+					statistics.capture_drops = m_capture_drops;
+				}
+
+				std::lock_guard const lock(m_rings_mutex);
+
+				statistics.dropped = m_retired_dropped + m_gpu_ring.dropped();
+				for (const auto& ring: m_rings)
+				{
+					statistics.dropped += ring->dropped();
+				}
+
+				statistics.threads = static_cast<u32>(m_rings.size());
+
+				return statistics;
+			}
+
+		private:
+			static constexpr u32 frame_track        = 0;
+			static constexpr u32 gpu_track          = 1;
+			static constexpr u32 first_thread_track = 2;
+
+			static constexpr i64 calibration_spin_ns = 2'000'000;
+
+			struct thread_ring_handle
+			{
+				u64 owner = 0;
+				std::shared_ptr<profile_ring> ring;
+
+				~thread_ring_handle()
+				{
+					if (ring)
+					{
+						ring->orphaned.store(true, std::memory_order_release);
+					}
+				}
+			};
+
+			struct zone_history
+			{
+				const profile_zone_site* p_site = nullptr;
+				b8 gpu                          = false;
+				i64 frame_total                 = 0;
+				u32 frame_calls                 = 0;
+				std::vector<i64> totals; // Per frame of the rolling window.
+				std::vector<u32> calls;
+			};
+
+			struct captured_zone
+			{
+				const profile_zone_site* p_site = nullptr;
+				i64 begin_ns                    = 0;
+				i64 end_ns                      = 0;
+				u32 track                       = 0;
+			};
+
+			profile_ring& get_thread_ring()
+			{
+				thread_ring_handle& handle = t_ring_handle;
+
+				if (handle.owner != m_id)
+				{
+					if (handle.ring)
+					{
+						handle.ring->orphaned.store(true, std::memory_order_release);
+					}
+
+					std::lock_guard const lock(m_rings_mutex);
+
+					handle.owner = m_id;
+					handle.ring  = std::make_shared<profile_ring>(m_create_info.ring_size, static_cast<u32>(m_track_names.size()));
+
+					m_rings.push_back(handle.ring);
+					m_track_names.emplace_back();
+				}
+
+				return *handle.ring;
+			}
+
+			// Samples both clocks, the rate is taken over everything since initialization.
+			void calibrate()
+			{
+				const i64 ticks = profiler::ticks();
+				const i64 ns    = profiler::now();
+
+				if (ticks != m_calibration_ticks)
+				{
+					m_ns_per_tick = static_cast<f64>(ns - m_calibration_ns) / static_cast<f64>(ticks - m_calibration_ticks);
+				}
+
+				m_reference_ticks = ticks;
+				m_reference_ns    = ns;
+			}
+
+			cc_nodiscard i64 to_ns(i64 ticks) const noexcept
+			{
+				if (!m_tsc)
+				{
+					return ticks;
+				}
+
+				return m_reference_ns + static_cast<i64>(static_cast<f64>(ticks - m_reference_ticks) * m_ns_per_tick);
+			}
+
+			// Expects m_statistics_mutex to be held.
+			void accumulate(const profile_event& event, b8 gpu, u32 track)
+			{
+				auto& indices             = gpu ? m_gpu_indices : m_cpu_indices;
+				const auto [it, inserted] = indices.try_emplace(event.p_site, static_cast<u32>(m_zones.size()));
+
+				if (inserted)
+				{
+					m_zones.push_back({
+					        .p_site = event.p_site,
+					        .gpu    = gpu,
+					        .totals = std::vector<i64>(m_create_info.history_frames, 0),
+					        .calls  = std::vector<u32>(m_create_info.history_frames, 0),
+					});
+				}
+
+				zone_history& zone = m_zones[it->second];
+				zone.frame_total += event.end - event.begin;
+				++zone.frame_calls;
+
+				if (m_capturing && event.begin >= m_capture_begin)
+				{
+					if (m_capture.size() < m_create_info.max_capture_events)
+					{
+						m_capture.push_back({ event.p_site, event.begin, event.end, track });
+					}
+					else
+					{
+						++m_capture_drops;
+					}
+				}
+			}
+
+			static std::string escape(std::string_view text)
+			{
+				std::string escaped;
+				escaped.reserve(text.size());
+
+				for (const char character: text)
+				{
+					switch (character)
+					{
+						case '"':
+							escaped += "\\\"";
+							break;
+						case '\\':
+							escaped += "\\\\";
+							break;
+						default:
+							if (static_cast<unsigned char>(character) < 0x20)
+							{
+								escaped += fmt::format("\\u{:04x}", static_cast<u32>(character));
+							}
+							else
+							{
+								escaped += character;
+							}
+					}
+				}
+
+				return escaped;
+			}
+
+			static thread_local thread_ring_handle t_ring_handle;
+			static std::atomic<u64> s_next_backend_id;
+
+			profiler_create_info m_create_info;
+			u64 m_id = 0;
+
+			mutable std::mutex m_rings_mutex;
+			std::vector<std::shared_ptr<profile_ring>> m_rings;
+			std::vector<std::string> m_track_names;
+			u64 m_retired_dropped = 0;
+
+			profile_ring m_gpu_ring;
+
+			b8 m_tsc                = false;
+			i64 m_calibration_ticks = 0; // Sampled together with m_calibration_ns on initialization.
+			i64 m_calibration_ns    = 0;
+			i64 m_reference_ticks   = 0; // Sampled together with m_reference_ns on the last end_frame().
+			i64 m_reference_ns      = 0;
+			f64 m_ns_per_tick       = 1.0;
+
+			std::mutex m_sites_mutex;
+			std::unordered_map<std::string_view, std::unique_ptr<profile_zone_site>> m_interned_sites;
+
+			mutable std::mutex m_statistics_mutex;
+			std::unordered_map<const profile_zone_site*, u32> m_cpu_indices;
+			std::unordered_map<const profile_zone_site*, u32> m_gpu_indices;
+			std::vector<zone_history> m_zones;
+			i64 m_frame_begin = 0;
+			u64 m_frames      = 0;
+			u64 m_zone_count  = 0;
+
+			std::vector<captured_zone> m_capture;
+			i64 m_capture_begin = 0;
+			u64 m_capture_drops = 0;
+			b8 m_capturing      = false;
+		};
+
+		thread_local profiler_backend::thread_ring_handle profiler_backend::t_ring_handle;
+		std::atomic<u64> profiler_backend::s_next_backend_id = 1;
+	} // namespace details
+
+	std::atomic<b8> profiler::s_active                             = false;
+	b8 profiler::s_tsc                                             = false;
+	std::unique_ptr<details::profiler_backend> profiler::s_backend = nullptr;
+
+	void profiler::initialize(const profiler_create_info& create_info)
+	{
+		shutdown();
+
+		s_tsc     = details::has_invariant_tsc();
+		s_backend = std::make_unique<details::profiler_backend>(create_info, s_tsc);
+		s_active.store(true, std::memory_order_release);
+
+		log::info(log_source::none, "Profiler initialized, timing zones with {}.", s_tsc ? "the time stamp counter" : "the steady clock");
+	}
+
+	void profiler::shutdown()
+	{
+		if (!s_backend)
+		{
+			return;
+		}
+
+		s_active.store(false, std::memory_order_release);
+
+		const profiler_statistics statistics = s_backend->get_statistics();
+		log::info(log_source::none, "Profiler shut down after {} frames, {} zones recorded, {} dropped.", statistics.frames, statistics.zones, statistics.dropped);
+
+		s_backend.reset();
+	}
+
+	void profiler::record(const profile_zone_site& site, i64 begin_ticks, i64 end_ticks) noexcept
+	{
+		if (is_active())
+		{
+			s_backend->record({ &site, begin_ticks, end_ticks });
+		}
+	}
+
+	void profiler::record_gpu(const profile_zone_site& site, i64 begin_ns, i64 end_ns) noexcept
+	{
+		if (is_active())
+		{
+			s_backend->record_gpu({ &site, begin_ns, end_ns });
+		}
+	}
+
+	const profile_zone_site& profiler::intern(const char* p_name)
+	{
+		static constexpr profile_zone_site inactive_site = { "inactive", __FILE__, __LINE__ };
+
+		if (!s_backend)
+		{
+			return inactive_site;
+		}
+
+		return s_backend->intern(p_name);
+	}
+
+	void profiler::set_thread_name(const char* p_name)
+	{
+		if (s_backend)
+		{
+			s_backend->set_thread_name(p_name);
+		}
+	}
+
+	void profiler::end_frame()
+	{
+		if (s_backend)
+		{
+			s_backend->end_frame();
+		}
+	}
+
+	void profiler::begin_capture()
+	{
+		if (s_backend)
+		{
+			s_backend->begin_capture();
+		}
+	}
+
+	b8 profiler::end_capture(const std::filesystem::path& path)
+	{
+		if (!s_backend)
+		{
+			return false;
+		}
+
+		return s_backend->end_capture(path);
+	}
+
+	std::vector<profile_zone_summary> profiler::get_summary()
+	{
+		if (s_backend)
+		{
+			return s_backend->get_summary();
+		}
+
+		return {};
+	}
+
+	profiler_statistics profiler::get_statistics()
+	{
+		if (s_backend)
+		{
+			return s_backend->get_statistics();
+		}
+
+		return {};
+	}
+
+	void profiler::log_summary(u32 max_zones)
+	{
+		const std::vector<profile_zone_summary> summary = get_summary();
+		const profiler_statistics statistics            = get_statistics();
+
+		log::info(log_source::none, "Profiler summary over the last {} frames:", statistics.window);
+
+		for (u32 i = 0; i < std::min<std::size_t>(summary.size(), max_zones); ++i)
+		{
+			const profile_zone_summary& zone = summary[i];
+			log::info(log_source::none, "  {:<32} {:>4} {:>9.3f} ms avg {:>9.3f} ms max {:>8.1f} calls", zone.p_name, zone.gpu ? "GPU" : "CPU", zone.average_ms, zone.max_ms, zone.calls_per_frame);
+		}
+
+		if (statistics.dropped != 0)
+		{
+			log::warning(log_source::none, "Profiler dropped {} zones, consider a larger ring size.", statistics.dropped);
+		}
+	}
+} // namespace cc
@@ -3,50 +3,143 @@
 
 #include "capricorn/base/window.hpp"
 
+#include "capricorn/graphics/glfw_shared_state.hpp"
+
 namespace cc
 {
 	window::window(const char* title, const u32 width, const u32 height)
-	    : m_p_title(title),
-	      m_width(width),
-	      m_height(height)
-	{
-		ensure(glfwInit(), "Failed to initialize GLFW!");
-		ensure(glfwVulkanSupported(), "Vulkan is not supported!");
-
-		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-
-		m_window = std::shared_ptr<GLFWwindow>(glfwCreateWindow(static_cast<i32>(m_width), static_cast<i32>(m_height), m_p_title, nullptr, nullptr));
-		ensure(m_window.operator bool(), "Failed to create GLFW window!");
-
-		vk::instance_create_info const instance_create_info = {
-		        .p_application_name        = "Capricorn",
-		        .p_engine_name             = "Capricorn",
-		        .application_version       = VK_MAKE_VERSION(0, 0, 1),
-		        .engine_version            = VK_MAKE_VERSION(0, 0, 1),
-		        .api_version               = VK_API_VERSION_1_0,
-		        .validation_layers_enabled = true,
-		};
+	    : window(window_create_info{ .p_title = title, .width = width, .height = height })
+	{
+	}
+
+	window::window(const window_create_info& create_info)
+	    : m_p_title(create_info.p_title),
+	      m_width(create_info.width),
+	      m_height(create_info.height),
+	      m_headless(create_info.headless)
+	{
+		using clock = std::chrono::steady_clock;
+
+		if (!m_headless)
+		{
+			const clock::time_point init_start = clock::now();
+
+			ensure(glfwInit(), "Failed to initialize GLFW!");
+			ensure(glfwVulkanSupported(), "Vulkan is not supported!");
+
+			// The graphics context creates its instance on another thread, fill the unsynchronized extension cache here.
+			glfw_shared_state::query_required_extensions();
+
+			m_startup_timing.glfw_init_seconds = std::chrono::duration<f64>(clock::now() - init_start).count();
+		}
 
 		graphics_context_create_info const graphics_context_create_info = {
-		        .p_window = m_window,
+		        .headless                = m_headless,
+		        .extent                  = { m_width, m_height },
+		        .p_capability_cache_path = create_info.p_capability_cache_path,
+		        .p_preferred_device      = create_info.p_preferred_device,
+		        .validation              = create_info.validation,
+		        .present_policy          = create_info.present_policy,
+		        .frames_in_flight        = create_info.frames_in_flight,
 		};
 
+		// Starts instance creation and device discovery, which overlap with creating the window below.
 		m_graphics_context = graphics_context::create(graphics_context_create_info);
+
+		if (!m_headless)
+		{
+			const clock::time_point window_start = clock::now();
+
+			glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+			glfwWindowHint(GLFW_RESIZABLE, create_info.resizable ? GLFW_TRUE : GLFW_FALSE);
+
+			m_window = std::shared_ptr<GLFWwindow>(glfwCreateWindow(static_cast<i32>(m_width), static_cast<i32>(m_height), m_p_title, nullptr, nullptr), glfwDestroyWindow);
+			ensure(m_window.operator bool(), "Failed to create GLFW window!");
+
+			glfwSetWindowUserPointer(m_window.get(), this);
+			glfwSetFramebufferSizeCallback(m_window.get(), [](GLFWwindow* p_window, i32 width, i32 height) {
+				auto* p_this = static_cast<window*>(glfwGetWindowUserPointer(p_window));
+				p_this->on_framebuffer_resized(width, height);
+			});
+
+			m_startup_timing.window_creation_seconds = std::chrono::duration<f64>(clock::now() - window_start).count();
+		}
+
+		m_graphics_context->initialize(m_window);
+
+		m_startup_timing.graphics = m_graphics_context->get_timing();
+	}
+
+	void window::on_framebuffer_resized(i32 width, i32 height)
+	{
+		m_width  = static_cast<u32>(width);
+		m_height = static_cast<u32>(height);
+
+		// Ignored until the swapchain exists, it takes its initial size from the surface.
+		m_graphics_context->resize(m_width, m_height);
 	}
 
 	void window::tick()
 	{
-		glfwPollEvents();
+		if (!m_headless)
+		{
+			glfwPollEvents();
+		}
+	}
+
+	void window::wait_events(f64 timeout_seconds)
+	{
+		if (m_headless)
+		{
+			std::this_thread::sleep_for(std::chrono::duration<f64>(timeout_seconds));
+			return;
+		}
+
+		glfwWaitEventsTimeout(timeout_seconds);
+	}
+
+	void window::request_close()
+	{
+		m_close_requested = true;
+
+		if (!m_headless)
+		{
+			glfwSetWindowShouldClose(m_window.get(), GLFW_TRUE);
+		}
 	}
 
 	b8 window::should_close() const
 	{
-		return glfwWindowShouldClose(m_window.get());
+		return m_headless ? m_close_requested : glfwWindowShouldClose(m_window.get());
+	}
+
+	b8 window::is_focused() const
+	{
+		return m_headless || glfwGetWindowAttrib(m_window.get(), GLFW_FOCUSED) == GLFW_TRUE;
+	}
+
+	b8 window::is_minimized() const
+	{
+		return !m_headless && glfwGetWindowAttrib(m_window.get(), GLFW_ICONIFIED) == GLFW_TRUE;
+	}
+
+	b8 window::is_headless() const
+	{
+		return m_headless;
 	}
 
 	std::weak_ptr<GLFWwindow> window::get_native_window() const
 	{
 		return m_window;
 	}
+
+	std::weak_ptr<graphics_context> window::get_graphics_context() const
+	{
+		return m_graphics_context;
+	}
+
+	const window_startup_timing& window::get_startup_timing() const noexcept
+	{
+		return m_startup_timing;
+	}
 } // namespace cc
\ No newline at end of file
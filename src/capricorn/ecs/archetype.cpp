@@ -0,0 +1,295 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/ecs/archetype.hpp"
+
+#include "capricorn/memory/memory_tracker.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cc::ecs
+{
+	namespace
+	{
+		constexpr u32 align_up(u32 value, std::size_t alignment) noexcept
+		{
+			const auto mask = static_cast<u32>(alignment - 1);
+			return (value + mask) & ~mask;
+		}
+
+		std::byte* allocate_chunk()
+		{
+			memory_tracker::allocated(memory_tag::ecs, chunk_size);
+			return static_cast<std::byte*>(::operator new(chunk_size, std::align_val_t{ chunk_alignment }));
+		}
+
+		void free_chunk(std::byte* p_data) noexcept
+		{
+			if (p_data != nullptr)
+			{
+				::operator delete(p_data, std::align_val_t{ chunk_alignment });
+				memory_tracker::freed(memory_tag::ecs, chunk_size);
+			}
+		}
+	} // namespace
+
+	archetype::archetype(u32 index, const component_mask& mask) : m_index(index), m_mask(mask)
+	{
+		m_columns.fill(no_column);
+
+		u32 row_size = sizeof(entity);
+
+		for (u32 id = 0; id < max_components; ++id)
+		{
+			if (!mask.test(id))
+			{
+				continue;
+			}
+
+			const component_info& info = component_registry::get_info(static_cast<component_id>(id));
+
+			m_columns[id] = static_cast<u16>(m_components.size());
+			m_components.push_back(static_cast<component_id>(id));
+			m_infos.push_back(&info);
+			m_trivial = m_trivial && info.trivial;
+			row_size += info.size;
+		}
+
+		m_offsets.resize(m_components.size());
+
+		// Every column starts on a cache line, so the first guess can be a few rows too many.
+		const auto layout = [this](u32 capacity) {
+			u32 offset = align_up(capacity * static_cast<u32>(sizeof(entity)), chunk_alignment);
+
+			for (std::size_t column = 0; column < m_infos.size(); ++column)
+			{
+				m_offsets[column] = offset;
+				offset            = align_up(offset + capacity * m_infos[column]->size, chunk_alignment);
+			}
+
+			return offset;
+		};
+
+		m_capacity = static_cast<u32>(chunk_size / row_size);
+		ensure(m_capacity > 0, "Components of an archetype do not fit a chunk!");
+
+		while (m_capacity > 1 && layout(m_capacity) > chunk_size)
+		{
+			--m_capacity;
+		}
+
+		ensure(layout(m_capacity) <= chunk_size, "Components of an archetype do not fit a chunk!");
+	}
+
+	archetype::~archetype()
+	{
+		for (const chunk& chunk: m_chunks)
+		{
+			if (!m_trivial)
+			{
+				for (u32 row = 0; row < chunk.count; ++row)
+				{
+					destroy_row(chunk, row);
+				}
+			}
+
+			free_chunk(chunk.p_data);
+		}
+
+		free_chunk(m_p_spare_chunk);
+	}
+
+	u32 archetype::get_index() const noexcept
+	{
+		return m_index;
+	}
+
+	const component_mask& archetype::get_mask() const noexcept
+	{
+		return m_mask;
+	}
+
+	const std::vector<component_id>& archetype::get_components() const noexcept
+	{
+		return m_components;
+	}
+
+	u32 archetype::get_capacity() const noexcept
+	{
+		return m_capacity;
+	}
+
+	u32 archetype::get_chunk_count() const noexcept
+	{
+		return static_cast<u32>(m_chunks.size());
+	}
+
+	u32 archetype::get_entity_count() const noexcept
+	{
+		return m_entity_count;
+	}
+
+	const chunk& archetype::get_chunk(u32 index) const noexcept
+	{
+		return m_chunks[index];
+	}
+
+	void* archetype::get_component(entity_location location, u16 column) const noexcept
+	{
+		return m_chunks[location.chunk].p_data + m_offsets[column] + static_cast<std::size_t>(location.row) * m_infos[column]->size;
+	}
+
+	entity_location archetype::allocate(entity entity)
+	{
+		if (m_chunks.empty() || m_chunks.back().count == m_capacity)
+		{
+			std::byte* p_data = m_p_spare_chunk != nullptr ? m_p_spare_chunk : allocate_chunk();
+			m_p_spare_chunk   = nullptr;
+
+			m_chunks.push_back({ .p_data = p_data, .count = 0 });
+		}
+
+		chunk& chunk = m_chunks.back();
+
+		const entity_location location = {
+		        .chunk = static_cast<u32>(m_chunks.size() - 1),
+		        .row   = chunk.count,
+		};
+
+		get_entities(chunk)[location.row] = entity;
+
+		++chunk.count;
+		++m_entity_count;
+
+		return location;
+	}
+
+	entity archetype::remove(entity_location location, b8 destroy) noexcept
+	{
+		chunk& target      = m_chunks[location.chunk];
+		chunk& last        = m_chunks.back();
+		const u32 last_row = last.count - 1;
+
+		entity moved = null_entity;
+
+		if (destroy && !m_trivial)
+		{
+			destroy_row(target, location.row);
+		}
+
+		if (&target != &last || location.row != last_row)
+		{
+			for (std::size_t column = 0; column < m_infos.size(); ++column)
+			{
+				const component_info& info = *m_infos[column];
+
+				if (info.size == 0)
+				{
+					continue;
+				}
+
+				std::byte* p_destination = target.p_data + m_offsets[column] + static_cast<std::size_t>(location.row) * info.size;
+				std::byte* p_source      = last.p_data + m_offsets[column] + static_cast<std::size_t>(last_row) * info.size;
+
+				if (info.trivial)
+				{
+					std::memcpy(p_destination, p_source, info.size);
+				}
+				else
+				{
+					info.p_relocate(p_destination, p_source);
+				}
+			}
+
+			moved                              = get_entities(last)[last_row];
+			get_entities(target)[location.row] = moved;
+		}
+
+		--last.count;
+		--m_entity_count;
+
+		if (last.count == 0)
+		{
+			free_chunk(m_p_spare_chunk);
+			m_p_spare_chunk = last.p_data;
+			m_chunks.pop_back();
+		}
+
+		return moved;
+	}
+
+	void archetype::relocate(entity_location location, archetype& target, entity_location target_location) noexcept
+	{
+		const chunk& source = m_chunks[location.chunk];
+
+		for (std::size_t column = 0; column < m_infos.size(); ++column)
+		{
+			const component_info& info = *m_infos[column];
+			const u16 target_column    = target.get_column(m_components[column]);
+
+			if (info.size == 0 || target_column == no_column)
+			{
+				continue;
+			}
+
+			std::byte* p_source = source.p_data + m_offsets[column] + static_cast<std::size_t>(location.row) * info.size;
+			void* p_destination = target.get_component(target_location, target_column);
+
+			if (info.trivial)
+			{
+				std::memcpy(p_destination, p_source, info.size);
+			}
+			else
+			{
+				info.p_relocate(p_destination, p_source);
+			}
+		}
+
+		// What the target does not have is dropped here, the row itself is removed by the caller without destroying.
+		for (std::size_t column = 0; column < m_infos.size(); ++column)
+		{
+			const component_info& info = *m_infos[column];
+
+			if (info.size != 0 && !info.trivial && target.get_column(m_components[column]) == no_column)
+			{
+				info.p_destroy(source.p_data + m_offsets[column] + static_cast<std::size_t>(location.row) * info.size);
+			}
+		}
+	}
+
+	archetype* archetype::get_add_edge(component_id component) const noexcept
+	{
+		const auto iterator = std::find_if(m_add_edges.begin(), m_add_edges.end(), [component](const edge& edge) { return edge.component == component; });
+		return iterator != m_add_edges.end() ? iterator->p_archetype : nullptr;
+	}
+
+	archetype* archetype::get_remove_edge(component_id component) const noexcept
+	{
+		const auto iterator = std::find_if(m_remove_edges.begin(), m_remove_edges.end(), [component](const edge& edge) { return edge.component == component; });
+		return iterator != m_remove_edges.end() ? iterator->p_archetype : nullptr;
+	}
+
+	void archetype::set_add_edge(component_id component, archetype* p_archetype)
+	{
+		m_add_edges.push_back({ .component = component, .p_archetype = p_archetype });
+	}
+
+	void archetype::set_remove_edge(component_id component, archetype* p_archetype)
+	{
+		m_remove_edges.push_back({ .component = component, .p_archetype = p_archetype });
+	}
+
+	void archetype::destroy_row(const chunk& chunk, u32 row) noexcept
+	{
+		for (std::size_t column = 0; column < m_infos.size(); ++column)
+		{
+			const component_info& info = *m_infos[column];
+
+			if (info.size != 0 && !info.trivial)
+			{
+				info.p_destroy(chunk.p_data + m_offsets[column] + static_cast<std::size_t>(row) * info.size);
+			}
+		}
+	}
+} // namespace cc::ecs
@@ -0,0 +1,162 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/ecs/command_buffer.hpp"
+
+#include "capricorn/ecs/world.hpp"
+
+#include <cstring>
+
+namespace cc::ecs
+{
+	command_buffer::command_buffer(world& world) : m_p_world(&world)
+	{
+	}
+
+	command_buffer::~command_buffer()
+	{
+		clear();
+	}
+
+	entity command_buffer::create()
+	{
+		return m_p_world->reserve();
+	}
+
+	void command_buffer::destroy(entity entity)
+	{
+		m_commands.push_back({ .type = command_type::destroy, .target = entity });
+	}
+
+	void command_buffer::playback()
+	{
+		if (m_commands.empty())
+		{
+			return;
+		}
+
+		// Entities created through this or any other buffer become alive before anything refers to them.
+		m_p_world->flush();
+
+		for (command& command: m_commands)
+		{
+			switch (command.type)
+			{
+				case command_type::destroy:
+					m_p_world->destroy(command.target);
+					break;
+
+				case command_type::add:
+				{
+					const component_info& info = component_registry::get_info(command.component);
+
+					if (!m_p_world->is_alive(command.target))
+					{
+						if (command.p_payload != nullptr && !info.trivial)
+						{
+							info.p_destroy(command.p_payload);
+						}
+
+						++m_dropped;
+						break;
+					}
+
+					void* p_component = m_p_world->add_uninitialized(command.target, command.component);
+
+					if (command.p_payload == nullptr)
+					{
+						break;
+					}
+
+					if (info.trivial)
+					{
+						std::memcpy(p_component, command.p_payload, info.size);
+					}
+					else
+					{
+						info.p_relocate(p_component, command.p_payload);
+					}
+
+					break;
+				}
+
+				case command_type::remove:
+					if (!m_p_world->is_alive(command.target))
+					{
+						++m_dropped;
+						break;
+					}
+
+					m_p_world->remove(command.target, command.component);
+					break;
+			}
+
+			// Relocated or destroyed, either way it is gone.
+			command.p_payload = nullptr;
+		}
+
+		clear();
+	}
+
+	void command_buffer::clear()
+	{
+		for (const command& command: m_commands)
+		{
+			if (command.p_payload == nullptr)
+			{
+				continue;
+			}
+
+			const component_info& info = component_registry::get_info(command.component);
+
+			if (!info.trivial)
+			{
+				info.p_destroy(command.p_payload);
+			}
+		}
+
+		m_commands.clear();
+		m_page      = 0;
+		m_page_used = 0;
+	}
+
+	b8 command_buffer::is_empty() const noexcept
+	{
+		return m_commands.empty();
+	}
+
+	u32 command_buffer::get_command_count() const noexcept
+	{
+		return static_cast<u32>(m_commands.size());
+	}
+
+	u64 command_buffer::get_dropped_count() const noexcept
+	{
+		return m_dropped;
+	}
+
+	void* command_buffer::allocate_payload(std::size_t size)
+	{
+		const auto aligned_size = static_cast<u32>((size + 15) & ~static_cast<std::size_t>(15));
+
+		if (m_pages.empty() || m_page_used + aligned_size > page_size)
+		{
+			if (!m_pages.empty())
+			{
+				++m_page;
+			}
+
+			if (m_page == m_pages.size())
+			{
+				m_pages.push_back(std::make_unique<page>());
+			}
+
+			m_page_used = 0;
+		}
+
+		void* p_payload = m_pages[m_page]->data + m_page_used;
+		m_page_used += aligned_size;
+
+		return p_payload;
+	}
+} // namespace cc::ecs
@@ -0,0 +1,44 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/ecs/component.hpp"
+
+#include "capricorn/base/log.hpp"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+
+namespace cc::ecs
+{
+	namespace
+	{
+		// Entries are written before the count that publishes them, readers only look below the count.
+		std::array<component_info, max_components> s_components;
+		std::atomic<u32> s_component_count = 0;
+		std::mutex s_registration_mutex;
+	} // namespace
+
+	const component_info& component_registry::get_info(component_id id) noexcept
+	{
+		return s_components[id];
+	}
+
+	u32 component_registry::get_count() noexcept
+	{
+		return s_component_count.load(std::memory_order_acquire);
+	}
+
+	component_id component_registry::register_component(const component_info& info)
+	{
+		std::lock_guard const lock(s_registration_mutex);
+
+		const u32 id = s_component_count.load(std::memory_order_relaxed);
+		ensure(id < max_components, "Too many component types, raise ecs::max_components!");
+
+		s_components[id] = info;
+		s_component_count.store(id + 1, std::memory_order_release);
+
+		return static_cast<component_id>(id);
+	}
+} // namespace cc::ecs
@@ -0,0 +1,194 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/ecs/system_scheduler.hpp"
+
+#include "capricorn/base/profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <optional>
+
+namespace cc::ecs
+{
+	system_builder::system_builder(system_scheduler& scheduler, u32 system) : m_scheduler(scheduler), m_system(system)
+	{
+	}
+
+	system_builder& system_builder::set_exclusive()
+	{
+		m_scheduler.m_systems[m_system].exclusive = true;
+		return *this;
+	}
+
+	system_scheduler::system_scheduler(const system_scheduler_create_info& create_info)
+	    : m_world(create_info.p_world.lock()),
+	      m_job_system(create_info.p_job_system.lock())
+	{
+		ensure(m_world != nullptr, "System scheduler requires a world!");
+	}
+
+	std::shared_ptr<system_scheduler> system_scheduler::create(const system_scheduler_create_info& create_info)
+	{
+		return std::make_shared<system_scheduler>(create_info);
+	}
+
+	void system_scheduler::add_system(const char* p_name, const setup_function& setup, execute_function execute)
+	{
+		const auto index = static_cast<u32>(m_systems.size());
+
+		m_systems.push_back({
+		        .p_name     = p_name,
+		        .reads      = {},
+		        .writes     = {},
+		        .exclusive  = false,
+		        .execute    = std::move(execute),
+		        .p_commands = std::make_unique<command_buffer>(*m_world),
+		});
+
+		system_builder builder(*this, index);
+
+		if (setup)
+		{
+			setup(builder);
+		}
+
+		m_waves_dirty = true;
+	}
+
+	void system_scheduler::run(f64 delta_time)
+	{
+		cc_profile_zone("system_scheduler::run");
+
+		using clock = std::chrono::steady_clock;
+
+		const clock::time_point run_start = clock::now();
+
+		if (m_waves_dirty)
+		{
+			build_waves();
+		}
+
+		for (const std::vector<u32>& wave: m_waves)
+		{
+			if (wave.size() == 1 || m_job_system == nullptr)
+			{
+				for (const u32 system: wave)
+				{
+					run_system(m_systems[system], delta_time);
+				}
+
+				continue;
+			}
+
+			job_counter counter;
+
+			// The calling thread takes the last one itself, wait() keeps it busy with the others afterwards.
+			for (std::size_t index = 0; index + 1 < wave.size(); ++index)
+			{
+				system_node* p_system = &m_systems[wave[index]];
+
+				m_job_system->run([this, p_system, delta_time] { run_system(*p_system, delta_time); }, &counter);
+			}
+
+			run_system(m_systems[wave.back()], delta_time);
+			m_job_system->wait(counter);
+		}
+
+		const clock::time_point playback_start = clock::now();
+
+		u32 commands = 0;
+
+		for (system_node& system: m_systems)
+		{
+			commands += system.p_commands->get_command_count();
+			system.p_commands->playback();
+		}
+
+		const clock::time_point playback_end = clock::now();
+
+		m_statistics.commands         = commands;
+		m_statistics.run_seconds      = std::chrono::duration<f64>(playback_start - run_start).count();
+		m_statistics.playback_seconds = std::chrono::duration<f64>(playback_end - playback_start).count();
+	}
+
+	u32 system_scheduler::get_system_count() const noexcept
+	{
+		return static_cast<u32>(m_systems.size());
+	}
+
+	system_scheduler_statistics system_scheduler::get_statistics() const noexcept
+	{
+		return m_statistics;
+	}
+
+	b8 system_scheduler::conflicts(const system_node& lhs, const system_node& rhs) noexcept
+	{
+		if (lhs.exclusive || rhs.exclusive)
+		{
+			return true;
+		}
+
+		return (lhs.writes & (rhs.reads | rhs.writes)).any() || (rhs.writes & lhs.reads).any();
+	}
+
+	void system_scheduler::build_waves()
+	{
+		std::vector<u32> system_waves(m_systems.size(), 0);
+
+		m_waves.clear();
+
+		for (std::size_t index = 0; index < m_systems.size(); ++index)
+		{
+			u32 wave = 0;
+
+			for (std::size_t earlier = 0; earlier < index; ++earlier)
+			{
+				if (conflicts(m_systems[earlier], m_systems[index]))
+				{
+					wave = std::max(wave, system_waves[earlier] + 1);
+				}
+			}
+
+			system_waves[index] = wave;
+
+			if (wave == m_waves.size())
+			{
+				m_waves.emplace_back();
+			}
+
+			m_waves[wave].push_back(static_cast<u32>(index));
+		}
+
+		m_statistics.systems     = static_cast<u32>(m_systems.size());
+		m_statistics.waves       = static_cast<u32>(m_waves.size());
+		m_statistics.widest_wave = 0;
+
+		for (const std::vector<u32>& wave: m_waves)
+		{
+			m_statistics.widest_wave = std::max(m_statistics.widest_wave, static_cast<u32>(wave.size()));
+		}
+
+		m_waves_dirty = false;
+	}
+
+	void system_scheduler::run_system(system_node& system, f64 delta_time)
+	{
+		// Interned by name, so the zones of a system add up across frames.
+		std::optional<profile_scope> zone;
+
+		if (profiler_enabled && system.p_name != nullptr && profiler::is_active())
+		{
+			zone.emplace(profiler::intern(system.p_name));
+		}
+
+		system_context context = {
+		        .world        = *m_world,
+		        .commands     = *system.p_commands,
+		        .p_job_system = m_job_system.get(),
+		        .delta_time   = delta_time,
+		};
+
+		system.execute(context);
+	}
+} // namespace cc::ecs
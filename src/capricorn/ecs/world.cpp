@@ -0,0 +1,356 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/ecs/world.hpp"
+
+#include <algorithm>
+
+namespace cc::ecs
+{
+	world::world() : world(world_create_info{})
+	{
+	}
+
+	world::world(const world_create_info& create_info)
+	{
+		m_records.reserve(create_info.entity_capacity);
+		m_p_empty_archetype = &find_or_create_archetype({});
+	}
+
+	world::~world()
+	{
+		ensure(m_iterating.load(std::memory_order_relaxed) == 0, "World destroyed while a query iterates it!");
+
+		// Archetypes destroy the components still alive in their chunks.
+		m_queries.clear();
+		m_archetypes.clear();
+	}
+
+	std::shared_ptr<world> world::create(const world_create_info& create_info)
+	{
+		return std::make_shared<world>(create_info);
+	}
+
+	entity world::create()
+	{
+		begin_structural_change();
+
+		const entity created = allocate_entity();
+		place(created, *m_p_empty_archetype);
+
+		return created;
+	}
+
+	void world::destroy(entity entity)
+	{
+		begin_structural_change();
+
+		if (!is_alive(entity))
+		{
+			return;
+		}
+
+		entity_record& record   = m_records[entity.index];
+		const ecs::entity moved = record.p_archetype->remove(record.location, true);
+
+		if (!moved.is_null())
+		{
+			m_records[moved.index].location = record.location;
+		}
+
+		record.p_archetype = nullptr;
+		record.location    = {};
+		++record.generation;
+
+		m_free_indices.push_back(entity.index);
+		m_free_cursor.store(static_cast<i64>(m_free_indices.size()), std::memory_order_relaxed);
+	}
+
+	b8 world::is_alive(entity entity) const noexcept
+	{
+		return entity.index < m_records.size() && m_records[entity.index].generation == entity.generation && m_records[entity.index].p_archetype != nullptr;
+	}
+
+	void* world::add_uninitialized(entity entity, component_id component)
+	{
+		begin_structural_change();
+		ensure(is_alive(entity), "Added a component to an entity that is not alive!");
+
+		entity_record& record = m_records[entity.index];
+		archetype& source     = *record.p_archetype;
+		const u16 column      = source.get_column(component);
+
+		if (column != archetype::no_column)
+		{
+			void* p_component          = source.get_component(record.location, column);
+			const component_info& info = component_registry::get_info(component);
+
+			if (info.size != 0 && !info.trivial)
+			{
+				info.p_destroy(p_component);
+			}
+
+			return p_component;
+		}
+
+		archetype& target = get_add_target(source, component);
+		move(record, target);
+
+		return target.get_component(record.location, target.get_column(component));
+	}
+
+	void world::remove(entity entity, component_id component)
+	{
+		begin_structural_change();
+
+		if (!is_alive(entity))
+		{
+			return;
+		}
+
+		entity_record& record = m_records[entity.index];
+		archetype& source     = *record.p_archetype;
+
+		if (source.get_column(component) == archetype::no_column)
+		{
+			return;
+		}
+
+		move(record, get_remove_target(source, component));
+	}
+
+	void* world::get(entity entity, component_id component) const noexcept
+	{
+		if (!is_alive(entity))
+		{
+			return nullptr;
+		}
+
+		const entity_record& record = m_records[entity.index];
+		const u16 column            = record.p_archetype->get_column(component);
+
+		return column != archetype::no_column ? record.p_archetype->get_component(record.location, column) : nullptr;
+	}
+
+	query_state& world::get_query_state(const component_mask& required, const component_mask& excluded)
+	{
+		std::lock_guard const lock(m_query_mutex);
+
+		std::unique_ptr<query_state>& p_state = m_queries[{ .required = required, .excluded = excluded }];
+
+		if (p_state == nullptr)
+		{
+			p_state           = std::make_unique<query_state>();
+			p_state->required = required;
+			p_state->excluded = excluded;
+		}
+
+		return *p_state;
+	}
+
+	void world::update_query(query_state& state)
+	{
+		// Archetypes are only created by structural changes, which cannot overlap iteration, so the size is stable here.
+		const auto archetype_count = static_cast<u32>(m_archetypes.size());
+
+		if (state.examined.load(std::memory_order_acquire) == archetype_count)
+		{
+			return;
+		}
+
+		// Systems sharing a query may get here at the same time.
+		std::lock_guard const lock(m_query_mutex);
+
+		for (u32 index = state.examined.load(std::memory_order_relaxed); index < archetype_count; ++index)
+		{
+			archetype& candidate       = *m_archetypes[index];
+			const component_mask& mask = candidate.get_mask();
+
+			if ((mask & state.required) == state.required && (mask & state.excluded).none())
+			{
+				state.archetypes.push_back(&candidate);
+			}
+		}
+
+		state.examined.store(archetype_count, std::memory_order_release);
+	}
+
+	entity world::reserve() noexcept
+	{
+		const i64 cursor = m_free_cursor.fetch_sub(1, std::memory_order_relaxed) - 1;
+
+		if (cursor >= 0)
+		{
+			const u32 index = m_free_indices[static_cast<std::size_t>(cursor)];
+			return { .index = index, .generation = m_records[index].generation };
+		}
+
+		// Past the free list, slots are appended in the order they were reserved.
+		return { .index = static_cast<u32>(m_records.size() + static_cast<std::size_t>(-cursor - 1)), .generation = 0 };
+	}
+
+	void world::flush()
+	{
+		const i64 cursor      = m_free_cursor.load(std::memory_order_relaxed);
+		const auto free_count = static_cast<i64>(m_free_indices.size());
+
+		if (cursor == free_count)
+		{
+			return;
+		}
+
+		for (i64 index = std::max<i64>(cursor, 0); index < free_count; ++index)
+		{
+			const u32 slot = m_free_indices[static_cast<std::size_t>(index)];
+			place({ .index = slot, .generation = m_records[slot].generation }, *m_p_empty_archetype);
+		}
+
+		m_free_indices.resize(static_cast<std::size_t>(std::max<i64>(cursor, 0)));
+
+		if (cursor < 0)
+		{
+			const auto first = static_cast<u32>(m_records.size());
+			m_records.resize(m_records.size() + static_cast<std::size_t>(-cursor));
+
+			for (u32 slot = first; slot < m_records.size(); ++slot)
+			{
+				place({ .index = slot, .generation = 0 }, *m_p_empty_archetype);
+			}
+		}
+
+		m_free_cursor.store(static_cast<i64>(m_free_indices.size()), std::memory_order_relaxed);
+	}
+
+	u32 world::get_entity_count() const noexcept
+	{
+		return static_cast<u32>(m_records.size() - m_free_indices.size());
+	}
+
+	u32 world::get_archetype_count() const noexcept
+	{
+		return static_cast<u32>(m_archetypes.size());
+	}
+
+	const archetype& world::get_archetype(u32 index) const noexcept
+	{
+		return *m_archetypes[index];
+	}
+
+	world_statistics world::get_statistics() const
+	{
+		world_statistics statistics = {
+		        .entities   = get_entity_count(),
+		        .archetypes = get_archetype_count(),
+		        .queries    = static_cast<u32>(m_queries.size()),
+		        .moves      = m_moves,
+		};
+
+		for (const std::unique_ptr<archetype>& p_archetype: m_archetypes)
+		{
+			statistics.chunks += p_archetype->get_chunk_count();
+		}
+
+		return statistics;
+	}
+
+	void world::begin_structural_change()
+	{
+		ensure(m_iterating.load(std::memory_order_relaxed) == 0, "Structural change while a query iterates, record it into a command buffer instead!");
+		flush();
+	}
+
+	entity world::allocate_entity()
+	{
+		if (!m_free_indices.empty())
+		{
+			const u32 index = m_free_indices.back();
+			m_free_indices.pop_back();
+			m_free_cursor.store(static_cast<i64>(m_free_indices.size()), std::memory_order_relaxed);
+
+			return { .index = index, .generation = m_records[index].generation };
+		}
+
+		m_records.emplace_back();
+		return { .index = static_cast<u32>(m_records.size() - 1), .generation = 0 };
+	}
+
+	void world::place(entity entity, archetype& target)
+	{
+		entity_record& record = m_records[entity.index];
+
+		record.p_archetype = &target;
+		record.location    = target.allocate(entity);
+	}
+
+	void world::move(entity_record& record, archetype& target)
+	{
+		archetype& source                    = *record.p_archetype;
+		const entity_location target_location = target.allocate(source.get_entities(source.get_chunk(record.location.chunk))[record.location.row]);
+
+		source.relocate(record.location, target, target_location);
+
+		// The components were relocated or destroyed above, what is left of the row only needs filling.
+		const entity moved = source.remove(record.location, false);
+
+		if (!moved.is_null())
+		{
+			m_records[moved.index].location = record.location;
+		}
+
+		record.p_archetype = &target;
+		record.location    = target_location;
+
+		++m_moves;
+	}
+
+	archetype& world::find_or_create_archetype(const component_mask& mask)
+	{
+		const auto iterator = m_archetype_lookup.find(mask);
+
+		if (iterator != m_archetype_lookup.end())
+		{
+			return *iterator->second;
+		}
+
+		archetype& created = *m_archetypes.emplace_back(std::make_unique<archetype>(static_cast<u32>(m_archetypes.size()), mask));
+		m_archetype_lookup.emplace(mask, &created);
+
+		return created;
+	}
+
+	archetype& world::get_add_target(archetype& source, component_id component)
+	{
+		archetype* p_target = source.get_add_edge(component);
+
+		if (p_target == nullptr)
+		{
+			component_mask mask = source.get_mask();
+			mask.set(component);
+
+			p_target = &find_or_create_archetype(mask);
+
+			source.set_add_edge(component, p_target);
+			p_target->set_remove_edge(component, &source);
+		}
+
+		return *p_target;
+	}
+
+	archetype& world::get_remove_target(archetype& source, component_id component)
+	{
+		archetype* p_target = source.get_remove_edge(component);
+
+		if (p_target == nullptr)
+		{
+			component_mask mask = source.get_mask();
+			mask.reset(component);
+
+			p_target = &find_or_create_archetype(mask);
+
+			source.set_remove_edge(component, p_target);
+			p_target->set_add_edge(component, &source);
+		}
+
+		return *p_target;
+	}
+} // namespace cc::ecs
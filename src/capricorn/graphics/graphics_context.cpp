@@ -4,42 +4,424 @@
 #include "capricorn/graphics/graphics_context.hpp"
 
 #include "capricorn/graphics/vulkan/instance_configurator.hpp"
+#include "capricorn/graphics/vulkan/memory_allocator.hpp"
+#include "capricorn/graphics/vulkan/pipeline_cache.hpp"
 
 namespace cc
 {
 	graphics_context::graphics_context(const graphics_context_create_info& create_info)
-	    : m_window(create_info.p_window)
+	    : m_create_info(create_info),
+	      m_headless(create_info.headless)
 	{
-		vk::instance_configurator instance_configurator;
+		if (m_create_info.host_allocator)
+		{
+			m_host_allocator = vk::host_allocator::create({});
+		}
 
-		vk::instance_create_info const instance_create_info = instance_configurator
-		                                                              .set_application_name("Sample application")
-		                                                              .set_engine_name("Capricorn")
-		                                                              .set_application_version(1, 0, 0)
-		                                                              .set_engine_version(1, 0, 0)
-		                                                              .set_api_version(1, 0, 0)
-		                                                              .add_enabled_layer("VK_LAYER_KHRONOS_validation")
-		                                                              .add_enabled_extension(VK_KHR_SURFACE_EXTENSION_NAME)
-		                                                              .set_validation_layers_enabled(true)
-		                                                              .get_create_info();
+		if (m_create_info.p_capability_cache_path != nullptr)
+		{
+			m_capability_cache = vk::capability_cache::create({ .p_path = m_create_info.p_capability_cache_path });
+		}
 
-		m_instance = std::make_unique<vk::instance>(instance_create_info);
+		// Nothing here needs the window, so it runs while the caller creates one.
+		m_startup = std::async(std::launch::async, [this] {
+			create_instance();
+		});
+	}
 
-		VkSurfaceKHR surface = VK_NULL_HANDLE;
+	void graphics_context::initialize(std::weak_ptr<GLFWwindow> p_window)
+	{
+		ensure(m_startup.valid(), "Graphics context is already initialized!");
+
+		using clock = std::chrono::steady_clock;
+
+		const clock::time_point wait_start = clock::now();
+
+		// Rethrows whatever went wrong on the startup thread.
+		m_startup.get();
 
-		if (glfwCreateWindowSurface(*m_instance->get_handle().lock(), m_window.lock().get(), nullptr, &surface) != VK_SUCCESS)
+		const clock::time_point surface_start = clock::now();
+		m_timing.startup_wait_seconds         = std::chrono::duration<f64>(surface_start - wait_start).count();
+
+		m_window = std::move(p_window);
+
+		if (!m_headless)
 		{
-			throw std::runtime_error("Failed to create window surface!");
+			VkSurfaceKHR surface = VK_NULL_HANDLE;
+
+			if (glfwCreateWindowSurface(*m_instance->get_handle().lock(), m_window.lock().get(), m_instance->get_allocation_callbacks(), &surface) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create window surface!");
+			}
+
+			m_surface = std::make_shared<VkSurfaceKHR>(surface);
+		}
+		else if (m_instance->headless_surface_enabled())
+		{
+			create_headless_surface();
 		}
 
-		m_surface = std::make_shared<VkSurfaceKHR>(surface);
+		m_timing.surface_seconds = std::chrono::duration<f64>(clock::now() - surface_start).count();
 
-		vk::device_create_info const device_create_info = {
+		vk::device_create_info device_create_info = {
 		        m_instance,
 		        m_surface,
 		};
 
+		device_create_info.candidates         = std::move(m_candidates);
+		device_create_info.frames_in_flight   = m_create_info.frames_in_flight;
+		device_create_info.p_preferred_device = m_create_info.p_preferred_device;
+
+		if (m_surface == nullptr)
+		{
+			// Offscreen images are never presented, so the device does not need swapchain support.
+			device_create_info.required_device_extensions.clear();
+		}
+
 		m_logical_device = vk::logical_device::create(device_create_info);
+
+		m_timing.device_selection_seconds = m_logical_device->get_creation_timing().selection_seconds;
+		m_timing.device_creation_seconds  = m_logical_device->get_creation_timing().creation_seconds;
+
+		if (m_capability_cache != nullptr)
+		{
+			m_timing.capability_cache_hits   = m_capability_cache->get_statistics().hits;
+			m_timing.capability_cache_misses = m_capability_cache->get_statistics().misses;
+
+			// Only written once the device came up, so a cache that led to a failure is never persisted.
+			m_capability_cache->save();
+		}
+
+		if (m_surface == nullptr)
+		{
+			// One image per frame in flight, so an image is never rendered to while the previous frame still uses it.
+			vk::offscreen_target_create_info const offscreen_target_create_info = {
+			        .p_device    = m_logical_device,
+			        .extent      = m_create_info.extent,
+			        .image_count = m_create_info.frames_in_flight,
+			};
+
+			m_offscreen_target = vk::offscreen_target::create(offscreen_target_create_info);
+		}
+		else
+		{
+			vk::swapchain_create_info const swapchain_create_info = {
+			        .p_instance  = m_instance,
+			        .p_device    = m_logical_device,
+			        .p_surface   = m_surface,
+			        .extent      = m_create_info.extent,
+			        .policy      = m_create_info.present_policy,
+			        .image_count = m_create_info.swapchain_image_count,
+			};
+
+			m_swapchain = vk::swapchain::create(swapchain_create_info);
+		}
+
+		m_upload_service = vk::upload_service::create({ .p_device = m_logical_device });
+
+		if (m_logical_device->has_descriptor_indexing())
+		{
+			m_bindless_heap = vk::bindless_heap::create({ .p_device = m_logical_device });
+		}
+		else
+		{
+			log::warning(log_source::renderer, "Device lacks descriptor indexing, running without a bindless heap.");
+		}
+
+		if constexpr (profiler_enabled)
+		{
+			if (vk::gpu_profiler::is_supported(*m_logical_device))
+			{
+				m_gpu_profiler = vk::gpu_profiler::create({ .p_device = m_logical_device });
+			}
+			else
+			{
+				log::warning(log_source::renderer, "Graphics queue lacks timestamps, running without GPU zones.");
+			}
+		}
+
+		create_frame_resources();
+
+		if (m_headless)
+		{
+			log::info(log_source::renderer, "Running headless, rendering to {}.", m_surface != nullptr ? "a headless surface" : "offscreen images");
+		}
+	}
+
+	void graphics_context::update()
+	{
+		cc_profile_zone("graphics_context::update");
+
+		if (const auto p_pipeline_cache = m_logical_device->get_pipeline_cache().lock())
+		{
+			p_pipeline_cache->update();
+		}
+
+		if (const auto p_memory_allocator = m_logical_device->get_memory_allocator().lock())
+		{
+			p_memory_allocator->update(m_frame_number);
+		}
+
+		// Uploads made since the last frame go out together, on the frame thread in case the queue is shared.
+		m_upload_service->flush();
+		m_upload_service->update();
+	}
+
+	std::optional<graphics_frame> graphics_context::begin_frame()
+	{
+		cc_profile_zone("graphics_context::begin_frame");
+
+		const u32 frame_index               = static_cast<u32>(m_frame_number % m_frames.size());
+		frame_resources& frame              = m_frames[frame_index];
+		const VkDevice device               = *m_logical_device;
+		const vk::device_dispatch& dispatch = m_logical_device->get_dispatch();
+
+		vk::vk_ensure(dispatch.vkWaitForFences(device, 1, &frame.in_flight, VK_TRUE, std::numeric_limits<u64>::max()), "Failed to wait for frame fence!");
+
+		// The fence above was the last one submitted with this slot, so every frame up to that one is done.
+		if (m_swapchain != nullptr && m_frame_number >= m_frames.size())
+		{
+			m_swapchain->release_retired(m_frame_number - m_frames.size());
+		}
+
+		graphics_frame result = {
+		        .command_buffer = frame.command_buffer,
+		        .frame_index    = frame_index,
+		        .frame_number   = m_frame_number,
+		};
+
+		if (m_swapchain != nullptr)
+		{
+			const std::optional<u32> image_index = m_swapchain->acquire_next_image(frame.image_available, m_frame_number);
+
+			// The fence is left signaled, so the next attempt does not wait on it.
+			if (!image_index.has_value())
+			{
+				return std::nullopt;
+			}
+
+			result.image_index = *image_index;
+			result.image       = m_swapchain->get_images()[result.image_index];
+			result.image_view  = m_swapchain->get_image_views()[result.image_index];
+			result.format      = m_swapchain->get_format();
+			result.extent      = m_swapchain->get_extent();
+		}
+		else
+		{
+			result.image_index = m_offscreen_target->acquire_next_image();
+			result.image       = m_offscreen_target->get_images()[result.image_index];
+			result.image_view  = m_offscreen_target->get_image_views()[result.image_index];
+			result.format      = m_offscreen_target->get_format();
+			result.extent      = m_offscreen_target->get_extent();
+		}
+
+		vk::vk_ensure(dispatch.vkResetFences(device, 1, &frame.in_flight), "Failed to reset frame fence!");
+		vk::vk_ensure(dispatch.vkResetCommandPool(device, frame.command_pool, 0), "Failed to reset frame command pool!");
+
+		VkCommandBufferBeginInfo begin_info = {};
+		begin_info.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vk::vk_ensure(dispatch.vkBeginCommandBuffer(frame.command_buffer, &begin_info), "Failed to begin frame command buffer!");
+
+		// The fence above finished the queries of the slot's previous frame as well. The frame zone has to be the first one.
+		if (m_gpu_profiler != nullptr)
+		{
+			static constexpr profile_zone_site frame_site = { "frame", __FILE__, __LINE__ };
+
+			m_gpu_profiler->begin_frame(frame.command_buffer, frame_index);
+			m_frame_zone = m_gpu_profiler->begin_zone(frame.command_buffer, frame_site);
+		}
+
+		// The fence above also freed the slot's bindless set for the writes made since the slot was last used.
+		if (m_bindless_heap != nullptr)
+		{
+			m_bindless_heap->begin_frame(frame_index, m_frame_number);
+		}
+
+		// Finished uploads need no wait, only their ownership moved over to the graphics queue.
+		m_upload_service->acquire(frame.command_buffer, m_upload_service->get_completed_token());
+
+		VkImageSubresourceRange const subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+		// The previous contents are not needed, the whole image is cleared.
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask        = 0;
+		barrier.dstAccessMask        = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout            = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image                = result.image;
+		barrier.subresourceRange     = subresource_range;
+
+		// Chained to the acquire semaphore, which the submission waits on at the transfer stage.
+		dispatch.vkCmdPipelineBarrier(frame.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		dispatch.vkCmdClearColorImage(frame.command_buffer, result.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &m_create_info.clear_color, 1, &subresource_range);
+
+		return result;
+	}
+
+	void graphics_context::end_frame(const graphics_frame& frame)
+	{
+		cc_profile_zone("graphics_context::end_frame");
+
+		const frame_resources& resources = m_frames[frame.frame_index];
+
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask        = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask        = 0;
+		barrier.oldLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout            = m_swapchain != nullptr ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image                = frame.image;
+		barrier.subresourceRange     = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+		m_logical_device->get_dispatch().vkCmdPipelineBarrier(frame.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		if (m_gpu_profiler != nullptr)
+		{
+			m_gpu_profiler->end_zone(frame.command_buffer, m_frame_zone);
+			m_gpu_profiler->end_frame();
+			m_frame_zone = vk::invalid_gpu_zone;
+		}
+
+		vk::vk_ensure(m_logical_device->get_dispatch().vkEndCommandBuffer(frame.command_buffer), "Failed to end frame command buffer!");
+
+		VkSemaphore const render_finished = m_swapchain != nullptr ? m_swapchain->get_render_finished_semaphore(frame.image_index) : VK_NULL_HANDLE;
+
+		// Binary semaphores ignore their value, it is only there to line up with the timeline one.
+		std::array<VkSemaphore, 3> wait_semaphores      = {};
+		std::array<VkPipelineStageFlags, 3> wait_stages = {};
+		std::array<u64, 3> wait_values                  = {};
+		u32 wait_count                                  = 0;
+
+		if (m_swapchain != nullptr)
+		{
+			wait_semaphores[wait_count] = resources.image_available;
+			wait_stages[wait_count]     = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			wait_count++;
+		}
+
+		if (m_upload_wait != 0 && !m_upload_service->is_complete(m_upload_wait))
+		{
+			if (m_upload_service->has_timeline_semaphore())
+			{
+				wait_semaphores[wait_count] = m_upload_service->get_timeline_semaphore();
+				wait_stages[wait_count]     = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+				wait_values[wait_count]     = m_upload_wait;
+				wait_count++;
+			}
+			else
+			{
+				m_upload_service->wait(m_upload_wait);
+			}
+		}
+
+		m_upload_wait = 0;
+
+		if (m_semaphore_wait != VK_NULL_HANDLE)
+		{
+			wait_semaphores[wait_count] = m_semaphore_wait;
+			wait_stages[wait_count]     = m_semaphore_wait_stages;
+			wait_count++;
+
+			m_semaphore_wait        = VK_NULL_HANDLE;
+			m_semaphore_wait_stages = 0;
+		}
+
+		VkTimelineSemaphoreSubmitInfoKHR timeline_submit_info = {};
+		timeline_submit_info.sType                            = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timeline_submit_info.waitSemaphoreValueCount          = wait_count;
+		timeline_submit_info.pWaitSemaphoreValues             = wait_values.data();
+
+		VkSubmitInfo submit_info       = {};
+		submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.pNext              = m_upload_service->has_timeline_semaphore() ? &timeline_submit_info : nullptr;
+		submit_info.waitSemaphoreCount = wait_count;
+		submit_info.pWaitSemaphores    = wait_semaphores.data();
+		submit_info.pWaitDstStageMask  = wait_stages.data();
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers    = &frame.command_buffer;
+
+		if (m_swapchain != nullptr)
+		{
+			submit_info.signalSemaphoreCount = 1;
+			submit_info.pSignalSemaphores    = &render_finished;
+		}
+
+		vk::vk_ensure(m_logical_device->get_dispatch().vkQueueSubmit(m_logical_device->get_graphics_queue().first, 1, &submit_info, resources.in_flight), "Failed to submit frame!");
+
+		if (m_swapchain != nullptr)
+		{
+			m_swapchain->present(m_logical_device->get_present_queue().first, frame.image_index);
+		}
+
+		++m_frame_number;
+	}
+
+	void graphics_context::wait_for_upload(const graphics_frame& frame, vk::upload_token token)
+	{
+		// The batch has to be on its way before a submission can wait for it.
+		m_upload_service->flush();
+		m_upload_service->acquire(frame.command_buffer, token);
+
+		m_upload_wait = std::max(m_upload_wait, token);
+	}
+
+	void graphics_context::wait_for_semaphore(cc_unused const graphics_frame& frame, VkSemaphore semaphore, VkPipelineStageFlags stages)
+	{
+		ensure(m_semaphore_wait == VK_NULL_HANDLE || m_semaphore_wait == semaphore, "The frame already waits for another semaphore!");
+
+		m_semaphore_wait = semaphore;
+		m_semaphore_wait_stages |= stages;
+	}
+
+	void graphics_context::resize(u32 width, u32 height)
+	{
+		if (m_swapchain != nullptr)
+		{
+			m_swapchain->request_recreate({ width, height });
+		}
+	}
+
+	graphics_context::~graphics_context()
+	{
+		// The startup thread uses the members below, let it finish first.
+		if (m_startup.valid())
+		{
+			m_startup.wait();
+		}
+
+		if (m_logical_device != nullptr)
+		{
+			m_logical_device->get_dispatch().vkDeviceWaitIdle(*m_logical_device);
+			destroy_frame_resources();
+		}
+
+		// Everything below depends on the instance, so tear down in reverse order of creation.
+		m_gpu_profiler.reset();
+		m_bindless_heap.reset();
+		m_upload_service.reset();
+		m_swapchain.reset();
+		m_offscreen_target.reset();
+		m_logical_device.reset();
+
+		if (m_surface != nullptr && m_instance != nullptr)
+		{
+			m_instance->get_dispatch().vkDestroySurfaceKHR(m_instance->operator VkInstance(), *m_surface, m_instance->get_allocation_callbacks());
+			m_surface.reset();
+		}
+
+		m_instance.reset();
+
+		if (m_host_allocator != nullptr)
+		{
+			m_host_allocator->log_statistics();
+		}
 	}
 
 	std::shared_ptr<graphics_context> graphics_context::create(const graphics_context_create_info& create_info)
@@ -56,4 +438,166 @@ namespace cc
 	{
 		return m_instance;
 	}
+
+	std::weak_ptr<VkSurfaceKHR> graphics_context::get_surface() const
+	{
+		return m_surface;
+	}
+
+	std::weak_ptr<vk::logical_device> graphics_context::get_logical_device() const
+	{
+		return m_logical_device;
+	}
+
+	std::weak_ptr<vk::offscreen_target> graphics_context::get_offscreen_target() const
+	{
+		return m_offscreen_target;
+	}
+
+	std::weak_ptr<vk::swapchain> graphics_context::get_swapchain() const
+	{
+		return m_swapchain;
+	}
+
+	std::weak_ptr<vk::upload_service> graphics_context::get_upload_service() const
+	{
+		return m_upload_service;
+	}
+
+	std::weak_ptr<vk::bindless_heap> graphics_context::get_bindless_heap() const
+	{
+		return m_bindless_heap;
+	}
+
+	std::weak_ptr<vk::gpu_profiler> graphics_context::get_gpu_profiler() const
+	{
+		return m_gpu_profiler;
+	}
+
+	const vk::host_allocator* graphics_context::get_host_allocator() const noexcept
+	{
+		return m_host_allocator.get();
+	}
+
+	b8 graphics_context::is_headless() const noexcept
+	{
+		return m_headless;
+	}
+
+	const graphics_context_timing& graphics_context::get_timing() const noexcept
+	{
+		return m_timing;
+	}
+
+	void graphics_context::create_instance()
+	{
+		using clock = std::chrono::steady_clock;
+
+		const clock::time_point instance_start = clock::now();
+
+		vk::instance_configurator instance_configurator;
+
+		instance_configurator
+		        .set_application_name("Sample application")
+		        .set_engine_name("Capricorn")
+		        .set_application_version(1, 0, 0)
+		        .set_engine_version(1, 0, 0)
+		        .set_api_version(1, 3, 0)
+		        .set_headless(m_headless);
+
+		const vk::validation_profile validation = vk::resolve_validation_profile(m_create_info.validation);
+		vk::apply_validation_profile(instance_configurator, validation);
+
+		if (!m_headless)
+		{
+			instance_configurator.add_enabled_extension(VK_KHR_SURFACE_EXTENSION_NAME);
+		}
+
+		vk::instance_create_info instance_create_info = instance_configurator.get_create_info();
+		instance_create_info.p_capability_cache       = m_capability_cache.get();
+		instance_create_info.p_allocator              = m_host_allocator != nullptr ? m_host_allocator->get_callbacks() : nullptr;
+
+		m_instance = std::make_unique<vk::instance>(instance_create_info);
+
+		log::info(log_source::renderer, "Validation profile: {}.", vk::get_validation_profile_name(validation));
+
+		const clock::time_point discovery_start = clock::now();
+		m_timing.instance_seconds               = std::chrono::duration<f64>(discovery_start - instance_start).count();
+
+		m_candidates = vk::discover_physical_devices(*m_instance, m_capability_cache.get());
+
+		m_timing.device_discovery_seconds = std::chrono::duration<f64>(clock::now() - discovery_start).count();
+	}
+
+	void graphics_context::create_frame_resources()
+	{
+		ensure(m_create_info.frames_in_flight > 0, "At least one frame has to be in flight!");
+
+		const VkDevice device                               = *m_logical_device;
+		const vk::device_dispatch& dispatch                 = m_logical_device->get_dispatch();
+		const VkAllocationCallbacks* p_allocation_callbacks = m_logical_device->get_allocation_callbacks();
+
+		m_frames.resize(m_create_info.frames_in_flight);
+
+		for (frame_resources& frame: m_frames)
+		{
+			// Created signaled so the first begin_frame() for every slot does not wait forever.
+			VkFenceCreateInfo fence_create_info = {};
+			fence_create_info.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			fence_create_info.flags             = VK_FENCE_CREATE_SIGNALED_BIT;
+
+			vk::vk_ensure(dispatch.vkCreateFence(device, &fence_create_info, p_allocation_callbacks, &frame.in_flight), "Failed to create frame fence!");
+
+			VkSemaphoreCreateInfo semaphore_create_info = {};
+			semaphore_create_info.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+			vk::vk_ensure(dispatch.vkCreateSemaphore(device, &semaphore_create_info, p_allocation_callbacks, &frame.image_available), "Failed to create frame semaphore!");
+
+			VkCommandPoolCreateInfo command_pool_create_info = {};
+			command_pool_create_info.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			command_pool_create_info.flags                   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			command_pool_create_info.queueFamilyIndex        = m_logical_device->get_graphics_queue().second;
+
+			vk::vk_ensure(dispatch.vkCreateCommandPool(device, &command_pool_create_info, p_allocation_callbacks, &frame.command_pool), "Failed to create frame command pool!");
+
+			VkCommandBufferAllocateInfo allocate_info = {};
+			allocate_info.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocate_info.commandPool                 = frame.command_pool;
+			allocate_info.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocate_info.commandBufferCount          = 1;
+
+			vk::vk_ensure(dispatch.vkAllocateCommandBuffers(device, &allocate_info, &frame.command_buffer), "Failed to allocate frame command buffer!");
+		}
+	}
+
+	void graphics_context::destroy_frame_resources()
+	{
+		const VkDevice device                               = *m_logical_device;
+		const vk::device_dispatch& dispatch                 = m_logical_device->get_dispatch();
+		const VkAllocationCallbacks* p_allocation_callbacks = m_logical_device->get_allocation_callbacks();
+
+		for (const frame_resources& frame: m_frames)
+		{
+			dispatch.vkDestroyCommandPool(device, frame.command_pool, p_allocation_callbacks);
+			dispatch.vkDestroySemaphore(device, frame.image_available, p_allocation_callbacks);
+			dispatch.vkDestroyFence(device, frame.in_flight, p_allocation_callbacks);
+		}
+
+		m_frames.clear();
+	}
+
+	void graphics_context::create_headless_surface()
+	{
+		const VkInstance instance              = m_instance->operator VkInstance();
+		const auto create_headless_surface_ext = m_instance->get_dispatch().vkCreateHeadlessSurfaceEXT;
+		ensure(create_headless_surface_ext != nullptr, "VK_EXT_headless_surface is enabled but vkCreateHeadlessSurfaceEXT is missing!");
+
+		VkHeadlessSurfaceCreateInfoEXT surface_create_info = {};
+		surface_create_info.sType                          = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+
+		VkSurfaceKHR surface = VK_NULL_HANDLE;
+		vk::vk_ensure(create_headless_surface_ext(instance, &surface_create_info, m_instance->get_allocation_callbacks(), &surface), "Failed to create headless surface!");
+
+		m_surface = std::make_shared<VkSurfaceKHR>(surface);
+	}
 } // namespace cc
\ No newline at end of file
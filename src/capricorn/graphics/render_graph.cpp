@@ -0,0 +1,959 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/render_graph.hpp"
+
+#include "capricorn/memory/scratch_arena.hpp"
+
+namespace cc
+{
+	namespace details
+	{
+		struct usage_info
+		{
+			VkPipelineStageFlags stages = 0;
+			VkAccessFlags access        = 0;
+			VkImageLayout layout        = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkImageUsageFlags usage     = 0;
+			b8 write                    = false;
+		};
+
+		// Shader accesses happen at different stages depending on the kind of pass, not on the queue it ends up on.
+		usage_info get_usage_info(resource_usage usage, render_queue queue)
+		{
+			const VkPipelineStageFlags shader_stages = queue == render_queue::compute ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			const VkPipelineStageFlags depth_stages  = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+			switch (usage)
+			{
+				case resource_usage::color_attachment:
+					return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true };
+				case resource_usage::depth_attachment:
+					return { depth_stages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true };
+				case resource_usage::depth_read:
+					return { depth_stages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, false };
+				case resource_usage::sampled:
+					return { shader_stages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, false };
+				case resource_usage::storage_read:
+					return { shader_stages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, false };
+				case resource_usage::storage_write:
+					return { shader_stages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true };
+				case resource_usage::transfer_src:
+					return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false };
+				case resource_usage::transfer_dst:
+					return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, true };
+			}
+
+			return {};
+		}
+
+		b8 is_attachment_usage(resource_usage usage)
+		{
+			return usage == resource_usage::color_attachment || usage == resource_usage::depth_attachment || usage == resource_usage::depth_read;
+		}
+
+		VkImageAspectFlags get_aspect(VkFormat format)
+		{
+			switch (format)
+			{
+				case VK_FORMAT_D16_UNORM:
+				case VK_FORMAT_X8_D24_UNORM_PACK32:
+				case VK_FORMAT_D32_SFLOAT:
+					return VK_IMAGE_ASPECT_DEPTH_BIT;
+				case VK_FORMAT_S8_UINT:
+					return VK_IMAGE_ASPECT_STENCIL_BIT;
+				case VK_FORMAT_D16_UNORM_S8_UINT:
+				case VK_FORMAT_D24_UNORM_S8_UINT:
+				case VK_FORMAT_D32_SFLOAT_S8_UINT:
+					return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+				default:
+					return VK_IMAGE_ASPECT_COLOR_BIT;
+			}
+		}
+
+		VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		f64 to_mebibytes(u64 bytes)
+		{
+			return static_cast<f64>(bytes) / (1024.0 * 1024.0);
+		}
+	} // namespace details
+
+	render_pass_builder::render_pass_builder(render_graph& graph, u32 pass)
+	    : m_graph(graph),
+	      m_pass(pass)
+	{
+	}
+
+	render_resource render_pass_builder::create_image(const render_image_desc& desc)
+	{
+		render_graph::resource_node& resource = m_graph.m_resources.emplace_back();
+		resource.desc                         = desc;
+
+		if (resource.desc.extent.width == 0 || resource.desc.extent.height == 0)
+		{
+			resource.desc.extent = m_graph.m_frame.extent;
+		}
+
+		return static_cast<render_resource>(m_graph.m_resources.size() - 1);
+	}
+
+	void render_pass_builder::read(render_resource resource, resource_usage usage)
+	{
+		m_graph.add_access(m_pass, resource, usage, false);
+	}
+
+	void render_pass_builder::write(render_resource resource, resource_usage usage)
+	{
+		m_graph.add_access(m_pass, resource, usage, true);
+	}
+
+	void render_pass_builder::set_side_effect()
+	{
+		m_graph.m_passes[m_pass].side_effect = true;
+	}
+
+	render_pass_context::render_pass_context(const render_graph& graph, VkCommandBuffer command_buffer, b8 async)
+	    : m_graph(graph),
+	      m_command_buffer(command_buffer),
+	      m_async(async)
+	{
+	}
+
+	VkCommandBuffer render_pass_context::get_command_buffer() const noexcept
+	{
+		return m_command_buffer;
+	}
+
+	VkImage render_pass_context::get_image(render_resource resource) const
+	{
+		return m_graph.get_resource(resource).image;
+	}
+
+	VkImageView render_pass_context::get_image_view(render_resource resource) const
+	{
+		return m_graph.get_resource(resource).image_view;
+	}
+
+	VkExtent2D render_pass_context::get_extent(render_resource resource) const
+	{
+		return m_graph.get_resource(resource).desc.extent;
+	}
+
+	b8 render_pass_context::is_async() const noexcept
+	{
+		return m_async;
+	}
+
+	b8 render_graph::transient_key::operator==(const transient_key& other) const noexcept
+	{
+		return format == other.format && extent.width == other.extent.width && extent.height == other.extent.height && mip_levels == other.mip_levels && samples == other.samples &&
+		       usage_flags == other.usage_flags && async == other.async && first == other.first && last == other.last;
+	}
+
+	render_graph::render_graph(const render_graph_create_info& create_info) // NOLINT(modernize-pass-by-value)
+	    : m_create_info(create_info),
+	      m_context(create_info.p_context.lock())
+	{
+		ensure(m_context != nullptr, "Render graph requires a graphics context!");
+
+		m_device           = m_context->get_logical_device().lock();
+		m_memory_allocator = m_device->get_memory_allocator().lock();
+		m_gpu_profiler     = m_context->get_gpu_profiler().lock();
+		m_async_compute    = m_create_info.async_compute && m_device->has_async_compute_queue();
+
+		m_slots = std::vector<frame_slot>(m_device->get_create_info().frames_in_flight);
+
+		if (!m_async_compute)
+		{
+			return;
+		}
+
+		VkCommandPoolCreateInfo pool_create_info = {};
+		pool_create_info.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		pool_create_info.flags                   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		pool_create_info.queueFamilyIndex        = m_device->get_compute_queue().second;
+
+		VkSemaphoreCreateInfo semaphore_create_info = {};
+		semaphore_create_info.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		const vk::device_dispatch& dispatch                 = m_device->get_dispatch();
+		const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+
+		for (frame_slot& slot: m_slots)
+		{
+			vk::vk_ensure(dispatch.vkCreateCommandPool(*m_device, &pool_create_info, p_allocation_callbacks, &slot.compute_pool), "Failed to create async compute command pool!");
+			vk::vk_ensure(dispatch.vkCreateSemaphore(*m_device, &semaphore_create_info, p_allocation_callbacks, &slot.compute_finished), "Failed to create async compute semaphore!");
+
+			VkCommandBufferAllocateInfo allocate_info = {};
+			allocate_info.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocate_info.commandPool                 = slot.compute_pool;
+			allocate_info.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocate_info.commandBufferCount          = 1;
+
+			vk::vk_ensure(dispatch.vkAllocateCommandBuffers(*m_device, &allocate_info, &slot.compute_commands), "Failed to allocate async compute command buffer!");
+		}
+	}
+
+	render_graph::~render_graph()
+	{
+		if (m_device == nullptr)
+		{
+			return;
+		}
+
+		const vk::device_dispatch& dispatch                 = m_device->get_dispatch();
+		const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+
+		// Frames in flight may still use the transient images and the compute command buffers.
+		dispatch.vkDeviceWaitIdle(*m_device);
+
+		for (frame_slot& slot: m_slots)
+		{
+			destroy_transient_images(slot);
+
+			if (slot.compute_pool != VK_NULL_HANDLE)
+			{
+				dispatch.vkDestroyCommandPool(*m_device, slot.compute_pool, p_allocation_callbacks);
+				dispatch.vkDestroySemaphore(*m_device, slot.compute_finished, p_allocation_callbacks);
+			}
+		}
+	}
+
+	std::shared_ptr<render_graph> render_graph::create(const render_graph_create_info& create_info)
+	{
+		return std::make_shared<render_graph>(create_info);
+	}
+
+	void render_graph::begin(const graphics_frame& frame)
+	{
+		ensure(!m_recording, "The previous frame's graph was never executed!");
+
+		m_frame     = frame;
+		m_recording = true;
+
+		m_resources.clear();
+		m_passes.clear();
+		m_transients.clear();
+
+		m_backbuffer = import_image(frame.image, frame.image_view, frame.format, frame.extent, resource_usage::transfer_dst, resource_usage::transfer_dst);
+	}
+
+	render_resource render_graph::import_image(VkImage image, VkImageView image_view, VkFormat format, VkExtent2D extent, resource_usage initial_usage, resource_usage final_usage)
+	{
+		ensure(m_recording, "Images can only be imported between begin() and execute()!");
+
+		resource_node& resource = m_resources.emplace_back();
+		resource.desc.format    = format;
+		resource.desc.extent    = extent;
+		resource.image          = image;
+		resource.image_view     = image_view;
+		resource.initial_usage  = initial_usage;
+		resource.final_usage    = final_usage;
+		resource.imported       = true;
+
+		return static_cast<render_resource>(m_resources.size() - 1);
+	}
+
+	void render_graph::add_pass(const char* p_name, render_queue queue, const setup_function& setup, execute_function execute)
+	{
+		ensure(m_recording, "Passes can only be added between begin() and execute()!");
+
+		const auto index = static_cast<u32>(m_passes.size());
+
+		pass_node& pass = m_passes.emplace_back();
+		pass.p_name     = p_name;
+		pass.queue      = queue;
+		pass.execute    = std::move(execute);
+
+		render_pass_builder builder(*this, index);
+		setup(builder);
+	}
+
+	void render_graph::execute()
+	{
+		cc_profile_zone("render_graph::execute");
+
+		ensure(m_recording, "Render graph was not begun!");
+
+		m_recording = false;
+
+		cull_passes();
+		assign_queues();
+		compute_lifetimes();
+		place_transient_images();
+
+		frame_slot& slot = m_slots[m_frame.frame_index];
+
+		m_current.passes         = static_cast<u32>(m_passes.size());
+		m_current.culled_passes  = 0;
+		m_current.async_passes   = 0;
+		m_current.barriers       = 0;
+		m_current.image_barriers = 0;
+		m_wait_stages            = 0;
+
+		for (const pass_node& pass: m_passes)
+		{
+			m_current.culled_passes += pass.culled ? 1 : 0;
+			m_current.async_passes += pass.async ? 1 : 0;
+		}
+
+		for (resource_node& resource: m_resources)
+		{
+			resource.state       = {};
+			resource.async_state = {};
+
+			if (resource.imported)
+			{
+				const details::usage_info info = details::get_usage_info(resource.initial_usage, render_queue::graphics);
+
+				// Treated as written by whatever left the image in its initial state.
+				resource.state = {
+				        .layout         = info.layout,
+				        .stages         = info.stages,
+				        .access         = info.access,
+				        .readers        = 0,
+				        .visible        = 0,
+				        .visible_access = 0,
+				        .initialized    = true,
+				};
+			}
+		}
+
+		barrier_batch batch;
+
+		if (m_current.async_passes != 0)
+		{
+			vk::vk_ensure(m_device->get_dispatch().vkResetCommandPool(*m_device, slot.compute_pool, 0), "Failed to reset async compute command pool!");
+
+			VkCommandBufferBeginInfo begin_info = {};
+			begin_info.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+			vk::vk_ensure(m_device->get_dispatch().vkBeginCommandBuffer(slot.compute_commands, &begin_info), "Failed to begin async compute command buffer!");
+
+			for (const pass_node& pass: m_passes)
+			{
+				if (!pass.culled && pass.async)
+				{
+					record(slot.compute_commands, pass, batch, true);
+				}
+			}
+
+			// Releases what the graphics queue uses afterwards, acquired again by its first pass there.
+			for (resource_node& resource: m_resources)
+			{
+				if (!resource.async || !resource.graphics)
+				{
+					continue;
+				}
+
+				const image_state& state = resource.async_state;
+
+				VkImageMemoryBarrier barrier = {};
+				barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.srcAccessMask        = state.access;
+				barrier.dstAccessMask        = 0;
+				barrier.oldLayout            = state.layout;
+				barrier.newLayout            = details::get_usage_info(resource.handoff_usage, render_queue::graphics).layout;
+				barrier.srcQueueFamilyIndex  = m_device->get_compute_queue().second;
+				barrier.dstQueueFamilyIndex  = m_device->get_graphics_queue().second;
+				barrier.image                = resource.image;
+				barrier.subresourceRange     = { details::get_aspect(resource.desc.format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+
+				batch.source |= state.stages | state.readers;
+				batch.destination |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+				batch.image_barriers.push_back(barrier);
+			}
+
+			flush(slot.compute_commands, batch);
+
+			vk::vk_ensure(m_device->get_dispatch().vkEndCommandBuffer(slot.compute_commands), "Failed to end async compute command buffer!");
+		}
+
+		for (const pass_node& pass: m_passes)
+		{
+			if (!pass.culled && !pass.async)
+			{
+				record(m_frame.command_buffer, pass, batch, false);
+			}
+		}
+
+		// Untouched imports are still in their initial state, which is all the final one may differ from.
+		for (resource_node& resource: m_resources)
+		{
+			if (resource.imported && resource.used)
+			{
+				transition(batch, resource, resource.state, resource.final_usage, render_queue::graphics, false);
+			}
+		}
+
+		flush(m_frame.command_buffer, batch);
+
+		if (m_current.async_passes != 0)
+		{
+			VkSubmitInfo submit_info         = {};
+			submit_info.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submit_info.commandBufferCount   = 1;
+			submit_info.pCommandBuffers      = &slot.compute_commands;
+			submit_info.signalSemaphoreCount = 1;
+			submit_info.pSignalSemaphores    = &slot.compute_finished;
+
+			// No fence, the frame's submission waits for the semaphore and its fence covers both.
+			vk::vk_ensure(m_device->get_dispatch().vkQueueSubmit(m_device->get_compute_queue().first, 1, &submit_info, VK_NULL_HANDLE), "Failed to submit async compute!");
+
+			// Nothing on the graphics queue may need the results, the semaphore still has to be waited on before it is signaled again.
+			m_context->wait_for_semaphore(m_frame, slot.compute_finished, m_wait_stages != 0 ? m_wait_stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		}
+
+		std::lock_guard const lock(m_statistics_mutex);
+		m_statistics = m_current;
+	}
+
+	b8 render_graph::is_recording() const noexcept
+	{
+		return m_recording;
+	}
+
+	render_resource render_graph::get_backbuffer() const noexcept
+	{
+		return m_backbuffer;
+	}
+
+	render_graph_statistics render_graph::get_statistics() const
+	{
+		std::lock_guard const lock(m_statistics_mutex);
+		return m_statistics;
+	}
+
+	void render_graph::cull_passes()
+	{
+		scratch_arena const scratch;
+		std::pmr::vector<b8> needed(m_resources.size(), false, scratch.get_resource());
+
+		// Backwards, so every pass is decided after everything that could depend on it. Writes count as accesses,
+		// the graph cannot tell whether a pass loads what an earlier one wrote.
+		for (auto index = static_cast<u32>(m_passes.size()); index-- > 0;)
+		{
+			pass_node& pass = m_passes[index];
+
+			b8 kept = pass.side_effect;
+
+			for (const resource_access& access: pass.accesses)
+			{
+				kept = kept || (access.write && (m_resources[access.resource].imported || needed[access.resource]));
+			}
+
+			pass.culled = !kept;
+
+			if (kept)
+			{
+				for (const resource_access& access: pass.accesses)
+				{
+					needed[access.resource] = true;
+				}
+			}
+		}
+	}
+
+	void render_graph::assign_queues()
+	{
+		for (pass_node& pass: m_passes)
+		{
+			if (pass.culled)
+			{
+				continue;
+			}
+
+			// Waiting for the graphics queue from the async one would need the frame's submission to be split, so only chains of async passes qualify.
+			b8 async = m_async_compute && pass.queue == render_queue::compute;
+
+			for (const resource_access& access: pass.accesses)
+			{
+				const resource_node& resource = m_resources[access.resource];
+				async                         = async && !resource.imported && !resource.graphics;
+			}
+
+			pass.async = async;
+
+			for (const resource_access& access: pass.accesses)
+			{
+				resource_node& resource = m_resources[access.resource];
+				resource.used           = true;
+
+				if (async)
+				{
+					resource.async = true;
+				}
+				else
+				{
+					if (resource.async && !resource.graphics)
+					{
+						resource.handoff_usage = access.usage;
+					}
+
+					resource.graphics = true;
+				}
+			}
+		}
+	}
+
+	void render_graph::compute_lifetimes()
+	{
+		for (resource_node& resource: m_resources)
+		{
+			resource.first = std::numeric_limits<u32>::max();
+			resource.last  = 0;
+		}
+
+		u32 position = 0;
+
+		for (const pass_node& pass: m_passes)
+		{
+			if (pass.culled || pass.async)
+			{
+				continue;
+			}
+
+			for (const resource_access& access: pass.accesses)
+			{
+				resource_node& resource = m_resources[access.resource];
+				resource.first          = std::min(resource.first, position);
+				resource.last           = std::max(resource.last, position);
+			}
+
+			position++;
+		}
+
+		// Async passes may run any time before the graphics pass waiting for them, so their images live from the start of the frame.
+		for (resource_node& resource: m_resources)
+		{
+			if (resource.async)
+			{
+				resource.first = 0;
+				resource.last  = resource.graphics ? resource.last : position;
+			}
+		}
+	}
+
+	void render_graph::place_transient_images()
+	{
+		frame_slot& slot = m_slots[m_frame.frame_index];
+
+		std::vector<transient_key> keys;
+
+		for (u32 index = 0; index < m_resources.size(); index++)
+		{
+			resource_node& resource = m_resources[index];
+
+			if (resource.imported || !resource.used)
+			{
+				continue;
+			}
+
+			resource.physical = static_cast<u32>(m_transients.size());
+			m_transients.push_back(index);
+
+			keys.push_back({
+			        .format      = resource.desc.format,
+			        .extent      = resource.desc.extent,
+			        .mip_levels  = resource.desc.mip_levels,
+			        .samples     = resource.desc.samples,
+			        .usage_flags = resource.usage_flags,
+			        .async       = resource.async,
+			        .first       = resource.first,
+			        .last        = resource.last,
+			});
+		}
+
+		m_current.transient_images = static_cast<u32>(keys.size());
+
+		if (keys == slot.keys)
+		{
+			for (const render_resource index: m_transients)
+			{
+				resource_node& resource = m_resources[index];
+				resource.image          = slot.images[resource.physical].image;
+				resource.image_view     = slot.images[resource.physical].image_view;
+			}
+
+			return;
+		}
+
+		// begin_frame() waited for the last frame that used this slot, nothing references its images any more.
+		destroy_transient_images(slot);
+
+		slot.keys = std::move(keys);
+		slot.images.resize(slot.keys.size());
+
+		scratch_arena const scratch;
+		std::pmr::vector<VkMemoryRequirements> requirements(slot.keys.size(), scratch.get_resource());
+
+		for (u32 index = 0; index < slot.keys.size(); index++)
+		{
+			const transient_key& key = slot.keys[index];
+
+			VkImageCreateInfo image_create_info = {};
+			image_create_info.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			image_create_info.imageType         = VK_IMAGE_TYPE_2D;
+			image_create_info.format            = key.format;
+			image_create_info.extent            = { key.extent.width, key.extent.height, 1 };
+			image_create_info.mipLevels         = key.mip_levels;
+			image_create_info.arrayLayers       = 1;
+			image_create_info.samples           = key.samples;
+			image_create_info.tiling            = VK_IMAGE_TILING_OPTIMAL;
+			image_create_info.usage             = key.usage_flags;
+			image_create_info.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+			image_create_info.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			vk::vk_ensure(m_device->get_dispatch().vkCreateImage(*m_device, &image_create_info, m_device->get_allocation_callbacks(), &slot.images[index].image), "Failed to create transient image!");
+			m_device->get_dispatch().vkGetImageMemoryRequirements(*m_device, slot.images[index].image, &requirements[index]);
+
+			slot.images[index].size = requirements[index].size;
+		}
+
+		// Largest first, which leaves the smaller images to fill the gaps between them.
+		std::pmr::vector<u32> order(slot.keys.size(), scratch.get_resource());
+		std::iota(order.begin(), order.end(), 0U);
+		std::sort(order.begin(), order.end(), [&requirements](u32 left, u32 right) {
+			return requirements[left].size > requirements[right].size;
+		});
+
+		// One allocation per set of memory types, images may only share memory all of them can be bound to.
+		struct heap
+		{
+			VkMemoryRequirements requirements = {};
+			std::vector<u32> images;
+		};
+
+		std::vector<heap> heaps;
+
+		for (const u32 index: order)
+		{
+			const VkMemoryRequirements& image_requirements = requirements[index];
+			const transient_key& key                       = slot.keys[index];
+
+			auto found = std::find_if(heaps.begin(), heaps.end(), [&image_requirements](const heap& candidate) {
+				return candidate.requirements.memoryTypeBits == image_requirements.memoryTypeBits;
+			});
+
+			if (found == heaps.end())
+			{
+				found                              = heaps.emplace(heaps.end());
+				found->requirements.memoryTypeBits = image_requirements.memoryTypeBits;
+				found->requirements.alignment      = 1;
+			}
+
+			// The images this one may not overlap, in the order of their offsets.
+			std::pmr::vector<u32> occupied(scratch.get_resource());
+
+			for (const u32 other: found->images)
+			{
+				const transient_key& other_key = slot.keys[other];
+
+				if (!m_create_info.aliasing || (key.first <= other_key.last && other_key.first <= key.last))
+				{
+					occupied.push_back(other);
+				}
+			}
+
+			std::sort(occupied.begin(), occupied.end(), [&slot](u32 left, u32 right) {
+				return slot.images[left].offset < slot.images[right].offset;
+			});
+
+			VkDeviceSize offset = 0;
+
+			for (const u32 other: occupied)
+			{
+				const transient_image& other_image = slot.images[other];
+
+				if (details::align_up(offset, image_requirements.alignment) + image_requirements.size <= other_image.offset)
+				{
+					break;
+				}
+
+				offset = std::max(offset, other_image.offset + other_image.size);
+			}
+
+			transient_image& image = slot.images[index];
+			image.memory           = static_cast<u32>(found - heaps.begin());
+			image.offset           = details::align_up(offset, image_requirements.alignment);
+
+			found->requirements.size      = std::max(found->requirements.size, image.offset + image.size);
+			found->requirements.alignment = std::max(found->requirements.alignment, image_requirements.alignment);
+			found->images.push_back(index);
+		}
+
+		VkDeviceSize transient_bytes = 0;
+		VkDeviceSize allocated_bytes = 0;
+
+		for (const heap& heap: heaps)
+		{
+			allocated_bytes += heap.requirements.size;
+
+			const vk::gpu_memory_create_info memory_create_info = {
+			        .requirements = heap.requirements,
+			        .memory       = vk::memory_usage::gpu_only,
+			        .category     = vk::allocation_category::render_target,
+			        .p_name       = "Render graph transients",
+			};
+
+			const std::shared_ptr<vk::gpu_memory>& memory = slot.memory.emplace_back(m_memory_allocator->allocate_memory(memory_create_info));
+
+			for (const u32 index: heap.images)
+			{
+				transient_image& image = slot.images[index];
+				transient_bytes += image.size;
+
+				m_memory_allocator->bind_image(*memory, image.image, image.offset);
+
+				// Whoever used the memory before this image has to be done with it when its first pass starts.
+				for (const u32 other: heap.images)
+				{
+					const transient_image& other_image = slot.images[other];
+
+					if (other != index && slot.keys[other].last < slot.keys[index].first && other_image.offset < image.offset + image.size && image.offset < other_image.offset + other_image.size)
+					{
+						image.predecessors.push_back(other);
+					}
+				}
+			}
+		}
+
+		for (const render_resource index: m_transients)
+		{
+			resource_node& resource = m_resources[index];
+			transient_image& image  = slot.images[resource.physical];
+
+			VkImageAspectFlags aspect = details::get_aspect(resource.desc.format);
+
+			// Views can only show one of depth and stencil, depth is the one passes sample.
+			if ((aspect & VK_IMAGE_ASPECT_DEPTH_BIT) != 0)
+			{
+				aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+			}
+
+			VkImageViewCreateInfo view_create_info = {};
+			view_create_info.sType                 = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			view_create_info.image                 = image.image;
+			view_create_info.viewType              = VK_IMAGE_VIEW_TYPE_2D;
+			view_create_info.format                = resource.desc.format;
+			view_create_info.subresourceRange      = { aspect, 0, resource.desc.mip_levels, 0, 1 };
+
+			vk::vk_ensure(m_device->get_dispatch().vkCreateImageView(*m_device, &view_create_info, m_device->get_allocation_callbacks(), &image.image_view), "Failed to create transient image view!");
+
+			resource.image      = image.image;
+			resource.image_view = image.image_view;
+		}
+
+		m_current.transient_bytes = transient_bytes;
+		m_current.allocated_bytes = allocated_bytes;
+		m_current.placements++;
+
+		log::info(log_source::renderer,
+		          "Render graph placed {} transient images ({:.2f} MiB) in {:.2f} MiB for frame slot {}.",
+		          slot.images.size(),
+		          details::to_mebibytes(transient_bytes),
+		          details::to_mebibytes(allocated_bytes),
+		          m_frame.frame_index);
+	}
+
+	void render_graph::destroy_transient_images(frame_slot& slot)
+	{
+		const vk::device_dispatch& dispatch                 = m_device->get_dispatch();
+		const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+
+		for (const transient_image& image: slot.images)
+		{
+			dispatch.vkDestroyImageView(*m_device, image.image_view, p_allocation_callbacks);
+			dispatch.vkDestroyImage(*m_device, image.image, p_allocation_callbacks);
+		}
+
+		// The images go first, memory may only be freed once nothing is bound to it.
+		slot.images.clear();
+		slot.memory.clear();
+		slot.keys.clear();
+	}
+
+	void render_graph::add_access(u32 pass, render_resource resource, resource_usage usage, b8 write)
+	{
+		ensure(resource < m_resources.size(), "Pass accesses an unknown resource!");
+
+		pass_node& node                = m_passes[pass];
+		const details::usage_info info = details::get_usage_info(usage, node.queue);
+
+		ensure(info.write == write, "Usage does not match whether the access was declared as a read or a write!");
+		ensure(node.queue == render_queue::graphics || !details::is_attachment_usage(usage), "Compute passes cannot use attachments!");
+
+		const b8 duplicate = std::any_of(node.accesses.begin(), node.accesses.end(), [resource](const resource_access& access) {
+			return access.resource == resource;
+		});
+
+		// A single layout per pass, writes include reading for the usages that can do both.
+		ensure(!duplicate, "A pass may only declare one access per image!");
+
+		node.accesses.push_back({ .resource = resource, .usage = usage, .write = write });
+		m_resources[resource].usage_flags |= info.usage;
+	}
+
+	void render_graph::transition(barrier_batch& batch, resource_node& resource, image_state& state, resource_usage usage, render_queue queue, b8 async)
+	{
+		const details::usage_info info = details::get_usage_info(usage, queue);
+
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout            = state.layout;
+		barrier.newLayout            = info.layout;
+		barrier.srcQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image                = resource.image;
+		barrier.subresourceRange     = { details::get_aspect(resource.desc.format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+
+		VkPipelineStageFlags source = 0;
+		b8 image_barrier            = false;
+
+		if (!state.initialized && !async && resource.async)
+		{
+			// Acquires what the async compute queue released, the frame's submission waits for it at these stages.
+			barrier.oldLayout           = resource.async_state.layout;
+			barrier.srcQueueFamilyIndex = m_device->get_compute_queue().second;
+			barrier.dstQueueFamilyIndex = m_device->get_graphics_queue().second;
+
+			source = info.stages;
+			m_wait_stages |= info.stages;
+			image_barrier = true;
+		}
+		else if (!state.initialized)
+		{
+			// The contents are discarded, but the memory may still be in use by the images placed there before.
+			for (const u32 predecessor: m_slots[m_frame.frame_index].images[resource.physical].predecessors)
+			{
+				const image_state& previous = m_resources[m_transients[predecessor]].state;
+
+				source |= previous.stages | previous.readers;
+				barrier.srcAccessMask |= previous.access;
+			}
+
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			source            = source != 0 ? source : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			image_barrier     = true;
+		}
+		else if (state.layout != info.layout)
+		{
+			source                = state.stages | state.readers;
+			barrier.srcAccessMask = state.access;
+			image_barrier         = true;
+		}
+		else if (info.write)
+		{
+			// The reads since the last write already waited for it, so only they have to finish.
+			source                = state.readers != 0 ? state.readers : state.stages;
+			barrier.srcAccessMask = state.readers != 0 ? 0 : state.access;
+			image_barrier         = barrier.srcAccessMask != 0;
+		}
+		else if ((state.visible & info.stages) != info.stages || (state.visible_access & info.access) != info.access)
+		{
+			source                = state.stages;
+			barrier.srcAccessMask = state.access;
+			image_barrier         = state.access != 0;
+		}
+
+		if (source != 0)
+		{
+			batch.source |= source;
+			batch.destination |= info.stages;
+		}
+
+		if (image_barrier)
+		{
+			barrier.dstAccessMask = info.access;
+			batch.image_barriers.push_back(barrier);
+		}
+
+		// Layout transitions are writes of their own, made visible to the stages of the barrier.
+		if (!state.initialized || barrier.oldLayout != barrier.newLayout)
+		{
+			state = {
+			        .layout         = info.layout,
+			        .stages         = info.stages,
+			        .access         = info.write ? info.access : 0,
+			        .readers        = info.write ? 0 : info.stages,
+			        .visible        = info.stages,
+			        .visible_access = info.access,
+			        .initialized    = true,
+			};
+		}
+		else if (info.write)
+		{
+			state.stages         = info.stages;
+			state.access         = info.access;
+			state.readers        = 0;
+			state.visible        = 0;
+			state.visible_access = 0;
+		}
+		else
+		{
+			state.readers |= info.stages;
+
+			if (source != 0)
+			{
+				state.visible |= info.stages;
+				state.visible_access |= info.access;
+			}
+		}
+	}
+
+	void render_graph::flush(VkCommandBuffer command_buffer, barrier_batch& batch)
+	{
+		if (batch.source == 0 && batch.image_barriers.empty())
+		{
+			return;
+		}
+
+		m_device->get_dispatch().vkCmdPipelineBarrier(command_buffer, batch.source, batch.destination, 0, 0, nullptr, 0, nullptr, static_cast<u32>(batch.image_barriers.size()), batch.image_barriers.data());
+
+		m_current.barriers++;
+		m_current.image_barriers += static_cast<u32>(batch.image_barriers.size());
+
+		batch.source      = 0;
+		batch.destination = 0;
+		batch.image_barriers.clear();
+	}
+
+	void render_graph::record(VkCommandBuffer command_buffer, const pass_node& pass, barrier_batch& batch, b8 async)
+	{
+		// Interned by name, so the zones of a pass add up across frames.
+		std::optional<profile_scope> cpu_zone;
+		std::optional<vk::gpu_profile_scope> gpu_zone;
+
+		if (profiler_enabled && pass.p_name != nullptr && profiler::is_active())
+		{
+			const profile_zone_site& site = profiler::intern(pass.p_name);
+
+			cpu_zone.emplace(site);
+			gpu_zone.emplace(async ? nullptr : m_gpu_profiler.get(), command_buffer, site);
+		}
+
+		for (const resource_access& access: pass.accesses)
+		{
+			resource_node& resource = m_resources[access.resource];
+			transition(batch, resource, async ? resource.async_state : resource.state, access.usage, pass.queue, async);
+		}
+
+		flush(command_buffer, batch);
+
+		if (pass.execute)
+		{
+			pass.execute(render_pass_context(*this, command_buffer, async));
+		}
+	}
+
+	const render_graph::resource_node& render_graph::get_resource(render_resource resource) const
+	{
+		ensure(resource < m_resources.size(), "Unknown render graph resource!");
+		return m_resources[resource];
+	}
+} // namespace cc
@@ -0,0 +1,505 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/texture/block_compression.hpp"
+
+namespace cc
+{
+	namespace details
+	{
+		using vec4 = std::array<f32, 4>;
+
+		constexpr u32 block_texels = 16;
+
+		constexpr std::array<u32, 16> bc7_weights = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		// Index order as the hardware decodes it: endpoint 0, endpoint 1, then the two interpolants.
+		constexpr std::array<f32, 4> bc1_weights = { 0.0F, 1.0F, 1.0F / 3.0F, 2.0F / 3.0F };
+
+		class bit_writer
+		{
+		public:
+			explicit bit_writer(u8* p_block)
+			    : m_p_block(p_block)
+			{
+			}
+
+			void write(u32 value, u32 count)
+			{
+				for (u32 bit = 0; bit < count; bit++, m_position++)
+				{
+					m_p_block[m_position / 8] |= static_cast<u8>(((value >> bit) & 1U) << (m_position % 8));
+				}
+			}
+
+		private:
+			u8* m_p_block  = nullptr;
+			u32 m_position = 0;
+		};
+
+		f32 distance(const vec4& a, const vec4& b, u32 channels)
+		{
+			f32 sum = 0.0F;
+			for (u32 channel = 0; channel < channels; channel++)
+			{
+				const f32 delta = a[channel] - b[channel];
+				sum += delta * delta;
+			}
+			return sum;
+		}
+
+		vec4 get_texel(const u8* p_texels, u32 index)
+		{
+			const u8* p_texel = p_texels + index * 4;
+			return { static_cast<f32>(p_texel[0]), static_cast<f32>(p_texel[1]), static_cast<f32>(p_texel[2]), static_cast<f32>(p_texel[3]) };
+		}
+
+		// Ends of the block's principal axis, clamped to the colour cube.
+		std::pair<vec4, vec4> find_principal_endpoints(const u8* p_texels, u32 channels)
+		{
+			vec4 mean    = {};
+			vec4 minimum = { 255.0F, 255.0F, 255.0F, 255.0F };
+			vec4 maximum = {};
+
+			for (u32 index = 0; index < block_texels; index++)
+			{
+				const vec4 texel = get_texel(p_texels, index);
+				for (u32 channel = 0; channel < channels; channel++)
+				{
+					mean[channel] += texel[channel] / static_cast<f32>(block_texels);
+					minimum[channel] = std::min(minimum[channel], texel[channel]);
+					maximum[channel] = std::max(maximum[channel], texel[channel]);
+				}
+			}
+
+			std::array<vec4, 4> covariance = {};
+
+			for (u32 index = 0; index < block_texels; index++)
+			{
+				const vec4 texel = get_texel(p_texels, index);
+				for (u32 row = 0; row < channels; row++)
+				{
+					for (u32 column = 0; column < channels; column++)
+					{
+						covariance[row][column] += (texel[row] - mean[row]) * (texel[column] - mean[column]);
+					}
+				}
+			}
+
+			// Power iteration, started from the bounding box diagonal.
+			vec4 axis = {};
+			for (u32 channel = 0; channel < channels; channel++)
+			{
+				axis[channel] = maximum[channel] - minimum[channel];
+			}
+
+			for (u32 iteration = 0; iteration < 8; iteration++)
+			{
+				vec4 next     = {};
+				f32 magnitude = 0.0F;
+
+				for (u32 row = 0; row < channels; row++)
+				{
+					for (u32 column = 0; column < channels; column++)
+					{
+						next[row] += covariance[row][column] * axis[column];
+					}
+					magnitude = std::max(magnitude, std::abs(next[row]));
+				}
+
+				if (magnitude == 0.0F)
+				{
+					break;
+				}
+
+				for (u32 channel = 0; channel < channels; channel++)
+				{
+					axis[channel] = next[channel] / magnitude;
+				}
+			}
+
+			const f32 length = distance(axis, {}, channels);
+
+			if (length == 0.0F)
+			{
+				return { mean, mean };
+			}
+
+			f32 low  = std::numeric_limits<f32>::max();
+			f32 high = std::numeric_limits<f32>::lowest();
+
+			for (u32 index = 0; index < block_texels; index++)
+			{
+				const vec4 texel = get_texel(p_texels, index);
+
+				f32 projection = 0.0F;
+				for (u32 channel = 0; channel < channels; channel++)
+				{
+					projection += (texel[channel] - mean[channel]) * axis[channel];
+				}
+
+				low  = std::min(low, projection);
+				high = std::max(high, projection);
+			}
+
+			vec4 first  = mean;
+			vec4 second = mean;
+
+			for (u32 channel = 0; channel < channels; channel++)
+			{
+				first[channel]  = std::clamp(mean[channel] + axis[channel] * low / length, 0.0F, 255.0F);
+				second[channel] = std::clamp(mean[channel] + axis[channel] * high / length, 0.0F, 255.0F);
+			}
+
+			return { first, second };
+		}
+
+		// Endpoints that minimise the squared error for fixed interpolation weights towards the second endpoint.
+		b8 refine_endpoints(const u8* p_texels, const std::array<f32, block_texels>& weights, u32 channels, vec4& first, vec4& second)
+		{
+			f32 aa  = 0.0F;
+			f32 ab  = 0.0F;
+			f32 bb  = 0.0F;
+			vec4 ax = {};
+			vec4 bx = {};
+
+			for (u32 index = 0; index < block_texels; index++)
+			{
+				const vec4 texel = get_texel(p_texels, index);
+				const f32 b      = weights[index];
+				const f32 a      = 1.0F - b;
+
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+
+				for (u32 channel = 0; channel < channels; channel++)
+				{
+					ax[channel] += a * texel[channel];
+					bx[channel] += b * texel[channel];
+				}
+			}
+
+			const f32 determinant = aa * bb - ab * ab;
+
+			if (std::abs(determinant) < 1e-6F)
+			{
+				return false;
+			}
+
+			for (u32 channel = 0; channel < channels; channel++)
+			{
+				first[channel]  = std::clamp((bb * ax[channel] - ab * bx[channel]) / determinant, 0.0F, 255.0F);
+				second[channel] = std::clamp((aa * bx[channel] - ab * ax[channel]) / determinant, 0.0F, 255.0F);
+			}
+
+			return true;
+		}
+
+		struct bc1_fit
+		{
+			u16 color0                            = 0;
+			u16 color1                            = 0;
+			u32 indices                           = 0;
+			f32 error                             = std::numeric_limits<f32>::max();
+			std::array<f32, block_texels> weights = {};
+		};
+
+		u16 pack_565(const vec4& color)
+		{
+			const auto r = static_cast<u32>(color[0] * 31.0F / 255.0F + 0.5F);
+			const auto g = static_cast<u32>(color[1] * 63.0F / 255.0F + 0.5F);
+			const auto b = static_cast<u32>(color[2] * 31.0F / 255.0F + 0.5F);
+			return static_cast<u16>(r << 11 | g << 5 | b);
+		}
+
+		vec4 unpack_565(u16 color)
+		{
+			const u32 r = color >> 11 & 31U;
+			const u32 g = color >> 5 & 63U;
+			const u32 b = color & 31U;
+			return { static_cast<f32>(r << 3 | r >> 2), static_cast<f32>(g << 2 | g >> 4), static_cast<f32>(b << 3 | b >> 2), 255.0F };
+		}
+
+		bc1_fit fit_bc1(const u8* p_texels, const vec4& first, const vec4& second)
+		{
+			bc1_fit fit;
+			fit.color0 = pack_565(second);
+			fit.color1 = pack_565(first);
+
+			// color0 > color1 selects the four colour mode, equal endpoints fall into the three colour mode where index 0 is still color0.
+			if (fit.color0 < fit.color1)
+			{
+				std::swap(fit.color0, fit.color1);
+			}
+
+			const vec4 endpoint0 = unpack_565(fit.color0);
+			const vec4 endpoint1 = unpack_565(fit.color1);
+			const u32 candidates = fit.color0 == fit.color1 ? 1 : 4;
+
+			std::array<vec4, 4> palette = {};
+			for (u32 index = 0; index < 4; index++)
+			{
+				for (u32 channel = 0; channel < 3; channel++)
+				{
+					palette[index][channel] = endpoint0[channel] + (endpoint1[channel] - endpoint0[channel]) * bc1_weights[index];
+				}
+			}
+
+			fit.error = 0.0F;
+
+			for (u32 texel = 0; texel < block_texels; texel++)
+			{
+				const vec4 color = get_texel(p_texels, texel);
+
+				u32 best       = 0;
+				f32 best_error = std::numeric_limits<f32>::max();
+
+				for (u32 index = 0; index < candidates; index++)
+				{
+					const f32 error = distance(color, palette[index], 3);
+					if (error < best_error)
+					{
+						best       = index;
+						best_error = error;
+					}
+				}
+
+				fit.indices |= best << (texel * 2);
+				fit.error += best_error;
+				fit.weights[texel] = bc1_weights[best];
+			}
+
+			return fit;
+		}
+
+		struct bc7_endpoint
+		{
+			std::array<u32, 4> values = {}; // 7 bits per channel.
+			u32 p_bit                 = 0;
+
+			cc_nodiscard u32 expand(u32 channel) const
+			{
+				return values[channel] << 1 | p_bit;
+			}
+		};
+
+		bc7_endpoint quantize_bc7(const vec4& color)
+		{
+			bc7_endpoint best;
+			f32 best_error = std::numeric_limits<f32>::max();
+
+			for (u32 p_bit = 0; p_bit < 2; p_bit++)
+			{
+				bc7_endpoint candidate;
+				candidate.p_bit = p_bit;
+
+				f32 error = 0.0F;
+				for (u32 channel = 0; channel < 4; channel++)
+				{
+					const f32 value           = std::round((color[channel] - static_cast<f32>(p_bit)) / 2.0F);
+					candidate.values[channel] = static_cast<u32>(std::clamp(value, 0.0F, 127.0F));
+
+					const f32 delta = static_cast<f32>(candidate.expand(channel)) - color[channel];
+					error += delta * delta;
+				}
+
+				if (error < best_error)
+				{
+					best       = candidate;
+					best_error = error;
+				}
+			}
+
+			return best;
+		}
+
+		struct bc7_fit
+		{
+			bc7_endpoint endpoint0;
+			bc7_endpoint endpoint1;
+			std::array<u32, block_texels> indices = {};
+			f32 error                             = std::numeric_limits<f32>::max();
+			std::array<f32, block_texels> weights = {};
+		};
+
+		bc7_fit fit_bc7(const u8* p_texels, const vec4& first, const vec4& second)
+		{
+			bc7_fit fit;
+			fit.endpoint0 = quantize_bc7(first);
+			fit.endpoint1 = quantize_bc7(second);
+
+			std::array<vec4, 16> palette = {};
+			for (u32 index = 0; index < 16; index++)
+			{
+				for (u32 channel = 0; channel < 4; channel++)
+				{
+					const u32 value         = ((64 - bc7_weights[index]) * fit.endpoint0.expand(channel) + bc7_weights[index] * fit.endpoint1.expand(channel) + 32) >> 6;
+					palette[index][channel] = static_cast<f32>(value);
+				}
+			}
+
+			fit.error = 0.0F;
+
+			for (u32 texel = 0; texel < block_texels; texel++)
+			{
+				const vec4 color = get_texel(p_texels, texel);
+
+				u32 best       = 0;
+				f32 best_error = std::numeric_limits<f32>::max();
+
+				for (u32 index = 0; index < 16; index++)
+				{
+					const f32 error = distance(color, palette[index], 4);
+					if (error < best_error)
+					{
+						best       = index;
+						best_error = error;
+					}
+				}
+
+				fit.indices[texel] = best;
+				fit.error += best_error;
+				fit.weights[texel] = static_cast<f32>(bc7_weights[best]) / 64.0F;
+			}
+
+			return fit;
+		}
+
+		void write_bc1(const bc1_fit& fit, u8* p_block)
+		{
+			p_block[0] = static_cast<u8>(fit.color0 & 0xFF);
+			p_block[1] = static_cast<u8>(fit.color0 >> 8);
+			p_block[2] = static_cast<u8>(fit.color1 & 0xFF);
+			p_block[3] = static_cast<u8>(fit.color1 >> 8);
+
+			for (u32 byte = 0; byte < 4; byte++)
+			{
+				p_block[4 + byte] = static_cast<u8>(fit.indices >> (byte * 8));
+			}
+		}
+
+		void write_bc7_mode6(bc7_fit fit, u8* p_block)
+		{
+			// The first index is stored without its top bit, which therefore has to be zero.
+			if (fit.indices[0] >= 8)
+			{
+				std::swap(fit.endpoint0, fit.endpoint1);
+				for (u32& index: fit.indices)
+				{
+					index = 15 - index;
+				}
+			}
+
+			std::memset(p_block, 0, 16);
+
+			bit_writer writer(p_block);
+			writer.write(1U << 6, 7);
+
+			for (u32 channel = 0; channel < 4; channel++)
+			{
+				writer.write(fit.endpoint0.values[channel], 7);
+				writer.write(fit.endpoint1.values[channel], 7);
+			}
+
+			writer.write(fit.endpoint0.p_bit, 1);
+			writer.write(fit.endpoint1.p_bit, 1);
+
+			for (u32 texel = 0; texel < block_texels; texel++)
+			{
+				writer.write(fit.indices[texel], texel == 0 ? 3 : 4);
+			}
+		}
+	} // namespace details
+
+	void encode_bc1_block(const u8* p_texels, u8* p_block)
+	{
+		auto [first, second] = details::find_principal_endpoints(p_texels, 3);
+
+		details::bc1_fit fit = details::fit_bc1(p_texels, first, second);
+
+		if (fit.error > 0.0F && details::refine_endpoints(p_texels, fit.weights, 3, first, second))
+		{
+			// The refit solves for color0 as the first endpoint, hand them over in the order fit_bc1() expects.
+			const details::bc1_fit refined = details::fit_bc1(p_texels, second, first);
+			fit                            = refined.error < fit.error ? refined : fit;
+		}
+
+		details::write_bc1(fit, p_block);
+	}
+
+	void encode_bc7_block(const u8* p_texels, u8* p_block)
+	{
+		auto [first, second] = details::find_principal_endpoints(p_texels, 4);
+
+		details::bc7_fit fit = details::fit_bc7(p_texels, first, second);
+
+		if (fit.error > 0.0F && details::refine_endpoints(p_texels, fit.weights, 4, first, second))
+		{
+			const details::bc7_fit refined = details::fit_bc7(p_texels, first, second);
+			fit                            = refined.error < fit.error ? refined : fit;
+		}
+
+		details::write_bc7_mode6(fit, p_block);
+	}
+
+	texture_data compress_texture(const texture_data& texture, texture_encoding encoding)
+	{
+		ensure(texture.encoding == texture_encoding::rgba8, "Only uncompressed textures can be transcoded!");
+
+		if (encoding == texture_encoding::rgba8)
+		{
+			return texture;
+		}
+
+		const u32 block_size = get_block_size(encoding);
+
+		texture_data compressed;
+		compressed.encoding = encoding;
+
+		std::size_t end = 0;
+		for (const texture_level& level: texture.levels)
+		{
+			const std::size_t size = get_level_size(encoding, level.width, level.height);
+			compressed.levels.push_back({ .width = level.width, .height = level.height, .offset = end, .size = size });
+			end = (end + size + 15) / 16 * 16;
+		}
+
+		compressed.bytes.resize(end);
+
+		std::array<u8, details::block_texels * 4> block = {};
+
+		for (u32 level = 0; level < texture.levels.size(); level++)
+		{
+			const texture_level& source = texture.levels[level];
+			const u8* p_source          = texture.bytes.data() + source.offset;
+			u8* p_destination           = compressed.bytes.data() + compressed.levels[level].offset;
+
+			for (u32 block_y = 0; block_y < source.height; block_y += 4)
+			{
+				for (u32 block_x = 0; block_x < source.width; block_x += 4)
+				{
+					for (u32 texel = 0; texel < details::block_texels; texel++)
+					{
+						const u32 x = std::min(block_x + texel % 4, source.width - 1);
+						const u32 y = std::min(block_y + texel / 4, source.height - 1);
+						std::memcpy(block.data() + texel * 4, p_source + (static_cast<std::size_t>(y) * source.width + x) * 4, 4);
+					}
+
+					if (encoding == texture_encoding::bc1)
+					{
+						encode_bc1_block(block.data(), p_destination);
+					}
+					else
+					{
+						encode_bc7_block(block.data(), p_destination);
+					}
+
+					p_destination += block_size;
+				}
+			}
+		}
+
+		return compressed;
+	}
+} // namespace cc
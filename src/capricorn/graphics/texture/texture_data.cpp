@@ -0,0 +1,296 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/texture/texture_data.hpp"
+
+#include "capricorn/assets/asset_pack_format.hpp"
+#include "capricorn/base/log.hpp"
+
+#include <bit>
+
+#include <png.h>
+
+namespace cc
+{
+	namespace details
+	{
+		constexpr std::size_t level_alignment = 16;
+		constexpr u32 linear_table_size       = 4096;
+
+		struct srgb_tables
+		{
+			std::array<f32, 256> to_linear                   = {};
+			std::array<u8, linear_table_size + 1> to_encoded = {};
+		};
+
+		const srgb_tables& get_srgb_tables()
+		{
+			static const srgb_tables tables = [] {
+				srgb_tables result;
+
+				for (u32 value = 0; value < 256; value++)
+				{
+					const f32 encoded       = static_cast<f32>(value) / 255.0F;
+					result.to_linear[value] = encoded <= 0.04045F ? encoded / 12.92F : std::pow((encoded + 0.055F) / 1.055F, 2.4F);
+				}
+
+				for (u32 index = 0; index <= linear_table_size; index++)
+				{
+					const f32 linear         = static_cast<f32>(index) / static_cast<f32>(linear_table_size);
+					const f32 encoded        = linear <= 0.0031308F ? linear * 12.92F : 1.055F * std::pow(linear, 1.0F / 2.4F) - 0.055F;
+					result.to_encoded[index] = static_cast<u8>(std::clamp(encoded * 255.0F + 0.5F, 0.0F, 255.0F));
+				}
+
+				return result;
+			}();
+
+			return tables;
+		}
+
+		std::size_t align_level(std::size_t offset)
+		{
+			return (offset + level_alignment - 1) / level_alignment * level_alignment;
+		}
+
+		// 2x2 box filter; the last row or column of an odd-sized level is dropped rather than spread over its neighbours.
+		void downsample(const u8* p_source, u32 source_width, u32 source_height, u8* p_destination, u32 width, u32 height, const srgb_tables* p_tables)
+		{
+			for (u32 y = 0; y < height; y++)
+			{
+				const u32 y0 = std::min(y * 2, source_height - 1);
+				const u32 y1 = std::min(y * 2 + 1, source_height - 1);
+
+				for (u32 x = 0; x < width; x++)
+				{
+					const u32 x0 = std::min(x * 2, source_width - 1);
+					const u32 x1 = std::min(x * 2 + 1, source_width - 1);
+
+					const std::array<const u8*, 4> texels = {
+					        p_source + (static_cast<std::size_t>(y0) * source_width + x0) * 4,
+					        p_source + (static_cast<std::size_t>(y0) * source_width + x1) * 4,
+					        p_source + (static_cast<std::size_t>(y1) * source_width + x0) * 4,
+					        p_source + (static_cast<std::size_t>(y1) * source_width + x1) * 4,
+					};
+
+					u8* p_texel = p_destination + (static_cast<std::size_t>(y) * width + x) * 4;
+
+					for (u32 channel = 0; channel < 4; channel++)
+					{
+						if (p_tables != nullptr && channel < 3)
+						{
+							f32 sum = 0.0F;
+							for (const u8* p_sample: texels)
+							{
+								sum += p_tables->to_linear[p_sample[channel]];
+							}
+
+							p_texel[channel] = p_tables->to_encoded[static_cast<u32>(sum * 0.25F * linear_table_size + 0.5F)];
+						}
+						else
+						{
+							const u32 sum    = texels[0][channel] + texels[1][channel] + texels[2][channel] + texels[3][channel];
+							p_texel[channel] = static_cast<u8>((sum + 2) / 4);
+						}
+					}
+				}
+			}
+		}
+	} // namespace details
+
+	std::span<const u8> texture_data::get_level(u32 level) const
+	{
+		return { bytes.data() + levels[level].offset, levels[level].size };
+	}
+
+	std::span<u8> texture_data::get_level(u32 level)
+	{
+		return { bytes.data() + levels[level].offset, levels[level].size };
+	}
+
+	u32 get_block_size(texture_encoding encoding) noexcept
+	{
+		switch (encoding)
+		{
+			case texture_encoding::bc1:
+				return 8;
+			case texture_encoding::bc7:
+				return 16;
+			default:
+				return 0;
+		}
+	}
+
+	std::size_t get_level_size(texture_encoding encoding, u32 width, u32 height) noexcept
+	{
+		const u32 block_size = get_block_size(encoding);
+
+		if (block_size == 0)
+		{
+			return static_cast<std::size_t>(width) * height * 4;
+		}
+
+		return static_cast<std::size_t>((width + 3) / 4) * ((height + 3) / 4) * block_size;
+	}
+
+	u32 get_mip_count(u32 width, u32 height) noexcept
+	{
+		return static_cast<u32>(std::bit_width(std::max(width, height)));
+	}
+
+	std::optional<texture_data> decode_png(std::span<const u8> file)
+	{
+		png_image image = {};
+		image.version   = PNG_IMAGE_VERSION;
+
+		if (png_image_begin_read_from_memory(&image, file.data(), file.size()) == 0)
+		{
+			log::warning(log_source::renderer, "Failed to read PNG header: {}", image.message);
+			return std::nullopt;
+		}
+
+		// libpng converts palettes, grey, 16-bit and tRNS to this on the fly.
+		image.format = PNG_FORMAT_RGBA;
+
+		texture_data texture;
+		texture.levels.push_back({ .width = image.width, .height = image.height, .offset = 0, .size = PNG_IMAGE_SIZE(image) });
+		texture.bytes.resize(PNG_IMAGE_SIZE(image));
+
+		if (png_image_finish_read(&image, nullptr, texture.bytes.data(), 0, nullptr) == 0)
+		{
+			log::warning(log_source::renderer, "Failed to decode PNG: {}", image.message);
+			png_image_free(&image);
+			return std::nullopt;
+		}
+
+		return texture;
+	}
+
+	void generate_mips(texture_data& texture, b8 srgb)
+	{
+		ensure(texture.encoding == texture_encoding::rgba8 && !texture.levels.empty(), "Mips can only be generated from uncompressed texels!");
+
+		const u32 width     = texture.levels[0].width;
+		const u32 height    = texture.levels[0].height;
+		const u32 mip_count = get_mip_count(width, height);
+		std::size_t end     = texture.levels[0].size;
+		texture.levels.resize(1);
+
+		for (u32 level = 1; level < mip_count; level++)
+		{
+			const u32 level_width    = std::max(1U, width >> level);
+			const u32 level_height   = std::max(1U, height >> level);
+			const std::size_t size   = get_level_size(texture_encoding::rgba8, level_width, level_height);
+			const std::size_t offset = details::align_level(end);
+
+			texture.levels.push_back({ .width = level_width, .height = level_height, .offset = offset, .size = size });
+			end = offset + size;
+		}
+
+		texture.bytes.resize(end);
+
+		const details::srgb_tables* p_tables = srgb ? &details::get_srgb_tables() : nullptr;
+
+		for (u32 level = 1; level < mip_count; level++)
+		{
+			const texture_level& source      = texture.levels[level - 1];
+			const texture_level& destination = texture.levels[level];
+
+			details::downsample(texture.bytes.data() + source.offset, source.width, source.height, texture.bytes.data() + destination.offset, destination.width, destination.height, p_tables);
+		}
+	}
+
+	b8 is_opaque(const texture_data& texture)
+	{
+		if (texture.encoding != texture_encoding::rgba8 || texture.levels.empty())
+		{
+			return texture.encoding == texture_encoding::bc1;
+		}
+
+		const std::span<const u8> texels = texture.get_level(0);
+
+		for (std::size_t index = 3; index < texels.size(); index += 4)
+		{
+			if (texels[index] != 255)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	std::vector<u8> serialize_texture(const texture_data& texture, b8 srgb)
+	{
+		ensure(!texture.levels.empty(), "Cannot serialize a texture without levels!");
+
+		const asset_pack_format::texture_header header = {
+		        .width       = texture.levels[0].width,
+		        .height      = texture.levels[0].height,
+		        .level_count = static_cast<u32>(texture.levels.size()),
+		        .encoding    = static_cast<u8>(texture.encoding),
+		        .srgb        = static_cast<u8>(srgb ? 1 : 0),
+		        .reserved    = {},
+		};
+
+		const std::size_t table_size = sizeof(header) + texture.levels.size() * sizeof(asset_pack_format::texture_level);
+		const std::size_t base       = details::align_level(table_size);
+
+		std::vector<u8> payload(base + texture.bytes.size());
+		std::memcpy(payload.data(), &header, sizeof(header));
+
+		for (std::size_t level = 0; level < texture.levels.size(); level++)
+		{
+			const asset_pack_format::texture_level entry = { .offset = base + texture.levels[level].offset, .size = texture.levels[level].size };
+			std::memcpy(payload.data() + sizeof(header) + level * sizeof(entry), &entry, sizeof(entry));
+		}
+
+		std::memcpy(payload.data() + base, texture.bytes.data(), texture.bytes.size());
+
+		return payload;
+	}
+
+	b8 parse_texture(std::span<const u8> payload, texture_data& texture, b8& srgb)
+	{
+		asset_pack_format::texture_header header = {};
+
+		if (payload.size() < sizeof(header))
+		{
+			return false;
+		}
+
+		std::memcpy(&header, payload.data(), sizeof(header));
+
+		const auto encoding = static_cast<texture_encoding>(header.encoding);
+
+		if (header.encoding > static_cast<u8>(texture_encoding::bc7) || header.width == 0 || header.height == 0 ||
+		    header.level_count == 0 || header.level_count > get_mip_count(header.width, header.height) ||
+		    payload.size() < sizeof(header) + static_cast<std::size_t>(header.level_count) * sizeof(asset_pack_format::texture_level))
+		{
+			return false;
+		}
+
+		texture.encoding = encoding;
+		texture.levels.clear();
+		texture.bytes.clear();
+
+		for (u32 level = 0; level < header.level_count; level++)
+		{
+			asset_pack_format::texture_level entry = {};
+			std::memcpy(&entry, payload.data() + sizeof(header) + level * sizeof(entry), sizeof(entry));
+
+			const u32 width  = std::max(1U, header.width >> level);
+			const u32 height = std::max(1U, header.height >> level);
+
+			if (entry.offset % details::level_alignment != 0 || entry.size != get_level_size(encoding, width, height) ||
+			    entry.offset > payload.size() || entry.size > payload.size() - entry.offset)
+			{
+				return false;
+			}
+
+			texture.levels.push_back({ .width = width, .height = height, .offset = entry.offset, .size = entry.size });
+		}
+
+		srgb = header.srgb != 0;
+		return true;
+	}
+} // namespace cc
@@ -0,0 +1,1015 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/texture/texture_streamer.hpp"
+
+#include "capricorn/base/binary_log.hpp"
+#include "capricorn/graphics/texture/block_compression.hpp"
+#include "capricorn/graphics/vulkan/memory_allocator.hpp"
+#include "capricorn/memory/scratch_arena.hpp"
+
+namespace cc
+{
+	namespace details
+	{
+		VkFormat get_texture_format(texture_encoding encoding, b8 srgb)
+		{
+			switch (encoding)
+			{
+				case texture_encoding::bc1:
+					return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+				case texture_encoding::bc7:
+					return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+				default:
+					return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+			}
+		}
+
+		f64 megabytes_per_second(u64 bytes, f64 seconds)
+		{
+			return seconds > 0.0 ? static_cast<f64>(bytes) / (1000.0 * 1000.0) / seconds : 0.0;
+		}
+
+		VkExtent3D get_level_extent(const VkExtent3D& extent, u32 level)
+		{
+			return { std::max(1U, extent.width >> level), std::max(1U, extent.height >> level), 1 };
+		}
+	} // namespace details
+
+	texture_streamer::texture_streamer(const texture_streamer_create_info& create_info) // NOLINT(modernize-pass-by-value)
+	    : m_create_info(create_info),
+	      m_context(create_info.p_context.lock()),
+	      m_job_system(create_info.p_job_system.lock())
+	{
+		ensure(m_context != nullptr, "Texture streamer requires a graphics context!");
+		ensure(m_job_system != nullptr, "Texture streamer requires a job system!");
+
+		m_device         = m_context->get_logical_device().lock();
+		m_upload_service = m_context->get_upload_service().lock();
+		m_bindless_heap  = m_context->get_bindless_heap().lock();
+		ensure(m_device != nullptr && m_upload_service != nullptr, "Texture streamer requires an initialized graphics context!");
+
+		m_bc_supported = m_device->get_enabled_features().textureCompressionBC == VK_TRUE;
+
+		if (m_create_info.compression != texture_compression::none && !m_bc_supported)
+		{
+			log::warning(log_source::renderer, "Device lacks BC texture compression, streaming textures uncompressed.");
+			m_create_info.compression = texture_compression::none;
+		}
+
+		if (m_create_info.mips == mip_source::gpu && m_create_info.compression != texture_compression::none)
+		{
+			log::warning(log_source::renderer, "Block-compressed textures cannot be blitted, generating their mips on the CPU.");
+			m_create_info.mips = mip_source::cpu;
+		}
+
+		if (m_create_info.mips == mip_source::gpu)
+		{
+			const auto p_instance         = m_device->get_create_info().instance.lock();
+			VkFormatProperties properties = {};
+			p_instance->get_dispatch().vkGetPhysicalDeviceFormatProperties(m_device->get_physical_device(), details::get_texture_format(texture_encoding::rgba8, m_create_info.srgb), &properties);
+
+			constexpr VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+			if ((properties.optimalTilingFeatures & required) != required)
+			{
+				log::warning(log_source::renderer, "Device cannot blit textures with linear filtering, generating their mips on the CPU.");
+				m_create_info.mips = mip_source::cpu;
+			}
+		}
+	}
+
+	texture_streamer::~texture_streamer()
+	{
+		if (m_job_system == nullptr)
+		{
+			return;
+		}
+
+		for (const std::unique_ptr<texture_record>& p_record: m_textures)
+		{
+			if (p_record != nullptr)
+			{
+				m_job_system->wait(p_record->loading);
+				m_job_system->wait(p_record->staging);
+			}
+		}
+
+		// Pending uploads may still be recording, and frames in flight may still sample the images.
+		m_upload_service->wait(m_upload_service->flush());
+		m_device->get_dispatch().vkDeviceWaitIdle(*m_device);
+
+		for (const std::unique_ptr<texture_record>& p_record: m_textures)
+		{
+			if (p_record != nullptr)
+			{
+				retire(*p_record, 0);
+			}
+		}
+
+		release_retired(0, true);
+		m_textures.clear();
+	}
+
+	std::shared_ptr<texture_streamer> texture_streamer::create(const texture_streamer_create_info& create_info)
+	{
+		return std::make_shared<texture_streamer>(create_info);
+	}
+
+	texture_handle texture_streamer::load(const std::filesystem::path& path)
+	{
+		auto p_record  = std::make_unique<texture_record>();
+		p_record->path = path;
+
+		texture_record* p_loading   = p_record.get();
+		const texture_handle handle = add_record(std::move(p_record));
+
+		m_job_system->run([this, p_loading] { load_texture(*p_loading); }, &p_loading->loading);
+
+		return handle;
+	}
+
+	texture_handle texture_streamer::load(std::shared_ptr<const asset_pack> p_pack, std::string_view name)
+	{
+		auto p_record    = std::make_unique<texture_record>();
+		p_record->path   = name;
+		p_record->p_pack = std::move(p_pack);
+
+		texture_record* p_loading   = p_record.get();
+		const texture_handle handle = add_record(std::move(p_record));
+
+		m_job_system->run([this, p_loading] { load_packed_texture(*p_loading); }, &p_loading->loading);
+
+		return handle;
+	}
+
+	texture_handle texture_streamer::add_record(std::unique_ptr<texture_record> p_record)
+	{
+		texture_handle handle = 0;
+
+		if (!m_free_handles.empty())
+		{
+			handle = m_free_handles.back();
+			m_free_handles.pop_back();
+		}
+		else
+		{
+			handle = static_cast<texture_handle>(m_textures.size());
+			m_textures.emplace_back();
+		}
+
+		m_textures[handle] = std::move(p_record);
+
+		std::lock_guard const lock(m_statistics_mutex);
+		m_statistics.loading += 1;
+
+		return handle;
+	}
+
+	void texture_streamer::unload(texture_handle texture)
+	{
+		texture_record* p_record = find(texture);
+
+		if (p_record != nullptr)
+		{
+			p_record->unloading = true;
+		}
+	}
+
+	void texture_streamer::request(texture_handle texture, f32 screen_size)
+	{
+		texture_record* p_record = find(texture);
+
+		if (p_record != nullptr)
+		{
+			p_record->demand = std::max(p_record->demand, screen_size);
+		}
+	}
+
+	void texture_streamer::update(const graphics_frame& frame)
+	{
+		cc_profile_zone("texture_streamer::update");
+
+		release_retired(frame.frame_number, false);
+
+		for (texture_handle handle = 0; handle < m_textures.size(); handle++)
+		{
+			texture_record* p_record = m_textures[handle].get();
+
+			if (p_record == nullptr)
+			{
+				continue;
+			}
+
+			texture_record& record = *p_record;
+			const load_state state = record.state.load(std::memory_order_acquire);
+
+			if (record.unloading)
+			{
+				// The jobs and the transfer queue may still be writing to the record and its images.
+				if (!record.loading.is_done() || !record.staging.is_done() || (record.pending.has_value() && !m_upload_service->is_complete(record.pending->token)))
+				{
+					continue;
+				}
+
+				// Transitions that copy finish in the frame that starts them, whatever is left is an upload. Its acquire
+				// barrier names the image, so the image has to outlive the frame that records it.
+				if (record.pending.has_value())
+				{
+					m_context->wait_for_upload(frame, record.pending->token);
+					end_upload(0);
+
+					m_retired.push_back({ .p_image = std::move(record.pending->p_image), .frame_number = frame.frame_number });
+
+					if (record.pending->p_source != nullptr)
+					{
+						m_retired.push_back({ .p_image = std::move(record.pending->p_source), .frame_number = frame.frame_number });
+					}
+				}
+
+				retire(record, frame.frame_number);
+
+				// Handed out again only once the frames that may still sample the retired view are done.
+				if (record.bindless != vk::invalid_bindless_index)
+				{
+					m_bindless_heap->remove_texture(record.bindless);
+				}
+
+				{
+					std::lock_guard const lock(m_statistics_mutex);
+					if (!record.counted)
+					{
+						m_statistics.loading -= 1;
+					}
+					else if (state == load_state::ready)
+					{
+						m_statistics.loaded -= 1;
+					}
+					else
+					{
+						m_statistics.failed -= 1;
+					}
+				}
+
+				m_textures[handle].reset();
+				m_free_handles.push_back(handle);
+				continue;
+			}
+
+			if (state == load_state::loading)
+			{
+				continue;
+			}
+
+			if (!record.counted)
+			{
+				record.counted = true;
+
+				if (state == load_state::ready)
+				{
+					const texture_level& top = record.data.levels[0];
+
+					record.level_count  = get_mip_count(top.width, top.height);
+					record.resident_mip = record.level_count;
+					record.tail_mip     = record.level_count - 1;
+
+					while (record.tail_mip > 0 && std::max(top.width >> (record.tail_mip - 1), top.height >> (record.tail_mip - 1)) <= m_create_info.tail_size)
+					{
+						record.tail_mip -= 1;
+					}
+				}
+
+				std::lock_guard const lock(m_statistics_mutex);
+				m_statistics.loading -= 1;
+				m_statistics.loaded += state == load_state::ready ? 1 : 0;
+				m_statistics.failed += state == load_state::failed ? 1 : 0;
+			}
+
+			if (state == load_state::ready && record.pending.has_value() && record.staging.is_done() && m_upload_service->is_complete(record.pending->token))
+			{
+				finish_transition(frame, record);
+			}
+		}
+
+		const b8 over_budget = balance_residency();
+
+		scratch_arena const scratch;
+		std::pmr::vector<texture_record*> candidates(scratch.get_resource());
+
+		for (const std::unique_ptr<texture_record>& p_record: m_textures)
+		{
+			if (p_record == nullptr || !p_record->counted || p_record->unloading || p_record->pending.has_value() || p_record->state.load(std::memory_order_relaxed) != load_state::ready)
+			{
+				continue;
+			}
+
+			const b8 stream_in  = p_record->wanted_mip < p_record->resident_mip;
+			const b8 stream_out = p_record->wanted_mip > p_record->resident_mip && (over_budget || p_record->stream_out_frames >= m_create_info.stream_out_delay);
+
+			if (stream_in || stream_out)
+			{
+				candidates.push_back(p_record.get());
+			}
+		}
+
+		// Textures without anything resident first, then the ones freeing memory, then the largest gains in resolution.
+		std::sort(candidates.begin(), candidates.end(), [](const texture_record* p_left, const texture_record* p_right) {
+			const auto rank = [](const texture_record* p_record) {
+				return p_record->p_image == nullptr ? 0 : (p_record->wanted_mip > p_record->resident_mip ? 1 : 2);
+			};
+
+			if (rank(p_left) != rank(p_right))
+			{
+				return rank(p_left) < rank(p_right);
+			}
+
+			return p_left->resident_mip - std::min(p_left->wanted_mip, p_left->resident_mip) > p_right->resident_mip - std::min(p_right->wanted_mip, p_right->resident_mip);
+		});
+
+		u32 transitions     = 0;
+		VkDeviceSize staged = 0;
+
+		for (texture_record* p_record: candidates)
+		{
+			if (transitions == m_create_info.max_transitions_per_frame)
+			{
+				break;
+			}
+
+			const VkDeviceSize bytes = get_staging_size(*p_record);
+
+			// Always let one through, a single level may be larger than the per-frame limit.
+			if (transitions > 0 && staged + bytes > m_create_info.max_bytes_per_frame)
+			{
+				continue;
+			}
+
+			start_transition(frame, *p_record);
+
+			transitions += 1;
+			staged += bytes;
+		}
+	}
+
+	b8 texture_streamer::is_loaded(texture_handle texture) const
+	{
+		const texture_record* p_record = find(texture);
+		return p_record != nullptr && p_record->state.load(std::memory_order_acquire) == load_state::ready;
+	}
+
+	b8 texture_streamer::is_resident(texture_handle texture) const
+	{
+		const texture_record* p_record = find(texture);
+		return p_record != nullptr && p_record->p_image != nullptr;
+	}
+
+	VkImageView texture_streamer::get_image_view(texture_handle texture) const
+	{
+		const texture_record* p_record = find(texture);
+		return p_record != nullptr ? p_record->view : VK_NULL_HANDLE;
+	}
+
+	vk::bindless_index texture_streamer::get_bindless_index(texture_handle texture) const
+	{
+		const texture_record* p_record = find(texture);
+		return p_record != nullptr ? p_record->bindless : vk::invalid_bindless_index;
+	}
+
+	u32 texture_streamer::get_resident_mip(texture_handle texture) const
+	{
+		const texture_record* p_record = find(texture);
+		return p_record != nullptr ? p_record->resident_mip : 0;
+	}
+
+	texture_streaming_statistics texture_streamer::get_statistics() const
+	{
+		std::lock_guard const lock(m_statistics_mutex);
+
+		texture_streaming_statistics statistics = m_statistics;
+
+		if (m_uploads_in_flight != 0)
+		{
+			statistics.upload_seconds += std::chrono::duration<f64>(clock::now() - m_upload_start).count();
+		}
+
+		return statistics;
+	}
+
+	void texture_streamer::log_statistics() const
+	{
+		const texture_streaming_statistics statistics = get_statistics();
+
+		log::info(log_source::renderer,
+		          "Textures: {} loaded, {} loading, {} failed, {:.1f} MiB resident of {:.1f} MiB wanted, {} mip transitions in and {} out.",
+		          statistics.loaded,
+		          statistics.loading,
+		          statistics.failed,
+		          static_cast<f64>(statistics.resident_bytes) / (1024.0 * 1024.0),
+		          static_cast<f64>(statistics.wanted_bytes) / (1024.0 * 1024.0),
+		          statistics.streamed_in,
+		          statistics.streamed_out);
+
+		log::info(log_source::renderer,
+		          "Texture throughput: decode {:.1f} MB/s, mips {:.1f} MB/s, transcode {:.1f} MB/s, unpack {:.1f} MB/s per worker, upload {:.1f} MB/s.",
+		          details::megabytes_per_second(statistics.decoded_bytes, statistics.decode_seconds),
+		          details::megabytes_per_second(statistics.mip_bytes, statistics.mip_seconds),
+		          details::megabytes_per_second(statistics.encoded_bytes, statistics.encode_seconds),
+		          details::megabytes_per_second(statistics.unpacked_bytes, statistics.unpack_seconds),
+		          details::megabytes_per_second(statistics.uploaded_bytes, statistics.upload_seconds));
+	}
+
+	void texture_streamer::load_texture(texture_record& record)
+	{
+		std::ifstream file(record.path, std::ios::binary | std::ios::ate);
+
+		if (!file)
+		{
+			cc_log_warning(log_source::renderer, "Failed to open texture {}.", record.path.string());
+			record.state.store(load_state::failed, std::memory_order_release);
+			return;
+		}
+
+		std::vector<u8> contents(static_cast<std::size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+
+		clock::time_point start             = clock::now();
+		std::optional<texture_data> texture = decode_png(contents);
+
+		if (!texture.has_value())
+		{
+			cc_log_warning(log_source::renderer, "Failed to decode texture {}.", record.path.string());
+			record.state.store(load_state::failed, std::memory_order_release);
+			return;
+		}
+
+		const f64 decode_seconds = std::chrono::duration<f64>(clock::now() - start).count();
+		const u64 decoded_bytes  = texture->bytes.size();
+
+		f64 mip_seconds = 0.0;
+
+		if (m_create_info.mips == mip_source::cpu)
+		{
+			start = clock::now();
+			generate_mips(*texture, m_create_info.srgb);
+			mip_seconds = std::chrono::duration<f64>(clock::now() - start).count();
+		}
+
+		const u64 mip_bytes = texture->bytes.size() - decoded_bytes;
+
+		texture_encoding encoding = texture_encoding::rgba8;
+
+		switch (m_create_info.compression)
+		{
+			case texture_compression::bc1:
+				encoding = texture_encoding::bc1;
+				break;
+			case texture_compression::bc7:
+				encoding = texture_encoding::bc7;
+				break;
+			case texture_compression::automatic:
+				encoding = is_opaque(*texture) ? texture_encoding::bc1 : texture_encoding::bc7;
+				break;
+			default:
+				break;
+		}
+
+		f64 encode_seconds = 0.0;
+		u64 encoded_bytes  = 0;
+
+		if (encoding != texture_encoding::rgba8)
+		{
+			start          = clock::now();
+			*texture       = compress_texture(*texture, encoding);
+			encode_seconds = std::chrono::duration<f64>(clock::now() - start).count();
+			encoded_bytes  = texture->bytes.size();
+		}
+
+		record.format = details::get_texture_format(encoding, m_create_info.srgb);
+		record.data   = std::move(*texture);
+		record.bytes  = record.data.bytes;
+
+		{
+			std::lock_guard const lock(m_statistics_mutex);
+			m_statistics.decoded_bytes += decoded_bytes;
+			m_statistics.decode_seconds += decode_seconds;
+			m_statistics.mip_bytes += mip_bytes;
+			m_statistics.mip_seconds += mip_seconds;
+			m_statistics.encoded_bytes += encoded_bytes;
+			m_statistics.encode_seconds += encode_seconds;
+		}
+
+		record.state.store(load_state::ready, std::memory_order_release);
+	}
+
+	void texture_streamer::load_packed_texture(texture_record& record)
+	{
+		const std::string name                 = record.path.generic_string();
+		const clock::time_point start          = clock::now();
+		const std::optional<asset_entry> entry = record.p_pack->find(name);
+
+		if (!entry.has_value() || entry->kind != asset_pack_format::entry_kind::texture)
+		{
+			cc_log_warning(log_source::renderer, "Asset pack {} holds no texture {}.", record.p_pack->get_path().string(), name);
+			record.state.store(load_state::failed, std::memory_order_release);
+			return;
+		}
+
+		std::span<const u8> payload = entry->stored;
+
+		if (entry->is_compressed())
+		{
+			record.data.bytes.resize(entry->size);
+
+			if (!record.p_pack->read(*entry, record.data.bytes))
+			{
+				cc_log_warning(log_source::renderer, "Failed to decompress texture {}.", name);
+				record.state.store(load_state::failed, std::memory_order_release);
+				return;
+			}
+
+			payload = record.data.bytes;
+		}
+
+		texture_data layout;
+		b8 srgb = false;
+
+		if (!parse_texture(payload, layout, srgb) || layout.levels.size() != get_mip_count(layout.levels[0].width, layout.levels[0].height))
+		{
+			cc_log_warning(log_source::renderer, "Texture {} in the asset pack is corrupt or lacks a full mip chain.", name);
+			record.state.store(load_state::failed, std::memory_order_release);
+			return;
+		}
+
+		if (layout.encoding != texture_encoding::rgba8 && !m_bc_supported)
+		{
+			cc_log_warning(log_source::renderer, "Texture {} was baked block-compressed, which the device cannot sample.", name);
+			record.state.store(load_state::failed, std::memory_order_release);
+			return;
+		}
+
+		// Level offsets are relative to the payload, which stays where it is: in the mapping, or in the decompressed copy.
+		record.format        = details::get_texture_format(layout.encoding, srgb);
+		record.data.encoding = layout.encoding;
+		record.data.levels   = std::move(layout.levels);
+		record.bytes         = payload;
+
+		const f64 unpack_seconds = std::chrono::duration<f64>(clock::now() - start).count();
+
+		{
+			std::lock_guard const lock(m_statistics_mutex);
+			m_statistics.unpacked_bytes += entry->size;
+			m_statistics.unpack_seconds += unpack_seconds;
+		}
+
+		record.state.store(load_state::ready, std::memory_order_release);
+	}
+
+	b8 texture_streamer::balance_residency()
+	{
+		scratch_arena const scratch;
+
+		struct candidate
+		{
+			texture_record* p_record = nullptr;
+			f32 loss                 = 0.0F; // Share of the on-screen size lost by dropping the next level.
+		};
+
+		std::pmr::vector<candidate> candidates(scratch.get_resource());
+
+		VkDeviceSize wanted   = 0;
+		VkDeviceSize resident = 0;
+
+		const auto get_loss = [](const texture_record& record) {
+			const texture_level& top = record.data.levels[0];
+			const u32 extent         = std::max(1U, std::max(top.width, top.height) >> (record.wanted_mip + 1));
+			return record.demand / static_cast<f32>(extent);
+		};
+
+		for (const std::unique_ptr<texture_record>& p_record: m_textures)
+		{
+			if (p_record == nullptr || !p_record->counted || p_record->unloading || p_record->state.load(std::memory_order_relaxed) != load_state::ready)
+			{
+				continue;
+			}
+
+			texture_record& record = *p_record;
+
+			if (record.demand > 0.0F)
+			{
+				// The smallest level that still has at least a texel per pixel.
+				const texture_level& top = record.data.levels[0];
+				const f32 ratio          = static_cast<f32>(std::max(top.width, top.height)) / record.demand;
+				record.wanted_mip        = std::min(static_cast<u32>(std::max(0.0F, std::floor(std::log2(ratio)))), record.tail_mip);
+			}
+			else
+			{
+				record.wanted_mip = record.tail_mip;
+			}
+
+			wanted += get_resident_size(record, record.wanted_mip);
+
+			if (record.p_image != nullptr)
+			{
+				resident += get_resident_size(record, record.resident_mip);
+			}
+
+			if (record.wanted_mip < record.tail_mip)
+			{
+				candidates.push_back({ .p_record = &record, .loss = get_loss(record) });
+			}
+		}
+
+		const VkDeviceSize wanted_total = wanted;
+
+		// Cut the textures that lose the least first, one level at a time.
+		const auto compare = [](const candidate& left, const candidate& right) {
+			return left.loss > right.loss;
+		};
+
+		std::make_heap(candidates.begin(), candidates.end(), compare);
+
+		while (wanted > m_create_info.memory_budget && !candidates.empty())
+		{
+			std::pop_heap(candidates.begin(), candidates.end(), compare);
+			texture_record& record = *candidates.back().p_record;
+			candidates.pop_back();
+
+			wanted -= get_resident_size(record, record.wanted_mip) - get_resident_size(record, record.wanted_mip + 1);
+			record.wanted_mip += 1;
+
+			if (record.wanted_mip < record.tail_mip)
+			{
+				candidates.push_back({ .p_record = &record, .loss = get_loss(record) });
+				std::push_heap(candidates.begin(), candidates.end(), compare);
+			}
+		}
+
+		for (const std::unique_ptr<texture_record>& p_record: m_textures)
+		{
+			if (p_record != nullptr)
+			{
+				const b8 wants_less         = p_record->p_image != nullptr && p_record->wanted_mip > p_record->resident_mip;
+				p_record->stream_out_frames = wants_less ? p_record->stream_out_frames + 1 : 0;
+				p_record->demand            = 0.0F;
+			}
+		}
+
+		{
+			std::lock_guard const lock(m_statistics_mutex);
+			m_statistics.resident_bytes = resident;
+			m_statistics.wanted_bytes   = wanted_total;
+		}
+
+		return resident > m_create_info.memory_budget;
+	}
+
+	void texture_streamer::start_transition(const graphics_frame& frame, texture_record& record)
+	{
+		const u32 mip         = record.wanted_mip;
+		const u32 level_count = record.level_count - mip;
+
+		constexpr VkImageUsageFlags sampled_usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+		if (record.p_image != nullptr && mip > record.resident_mip)
+		{
+			// Everything still wanted is already on the GPU.
+			transition& pending = record.pending.emplace();
+			pending.kind        = transition_kind::copy;
+			pending.mip         = mip;
+			pending.p_image     = create_image(record, mip, level_count, sampled_usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+			record_copy(frame.command_buffer, *record.p_image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mip - record.resident_mip, *pending.p_image);
+			finish_transition(frame, record);
+
+			std::lock_guard const lock(m_statistics_mutex);
+			m_statistics.streamed_out += 1;
+			return;
+		}
+
+		transition& pending = record.pending.emplace();
+		pending.mip         = mip;
+		pending.bytes       = get_staging_size(record);
+
+		if (record.data.levels.size() < record.level_count)
+		{
+			// Only level 0 is kept on the host, so every stream-in blits the whole chain and copies out the wanted part.
+			pending.kind     = transition_kind::blit;
+			pending.p_source = create_image(record, 0, record.level_count, sampled_usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+			if (mip == 0)
+			{
+				pending.p_image = std::move(pending.p_source);
+			}
+			else
+			{
+				pending.p_image = create_image(record, mip, level_count, sampled_usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+			}
+		}
+		else
+		{
+			pending.kind    = transition_kind::upload;
+			pending.p_image = create_image(record, mip, level_count, sampled_usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+		}
+
+		if (m_uploads_in_flight++ == 0)
+		{
+			m_upload_start = clock::now();
+		}
+
+		// Safe with or without a transfer queue of its own, on a shared queue the upload service leaves submitting to flush() on the frame thread.
+		texture_record* p_record = &record;
+		m_job_system->run([this, p_record] { stage_upload(*p_record); }, &record.staging);
+
+		std::lock_guard const lock(m_statistics_mutex);
+		m_statistics.streamed_in += 1;
+	}
+
+	void texture_streamer::stage_upload(texture_record& record)
+	{
+		transition& pending      = *record.pending;
+		const texture_data& data = record.data;
+
+		// Blits start from level 0, which is all the host keeps in that mode.
+		const u32 first_level  = pending.kind == transition_kind::blit ? 0 : pending.mip;
+		const auto last_level  = static_cast<u32>(data.levels.size());
+		const std::size_t base = data.levels[first_level].offset;
+
+		scratch_arena const scratch;
+		std::pmr::vector<VkBufferImageCopy> regions(scratch.get_resource());
+
+		for (u32 level = first_level; level < last_level; level++)
+		{
+			VkBufferImageCopy region = {};
+			region.bufferOffset      = data.levels[level].offset - base;
+			region.imageSubresource  = { VK_IMAGE_ASPECT_COLOR_BIT, level - first_level, 0, 1 };
+			region.imageExtent       = { data.levels[level].width, data.levels[level].height, 1 };
+
+			regions.push_back(region);
+		}
+
+		const b8 blit                    = pending.kind == transition_kind::blit;
+		const vk::gpu_image& destination = blit && pending.p_source != nullptr ? *pending.p_source : *pending.p_image;
+		const VkImageLayout final_layout = blit ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		pending.token = m_upload_service->upload_image(destination, record.bytes.data() + base, pending.bytes, regions, final_layout);
+	}
+
+	void texture_streamer::finish_transition(const graphics_frame& frame, texture_record& record)
+	{
+		transition& pending = *record.pending;
+
+		if (pending.kind != transition_kind::copy)
+		{
+			// begin_frame() only acquired what had completed by then.
+			m_context->wait_for_upload(frame, pending.token);
+			end_upload(pending.bytes);
+		}
+
+		if (pending.kind == transition_kind::blit)
+		{
+			const vk::gpu_image& chain = pending.p_source != nullptr ? *pending.p_source : *pending.p_image;
+
+			record_blits(frame.command_buffer, record, chain, pending.p_source != nullptr ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+			if (pending.p_source != nullptr)
+			{
+				record_copy(frame.command_buffer, *pending.p_source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, pending.mip, *pending.p_image);
+				m_retired.push_back({ .p_image = std::move(pending.p_source), .frame_number = frame.frame_number });
+			}
+		}
+
+		retire(record, frame.frame_number);
+
+		VkImageViewCreateInfo view_create_info = {};
+		view_create_info.sType                 = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		view_create_info.image                 = pending.p_image->get_handle();
+		view_create_info.viewType              = VK_IMAGE_VIEW_TYPE_2D;
+		view_create_info.format                = record.format;
+		view_create_info.subresourceRange      = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+
+		vk::vk_ensure(m_device->get_dispatch().vkCreateImageView(*m_device, &view_create_info, m_device->get_allocation_callbacks(), &record.view), "Failed to create texture image view!");
+
+		// The old view stays alive for frames_in_flight frames through m_retired, as the heap requires.
+		if (m_bindless_heap != nullptr)
+		{
+			if (record.bindless == vk::invalid_bindless_index)
+			{
+				record.bindless = m_bindless_heap->add_texture(record.view);
+			}
+			else
+			{
+				m_bindless_heap->update_texture(record.bindless, record.view);
+			}
+		}
+
+		record.p_image      = std::move(pending.p_image);
+		record.resident_mip = pending.mip;
+		record.pending.reset();
+	}
+
+	void texture_streamer::record_blits(VkCommandBuffer command_buffer, const texture_record& record, const vk::gpu_image& image, VkImageLayout final_layout) const
+	{
+		const vk::device_dispatch& dispatch = m_device->get_dispatch();
+
+		const VkExtent3D& extent = image.get_extent();
+
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image                = image.get_handle();
+
+		// The upload left every level in TRANSFER_SRC, each level below 0 is written from the one above it.
+		for (u32 level = 1; level < record.level_count; level++)
+		{
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+			barrier.srcAccessMask    = 0;
+			barrier.dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+			dispatch.vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			const VkExtent3D source      = details::get_level_extent(extent, level - 1);
+			const VkExtent3D destination = details::get_level_extent(extent, level);
+
+			VkImageBlit blit    = {};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+			blit.srcOffsets[1]  = { static_cast<i32>(source.width), static_cast<i32>(source.height), 1 };
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+			blit.dstOffsets[1]  = { static_cast<i32>(destination.width), static_cast<i32>(destination.height), 1 };
+
+			dispatch.vkCmdBlitImage(command_buffer, image.get_handle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image.get_handle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+			dispatch.vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+		if (final_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+		{
+			return;
+		}
+
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, record.level_count, 0, 1 };
+		barrier.srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask    = VK_ACCESS_SHADER_READ_BIT;
+		barrier.oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout        = final_layout;
+
+		dispatch.vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	void texture_streamer::record_copy(VkCommandBuffer command_buffer, const vk::gpu_image& source, VkImageLayout source_layout, u32 first_level, const vk::gpu_image& destination) const
+	{
+		const vk::device_dispatch& dispatch = m_device->get_dispatch();
+
+		const u32 level_count = destination.get_mip_levels();
+
+		std::array<VkImageMemoryBarrier, 2> barriers = {};
+
+		barriers[0].sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barriers[0].srcAccessMask       = VK_ACCESS_MEMORY_WRITE_BIT;
+		barriers[0].dstAccessMask       = VK_ACCESS_TRANSFER_READ_BIT;
+		barriers[0].oldLayout           = source_layout;
+		barriers[0].newLayout           = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[0].image               = source.get_handle();
+		barriers[0].subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, first_level, level_count, 0, 1 };
+
+		barriers[1].sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barriers[1].srcAccessMask       = 0;
+		barriers[1].dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[1].oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+		barriers[1].newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[1].image               = destination.get_handle();
+		barriers[1].subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, level_count, 0, 1 };
+
+		// The source may still be sampled by earlier frames on the same queue.
+		dispatch.vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<u32>(barriers.size()), barriers.data());
+
+		scratch_arena const scratch;
+		std::pmr::vector<VkImageCopy> copies(scratch.get_resource());
+
+		for (u32 level = 0; level < level_count; level++)
+		{
+			VkImageCopy copy    = {};
+			copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, first_level + level, 0, 1 };
+			copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+			copy.extent         = details::get_level_extent(destination.get_extent(), level);
+
+			copies.push_back(copy);
+		}
+
+		dispatch.vkCmdCopyImage(command_buffer, source.get_handle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, destination.get_handle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<u32>(copies.size()), copies.data());
+
+		barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barriers[1].oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[1].newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		dispatch.vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barriers[1]);
+	}
+
+	void texture_streamer::end_upload(VkDeviceSize bytes)
+	{
+		std::lock_guard const lock(m_statistics_mutex);
+		m_statistics.uploaded_bytes += bytes;
+
+		if (--m_uploads_in_flight == 0)
+		{
+			m_statistics.upload_seconds += std::chrono::duration<f64>(clock::now() - m_upload_start).count();
+		}
+	}
+
+	void texture_streamer::retire(texture_record& record, u64 frame_number)
+	{
+		if (record.p_image == nullptr)
+		{
+			return;
+		}
+
+		m_retired.push_back({ .p_image = std::move(record.p_image), .view = record.view, .frame_number = frame_number });
+
+		record.view         = VK_NULL_HANDLE;
+		record.resident_mip = record.level_count;
+	}
+
+	void texture_streamer::release_retired(u64 frame_number, b8 all)
+	{
+		const u32 frames_in_flight = m_device->get_create_info().frames_in_flight;
+
+		// begin_frame() has waited for every frame at least frames_in_flight behind this one.
+		while (!m_retired.empty() && (all || m_retired.front().frame_number + frames_in_flight <= frame_number))
+		{
+			if (m_retired.front().view != VK_NULL_HANDLE)
+			{
+				m_device->get_dispatch().vkDestroyImageView(*m_device, m_retired.front().view, m_device->get_allocation_callbacks());
+			}
+
+			m_retired.pop_front();
+		}
+	}
+
+	std::shared_ptr<vk::gpu_image> texture_streamer::create_image(const texture_record& record, u32 mip, u32 level_count, VkImageUsageFlags usage) const
+	{
+		const texture_level& top = record.data.levels[0];
+
+		VkImageCreateInfo image_create_info = {};
+		image_create_info.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_create_info.imageType         = VK_IMAGE_TYPE_2D;
+		image_create_info.format            = record.format;
+		image_create_info.extent            = details::get_level_extent({ top.width, top.height, 1 }, mip);
+		image_create_info.mipLevels         = level_count;
+		image_create_info.arrayLayers       = 1;
+		image_create_info.samples           = VK_SAMPLE_COUNT_1_BIT;
+		image_create_info.tiling            = VK_IMAGE_TILING_OPTIMAL;
+		image_create_info.usage             = usage;
+		image_create_info.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+		image_create_info.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		return m_device->get_memory_allocator().lock()->create_image({
+		        .image    = image_create_info,
+		        .category = vk::allocation_category::texture,
+		        .p_name   = "streamed texture",
+		});
+	}
+
+	VkDeviceSize texture_streamer::get_resident_size(const texture_record& record, u32 mip) const
+	{
+		const texture_level& top = record.data.levels[0];
+
+		VkDeviceSize size = 0;
+		for (u32 level = mip; level < record.level_count; level++)
+		{
+			size += get_level_size(record.data.encoding, std::max(1U, top.width >> level), std::max(1U, top.height >> level));
+		}
+
+		return size;
+	}
+
+	VkDeviceSize texture_streamer::get_staging_size(const texture_record& record) const
+	{
+		if (record.p_image != nullptr && record.wanted_mip > record.resident_mip)
+		{
+			return 0;
+		}
+
+		const texture_data& data = record.data;
+		const u32 first_level    = data.levels.size() < record.level_count ? 0 : record.wanted_mip;
+
+		return data.levels.back().offset + data.levels.back().size - data.levels[first_level].offset;
+	}
+
+	texture_streamer::texture_record* texture_streamer::find(texture_handle texture) const
+	{
+		return texture < m_textures.size() ? m_textures[texture].get() : nullptr;
+	}
+} // namespace cc
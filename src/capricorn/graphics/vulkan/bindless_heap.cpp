@@ -0,0 +1,356 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/vulkan/bindless_heap.hpp"
+
+#include "capricorn/base/log.hpp"
+#include "capricorn/graphics/vulkan/vulkan_utils.hpp"
+
+namespace cc::vk
+{
+	bindless_heap::bindless_heap(const bindless_heap_create_info& create_info) // NOLINT(modernize-pass-by-value)
+	    : m_create_info(create_info),
+	      m_device(create_info.p_device.lock())
+	{
+		ensure(m_device != nullptr, "Bindless heap requires a logical device!");
+		ensure(m_device->has_descriptor_indexing(), "Bindless heap requires descriptor indexing!");
+
+		const VkDevice device                               = *m_device;
+		const device_dispatch& dispatch                     = m_device->get_dispatch();
+		const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+		const u32 frames_in_flight                          = m_device->get_create_info().frames_in_flight;
+		ensure(frames_in_flight > 0 && frames_in_flight <= 32, "Bindless heap tracks at most 32 frames in flight!");
+
+		// A combined image sampler counts against both the sampler and the sampled image limits.
+		const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& limits = m_device->get_descriptor_indexing_properties();
+
+		const u32 resources = std::min(limits.maxPerStageUpdateAfterBindResources, limits.maxUpdateAfterBindDescriptorsInAllPools / frames_in_flight);
+
+		m_buffers.limit  = std::min({ m_create_info.max_buffers, limits.maxDescriptorSetUpdateAfterBindStorageBuffers, limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers, resources / 2 });
+		m_textures.limit = std::min({ m_create_info.max_textures,
+		                              limits.maxDescriptorSetUpdateAfterBindSampledImages,
+		                              limits.maxDescriptorSetUpdateAfterBindSamplers,
+		                              limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		                              limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+		                              resources - m_buffers.limit });
+
+		ensure(m_textures.limit > 0 && m_buffers.limit > 0, "Device allows no update-after-bind descriptors!");
+
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+		bindings[texture_binding].binding                    = texture_binding;
+		bindings[texture_binding].descriptorType             = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[texture_binding].descriptorCount            = m_textures.limit;
+		bindings[texture_binding].stageFlags                 = VK_SHADER_STAGE_ALL;
+		bindings[buffer_binding].binding                     = buffer_binding;
+		bindings[buffer_binding].descriptorType              = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[buffer_binding].descriptorCount             = m_buffers.limit;
+		bindings[buffer_binding].stageFlags                  = VK_SHADER_STAGE_ALL;
+
+		// Update-after-bind lets write() change the current frame's set after it was bound, partially bound lets entries
+		// stay unwritten or point at destroyed resources as long as no shader reaches them.
+		constexpr VkDescriptorBindingFlagsEXT binding_flags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+
+		std::array<VkDescriptorBindingFlagsEXT, 2> const flags = { binding_flags, binding_flags };
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_create_info = {};
+		binding_flags_create_info.sType                                          = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		binding_flags_create_info.bindingCount                                   = static_cast<u32>(flags.size());
+		binding_flags_create_info.pBindingFlags                                  = flags.data();
+
+		VkDescriptorSetLayoutCreateInfo set_layout_create_info = {};
+		set_layout_create_info.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		set_layout_create_info.pNext                           = &binding_flags_create_info;
+		set_layout_create_info.flags                           = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+		set_layout_create_info.bindingCount                    = static_cast<u32>(bindings.size());
+		set_layout_create_info.pBindings                       = bindings.data();
+
+		vk_ensure(dispatch.vkCreateDescriptorSetLayout(device, &set_layout_create_info, p_allocation_callbacks, &m_set_layout), "Failed to create bindless descriptor set layout!");
+
+		VkPushConstantRange push_constant_range = {};
+		push_constant_range.stageFlags          = VK_SHADER_STAGE_ALL;
+		push_constant_range.offset              = 0;
+		push_constant_range.size                = std::min(m_create_info.push_constant_size, m_device->get_properties().limits.maxPushConstantsSize);
+
+		VkPipelineLayoutCreateInfo pipeline_layout_create_info = {};
+		pipeline_layout_create_info.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipeline_layout_create_info.setLayoutCount             = 1;
+		pipeline_layout_create_info.pSetLayouts                = &m_set_layout;
+		pipeline_layout_create_info.pushConstantRangeCount     = push_constant_range.size > 0 ? 1 : 0;
+		pipeline_layout_create_info.pPushConstantRanges        = &push_constant_range;
+
+		vk_ensure(dispatch.vkCreatePipelineLayout(device, &pipeline_layout_create_info, p_allocation_callbacks, &m_pipeline_layout), "Failed to create bindless pipeline layout!");
+
+		std::array<VkDescriptorPoolSize, 2> const pool_sizes = { {
+		        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_textures.limit * frames_in_flight },
+		        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_buffers.limit * frames_in_flight },
+		} };
+
+		VkDescriptorPoolCreateInfo pool_create_info = {};
+		pool_create_info.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		pool_create_info.flags                      = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+		pool_create_info.maxSets                    = frames_in_flight;
+		pool_create_info.poolSizeCount              = static_cast<u32>(pool_sizes.size());
+		pool_create_info.pPoolSizes                 = pool_sizes.data();
+
+		vk_ensure(dispatch.vkCreateDescriptorPool(device, &pool_create_info, p_allocation_callbacks, &m_descriptor_pool), "Failed to create bindless descriptor pool!");
+
+		const std::vector<VkDescriptorSetLayout> set_layouts(frames_in_flight, m_set_layout);
+
+		VkDescriptorSetAllocateInfo allocate_info = {};
+		allocate_info.sType                       = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocate_info.descriptorPool              = m_descriptor_pool;
+		allocate_info.descriptorSetCount          = frames_in_flight;
+		allocate_info.pSetLayouts                 = set_layouts.data();
+
+		m_sets.resize(frames_in_flight);
+		vk_ensure(dispatch.vkAllocateDescriptorSets(device, &allocate_info, m_sets.data()), "Failed to allocate bindless descriptor sets!");
+
+		VkSamplerCreateInfo sampler_create_info = {};
+		sampler_create_info.sType               = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		sampler_create_info.magFilter           = VK_FILTER_LINEAR;
+		sampler_create_info.minFilter           = VK_FILTER_LINEAR;
+		sampler_create_info.mipmapMode          = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		sampler_create_info.addressModeU        = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		sampler_create_info.addressModeV        = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		sampler_create_info.addressModeW        = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		sampler_create_info.maxLod              = VK_LOD_CLAMP_NONE;
+
+		vk_ensure(dispatch.vkCreateSampler(device, &sampler_create_info, p_allocation_callbacks, &m_default_sampler), "Failed to create bindless default sampler!");
+
+		m_statistics.texture_limit = m_textures.limit;
+		m_statistics.buffer_limit  = m_buffers.limit;
+
+		log::info(log_source::renderer, "Bindless heap created with room for {} textures and {} buffers.", m_textures.limit, m_buffers.limit);
+	}
+
+	bindless_heap::~bindless_heap()
+	{
+		if (m_device == nullptr)
+		{
+			return;
+		}
+
+		const VkDevice device                               = *m_device;
+		const device_dispatch& dispatch                     = m_device->get_dispatch();
+		const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+
+		// Frames in flight may still read the sets.
+		dispatch.vkDeviceWaitIdle(device);
+
+		dispatch.vkDestroySampler(device, m_default_sampler, p_allocation_callbacks);
+		dispatch.vkDestroyDescriptorPool(device, m_descriptor_pool, p_allocation_callbacks);
+		dispatch.vkDestroyPipelineLayout(device, m_pipeline_layout, p_allocation_callbacks);
+		dispatch.vkDestroyDescriptorSetLayout(device, m_set_layout, p_allocation_callbacks);
+	}
+
+	std::shared_ptr<bindless_heap> bindless_heap::create(const bindless_heap_create_info& create_info)
+	{
+		return std::make_shared<bindless_heap>(create_info);
+	}
+
+	void bindless_heap::begin_frame(u32 frame_index, u64 frame_number)
+	{
+		m_frame_index  = frame_index;
+		m_frame_number = frame_number;
+		m_frame_begun  = true;
+
+		const u32 slot = 1U << frame_index;
+		u32 written    = 0;
+
+		for (pending_write& entry: m_pending)
+		{
+			if ((entry.slots & slot) != 0)
+			{
+				write_set(m_sets[frame_index], entry);
+				entry.slots &= ~slot;
+				written++;
+			}
+		}
+
+		std::erase_if(m_pending, [](const pending_write& entry) { return entry.slots == 0; });
+
+		const u32 frames_in_flight = static_cast<u32>(m_sets.size());
+
+		// Every frame that could still have read a released index has finished once its slot comes around again.
+		for (index_pool* p_pool: { &m_textures, &m_buffers })
+		{
+			while (!p_pool->released.empty() && p_pool->released.front().second + frames_in_flight <= frame_number)
+			{
+				p_pool->free.push_back(p_pool->released.front().first);
+				p_pool->released.pop_front();
+			}
+		}
+
+		std::lock_guard const lock(m_statistics_mutex);
+		m_statistics.writes += written;
+		m_statistics.pending_writes = static_cast<u32>(m_pending.size());
+	}
+
+	bindless_index bindless_heap::add_texture(VkImageView image_view, VkSampler sampler, VkImageLayout layout)
+	{
+		const bindless_index index = allocate(m_textures);
+		update_texture(index, image_view, sampler, layout);
+
+		return index;
+	}
+
+	void bindless_heap::update_texture(bindless_index index, VkImageView image_view, VkSampler sampler, VkImageLayout layout)
+	{
+		ensure(index < m_textures.next, "Updating a bindless texture that was never added!");
+
+		write({
+		        .binding = texture_binding,
+		        .index   = index,
+		        .image   = { sampler != VK_NULL_HANDLE ? sampler : m_default_sampler, image_view, layout },
+		});
+	}
+
+	void bindless_heap::remove_texture(bindless_index index)
+	{
+		release(m_textures, index);
+	}
+
+	bindless_index bindless_heap::add_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		const bindless_index index = allocate(m_buffers);
+		update_buffer(index, buffer, offset, range);
+
+		return index;
+	}
+
+	void bindless_heap::update_buffer(bindless_index index, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		ensure(index < m_buffers.next, "Updating a bindless buffer that was never added!");
+
+		write({
+		        .binding = buffer_binding,
+		        .index   = index,
+		        .buffer  = { buffer, offset, range },
+		});
+	}
+
+	void bindless_heap::remove_buffer(bindless_index index)
+	{
+		release(m_buffers, index);
+	}
+
+	void bindless_heap::bind(VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point) const
+	{
+		m_device->get_dispatch().vkCmdBindDescriptorSets(command_buffer, bind_point, m_pipeline_layout, 0, 1, &m_sets[m_frame_index], 0, nullptr);
+	}
+
+	VkDescriptorSetLayout bindless_heap::get_set_layout() const noexcept
+	{
+		return m_set_layout;
+	}
+
+	VkPipelineLayout bindless_heap::get_pipeline_layout() const noexcept
+	{
+		return m_pipeline_layout;
+	}
+
+	VkDescriptorSet bindless_heap::get_set() const noexcept
+	{
+		return m_sets[m_frame_index];
+	}
+
+	bindless_heap_statistics bindless_heap::get_statistics() const
+	{
+		std::lock_guard const lock(m_statistics_mutex);
+		return m_statistics;
+	}
+
+	bindless_index bindless_heap::allocate(index_pool& pool)
+	{
+		bindless_index index = invalid_bindless_index;
+
+		if (!pool.free.empty())
+		{
+			index = pool.free.back();
+			pool.free.pop_back();
+		}
+		else
+		{
+			ensure(pool.next < pool.limit, "Bindless heap is full, raise its limits!");
+			index = pool.next++;
+		}
+
+		pool.used++;
+
+		std::lock_guard const lock(m_statistics_mutex);
+		m_statistics.textures     = m_textures.used;
+		m_statistics.buffers      = m_buffers.used;
+		m_statistics.texture_peak = m_textures.next;
+		m_statistics.buffer_peak  = m_buffers.next;
+
+		return index;
+	}
+
+	void bindless_heap::release(index_pool& pool, bindless_index index)
+	{
+		ensure(index < pool.next, "Releasing a bindless index that was never handed out!");
+
+		const u32 binding = &pool == &m_textures ? texture_binding : buffer_binding;
+
+		// The descriptor keeps pointing at the resource, which is fine for partially bound entries no shader reaches,
+		// but a write still waiting for its slot would name a resource the caller is about to destroy.
+		std::erase_if(m_pending, [binding, index](const pending_write& entry) { return entry.binding == binding && entry.index == index; });
+
+		pool.released.emplace_back(index, m_frame_number);
+		pool.used--;
+
+		std::lock_guard const lock(m_statistics_mutex);
+		m_statistics.textures       = m_textures.used;
+		m_statistics.buffers        = m_buffers.used;
+		m_statistics.pending_writes = static_cast<u32>(m_pending.size());
+	}
+
+	void bindless_heap::write(pending_write entry)
+	{
+		// A newer write of the same entry supersedes the ones still waiting for their slot.
+		std::erase_if(m_pending, [&entry](const pending_write& pending) { return pending.binding == entry.binding && pending.index == entry.index; });
+
+		entry.slots = static_cast<u32>((1ULL << m_sets.size()) - 1);
+		u32 written = 0;
+
+		// The current frame has not been submitted yet, so its set may change even after it was bound.
+		if (m_frame_begun)
+		{
+			write_set(m_sets[m_frame_index], entry);
+			entry.slots &= ~(1U << m_frame_index);
+			written++;
+		}
+
+		if (entry.slots != 0)
+		{
+			m_pending.push_back(entry);
+		}
+
+		std::lock_guard const lock(m_statistics_mutex);
+		m_statistics.writes += written;
+		m_statistics.pending_writes = static_cast<u32>(m_pending.size());
+	}
+
+	void bindless_heap::write_set(VkDescriptorSet set, const pending_write& entry) const
+	{
+		VkWriteDescriptorSet descriptor_write = {};
+		descriptor_write.sType                = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptor_write.dstSet               = set;
+		descriptor_write.dstBinding           = entry.binding;
+		descriptor_write.dstArrayElement      = entry.index;
+		descriptor_write.descriptorCount      = 1;
+
+		if (entry.binding == texture_binding)
+		{
+			descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			descriptor_write.pImageInfo     = &entry.image;
+		}
+		else
+		{
+			descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptor_write.pBufferInfo    = &entry.buffer;
+		}
+
+		m_device->get_dispatch().vkUpdateDescriptorSets(*m_device, 1, &descriptor_write, 0, nullptr);
+	}
+} // namespace cc::vk
@@ -0,0 +1,367 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/vulkan/capability_cache.hpp"
+
+#include "capricorn/base/hash.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+namespace cc::vk
+{
+	namespace details
+	{
+		constexpr std::array<char, 8> capability_cache_magic = { 'C', 'C', 'C', 'A', 'P', 'S', '\r', '\n' };
+		constexpr u32 capability_cache_version               = 1;
+
+		// Guards against absurd counts in a corrupted file before anything is allocated.
+		constexpr u32 capability_cache_max_count = 4096;
+
+		class cache_writer
+		{
+		public:
+			template<typename T>
+			void write(const T& value)
+			{
+				static_assert(std::is_trivially_copyable_v<T>);
+				const auto* p_bytes = reinterpret_cast<const char*>(&value);
+				m_buffer.insert(m_buffer.end(), p_bytes, p_bytes + sizeof(T));
+			}
+
+			void write(const std::string& string)
+			{
+				write(static_cast<u32>(string.size()));
+				m_buffer.insert(m_buffer.end(), string.begin(), string.end());
+			}
+
+			void write(const std::vector<std::string>& strings)
+			{
+				write(static_cast<u32>(strings.size()));
+				for (const auto& string: strings)
+				{
+					write(string);
+				}
+			}
+
+			cc_nodiscard const std::vector<char>& get_buffer() const noexcept
+			{
+				return m_buffer;
+			}
+
+		private:
+			std::vector<char> m_buffer;
+		};
+
+		class cache_reader
+		{
+		public:
+			explicit cache_reader(const std::vector<char>& buffer)
+			    : m_buffer(buffer)
+			{
+			}
+
+			template<typename T>
+			b8 read(T& value)
+			{
+				static_assert(std::is_trivially_copyable_v<T>);
+				if (m_offset + sizeof(T) > m_buffer.size())
+				{
+					return false;
+				}
+
+				std::memcpy(&value, m_buffer.data() + m_offset, sizeof(T));
+				m_offset += sizeof(T);
+				return true;
+			}
+
+			b8 read(std::string& string)
+			{
+				u32 size = 0;
+				if (!read(size) || m_offset + size > m_buffer.size())
+				{
+					return false;
+				}
+
+				string.assign(m_buffer.data() + m_offset, size);
+				m_offset += size;
+				return true;
+			}
+
+			b8 read(std::vector<std::string>& strings)
+			{
+				u32 count = 0;
+				if (!read(count) || count > capability_cache_max_count)
+				{
+					return false;
+				}
+
+				strings.resize(count);
+				for (auto& string: strings)
+				{
+					if (!read(string))
+					{
+						return false;
+					}
+				}
+
+				return true;
+			}
+
+		private:
+			const std::vector<char>& m_buffer;
+			std::size_t m_offset = 0;
+		};
+	} // namespace details
+
+	b8 device_capabilities::matches(const VkPhysicalDeviceProperties& properties) const noexcept
+	{
+		return vendor_id == properties.vendorID && device_id == properties.deviceID && driver_version == properties.driverVersion &&
+		       std::equal(pipeline_cache_uuid.begin(), pipeline_cache_uuid.end(), std::begin(properties.pipelineCacheUUID));
+	}
+
+	capability_cache::capability_cache(const capability_cache_create_info& create_info)
+	    : m_create_info(create_info)
+	{
+		load();
+	}
+
+	std::shared_ptr<capability_cache> capability_cache::create(const capability_cache_create_info& create_info)
+	{
+		return std::make_shared<capability_cache>(create_info);
+	}
+
+	u64 capability_cache::compute_instance_key()
+	{
+		u32 loader_version = VK_API_VERSION_1_0;
+
+		// vkEnumerateInstanceVersion only exists in 1.1 loaders.
+		const auto enumerate_instance_version = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(vkGetInstanceProcAddr(VK_NULL_HANDLE, "vkEnumerateInstanceVersion"));
+		if (enumerate_instance_version != nullptr)
+		{
+			enumerate_instance_version(&loader_version);
+		}
+
+		u64 key = fnv1a(&loader_version, sizeof(loader_version));
+
+		for (const char* p_variable: { "VK_ICD_FILENAMES", "VK_DRIVER_FILES", "VK_ADD_DRIVER_FILES", "VK_LAYER_PATH", "VK_ADD_LAYER_PATH", "VK_INSTANCE_LAYERS" })
+		{
+			const char* p_value = std::getenv(p_variable);
+			if (p_value != nullptr)
+			{
+				key = fnv1a(p_variable, std::strlen(p_variable), key);
+				key = fnv1a(p_value, std::strlen(p_value), key);
+			}
+		}
+
+		return key;
+	}
+
+	const instance_capabilities* capability_cache::find_instance(u64 key)
+	{
+		if (m_instance.has_value() && m_instance->key == key)
+		{
+			++m_statistics.hits;
+			return &m_instance.value();
+		}
+
+		++m_statistics.misses;
+		return nullptr;
+	}
+
+	void capability_cache::store_instance(instance_capabilities capabilities)
+	{
+		m_instance = std::move(capabilities);
+		m_dirty    = true;
+	}
+
+	const device_capabilities* capability_cache::find_device(const VkPhysicalDeviceProperties& properties)
+	{
+		for (const auto& device: m_devices)
+		{
+			if (device.matches(properties))
+			{
+				++m_statistics.hits;
+				return &device;
+			}
+		}
+
+		++m_statistics.misses;
+		return nullptr;
+	}
+
+	void capability_cache::store_device(device_capabilities capabilities)
+	{
+		// A device that no longer matches is stale, drop its old entry instead of letting entries pile up.
+		std::erase_if(m_devices, [&capabilities](const device_capabilities& device) {
+			return device.vendor_id == capabilities.vendor_id && device.device_id == capabilities.device_id;
+		});
+
+		m_devices.push_back(std::move(capabilities));
+		m_dirty = true;
+	}
+
+	void capability_cache::invalidate()
+	{
+		m_instance.reset();
+		m_devices.clear();
+		m_dirty = true;
+	}
+
+	void capability_cache::save()
+	{
+		if (!m_dirty || m_create_info.p_path == nullptr)
+		{
+			return;
+		}
+
+		details::cache_writer writer;
+		writer.write(details::capability_cache_magic);
+		writer.write(details::capability_cache_version);
+
+		writer.write(static_cast<u8>(m_instance.has_value()));
+		if (m_instance.has_value())
+		{
+			writer.write(m_instance->key);
+			writer.write(m_instance->layers);
+			writer.write(m_instance->extensions);
+		}
+
+		writer.write(static_cast<u32>(m_devices.size()));
+		for (const auto& device: m_devices)
+		{
+			writer.write(device.vendor_id);
+			writer.write(device.device_id);
+			writer.write(device.driver_version);
+			writer.write(device.pipeline_cache_uuid);
+
+			writer.write(static_cast<u32>(device.queue_families.size()));
+			for (const auto& queue_family: device.queue_families)
+			{
+				writer.write(queue_family);
+			}
+
+			writer.write(device.extensions);
+		}
+
+		const std::filesystem::path path           = m_create_info.p_path;
+		const std::filesystem::path temporary_path = path.string() + ".tmp";
+
+		{
+			std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+			file.write(writer.get_buffer().data(), static_cast<std::streamsize>(writer.get_buffer().size()));
+
+			if (!file)
+			{
+				log::warning(log_source::renderer, "Failed to write capability cache {}.", temporary_path.string());
+				return;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporary_path, path, error);
+
+		if (error)
+		{
+			log::warning(log_source::renderer, "Failed to replace capability cache {}: {}.", path.string(), error.message());
+			return;
+		}
+
+		m_dirty = false;
+	}
+
+	capability_cache_statistics capability_cache::get_statistics() const noexcept
+	{
+		return m_statistics;
+	}
+
+	void capability_cache::load()
+	{
+		if (m_create_info.p_path == nullptr)
+		{
+			return;
+		}
+
+		std::ifstream file(m_create_info.p_path, std::ios::binary);
+		if (!file)
+		{
+			return;
+		}
+
+		const std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		details::cache_reader reader(buffer);
+
+		const auto reject = [this](const char* p_reason) {
+			log::warning(log_source::renderer, "Ignoring capability cache {}: {}.", m_create_info.p_path, p_reason);
+			m_instance.reset();
+			m_devices.clear();
+		};
+
+		std::array<char, 8> magic = {};
+		u32 version               = 0;
+
+		if (!reader.read(magic) || magic != details::capability_cache_magic || !reader.read(version) || version != details::capability_cache_version)
+		{
+			reject("unknown format");
+			return;
+		}
+
+		u8 has_instance = 0;
+		if (!reader.read(has_instance))
+		{
+			reject("truncated");
+			return;
+		}
+
+		if (has_instance != 0)
+		{
+			instance_capabilities instance;
+			if (!reader.read(instance.key) || !reader.read(instance.layers) || !reader.read(instance.extensions))
+			{
+				reject("truncated");
+				return;
+			}
+
+			m_instance = std::move(instance);
+		}
+
+		u32 device_count = 0;
+		if (!reader.read(device_count) || device_count > details::capability_cache_max_count)
+		{
+			reject("truncated");
+			return;
+		}
+
+		for (u32 device_index = 0; device_index < device_count; ++device_index)
+		{
+			device_capabilities device;
+			u32 queue_family_count = 0;
+
+			if (!reader.read(device.vendor_id) || !reader.read(device.device_id) || !reader.read(device.driver_version) || !reader.read(device.pipeline_cache_uuid) ||
+			    !reader.read(queue_family_count) || queue_family_count > details::capability_cache_max_count)
+			{
+				reject("truncated");
+				return;
+			}
+
+			device.queue_families.resize(queue_family_count);
+			for (auto& queue_family: device.queue_families)
+			{
+				if (!reader.read(queue_family))
+				{
+					reject("truncated");
+					return;
+				}
+			}
+
+			if (!reader.read(device.extensions))
+			{
+				reject("truncated");
+				return;
+			}
+
+			m_devices.push_back(std::move(device));
+		}
+	}
+} // namespace cc::vk
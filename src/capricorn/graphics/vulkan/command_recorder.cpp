@@ -0,0 +1,203 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/vulkan/command_recorder.hpp"
+
+#include "capricorn/memory/scratch_arena.hpp"
+
+namespace cc::vk
+{
+	command_recorder::command_recorder(const command_recorder_create_info& create_info) // NOLINT(modernize-pass-by-value)
+	    : m_create_info(create_info),
+	      m_device(create_info.p_device.lock()),
+	      m_job_system(create_info.p_job_system.lock())
+	{
+		ensure(m_device != nullptr, "Command recorder requires a logical device!");
+		ensure(m_job_system != nullptr, "Command recorder requires a job system!");
+		ensure(m_create_info.max_recordings_per_frame > 0 && m_create_info.allocation_batch > 0, "Command recorder needs room for at least one recording!");
+
+		const u32 frames_in_flight = m_device->get_create_info().frames_in_flight;
+		m_thread_count             = m_job_system->get_thread_count();
+
+		m_pools = std::vector<thread_pool>(static_cast<std::size_t>(frames_in_flight) * m_thread_count);
+
+		// Transient, and without RESET_COMMAND_BUFFER_BIT: buffers are only ever reset together with their pool.
+		VkCommandPoolCreateInfo pool_create_info = {};
+		pool_create_info.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		pool_create_info.flags                   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		pool_create_info.queueFamilyIndex        = m_device->get_graphics_queue().second;
+
+		for (thread_pool& pool: m_pools)
+		{
+			vk_ensure(m_device->get_dispatch().vkCreateCommandPool(*m_device, &pool_create_info, m_device->get_allocation_callbacks(), &pool.command_pool), "Failed to create recording command pool!");
+		}
+
+		m_recordings = std::make_unique<recording[]>(m_create_info.max_recordings_per_frame);
+	}
+
+	command_recorder::~command_recorder()
+	{
+		if (m_device == nullptr)
+		{
+			return;
+		}
+
+		// Destroying a pool frees its command buffers, which frames in flight may still execute.
+		m_device->get_dispatch().vkDeviceWaitIdle(*m_device);
+
+		for (const thread_pool& pool: m_pools)
+		{
+			m_device->get_dispatch().vkDestroyCommandPool(*m_device, pool.command_pool, m_device->get_allocation_callbacks());
+		}
+	}
+
+	std::shared_ptr<command_recorder> command_recorder::create(const command_recorder_create_info& create_info)
+	{
+		return std::make_shared<command_recorder>(create_info);
+	}
+
+	void command_recorder::begin_frame(u32 frame_index)
+	{
+		ensure(m_recording_count.load(std::memory_order_relaxed) == 0, "Recordings of the previous frame were never executed!");
+
+		m_frame_index = frame_index;
+
+		for (u32 thread = 0; thread < m_thread_count; thread++)
+		{
+			thread_pool& pool = m_pools[static_cast<std::size_t>(frame_index) * m_thread_count + thread];
+
+			if (pool.used != 0)
+			{
+				vk_ensure(m_device->get_dispatch().vkResetCommandPool(*m_device, pool.command_pool, 0), "Failed to reset recording command pool!");
+				pool.used = 0;
+			}
+		}
+	}
+
+	VkCommandBuffer command_recorder::begin(const VkCommandBufferInheritanceInfo& inheritance)
+	{
+		thread_pool& pool = get_thread_pool();
+
+		if (pool.used == pool.command_buffers.size())
+		{
+			const std::size_t first = pool.command_buffers.size();
+			pool.command_buffers.resize(first + m_create_info.allocation_batch);
+
+			VkCommandBufferAllocateInfo allocate_info = {};
+			allocate_info.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocate_info.commandPool                 = pool.command_pool;
+			allocate_info.level                       = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocate_info.commandBufferCount          = m_create_info.allocation_batch;
+
+			vk_ensure(m_device->get_dispatch().vkAllocateCommandBuffers(*m_device, &allocate_info, pool.command_buffers.data() + first), "Failed to allocate recording command buffers!");
+
+			m_allocated.fetch_add(m_create_info.allocation_batch, std::memory_order_relaxed);
+		}
+
+		const VkCommandBuffer command_buffer = pool.command_buffers[pool.used++];
+
+		VkCommandBufferInheritanceInfo inheritance_info = inheritance;
+		inheritance_info.sType                          = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+
+		VkCommandBufferBeginInfo begin_info = {};
+		begin_info.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		begin_info.pInheritanceInfo         = &inheritance_info;
+
+		if (inheritance.renderPass != VK_NULL_HANDLE)
+		{
+			begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		}
+
+		vk_ensure(m_device->get_dispatch().vkBeginCommandBuffer(command_buffer, &begin_info), "Failed to begin recording command buffer!");
+
+		return command_buffer;
+	}
+
+	void command_recorder::submit(VkCommandBuffer command_buffer, u32 order)
+	{
+		vk_ensure(m_device->get_dispatch().vkEndCommandBuffer(command_buffer), "Failed to end recording command buffer!");
+
+		const u32 index = m_recording_count.fetch_add(1, std::memory_order_relaxed);
+		ensure(index < m_create_info.max_recordings_per_frame, "Too many recordings in one frame, raise max_recordings_per_frame!");
+
+		recording& entry     = m_recordings[index];
+		entry.command_buffer = command_buffer;
+		entry.order          = order;
+		entry.ready.store(true, std::memory_order_release);
+	}
+
+	u32 command_recorder::reserve_orders(u32 count)
+	{
+		const u32 first = m_next_order;
+		m_next_order += count;
+		return first;
+	}
+
+	u32 command_recorder::execute(VkCommandBuffer primary)
+	{
+		const u32 count = std::min(m_recording_count.load(std::memory_order_acquire), m_create_info.max_recordings_per_frame);
+
+		scratch_arena const scratch;
+		std::pmr::vector<std::pair<u32, VkCommandBuffer>> ordered(scratch.get_resource());
+		ordered.reserve(count);
+
+		for (u32 index = 0; index < count; index++)
+		{
+			recording& entry = m_recordings[index];
+
+			// Claimed but not yet published means a job is still recording, the caller has to wait for those first.
+			ensure(entry.ready.load(std::memory_order_acquire), "Executing recordings that are still being recorded!");
+
+			ordered.emplace_back(entry.order, entry.command_buffer);
+			entry.ready.store(false, std::memory_order_relaxed);
+		}
+
+		m_recording_count.store(0, std::memory_order_relaxed);
+		m_next_order = 0;
+
+		if (count == 0)
+		{
+			return 0;
+		}
+
+		std::sort(ordered.begin(), ordered.end(), [](const auto& left, const auto& right) {
+			return left.first < right.first;
+		});
+
+		std::pmr::vector<VkCommandBuffer> command_buffers(scratch.get_resource());
+		command_buffers.reserve(count);
+
+		for (const auto& [order, command_buffer]: ordered)
+		{
+			command_buffers.push_back(command_buffer);
+		}
+
+		m_device->get_dispatch().vkCmdExecuteCommands(primary, count, command_buffers.data());
+
+		std::lock_guard const lock(m_statistics_mutex);
+		m_statistics.recorded += count;
+		m_statistics.executed += 1;
+		m_statistics.peak_per_frame = std::max(m_statistics.peak_per_frame, count);
+
+		return count;
+	}
+
+	command_recorder_statistics command_recorder::get_statistics() const
+	{
+		std::lock_guard const lock(m_statistics_mutex);
+
+		command_recorder_statistics statistics = m_statistics;
+		statistics.allocated                   = m_allocated.load(std::memory_order_relaxed);
+
+		return statistics;
+	}
+
+	command_recorder::thread_pool& command_recorder::get_thread_pool()
+	{
+		const u32 thread_index = m_job_system->get_thread_index();
+		ensure(thread_index < m_thread_count, "Only job system threads may record commands!");
+
+		return m_pools[static_cast<std::size_t>(m_frame_index) * m_thread_count + thread_index];
+	}
+} // namespace cc::vk
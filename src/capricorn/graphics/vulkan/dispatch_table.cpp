@@ -0,0 +1,41 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/vulkan/dispatch_table.hpp"
+
+// Expanded inside the load() functions below, which provide resolve and api_version.
+#define cc_vk_load(name)                                 \
+	name = reinterpret_cast<PFN_##name>(resolve(#name)); \
+	ensure(name != nullptr, "Failed to load " #name "!");
+#define cc_vk_load_extension(name) name = reinterpret_cast<PFN_##name>(resolve(#name));
+#define cc_vk_load_promoted(name, suffix, version) name = reinterpret_cast<PFN_##name>(resolve(api_version >= (version) ? #name : #name #suffix));
+
+namespace cc::vk
+{
+	void instance_dispatch::load(VkInstance instance, u32 api_version)
+	{
+		// Besides global functions such as vkCreateInstance, the only one the engine still calls through the linked loader.
+		const auto resolve = [instance](const char* p_name) {
+			return vkGetInstanceProcAddr(instance, p_name);
+		};
+
+		cc_vk_instance_functions(cc_vk_load)
+		cc_vk_instance_extension_functions(cc_vk_load_extension)
+		cc_vk_instance_promoted_functions(cc_vk_load_promoted)
+	}
+
+	void device_dispatch::load(PFN_vkGetDeviceProcAddr get_device_proc_addr, VkDevice device, u32 api_version)
+	{
+		const auto resolve = [get_device_proc_addr, device](const char* p_name) {
+			return get_device_proc_addr(device, p_name);
+		};
+
+		cc_vk_device_functions(cc_vk_load)
+		cc_vk_device_extension_functions(cc_vk_load_extension)
+		cc_vk_device_promoted_functions(cc_vk_load_promoted)
+	}
+} // namespace cc::vk
+
+#undef cc_vk_load
+#undef cc_vk_load_extension
+#undef cc_vk_load_promoted
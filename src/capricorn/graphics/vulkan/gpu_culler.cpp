@@ -0,0 +1,397 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/vulkan/gpu_culler.hpp"
+
+#include "capricorn/base/log.hpp"
+#include "capricorn/base/profiler.hpp"
+#include "capricorn/graphics/vulkan/memory_allocator.hpp"
+#include "capricorn/graphics/vulkan/pipeline_cache.hpp"
+#include "capricorn/graphics/vulkan/vulkan_utils.hpp"
+#include "capricorn/shaders/cull.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+namespace cc::vk
+{
+	namespace details
+	{
+		// The push constants of shaders/cull.comp.
+		struct cull_constants
+		{
+			std::array<glm::vec4, 6> planes = {};
+			u32 count                       = 0;
+		};
+	} // namespace details
+
+	gpu_culler::gpu_culler(const gpu_culler_create_info& create_info) // NOLINT(modernize-pass-by-value)
+	    : m_create_info(create_info),
+	      m_device(create_info.p_device.lock())
+	{
+		ensure(m_device != nullptr, "GPU culler requires a logical device!");
+		ensure(is_supported(*m_device), "GPU culler requires multiDrawIndirect and drawIndirectCount!");
+		ensure(m_create_info.capacity > 0 && m_create_info.capacity <= m_device->get_properties().limits.maxDrawIndirectCount, "GPU culler capacity exceeds maxDrawIndirectCount!");
+
+		const std::shared_ptr<memory_allocator> p_allocator = m_device->get_memory_allocator().lock();
+		ensure(p_allocator != nullptr, "GPU culler requires a memory allocator!");
+
+		const VkDeviceSize capacity = m_create_info.capacity;
+
+		m_bounds = p_allocator->create_buffer({
+		        .size    = capacity * sizeof(glm::vec4),
+		        .usage   = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		        .movable = true,
+		        .p_name  = "culling bounds",
+		});
+
+		m_draws = p_allocator->create_buffer({
+		        .size    = capacity * sizeof(VkDrawIndexedIndirectCommand),
+		        .usage   = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		        .movable = true,
+		        .p_name  = "culling draws",
+		});
+
+		m_visible = p_allocator->create_buffer({
+		        .size    = capacity * sizeof(VkDrawIndexedIndirectCommand),
+		        .usage   = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		        .movable = true,
+		        .p_name  = "culling visible draws",
+		});
+
+		m_counter = p_allocator->create_buffer({
+		        .size    = sizeof(u32),
+		        .usage   = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		        .movable = true,
+		        .p_name  = "culling draw count",
+		});
+
+		m_staging.resize(m_device->get_create_info().frames_in_flight);
+		m_spheres.reserve(m_create_info.capacity);
+		m_commands.reserve(m_create_info.capacity);
+
+		m_first_instance = m_device->get_enabled_features().drawIndirectFirstInstance == VK_TRUE;
+
+		create_descriptors();
+		create_pipeline();
+	}
+
+	gpu_culler::~gpu_culler()
+	{
+		if (m_device == nullptr)
+		{
+			return;
+		}
+
+		const VkDevice device                               = *m_device;
+		const device_dispatch& dispatch                     = m_device->get_dispatch();
+		const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+
+		dispatch.vkDestroyPipeline(device, m_pipeline, p_allocation_callbacks);
+		dispatch.vkDestroyPipelineLayout(device, m_pipeline_layout, p_allocation_callbacks);
+		dispatch.vkDestroyDescriptorPool(device, m_descriptor_pool, p_allocation_callbacks);
+		dispatch.vkDestroyDescriptorSetLayout(device, m_set_layout, p_allocation_callbacks);
+	}
+
+	std::shared_ptr<gpu_culler> gpu_culler::create(const gpu_culler_create_info& create_info)
+	{
+		return std::make_shared<gpu_culler>(create_info);
+	}
+
+	b8 gpu_culler::is_supported(const logical_device& device) noexcept
+	{
+		return device.get_enabled_features().multiDrawIndirect == VK_TRUE && device.has_draw_indirect_count();
+	}
+
+	u32 gpu_culler::add(const gpu_cull_object& object)
+	{
+		ensure(m_spheres.size() < m_create_info.capacity, "GPU culler is full!");
+
+		const auto index = static_cast<u32>(m_spheres.size());
+
+		m_spheres.emplace_back();
+		m_commands.emplace_back();
+		set(index, object);
+
+		return index;
+	}
+
+	void gpu_culler::set(u32 index, const gpu_cull_object& object)
+	{
+		ensure(index < m_spheres.size(), "GPU culler object index out of range!");
+
+		m_spheres[index] = glm::vec4(object.center, object.radius);
+
+		VkDrawIndexedIndirectCommand& command = m_commands[index];
+		command.indexCount                    = object.index_count;
+		command.instanceCount                 = 1;
+		command.firstIndex                    = object.first_index;
+		command.vertexOffset                  = object.vertex_offset;
+		command.firstInstance                 = m_first_instance ? index : 0;
+
+		if (m_dirty_begin == m_dirty_end)
+		{
+			m_dirty_begin = index;
+			m_dirty_end   = index + 1;
+		}
+		else
+		{
+			m_dirty_begin = std::min(m_dirty_begin, index);
+			m_dirty_end   = std::max(m_dirty_end, index + 1);
+		}
+	}
+
+	void gpu_culler::clear() noexcept
+	{
+		m_spheres.clear();
+		m_commands.clear();
+		m_dirty_begin = 0;
+		m_dirty_end   = 0;
+	}
+
+	void gpu_culler::cull(VkCommandBuffer command_buffer, u32 frame_index, const math::frustum& frustum)
+	{
+		cc_profile_zone("gpu_culler::cull");
+
+		const device_dispatch& dispatch = m_device->get_dispatch();
+
+		// The previous frame's dispatch and draw may still be reading what is about to be overwritten.
+		VkMemoryBarrier reuse = {};
+		reuse.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		reuse.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+		reuse.dstAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		dispatch.vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &reuse, 0, nullptr, 0, nullptr);
+
+		// Defragmentation moved the buffers. What was uploaded to the old ones after its copy is not in the new ones, so upload everything again.
+		if (m_bounds->get_handle() != m_uploaded_bounds || m_draws->get_handle() != m_uploaded_draws)
+		{
+			m_uploaded_bounds = m_bounds->get_handle();
+			m_uploaded_draws  = m_draws->get_handle();
+
+			if (!m_spheres.empty())
+			{
+				m_dirty_begin = 0;
+				m_dirty_end   = get_count();
+			}
+		}
+
+		update_descriptors(frame_index);
+		upload(command_buffer, frame_index);
+		dispatch.vkCmdFillBuffer(command_buffer, m_counter->get_handle(), 0, sizeof(u32), 0);
+
+		VkMemoryBarrier transferred = {};
+		transferred.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		transferred.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+		transferred.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		dispatch.vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &transferred, 0, nullptr, 0, nullptr);
+
+		const details::cull_constants constants = { .planes = frustum.planes, .count = get_count() };
+
+		if (constants.count > 0)
+		{
+			dispatch.vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+			dispatch.vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout, 0, 1, &m_sets[frame_index], 0, nullptr);
+			dispatch.vkCmdPushConstants(command_buffer, m_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+			dispatch.vkCmdDispatch(command_buffer, (constants.count + workgroup_size - 1) / workgroup_size, 1, 1);
+		}
+
+		VkMemoryBarrier culled = {};
+		culled.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		culled.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+		culled.dstAccessMask   = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+		dispatch.vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &culled, 0, nullptr, 0, nullptr);
+	}
+
+	void gpu_culler::draw(VkCommandBuffer command_buffer) const
+	{
+		if (m_spheres.empty())
+		{
+			return;
+		}
+
+		m_device->get_dispatch().vkCmdDrawIndexedIndirectCount(command_buffer, m_visible->get_handle(), 0, m_counter->get_handle(), 0, get_count(), sizeof(VkDrawIndexedIndirectCommand));
+	}
+
+	u32 gpu_culler::get_count() const noexcept
+	{
+		return static_cast<u32>(m_spheres.size());
+	}
+
+	u32 gpu_culler::get_capacity() const noexcept
+	{
+		return m_create_info.capacity;
+	}
+
+	void gpu_culler::create_pipeline()
+	{
+		const VkDevice device                               = *m_device;
+		const device_dispatch& dispatch                     = m_device->get_dispatch();
+		const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+
+		const std::shared_ptr<pipeline_cache> p_pipeline_cache = m_device->get_pipeline_cache().lock();
+		ensure(p_pipeline_cache != nullptr, "GPU culler requires a pipeline cache!");
+
+		VkPushConstantRange push_constant_range = {};
+		push_constant_range.stageFlags          = VK_SHADER_STAGE_COMPUTE_BIT;
+		push_constant_range.size                = sizeof(details::cull_constants);
+
+		VkPipelineLayoutCreateInfo layout_create_info = {};
+		layout_create_info.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layout_create_info.setLayoutCount             = 1;
+		layout_create_info.pSetLayouts                = &m_set_layout;
+		layout_create_info.pushConstantRangeCount     = 1;
+		layout_create_info.pPushConstantRanges        = &push_constant_range;
+
+		vk_ensure(dispatch.vkCreatePipelineLayout(device, &layout_create_info, p_allocation_callbacks, &m_pipeline_layout), "Failed to create culling pipeline layout!");
+
+		VkShaderModuleCreateInfo module_create_info = {};
+		module_create_info.sType                    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		module_create_info.codeSize                 = shaders::cull_shader.size() * sizeof(u32);
+		module_create_info.pCode                    = shaders::cull_shader.data();
+
+		VkShaderModule module = VK_NULL_HANDLE;
+		vk_ensure(dispatch.vkCreateShaderModule(device, &module_create_info, p_allocation_callbacks, &module), "Failed to create culling shader module!");
+
+		VkComputePipelineCreateInfo pipeline_create_info = {};
+		pipeline_create_info.sType                       = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeline_create_info.stage.sType                 = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipeline_create_info.stage.stage                 = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipeline_create_info.stage.module                = module;
+		pipeline_create_info.stage.pName                 = "main";
+		pipeline_create_info.layout                      = m_pipeline_layout;
+
+		m_pipeline = p_pipeline_cache->create_compute_pipeline(pipeline_create_info);
+
+		dispatch.vkDestroyShaderModule(device, module, p_allocation_callbacks);
+	}
+
+	void gpu_culler::create_descriptors()
+	{
+		const VkDevice device                               = *m_device;
+		const device_dispatch& dispatch                     = m_device->get_dispatch();
+		const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+
+		const auto frame_count = static_cast<u32>(m_staging.size());
+
+		std::array<VkDescriptorSetLayoutBinding, 4> bindings = {};
+
+		for (u32 binding = 0; binding < bindings.size(); binding++)
+		{
+			bindings[binding].binding         = binding;
+			bindings[binding].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[binding].descriptorCount = 1;
+			bindings[binding].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo set_layout_create_info = {};
+		set_layout_create_info.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		set_layout_create_info.bindingCount                    = static_cast<u32>(bindings.size());
+		set_layout_create_info.pBindings                       = bindings.data();
+
+		vk_ensure(dispatch.vkCreateDescriptorSetLayout(device, &set_layout_create_info, p_allocation_callbacks, &m_set_layout), "Failed to create culling descriptor set layout!");
+
+		VkDescriptorPoolSize const pool_size = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<u32>(bindings.size()) * frame_count };
+
+		VkDescriptorPoolCreateInfo pool_create_info = {};
+		pool_create_info.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		pool_create_info.maxSets                    = frame_count;
+		pool_create_info.poolSizeCount              = 1;
+		pool_create_info.pPoolSizes                 = &pool_size;
+
+		vk_ensure(dispatch.vkCreateDescriptorPool(device, &pool_create_info, p_allocation_callbacks, &m_descriptor_pool), "Failed to create culling descriptor pool!");
+
+		const std::vector<VkDescriptorSetLayout> set_layouts(frame_count, m_set_layout);
+
+		VkDescriptorSetAllocateInfo allocate_info = {};
+		allocate_info.sType                       = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocate_info.descriptorPool              = m_descriptor_pool;
+		allocate_info.descriptorSetCount          = frame_count;
+		allocate_info.pSetLayouts                 = set_layouts.data();
+
+		m_sets.resize(frame_count, VK_NULL_HANDLE);
+		m_set_buffers.resize(frame_count, {});
+
+		vk_ensure(dispatch.vkAllocateDescriptorSets(device, &allocate_info, m_sets.data()), "Failed to allocate culling descriptor sets!");
+	}
+
+	void gpu_culler::update_descriptors(u32 frame_index)
+	{
+		ensure(frame_index < m_sets.size(), "Frame index exceeds the frames in flight!");
+
+		const std::array<VkBuffer, 4> buffers = { m_bounds->get_handle(), m_draws->get_handle(), m_visible->get_handle(), m_counter->get_handle() };
+
+		// Written on the frame's first use and after defragmentation, the frame that last used the set has completed by now.
+		if (m_set_buffers[frame_index] == buffers)
+		{
+			return;
+		}
+
+		std::array<VkDescriptorBufferInfo, buffers.size()> buffer_infos = {};
+		std::array<VkWriteDescriptorSet, buffers.size()> writes         = {};
+
+		for (u32 binding = 0; binding < buffers.size(); binding++)
+		{
+			buffer_infos[binding] = { buffers[binding], 0, VK_WHOLE_SIZE };
+
+			writes[binding].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[binding].dstSet          = m_sets[frame_index];
+			writes[binding].dstBinding      = binding;
+			writes[binding].descriptorCount = 1;
+			writes[binding].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[binding].pBufferInfo     = &buffer_infos[binding];
+		}
+
+		m_device->get_dispatch().vkUpdateDescriptorSets(*m_device, static_cast<u32>(writes.size()), writes.data(), 0, nullptr);
+
+		m_set_buffers[frame_index] = buffers;
+	}
+
+	void gpu_culler::upload(VkCommandBuffer command_buffer, u32 frame_index)
+	{
+		if (m_dirty_begin == m_dirty_end)
+		{
+			return;
+		}
+
+		ensure(frame_index < m_staging.size(), "Frame index exceeds the frames in flight!");
+
+		const VkDeviceSize count         = m_dirty_end - m_dirty_begin;
+		const VkDeviceSize sphere_bytes  = count * sizeof(glm::vec4);
+		const VkDeviceSize command_bytes = count * sizeof(VkDrawIndexedIndirectCommand);
+
+		std::shared_ptr<gpu_buffer>& p_staging = m_staging[frame_index];
+
+		// The frame's fence was waited for before its command buffer was handed out, so its staging buffer is free again.
+		if (p_staging == nullptr || p_staging->get_size() < sphere_bytes + command_bytes)
+		{
+			p_staging = m_device->get_memory_allocator().lock()->create_buffer({
+			        .size     = std::bit_ceil(sphere_bytes + command_bytes),
+			        .usage    = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			        .memory   = memory_usage::upload,
+			        .category = allocation_category::staging,
+			        .p_name   = "culling staging",
+			});
+		}
+
+		auto* p_mapped = static_cast<u8*>(p_staging->get_mapped_data());
+		std::memcpy(p_mapped, m_spheres.data() + m_dirty_begin, sphere_bytes);
+		std::memcpy(p_mapped + sphere_bytes, m_commands.data() + m_dirty_begin, command_bytes);
+
+		m_device->get_memory_allocator().lock()->flush(*p_staging, 0, sphere_bytes + command_bytes);
+
+		const VkBufferCopy sphere_copy  = { 0, m_dirty_begin * sizeof(glm::vec4), sphere_bytes };
+		const VkBufferCopy command_copy = { sphere_bytes, m_dirty_begin * sizeof(VkDrawIndexedIndirectCommand), command_bytes };
+
+		const device_dispatch& dispatch = m_device->get_dispatch();
+		dispatch.vkCmdCopyBuffer(command_buffer, p_staging->get_handle(), m_bounds->get_handle(), 1, &sphere_copy);
+		dispatch.vkCmdCopyBuffer(command_buffer, p_staging->get_handle(), m_draws->get_handle(), 1, &command_copy);
+
+		m_dirty_begin = 0;
+		m_dirty_end   = 0;
+	}
+} // namespace cc::vk
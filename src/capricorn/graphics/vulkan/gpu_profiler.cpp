@@ -0,0 +1,309 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/vulkan/gpu_profiler.hpp"
+
+#include "capricorn/memory/scratch_arena.hpp"
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#endif
+
+namespace cc::vk
+{
+	namespace details
+	{
+		// The clock std::chrono::steady_clock reads, which cc::profiler timestamps come from.
+#ifdef _WIN32
+		constexpr VkTimeDomainEXT host_time_domain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#else
+		constexpr VkTimeDomainEXT host_time_domain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+#endif
+
+		u32 get_timestamp_valid_bits(const instance_dispatch& dispatch, const logical_device& device)
+		{
+			scratch_arena const scratch;
+
+			u32 family_count = 0;
+			dispatch.vkGetPhysicalDeviceQueueFamilyProperties(device.get_physical_device(), &family_count, nullptr);
+
+			std::pmr::vector<VkQueueFamilyProperties> families(family_count, scratch.get_resource());
+			dispatch.vkGetPhysicalDeviceQueueFamilyProperties(device.get_physical_device(), &family_count, families.data());
+
+			return families[device.get_graphics_queue().second].timestampValidBits;
+		}
+	} // namespace details
+
+	gpu_profiler::gpu_profiler(const gpu_profiler_create_info& create_info) // NOLINT(modernize-pass-by-value)
+	    : m_create_info(create_info),
+	      m_device(create_info.p_device.lock())
+	{
+		ensure(m_device != nullptr, "GPU profiler requires a logical device!");
+		ensure(m_create_info.max_zones_per_frame > 0, "GPU profiler needs room for at least one zone!");
+
+		const auto p_instance                               = m_device->get_create_info().instance.lock();
+		const instance_dispatch& instance_functions         = p_instance->get_dispatch();
+		const device_dispatch& dispatch                     = m_device->get_dispatch();
+		const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+		const VkDevice device                               = *m_device;
+
+		const u32 valid_bits = details::get_timestamp_valid_bits(instance_functions, *m_device);
+		ensure(valid_bits != 0, "The graphics queue does not support timestamps!");
+
+		m_timestamp_period = static_cast<f64>(m_device->get_properties().limits.timestampPeriod);
+		m_timestamp_mask   = valid_bits >= 64 ? std::numeric_limits<u64>::max() : (u64 { 1 } << valid_bits) - 1;
+
+		const u32 query_count = m_create_info.max_zones_per_frame * 2;
+
+		VkQueryPoolCreateInfo query_pool_create_info = {};
+		query_pool_create_info.sType                 = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		query_pool_create_info.queryType             = VK_QUERY_TYPE_TIMESTAMP;
+		query_pool_create_info.queryCount            = query_count;
+
+		m_slots = std::vector<frame_slot>(m_device->get_create_info().frames_in_flight);
+
+		for (frame_slot& slot: m_slots)
+		{
+			vk_ensure(dispatch.vkCreateQueryPool(device, &query_pool_create_info, p_allocation_callbacks, &slot.query_pool), "Failed to create timestamp query pool!");
+			slot.sites.resize(m_create_info.max_zones_per_frame);
+		}
+
+		m_results.resize(static_cast<std::size_t>(query_count) * 2);
+
+		if (m_device->is_extension_enabled(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME))
+		{
+			const auto get_time_domains          = instance_functions.vkGetPhysicalDeviceCalibrateableTimeDomainsEXT;
+			const auto get_calibrated_timestamps = dispatch.vkGetCalibratedTimestampsEXT;
+
+			scratch_arena const scratch;
+
+			u32 domain_count = 0;
+			std::pmr::vector<VkTimeDomainEXT> domains(scratch.get_resource());
+
+			if (get_time_domains != nullptr && get_time_domains(m_device->get_physical_device(), &domain_count, nullptr) == VK_SUCCESS)
+			{
+				domains.resize(domain_count);
+				get_time_domains(m_device->get_physical_device(), &domain_count, domains.data());
+			}
+
+			const b8 device_domain = std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != domains.end();
+			const b8 host_domain   = std::find(domains.begin(), domains.end(), details::host_time_domain) != domains.end();
+
+			if (device_domain && host_domain && get_calibrated_timestamps != nullptr)
+			{
+				m_get_calibrated_timestamps = get_calibrated_timestamps;
+				m_host_domain               = details::host_time_domain;
+
+#ifdef _WIN32
+				LARGE_INTEGER frequency = {};
+				QueryPerformanceFrequency(&frequency);
+				m_host_ticks_per_second = frequency.QuadPart;
+#endif
+			}
+		}
+
+		{
+			std::lock_guard const lock(m_statistics_mutex);
+			m_statistics.calibrated = m_get_calibrated_timestamps != nullptr;
+		}
+
+		log::info(log_source::renderer,
+		          "GPU profiler created with {} zones per frame, {} valid timestamp bits, {} ns per tick, {}.",
+		          m_create_info.max_zones_per_frame,
+		          valid_bits,
+		          m_timestamp_period,
+		          m_get_calibrated_timestamps != nullptr ? "calibrated" : "aligned to submissions");
+	}
+
+	gpu_profiler::~gpu_profiler()
+	{
+		if (m_device == nullptr)
+		{
+			return;
+		}
+
+		for (const frame_slot& slot: m_slots)
+		{
+			m_device->get_dispatch().vkDestroyQueryPool(*m_device, slot.query_pool, m_device->get_allocation_callbacks());
+		}
+	}
+
+	std::shared_ptr<gpu_profiler> gpu_profiler::create(const gpu_profiler_create_info& create_info)
+	{
+		return std::make_shared<gpu_profiler>(create_info);
+	}
+
+	b8 gpu_profiler::is_supported(const logical_device& device)
+	{
+		const auto p_instance = device.get_create_info().instance.lock();
+		return details::get_timestamp_valid_bits(p_instance->get_dispatch(), device) != 0;
+	}
+
+	void gpu_profiler::begin_frame(VkCommandBuffer command_buffer, u32 frame_index)
+	{
+		frame_slot& slot = m_slots[frame_index];
+
+		if (slot.submitted)
+		{
+			resolve(slot);
+			slot.submitted = false;
+		}
+
+		// Every query has to be reset before it is written, including those of zones that were never reached.
+		m_device->get_dispatch().vkCmdResetQueryPool(command_buffer, slot.query_pool, 0, m_create_info.max_zones_per_frame * 2);
+
+		m_frame_index = frame_index;
+		m_zone_count.store(0, std::memory_order_relaxed);
+	}
+
+	void gpu_profiler::end_frame()
+	{
+		frame_slot& slot = m_slots[m_frame_index];
+
+		const u32 zone_count = m_zone_count.load(std::memory_order_relaxed);
+
+		slot.zone_count = std::min(zone_count, m_create_info.max_zones_per_frame);
+		slot.submit_ns  = profiler::now();
+		slot.submitted  = true;
+
+		if (zone_count > slot.zone_count)
+		{
+			std::lock_guard const lock(m_statistics_mutex);
+			m_statistics.overflowed += zone_count - slot.zone_count;
+		}
+	}
+
+	gpu_zone gpu_profiler::begin_zone(VkCommandBuffer command_buffer, const profile_zone_site& site)
+	{
+		if (!profiler::is_active())
+		{
+			return invalid_gpu_zone;
+		}
+
+		const gpu_zone zone = m_zone_count.fetch_add(1, std::memory_order_relaxed);
+
+		if (zone >= m_create_info.max_zones_per_frame)
+		{
+			return invalid_gpu_zone;
+		}
+
+		frame_slot& slot = m_slots[m_frame_index];
+		slot.sites[zone] = &site;
+
+		m_device->get_dispatch().vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.query_pool, zone * 2);
+
+		return zone;
+	}
+
+	void gpu_profiler::end_zone(VkCommandBuffer command_buffer, gpu_zone zone)
+	{
+		if (zone == invalid_gpu_zone)
+		{
+			return;
+		}
+
+		m_device->get_dispatch().vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_slots[m_frame_index].query_pool, zone * 2 + 1);
+	}
+
+	gpu_profiler_statistics gpu_profiler::get_statistics() const
+	{
+		std::lock_guard const lock(m_statistics_mutex);
+		return m_statistics;
+	}
+
+	b8 gpu_profiler::calibrate()
+	{
+		std::array<VkCalibratedTimestampInfoEXT, 2> infos = {};
+		infos[0].sType                                    = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+		infos[0].timeDomain                               = VK_TIME_DOMAIN_DEVICE_EXT;
+		infos[1].sType                                    = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+		infos[1].timeDomain                               = m_host_domain;
+
+		std::array<u64, 2> timestamps = {};
+		u64 max_deviation             = 0;
+
+		if (m_get_calibrated_timestamps(*m_device, static_cast<u32>(infos.size()), infos.data(), timestamps.data(), &max_deviation) != VK_SUCCESS)
+		{
+			return false;
+		}
+
+		const auto host_ticks = static_cast<i64>(timestamps[1]);
+
+		m_reference_ticks = timestamps[0];
+		m_reference_ns    = host_ticks / m_host_ticks_per_second * 1'000'000'000 + host_ticks % m_host_ticks_per_second * 1'000'000'000 / m_host_ticks_per_second;
+
+		std::lock_guard const lock(m_statistics_mutex);
+		m_statistics.max_deviation_us = static_cast<f64>(max_deviation) / 1000.0;
+
+		return true;
+	}
+
+	void gpu_profiler::resolve(frame_slot& slot)
+	{
+		if (slot.zone_count == 0)
+		{
+			return;
+		}
+
+		const u32 query_count = slot.zone_count * 2;
+
+		// The slot's fence was waited for, so anything still unavailable was never written.
+		const VkResult result = m_device->get_dispatch().vkGetQueryPoolResults(*m_device,
+		                                                                       slot.query_pool,
+		                                                                       0,
+		                                                                       query_count,
+		                                                                       sizeof(u64) * 2 * query_count,
+		                                                                       m_results.data(),
+		                                                                       sizeof(u64) * 2,
+		                                                                       VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+		if (result != VK_SUCCESS && result != VK_NOT_READY)
+		{
+			log::warning(log_source::renderer, "Failed to read GPU timestamps: {}.", static_cast<i32>(result));
+			return;
+		}
+
+		b8 aligned = m_get_calibrated_timestamps != nullptr && calibrate();
+
+		// The frame zone is the first one, and its work cannot start before the frame was submitted.
+		if (!aligned && m_results[1] != 0)
+		{
+			m_reference_ticks = m_results[0];
+			m_reference_ns    = slot.submit_ns;
+			aligned           = true;
+		}
+
+		u64 resolved    = 0;
+		u64 unavailable = 0;
+
+		for (u32 zone = 0; zone < slot.zone_count; ++zone)
+		{
+			const u64* p_result = m_results.data() + static_cast<std::size_t>(zone) * 4;
+
+			if (!aligned || p_result[1] == 0 || p_result[3] == 0)
+			{
+				++unavailable;
+				continue;
+			}
+
+			profiler::record_gpu(*slot.sites[zone], to_host_ns(p_result[0]), to_host_ns(p_result[2]));
+			++resolved;
+		}
+
+		std::lock_guard const lock(m_statistics_mutex);
+		m_statistics.resolved += resolved;
+		m_statistics.unavailable += unavailable;
+	}
+
+	i64 gpu_profiler::to_host_ns(u64 timestamp) const noexcept
+	{
+		// Timestamps wrap at timestampValidBits, so the distance to the reference is taken modulo that.
+		const u64 distance = (timestamp - m_reference_ticks) & m_timestamp_mask;
+		const i64 ticks    = distance > (m_timestamp_mask >> 1) ? static_cast<i64>(distance - m_timestamp_mask - 1) : static_cast<i64>(distance);
+
+		return m_reference_ns + static_cast<i64>(static_cast<f64>(ticks) * m_timestamp_period);
+	}
+} // namespace cc::vk
@@ -0,0 +1,546 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/vulkan/host_allocator.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace cc::vk
+{
+	namespace
+	{
+		// Precedes every pointer handed to the driver.
+		struct block_header
+		{
+			u64 size;       // As requested, for statistics and the copy on reallocation.
+			u32 offset;     // From the start of the block to the pointer.
+			u8 size_class;  // large_class for blocks from operator new.
+			u8 scope;
+			u16 reserved;
+		};
+
+		static_assert(sizeof(block_header) == 16);
+
+		constexpr u8 large_class = 0xFF;
+
+		// Blocks within 64 byte aligned chunks are aligned to their size up to this, larger alignments take the large path.
+		constexpr std::size_t max_pooled_alignment = 64;
+
+		std::atomic<u64> s_next_allocator_id = 1;
+
+		// The cache of the allocator this thread used last, so the common case skips the lookup.
+		struct thread_cache_memo
+		{
+			u64 allocator_id = 0;
+			void* p_cache    = nullptr;
+		};
+
+		thread_local thread_cache_memo t_memo;
+
+		cc_nodiscard constexpr std::size_t align_up(std::size_t value, std::size_t alignment) noexcept
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
+		// The header needs 16 bytes before the pointer, which is itself aligned to alignment.
+		cc_nodiscard constexpr std::size_t get_header_offset(std::size_t alignment) noexcept
+		{
+			return align_up(sizeof(block_header), alignment);
+		}
+
+		cc_nodiscard constexpr u32 get_size_class(std::size_t bytes) noexcept
+		{
+			return static_cast<u32>(std::countr_zero(std::bit_ceil(std::max(bytes, host_allocator::min_block_size)))) - std::countr_zero(host_allocator::min_block_size);
+		}
+
+		cc_nodiscard constexpr std::size_t get_block_size(u32 size_class) noexcept
+		{
+			return host_allocator::min_block_size << size_class;
+		}
+
+		cc_nodiscard block_header* get_header(void* p_memory) noexcept
+		{
+			return static_cast<block_header*>(p_memory) - 1;
+		}
+	} // namespace
+
+	host_allocator::host_allocator()
+	    : host_allocator(host_allocator_create_info{})
+	{
+	}
+
+	host_allocator::host_allocator(const host_allocator_create_info& create_info) // NOLINT(modernize-pass-by-value)
+	    : m_create_info(create_info), m_id(s_next_allocator_id.fetch_add(1, std::memory_order_relaxed))
+	{
+		ensure(std::has_single_bit(m_create_info.chunk_size) && m_create_info.chunk_size >= max_pooled_size, "Host allocator chunks must be a power of two of at least the largest size class!");
+		ensure(m_create_info.cache_batch_size > 0, "Host allocator thread caches must move at least one block at a time!");
+
+		m_callbacks.pUserData             = this;
+		m_callbacks.pfnAllocation         = &allocation_callback;
+		m_callbacks.pfnReallocation       = &reallocation_callback;
+		m_callbacks.pfnFree               = &free_callback;
+		m_callbacks.pfnInternalAllocation = &internal_allocation_callback;
+		m_callbacks.pfnInternalFree       = &internal_free_callback;
+	}
+
+	host_allocator::~host_allocator()
+	{
+		u64 outstanding = 0;
+		for (const scope_counters& counters: m_scopes)
+		{
+			outstanding += counters.current.load(std::memory_order_relaxed);
+		}
+
+		if (outstanding != 0)
+		{
+			log::warning(log_source::renderer, "Vulkan host allocator destroyed with {} bytes still held by the driver.", outstanding);
+		}
+
+		for (std::byte* p_chunk: m_chunks)
+		{
+			::operator delete(p_chunk, std::align_val_t{ max_pooled_alignment });
+		}
+	}
+
+	std::unique_ptr<host_allocator> host_allocator::create(const host_allocator_create_info& create_info)
+	{
+		return std::make_unique<host_allocator>(create_info);
+	}
+
+	const VkAllocationCallbacks* host_allocator::get_callbacks() const noexcept
+	{
+		return &m_callbacks;
+	}
+
+	void* host_allocator::allocate(std::size_t size, std::size_t alignment, VkSystemAllocationScope scope) noexcept
+	{
+		if (size == 0)
+		{
+			return nullptr;
+		}
+
+		void* p_memory = allocate_block(size, alignment, scope);
+		if (p_memory != nullptr)
+		{
+			count_allocation(scope, size);
+		}
+
+		return p_memory;
+	}
+
+	void* host_allocator::reallocate(void* p_original, std::size_t size, std::size_t alignment, VkSystemAllocationScope scope) noexcept
+	{
+		// Both edge cases are spelled out by the specification of PFN_vkReallocationFunction.
+		if (p_original == nullptr)
+		{
+			return allocate(size, alignment, scope);
+		}
+
+		if (size == 0)
+		{
+			free(p_original);
+			return nullptr;
+		}
+
+		block_header* header      = get_header(p_original);
+		const u64 original_size   = header->size;
+		const auto original_scope = static_cast<VkSystemAllocationScope>(header->scope);
+
+		// Large blocks only know their requested size, which release_block() needs to account for what was reserved, so
+		// they are never reused. Pooled blocks are whenever the new size still fits their size class.
+		const b8 pooled  = header->size_class != large_class;
+		const b8 aligned = reinterpret_cast<std::uintptr_t>(p_original) % std::max(alignment, alignof(block_header)) == 0;
+
+		if (pooled && aligned && size <= get_block_size(header->size_class) - header->offset)
+		{
+			header->size  = size;
+			header->scope = static_cast<u8>(scope);
+
+			count_reallocation(original_scope, original_size, scope, size);
+			m_in_place_reallocs.fetch_add(1, std::memory_order_relaxed);
+
+			return p_original;
+		}
+
+		void* p_memory = allocate_block(size, alignment, scope);
+		if (p_memory == nullptr)
+		{
+			// The original must stay valid when reallocation fails.
+			return nullptr;
+		}
+
+		std::memcpy(p_memory, p_original, std::min<std::size_t>(original_size, size));
+		release_block(p_original);
+
+		count_reallocation(original_scope, original_size, scope, size);
+
+		return p_memory;
+	}
+
+	void host_allocator::free(void* p_memory) noexcept
+	{
+		if (p_memory == nullptr)
+		{
+			return;
+		}
+
+		const block_header* header = get_header(p_memory);
+		count_free(static_cast<VkSystemAllocationScope>(header->scope), header->size);
+
+		release_block(p_memory);
+	}
+
+	host_allocator_statistics host_allocator::get_statistics() const
+	{
+		host_allocator_statistics statistics = {};
+
+		for (u32 index = 0; index < allocation_scope_count; ++index)
+		{
+			const scope_counters& counters = m_scopes[index];
+
+			statistics.scopes[index] = {
+			        .current          = counters.current.load(std::memory_order_relaxed),
+			        .peak             = counters.peak.load(std::memory_order_relaxed),
+			        .allocations      = counters.allocations.load(std::memory_order_relaxed),
+			        .reallocations    = counters.reallocations.load(std::memory_order_relaxed),
+			        .frees            = counters.frees.load(std::memory_order_relaxed),
+			        .internal_current = counters.internal_current.load(std::memory_order_relaxed),
+			        .internal_peak    = counters.internal_peak.load(std::memory_order_relaxed),
+			};
+		}
+
+		statistics.reserved          = m_reserved.load(std::memory_order_relaxed);
+		statistics.large_allocations = m_large_allocations.load(std::memory_order_relaxed);
+		statistics.in_place_reallocs = m_in_place_reallocs.load(std::memory_order_relaxed);
+
+		const std::lock_guard lock(m_mutex);
+		statistics.cache_refills = m_cache_refills;
+		statistics.threads       = static_cast<u32>(m_thread_caches.size());
+
+		return statistics;
+	}
+
+	void host_allocator::log_statistics() const
+	{
+		const host_allocator_statistics statistics = get_statistics();
+
+		for (u32 index = 0; index < allocation_scope_count; ++index)
+		{
+			const host_scope_statistics& scope = statistics.scopes[index];
+
+			if (scope.allocations == 0 && scope.internal_peak == 0)
+			{
+				continue;
+			}
+
+			log::info(log_source::renderer,
+			          "Vulkan host memory [{}]: peak {} bytes, {} bytes outstanding, {} allocations, {} reallocations, {} frees, internal peak {} bytes.",
+			          get_scope_name(static_cast<VkSystemAllocationScope>(index)),
+			          scope.peak,
+			          scope.current,
+			          scope.allocations,
+			          scope.reallocations,
+			          scope.frees,
+			          scope.internal_peak);
+		}
+
+		log::info(log_source::renderer,
+		          "Vulkan host allocator: {} bytes reserved, {} large allocations, {} reallocations in place, {} cache refills over {} threads.",
+		          statistics.reserved,
+		          statistics.large_allocations,
+		          statistics.in_place_reallocs,
+		          statistics.cache_refills,
+		          statistics.threads);
+	}
+
+	const char* host_allocator::get_scope_name(VkSystemAllocationScope scope) noexcept
+	{
+		switch (scope)
+		{
+			case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:
+				return "command";
+			case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:
+				return "object";
+			case VK_SYSTEM_ALLOCATION_SCOPE_CACHE:
+				return "cache";
+			case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE:
+				return "device";
+			case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE:
+				return "instance";
+			default:
+				return "unknown";
+		}
+	}
+
+	void* host_allocator::allocation_callback(void* p_user_data, std::size_t size, std::size_t alignment, VkSystemAllocationScope scope)
+	{
+		return static_cast<host_allocator*>(p_user_data)->allocate(size, alignment, scope);
+	}
+
+	void* host_allocator::reallocation_callback(void* p_user_data, void* p_original, std::size_t size, std::size_t alignment, VkSystemAllocationScope scope)
+	{
+		return static_cast<host_allocator*>(p_user_data)->reallocate(p_original, size, alignment, scope);
+	}
+
+	void host_allocator::free_callback(void* p_user_data, void* p_memory)
+	{
+		static_cast<host_allocator*>(p_user_data)->free(p_memory);
+	}
+
+	void host_allocator::internal_allocation_callback(void* p_user_data, std::size_t size, VkInternalAllocationType /*type*/, VkSystemAllocationScope scope)
+	{
+		scope_counters& counters = static_cast<host_allocator*>(p_user_data)->m_scopes[scope];
+
+		const u64 current = counters.internal_current.fetch_add(size, std::memory_order_relaxed) + size;
+		raise_peak(counters.internal_peak, current);
+	}
+
+	void host_allocator::internal_free_callback(void* p_user_data, std::size_t size, VkInternalAllocationType /*type*/, VkSystemAllocationScope scope)
+	{
+		static_cast<host_allocator*>(p_user_data)->m_scopes[scope].internal_current.fetch_sub(size, std::memory_order_relaxed);
+	}
+
+	void* host_allocator::allocate_block(std::size_t size, std::size_t alignment, VkSystemAllocationScope scope) noexcept
+	{
+		alignment                       = std::max(alignment, alignof(block_header));
+		const std::size_t header_offset = get_header_offset(alignment);
+
+		std::byte* p_block = nullptr;
+		u8 size_class      = large_class;
+
+		if (alignment <= max_pooled_alignment && header_offset + size <= max_pooled_size)
+		{
+			size_class = static_cast<u8>(get_size_class(header_offset + size));
+			p_block    = static_cast<std::byte*>(pop_block(size_class));
+		}
+		else
+		{
+			// Drivers only ask for this much for a few long-lived objects, the system allocator serves those well.
+			p_block = static_cast<std::byte*>(::operator new(header_offset + size, std::align_val_t{ header_offset }, std::nothrow));
+			if (p_block != nullptr)
+			{
+				m_reserved.fetch_add(header_offset + size, std::memory_order_relaxed);
+				m_large_allocations.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		// Out of memory, the driver turns this into VK_ERROR_OUT_OF_HOST_MEMORY.
+		if (p_block == nullptr)
+		{
+			return nullptr;
+		}
+
+		void* p_memory       = p_block + header_offset;
+		block_header* header = get_header(p_memory);
+		header->size         = size;
+		header->offset       = static_cast<u32>(header_offset);
+		header->size_class   = size_class;
+		header->scope        = static_cast<u8>(scope);
+
+		return p_memory;
+	}
+
+	void host_allocator::release_block(void* p_memory) noexcept
+	{
+		const block_header* header = get_header(p_memory);
+		std::byte* p_block         = static_cast<std::byte*>(p_memory) - header->offset;
+
+		if (header->size_class == large_class)
+		{
+			m_reserved.fetch_sub(header->offset + header->size, std::memory_order_relaxed);
+			::operator delete(p_block, std::align_val_t{ header->offset });
+			return;
+		}
+
+		push_block(header->size_class, p_block);
+	}
+
+	void host_allocator::raise_peak(std::atomic<u64>& peak, u64 value) noexcept
+	{
+		u64 current_peak = peak.load(std::memory_order_relaxed);
+
+		while (value > current_peak && !peak.compare_exchange_weak(current_peak, value, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	host_allocator::thread_cache* host_allocator::get_thread_cache() noexcept
+	{
+		if (t_memo.allocator_id == m_id)
+		{
+			return static_cast<thread_cache*>(t_memo.p_cache);
+		}
+
+		const std::lock_guard lock(m_mutex);
+
+		try
+		{
+			// A thread id reused after its thread exited takes over the cache, blocks and all.
+			std::unique_ptr<thread_cache>& cache = m_thread_caches[std::this_thread::get_id()];
+			if (cache == nullptr)
+			{
+				cache = std::make_unique<thread_cache>();
+			}
+
+			t_memo = {
+			        .allocator_id = m_id,
+			        .p_cache      = cache.get(),
+			};
+
+			return cache.get();
+		}
+		catch (const std::bad_alloc&)
+		{
+			return nullptr;
+		}
+	}
+
+	void* host_allocator::pop_block(u32 size_class) noexcept
+	{
+		thread_cache* p_cache = get_thread_cache();
+		if (p_cache == nullptr)
+		{
+			return nullptr;
+		}
+
+		if (p_cache->free_lists[size_class] == nullptr)
+		{
+			refill(*p_cache, size_class);
+
+			if (p_cache->free_lists[size_class] == nullptr)
+			{
+				return nullptr;
+			}
+		}
+
+		free_block* p_block             = p_cache->free_lists[size_class];
+		p_cache->free_lists[size_class] = p_block->p_next;
+		--p_cache->counts[size_class];
+
+		return p_block;
+	}
+
+	void host_allocator::push_block(u32 size_class, void* p_block) noexcept
+	{
+		auto* p_free = static_cast<free_block*>(p_block);
+
+		thread_cache* p_cache = get_thread_cache();
+		if (p_cache == nullptr)
+		{
+			const std::lock_guard lock(m_mutex);
+			p_free->p_next           = m_free_lists[size_class];
+			m_free_lists[size_class] = p_free;
+			return;
+		}
+
+		p_free->p_next                  = p_cache->free_lists[size_class];
+		p_cache->free_lists[size_class] = p_free;
+
+		// Keeps a thread that only frees, such as one destroying what others created, from hoarding blocks.
+		if (++p_cache->counts[size_class] >= 2 * m_create_info.cache_batch_size)
+		{
+			drain(*p_cache, size_class, m_create_info.cache_batch_size);
+		}
+	}
+
+	void host_allocator::refill(thread_cache& cache, u32 size_class) noexcept
+	{
+		const std::lock_guard lock(m_mutex);
+
+		++m_cache_refills;
+
+		for (u32 index = 0; index < m_create_info.cache_batch_size; ++index)
+		{
+			if (m_free_lists[size_class] == nullptr && !grow(size_class))
+			{
+				return;
+			}
+
+			free_block* p_block          = m_free_lists[size_class];
+			m_free_lists[size_class]     = p_block->p_next;
+			p_block->p_next              = cache.free_lists[size_class];
+			cache.free_lists[size_class] = p_block;
+			++cache.counts[size_class];
+		}
+	}
+
+	void host_allocator::drain(thread_cache& cache, u32 size_class, u32 count) noexcept
+	{
+		const std::lock_guard lock(m_mutex);
+
+		for (u32 index = 0; index < count; ++index)
+		{
+			free_block* p_block          = cache.free_lists[size_class];
+			cache.free_lists[size_class] = p_block->p_next;
+			p_block->p_next              = m_free_lists[size_class];
+			m_free_lists[size_class]     = p_block;
+		}
+
+		cache.counts[size_class] -= count;
+	}
+
+	b8 host_allocator::grow(u32 size_class) noexcept
+	{
+		// Nothing may throw through the driver's frames, running out is reported by returning null instead.
+		auto* p_chunk = static_cast<std::byte*>(::operator new(m_create_info.chunk_size, std::align_val_t{ max_pooled_alignment }, std::nothrow));
+		if (p_chunk == nullptr)
+		{
+			return false;
+		}
+
+		try
+		{
+			m_chunks.push_back(p_chunk);
+		}
+		catch (const std::bad_alloc&)
+		{
+			::operator delete(p_chunk, std::align_val_t{ max_pooled_alignment });
+			return false;
+		}
+
+		m_reserved.fetch_add(m_create_info.chunk_size, std::memory_order_relaxed);
+
+		const std::size_t block_size = get_block_size(size_class);
+
+		for (std::size_t offset = m_create_info.chunk_size; offset >= block_size; offset -= block_size)
+		{
+			auto* p_block            = reinterpret_cast<free_block*>(p_chunk + offset - block_size);
+			p_block->p_next          = m_free_lists[size_class];
+			m_free_lists[size_class] = p_block;
+		}
+
+		return true;
+	}
+
+	void host_allocator::count_allocation(VkSystemAllocationScope scope, u64 size) noexcept
+	{
+		scope_counters& counters = m_scopes[scope];
+
+		const u64 current = counters.current.fetch_add(size, std::memory_order_relaxed) + size;
+		counters.allocations.fetch_add(1, std::memory_order_relaxed);
+
+		raise_peak(counters.peak, current);
+	}
+
+	void host_allocator::count_free(VkSystemAllocationScope scope, u64 size) noexcept
+	{
+		scope_counters& counters = m_scopes[scope];
+
+		counters.current.fetch_sub(size, std::memory_order_relaxed);
+		counters.frees.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void host_allocator::count_reallocation(VkSystemAllocationScope original_scope, u64 original_size, VkSystemAllocationScope scope, u64 size) noexcept
+	{
+		m_scopes[original_scope].current.fetch_sub(original_size, std::memory_order_relaxed);
+
+		scope_counters& counters = m_scopes[scope];
+
+		const u64 current = counters.current.fetch_add(size, std::memory_order_relaxed) + size;
+		counters.reallocations.fetch_add(1, std::memory_order_relaxed);
+
+		raise_peak(counters.peak, current);
+	}
+} // namespace cc::vk
@@ -5,26 +5,13 @@
 
 #include "capricorn/base/log.hpp"
 #include "capricorn/graphics/glfw_shared_state.hpp"
+#include "capricorn/graphics/vulkan/capability_cache.hpp"
 #include "capricorn/graphics/vulkan/vulkan_utils.hpp"
 
 namespace cc::vk
 {
 	namespace details
 	{
-		VkBool32 default_debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity, VkDebugUtilsMessageTypeFlagsEXT message_type, const VkDebugUtilsMessengerCallbackDataEXT* p_callback_data, void* p_user_data)
-		{
-			if (message_severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT)
-			{
-				log::warn(log_source::renderer, p_callback_data->pMessage);
-			}
-			else
-			{
-				log::info(log_source::renderer, p_callback_data->pMessage);
-			}
-
-			return VK_FALSE;
-		}
-
 		std::vector<std::string> get_available_validation_layers()
 		{
 			std::vector<VkLayerProperties> available_layers;
@@ -55,15 +42,19 @@ namespace cc::vk
 			return available_extension_names;
 		}
 
-		VkResult create_debug_utils_messenger_ext(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* p_create_info, const VkAllocationCallbacks* p_allocator, VkDebugUtilsMessengerEXT* p_debug_messenger)
+		u32 get_instance_version()
 		{
-			const auto func = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT"));
-			if (func != nullptr)
+			// Loaders that only know Vulkan 1.0 do not export it, and fail instance creation for any later version.
+			const auto enumerate_instance_version = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(vkGetInstanceProcAddr(VK_NULL_HANDLE, "vkEnumerateInstanceVersion"));
+
+			u32 version = VK_API_VERSION_1_0;
+
+			if (enumerate_instance_version != nullptr && enumerate_instance_version(&version) != VK_SUCCESS)
 			{
-				return func(instance, p_create_info, p_allocator, p_debug_messenger);
+				version = VK_API_VERSION_1_0;
 			}
 
-			return VK_ERROR_EXTENSION_NOT_PRESENT;
+			return version;
 		}
 	} // namespace details
 
@@ -83,25 +74,95 @@ namespace cc::vk
 
 		std::vector<const char*> extensions(params.enabled_extensions);
 		std::vector<const char*> const layers(params.enabled_layers);
-		std::vector<const char*> const glfw_extensions = glfw_shared_state::query_required_extensions();
 
-		// Add all required GLFW extensions.
-		extensions.insert(extensions.end(), std::begin(glfw_extensions), std::end(glfw_extensions));
+		capability_cache* p_cache = params.p_capability_cache;
+
+		const u64 cache_key                   = capability_cache::compute_instance_key();
+		const instance_capabilities* p_cached = p_cache != nullptr ? p_cache->find_instance(cache_key) : nullptr;
+		b8 from_cache                         = p_cached != nullptr;
+
+		const auto query_capabilities = [cache_key] {
+			return instance_capabilities{
+			        .key        = cache_key,
+			        .layers     = details::get_available_validation_layers(),
+			        .extensions = details::get_available_extensions(),
+			};
+		};
+
+		instance_capabilities capabilities = from_cache ? *p_cached : query_capabilities();
+
+		if (!from_cache && p_cache != nullptr)
+		{
+			p_cache->store_instance(capabilities);
+		}
+
+		const auto is_extension_available = [&capabilities](const char* p_extension) {
+			return std::find(capabilities.extensions.begin(), capabilities.extensions.end(), p_extension) != capabilities.extensions.end();
+		};
+
+		const auto is_layer_available = [&capabilities](const char* p_layer) {
+			return std::find(capabilities.layers.begin(), capabilities.layers.end(), p_layer) != capabilities.layers.end();
+		};
+
+		// A cached answer can be out of date in ways the key does not see, e.g. a layer installed into an already known path.
+		const auto refresh_if_cached = [&] {
+			if (!from_cache)
+			{
+				return false;
+			}
+
+			log::warning(log_source::renderer, "Cached instance capabilities are stale, querying the loader again.");
 
-		if (params.validation_layers_enabled)
+			capabilities = query_capabilities();
+			from_cache   = false;
+			p_cache->store_instance(capabilities);
+
+			return true;
+		};
+
+		if (!params.headless)
+		{
+			// Add all required GLFW extensions.
+			std::vector<const char*> const glfw_extensions = glfw_shared_state::query_required_extensions();
+			extensions.insert(extensions.end(), std::begin(glfw_extensions), std::end(glfw_extensions));
+		}
+		else if (is_extension_available(VK_KHR_SURFACE_EXTENSION_NAME) && is_extension_available(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME))
+		{
+			// Without it the caller falls back to rendering into offscreen images.
+			extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+			extensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+			m_headless_surface_enabled = true;
+		}
+
+		// The loader may know a newer version than the drivers behind it, devices are capped again in logical_device.
+		m_instance_version = details::get_instance_version();
+		m_api_version      = std::min(params.api_version != 0 ? params.api_version : VK_API_VERSION_1_0, m_instance_version);
+
+		// Device extensions such as VK_EXT_memory_budget query through it on Vulkan 1.0, later versions have it in core.
+		if (m_api_version < VK_API_VERSION_1_1 && is_extension_available(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+		{
+			extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+			m_properties2_ext_supported = true;
+		}
+
+		if (params.validation_layers_enabled || params.debug_messenger_enabled)
 		{
 			// Add the debug utils extension.
 			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-			m_validation_layers_enabled = true;
 		}
 
+		m_validation_layers_enabled = params.validation_layers_enabled;
+
+		// Remove duplicates, the window system and the caller may both ask for VK_KHR_surface.
+		std::sort(extensions.begin(), extensions.end(), [](const char* p_lhs, const char* p_rhs) { return std::strcmp(p_lhs, p_rhs) < 0; });
+		extensions.erase(std::unique(extensions.begin(), extensions.end(), [](const char* p_lhs, const char* p_rhs) { return std::strcmp(p_lhs, p_rhs) == 0; }), extensions.end());
+
 		// Check if the requested validation layers are available.
 		if (params.validation_layers_requested)
 		{
-			const auto available_layers = details::get_available_validation_layers();
 			for (const auto& requested_layer: params.enabled_layers)
 			{
-				if (std::find(available_layers.begin(), available_layers.end(), requested_layer) == available_layers.end())
+				if (!is_layer_available(requested_layer) && (!refresh_if_cached() || !is_layer_available(requested_layer)))
 				{
 					log::error(log_source::renderer, "Requested validation layer {} is not available.", requested_layer);
 					throw std::runtime_error("Requested validation layer is not available.");
@@ -110,16 +171,49 @@ namespace cc::vk
 		}
 
 		// Check if the requested extensions are available.
-		const auto available_extensions = details::get_available_extensions();
 		for (const auto& requested_extension: extensions)
 		{
-			if (std::find(available_extensions.begin(), available_extensions.end(), requested_extension) == available_extensions.end())
+			if (!is_extension_available(requested_extension) && (!refresh_if_cached() || !is_extension_available(requested_extension)))
 			{
 				log::error(log_source::renderer, "Requested extension {} is not available.", requested_extension);
 				throw std::runtime_error("Requested extension is not available.");
 			}
 		}
 
+		const b8 has_validation_features = !params.disabled_validation_checks.empty() || !params.enabled_validation_features.empty() || !params.disabled_validation_features.empty();
+
+		VkValidationFeaturesEXT validation_features_info = {};
+		VkValidationFlagsEXT validation_flags            = {};
+		const void* p_next                               = nullptr;
+
+		if (has_validation_features && params.validation_layers_requested)
+		{
+			// Provided by the validation layer rather than the loader, so it is not among the extensions checked above.
+			extensions.push_back(VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME);
+
+			validation_features_info.sType                          = VK_STRUCTURE_TYPE_VALIDATION_FEATURES_EXT;
+			validation_features_info.enabledValidationFeatureCount  = static_cast<uint32_t>(params.enabled_validation_features.size());
+			validation_features_info.pEnabledValidationFeatures     = params.enabled_validation_features.data();
+			validation_features_info.disabledValidationFeatureCount = static_cast<uint32_t>(params.disabled_validation_features.size());
+			validation_features_info.pDisabledValidationFeatures    = params.disabled_validation_features.data();
+			p_next                                                  = &validation_features_info;
+
+			if (!params.disabled_validation_checks.empty())
+			{
+				extensions.push_back(VK_EXT_VALIDATION_FLAGS_EXTENSION_NAME);
+
+				validation_flags.sType                        = VK_STRUCTURE_TYPE_VALIDATION_FLAGS_EXT;
+				validation_flags.pNext                        = p_next;
+				validation_flags.disabledValidationCheckCount = static_cast<uint32_t>(params.disabled_validation_checks.size());
+				validation_flags.pDisabledValidationChecks    = params.disabled_validation_checks.data();
+				p_next                                        = &validation_flags;
+			}
+		}
+		else if (has_validation_features)
+		{
+			log::warning(log_source::renderer, "Validation features are set without a validation layer, they are ignored.");
+		}
+
 		// Create the application info struct.
 		VkApplicationInfo application_info  = {};
 		application_info.sType              = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -127,11 +221,12 @@ namespace cc::vk
 		application_info.applicationVersion = params.application_version;
 		application_info.pEngineName        = params.p_engine_name;
 		application_info.engineVersion      = params.engine_version;
-		application_info.apiVersion         = VK_API_VERSION_1_0;
+		application_info.apiVersion         = m_api_version;
 
 		// Create the instance create info struct.
 		VkInstanceCreateInfo instance_create_info    = {};
 		instance_create_info.sType                   = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+		instance_create_info.pNext                   = p_next;
 		instance_create_info.pApplicationInfo        = &application_info;
 		instance_create_info.enabledExtensionCount   = static_cast<uint32_t>(extensions.size());
 		instance_create_info.ppEnabledExtensionNames = extensions.data();
@@ -143,31 +238,71 @@ namespace cc::vk
 		// Create the instance.
 		if (vkCreateInstance(&instance_create_info, params.p_allocator, &instance) != VK_SUCCESS)
 		{
+			if (from_cache)
+			{
+				// Do not trust the cache on the next run either.
+				p_cache->invalidate();
+			}
+
 			log::error(log_source::renderer, "Failed to create vulkan instance.");
 			throw std::runtime_error("Failed to create vulkan instance.");
 		}
 
 		m_instance = std::make_shared<VkInstance>(instance);
 
-		// Create the debug messenger.
-		if (params.validation_layers_requested)
+		m_dispatch.load(instance, m_api_version);
+
+		// Destruction has to use the same callbacks as creation.
+		if (params.p_allocator != nullptr)
+		{
+			m_allocator = std::make_shared<VkAllocationCallbacks>(*params.p_allocator);
+		}
+
+		// Create the debug messenger, at the severities asked for; the layer skips formatting everything below them.
+		if (params.debug_messenger_enabled)
 		{
+			if (params.debug_callback == nullptr)
+			{
+				m_message_filter = debug_message_filter::create(params.message_filter);
+			}
+
 			VkDebugUtilsMessengerCreateInfoEXT debug_messenger_create_info = {};
 			debug_messenger_create_info.sType                              = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-			debug_messenger_create_info.messageSeverity                    = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-			debug_messenger_create_info.messageType                        = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-			debug_messenger_create_info.pfnUserCallback                    = params.debug_callback;
-			debug_messenger_create_info.pUserData                          = params.p_user_data;
+			debug_messenger_create_info.messageSeverity                    = params.message_severity;
+			debug_messenger_create_info.messageType                        = params.message_type;
+			debug_messenger_create_info.pfnUserCallback                    = m_message_filter != nullptr ? &debug_message_filter::callback : params.debug_callback;
+			debug_messenger_create_info.pUserData                          = m_message_filter != nullptr ? m_message_filter.get() : params.p_user_data;
 			debug_messenger_create_info.pNext                              = nullptr;
 
 			VkDebugUtilsMessengerEXT debug_messenger = VK_NULL_HANDLE;
 
-			vk_ensure(details::create_debug_utils_messenger_ext(*m_instance, &debug_messenger_create_info, params.p_allocator, &debug_messenger), "Failed to create debug messenger.");
+			ensure(m_dispatch.vkCreateDebugUtilsMessengerEXT != nullptr, "Failed to create debug messenger.");
+			vk_ensure(m_dispatch.vkCreateDebugUtilsMessengerEXT(instance, &debug_messenger_create_info, params.p_allocator, &debug_messenger), "Failed to create debug messenger.");
 
 			m_debug_messenger = std::make_shared<VkDebugUtilsMessengerEXT>(debug_messenger);
 		}
 
-		log::info(log_source::renderer, "Vulkan instance created.");
+		log::info(log_source::renderer, "Vulkan instance created with API version {}.{}.", VK_API_VERSION_MAJOR(m_api_version), VK_API_VERSION_MINOR(m_api_version));
+	}
+
+	instance::~instance()
+	{
+		if (m_instance == nullptr)
+		{
+			return;
+		}
+
+		if (m_debug_messenger != nullptr && m_dispatch.vkDestroyDebugUtilsMessengerEXT != nullptr)
+		{
+			m_dispatch.vkDestroyDebugUtilsMessengerEXT(*m_instance, *m_debug_messenger, m_allocator.get());
+		}
+
+		if (m_message_filter != nullptr)
+		{
+			m_message_filter->log_statistics();
+		}
+
+		m_dispatch.vkDestroyInstance(*m_instance, m_allocator.get());
 	}
 
 	instance::operator VkInstance() const noexcept
@@ -189,4 +324,34 @@ namespace cc::vk
 	{
 		return m_validation_layers_enabled;
 	}
+
+	b8 instance::headless_surface_enabled() const noexcept
+	{
+		return m_headless_surface_enabled;
+	}
+
+	b8 instance::properties2_enabled() const noexcept
+	{
+		return m_properties2_ext_supported || m_api_version >= VK_API_VERSION_1_1;
+	}
+
+	u32 instance::get_api_version() const noexcept
+	{
+		return m_api_version;
+	}
+
+	const instance_dispatch& instance::get_dispatch() const noexcept
+	{
+		return m_dispatch;
+	}
+
+	const VkAllocationCallbacks* instance::get_allocation_callbacks() const noexcept
+	{
+		return m_allocator.get();
+	}
+
+	const debug_message_filter* instance::get_message_filter() const noexcept
+	{
+		return m_message_filter.get();
+	}
 } // namespace cc::vk
\ No newline at end of file
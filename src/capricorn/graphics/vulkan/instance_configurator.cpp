@@ -125,7 +125,13 @@ namespace cc::vk
 		return *this;
 	}
 
-	instance_configurator& instance_configurator::set_allocator(VkAllocationCallbacks* allocator)
+	instance_configurator& instance_configurator::set_headless(b8 headless)
+	{
+		m_info.headless = headless;
+		return *this;
+	}
+
+	instance_configurator& instance_configurator::set_allocator(const VkAllocationCallbacks* allocator)
 	{
 		m_info.p_allocator = allocator;
 		return *this;
@@ -3,175 +3,648 @@
 
 #include "capricorn/graphics/vulkan/logical_device.hpp"
 
+#include "capricorn/graphics/vulkan/capability_cache.hpp"
+#include "capricorn/graphics/vulkan/memory_allocator.hpp"
+#include "capricorn/graphics/vulkan/pipeline_cache.hpp"
+#include "capricorn/graphics/vulkan/vulkan_utils.hpp"
+#include "capricorn/memory/scratch_arena.hpp"
+
 namespace cc::vk
 {
 	namespace details
 	{
-		struct queue_family_indices
+		// The family each role submits to. Compute and transfer are the graphics family when there is no better one.
+		struct queue_topology
 		{
-			std::optional<u8> graphics_family;
-			std::optional<u8> present_family;
-
-			cc_nodiscard b8 is_complete() const
-			{
-				return graphics_family.has_value() && present_family.has_value();
-			}
+			u32 graphics_family = 0;
+			std::optional<u32> present_family; // Set when a surface was given.
+			u32 compute_family  = 0;
+			u32 transfer_family = 0;
 		};
 
-		queue_family_indices find_queue_families(const VkPhysicalDevice& physical_device, const VkSurfaceKHR& surface)
+		// Returns nothing when the device has no graphics family, or none that can present. Without a surface present_support is empty.
+		std::optional<queue_topology> find_queue_topology(const physical_device_candidate& candidate, std::span<const VkBool32> present_support)
 		{
-			queue_family_indices indices;
+			const b8 present_required = !present_support.empty();
 
-			u32 queue_family_count = 0;
-			vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, nullptr);
+			std::optional<u32> graphics_family;
+			std::optional<u32> present_family;
+			std::optional<u32> compute_family;
+			std::optional<u32> transfer_family;
 
-			std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
-			vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_families.data());
+			b8 graphics_presents = false;
+			b8 transfer_only     = false; // A family with nothing but transfer is a copy engine, an async compute family is the next best thing.
 
-			u8 index = 0;
-			for (const auto& queue_family: queue_families)
+			for (u32 index = 0; index < static_cast<u32>(candidate.queue_families.size()); index++)
 			{
-				if (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT)
-					indices.graphics_family = index;
+				const VkQueueFlags flags = candidate.queue_families[index].queueFlags;
 
-				VkBool32 present_support = false;
-				vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, index, surface, &present_support);
+				const b8 presents = present_required && present_support[index] == VK_TRUE;
 
-				if (present_support)
-					indices.present_family = index;
+				if (presents && !present_family.has_value())
+					present_family = index;
 
-				if (indices.is_complete())
-					break;
+				// Presenting from the graphics family spares the swapchain images an ownership transfer.
+				if ((flags & VK_QUEUE_GRAPHICS_BIT) && (!graphics_family.has_value() || (presents && !graphics_presents)))
+				{
+					graphics_family   = index;
+					graphics_presents = presents;
+				}
 
-				index++;
+				// Graphics and compute families support transfers whether or not they advertise the bit.
+				const b8 transfer = (flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT)) != 0;
+				const b8 only     = (flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0;
+
+				if (transfer && !(flags & VK_QUEUE_GRAPHICS_BIT) && (!transfer_family.has_value() || (only && !transfer_only)))
+				{
+					transfer_family = index;
+					transfer_only   = only;
+				}
+
+				if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && !compute_family.has_value())
+					compute_family = index;
 			}
 
-			return indices;
+			if (!graphics_family.has_value() || (present_required && !present_family.has_value()))
+				return std::nullopt;
+
+			if (graphics_presents)
+				present_family = graphics_family;
+
+			// Sharing the family with transfers needs a second queue in it, the two are submitted to from different threads.
+			if (compute_family.has_value() && compute_family == transfer_family && candidate.queue_families[*compute_family].queueCount < 2)
+				compute_family.reset();
+
+			return queue_topology {
+			        .graphics_family = *graphics_family,
+			        .present_family  = present_family,
+			        .compute_family  = compute_family.value_or(*graphics_family),
+			        .transfer_family = transfer_family.value_or(*graphics_family),
+			};
 		}
 
-		b8 check_device_extension_support(const VkPhysicalDevice& physical_device, const std::vector<const char*>& required_device_extensions)
+		// Parses 32 hex digits, dashes anywhere in between are skipped.
+		std::optional<std::array<u8, VK_UUID_SIZE>> parse_uuid(std::string_view text)
 		{
-			u32 extension_count = 0;
-			vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr);
+			std::array<u8, VK_UUID_SIZE> uuid = {};
 
-			std::vector<VkExtensionProperties> available_extensions(extension_count);
-			vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, available_extensions.data());
+			u32 digits = 0;
+			for (const char character: text)
+			{
+				if (character == '-')
+					continue;
 
-			std::set<std::string> required_extensions(required_device_extensions.begin(), required_device_extensions.end());
+				const auto digit = static_cast<unsigned char>(std::tolower(static_cast<unsigned char>(character)));
 
-			for (const auto& extension: available_extensions)
-				required_extensions.erase(extension.extensionName);
+				if (!std::isxdigit(digit) || digits == VK_UUID_SIZE * 2)
+					return std::nullopt;
 
-			return required_extensions.empty();
+				const u32 value = std::isdigit(digit) ? digit - '0' : digit - 'a' + 10;
+
+				uuid[digits / 2] = static_cast<u8>(uuid[digits / 2] << 4 | value);
+				digits++;
+			}
+
+			if (digits != VK_UUID_SIZE * 2)
+				return std::nullopt;
+
+			return uuid;
 		}
 
-		struct swap_chain_support_details
+		// Every device type is further ahead of the next than the other terms add up to: memory 128, API version 100 and features 150.
+		constexpr u32 type_score(VkPhysicalDeviceType type)
 		{
-			VkSurfaceCapabilitiesKHR capabilities = {};
-			std::vector<VkSurfaceFormatKHR> formats;
-			std::vector<VkPresentModeKHR> present_modes;
-		};
+			switch (type)
+			{
+				case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 2000;
+				case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 1500;
+				case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 1000;
+				case VK_PHYSICAL_DEVICE_TYPE_CPU: return 0;
+				default: return 500;
+			}
+		}
+
+		b8 requires_properties2(const char* p_extension)
+		{
+			return std::strcmp(p_extension, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0 || std::strcmp(p_extension, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0 ||
+			       std::strcmp(p_extension, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0 || std::strcmp(p_extension, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) == 0;
+		}
+
+		b8 promoted_to_vulkan12(const char* p_extension)
+		{
+			return std::strcmp(p_extension, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0 || std::strcmp(p_extension, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0 ||
+			       std::strcmp(p_extension, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0;
+		}
 
-		swap_chain_support_details query_swap_chain_support(const VkPhysicalDevice& physical_device, const VkSurfaceKHR& surface)
+		b8 check_device_extension_support(const physical_device_candidate& candidate, const std::vector<const char*>& required_device_extensions)
 		{
-			swap_chain_support_details details;
+			scratch_arena const scratch;
+
+			std::pmr::set<std::string_view> required_extensions(required_device_extensions.begin(), required_device_extensions.end(), scratch.get_resource());
 
-			vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &details.capabilities);
+			for (const auto& extension: candidate.extensions)
+				required_extensions.erase(extension);
+
+			return required_extensions.empty();
+		}
+
+		swap_chain_support_details query_swap_chain_support(const instance_dispatch& dispatch, const VkPhysicalDevice& physical_device, const VkSurfaceKHR& surface, std::pmr::memory_resource* p_resource)
+		{
+			swap_chain_support_details details(p_resource);
+
+			vk_ensure(dispatch.vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &details.capabilities), "failed to get physical device surface capabilities!");
 
 			u32 format_count = 0;
-			vk_ensure(vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &format_count, nullptr), "failed to get physical device surface formats!");
+			vk_ensure(dispatch.vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &format_count, nullptr), "failed to get physical device surface formats!");
 
 			if (format_count != 0)
 			{
 				details.formats.resize(format_count);
-				vk_ensure(vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &format_count, details.formats.data()), "failed to get physical device surface formats!");
+				vk_ensure(dispatch.vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &format_count, details.formats.data()), "failed to get physical device surface formats!");
 			}
 
 			u32 present_mode_count = 0;
-			vk_ensure(vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &present_mode_count, nullptr), "failed to get physical device surface present modes!");
+			vk_ensure(dispatch.vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &present_mode_count, nullptr), "failed to get physical device surface present modes!");
 
 			if (present_mode_count != 0)
 			{
 				details.present_modes.resize(present_mode_count);
-				vk_ensure(vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &present_mode_count, details.present_modes.data()), "failed to get physical device surface present modes!");
+				vk_ensure(dispatch.vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &present_mode_count, details.present_modes.data()), "failed to get physical device surface present modes!");
 			}
 
 			return details;
 		}
 
-		b8 is_device_suitable(const VkPhysicalDevice& physical_device, VkSurfaceKHR& surface, const std::vector<const char*>& required_device_extensions)
+		// Returns the queue families to use, or nothing when the device cannot serve the surface.
+		std::optional<queue_topology> check_device_suitability(const instance_dispatch& dispatch, const physical_device_candidate& candidate, VkSurfaceKHR surface, const std::vector<const char*>& required_device_extensions)
 		{
-			const auto indices = find_queue_families(physical_device, surface);
+			scratch_arena const scratch;
+
+			std::pmr::vector<VkBool32> present_support(scratch.get_resource());
+
+			if (surface != VK_NULL_HANDLE)
+			{
+				present_support.resize(candidate.queue_families.size(), VK_FALSE);
+
+				for (u32 index = 0; index < static_cast<u32>(present_support.size()); index++)
+					dispatch.vkGetPhysicalDeviceSurfaceSupportKHR(candidate.handle, index, surface, &present_support[index]);
+			}
 
-			const b8 extensions_supported = check_device_extension_support(physical_device, required_device_extensions);
+			const auto topology = find_queue_topology(candidate, present_support);
 
-			b8 swap_chain_adequate = false;
-			if (extensions_supported)
+			if (!topology.has_value() || !check_device_extension_support(candidate, required_device_extensions))
 			{
-				swap_chain_support_details const swap_chain_support = query_swap_chain_support(physical_device, surface);
-				swap_chain_adequate                                 = !swap_chain_support.formats.empty() && !swap_chain_support.present_modes.empty();
+				return std::nullopt;
 			}
 
-			return indices.is_complete() && extensions_supported && swap_chain_adequate;
+			if (surface != VK_NULL_HANDLE)
+			{
+				swap_chain_support_details const swap_chain_support = query_swap_chain_support(dispatch, candidate.handle, surface, scratch.get_resource());
+
+				if (swap_chain_support.formats.empty() || swap_chain_support.present_modes.empty())
+				{
+					return std::nullopt;
+				}
+			}
+
+			return topology;
 		}
 	} // namespace details
 
+	void device_features::link(u32 api_version, b8 descriptor_indexing_extension, b8 timeline_semaphore_extension)
+	{
+		core.sType                = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		vulkan11.sType            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+		vulkan12.sType            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		vulkan13.sType            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+		descriptor_indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		timeline_semaphore.sType  = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+		// The structs of promoted extensions may not be chained along with the struct of the version that promoted them.
+		void** pp_next = &core.pNext;
+
+		const auto append = [&pp_next](auto& features) {
+			*pp_next = &features;
+			pp_next  = &features.pNext;
+		};
+
+		if (api_version >= VK_API_VERSION_1_2)
+		{
+			append(vulkan11);
+			append(vulkan12);
+
+			if (api_version >= VK_API_VERSION_1_3)
+			{
+				append(vulkan13);
+			}
+		}
+		else
+		{
+			if (descriptor_indexing_extension)
+			{
+				append(descriptor_indexing);
+			}
+
+			if (timeline_semaphore_extension)
+			{
+				append(timeline_semaphore);
+			}
+		}
+
+		*pp_next = nullptr;
+	}
+
+	std::vector<physical_device_candidate> discover_physical_devices(const instance& instance, capability_cache* p_capability_cache)
+	{
+		const instance_dispatch& dispatch = instance.get_dispatch();
+
+		std::vector<VkPhysicalDevice> devices;
+		vk_ensure(enumerate_vulkan_construct<VkPhysicalDevice>(devices, dispatch.vkEnumeratePhysicalDevices, instance.operator VkInstance()), "failed to enumerate physical devices!");
+
+		// The device UUID is only reported through VkPhysicalDeviceIDProperties, which came with Vulkan 1.1.
+		const b8 device_uuid = instance.get_api_version() >= VK_API_VERSION_1_1;
+
+		std::vector<physical_device_candidate> candidates;
+		candidates.reserve(devices.size());
+
+		for (VkPhysicalDevice const device: devices)
+		{
+			physical_device_candidate& candidate = candidates.emplace_back();
+			candidate.handle                     = device;
+
+			// Properties are cheap and carry the driver version, which is what tells us whether the cached entry is still valid.
+			dispatch.vkGetPhysicalDeviceProperties(device, &candidate.properties);
+
+			// As cheap, and what device scoring looks at.
+			dispatch.vkGetPhysicalDeviceFeatures(device, &candidate.features);
+			dispatch.vkGetPhysicalDeviceMemoryProperties(device, &candidate.memory_properties);
+
+			if (device_uuid && candidate.properties.apiVersion >= VK_API_VERSION_1_1)
+			{
+				VkPhysicalDeviceIDProperties id_properties = {};
+				id_properties.sType                        = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+				VkPhysicalDeviceProperties2 properties = {};
+				properties.sType                       = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+				properties.pNext                       = &id_properties;
+
+				dispatch.vkGetPhysicalDeviceProperties2(device, &properties);
+				std::copy(std::begin(id_properties.deviceUUID), std::end(id_properties.deviceUUID), candidate.device_uuid.begin());
+			}
+
+			const device_capabilities* p_cached = p_capability_cache != nullptr ? p_capability_cache->find_device(candidate.properties) : nullptr;
+
+			if (p_cached != nullptr)
+			{
+				candidate.queue_families = p_cached->queue_families;
+				candidate.extensions     = p_cached->extensions;
+				continue;
+			}
+
+			u32 queue_family_count = 0;
+			dispatch.vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, nullptr);
+			candidate.queue_families.resize(queue_family_count);
+			dispatch.vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, candidate.queue_families.data());
+
+			std::vector<VkExtensionProperties> available_extensions;
+			vk_ensure(enumerate_vulkan_construct<VkExtensionProperties>(available_extensions, dispatch.vkEnumerateDeviceExtensionProperties, device, nullptr), "failed to enumerate device extensions!");
+
+			for (const auto& extension: available_extensions)
+			{
+				candidate.extensions.emplace_back(extension.extensionName);
+			}
+
+			if (p_capability_cache != nullptr)
+			{
+				device_capabilities capabilities = {
+				        .vendor_id      = candidate.properties.vendorID,
+				        .device_id      = candidate.properties.deviceID,
+				        .driver_version = candidate.properties.driverVersion,
+				        .queue_families = candidate.queue_families,
+				        .extensions     = candidate.extensions,
+				};
+
+				std::copy(std::begin(candidate.properties.pipelineCacheUUID), std::end(candidate.properties.pipelineCacheUUID), capabilities.pipeline_cache_uuid.begin());
+
+				p_capability_cache->store_device(std::move(capabilities));
+			}
+		}
+
+		return candidates;
+	}
+
+	physical_device_score score_physical_device(const physical_device_candidate& candidate, u32 instance_api_version)
+	{
+		constexpr VkDeviceSize step = VkDeviceSize { 256 } * 1024 * 1024;
+
+		VkDeviceSize device_local = 0;
+		for (u32 index = 0; index < candidate.memory_properties.memoryHeapCount; index++)
+		{
+			const VkMemoryHeap& heap = candidate.memory_properties.memoryHeaps[index];
+
+			if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+				device_local = std::max(device_local, heap.size);
+		}
+
+		const u32 api_version = std::min(instance_api_version, candidate.properties.apiVersion);
+
+		const auto has_extension = [&candidate](const char* p_extension) {
+			return std::find(candidate.extensions.begin(), candidate.extensions.end(), p_extension) != candidate.extensions.end();
+		};
+
+		// Both are core since Vulkan 1.2; whether every feature bindless needs is supported only shows once properties2 can be asked.
+		const b8 descriptor_indexing = api_version >= VK_API_VERSION_1_2 || has_extension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		const b8 timeline_semaphore  = api_version >= VK_API_VERSION_1_2 || has_extension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+		const details::queue_topology topology = details::find_queue_topology(candidate, {}).value_or(details::queue_topology {});
+
+		physical_device_score score;
+		score.type        = details::type_score(candidate.properties.deviceType);
+		score.memory      = static_cast<u32>(std::min<VkDeviceSize>(device_local / step, 64)) * 2;
+		score.api_version = std::min(VK_API_VERSION_MINOR(api_version), 4U) * 25;
+		score.features    = (candidate.features.textureCompressionBC ? 25 : 0) + (descriptor_indexing ? 50 : 0) + (timeline_semaphore ? 25 : 0) +
+		                 (topology.compute_family != topology.graphics_family ? 25 : 0) + (topology.transfer_family != topology.graphics_family ? 25 : 0);
+
+		return score;
+	}
+
+	b8 matches_physical_device(const physical_device_candidate& candidate, std::string_view name)
+	{
+		if (const auto uuid = details::parse_uuid(name); uuid.has_value())
+		{
+			return *uuid == candidate.device_uuid && *uuid != std::array<u8, VK_UUID_SIZE> {};
+		}
+
+		const std::string_view device_name = candidate.properties.deviceName;
+
+		const auto equal = [](char left, char right) {
+			return std::tolower(static_cast<unsigned char>(left)) == std::tolower(static_cast<unsigned char>(right));
+		};
+
+		return !name.empty() && std::search(device_name.begin(), device_name.end(), name.begin(), name.end(), equal) != device_name.end();
+	}
+
 	logical_device::logical_device(const device_create_info& create_info) // NOLINT(modernize-pass-by-value)
 	    : m_create_info(create_info)
 	{
-		// Pick the physical device
-		u32 device_count = 0;
-		vk_ensure(vkEnumeratePhysicalDevices(m_create_info.instance.lock()->operator VkInstance(), &device_count, nullptr), "failed to enumerate physical devices!");
+		using clock = std::chrono::steady_clock;
+
+		const clock::time_point selection_start = clock::now();
 
-		if (device_count == 0)
+		const auto p_instance = m_create_info.instance.lock();
+
+		if (m_create_info.candidates.empty())
+		{
+			m_create_info.candidates = discover_physical_devices(*p_instance);
+		}
+
+		if (m_create_info.candidates.empty())
 			throw std::runtime_error("failed to find GPUs with Vulkan support!");
 
-		std::vector<VkPhysicalDevice> devices(device_count);
-		vk_ensure(vkEnumeratePhysicalDevices(m_create_info.instance.lock()->operator VkInstance(), &device_count, devices.data()), "failed to enumerate physical devices!");
+		// Headless contexts without a surface pass none; device selection then ignores presentation.
+		const auto p_surface       = m_create_info.surface.lock();
+		VkSurfaceKHR const surface = p_surface != nullptr ? *p_surface : VK_NULL_HANDLE;
 
-		for (const auto& device: devices)
+		// Pick the physical device
+		std::optional<details::queue_topology> selected_topology;
+
+		const physical_device_candidate* p_selected = nullptr;
+
+		u32 best_score = 0;
+		b8 preferred   = false;
+
+		for (const auto& candidate: m_create_info.candidates)
 		{
-			if (details::is_device_suitable(device, *m_create_info.surface.lock(), m_create_info.required_device_extensions))
+			const auto topology = details::check_device_suitability(p_instance->get_dispatch(), candidate, surface, m_create_info.required_device_extensions);
+
+			if (!topology.has_value())
+			{
+				log::info(log_source::renderer, "Device {} is not suitable.", candidate.properties.deviceName);
+				continue;
+			}
+
+			const physical_device_score score = score_physical_device(candidate, p_instance->get_api_version());
+
+			log::info(log_source::renderer,
+			          "Device {} scores {}: type {}, memory {}, API version {}, features {}.",
+			          candidate.properties.deviceName,
+			          score.total(),
+			          score.type,
+			          score.memory,
+			          score.api_version,
+			          score.features);
+
+			if (preferred)
+				continue;
+
+			// The first preferred match wins outright, otherwise the first of the best scores.
+			preferred = m_create_info.p_preferred_device != nullptr && matches_physical_device(candidate, m_create_info.p_preferred_device);
+
+			if (preferred || p_selected == nullptr || score.total() > best_score)
 			{
-				m_physical_device = device;
-				break;
+				p_selected        = &candidate;
+				selected_topology = topology;
+				best_score        = score.total();
 			}
 		}
 
-		if (m_physical_device == VK_NULL_HANDLE)
+		if (p_selected == nullptr)
 		{
 			throw std::runtime_error("failed to find a suitable GPU!");
 		}
 
+		if (m_create_info.p_preferred_device != nullptr && !preferred)
+		{
+			log::warning(log_source::renderer, "Preferred device {} is not present or not suitable, selecting by score.", m_create_info.p_preferred_device);
+		}
+
+		m_physical_device   = p_selected->handle;
+		m_properties        = p_selected->properties;
+		m_memory_properties = p_selected->memory_properties;
+
+		log::info(log_source::renderer, "Selected device {}{}.", p_selected->properties.deviceName, preferred ? " as preferred" : "");
+
+		const clock::time_point creation_start = clock::now();
+
 		// Create the logical device
-		const auto indices = details::find_queue_families(m_physical_device, *m_create_info.surface.lock());
+		const details::queue_topology& topology = *selected_topology;
+
+		scratch_arena const scratch;
+
+		// Roles ask for queues in this order, so the ones asking first get queues of their own when the family runs short.
+		struct queue_request
+		{
+			u32 family = 0;
+			u32 count  = 0;
+		};
+
+		const std::array<queue_request, 3> requests = { {
+		        { topology.graphics_family, std::max(m_create_info.graphics_queue_count, 1U) },
+		        { topology.compute_family, std::max(m_create_info.compute_queue_count, 1U) },
+		        { topology.transfer_family, std::max(m_create_info.transfer_queue_count, 1U) },
+		} };
+
+		// The present queue is the first graphics queue, unless presentation needs another family.
+		const b8 separate_present = topology.present_family.has_value() && topology.present_family != topology.graphics_family;
+
+		std::pmr::map<u32, u32> family_queue_counts(scratch.get_resource());
+
+		for (const queue_request& request: requests)
+			family_queue_counts[request.family] += request.count;
+
+		if (separate_present)
+			family_queue_counts[*topology.present_family] += 1;
+
+		u32 max_queue_count = 0;
+
+		for (auto& [family, count]: family_queue_counts)
+		{
+			count           = std::min(count, p_selected->queue_families[family].queueCount);
+			max_queue_count = std::max(max_queue_count, count);
+		}
 
-		std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
-		std::set<u32> const unique_queue_families = {indices.graphics_family.value(), indices.present_family.value()};
+		const std::pmr::vector<float> queue_priorities(max_queue_count, 1.0F, scratch.get_resource());
 
-		float const queue_priority = 1.0F;
+		std::pmr::vector<VkDeviceQueueCreateInfo> queue_create_infos(scratch.get_resource());
 
-		for (u32 const queue_family: unique_queue_families)
+		for (const auto& [family, count]: family_queue_counts)
 		{
 			VkDeviceQueueCreateInfo queue_create_info = {};
 			queue_create_info.sType                   = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-			queue_create_info.queueFamilyIndex        = queue_family;
-			queue_create_info.queueCount              = 1;
-			queue_create_info.pQueuePriorities        = &queue_priority;
+			queue_create_info.queueFamilyIndex        = family;
+			queue_create_info.queueCount              = count;
+			queue_create_info.pQueuePriorities        = queue_priorities.data();
 			queue_create_infos.push_back(queue_create_info);
 		}
 
-		VkPhysicalDeviceFeatures const device_features = {};
+		// A device may support less than the instance negotiated, and only the lower of the two may be used with it.
+		m_api_version = std::min(p_instance->get_api_version(), p_selected->properties.apiVersion);
+
+		m_enabled_extensions = m_create_info.required_device_extensions;
+
+		// Core since Vulkan 1.1, a Vulkan 1.0 device only has it where the instance enabled the extension.
+		const b8 properties2_enabled = m_api_version >= VK_API_VERSION_1_1 || (p_instance->get_api_version() < VK_API_VERSION_1_1 && p_instance->properties2_enabled());
+
+		for (const char* p_extension: m_create_info.optional_device_extensions)
+		{
+			// These depend on VK_KHR_get_physical_device_properties2, which Vulkan 1.0 only has with the instance extension.
+			if (!properties2_enabled && details::requires_properties2(p_extension))
+			{
+				continue;
+			}
+
+			// Promoted to core in Vulkan 1.2, where the features are enabled through VkPhysicalDeviceVulkan12Features instead.
+			if (m_api_version >= VK_API_VERSION_1_2 && details::promoted_to_vulkan12(p_extension))
+			{
+				continue;
+			}
+
+			if (std::find(p_selected->extensions.begin(), p_selected->extensions.end(), p_extension) != p_selected->extensions.end())
+			{
+				m_enabled_extensions.push_back(p_extension);
+			}
+		}
+
+		// Descriptor indexing needs VK_KHR_maintenance3 before Vulkan 1.1.
+		if (m_api_version < VK_API_VERSION_1_1 && !is_extension_enabled(VK_KHR_MAINTENANCE_3_EXTENSION_NAME))
+		{
+			std::erase_if(m_enabled_extensions, [](const char* p_extension) { return std::strcmp(p_extension, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0; });
+		}
+
+		const VkInstance instance                   = p_instance->operator VkInstance();
+		const instance_dispatch& instance_functions = p_instance->get_dispatch();
+
+		m_supported_features.link(m_api_version, is_extension_enabled(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME), is_extension_enabled(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME));
+		m_enabled_features.link(m_api_version, is_extension_enabled(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME), is_extension_enabled(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME));
+
+		if (properties2_enabled)
+		{
+			// Loaded under the name of the instance's version, the same one properties2_enabled decided on.
+			const auto get_features2   = instance_functions.vkGetPhysicalDeviceFeatures2;
+			const auto get_properties2 = instance_functions.vkGetPhysicalDeviceProperties2;
+
+			get_features2(m_physical_device, &m_supported_features.core);
+
+			// The limits the bindless heap sizes its arrays by.
+			if (m_api_version >= VK_API_VERSION_1_2 || is_extension_enabled(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+			{
+				m_descriptor_indexing_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+				VkPhysicalDeviceProperties2 properties = {};
+				properties.sType                       = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+				properties.pNext                       = &m_descriptor_indexing_properties;
+
+				get_properties2(m_physical_device, &properties);
+			}
+		}
+		else
+		{
+			instance_functions.vkGetPhysicalDeviceFeatures(m_physical_device, &m_supported_features.core.features);
+		}
+
+		// Only features something in the engine checks for through the getters below, everything else costs for nothing.
+		m_enabled_features.core.features.textureCompressionBC      = m_supported_features.core.features.textureCompressionBC;
+		m_enabled_features.core.features.multiDrawIndirect         = m_supported_features.core.features.multiDrawIndirect;
+		m_enabled_features.core.features.drawIndirectFirstInstance = m_supported_features.core.features.drawIndirectFirstInstance;
+
+		const auto enable_descriptor_indexing = [](const auto& supported, auto& enabled) {
+			// Bindless needs all of them, a subset is as good as none.
+			const b8 complete = supported.shaderSampledImageArrayNonUniformIndexing && supported.shaderStorageBufferArrayNonUniformIndexing && supported.descriptorBindingSampledImageUpdateAfterBind &&
+			                    supported.descriptorBindingStorageBufferUpdateAfterBind && supported.descriptorBindingUpdateUnusedWhilePending && supported.descriptorBindingPartiallyBound &&
+			                    supported.runtimeDescriptorArray;
+
+			if (complete)
+			{
+				enabled.shaderSampledImageArrayNonUniformIndexing     = VK_TRUE;
+				enabled.shaderStorageBufferArrayNonUniformIndexing    = VK_TRUE;
+				enabled.descriptorBindingSampledImageUpdateAfterBind  = VK_TRUE;
+				enabled.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+				enabled.descriptorBindingUpdateUnusedWhilePending     = VK_TRUE;
+				enabled.descriptorBindingPartiallyBound               = VK_TRUE;
+				enabled.runtimeDescriptorArray                        = VK_TRUE;
+			}
+
+			return complete;
+		};
+
+		if (m_api_version >= VK_API_VERSION_1_2)
+		{
+			m_descriptor_indexing = enable_descriptor_indexing(m_supported_features.vulkan12, m_enabled_features.vulkan12);
+
+			m_enabled_features.vulkan12.timelineSemaphore = m_supported_features.vulkan12.timelineSemaphore;
+			m_timeline_semaphore                          = m_enabled_features.vulkan12.timelineSemaphore == VK_TRUE;
+
+			m_enabled_features.vulkan12.drawIndirectCount = m_supported_features.vulkan12.drawIndirectCount;
+			m_draw_indirect_count                         = m_enabled_features.vulkan12.drawIndirectCount == VK_TRUE;
+		}
+		else
+		{
+			if (is_extension_enabled(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+			{
+				m_descriptor_indexing = enable_descriptor_indexing(m_supported_features.descriptor_indexing, m_enabled_features.descriptor_indexing);
+			}
+
+			// Every device exposing the extension has to support the feature, it only needs switching on.
+			if (is_extension_enabled(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+			{
+				m_enabled_features.timeline_semaphore.timelineSemaphore = VK_TRUE;
+				m_timeline_semaphore                                    = true;
+			}
+
+			// The extension has no feature struct, enabling it is all there is to it.
+			m_draw_indirect_count = is_extension_enabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		}
 
 		VkDeviceCreateInfo device_create_info      = {};
 		device_create_info.sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		device_create_info.pNext                   = properties2_enabled ? &m_enabled_features.core : nullptr;
 		device_create_info.queueCreateInfoCount    = static_cast<u32>(queue_create_infos.size());
 		device_create_info.pQueueCreateInfos       = queue_create_infos.data();
-		device_create_info.pEnabledFeatures        = &device_features;
-		device_create_info.enabledExtensionCount   = static_cast<u32>(m_create_info.required_device_extensions.size());
-		device_create_info.ppEnabledExtensionNames = m_create_info.required_device_extensions.data();
+		device_create_info.pEnabledFeatures        = properties2_enabled ? nullptr : &m_enabled_features.core.features;
+		device_create_info.enabledExtensionCount   = static_cast<u32>(m_enabled_extensions.size());
+		device_create_info.ppEnabledExtensionNames = m_enabled_extensions.data();
 
-		if (m_create_info.instance.lock()->validation_layers_enabled())
+		if (p_instance->validation_layers_enabled())
 		{
 			device_create_info.enabledLayerCount   = static_cast<u32>(m_create_info.required_validation_layers.size());
 			device_create_info.ppEnabledLayerNames = m_create_info.required_validation_layers.data();
@@ -181,10 +654,105 @@ namespace cc::vk
 			device_create_info.enabledLayerCount = 0;
 		}
 
-		vk_ensure(vkCreateDevice(m_physical_device, &device_create_info, nullptr, &m_device), "failed to create logical device!");
+		// Whatever the instance allocates with, so the driver's host memory is accounted for in one place.
+		m_p_allocation_callbacks = p_instance->get_allocation_callbacks();
+
+		vk_ensure(instance_functions.vkCreateDevice(m_physical_device, &device_create_info, m_p_allocation_callbacks, &m_device), "failed to create logical device!");
+
+		m_dispatch.load(instance_functions.vkGetDeviceProcAddr, m_device, m_api_version);
+
+		// Hand out each family's queues in request order, wrapping around once they run out.
+		std::pmr::map<u32, u32> next_queue_index(scratch.get_resource());
+
+		for (std::size_t role = 0; role < requests.size(); role++)
+		{
+			const queue_request& request = requests[role];
+			const u32 family_count       = family_queue_counts[request.family];
+
+			for (u32 queue = 0; queue < std::min(request.count, family_count); queue++)
+			{
+				VkQueue handle = VK_NULL_HANDLE;
+				m_dispatch.vkGetDeviceQueue(m_device, request.family, next_queue_index[request.family]++ % family_count, &handle);
+				m_queues[role].push_back(handle);
+			}
+		}
+
+		m_graphics_queue = { m_queues[static_cast<std::size_t>(queue_role::graphics)].front(), topology.graphics_family };
+		m_compute_queue  = { m_queues[static_cast<std::size_t>(queue_role::compute)].front(), topology.compute_family };
+		m_transfer_queue = { m_queues[static_cast<std::size_t>(queue_role::transfer)].front(), topology.transfer_family };
+
+		if (separate_present)
+		{
+			m_present_queue.second = *topology.present_family;
+			m_dispatch.vkGetDeviceQueue(m_device, m_present_queue.second, next_queue_index[m_present_queue.second] % family_queue_counts[m_present_queue.second], &m_present_queue.first);
+		}
+		else if (topology.present_family.has_value())
+		{
+			m_present_queue = m_graphics_queue;
+		}
 
-		vkGetDeviceQueue(m_device, indices.graphics_family.value(), 0, &m_graphics_queue.first);
-		vkGetDeviceQueue(m_device, indices.present_family.value(), 0, &m_present_queue.first);
+		log::info(log_source::renderer,
+		          "Device uses API version {}.{}, {}descriptor indexing, {}timeline semaphores.",
+		          VK_API_VERSION_MAJOR(m_api_version),
+		          VK_API_VERSION_MINOR(m_api_version),
+		          m_descriptor_indexing ? "" : "no ",
+		          m_timeline_semaphore ? "" : "no ");
+
+		log::info(log_source::renderer,
+		          "Queue families: graphics {} ({} queues), transfer {}{} ({} queues), compute {}{} ({} queues).",
+		          m_graphics_queue.second,
+		          get_queues(queue_role::graphics).size(),
+		          m_transfer_queue.second,
+		          has_dedicated_transfer_queue() ? "" : " (shared with graphics)",
+		          get_queues(queue_role::transfer).size(),
+		          m_compute_queue.second,
+		          has_async_compute_queue() ? "" : " (shared with graphics)",
+		          get_queues(queue_role::compute).size());
+
+		pipeline_cache_create_info const pipeline_cache_create_info = {
+		        .device                 = m_device,
+		        .p_dispatch             = &m_dispatch,
+		        .p_allocation_callbacks = m_p_allocation_callbacks,
+		        .properties             = m_properties,
+		        .p_path                 = m_create_info.p_pipeline_cache_path,
+		        .creation_feedback      = is_extension_enabled(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME),
+		};
+
+		m_pipeline_cache = pipeline_cache::create(pipeline_cache_create_info);
+
+		memory_allocator_create_info const memory_allocator_create_info = {
+		        .instance               = instance,
+		        .physical_device        = m_physical_device,
+		        .device                 = m_device,
+		        .p_dispatch             = &m_dispatch,
+		        .p_allocation_callbacks = m_p_allocation_callbacks,
+		        .queue                  = m_graphics_queue,
+		        .memory_budget          = is_extension_enabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME),
+		        .dedicated_allocation   = is_extension_enabled(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME) && is_extension_enabled(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME),
+		        .frames_in_flight       = m_create_info.frames_in_flight,
+		        .api_version            = m_api_version,
+		};
+
+		m_memory_allocator = memory_allocator::create(memory_allocator_create_info);
+
+		m_creation_timing.selection_seconds = std::chrono::duration<f64>(creation_start - selection_start).count();
+		m_creation_timing.creation_seconds  = std::chrono::duration<f64>(clock::now() - creation_start).count();
+	}
+
+	logical_device::~logical_device()
+	{
+		if (m_device != VK_NULL_HANDLE)
+		{
+			m_dispatch.vkDeviceWaitIdle(m_device);
+
+			// Writes the pipeline cache back to disk, which needs the device.
+			m_pipeline_cache.reset();
+
+			// Every resource has to be gone by now, the allocator reports the ones that are not.
+			m_memory_allocator.reset();
+
+			m_dispatch.vkDestroyDevice(m_device, m_p_allocation_callbacks);
+		}
 	}
 
 	logical_device::operator VkDevice() const
@@ -201,4 +769,126 @@ namespace cc::vk
 	{
 		return m_create_info;
 	}
+
+	VkPhysicalDevice logical_device::get_physical_device() const noexcept
+	{
+		return m_physical_device;
+	}
+
+	const VkPhysicalDeviceProperties& logical_device::get_properties() const noexcept
+	{
+		return m_properties;
+	}
+
+	const VkPhysicalDeviceMemoryProperties& logical_device::get_memory_properties() const noexcept
+	{
+		return m_memory_properties;
+	}
+
+	std::pair<VkQueue, u32> logical_device::get_graphics_queue() const noexcept
+	{
+		return m_graphics_queue;
+	}
+
+	std::pair<VkQueue, u32> logical_device::get_present_queue() const noexcept
+	{
+		return m_present_queue;
+	}
+
+	std::pair<VkQueue, u32> logical_device::get_transfer_queue() const noexcept
+	{
+		return m_transfer_queue;
+	}
+
+	std::pair<VkQueue, u32> logical_device::get_compute_queue() const noexcept
+	{
+		return m_compute_queue;
+	}
+
+	std::span<const VkQueue> logical_device::get_queues(queue_role role) const noexcept
+	{
+		return m_queues[static_cast<std::size_t>(role)];
+	}
+
+	b8 logical_device::has_dedicated_transfer_queue() const noexcept
+	{
+		return m_transfer_queue.second != m_graphics_queue.second;
+	}
+
+	b8 logical_device::has_async_compute_queue() const noexcept
+	{
+		return m_compute_queue.second != m_graphics_queue.second;
+	}
+
+	b8 logical_device::can_present() const noexcept
+	{
+		return m_present_queue.first != VK_NULL_HANDLE;
+	}
+
+	b8 logical_device::is_extension_enabled(const char* p_extension) const noexcept
+	{
+		return std::any_of(m_enabled_extensions.begin(), m_enabled_extensions.end(), [p_extension](const char* p_enabled) {
+			return std::strcmp(p_enabled, p_extension) == 0;
+		});
+	}
+
+	const VkPhysicalDeviceFeatures& logical_device::get_enabled_features() const noexcept
+	{
+		return m_enabled_features.core.features;
+	}
+
+	const device_features& logical_device::get_supported_features() const noexcept
+	{
+		return m_supported_features;
+	}
+
+	const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& logical_device::get_descriptor_indexing_properties() const noexcept
+	{
+		return m_descriptor_indexing_properties;
+	}
+
+	u32 logical_device::get_api_version() const noexcept
+	{
+		return m_api_version;
+	}
+
+	b8 logical_device::has_timeline_semaphore() const noexcept
+	{
+		return m_timeline_semaphore;
+	}
+
+	b8 logical_device::has_descriptor_indexing() const noexcept
+	{
+		return m_descriptor_indexing;
+	}
+
+	b8 logical_device::has_draw_indirect_count() const noexcept
+	{
+		return m_draw_indirect_count;
+	}
+
+	std::weak_ptr<pipeline_cache> logical_device::get_pipeline_cache() const noexcept
+	{
+		return m_pipeline_cache;
+	}
+
+	std::weak_ptr<memory_allocator> logical_device::get_memory_allocator() const noexcept
+	{
+		return m_memory_allocator;
+	}
+
+	const device_creation_timing& logical_device::get_creation_timing() const noexcept
+	{
+		return m_creation_timing;
+	}
+
+	const device_dispatch& logical_device::get_dispatch() const noexcept
+	{
+		return m_dispatch;
+	}
+
+	const VkAllocationCallbacks* logical_device::get_allocation_callbacks() const noexcept
+	{
+		return m_p_allocation_callbacks;
+	}
 } // namespace cc::vk
\ No newline at end of file
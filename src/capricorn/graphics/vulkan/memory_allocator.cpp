@@ -0,0 +1,869 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/vulkan/memory_allocator.hpp"
+
+namespace cc::vk
+{
+	namespace details
+	{
+		VmaAllocationCreateInfo to_allocation_create_info(memory_usage usage)
+		{
+			VmaAllocationCreateInfo allocation_create_info = {};
+
+			switch (usage)
+			{
+				case memory_usage::gpu_only:
+					allocation_create_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+					break;
+				case memory_usage::upload:
+					allocation_create_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+					allocation_create_info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+					break;
+				case memory_usage::dynamic:
+					allocation_create_info.usage = VMA_MEMORY_USAGE_AUTO;
+					allocation_create_info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+					break;
+				case memory_usage::readback:
+					allocation_create_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+					allocation_create_info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+					break;
+			}
+
+			return allocation_create_info;
+		}
+
+		f64 to_mebibytes(u64 bytes)
+		{
+			return static_cast<f64>(bytes) / (1024.0 * 1024.0);
+		}
+	} // namespace details
+
+	gpu_buffer::~gpu_buffer()
+	{
+		if (m_p_allocator != nullptr)
+		{
+			m_p_allocator->release(*this);
+		}
+	}
+
+	VkBuffer gpu_buffer::get_handle() const noexcept
+	{
+		return m_buffer;
+	}
+
+	VkDeviceSize gpu_buffer::get_size() const noexcept
+	{
+		return m_size;
+	}
+
+	void* gpu_buffer::get_mapped_data() const noexcept
+	{
+		return m_p_mapped;
+	}
+
+	allocation_category gpu_buffer::get_category() const noexcept
+	{
+		return m_category;
+	}
+
+	b8 gpu_buffer::is_dedicated() const noexcept
+	{
+		return m_dedicated;
+	}
+
+	gpu_image::~gpu_image()
+	{
+		if (m_p_allocator != nullptr)
+		{
+			m_p_allocator->release(*this);
+		}
+	}
+
+	VkImage gpu_image::get_handle() const noexcept
+	{
+		return m_image;
+	}
+
+	const VkExtent3D& gpu_image::get_extent() const noexcept
+	{
+		return m_extent;
+	}
+
+	VkFormat gpu_image::get_format() const noexcept
+	{
+		return m_format;
+	}
+
+	u32 gpu_image::get_mip_levels() const noexcept
+	{
+		return m_mip_levels;
+	}
+
+	allocation_category gpu_image::get_category() const noexcept
+	{
+		return m_category;
+	}
+
+	b8 gpu_image::is_dedicated() const noexcept
+	{
+		return m_dedicated;
+	}
+
+	gpu_memory::~gpu_memory()
+	{
+		if (m_p_allocator != nullptr)
+		{
+			m_p_allocator->release(*this);
+		}
+	}
+
+	VkDeviceSize gpu_memory::get_size() const noexcept
+	{
+		return m_size;
+	}
+
+	allocation_category gpu_memory::get_category() const noexcept
+	{
+		return m_category;
+	}
+
+	memory_allocator::memory_allocator(const memory_allocator_create_info& create_info)
+	    : m_create_info(create_info)
+	{
+		ensure(m_create_info.device != VK_NULL_HANDLE, "Memory allocator requires a device!");
+		ensure(m_create_info.p_dispatch != nullptr, "Memory allocator requires the device's dispatch table!");
+
+		// Device functions come from the device's table, so VMA calls the driver directly rather than the loader's trampolines.
+		// The rest, the few physical device queries and whatever a newer API version adds, VMA fetches through the first two.
+		const device_dispatch& dispatch = *m_create_info.p_dispatch;
+
+		VmaVulkanFunctions vulkan_functions                = {};
+		vulkan_functions.vkGetInstanceProcAddr             = vkGetInstanceProcAddr;
+		vulkan_functions.vkGetDeviceProcAddr               = vkGetDeviceProcAddr;
+		vulkan_functions.vkAllocateMemory                  = dispatch.vkAllocateMemory;
+		vulkan_functions.vkFreeMemory                      = dispatch.vkFreeMemory;
+		vulkan_functions.vkMapMemory                       = dispatch.vkMapMemory;
+		vulkan_functions.vkUnmapMemory                     = dispatch.vkUnmapMemory;
+		vulkan_functions.vkFlushMappedMemoryRanges         = dispatch.vkFlushMappedMemoryRanges;
+		vulkan_functions.vkInvalidateMappedMemoryRanges    = dispatch.vkInvalidateMappedMemoryRanges;
+		vulkan_functions.vkBindBufferMemory                = dispatch.vkBindBufferMemory;
+		vulkan_functions.vkBindImageMemory                 = dispatch.vkBindImageMemory;
+		vulkan_functions.vkGetBufferMemoryRequirements     = dispatch.vkGetBufferMemoryRequirements;
+		vulkan_functions.vkGetImageMemoryRequirements      = dispatch.vkGetImageMemoryRequirements;
+		vulkan_functions.vkCreateBuffer                    = dispatch.vkCreateBuffer;
+		vulkan_functions.vkDestroyBuffer                   = dispatch.vkDestroyBuffer;
+		vulkan_functions.vkCreateImage                     = dispatch.vkCreateImage;
+		vulkan_functions.vkDestroyImage                    = dispatch.vkDestroyImage;
+		vulkan_functions.vkCmdCopyBuffer                   = dispatch.vkCmdCopyBuffer;
+		vulkan_functions.vkGetBufferMemoryRequirements2KHR = dispatch.vkGetBufferMemoryRequirements2;
+		vulkan_functions.vkGetImageMemoryRequirements2KHR  = dispatch.vkGetImageMemoryRequirements2;
+		vulkan_functions.vkBindBufferMemory2KHR            = dispatch.vkBindBufferMemory2;
+		vulkan_functions.vkBindImageMemory2KHR             = dispatch.vkBindImageMemory2;
+
+		VmaAllocatorCreateInfo allocator_create_info      = {};
+		allocator_create_info.vulkanApiVersion            = m_create_info.api_version;
+		allocator_create_info.instance                    = m_create_info.instance;
+		allocator_create_info.physicalDevice              = m_create_info.physical_device;
+		allocator_create_info.device                      = m_create_info.device;
+		allocator_create_info.preferredLargeHeapBlockSize = m_create_info.block_size;
+		allocator_create_info.pVulkanFunctions            = &vulkan_functions;
+		allocator_create_info.pAllocationCallbacks        = m_create_info.p_allocation_callbacks;
+
+		if (m_create_info.memory_budget)
+		{
+			allocator_create_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+		}
+
+		if (m_create_info.dedicated_allocation)
+		{
+			// Lets the driver ask for a dedicated allocation where it knows better, e.g. for render targets.
+			allocator_create_info.flags |= VMA_ALLOCATOR_CREATE_KHR_DEDICATED_ALLOCATION_BIT;
+		}
+
+		vk_ensure(vmaCreateAllocator(&allocator_create_info, &m_allocator), "Failed to create memory allocator!");
+
+		// VMA queried both while it was created.
+		const VkPhysicalDeviceProperties* p_properties = nullptr;
+		vmaGetPhysicalDeviceProperties(m_allocator, &p_properties);
+		m_max_allocation_count = p_properties->limits.maxMemoryAllocationCount;
+
+		const VkPhysicalDeviceMemoryProperties* p_memory_properties = nullptr;
+		vmaGetMemoryProperties(m_allocator, &p_memory_properties);
+		m_over_budget.resize(p_memory_properties->memoryHeapCount, false);
+
+		// Defragmentation copies go through their own pool, so they never wait on a frame's command buffer.
+		VkCommandPoolCreateInfo pool_create_info = {};
+		pool_create_info.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		pool_create_info.flags                   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		pool_create_info.queueFamilyIndex        = m_create_info.queue.second;
+
+		vk_ensure(m_create_info.p_dispatch->vkCreateCommandPool(m_create_info.device, &pool_create_info, m_create_info.p_allocation_callbacks, &m_command_pool), "Failed to create defragmentation command pool!");
+
+		VkCommandBufferAllocateInfo command_buffer_info = {};
+		command_buffer_info.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		command_buffer_info.commandPool                 = m_command_pool;
+		command_buffer_info.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		command_buffer_info.commandBufferCount          = 1;
+
+		vk_ensure(m_create_info.p_dispatch->vkAllocateCommandBuffers(m_create_info.device, &command_buffer_info, &m_command_buffer), "Failed to allocate defragmentation command buffer!");
+
+		VkFenceCreateInfo fence_create_info = {};
+		fence_create_info.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		vk_ensure(m_create_info.p_dispatch->vkCreateFence(m_create_info.device, &fence_create_info, m_create_info.p_allocation_callbacks, &m_fence), "Failed to create defragmentation fence!");
+
+		log::info(log_source::renderer,
+		          "Memory allocator created (memory budget: {}, dedicated allocations: {}, allocation limit: {}).",
+		          m_create_info.memory_budget,
+		          m_create_info.dedicated_allocation,
+		          m_max_allocation_count);
+	}
+
+	memory_allocator::~memory_allocator()
+	{
+		if (m_allocator == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		// The owner waited for the device to go idle, an outstanding pass can be finished right away.
+		if (m_defragmentation != VK_NULL_HANDLE)
+		{
+			if (m_stage == defragmentation_stage::copying)
+			{
+				m_create_info.p_dispatch->vkWaitForFences(m_create_info.device, 1, &m_fence, VK_TRUE, UINT64_MAX);
+				swap_moved_buffers();
+			}
+
+			if (m_stage != defragmentation_stage::idle)
+			{
+				end_defragmentation_pass();
+			}
+
+			// Ending the pass may have finished defragmentation as a whole.
+			if (m_defragmentation != VK_NULL_HANDLE)
+			{
+				vmaEndDefragmentation(m_allocator, m_defragmentation, nullptr);
+			}
+		}
+
+		log_statistics();
+
+		for (std::size_t index = 0; index < m_statistics.size(); ++index)
+		{
+			if (m_statistics[index].allocations != 0)
+			{
+				log::warning(log_source::renderer,
+				             "{} {} allocations ({:.2f} MiB) outlived the memory allocator.",
+				             m_statistics[index].allocations,
+				             get_category_name(static_cast<allocation_category>(index)),
+				             details::to_mebibytes(m_statistics[index].bytes));
+			}
+		}
+
+		m_create_info.p_dispatch->vkDestroyFence(m_create_info.device, m_fence, m_create_info.p_allocation_callbacks);
+		m_create_info.p_dispatch->vkDestroyCommandPool(m_create_info.device, m_command_pool, m_create_info.p_allocation_callbacks);
+		vmaDestroyAllocator(m_allocator);
+	}
+
+	memory_allocator::operator VmaAllocator() const noexcept
+	{
+		return m_allocator;
+	}
+
+	std::shared_ptr<memory_allocator> memory_allocator::create(const memory_allocator_create_info& create_info)
+	{
+		return std::make_shared<memory_allocator>(create_info);
+	}
+
+	std::shared_ptr<gpu_buffer> memory_allocator::create_buffer(const gpu_buffer_create_info& create_info)
+	{
+		ensure(create_info.size != 0, "Cannot create an empty buffer!");
+
+		VkBufferCreateInfo buffer_create_info = {};
+		buffer_create_info.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_create_info.size               = create_info.size;
+		buffer_create_info.usage              = create_info.usage;
+		buffer_create_info.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+
+		// Moving a buffer means copying out of it and into its new place.
+		if (create_info.movable)
+		{
+			buffer_create_info.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		}
+
+		const b8 dedicated = create_info.dedicated || create_info.size >= m_create_info.dedicated_threshold;
+
+		VmaAllocationCreateInfo allocation_create_info = details::to_allocation_create_info(create_info.memory);
+
+		if (dedicated)
+		{
+			allocation_create_info.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+		}
+
+		auto buffer = std::make_shared<gpu_buffer>();
+
+		VmaAllocationInfo allocation_info = {};
+		vk_ensure(vmaCreateBuffer(m_allocator, &buffer_create_info, &allocation_create_info, &buffer->m_buffer, &buffer->m_allocation, &allocation_info), "Failed to create buffer!");
+
+		buffer->m_p_allocator     = this;
+		buffer->m_size            = create_info.size;
+		buffer->m_allocation_size = allocation_info.size;
+		buffer->m_usage           = buffer_create_info.usage;
+		buffer->m_p_mapped        = allocation_info.pMappedData;
+		buffer->m_category        = create_info.category;
+		buffer->m_dedicated       = dedicated;
+
+		// Defragmentation finds the buffer through the user data, everything without it stays in place.
+		if (create_info.movable && !dedicated && create_info.memory == memory_usage::gpu_only)
+		{
+			vmaSetAllocationUserData(m_allocator, buffer->m_allocation, buffer.get());
+		}
+
+		if (create_info.p_name != nullptr)
+		{
+			vmaSetAllocationName(m_allocator, buffer->m_allocation, create_info.p_name);
+		}
+
+		record_allocation(buffer->m_category, buffer->m_allocation_size, dedicated);
+
+		return buffer;
+	}
+
+	std::shared_ptr<gpu_image> memory_allocator::create_image(const gpu_image_create_info& create_info)
+	{
+		const VkImageCreateInfo& image_create_info = create_info.image;
+
+		ensure(image_create_info.sType == VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, "Image create info is not filled in!");
+
+		VmaAllocationCreateInfo allocation_create_info = details::to_allocation_create_info(create_info.memory);
+
+		// The final size is only known after the driver added alignment and padding, so ask first.
+		b8 dedicated = create_info.dedicated || create_info.category == allocation_category::render_target;
+
+		if (!dedicated)
+		{
+			VkImage probe = VK_NULL_HANDLE;
+			vk_ensure(m_create_info.p_dispatch->vkCreateImage(m_create_info.device, &image_create_info, m_create_info.p_allocation_callbacks, &probe), "Failed to create image!");
+
+			VkMemoryRequirements requirements = {};
+			m_create_info.p_dispatch->vkGetImageMemoryRequirements(m_create_info.device, probe, &requirements);
+			m_create_info.p_dispatch->vkDestroyImage(m_create_info.device, probe, m_create_info.p_allocation_callbacks);
+
+			dedicated = requirements.size >= m_create_info.dedicated_threshold;
+		}
+
+		if (dedicated)
+		{
+			allocation_create_info.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+		}
+
+		auto image = std::make_shared<gpu_image>();
+
+		VmaAllocationInfo allocation_info = {};
+		vk_ensure(vmaCreateImage(m_allocator, &image_create_info, &allocation_create_info, &image->m_image, &image->m_allocation, &allocation_info), "Failed to create image!");
+
+		image->m_p_allocator     = this;
+		image->m_allocation_size = allocation_info.size;
+		image->m_extent          = image_create_info.extent;
+		image->m_format          = image_create_info.format;
+		image->m_mip_levels      = image_create_info.mipLevels;
+		image->m_category        = create_info.category;
+		image->m_dedicated       = dedicated;
+
+		if (create_info.p_name != nullptr)
+		{
+			vmaSetAllocationName(m_allocator, image->m_allocation, create_info.p_name);
+		}
+
+		record_allocation(image->m_category, image->m_allocation_size, dedicated);
+
+		return image;
+	}
+
+	std::shared_ptr<gpu_memory> memory_allocator::allocate_memory(const gpu_memory_create_info& create_info)
+	{
+		ensure(create_info.requirements.size > 0 && create_info.requirements.memoryTypeBits != 0, "Memory requirements are not filled in!");
+
+		VmaAllocationCreateInfo allocation_create_info = details::to_allocation_create_info(create_info.memory);
+		allocation_create_info.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+
+		auto memory = std::make_shared<gpu_memory>();
+
+		VmaAllocationInfo allocation_info = {};
+		vk_ensure(vmaAllocateMemory(m_allocator, &create_info.requirements, &allocation_create_info, &memory->m_allocation, &allocation_info), "Failed to allocate memory!");
+
+		memory->m_p_allocator = this;
+		memory->m_size        = allocation_info.size;
+		memory->m_category    = create_info.category;
+
+		if (create_info.p_name != nullptr)
+		{
+			vmaSetAllocationName(m_allocator, memory->m_allocation, create_info.p_name);
+		}
+
+		record_allocation(memory->m_category, memory->m_size, true);
+
+		return memory;
+	}
+
+	void memory_allocator::bind_image(const gpu_memory& memory, VkImage image, VkDeviceSize offset)
+	{
+		vk_ensure(vmaBindImageMemory2(m_allocator, memory.m_allocation, offset, image, nullptr), "Failed to bind image memory!");
+	}
+
+	void memory_allocator::flush(const gpu_buffer& buffer, VkDeviceSize offset, VkDeviceSize size)
+	{
+		vk_ensure(vmaFlushAllocation(m_allocator, buffer.m_allocation, offset, size), "Failed to flush buffer!");
+	}
+
+	void memory_allocator::update(u64 frame_number)
+	{
+		vmaSetCurrentFrameIndex(m_allocator, static_cast<u32>(frame_number));
+
+		check_budgets(frame_number);
+		step_defragmentation(frame_number);
+	}
+
+	void memory_allocator::begin_defragmentation()
+	{
+		std::lock_guard const lock(m_defragmentation_mutex);
+
+		if (m_defragmentation != VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		VmaDefragmentationInfo defragmentation_info = {};
+		defragmentation_info.flags                  = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+		defragmentation_info.maxBytesPerPass        = m_create_info.defragmentation_bytes_per_pass;
+		defragmentation_info.maxAllocationsPerPass  = m_create_info.defragmentation_moves_per_pass;
+
+		vk_ensure(vmaBeginDefragmentation(m_allocator, &defragmentation_info, &m_defragmentation), "Failed to begin defragmentation!");
+
+		log::info(log_source::renderer, "GPU memory defragmentation started.");
+	}
+
+	b8 memory_allocator::is_defragmenting() const noexcept
+	{
+		std::lock_guard const lock(m_defragmentation_mutex);
+		return m_defragmentation != VK_NULL_HANDLE;
+	}
+
+	std::vector<heap_budget> memory_allocator::get_budgets() const
+	{
+		const VkPhysicalDeviceMemoryProperties* p_memory_properties = nullptr;
+		vmaGetMemoryProperties(m_allocator, &p_memory_properties);
+
+		std::vector<VmaBudget> vma_budgets(p_memory_properties->memoryHeapCount);
+		vmaGetHeapBudgets(m_allocator, vma_budgets.data());
+
+		std::vector<heap_budget> budgets;
+		budgets.reserve(vma_budgets.size());
+
+		for (u32 heap_index = 0; heap_index < p_memory_properties->memoryHeapCount; ++heap_index)
+		{
+			const VmaBudget& vma_budget = vma_budgets[heap_index];
+
+			budgets.push_back({
+			        .heap_index       = heap_index,
+			        .device_local     = (p_memory_properties->memoryHeaps[heap_index].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0,
+			        .usage            = vma_budget.usage,
+			        .budget           = vma_budget.budget,
+			        .block_bytes      = vma_budget.statistics.blockBytes,
+			        .allocation_bytes = vma_budget.statistics.allocationBytes,
+			        .block_count      = vma_budget.statistics.blockCount,
+			});
+		}
+
+		return budgets;
+	}
+
+	memory_category_statistics memory_allocator::get_statistics(allocation_category category) const
+	{
+		std::lock_guard const lock(m_statistics_mutex);
+		return m_statistics[static_cast<std::size_t>(category)];
+	}
+
+	defragmentation_statistics memory_allocator::get_defragmentation_statistics() const
+	{
+		std::lock_guard const lock(m_defragmentation_mutex);
+		return m_defragmentation_statistics;
+	}
+
+	void memory_allocator::log_statistics() const
+	{
+		for (std::size_t index = 0; index < static_cast<std::size_t>(allocation_category::count); ++index)
+		{
+			const memory_category_statistics statistics = get_statistics(static_cast<allocation_category>(index));
+
+			if (statistics.peak_bytes == 0)
+			{
+				continue;
+			}
+
+			log::info(log_source::renderer,
+			          "GPU memory for {}: {} allocations ({} dedicated), {:.2f} MiB, peak {:.2f} MiB.",
+			          get_category_name(static_cast<allocation_category>(index)),
+			          statistics.allocations,
+			          statistics.dedicated,
+			          details::to_mebibytes(statistics.bytes),
+			          details::to_mebibytes(statistics.peak_bytes));
+		}
+
+		const defragmentation_statistics defragmentation = get_defragmentation_statistics();
+
+		if (defragmentation.passes != 0)
+		{
+			log::info(log_source::renderer,
+			          "GPU memory defragmentation: {} passes moved {} buffers ({:.2f} MiB) and freed {:.2f} MiB.",
+			          defragmentation.passes,
+			          defragmentation.moves,
+			          details::to_mebibytes(defragmentation.bytes_moved),
+			          details::to_mebibytes(defragmentation.bytes_freed));
+		}
+	}
+
+	const char* memory_allocator::get_category_name(allocation_category category)
+	{
+		switch (category)
+		{
+			case allocation_category::texture:
+				return "textures";
+			case allocation_category::buffer:
+				return "buffers";
+			case allocation_category::staging:
+				return "staging";
+			case allocation_category::render_target:
+				return "render targets";
+			case allocation_category::count:
+				break;
+		}
+
+		return "unknown";
+	}
+
+	void memory_allocator::release(gpu_buffer& buffer)
+	{
+		record_release(buffer.m_category, buffer.m_allocation_size, buffer.m_dedicated);
+
+		{
+			std::lock_guard const lock(m_defragmentation_mutex);
+
+			// Allocations that are part of a pass are freed by VMA when the pass ends. Buffers being
+			// copied are still read by the copy, their handles are destroyed together with the pass.
+			if (VmaDefragmentationMove* p_move = find_move(buffer.m_allocation); p_move != nullptr)
+			{
+				if (p_move->operation != VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY)
+				{
+					m_create_info.p_dispatch->vkDestroyBuffer(m_create_info.device, buffer.m_buffer, m_create_info.p_allocation_callbacks);
+				}
+
+				p_move->operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+				return;
+			}
+		}
+
+		vmaDestroyBuffer(m_allocator, buffer.m_buffer, buffer.m_allocation);
+	}
+
+	void memory_allocator::release(gpu_image& image)
+	{
+		record_release(image.m_category, image.m_allocation_size, image.m_dedicated);
+
+		{
+			std::lock_guard const lock(m_defragmentation_mutex);
+
+			// Images are never copied, but VMA may have picked one for the pass anyway.
+			if (VmaDefragmentationMove* p_move = find_move(image.m_allocation); p_move != nullptr)
+			{
+				m_create_info.p_dispatch->vkDestroyImage(m_create_info.device, image.m_image, m_create_info.p_allocation_callbacks);
+				p_move->operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+				return;
+			}
+		}
+
+		vmaDestroyImage(m_allocator, image.m_image, image.m_allocation);
+	}
+
+	void memory_allocator::release(gpu_memory& memory)
+	{
+		record_release(memory.m_category, memory.m_size, true);
+
+		vmaFreeMemory(m_allocator, memory.m_allocation);
+	}
+
+	void memory_allocator::record_allocation(allocation_category category, VkDeviceSize size, b8 dedicated)
+	{
+		std::lock_guard const lock(m_statistics_mutex);
+
+		memory_category_statistics& statistics = m_statistics[static_cast<std::size_t>(category)];
+
+		statistics.allocations += 1;
+		statistics.dedicated += dedicated ? 1 : 0;
+		statistics.bytes += size;
+		statistics.peak_bytes = std::max(statistics.peak_bytes, statistics.bytes);
+	}
+
+	void memory_allocator::record_release(allocation_category category, VkDeviceSize size, b8 dedicated)
+	{
+		std::lock_guard const lock(m_statistics_mutex);
+
+		memory_category_statistics& statistics = m_statistics[static_cast<std::size_t>(category)];
+
+		statistics.allocations -= 1;
+		statistics.dedicated -= dedicated ? 1 : 0;
+		statistics.bytes -= size;
+	}
+
+	void memory_allocator::check_budgets(u64 frame_number)
+	{
+		// Runs every frame, so no get_budgets() and its vector; VMA only refreshes the numbers when the frame index changes.
+		std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets = {};
+		vmaGetHeapBudgets(m_allocator, budgets.data());
+
+		u32 block_count               = 0;
+		VkDeviceSize block_bytes      = 0;
+		VkDeviceSize allocation_bytes = 0;
+
+		for (u32 heap_index = 0; heap_index < m_over_budget.size(); ++heap_index)
+		{
+			const VmaBudget& budget = budgets[heap_index];
+
+			block_count += budget.statistics.blockCount;
+			block_bytes += budget.statistics.blockBytes;
+			allocation_bytes += budget.statistics.allocationBytes;
+
+			const b8 over_budget = static_cast<f64>(budget.usage) > static_cast<f64>(budget.budget) * m_create_info.budget_warning_fraction;
+
+			// Only warn when crossing the line, not every frame spent above it.
+			if (over_budget && !m_over_budget[heap_index])
+			{
+				log::warning(log_source::renderer,
+				             "Memory heap {} is at {:.2f} of {:.2f} MiB, further allocations may be evicted or fail.",
+				             heap_index,
+				             details::to_mebibytes(budget.usage),
+				             details::to_mebibytes(budget.budget));
+			}
+
+			m_over_budget[heap_index] = over_budget;
+		}
+
+		const b8 near_allocation_limit = m_max_allocation_count != 0 && block_count > m_max_allocation_count - m_max_allocation_count / 10;
+
+		if (near_allocation_limit && !m_near_allocation_limit)
+		{
+			log::warning(log_source::renderer, "{} of at most {} device memory allocations are in use.", block_count, m_max_allocation_count);
+		}
+
+		m_near_allocation_limit = near_allocation_limit;
+
+		// Blocks stay allocated as long as a single resource lives in them, so freed space is only given back by compacting.
+		const VkDeviceSize unused_bytes = block_bytes - allocation_bytes;
+		const b8 over_threshold         = static_cast<f64>(unused_bytes) > static_cast<f64>(block_bytes) * m_create_info.defragmentation_threshold;
+		const b8 fragmented             = unused_bytes >= m_create_info.defragmentation_min_unused_bytes && over_threshold;
+
+		if ((fragmented || near_allocation_limit) && frame_number >= m_next_defragmentation_frame && !is_defragmenting())
+		{
+			m_next_defragmentation_frame = frame_number + m_create_info.defragmentation_interval;
+			begin_defragmentation();
+		}
+	}
+
+	void memory_allocator::step_defragmentation(u64 frame_number)
+	{
+		std::lock_guard const lock(m_defragmentation_mutex);
+
+		if (m_defragmentation == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		switch (m_stage)
+		{
+			case defragmentation_stage::idle:
+				begin_defragmentation_pass();
+				break;
+
+			case defragmentation_stage::copying:
+				// Never blocks, the frame goes on with the old buffers until the copies are done.
+				if (m_create_info.p_dispatch->vkGetFenceStatus(m_create_info.device, m_fence) != VK_SUCCESS)
+				{
+					return;
+				}
+
+				swap_moved_buffers();
+				m_swap_frame = frame_number;
+				break;
+
+			case defragmentation_stage::swapped:
+				// Frames recorded before the swap may still read from the old place.
+				if (frame_number < m_swap_frame + m_create_info.frames_in_flight)
+				{
+					return;
+				}
+
+				end_defragmentation_pass();
+				break;
+		}
+	}
+
+	void memory_allocator::begin_defragmentation_pass()
+	{
+		const VkResult result = vmaBeginDefragmentationPass(m_allocator, m_defragmentation, &m_pass);
+
+		if (result == VK_SUCCESS)
+		{
+			// Nothing left to move.
+			VmaDefragmentationStats stats = {};
+			vmaEndDefragmentation(m_allocator, m_defragmentation, &stats);
+
+			m_defragmentation = VK_NULL_HANDLE;
+			m_defragmentation_statistics.bytes_freed += stats.bytesFreed;
+
+			log::info(log_source::renderer, "GPU memory defragmentation finished, {:.2f} MiB freed.", details::to_mebibytes(stats.bytesFreed));
+			return;
+		}
+
+		vk_ensure(result == VK_INCOMPLETE ? VK_SUCCESS : result, "Failed to begin defragmentation pass!");
+
+		m_old_buffers.assign(m_pass.moveCount, VK_NULL_HANDLE);
+		m_new_buffers.assign(m_pass.moveCount, VK_NULL_HANDLE);
+
+		vk_ensure(m_create_info.p_dispatch->vkResetCommandBuffer(m_command_buffer, 0), "Failed to reset defragmentation command buffer!");
+
+		VkCommandBufferBeginInfo begin_info = {};
+		begin_info.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vk_ensure(m_create_info.p_dispatch->vkBeginCommandBuffer(m_command_buffer, &begin_info), "Failed to begin defragmentation command buffer!");
+
+		u32 copies = 0;
+
+		for (u32 index = 0; index < m_pass.moveCount; ++index)
+		{
+			VmaDefragmentationMove& move = m_pass.pMoves[index];
+
+			VmaAllocationInfo allocation_info = {};
+			vmaGetAllocationInfo(m_allocator, move.srcAllocation, &allocation_info);
+
+			auto* p_buffer = static_cast<gpu_buffer*>(allocation_info.pUserData);
+
+			// Images and buffers that were not created as movable may be referenced by handle anywhere.
+			if (p_buffer == nullptr)
+			{
+				move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+				continue;
+			}
+
+			VkBufferCreateInfo buffer_create_info = {};
+			buffer_create_info.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			buffer_create_info.size               = p_buffer->m_size;
+			buffer_create_info.usage              = p_buffer->m_usage;
+			buffer_create_info.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+
+			vk_ensure(m_create_info.p_dispatch->vkCreateBuffer(m_create_info.device, &buffer_create_info, m_create_info.p_allocation_callbacks, &m_new_buffers[index]), "Failed to create defragmentation buffer!");
+			vk_ensure(vmaBindBufferMemory(m_allocator, move.dstTmpAllocation, m_new_buffers[index]), "Failed to bind defragmentation buffer!");
+
+			m_old_buffers[index] = p_buffer->m_buffer;
+
+			const VkBufferCopy region = { .srcOffset = 0, .dstOffset = 0, .size = p_buffer->m_size };
+			m_create_info.p_dispatch->vkCmdCopyBuffer(m_command_buffer, m_old_buffers[index], m_new_buffers[index], 1, &region);
+
+			m_defragmentation_statistics.moves += 1;
+			m_defragmentation_statistics.bytes_moved += p_buffer->m_size;
+			++copies;
+		}
+
+		// Whatever the frames do with the buffers afterwards has to see the copies.
+		VkMemoryBarrier barrier = {};
+		barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask   = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+		m_create_info.p_dispatch->vkCmdPipelineBarrier(m_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		vk_ensure(m_create_info.p_dispatch->vkEndCommandBuffer(m_command_buffer), "Failed to end defragmentation command buffer!");
+
+		m_defragmentation_statistics.passes += 1;
+
+		if (copies == 0)
+		{
+			end_defragmentation_pass();
+			return;
+		}
+
+		VkSubmitInfo submit_info       = {};
+		submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers    = &m_command_buffer;
+
+		vk_ensure(m_create_info.p_dispatch->vkResetFences(m_create_info.device, 1, &m_fence), "Failed to reset defragmentation fence!");
+		vk_ensure(m_create_info.p_dispatch->vkQueueSubmit(m_create_info.queue.first, 1, &submit_info, m_fence), "Failed to submit defragmentation copies!");
+
+		m_stage = defragmentation_stage::copying;
+	}
+
+	void memory_allocator::swap_moved_buffers()
+	{
+		for (u32 index = 0; index < m_pass.moveCount; ++index)
+		{
+			if (m_pass.pMoves[index].operation == VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY)
+			{
+				VmaAllocationInfo allocation_info = {};
+				vmaGetAllocationInfo(m_allocator, m_pass.pMoves[index].srcAllocation, &allocation_info);
+
+				static_cast<gpu_buffer*>(allocation_info.pUserData)->m_buffer = m_new_buffers[index];
+			}
+		}
+
+		m_stage = defragmentation_stage::swapped;
+	}
+
+	VmaDefragmentationMove* memory_allocator::find_move(VmaAllocation allocation)
+	{
+		for (u32 index = 0; index < m_pass.moveCount; ++index)
+		{
+			if (m_pass.pMoves[index].srcAllocation == allocation)
+			{
+				return &m_pass.pMoves[index];
+			}
+		}
+
+		return nullptr;
+	}
+
+	void memory_allocator::end_defragmentation_pass()
+	{
+		// Before ending the pass, which frees the memory the buffers are bound to and clears m_pass.
+		for (u32 index = 0; index < m_pass.moveCount; ++index)
+		{
+			m_create_info.p_dispatch->vkDestroyBuffer(m_create_info.device, m_old_buffers[index], m_create_info.p_allocation_callbacks);
+
+			// Released mid-move, neither place is referenced anymore.
+			if (m_pass.pMoves[index].operation == VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY)
+			{
+				m_create_info.p_dispatch->vkDestroyBuffer(m_create_info.device, m_new_buffers[index], m_create_info.p_allocation_callbacks);
+			}
+		}
+
+		const VkResult result = vmaEndDefragmentationPass(m_allocator, m_defragmentation, &m_pass);
+
+		m_old_buffers.clear();
+		m_new_buffers.clear();
+		m_pass  = {};
+		m_stage = defragmentation_stage::idle;
+
+		if (result == VK_SUCCESS)
+		{
+			VmaDefragmentationStats stats = {};
+			vmaEndDefragmentation(m_allocator, m_defragmentation, &stats);
+
+			m_defragmentation = VK_NULL_HANDLE;
+			m_defragmentation_statistics.bytes_freed += stats.bytesFreed;
+
+			log::info(log_source::renderer, "GPU memory defragmentation finished, {:.2f} MiB freed.", details::to_mebibytes(stats.bytesFreed));
+		}
+	}
+} // namespace cc::vk
@@ -0,0 +1,120 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/vulkan/offscreen_target.hpp"
+
+#include "capricorn/graphics/vulkan/memory_allocator.hpp"
+
+namespace cc::vk
+{
+	offscreen_target::offscreen_target(const offscreen_target_create_info& create_info) // NOLINT(modernize-pass-by-value)
+	    : m_create_info(create_info)
+	{
+		const auto p_device = m_create_info.p_device.lock();
+		ensure(p_device != nullptr, "Offscreen target requires a logical device!");
+		ensure(m_create_info.image_count > 0, "Offscreen target requires at least one image!");
+
+		const auto p_allocator = p_device->get_memory_allocator().lock();
+		ensure(p_allocator != nullptr, "Offscreen target requires a memory allocator!");
+
+		const VkDevice device                               = *p_device;
+		const device_dispatch& dispatch                     = p_device->get_dispatch();
+		const VkAllocationCallbacks* p_allocation_callbacks = p_device->get_allocation_callbacks();
+
+		m_images.resize(m_create_info.image_count, VK_NULL_HANDLE);
+		m_allocations.resize(m_create_info.image_count);
+		m_image_views.resize(m_create_info.image_count, VK_NULL_HANDLE);
+
+		for (u32 index = 0; index < m_create_info.image_count; index++)
+		{
+			VkImageCreateInfo image_create_info = {};
+			image_create_info.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			image_create_info.imageType         = VK_IMAGE_TYPE_2D;
+			image_create_info.format            = m_create_info.format;
+			image_create_info.extent            = { m_create_info.extent.width, m_create_info.extent.height, 1 };
+			image_create_info.mipLevels         = 1;
+			image_create_info.arrayLayers       = 1;
+			image_create_info.samples           = VK_SAMPLE_COUNT_1_BIT;
+			image_create_info.tiling            = VK_IMAGE_TILING_OPTIMAL;
+			image_create_info.usage             = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			image_create_info.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+			image_create_info.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			m_allocations[index] = p_allocator->create_image({
+			        .image    = image_create_info,
+			        .category = allocation_category::render_target,
+			        .p_name   = "offscreen target",
+			});
+
+			m_images[index] = m_allocations[index]->get_handle();
+
+			VkImageViewCreateInfo view_create_info           = {};
+			view_create_info.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			view_create_info.image                           = m_images[index];
+			view_create_info.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+			view_create_info.format                          = m_create_info.format;
+			view_create_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+			view_create_info.subresourceRange.baseMipLevel   = 0;
+			view_create_info.subresourceRange.levelCount     = 1;
+			view_create_info.subresourceRange.baseArrayLayer = 0;
+			view_create_info.subresourceRange.layerCount     = 1;
+
+			vk_ensure(dispatch.vkCreateImageView(device, &view_create_info, p_allocation_callbacks, &m_image_views[index]), "Failed to create offscreen image view!");
+		}
+
+		log::info(log_source::renderer, "Created {} offscreen images of {}x{}.", m_create_info.image_count, m_create_info.extent.width, m_create_info.extent.height);
+	}
+
+	offscreen_target::~offscreen_target()
+	{
+		const auto p_device = m_create_info.p_device.lock();
+
+		if (p_device == nullptr)
+		{
+			return;
+		}
+
+		const VkDevice device                               = *p_device;
+		const device_dispatch& dispatch                     = p_device->get_dispatch();
+		const VkAllocationCallbacks* p_allocation_callbacks = p_device->get_allocation_callbacks();
+
+		for (std::size_t index = 0; index < m_images.size(); index++)
+		{
+			dispatch.vkDestroyImageView(device, m_image_views[index], p_allocation_callbacks);
+		}
+
+		m_allocations.clear();
+	}
+
+	std::shared_ptr<offscreen_target> offscreen_target::create(const offscreen_target_create_info& create_info)
+	{
+		return std::make_shared<offscreen_target>(create_info);
+	}
+
+	u32 offscreen_target::acquire_next_image() noexcept
+	{
+		const u32 image = m_current_image;
+		m_current_image = (m_current_image + 1) % m_create_info.image_count;
+		return image;
+	}
+
+	const std::vector<VkImage>& offscreen_target::get_images() const
+	{
+		return m_images;
+	}
+
+	const std::vector<VkImageView>& offscreen_target::get_image_views() const
+	{
+		return m_image_views;
+	}
+
+	const VkExtent2D& offscreen_target::get_extent() const
+	{
+		return m_create_info.extent;
+	}
+
+	const VkFormat& offscreen_target::get_format() const
+	{
+		return m_create_info.format;
+	}
+} // namespace cc::vk
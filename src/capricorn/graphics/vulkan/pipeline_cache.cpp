@@ -0,0 +1,327 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/vulkan/pipeline_cache.hpp"
+
+#include "capricorn/base/hash.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+namespace cc::vk
+{
+	namespace details
+	{
+		constexpr std::array<char, 8> pipeline_cache_magic = { 'C', 'C', 'P', 'I', 'P', 'E', '\r', '\n' };
+		constexpr u32 pipeline_cache_version               = 1;
+
+		// Precedes the driver's blob on disk, so truncated or damaged files are caught before the driver sees them.
+		struct pipeline_cache_file_header
+		{
+			std::array<char, 8> magic = pipeline_cache_magic;
+			u32 version               = pipeline_cache_version;
+			u32 reserved              = 0;
+			u64 size                  = 0;
+			u64 checksum              = 0;
+		};
+
+		// The layout the Vulkan specification mandates for VK_PIPELINE_CACHE_HEADER_VERSION_ONE.
+		struct pipeline_cache_header_version_one
+		{
+			u32 header_size;
+			u32 header_version;
+			u32 vendor_id;
+			u32 device_id;
+			std::array<u8, VK_UUID_SIZE> pipeline_cache_uuid;
+		};
+	} // namespace details
+
+	pipeline_cache::pipeline_cache(const pipeline_cache_create_info& create_info)
+	    : m_create_info(create_info)
+	{
+		ensure(m_create_info.device != VK_NULL_HANDLE, "Pipeline cache requires a device!");
+		ensure(m_create_info.p_dispatch != nullptr, "Pipeline cache requires the device's dispatch table!");
+
+		load();
+
+		VkPipelineCacheCreateInfo cache_create_info = {};
+		cache_create_info.sType                     = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cache_create_info.initialDataSize           = m_initial_data.size();
+		cache_create_info.pInitialData              = m_initial_data.empty() ? nullptr : m_initial_data.data();
+
+		vk_ensure(m_create_info.p_dispatch->vkCreatePipelineCache(m_create_info.device, &cache_create_info, m_create_info.p_allocation_callbacks, &m_cache), "Failed to create pipeline cache!");
+	}
+
+	pipeline_cache::~pipeline_cache()
+	{
+		if (m_cache == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		merge_worker_caches();
+		save();
+
+		const pipeline_cache_statistics statistics = get_statistics();
+		if (statistics.pipelines != 0)
+		{
+			log::info(log_source::renderer,
+			          "Created {} pipelines ({} cache hits, {} misses) in {:.3f} ms, the slowest took {:.3f} ms.",
+			          statistics.pipelines,
+			          statistics.hits,
+			          statistics.misses,
+			          statistics.compile_seconds * 1000.0,
+			          statistics.max_compile_seconds * 1000.0);
+		}
+
+		m_create_info.p_dispatch->vkDestroyPipelineCache(m_create_info.device, m_cache, m_create_info.p_allocation_callbacks);
+	}
+
+	pipeline_cache::operator VkPipelineCache() const noexcept
+	{
+		return m_cache;
+	}
+
+	std::shared_ptr<pipeline_cache> pipeline_cache::create(const pipeline_cache_create_info& create_info)
+	{
+		return std::make_shared<pipeline_cache>(create_info);
+	}
+
+	template<typename CreateInfo, typename Function>
+	VkPipeline pipeline_cache::create_pipeline(CreateInfo create_info, VkPipelineCache cache, Function function)
+	{
+		VkPipelineCreationFeedbackEXT feedback                       = {};
+		VkPipelineCreationFeedbackCreateInfoEXT feedback_create_info = {};
+
+		if (m_create_info.creation_feedback)
+		{
+			feedback_create_info.sType                     = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+			feedback_create_info.pNext                     = create_info.pNext;
+			feedback_create_info.pPipelineCreationFeedback = &feedback;
+			create_info.pNext                              = &feedback_create_info;
+		}
+
+		VkPipeline pipeline = VK_NULL_HANDLE;
+
+		const clock::time_point start = clock::now();
+		vk_ensure(function(m_create_info.device, cache != VK_NULL_HANDLE ? cache : m_cache, 1, &create_info, m_create_info.p_allocation_callbacks, &pipeline), "Failed to create pipeline!");
+		const f64 seconds = std::chrono::duration<f64>(clock::now() - start).count();
+
+		std::lock_guard const lock(m_statistics_mutex);
+
+		++m_statistics.pipelines;
+		m_statistics.compile_seconds += seconds;
+		m_statistics.max_compile_seconds = std::max(m_statistics.max_compile_seconds, seconds);
+
+		if ((feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT) != 0)
+		{
+			const b8 hit = (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) != 0;
+			++(hit ? m_statistics.hits : m_statistics.misses);
+		}
+
+		return pipeline;
+	}
+
+	VkPipeline pipeline_cache::create_graphics_pipeline(const VkGraphicsPipelineCreateInfo& create_info, VkPipelineCache cache)
+	{
+		return create_pipeline(create_info, cache, m_create_info.p_dispatch->vkCreateGraphicsPipelines);
+	}
+
+	VkPipeline pipeline_cache::create_compute_pipeline(const VkComputePipelineCreateInfo& create_info, VkPipelineCache cache)
+	{
+		return create_pipeline(create_info, cache, m_create_info.p_dispatch->vkCreateComputePipelines);
+	}
+
+	VkPipelineCache pipeline_cache::create_worker_cache()
+	{
+		VkPipelineCacheCreateInfo cache_create_info = {};
+		cache_create_info.sType                     = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cache_create_info.initialDataSize           = m_initial_data.size();
+		cache_create_info.pInitialData              = m_initial_data.empty() ? nullptr : m_initial_data.data();
+
+		VkPipelineCache cache = VK_NULL_HANDLE;
+		vk_ensure(m_create_info.p_dispatch->vkCreatePipelineCache(m_create_info.device, &cache_create_info, m_create_info.p_allocation_callbacks, &cache), "Failed to create worker pipeline cache!");
+
+		std::lock_guard const lock(m_worker_mutex);
+		m_worker_caches.push_back(cache);
+
+		return cache;
+	}
+
+	void pipeline_cache::merge_worker_caches()
+	{
+		std::lock_guard const lock(m_worker_mutex);
+
+		if (m_worker_caches.empty())
+		{
+			return;
+		}
+
+		vk_ensure(m_create_info.p_dispatch->vkMergePipelineCaches(m_create_info.device, m_cache, static_cast<u32>(m_worker_caches.size()), m_worker_caches.data()), "Failed to merge pipeline caches!");
+
+		for (VkPipelineCache const cache: m_worker_caches)
+		{
+			m_create_info.p_dispatch->vkDestroyPipelineCache(m_create_info.device, cache, m_create_info.p_allocation_callbacks);
+		}
+
+		m_worker_caches.clear();
+
+		std::lock_guard const statistics_lock(m_statistics_mutex);
+		++m_statistics.merges;
+	}
+
+	void pipeline_cache::update()
+	{
+		if (m_create_info.autosave_interval_seconds <= 0.0 || clock::now() - m_last_save < std::chrono::duration<f64>(m_create_info.autosave_interval_seconds))
+		{
+			return;
+		}
+
+		// Worker caches are folded in but kept, their threads may still be compiling into them.
+		{
+			std::lock_guard const lock(m_worker_mutex);
+
+			if (!m_worker_caches.empty())
+			{
+				vk_ensure(m_create_info.p_dispatch->vkMergePipelineCaches(m_create_info.device, m_cache, static_cast<u32>(m_worker_caches.size()), m_worker_caches.data()), "Failed to merge pipeline caches!");
+			}
+		}
+
+		save();
+	}
+
+	void pipeline_cache::save()
+	{
+		m_last_save = clock::now();
+
+		const u64 pipelines = get_statistics().pipelines;
+
+		// Nothing was compiled since the last save, or since loading, so the file is already up to date.
+		if (m_create_info.p_path == nullptr || pipelines == m_saved_pipelines)
+		{
+			return;
+		}
+
+		std::size_t size = 0;
+		vk_ensure(m_create_info.p_dispatch->vkGetPipelineCacheData(m_create_info.device, m_cache, &size, nullptr), "Failed to get pipeline cache size!");
+
+		std::vector<u8> data(size);
+		vk_ensure(m_create_info.p_dispatch->vkGetPipelineCacheData(m_create_info.device, m_cache, &size, data.data()), "Failed to get pipeline cache data!");
+		data.resize(size);
+
+		details::pipeline_cache_file_header header;
+		header.size     = data.size();
+		header.checksum = fnv1a(data.data(), data.size());
+
+		const std::filesystem::path path           = m_create_info.p_path;
+		const std::filesystem::path temporary_path = path.string() + ".tmp";
+
+		{
+			std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+			if (!file)
+			{
+				log::warning(log_source::renderer, "Failed to write pipeline cache {}.", temporary_path.string());
+				return;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporary_path, path, error);
+
+		if (error)
+		{
+			log::warning(log_source::renderer, "Failed to replace pipeline cache {}: {}.", path.string(), error.message());
+			return;
+		}
+
+		m_saved_pipelines = pipelines;
+
+		std::lock_guard const lock(m_statistics_mutex);
+		m_statistics.saved_bytes = data.size();
+	}
+
+	pipeline_cache_statistics pipeline_cache::get_statistics() const
+	{
+		std::lock_guard const lock(m_statistics_mutex);
+		return m_statistics;
+	}
+
+	void pipeline_cache::load()
+	{
+		if (m_create_info.p_path == nullptr)
+		{
+			return;
+		}
+
+		std::ifstream file(m_create_info.p_path, std::ios::binary);
+		if (!file)
+		{
+			return;
+		}
+
+		details::pipeline_cache_file_header header;
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+		if (!file)
+		{
+			log::warning(log_source::renderer, "Ignoring pipeline cache {}, it is truncated or corrupted.", m_create_info.p_path);
+			return;
+		}
+
+		if (header.magic != details::pipeline_cache_magic || header.version != details::pipeline_cache_version)
+		{
+			log::warning(log_source::renderer, "Ignoring pipeline cache {}, it was not written by this version.", m_create_info.p_path);
+			return;
+		}
+
+		std::error_code error;
+		const std::uintmax_t file_size = std::filesystem::file_size(m_create_info.p_path, error);
+
+		// Checked before allocating, a damaged size field could ask for anything.
+		if (error || header.size != file_size - sizeof(header))
+		{
+			log::warning(log_source::renderer, "Ignoring pipeline cache {}, it is truncated or corrupted.", m_create_info.p_path);
+			return;
+		}
+
+		std::vector<u8> data(static_cast<std::size_t>(header.size));
+		file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+		if (!file || fnv1a(data.data(), data.size()) != header.checksum)
+		{
+			log::warning(log_source::renderer, "Ignoring pipeline cache {}, it is truncated or corrupted.", m_create_info.p_path);
+			return;
+		}
+
+		if (!is_compatible(data))
+		{
+			// Expected after a driver update or when the file was copied from another machine.
+			log::info(log_source::renderer, "Ignoring pipeline cache {}, it was created for another device or driver.", m_create_info.p_path);
+			return;
+		}
+
+		m_initial_data = std::move(data);
+
+		m_statistics.loaded_bytes = m_initial_data.size();
+
+		log::info(log_source::renderer, "Loaded {} bytes of pipeline cache from {}.", m_initial_data.size(), m_create_info.p_path);
+	}
+
+	b8 pipeline_cache::is_compatible(const std::vector<u8>& data) const
+	{
+		details::pipeline_cache_header_version_one header = {};
+
+		if (data.size() < sizeof(header))
+		{
+			return false;
+		}
+
+		std::memcpy(&header, data.data(), sizeof(header));
+
+		return header.header_size >= sizeof(header) && header.header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE && header.vendor_id == m_create_info.properties.vendorID &&
+		       header.device_id == m_create_info.properties.deviceID && std::equal(header.pipeline_cache_uuid.begin(), header.pipeline_cache_uuid.end(), std::begin(m_create_info.properties.pipelineCacheUUID));
+	}
+} // namespace cc::vk
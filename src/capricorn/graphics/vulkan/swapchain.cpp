@@ -3,6 +3,381 @@
 
 #include "capricorn/graphics/vulkan/swapchain.hpp"
 
+#include "capricorn/graphics/vulkan/vulkan_utils.hpp"
+#include "capricorn/memory/scratch_arena.hpp"
+
 namespace cc::vk
 {
-} // namespace cc
\ No newline at end of file
+	namespace details
+	{
+		VkSurfaceFormatKHR choose_surface_format(const std::pmr::vector<VkSurfaceFormatKHR>& formats)
+		{
+			for (const auto& format: formats)
+			{
+				if (format.format == VK_FORMAT_B8G8R8A8_SRGB && format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
+				{
+					return format;
+				}
+			}
+
+			return formats.front();
+		}
+
+		VkPresentModeKHR choose_present_mode(const std::pmr::vector<VkPresentModeKHR>& present_modes, present_policy policy)
+		{
+			const auto is_supported = [&present_modes](VkPresentModeKHR present_mode) {
+				return std::find(present_modes.begin(), present_modes.end(), present_mode) != present_modes.end();
+			};
+
+			switch (policy)
+			{
+				case present_policy::low_latency:
+					if (is_supported(VK_PRESENT_MODE_MAILBOX_KHR))
+						return VK_PRESENT_MODE_MAILBOX_KHR;
+					break;
+				case present_policy::uncapped:
+					if (is_supported(VK_PRESENT_MODE_IMMEDIATE_KHR))
+						return VK_PRESENT_MODE_IMMEDIATE_KHR;
+					if (is_supported(VK_PRESENT_MODE_MAILBOX_KHR))
+						return VK_PRESENT_MODE_MAILBOX_KHR;
+					break;
+				case present_policy::power_saving:
+					break;
+			}
+
+			// The only mode every implementation has to support.
+			return VK_PRESENT_MODE_FIFO_KHR;
+		}
+
+		VkExtent2D choose_extent(const VkSurfaceCapabilitiesKHR& capabilities, VkExtent2D requested)
+		{
+			if (capabilities.currentExtent.width != std::numeric_limits<u32>::max())
+			{
+				return capabilities.currentExtent;
+			}
+
+			return {
+			        std::clamp(requested.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width),
+			        std::clamp(requested.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height),
+			};
+		}
+
+		const char* get_present_mode_name(VkPresentModeKHR present_mode)
+		{
+			switch (present_mode)
+			{
+				case VK_PRESENT_MODE_IMMEDIATE_KHR:
+					return "immediate";
+				case VK_PRESENT_MODE_MAILBOX_KHR:
+					return "mailbox";
+				case VK_PRESENT_MODE_FIFO_KHR:
+					return "fifo";
+				case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+					return "fifo relaxed";
+				default:
+					return "unknown";
+			}
+		}
+	} // namespace details
+
+	swapchain::swapchain(const swapchain_create_info& create_info) // NOLINT(modernize-pass-by-value)
+	    : m_create_info(create_info)
+	{
+		const auto p_device = m_create_info.p_device.lock();
+		ensure(p_device != nullptr, "Swapchain requires a logical device!");
+		ensure(!m_create_info.p_instance.expired(), "Swapchain requires an instance!");
+		ensure(!m_create_info.p_surface.expired(), "Swapchain requires a surface!");
+		ensure(p_device->can_present(), "Swapchain requires a device that can present!");
+
+		m_device                 = *p_device;
+		m_p_dispatch             = &p_device->get_dispatch();
+		m_p_allocation_callbacks = p_device->get_allocation_callbacks();
+
+		recreate();
+	}
+
+	swapchain::~swapchain()
+	{
+		if (m_device == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		// Presents may still be reading from the images, retired or not.
+		m_p_dispatch->vkDeviceWaitIdle(m_device);
+
+		for (const auto& retired: m_retired)
+		{
+			destroy_resources(retired.swapchain, retired.image_views, retired.render_finished);
+		}
+
+		destroy_resources(m_swapchain, m_swapchain_image_views, m_render_finished);
+	}
+
+	std::shared_ptr<swapchain> swapchain::create(const swapchain_create_info& create_info)
+	{
+		return std::make_shared<swapchain>(create_info);
+	}
+
+	std::optional<u32> swapchain::acquire_next_image(VkSemaphore image_available, u64 frame_number)
+	{
+		m_frame_number = frame_number;
+
+		if (m_recreate_requested)
+		{
+			recreate();
+
+			// Still minimized.
+			if (m_recreate_requested)
+			{
+				return std::nullopt;
+			}
+		}
+
+		u32 image_index       = 0;
+		const VkResult result = m_p_dispatch->vkAcquireNextImageKHR(m_device, m_swapchain, std::numeric_limits<u64>::max(), image_available, VK_NULL_HANDLE, &image_index);
+
+		if (result == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			// Nothing was acquired and the semaphore stays unsignaled, so the frame can simply be skipped.
+			recreate();
+			return std::nullopt;
+		}
+
+		if (result == VK_SUBOPTIMAL_KHR)
+		{
+			// The image was acquired and the semaphore will be signaled, so use it and recreate afterwards.
+			m_recreate_requested = true;
+		}
+		else
+		{
+			vk_ensure(result, "Failed to acquire swapchain image!");
+		}
+
+		return image_index;
+	}
+
+	void swapchain::present(VkQueue queue, u32 image_index)
+	{
+		VkPresentInfoKHR present_info   = {};
+		present_info.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		present_info.waitSemaphoreCount = 1;
+		present_info.pWaitSemaphores    = &m_render_finished[image_index];
+		present_info.swapchainCount     = 1;
+		present_info.pSwapchains        = &m_swapchain;
+		present_info.pImageIndices      = &image_index;
+
+		const VkResult result = m_p_dispatch->vkQueuePresentKHR(queue, &present_info);
+
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+		{
+			m_recreate_requested = true;
+			return;
+		}
+
+		vk_ensure(result, "Failed to present swapchain image!");
+	}
+
+	void swapchain::request_recreate(VkExtent2D extent) noexcept
+	{
+		m_create_info.extent = extent;
+		m_recreate_requested = true;
+	}
+
+	void swapchain::release_retired(u64 completed_frame)
+	{
+		std::erase_if(m_retired, [this, completed_frame](const retired_swapchain& retired) {
+			if (retired.frame_number > completed_frame)
+			{
+				return false;
+			}
+
+			destroy_resources(retired.swapchain, retired.image_views, retired.render_finished);
+			return true;
+		});
+	}
+
+	const std::vector<VkImage>& swapchain::get_images() const
+	{
+		return m_swapchain_images;
+	}
+
+	const std::vector<VkImageView>& swapchain::get_image_views() const
+	{
+		return m_swapchain_image_views;
+	}
+
+	const VkExtent2D& swapchain::get_extent() const
+	{
+		return m_swapchain_extent;
+	}
+
+	const VkFormat& swapchain::get_format() const
+	{
+		return m_swapchain_image_format;
+	}
+
+	const VkSwapchainKHR& swapchain::get_swapchain() const
+	{
+		return m_swapchain;
+	}
+
+	VkPresentModeKHR swapchain::get_present_mode() const noexcept
+	{
+		return m_present_mode;
+	}
+
+	VkSemaphore swapchain::get_render_finished_semaphore(u32 image_index) const
+	{
+		return m_render_finished[image_index];
+	}
+
+	u32 swapchain::get_recreation_count() const noexcept
+	{
+		return m_recreation_count;
+	}
+
+	void swapchain::recreate()
+	{
+		const auto p_instance      = m_create_info.p_instance.lock();
+		const auto p_device        = m_create_info.p_device.lock();
+		const VkSurfaceKHR surface = *m_create_info.p_surface.lock();
+
+		scratch_arena const scratch;
+		const details::swap_chain_support_details support = details::query_swap_chain_support(p_instance->get_dispatch(), p_device->get_physical_device(), surface, scratch.get_resource());
+
+		const VkExtent2D extent = details::choose_extent(support.capabilities, m_create_info.extent);
+
+		if (extent.width == 0 || extent.height == 0)
+		{
+			// Minimized, there is nothing to present to until the window comes back.
+			m_recreate_requested = true;
+			return;
+		}
+
+		if ((support.capabilities.supportedUsageFlags & m_create_info.image_usage) != m_create_info.image_usage)
+		{
+			log::error(log_source::renderer, "The surface does not support the requested swapchain image usage.");
+			throw std::runtime_error("The surface does not support the requested swapchain image usage.");
+		}
+
+		const VkSurfaceFormatKHR surface_format = details::choose_surface_format(support.formats);
+		m_present_mode                          = details::choose_present_mode(support.present_modes, m_create_info.policy);
+
+		u32 image_count = std::max(m_create_info.image_count, support.capabilities.minImageCount);
+
+		if (support.capabilities.maxImageCount != 0)
+		{
+			image_count = std::min(image_count, support.capabilities.maxImageCount);
+		}
+
+		VkCompositeAlphaFlagBitsKHR composite_alpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+
+		if ((support.capabilities.supportedCompositeAlpha & composite_alpha) == 0)
+		{
+			// Some compositors only offer inherit or premultiplied, take the lowest bit they do support.
+			composite_alpha = static_cast<VkCompositeAlphaFlagBitsKHR>(support.capabilities.supportedCompositeAlpha & (~support.capabilities.supportedCompositeAlpha + 1));
+		}
+
+		const std::array<u32, 2> queue_families = { p_device->get_graphics_queue().second, p_device->get_present_queue().second };
+
+		VkSwapchainCreateInfoKHR swapchain_create_info = {};
+		swapchain_create_info.sType                    = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+		swapchain_create_info.surface                  = surface;
+		swapchain_create_info.minImageCount            = image_count;
+		swapchain_create_info.imageFormat              = surface_format.format;
+		swapchain_create_info.imageColorSpace          = surface_format.colorSpace;
+		swapchain_create_info.imageExtent              = extent;
+		swapchain_create_info.imageArrayLayers         = 1;
+		swapchain_create_info.imageUsage               = m_create_info.image_usage;
+		swapchain_create_info.preTransform             = support.capabilities.currentTransform;
+		swapchain_create_info.compositeAlpha           = composite_alpha;
+		swapchain_create_info.presentMode              = m_present_mode;
+		swapchain_create_info.clipped                  = VK_TRUE;
+		swapchain_create_info.oldSwapchain             = m_swapchain;
+
+		if (queue_families[0] != queue_families[1])
+		{
+			swapchain_create_info.imageSharingMode      = VK_SHARING_MODE_CONCURRENT;
+			swapchain_create_info.queueFamilyIndexCount = static_cast<u32>(queue_families.size());
+			swapchain_create_info.pQueueFamilyIndices   = queue_families.data();
+		}
+		else
+		{
+			swapchain_create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		}
+
+		VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+		vk_ensure(m_p_dispatch->vkCreateSwapchainKHR(m_device, &swapchain_create_info, m_p_allocation_callbacks, &swapchain), "Failed to create swapchain!");
+
+		if (m_swapchain != VK_NULL_HANDLE)
+		{
+			// Frames in flight may still present from the old images, keep them until those frames have completed.
+			m_retired.push_back({
+			        .swapchain       = m_swapchain,
+			        .image_views     = std::move(m_swapchain_image_views),
+			        .render_finished = std::move(m_render_finished),
+			        .frame_number    = m_frame_number,
+			});
+
+			m_swapchain_image_views.clear();
+			m_render_finished.clear();
+
+			++m_recreation_count;
+		}
+
+		m_swapchain              = swapchain;
+		m_swapchain_extent       = extent;
+		m_swapchain_image_format = surface_format.format;
+
+		vk_ensure(enumerate_vulkan_construct<VkImage>(m_swapchain_images, m_p_dispatch->vkGetSwapchainImagesKHR, m_device, m_swapchain), "Failed to get swapchain images!");
+
+		m_swapchain_image_views.resize(m_swapchain_images.size(), VK_NULL_HANDLE);
+		m_render_finished.resize(m_swapchain_images.size(), VK_NULL_HANDLE);
+
+		for (std::size_t index = 0; index < m_swapchain_images.size(); index++)
+		{
+			VkImageViewCreateInfo view_create_info           = {};
+			view_create_info.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			view_create_info.image                           = m_swapchain_images[index];
+			view_create_info.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+			view_create_info.format                          = m_swapchain_image_format;
+			view_create_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+			view_create_info.subresourceRange.baseMipLevel   = 0;
+			view_create_info.subresourceRange.levelCount     = 1;
+			view_create_info.subresourceRange.baseArrayLayer = 0;
+			view_create_info.subresourceRange.layerCount     = 1;
+
+			vk_ensure(m_p_dispatch->vkCreateImageView(m_device, &view_create_info, m_p_allocation_callbacks, &m_swapchain_image_views[index]), "Failed to create swapchain image view!");
+
+			VkSemaphoreCreateInfo semaphore_create_info = {};
+			semaphore_create_info.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+			vk_ensure(m_p_dispatch->vkCreateSemaphore(m_device, &semaphore_create_info, m_p_allocation_callbacks, &m_render_finished[index]), "Failed to create swapchain semaphore!");
+		}
+
+		m_recreate_requested = false;
+
+		log::info(log_source::renderer,
+		          "Created swapchain with {} images of {}x{}, presenting in {} mode.",
+		          m_swapchain_images.size(),
+		          extent.width,
+		          extent.height,
+		          details::get_present_mode_name(m_present_mode));
+	}
+
+	void swapchain::destroy_resources(VkSwapchainKHR swapchain, const std::vector<VkImageView>& image_views, const std::vector<VkSemaphore>& render_finished) const
+	{
+		for (VkImageView const image_view: image_views)
+		{
+			m_p_dispatch->vkDestroyImageView(m_device, image_view, m_p_allocation_callbacks);
+		}
+
+		for (VkSemaphore const semaphore: render_finished)
+		{
+			m_p_dispatch->vkDestroySemaphore(m_device, semaphore, m_p_allocation_callbacks);
+		}
+
+		m_p_dispatch->vkDestroySwapchainKHR(m_device, swapchain, m_p_allocation_callbacks);
+	}
+} // namespace cc::vk
@@ -0,0 +1,592 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/vulkan/upload_service.hpp"
+
+#include "capricorn/graphics/vulkan/memory_allocator.hpp"
+#include "capricorn/memory/scratch_arena.hpp"
+
+namespace cc::vk
+{
+	namespace details
+	{
+		constexpr u64 align_up(u64 value, u64 alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	} // namespace details
+
+	upload_service::upload_service(const upload_service_create_info& create_info)
+	    : m_create_info(create_info),
+	      m_device(create_info.p_device.lock())
+	{
+		ensure(m_device != nullptr, "Upload service requires a logical device!");
+
+		m_allocator = m_device->get_memory_allocator().lock();
+		ensure(m_allocator != nullptr, "Upload service requires a memory allocator!");
+
+		m_transfer_queue     = m_device->get_transfer_queue();
+		m_graphics_family    = m_device->get_graphics_queue().second;
+		m_ownership_transfer = m_device->has_dedicated_transfer_queue();
+
+		// 16 covers the texel block size of every format; the ring size has to be a multiple so wrapping keeps the alignment.
+		m_alignment             = std::max<VkDeviceSize>(16, m_device->get_properties().limits.optimalBufferCopyOffsetAlignment);
+		m_create_info.ring_size = details::align_up(m_create_info.ring_size, m_alignment);
+
+		m_ring = m_allocator->create_buffer({
+		        .size     = m_create_info.ring_size,
+		        .usage    = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		        .memory   = memory_usage::upload,
+		        .category = allocation_category::staging,
+		        .p_name   = "staging ring",
+		});
+
+		if (m_device->has_timeline_semaphore())
+		{
+			const VkDevice device                               = *m_device;
+			const device_dispatch& dispatch                     = m_device->get_dispatch();
+			const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+
+			VkSemaphoreTypeCreateInfoKHR type_create_info = {};
+			type_create_info.sType                        = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+			type_create_info.semaphoreType                = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+			type_create_info.initialValue                 = 0;
+
+			VkSemaphoreCreateInfo semaphore_create_info = {};
+			semaphore_create_info.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			semaphore_create_info.pNext                 = &type_create_info;
+
+			vk_ensure(dispatch.vkCreateSemaphore(device, &semaphore_create_info, p_allocation_callbacks, &m_timeline), "Failed to create upload timeline semaphore!");
+		}
+
+		log::info(log_source::renderer,
+		          "Upload service created with a {} MiB staging ring on queue family {}{}.",
+		          m_create_info.ring_size / (1024 * 1024),
+		          m_transfer_queue.second,
+		          m_timeline != VK_NULL_HANDLE ? "" : ", without timeline semaphores");
+	}
+
+	upload_service::~upload_service()
+	{
+		if (m_device == nullptr)
+		{
+			return;
+		}
+
+		const VkDevice device                               = *m_device;
+		const device_dispatch& dispatch                     = m_device->get_dispatch();
+		const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+
+		{
+			std::lock_guard const lock(m_mutex);
+
+			submit();
+			dispatch.vkQueueWaitIdle(m_transfer_queue.first);
+			collect_completed();
+		}
+
+		for (const batch& batch: m_free_batches)
+		{
+			dispatch.vkDestroyFence(device, batch.fence, p_allocation_callbacks);
+			dispatch.vkDestroyCommandPool(device, batch.command_pool, p_allocation_callbacks);
+		}
+
+		if (m_timeline != VK_NULL_HANDLE)
+		{
+			dispatch.vkDestroySemaphore(device, m_timeline, p_allocation_callbacks);
+		}
+
+		const upload_statistics statistics = get_statistics();
+		if (statistics.uploads != 0)
+		{
+			log::info(log_source::renderer,
+			          "Uploaded {:.2f} MiB in {} uploads and {} batches, {} stalled on ring space and {} were too large for it.",
+			          static_cast<f64>(statistics.bytes) / (1024.0 * 1024.0),
+			          statistics.uploads,
+			          statistics.batches,
+			          statistics.ring_stalls,
+			          statistics.oversized);
+		}
+
+		m_ring.reset();
+	}
+
+	std::shared_ptr<upload_service> upload_service::create(const upload_service_create_info& create_info)
+	{
+		return std::make_shared<upload_service>(create_info);
+	}
+
+	upload_token upload_service::upload_buffer(const gpu_buffer& destination, VkDeviceSize offset, const void* p_data, VkDeviceSize size)
+	{
+		ensure(size != 0, "Cannot upload zero bytes!");
+		ensure(offset + size <= destination.get_size(), "Upload does not fit into the destination buffer!");
+
+		std::lock_guard const lock(m_mutex);
+
+		const staging_allocation staging = allocate(size);
+
+		std::memcpy(staging.p_data, p_data, size);
+		m_allocator->flush(staging.p_owner != nullptr ? *staging.p_owner : *m_ring, staging.offset, size);
+
+		batch& batch = get_recording_batch();
+
+		if (staging.p_owner != nullptr)
+		{
+			batch.oversized.push_back(staging.p_owner);
+		}
+
+		const VkBufferCopy region = { .srcOffset = staging.offset, .dstOffset = offset, .size = size };
+		m_device->get_dispatch().vkCmdCopyBuffer(batch.command_buffer, staging.buffer, destination.get_handle(), 1, &region);
+
+		if (m_ownership_transfer)
+		{
+			VkBufferMemoryBarrier barrier = {};
+			barrier.sType                 = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask         = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask         = 0;
+			barrier.srcQueueFamilyIndex   = m_transfer_queue.second;
+			barrier.dstQueueFamilyIndex   = m_graphics_family;
+			barrier.buffer                = destination.get_handle();
+			barrier.offset                = offset;
+			barrier.size                  = size;
+
+			// The release half; the destination stage does not matter, the acquire on the graphics queue decides.
+			m_device->get_dispatch().vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = m_create_info.destination_access;
+			get_pending_acquire().buffers.push_back(barrier);
+
+			m_statistics.ownership_moves += 1;
+		}
+
+		return finish_upload(batch, size);
+	}
+
+	upload_token upload_service::upload_image(const gpu_image& destination, const void* p_data, VkDeviceSize size, std::span<const VkBufferImageCopy> regions, VkImageLayout final_layout)
+	{
+		ensure(size != 0 && !regions.empty(), "Cannot upload an empty image!");
+
+		std::lock_guard const lock(m_mutex);
+
+		const staging_allocation staging = allocate(size);
+
+		std::memcpy(staging.p_data, p_data, size);
+		m_allocator->flush(staging.p_owner != nullptr ? *staging.p_owner : *m_ring, staging.offset, size);
+
+		batch& batch = get_recording_batch();
+
+		if (staging.p_owner != nullptr)
+		{
+			batch.oversized.push_back(staging.p_owner);
+		}
+
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask        = 0;
+		barrier.dstAccessMask        = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout            = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image                = destination.get_handle();
+		barrier.subresourceRange     = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+
+		// The previous contents are replaced, so there is nothing to wait for.
+		m_device->get_dispatch().vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		scratch_arena const scratch;
+		std::pmr::vector<VkBufferImageCopy> staged_regions(regions.begin(), regions.end(), scratch.get_resource());
+
+		for (VkBufferImageCopy& region: staged_regions)
+		{
+			region.bufferOffset += staging.offset;
+		}
+
+		m_device->get_dispatch().vkCmdCopyBufferToImage(batch.command_buffer, staging.buffer, destination.get_handle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<u32>(staged_regions.size()), staged_regions.data());
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout     = final_layout;
+
+		if (m_ownership_transfer)
+		{
+			barrier.dstAccessMask       = 0;
+			barrier.srcQueueFamilyIndex = m_transfer_queue.second;
+			barrier.dstQueueFamilyIndex = m_graphics_family;
+
+			// Release and acquire have to describe the same layout transition.
+			m_device->get_dispatch().vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = m_create_info.destination_access;
+			get_pending_acquire().images.push_back(barrier);
+
+			m_statistics.ownership_moves += 1;
+		}
+		else
+		{
+			barrier.dstAccessMask = m_create_info.destination_access;
+
+			m_device->get_dispatch().vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, m_create_info.destination_stages, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+		return finish_upload(batch, size);
+	}
+
+	upload_token upload_service::flush()
+	{
+		std::lock_guard const lock(m_mutex);
+		return submit();
+	}
+
+	void upload_service::update()
+	{
+		std::lock_guard const lock(m_mutex);
+		collect_completed();
+	}
+
+	b8 upload_service::is_complete(upload_token token)
+	{
+		std::lock_guard const lock(m_mutex);
+
+		collect_completed();
+		return token <= m_completed_token;
+	}
+
+	void upload_service::wait(upload_token token)
+	{
+		std::unique_lock lock(m_mutex);
+
+		ensure(token < m_next_token || (m_recording.has_value() && token == m_recording->token), "Waiting on an upload that was never made!");
+
+		collect_completed();
+
+		if (token <= m_completed_token)
+		{
+			return;
+		}
+
+		if (m_recording.has_value() && m_recording->token <= token)
+		{
+			// A shared queue is the frame thread's to submit to, which flushes before it waits.
+			ensure(m_ownership_transfer, "Waiting on an upload that was not flushed!");
+			submit();
+		}
+
+		if (m_timeline != VK_NULL_HANDLE)
+		{
+			// Other threads can keep uploading meanwhile.
+			lock.unlock();
+
+			VkSemaphoreWaitInfoKHR wait_info = {};
+			wait_info.sType                  = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+			wait_info.semaphoreCount         = 1;
+			wait_info.pSemaphores            = &m_timeline;
+			wait_info.pValues                = &token;
+
+			vk_ensure(m_device->get_dispatch().vkWaitSemaphores(*m_device, &wait_info, std::numeric_limits<u64>::max()), "Failed to wait for upload!");
+			return;
+		}
+
+		while (m_completed_token < token)
+		{
+			wait_for_oldest();
+		}
+	}
+
+	upload_token upload_service::get_completed_token()
+	{
+		std::lock_guard const lock(m_mutex);
+
+		collect_completed();
+		return m_completed_token;
+	}
+
+	void upload_service::acquire(VkCommandBuffer command_buffer, upload_token token)
+	{
+		std::lock_guard const lock(m_mutex);
+
+		scratch_arena const scratch;
+		std::pmr::vector<VkBufferMemoryBarrier> buffers(scratch.get_resource());
+		std::pmr::vector<VkImageMemoryBarrier> images(scratch.get_resource());
+
+		while (!m_pending_acquires.empty() && m_pending_acquires.front().token <= token)
+		{
+			const pending_acquire& pending = m_pending_acquires.front();
+
+			buffers.insert(buffers.end(), pending.buffers.begin(), pending.buffers.end());
+			images.insert(images.end(), pending.images.begin(), pending.images.end());
+
+			m_pending_acquires.pop_front();
+		}
+
+		if (buffers.empty() && images.empty())
+		{
+			return;
+		}
+
+		m_device->get_dispatch().vkCmdPipelineBarrier(command_buffer,
+		                                              VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		                                              m_create_info.destination_stages,
+		                                              0,
+		                                              0,
+		                                              nullptr,
+		                                              static_cast<u32>(buffers.size()),
+		                                              buffers.data(),
+		                                              static_cast<u32>(images.size()),
+		                                              images.data());
+	}
+
+	b8 upload_service::has_timeline_semaphore() const noexcept
+	{
+		return m_timeline != VK_NULL_HANDLE;
+	}
+
+	VkSemaphore upload_service::get_timeline_semaphore() const noexcept
+	{
+		return m_timeline;
+	}
+
+	upload_statistics upload_service::get_statistics() const
+	{
+		std::lock_guard const lock(m_mutex);
+		return m_statistics;
+	}
+
+	upload_service::staging_allocation upload_service::allocate(VkDeviceSize size)
+	{
+		const VkDeviceSize ring_size = m_create_info.ring_size;
+
+		// Anything this large would keep the ring blocked for a long time, it gets a buffer of its own instead.
+		if (size > ring_size / 2)
+		{
+			m_statistics.oversized += 1;
+			return allocate_dedicated(size);
+		}
+
+		b8 stalled = false;
+
+		while (true)
+		{
+			collect_completed();
+
+			u64 start = details::align_up(m_ring_head, m_alignment);
+
+			// Never straddle the end, skip to the start of the ring instead.
+			if (start % ring_size + size > ring_size)
+			{
+				start = details::align_up(start, ring_size);
+			}
+
+			if (start + size - m_ring_tail <= ring_size)
+			{
+				m_ring_head = start + size;
+
+				const VkDeviceSize offset = start % ring_size;
+				return { .buffer = m_ring->get_handle(), .offset = offset, .p_data = static_cast<u8*>(m_ring->get_mapped_data()) + offset };
+			}
+
+			if (!stalled)
+			{
+				m_statistics.ring_stalls += 1;
+				stalled = true;
+			}
+
+			// The space may be held by the batch that is still recording. Uploads come from any thread, and a shared queue
+			// is only submitted to from the frame thread, so there the upload gets a staging buffer of its own instead.
+			if (m_in_flight.empty())
+			{
+				if (!m_ownership_transfer)
+				{
+					return allocate_dedicated(size);
+				}
+
+				submit();
+			}
+
+			wait_for_oldest();
+		}
+	}
+
+	upload_service::staging_allocation upload_service::allocate_dedicated(VkDeviceSize size)
+	{
+		std::shared_ptr<gpu_buffer> p_owner = m_allocator->create_buffer({
+		        .size     = size,
+		        .usage    = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		        .memory   = memory_usage::upload,
+		        .category = allocation_category::staging,
+		        .p_name   = "oversized staging",
+		});
+
+		return { .buffer = p_owner->get_handle(), .offset = 0, .p_data = static_cast<u8*>(p_owner->get_mapped_data()), .p_owner = std::move(p_owner) };
+	}
+
+	upload_service::batch& upload_service::get_recording_batch()
+	{
+		if (m_recording.has_value())
+		{
+			return *m_recording;
+		}
+
+		const VkDevice device                               = *m_device;
+		const device_dispatch& dispatch                     = m_device->get_dispatch();
+		const VkAllocationCallbacks* p_allocation_callbacks = m_device->get_allocation_callbacks();
+
+		if (!m_free_batches.empty())
+		{
+			m_recording = std::move(m_free_batches.back());
+			m_free_batches.pop_back();
+		}
+		else
+		{
+			m_recording.emplace();
+
+			VkCommandPoolCreateInfo pool_create_info = {};
+			pool_create_info.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			pool_create_info.flags                   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			pool_create_info.queueFamilyIndex        = m_transfer_queue.second;
+
+			vk_ensure(dispatch.vkCreateCommandPool(device, &pool_create_info, p_allocation_callbacks, &m_recording->command_pool), "Failed to create upload command pool!");
+
+			VkCommandBufferAllocateInfo allocate_info = {};
+			allocate_info.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocate_info.commandPool                 = m_recording->command_pool;
+			allocate_info.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocate_info.commandBufferCount          = 1;
+
+			vk_ensure(dispatch.vkAllocateCommandBuffers(device, &allocate_info, &m_recording->command_buffer), "Failed to allocate upload command buffer!");
+
+			VkFenceCreateInfo fence_create_info = {};
+			fence_create_info.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+			vk_ensure(dispatch.vkCreateFence(device, &fence_create_info, p_allocation_callbacks, &m_recording->fence), "Failed to create upload fence!");
+		}
+
+		m_recording->token        = m_next_token;
+		m_recording->ring_end     = m_ring_head;
+		m_recording->staged_bytes = 0;
+
+		VkCommandBufferBeginInfo begin_info = {};
+		begin_info.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vk_ensure(dispatch.vkBeginCommandBuffer(m_recording->command_buffer, &begin_info), "Failed to begin upload command buffer!");
+
+		return *m_recording;
+	}
+
+	upload_service::pending_acquire& upload_service::get_pending_acquire()
+	{
+		if (m_pending_acquires.empty() || m_pending_acquires.back().token != m_next_token)
+		{
+			m_pending_acquires.push_back({ .token = m_next_token });
+		}
+
+		return m_pending_acquires.back();
+	}
+
+	upload_token upload_service::finish_upload(batch& batch, VkDeviceSize size)
+	{
+		batch.ring_end = m_ring_head;
+		batch.staged_bytes += size;
+
+		m_statistics.uploads += 1;
+		m_statistics.bytes += size;
+
+		const upload_token token = batch.token;
+
+		// A shared queue may only be submitted to from the frame thread, so those batches wait for flush().
+		if (m_ownership_transfer && batch.staged_bytes >= m_create_info.batch_size)
+		{
+			submit();
+		}
+
+		return token;
+	}
+
+	upload_token upload_service::submit()
+	{
+		if (!m_recording.has_value())
+		{
+			return m_next_token - 1;
+		}
+
+		batch& batch = *m_recording;
+
+		if (!m_ownership_transfer)
+		{
+			// Same queue as the frames, a barrier orders the copies before everything submitted after them.
+			VkMemoryBarrier barrier = {};
+			barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask   = m_create_info.destination_access;
+
+			m_device->get_dispatch().vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, m_create_info.destination_stages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		vk_ensure(m_device->get_dispatch().vkEndCommandBuffer(batch.command_buffer), "Failed to end upload command buffer!");
+
+		VkTimelineSemaphoreSubmitInfoKHR timeline_submit_info = {};
+		timeline_submit_info.sType                            = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timeline_submit_info.signalSemaphoreValueCount        = 1;
+		timeline_submit_info.pSignalSemaphoreValues           = &batch.token;
+
+		VkSubmitInfo submit_info       = {};
+		submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers    = &batch.command_buffer;
+
+		if (m_timeline != VK_NULL_HANDLE)
+		{
+			submit_info.pNext                = &timeline_submit_info;
+			submit_info.signalSemaphoreCount = 1;
+			submit_info.pSignalSemaphores    = &m_timeline;
+		}
+
+		vk_ensure(m_device->get_dispatch().vkQueueSubmit(m_transfer_queue.first, 1, &submit_info, batch.fence), "Failed to submit uploads!");
+
+		const upload_token token = batch.token;
+
+		m_in_flight.push_back(std::move(batch));
+		m_recording.reset();
+		m_next_token += 1;
+		m_statistics.batches += 1;
+
+		return token;
+	}
+
+	void upload_service::collect_completed()
+	{
+		const VkDevice device           = *m_device;
+		const device_dispatch& dispatch = m_device->get_dispatch();
+
+		while (!m_in_flight.empty() && dispatch.vkGetFenceStatus(device, m_in_flight.front().fence) == VK_SUCCESS)
+		{
+			batch& batch = m_in_flight.front();
+
+			m_completed_token = batch.token;
+			m_ring_tail       = std::max(m_ring_tail, batch.ring_end);
+
+			batch.oversized.clear();
+
+			vk_ensure(dispatch.vkResetFences(device, 1, &batch.fence), "Failed to reset upload fence!");
+			vk_ensure(dispatch.vkResetCommandPool(device, batch.command_pool, 0), "Failed to reset upload command pool!");
+
+			m_free_batches.push_back(std::move(batch));
+			m_in_flight.pop_front();
+		}
+	}
+
+	void upload_service::wait_for_oldest()
+	{
+		if (m_in_flight.empty())
+		{
+			return;
+		}
+
+		vk_ensure(m_device->get_dispatch().vkWaitForFences(*m_device, 1, &m_in_flight.front().fence, VK_TRUE, std::numeric_limits<u64>::max()), "Failed to wait for uploads!");
+
+		collect_completed();
+	}
+} // namespace cc::vk
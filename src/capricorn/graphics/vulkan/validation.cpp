@@ -0,0 +1,278 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/graphics/vulkan/validation.hpp"
+
+#include "capricorn/base/binary_log.hpp"
+#include "capricorn/base/hash.hpp"
+#include "capricorn/base/log.hpp"
+#include "capricorn/graphics/vulkan/instance_configurator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace cc::vk
+{
+	namespace
+	{
+		constexpr std::array validation_profiles = {
+		        validation_profile::off,
+		        validation_profile::errors,
+		        validation_profile::full,
+		        validation_profile::gpu_assisted,
+		        validation_profile::synchronization,
+		};
+
+		constexpr u32 most_frequent_count = 5;
+	} // namespace
+
+	const char* get_validation_profile_name(validation_profile profile) noexcept
+	{
+		switch (profile)
+		{
+			case validation_profile::off:
+				return "off";
+			case validation_profile::errors:
+				return "errors";
+			case validation_profile::full:
+				return "full";
+			case validation_profile::gpu_assisted:
+				return "gpu_assisted";
+			case validation_profile::synchronization:
+				return "synchronization";
+			default:
+				return "unknown";
+		}
+	}
+
+	std::optional<validation_profile> parse_validation_profile(std::string_view name) noexcept
+	{
+		for (const validation_profile profile: validation_profiles)
+		{
+			if (name == get_validation_profile_name(profile))
+			{
+				return profile;
+			}
+		}
+
+		return std::nullopt;
+	}
+
+	validation_profile resolve_validation_profile(validation_profile requested)
+	{
+		const char* p_value = std::getenv("CAPRICORN_VALIDATION");
+
+		if (p_value == nullptr)
+		{
+			return requested;
+		}
+
+		const std::optional<validation_profile> profile = parse_validation_profile(p_value);
+
+		if (!profile.has_value())
+		{
+			log::warning(log_source::renderer, "Unknown validation profile {} in CAPRICORN_VALIDATION, using {}.", p_value, get_validation_profile_name(requested));
+			return requested;
+		}
+
+		return *profile;
+	}
+
+	void apply_validation_profile(instance_configurator& configurator, validation_profile profile)
+	{
+		if (profile == validation_profile::off)
+		{
+			configurator.set_validation_layers_enabled(false).set_debug_messenger_enabled(false);
+			return;
+		}
+
+		constexpr VkDebugUtilsMessageTypeFlagsEXT all_types = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+
+		// The layer still runs every check at errors, only the messages it bothers to format are fewer.
+		const VkDebugUtilsMessageSeverityFlagsEXT severity = profile == validation_profile::errors
+		                                                             ? VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT
+		                                                             : VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+
+		configurator
+		        .add_enabled_layer("VK_LAYER_KHRONOS_validation")
+		        .set_validation_layers_enabled(true)
+		        .set_debug_messenger_enabled(true)
+		        .set_message_severity(severity)
+		        .set_message_type(profile == validation_profile::errors ? VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT : all_types);
+
+		if (profile == validation_profile::gpu_assisted)
+		{
+			configurator
+			        .add_enabled_validation_feature(VK_VALIDATION_FEATURE_ENABLE_GPU_ASSISTED_EXT)
+			        .add_enabled_validation_feature(VK_VALIDATION_FEATURE_ENABLE_GPU_ASSISTED_RESERVE_BINDING_SLOT_EXT);
+		}
+		else if (profile == validation_profile::synchronization)
+		{
+			configurator.add_enabled_validation_feature(VK_VALIDATION_FEATURE_ENABLE_SYNCHRONIZATION_VALIDATION_EXT);
+		}
+	}
+
+	debug_message_filter::debug_message_filter(const debug_message_filter_create_info& create_info) : m_create_info(create_info)
+	{
+	}
+
+	std::unique_ptr<debug_message_filter> debug_message_filter::create(const debug_message_filter_create_info& create_info)
+	{
+		return std::make_unique<debug_message_filter>(create_info);
+	}
+
+	VkBool32 debug_message_filter::callback(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity, VkDebugUtilsMessageTypeFlagsEXT /*message_type*/, const VkDebugUtilsMessengerCallbackDataEXT* p_callback_data, void* p_user_data)
+	{
+		auto* p_filter = static_cast<debug_message_filter*>(p_user_data);
+
+		if (p_filter != nullptr && p_callback_data != nullptr)
+		{
+			p_filter->submit(message_severity, p_callback_data->messageIdNumber, p_callback_data->pMessageIdName, p_callback_data->pMessage);
+		}
+
+		// The call that triggered the message goes ahead either way.
+		return VK_FALSE;
+	}
+
+	b8 debug_message_filter::submit(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity, i32 message_id, const char* p_message_id_name, const char* p_message)
+	{
+		// Some messages, mostly from the loader, leave the number zero and only carry a name.
+		if (message_id == 0 && p_message_id_name != nullptr)
+		{
+			message_id = static_cast<i32>(fnv1a(p_message_id_name, std::strlen(p_message_id_name)));
+		}
+
+		const b8 is_error = message_severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+		b8 last_repeat    = false;
+
+		{
+			std::lock_guard lock(m_mutex);
+
+			if (is_error)
+			{
+				++m_statistics.errors;
+			}
+			else if (message_severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT)
+			{
+				++m_statistics.warnings;
+			}
+			else if (message_severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT)
+			{
+				++m_statistics.info;
+			}
+			else
+			{
+				++m_statistics.verbose;
+			}
+
+			auto [iterator, inserted] = m_records.try_emplace(message_id);
+			message_record& record    = iterator->second;
+
+			if (inserted)
+			{
+				record.id_name = p_message_id_name != nullptr ? p_message_id_name : "unnamed";
+				++m_statistics.unique_ids;
+			}
+
+			++record.count;
+
+			if (record.logged >= m_create_info.max_repeats)
+			{
+				++m_statistics.repeats;
+				return false;
+			}
+
+			if (!is_error && m_create_info.max_messages_per_second != 0)
+			{
+				const clock::time_point now = clock::now();
+
+				if (now - m_window_start >= std::chrono::seconds(1))
+				{
+					m_window_start    = now;
+					m_window_messages = 0;
+				}
+
+				if (m_window_messages >= m_create_info.max_messages_per_second)
+				{
+					++m_statistics.rate_limited;
+					return false;
+				}
+
+				++m_window_messages;
+			}
+
+			last_repeat = ++record.logged == m_create_info.max_repeats;
+			++m_statistics.logged;
+		}
+
+		// Outside the lock, and deferred to the binary stream when one is open, writing the message is the expensive part.
+		const char* p_name   = p_message_id_name != nullptr ? p_message_id_name : "unnamed";
+		const char* p_suffix = last_repeat ? " (repeats of this message are only counted from now on)" : "";
+
+		if (is_error)
+		{
+			cc_log_error(log_source::renderer, "[{}] {}{}", p_name, p_message != nullptr ? p_message : "", p_suffix);
+		}
+		else if (message_severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT)
+		{
+			cc_log_warning(log_source::renderer, "[{}] {}{}", p_name, p_message != nullptr ? p_message : "", p_suffix);
+		}
+		else
+		{
+			cc_log_info(log_source::renderer, "[{}] {}{}", p_name, p_message != nullptr ? p_message : "", p_suffix);
+		}
+
+		return true;
+	}
+
+	debug_message_statistics debug_message_filter::get_statistics() const
+	{
+		std::lock_guard lock(m_mutex);
+		return m_statistics;
+	}
+
+	void debug_message_filter::log_statistics() const
+	{
+		std::vector<std::pair<i32, message_record>> records;
+		debug_message_statistics statistics;
+
+		{
+			std::lock_guard lock(m_mutex);
+			records.assign(m_records.begin(), m_records.end());
+			statistics = m_statistics;
+		}
+
+		const u64 total = statistics.verbose + statistics.info + statistics.warnings + statistics.errors;
+
+		if (total == 0)
+		{
+			return;
+		}
+
+		log::info(log_source::renderer,
+		          "Debug messages: {} errors, {} warnings, {} info, {} verbose from {} ids; {} logged, {} held back as repeats and {} by the rate limit.",
+		          statistics.errors,
+		          statistics.warnings,
+		          statistics.info,
+		          statistics.verbose,
+		          statistics.unique_ids,
+		          statistics.logged,
+		          statistics.repeats,
+		          statistics.rate_limited);
+
+		const std::size_t shown = std::min<std::size_t>(most_frequent_count, records.size());
+
+		std::partial_sort(records.begin(), records.begin() + static_cast<std::ptrdiff_t>(shown), records.end(), [](const auto& lhs, const auto& rhs) {
+			return lhs.second.count > rhs.second.count;
+		});
+
+		for (std::size_t index = 0; index < shown; ++index)
+		{
+			const auto& [id, record] = records[index];
+			log::info(log_source::renderer, "  {:>8}x {} ({:#010x})", record.count, record.id_name, static_cast<u32>(id));
+		}
+	}
+} // namespace cc::vk
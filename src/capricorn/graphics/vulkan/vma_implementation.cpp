@@ -0,0 +1,9 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+// VMA is a single-header library, its implementation is compiled exactly once, here.
+// Nothing is taken from the linked loader, memory_allocator hands VMA the device's dispatch table and it fetches the rest.
+#define VMA_STATIC_VULKAN_FUNCTIONS 0
+#define VMA_DYNAMIC_VULKAN_FUNCTIONS 1
+#define VMA_IMPLEMENTATION
+#include <vk_mem_alloc.h>
@@ -0,0 +1,311 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/jobs/job_system.hpp"
+
+#include "capricorn/base/profiler.hpp"
+
+namespace cc
+{
+	namespace details
+	{
+		constexpr u32 invalid_thread_index = ~0U;
+
+		struct job_thread_state
+		{
+			u64 owner        = 0;
+			u32 thread_index  = invalid_thread_index;
+		};
+
+		thread_local job_thread_state t_job_thread_state;
+
+		std::atomic<u64> s_next_job_system_id = 1;
+
+		u32 next_random(u32& state)
+		{
+			// xorshift32, only used to spread steal attempts over victims.
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+	} // namespace details
+
+	b8 job_counter::is_done() const noexcept
+	{
+		return m_state.load(std::memory_order_acquire) == 0;
+	}
+
+	u32 job_counter::get_pending() const noexcept
+	{
+		return static_cast<u32>(m_state.load(std::memory_order_acquire) & pending_mask);
+	}
+
+	job_system::worker::worker(const job_system_create_info& create_info)
+	    : deque(create_info.deque_capacity),
+	      job_pool(std::make_unique<job[]>(std::bit_ceil(create_info.job_pool_size))),
+	      job_pool_mask(std::bit_ceil(create_info.job_pool_size) - 1)
+	{
+	}
+
+	job_system::job_system(const job_system_create_info& create_info)
+	    : m_create_info(create_info),
+	      m_id(details::s_next_job_system_id.fetch_add(1, std::memory_order_relaxed))
+	{
+		u32 worker_count = m_create_info.worker_count;
+		if (worker_count == 0)
+		{
+			worker_count = std::max(std::thread::hardware_concurrency(), 2U) - 1;
+		}
+
+		const u32 thread_count = worker_count + 1;
+
+		for (u32 index = 0; index < thread_count; ++index)
+		{
+			m_workers.push_back(std::make_unique<worker>(m_create_info));
+			m_workers.back()->random_state = 0x9E3779B9U * (index + 1);
+		}
+
+		// The creating thread takes slot 0 so it can submit work and help out while waiting.
+		details::t_job_thread_state = { m_id, 0 };
+
+		m_running.store(true, std::memory_order_release);
+
+		for (u32 index = 1; index < thread_count; ++index)
+		{
+			m_threads.emplace_back(&job_system::worker_main, this, index);
+		}
+
+		log::info(log_source::application, "Job system started with {} worker threads.", worker_count);
+	}
+
+	job_system::~job_system()
+	{
+		m_running.store(false, std::memory_order_release);
+		m_wake.release(static_cast<std::ptrdiff_t>(m_threads.size()));
+
+		for (auto& thread: m_threads)
+		{
+			thread.join();
+		}
+
+		details::t_job_thread_state = {};
+	}
+
+	std::shared_ptr<job_system> job_system::create(const job_system_create_info& create_info)
+	{
+		return std::make_shared<job_system>(create_info);
+	}
+
+	void job_system::wait(job_counter& counter)
+	{
+		const u32 thread_index = get_thread_index();
+		ensure(thread_index != details::invalid_thread_index, "Only job system threads may wait on a job counter!");
+
+		while (!counter.is_done())
+		{
+			if (!try_execute_one(thread_index))
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	u32 job_system::get_thread_count() const noexcept
+	{
+		return static_cast<u32>(m_workers.size());
+	}
+
+	u32 job_system::get_thread_index() const noexcept
+	{
+		const details::job_thread_state& state = details::t_job_thread_state;
+		return state.owner == m_id ? state.thread_index : details::invalid_thread_index;
+	}
+
+	job_system_statistics job_system::get_statistics() const noexcept
+	{
+		job_system_statistics statistics = {};
+
+		for (const auto& worker: m_workers)
+		{
+			statistics.executed += worker->executed.load(std::memory_order_relaxed);
+			statistics.stolen += worker->stolen.load(std::memory_order_relaxed);
+			statistics.inlined += worker->inlined.load(std::memory_order_relaxed);
+		}
+
+		return statistics;
+	}
+
+	job_system::worker& job_system::get_current_worker()
+	{
+		const u32 thread_index = get_thread_index();
+		ensure(thread_index != details::invalid_thread_index, "Jobs can only be submitted from job system threads!");
+
+		return *m_workers[thread_index];
+	}
+
+	job* job_system::allocate_job()
+	{
+		worker& current = get_current_worker();
+
+		for (u32 attempt = 0; attempt <= current.job_pool_mask; ++attempt)
+		{
+			job* p_job = &current.job_pool[current.job_pool_index++ & current.job_pool_mask];
+
+			if (!p_job->in_use.load(std::memory_order_acquire))
+			{
+				p_job->in_use.store(true, std::memory_order_relaxed);
+				return p_job;
+			}
+		}
+
+		log::critical(log_source::application, "Job pool of thread {} is exhausted, every job is still in flight.", get_thread_index());
+		throw std::runtime_error("Job pool exhausted.");
+	}
+
+	void job_system::submit(job* p_job)
+	{
+		worker& current = get_current_worker();
+
+		if (!current.deque.push(p_job))
+		{
+			current.inlined.fetch_add(1, std::memory_order_relaxed);
+			execute(p_job);
+			return;
+		}
+
+		// Pairs with the increment of m_sleeping in worker_main(): either the sleeper sees the job or we see the sleeper.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (m_sleeping.load(std::memory_order_relaxed) > 0)
+		{
+			m_wake.release();
+		}
+	}
+
+	void job_system::execute(job* p_job)
+	{
+		job_counter* p_counter = p_job->p_counter;
+
+		p_job->p_function(*p_job);
+		p_job->in_use.store(false, std::memory_order_release);
+
+		worker& current = *m_workers[get_thread_index()];
+		current.executed.store(current.executed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+		if (p_counter == nullptr)
+		{
+			return;
+		}
+
+		u64 state = p_counter->m_state.load(std::memory_order_relaxed);
+		b8 last   = false;
+
+		do
+		{
+			last = (state & job_counter::pending_mask) == 1;
+		} while (!p_counter->m_state.compare_exchange_weak(state, last ? job_counter::finalizing_bit : state - 1, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+		if (!last)
+		{
+			return;
+		}
+
+		std::vector<job*> continuations;
+
+		{
+			std::lock_guard const lock(p_counter->m_continuations_mutex);
+			continuations.swap(p_counter->m_continuations);
+		}
+
+		// From here on a waiter may return and destroy the counter.
+		p_counter->m_state.store(0, std::memory_order_release);
+
+		for (job* p_continuation: continuations)
+		{
+			submit(p_continuation);
+		}
+	}
+
+	b8 job_system::try_execute_one(u32 thread_index)
+	{
+		job* p_job = find_work(thread_index);
+
+		if (p_job == nullptr)
+		{
+			return false;
+		}
+
+		execute(p_job);
+		return true;
+	}
+
+	job* job_system::find_work(u32 thread_index)
+	{
+		worker& current = *m_workers[thread_index];
+		job* p_job      = nullptr;
+
+		if (current.deque.pop(p_job))
+		{
+			return p_job;
+		}
+
+		const u32 thread_count = get_thread_count();
+		const u32 start        = details::next_random(current.random_state) % thread_count;
+
+		for (u32 offset = 0; offset < thread_count; ++offset)
+		{
+			const u32 victim = (start + offset) % thread_count;
+
+			if (victim != thread_index && m_workers[victim]->deque.steal(p_job))
+			{
+				current.stolen.store(current.stolen.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				return p_job;
+			}
+		}
+
+		return nullptr;
+	}
+
+	void job_system::worker_main(u32 thread_index)
+	{
+		details::t_job_thread_state = { m_id, thread_index };
+
+		if constexpr (profiler_enabled)
+		{
+			profiler::set_thread_name(fmt::format("Worker {}", thread_index).c_str());
+		}
+
+		u32 idle_rounds = 0;
+
+		while (m_running.load(std::memory_order_acquire))
+		{
+			if (try_execute_one(thread_index))
+			{
+				idle_rounds = 0;
+				continue;
+			}
+
+			if (++idle_rounds < m_create_info.spin_count)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+
+			// Look once more after announcing ourselves, a submitter may have missed us.
+			if (job* p_job = find_work(thread_index))
+			{
+				m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+				execute(p_job);
+				idle_rounds = 0;
+				continue;
+			}
+
+			m_wake.acquire();
+			m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+			idle_rounds = 0;
+		}
+	}
+} // namespace cc
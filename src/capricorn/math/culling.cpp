@@ -0,0 +1,514 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/math/culling.hpp"
+
+#include "capricorn/base/profiler.hpp"
+
+#include <cmath>
+
+namespace cc::math
+{
+	namespace
+	{
+		// Also culls what is left over after the wider kernels' last full register.
+		template<b8 Boxes>
+		u32 cull_scalar(const frustum& frustum, const bounds_array& bounds, u32 begin, u32* p_visible, u32 visible) noexcept
+		{
+			const u32 count       = bounds.get_count();
+			const f32* p_x        = bounds.get_center_x();
+			const f32* p_y        = bounds.get_center_y();
+			const f32* p_z        = bounds.get_center_z();
+			const f32* p_extent_x = bounds.get_extent_x();
+			const f32* p_extent_y = bounds.get_extent_y();
+			const f32* p_extent_z = bounds.get_extent_z();
+			const f32* p_radii    = bounds.get_radii();
+
+			for (u32 index = begin; index < count; ++index)
+			{
+				b8 inside = true;
+
+				for (const glm::vec4& plane: frustum.planes)
+				{
+					const f32 distance = plane.x * p_x[index] + plane.y * p_y[index] + plane.z * p_z[index] + plane.w;
+
+					// How far the bounds reaches past its center towards the plane's outer side.
+					f32 reach = 0.0F;
+
+					if constexpr (Boxes)
+					{
+						reach = std::abs(plane.x) * p_extent_x[index] + std::abs(plane.y) * p_extent_y[index] + std::abs(plane.z) * p_extent_z[index];
+					}
+					else
+					{
+						reach = p_radii[index];
+					}
+
+					inside &= distance + reach >= 0.0F;
+				}
+
+				// Written either way, only kept when visible, which saves a branch nothing could predict.
+				p_visible[visible] = index;
+				visible += inside ? 1 : 0;
+			}
+
+			return visible;
+		}
+
+#if CAPRICORN_SIMD_X86
+		// For every 8-bit mask, the positions of its set bits packed into bytes from the lowest up.
+		constexpr std::array<u64, 256> compaction_table = [] {
+			std::array<u64, 256> table = {};
+
+			for (u32 mask = 0; mask < 256; ++mask)
+			{
+				u32 slot = 0;
+
+				for (u32 bit = 0; bit < 8; ++bit)
+				{
+					if ((mask & (1U << bit)) != 0)
+					{
+						table[mask] |= static_cast<u64>(bit) << (slot++ * 8);
+					}
+				}
+			}
+
+			return table;
+		}();
+
+		template<b8 Boxes>
+		cc_simd_target("sse4.1,popcnt") u32 cull_sse4(const frustum& frustum, const bounds_array& bounds, u32* p_visible) noexcept
+		{
+			const u32 count       = bounds.get_count();
+			const f32* p_x        = bounds.get_center_x();
+			const f32* p_y        = bounds.get_center_y();
+			const f32* p_z        = bounds.get_center_z();
+			const f32* p_extent_x = bounds.get_extent_x();
+			const f32* p_extent_y = bounds.get_extent_y();
+			const f32* p_extent_z = bounds.get_extent_z();
+			const f32* p_radii    = bounds.get_radii();
+
+			__m128 plane_x[6];
+			__m128 plane_y[6];
+			__m128 plane_z[6];
+			__m128 plane_w[6];
+			__m128 reach_x[6];
+			__m128 reach_y[6];
+			__m128 reach_z[6];
+
+			for (u32 plane = 0; plane < 6; ++plane)
+			{
+				plane_x[plane] = _mm_set1_ps(frustum.planes[plane].x);
+				plane_y[plane] = _mm_set1_ps(frustum.planes[plane].y);
+				plane_z[plane] = _mm_set1_ps(frustum.planes[plane].z);
+				plane_w[plane] = _mm_set1_ps(frustum.planes[plane].w);
+				reach_x[plane] = _mm_set1_ps(std::abs(frustum.planes[plane].x));
+				reach_y[plane] = _mm_set1_ps(std::abs(frustum.planes[plane].y));
+				reach_z[plane] = _mm_set1_ps(std::abs(frustum.planes[plane].z));
+			}
+
+			const __m128 zero = _mm_setzero_ps();
+
+			u32 visible = 0;
+			u32 index   = 0;
+
+			for (; index + 4 <= count; index += 4)
+			{
+				const __m128 x = _mm_loadu_ps(p_x + index);
+				const __m128 y = _mm_loadu_ps(p_y + index);
+				const __m128 z = _mm_loadu_ps(p_z + index);
+
+				__m128 extent_x = zero;
+				__m128 extent_y = zero;
+				__m128 extent_z = zero;
+				__m128 radius   = zero;
+
+				if constexpr (Boxes)
+				{
+					extent_x = _mm_loadu_ps(p_extent_x + index);
+					extent_y = _mm_loadu_ps(p_extent_y + index);
+					extent_z = _mm_loadu_ps(p_extent_z + index);
+				}
+				else
+				{
+					radius = _mm_loadu_ps(p_radii + index);
+				}
+
+				__m128 inside = _mm_cmpeq_ps(zero, zero);
+
+				for (u32 plane = 0; plane < 6; ++plane)
+				{
+					const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_x[plane], x), _mm_mul_ps(plane_y[plane], y)), _mm_mul_ps(plane_z[plane], z)), plane_w[plane]);
+					__m128 reach          = radius;
+
+					if constexpr (Boxes)
+					{
+						reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(reach_x[plane], extent_x), _mm_mul_ps(reach_y[plane], extent_y)), _mm_mul_ps(reach_z[plane], extent_z));
+					}
+
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), zero));
+				}
+
+				// Four lanes use the low half of the table, the lanes past the visible ones are overwritten later.
+				const auto mask       = static_cast<u32>(_mm_movemask_ps(inside));
+				const __m128i lanes   = _mm_cvtepu8_epi32(_mm_cvtsi64_si128(static_cast<i64>(compaction_table[mask])));
+				const __m128i indices = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(index)), lanes);
+
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(p_visible + visible), indices);
+				visible += static_cast<u32>(_mm_popcnt_u32(mask));
+			}
+
+			return cull_scalar<Boxes>(frustum, bounds, index, p_visible, visible);
+		}
+
+		template<b8 Boxes>
+		cc_simd_target("avx2,fma,popcnt") u32 cull_avx2(const frustum& frustum, const bounds_array& bounds, u32* p_visible) noexcept
+		{
+			const u32 count       = bounds.get_count();
+			const f32* p_x        = bounds.get_center_x();
+			const f32* p_y        = bounds.get_center_y();
+			const f32* p_z        = bounds.get_center_z();
+			const f32* p_extent_x = bounds.get_extent_x();
+			const f32* p_extent_y = bounds.get_extent_y();
+			const f32* p_extent_z = bounds.get_extent_z();
+			const f32* p_radii    = bounds.get_radii();
+
+			__m256 plane_x[6];
+			__m256 plane_y[6];
+			__m256 plane_z[6];
+			__m256 plane_w[6];
+			__m256 reach_x[6];
+			__m256 reach_y[6];
+			__m256 reach_z[6];
+
+			for (u32 plane = 0; plane < 6; ++plane)
+			{
+				plane_x[plane] = _mm256_set1_ps(frustum.planes[plane].x);
+				plane_y[plane] = _mm256_set1_ps(frustum.planes[plane].y);
+				plane_z[plane] = _mm256_set1_ps(frustum.planes[plane].z);
+				plane_w[plane] = _mm256_set1_ps(frustum.planes[plane].w);
+				reach_x[plane] = _mm256_set1_ps(std::abs(frustum.planes[plane].x));
+				reach_y[plane] = _mm256_set1_ps(std::abs(frustum.planes[plane].y));
+				reach_z[plane] = _mm256_set1_ps(std::abs(frustum.planes[plane].z));
+			}
+
+			const __m256 zero = _mm256_setzero_ps();
+
+			u32 visible = 0;
+			u32 index   = 0;
+
+			for (; index + 8 <= count; index += 8)
+			{
+				const __m256 x = _mm256_loadu_ps(p_x + index);
+				const __m256 y = _mm256_loadu_ps(p_y + index);
+				const __m256 z = _mm256_loadu_ps(p_z + index);
+
+				__m256 extent_x = zero;
+				__m256 extent_y = zero;
+				__m256 extent_z = zero;
+				__m256 radius   = zero;
+
+				if constexpr (Boxes)
+				{
+					extent_x = _mm256_loadu_ps(p_extent_x + index);
+					extent_y = _mm256_loadu_ps(p_extent_y + index);
+					extent_z = _mm256_loadu_ps(p_extent_z + index);
+				}
+				else
+				{
+					radius = _mm256_loadu_ps(p_radii + index);
+				}
+
+				__m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+
+				for (u32 plane = 0; plane < 6; ++plane)
+				{
+					const __m256 distance = _mm256_fmadd_ps(plane_z[plane], z, _mm256_fmadd_ps(plane_y[plane], y, _mm256_fmadd_ps(plane_x[plane], x, plane_w[plane])));
+					__m256 reach          = radius;
+
+					if constexpr (Boxes)
+					{
+						reach = _mm256_fmadd_ps(reach_z[plane], extent_z, _mm256_fmadd_ps(reach_y[plane], extent_y, _mm256_mul_ps(reach_x[plane], extent_x)));
+					}
+
+					inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), zero, _CMP_GE_OQ));
+				}
+
+				// All eight lanes are stored, which stays within p_visible because visible never passes index.
+				const auto mask       = static_cast<u32>(_mm256_movemask_ps(inside));
+				const __m256i lanes   = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(static_cast<i64>(compaction_table[mask])));
+				const __m256i indices = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(index)), lanes);
+
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(p_visible + visible), indices);
+				visible += static_cast<u32>(_mm_popcnt_u32(mask));
+			}
+
+			return cull_scalar<Boxes>(frustum, bounds, index, p_visible, visible);
+		}
+
+		template<b8 Boxes>
+		cc_simd_target("avx512f,popcnt") u32 cull_avx512(const frustum& frustum, const bounds_array& bounds, u32* p_visible) noexcept
+		{
+			const u32 count       = bounds.get_count();
+			const f32* p_x        = bounds.get_center_x();
+			const f32* p_y        = bounds.get_center_y();
+			const f32* p_z        = bounds.get_center_z();
+			const f32* p_extent_x = bounds.get_extent_x();
+			const f32* p_extent_y = bounds.get_extent_y();
+			const f32* p_extent_z = bounds.get_extent_z();
+			const f32* p_radii    = bounds.get_radii();
+
+			__m512 plane_x[6];
+			__m512 plane_y[6];
+			__m512 plane_z[6];
+			__m512 plane_w[6];
+			__m512 reach_x[6];
+			__m512 reach_y[6];
+			__m512 reach_z[6];
+
+			for (u32 plane = 0; plane < 6; ++plane)
+			{
+				plane_x[plane] = _mm512_set1_ps(frustum.planes[plane].x);
+				plane_y[plane] = _mm512_set1_ps(frustum.planes[plane].y);
+				plane_z[plane] = _mm512_set1_ps(frustum.planes[plane].z);
+				plane_w[plane] = _mm512_set1_ps(frustum.planes[plane].w);
+				reach_x[plane] = _mm512_set1_ps(std::abs(frustum.planes[plane].x));
+				reach_y[plane] = _mm512_set1_ps(std::abs(frustum.planes[plane].y));
+				reach_z[plane] = _mm512_set1_ps(std::abs(frustum.planes[plane].z));
+			}
+
+			const __m512 zero         = _mm512_setzero_ps();
+			const __m512i lane_offsets = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+			u32 visible = 0;
+
+			// The last iteration masks off the lanes past the end instead of handing them to the scalar kernel.
+			for (u32 index = 0; index < count; index += 16)
+			{
+				const u32 remaining = count - index;
+				const auto lanes    = static_cast<__mmask16>(remaining >= 16 ? 0xFFFFU : (1U << remaining) - 1);
+
+				const __m512 x = _mm512_maskz_loadu_ps(lanes, p_x + index);
+				const __m512 y = _mm512_maskz_loadu_ps(lanes, p_y + index);
+				const __m512 z = _mm512_maskz_loadu_ps(lanes, p_z + index);
+
+				__m512 extent_x = zero;
+				__m512 extent_y = zero;
+				__m512 extent_z = zero;
+				__m512 radius   = zero;
+
+				if constexpr (Boxes)
+				{
+					extent_x = _mm512_maskz_loadu_ps(lanes, p_extent_x + index);
+					extent_y = _mm512_maskz_loadu_ps(lanes, p_extent_y + index);
+					extent_z = _mm512_maskz_loadu_ps(lanes, p_extent_z + index);
+				}
+				else
+				{
+					radius = _mm512_maskz_loadu_ps(lanes, p_radii + index);
+				}
+
+				__mmask16 inside = lanes;
+
+				for (u32 plane = 0; plane < 6; ++plane)
+				{
+					const __m512 distance = _mm512_fmadd_ps(plane_z[plane], z, _mm512_fmadd_ps(plane_y[plane], y, _mm512_fmadd_ps(plane_x[plane], x, plane_w[plane])));
+					__m512 reach          = radius;
+
+					if constexpr (Boxes)
+					{
+						reach = _mm512_fmadd_ps(reach_z[plane], extent_z, _mm512_fmadd_ps(reach_y[plane], extent_y, _mm512_mul_ps(reach_x[plane], extent_x)));
+					}
+
+					inside = _mm512_mask_cmp_ps_mask(inside, _mm512_add_ps(distance, reach), zero, _CMP_GE_OQ);
+				}
+
+				const __m512i indices = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(index)), lane_offsets);
+
+				// Compressing in a register and storing every lane is fast on every AVX-512 CPU, compressing to memory is not.
+				if (remaining >= 16)
+				{
+					_mm512_storeu_si512(p_visible + visible, _mm512_maskz_compress_epi32(inside, indices));
+				}
+				else
+				{
+					_mm512_mask_compressstoreu_epi32(p_visible + visible, inside, indices);
+				}
+
+				visible += static_cast<u32>(_mm_popcnt_u32(inside));
+			}
+
+			return visible;
+		}
+#endif
+
+		template<b8 Boxes>
+		u32 cull(const frustum& frustum, const bounds_array& bounds, u32* p_visible, simd_level level) noexcept
+		{
+			switch (clamp_simd_level(level))
+			{
+#if CAPRICORN_SIMD_X86
+				case simd_level::avx512:
+					return cull_avx512<Boxes>(frustum, bounds, p_visible);
+				case simd_level::avx2:
+					return cull_avx2<Boxes>(frustum, bounds, p_visible);
+				case simd_level::sse4:
+					return cull_sse4<Boxes>(frustum, bounds, p_visible);
+#endif
+				default:
+					return cull_scalar<Boxes>(frustum, bounds, 0, p_visible, 0);
+			}
+		}
+	} // namespace
+
+	frustum frustum::from_matrix(const glm::mat4& view_projection) noexcept
+	{
+		// A clip-space point is inside when -w <= x <= w, -w <= y <= w and 0 <= z <= w, each bound is a row combination.
+		const auto row = [&view_projection](u32 index) {
+			return glm::vec4(view_projection[0][index], view_projection[1][index], view_projection[2][index], view_projection[3][index]);
+		};
+
+		frustum result = {
+		        .planes = {
+		                row(3) + row(0),
+		                row(3) - row(0),
+		                row(3) + row(1),
+		                row(3) - row(1),
+		                row(2),
+		                row(3) - row(2),
+		        },
+		};
+
+		for (glm::vec4& plane: result.planes)
+		{
+			plane = plane / glm::length(glm::vec3(plane.x, plane.y, plane.z));
+		}
+
+		return result;
+	}
+
+	u32 bounds_array::add(const glm::vec3& center, const glm::vec3& extents)
+	{
+		const u32 index = get_count();
+
+		m_center_x.push_back(center.x);
+		m_center_y.push_back(center.y);
+		m_center_z.push_back(center.z);
+		m_extent_x.push_back(extents.x);
+		m_extent_y.push_back(extents.y);
+		m_extent_z.push_back(extents.z);
+		m_radii.push_back(glm::length(extents));
+
+		return index;
+	}
+
+	u32 bounds_array::add_sphere(const glm::vec3& center, f32 radius)
+	{
+		const u32 index = add(center, glm::vec3(radius));
+
+		// Tighter than the sphere around the box.
+		m_radii[index] = radius;
+
+		return index;
+	}
+
+	void bounds_array::set(u32 index, const glm::vec3& center, const glm::vec3& extents)
+	{
+		m_center_x[index] = center.x;
+		m_center_y[index] = center.y;
+		m_center_z[index] = center.z;
+		m_extent_x[index] = extents.x;
+		m_extent_y[index] = extents.y;
+		m_extent_z[index] = extents.z;
+		m_radii[index]    = glm::length(extents);
+	}
+
+	void bounds_array::reserve(u32 capacity)
+	{
+		m_center_x.reserve(capacity);
+		m_center_y.reserve(capacity);
+		m_center_z.reserve(capacity);
+		m_extent_x.reserve(capacity);
+		m_extent_y.reserve(capacity);
+		m_extent_z.reserve(capacity);
+		m_radii.reserve(capacity);
+	}
+
+	void bounds_array::clear() noexcept
+	{
+		m_center_x.clear();
+		m_center_y.clear();
+		m_center_z.clear();
+		m_extent_x.clear();
+		m_extent_y.clear();
+		m_extent_z.clear();
+		m_radii.clear();
+	}
+
+	u32 bounds_array::get_count() const noexcept
+	{
+		return static_cast<u32>(m_radii.size());
+	}
+
+	glm::vec3 bounds_array::get_center(u32 index) const noexcept
+	{
+		return { m_center_x[index], m_center_y[index], m_center_z[index] };
+	}
+
+	glm::vec3 bounds_array::get_extents(u32 index) const noexcept
+	{
+		return { m_extent_x[index], m_extent_y[index], m_extent_z[index] };
+	}
+
+	f32 bounds_array::get_radius(u32 index) const noexcept
+	{
+		return m_radii[index];
+	}
+
+	const f32* bounds_array::get_center_x() const noexcept
+	{
+		return m_center_x.data();
+	}
+
+	const f32* bounds_array::get_center_y() const noexcept
+	{
+		return m_center_y.data();
+	}
+
+	const f32* bounds_array::get_center_z() const noexcept
+	{
+		return m_center_z.data();
+	}
+
+	const f32* bounds_array::get_extent_x() const noexcept
+	{
+		return m_extent_x.data();
+	}
+
+	const f32* bounds_array::get_extent_y() const noexcept
+	{
+		return m_extent_y.data();
+	}
+
+	const f32* bounds_array::get_extent_z() const noexcept
+	{
+		return m_extent_z.data();
+	}
+
+	const f32* bounds_array::get_radii() const noexcept
+	{
+		return m_radii.data();
+	}
+
+	u32 cull_spheres(const frustum& frustum, const bounds_array& bounds, u32* p_visible, simd_level level)
+	{
+		cc_profile_zone("math::cull_spheres");
+		return cull<false>(frustum, bounds, p_visible, level);
+	}
+
+	u32 cull_boxes(const frustum& frustum, const bounds_array& bounds, u32* p_visible, simd_level level)
+	{
+		cc_profile_zone("math::cull_boxes");
+		return cull<true>(frustum, bounds, p_visible, level);
+	}
+} // namespace cc::math
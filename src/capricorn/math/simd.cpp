@@ -0,0 +1,156 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/math/simd.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <string_view>
+
+#if CAPRICORN_SIMD_X86 && !defined(_MSC_VER)
+	#include <cpuid.h>
+#endif
+
+namespace cc::math
+{
+	namespace
+	{
+		constexpr std::array<simd_level, 4> simd_levels = { simd_level::scalar, simd_level::sse4, simd_level::avx2, simd_level::avx512 };
+
+#if CAPRICORN_SIMD_X86
+		struct cpuid_registers
+		{
+			u32 eax = 0;
+			u32 ebx = 0;
+			u32 ecx = 0;
+			u32 edx = 0;
+		};
+
+		cpuid_registers cpuid(u32 leaf, u32 subleaf) noexcept
+		{
+	#ifdef _MSC_VER
+			std::array<int, 4> registers = {};
+			__cpuidex(registers.data(), static_cast<int>(leaf), static_cast<int>(subleaf));
+
+			return {
+			        .eax = static_cast<u32>(registers[0]),
+			        .ebx = static_cast<u32>(registers[1]),
+			        .ecx = static_cast<u32>(registers[2]),
+			        .edx = static_cast<u32>(registers[3]),
+			};
+	#else
+			cpuid_registers registers;
+			__cpuid_count(leaf, subleaf, registers.eax, registers.ebx, registers.ecx, registers.edx);
+
+			return registers;
+	#endif
+		}
+
+		// The register state the OS saves on a context switch, without which the registers must not be touched.
+		u64 read_xcr0() noexcept
+		{
+	#ifdef _MSC_VER
+			return _xgetbv(0);
+	#else
+			u32 eax = 0;
+			u32 edx = 0;
+			__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+
+			return (static_cast<u64>(edx) << 32) | eax;
+	#endif
+		}
+#endif
+
+		simd_level detect_simd_level() noexcept
+		{
+#if CAPRICORN_SIMD_X86
+			const cpuid_registers features = cpuid(1, 0);
+
+			// Every vector path counts survivors with popcnt, which is its own feature bit rather than part of SSE4.1.
+			const b8 has_sse41  = (features.ecx & (1U << 19)) != 0;
+			const b8 has_popcnt = (features.ecx & (1U << 23)) != 0;
+
+			if (!has_sse41 || !has_popcnt)
+			{
+				return simd_level::scalar;
+			}
+
+			const b8 has_xsave = (features.ecx & (1U << 27)) != 0;
+			const u64 xcr0     = has_xsave ? read_xcr0() : 0;
+
+			// XMM and YMM state.
+			if ((xcr0 & 0x6) != 0x6 || cpuid(0, 0).eax < 7)
+			{
+				return simd_level::sse4;
+			}
+
+			const cpuid_registers extended = cpuid(7, 0);
+
+			const b8 has_avx  = (features.ecx & (1U << 28)) != 0;
+			const b8 has_fma  = (features.ecx & (1U << 12)) != 0;
+			const b8 has_avx2 = (extended.ebx & (1U << 5)) != 0;
+
+			if (!has_avx || !has_fma || !has_avx2)
+			{
+				return simd_level::sse4;
+			}
+
+			// Opmask, the upper halves of ZMM0-15 and ZMM16-31.
+			if ((extended.ebx & (1U << 16)) == 0 || (xcr0 & 0xE0) != 0xE0)
+			{
+				return simd_level::avx2;
+			}
+
+			return simd_level::avx512;
+#else
+			return simd_level::scalar;
+#endif
+		}
+
+		simd_level resolve_simd_level() noexcept
+		{
+			const simd_level detected = detect_simd_level();
+			const char* p_cap         = std::getenv("CAPRICORN_SIMD");
+
+			if (p_cap == nullptr)
+			{
+				return detected;
+			}
+
+			const auto iterator = std::find_if(simd_levels.begin(), simd_levels.end(), [p_cap](simd_level level) {
+				return std::string_view(p_cap) == get_simd_level_name(level);
+			});
+
+			return iterator != simd_levels.end() ? std::min(*iterator, detected) : detected;
+		}
+	} // namespace
+
+	const char* get_simd_level_name(simd_level level) noexcept
+	{
+		switch (level)
+		{
+			case simd_level::scalar:
+				return "scalar";
+			case simd_level::sse4:
+				return "sse4";
+			case simd_level::avx2:
+				return "avx2";
+			case simd_level::avx512:
+				return "avx512";
+		}
+
+		return "unknown";
+	}
+
+	simd_level get_simd_level() noexcept
+	{
+		static const simd_level level = resolve_simd_level();
+		return level;
+	}
+
+	simd_level clamp_simd_level(simd_level level) noexcept
+	{
+		return std::min(level, get_simd_level());
+	}
+} // namespace cc::math
@@ -0,0 +1,399 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/math/transform_hierarchy.hpp"
+
+#include "capricorn/base/profiler.hpp"
+
+#include <algorithm>
+
+namespace cc::math
+{
+	namespace
+	{
+		void propagate_scalar(const u32* p_parents, const glm::mat4* p_locals, glm::mat4* p_worlds, u32 begin, u32 end) noexcept
+		{
+			for (u32 index = begin; index < end; ++index)
+			{
+				const u32 parent = p_parents[index];
+				p_worlds[index]  = parent == no_transform ? p_locals[index] : p_worlds[parent] * p_locals[index];
+			}
+		}
+
+#if CAPRICORN_SIMD_X86
+		// Column j of parent * local is the sum over k of the parent's column k scaled by local[j][k].
+
+		cc_simd_target("sse4.1") void propagate_sse4(const u32* p_parents, const glm::mat4* p_locals, glm::mat4* p_worlds, u32 begin, u32 end) noexcept
+		{
+			for (u32 index = begin; index < end; ++index)
+			{
+				const u32 parent = p_parents[index];
+
+				if (parent == no_transform)
+				{
+					p_worlds[index] = p_locals[index];
+					continue;
+				}
+
+				const f32* p_parent = &p_worlds[parent][0][0];
+				const f32* p_local  = &p_locals[index][0][0];
+				f32* p_world        = &p_worlds[index][0][0];
+
+				const __m128 parent_0 = _mm_loadu_ps(p_parent);
+				const __m128 parent_1 = _mm_loadu_ps(p_parent + 4);
+				const __m128 parent_2 = _mm_loadu_ps(p_parent + 8);
+				const __m128 parent_3 = _mm_loadu_ps(p_parent + 12);
+
+				for (u32 column = 0; column < 4; ++column)
+				{
+					const f32* p_column = p_local + column * 4;
+
+					__m128 result = _mm_mul_ps(parent_0, _mm_set1_ps(p_column[0]));
+					result        = _mm_add_ps(result, _mm_mul_ps(parent_1, _mm_set1_ps(p_column[1])));
+					result        = _mm_add_ps(result, _mm_mul_ps(parent_2, _mm_set1_ps(p_column[2])));
+					result        = _mm_add_ps(result, _mm_mul_ps(parent_3, _mm_set1_ps(p_column[3])));
+
+					_mm_storeu_ps(p_world + column * 4, result);
+				}
+			}
+		}
+
+		// Two result columns per register, each half broadcasting its own column's elements.
+		cc_simd_target("avx2,fma") void propagate_avx2(const u32* p_parents, const glm::mat4* p_locals, glm::mat4* p_worlds, u32 begin, u32 end) noexcept
+		{
+			const __m256i splat_0 = _mm256_setr_epi32(0, 0, 0, 0, 4, 4, 4, 4);
+			const __m256i splat_1 = _mm256_setr_epi32(1, 1, 1, 1, 5, 5, 5, 5);
+			const __m256i splat_2 = _mm256_setr_epi32(2, 2, 2, 2, 6, 6, 6, 6);
+			const __m256i splat_3 = _mm256_setr_epi32(3, 3, 3, 3, 7, 7, 7, 7);
+
+			for (u32 index = begin; index < end; ++index)
+			{
+				const u32 parent = p_parents[index];
+
+				if (parent == no_transform)
+				{
+					p_worlds[index] = p_locals[index];
+					continue;
+				}
+
+				const f32* p_parent = &p_worlds[parent][0][0];
+				const f32* p_local  = &p_locals[index][0][0];
+				f32* p_world        = &p_worlds[index][0][0];
+
+				const __m256 parent_0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(p_parent));
+				const __m256 parent_1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(p_parent + 4));
+				const __m256 parent_2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(p_parent + 8));
+				const __m256 parent_3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(p_parent + 12));
+
+				for (u32 half = 0; half < 2; ++half)
+				{
+					const __m256 columns = _mm256_loadu_ps(p_local + half * 8);
+
+					__m256 result = _mm256_mul_ps(parent_0, _mm256_permutevar8x32_ps(columns, splat_0));
+					result        = _mm256_fmadd_ps(parent_1, _mm256_permutevar8x32_ps(columns, splat_1), result);
+					result        = _mm256_fmadd_ps(parent_2, _mm256_permutevar8x32_ps(columns, splat_2), result);
+					result        = _mm256_fmadd_ps(parent_3, _mm256_permutevar8x32_ps(columns, splat_3), result);
+
+					_mm256_storeu_ps(p_world + half * 8, result);
+				}
+			}
+		}
+
+		// The whole matrix in one register.
+		cc_simd_target("avx512f") void propagate_avx512(const u32* p_parents, const glm::mat4* p_locals, glm::mat4* p_worlds, u32 begin, u32 end) noexcept
+		{
+			const __m512i splat_0 = _mm512_setr_epi32(0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12);
+			const __m512i splat_1 = _mm512_setr_epi32(1, 1, 1, 1, 5, 5, 5, 5, 9, 9, 9, 9, 13, 13, 13, 13);
+			const __m512i splat_2 = _mm512_setr_epi32(2, 2, 2, 2, 6, 6, 6, 6, 10, 10, 10, 10, 14, 14, 14, 14);
+			const __m512i splat_3 = _mm512_setr_epi32(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+
+			for (u32 index = begin; index < end; ++index)
+			{
+				const u32 parent = p_parents[index];
+
+				if (parent == no_transform)
+				{
+					p_worlds[index] = p_locals[index];
+					continue;
+				}
+
+				const f32* p_parent = &p_worlds[parent][0][0];
+				const f32* p_local  = &p_locals[index][0][0];
+				f32* p_world        = &p_worlds[index][0][0];
+
+				const __m512 parent_0 = _mm512_broadcast_f32x4(_mm_loadu_ps(p_parent));
+				const __m512 parent_1 = _mm512_broadcast_f32x4(_mm_loadu_ps(p_parent + 4));
+				const __m512 parent_2 = _mm512_broadcast_f32x4(_mm_loadu_ps(p_parent + 8));
+				const __m512 parent_3 = _mm512_broadcast_f32x4(_mm_loadu_ps(p_parent + 12));
+
+				const __m512 columns = _mm512_loadu_ps(p_local);
+
+				__m512 result = _mm512_mul_ps(parent_0, _mm512_permutexvar_ps(splat_0, columns));
+				result        = _mm512_fmadd_ps(parent_1, _mm512_permutexvar_ps(splat_1, columns), result);
+				result        = _mm512_fmadd_ps(parent_2, _mm512_permutexvar_ps(splat_2, columns), result);
+				result        = _mm512_fmadd_ps(parent_3, _mm512_permutexvar_ps(splat_3, columns), result);
+
+				_mm512_storeu_ps(p_world, result);
+			}
+		}
+#endif
+	} // namespace
+
+	void propagate_transforms(const u32* p_parents, const glm::mat4* p_locals, glm::mat4* p_worlds, u32 begin, u32 end, simd_level level)
+	{
+		switch (clamp_simd_level(level))
+		{
+#if CAPRICORN_SIMD_X86
+			case simd_level::avx512:
+				propagate_avx512(p_parents, p_locals, p_worlds, begin, end);
+				break;
+			case simd_level::avx2:
+				propagate_avx2(p_parents, p_locals, p_worlds, begin, end);
+				break;
+			case simd_level::sse4:
+				propagate_sse4(p_parents, p_locals, p_worlds, begin, end);
+				break;
+#endif
+			default:
+				propagate_scalar(p_parents, p_locals, p_worlds, begin, end);
+				break;
+		}
+	}
+
+	transform_hierarchy::transform_hierarchy(const transform_hierarchy_create_info& create_info)
+	{
+		m_positions.reserve(create_info.capacity);
+		m_child_counts.reserve(create_info.capacity);
+		m_nodes.reserve(create_info.capacity);
+		m_parents.reserve(create_info.capacity);
+		m_depths.reserve(create_info.capacity);
+		m_locals.reserve(create_info.capacity);
+		m_worlds.reserve(create_info.capacity);
+	}
+
+	std::shared_ptr<transform_hierarchy> transform_hierarchy::create(const transform_hierarchy_create_info& create_info)
+	{
+		return std::make_shared<transform_hierarchy>(create_info);
+	}
+
+	u32 transform_hierarchy::add(u32 parent, const glm::mat4& local)
+	{
+		ensure(parent == no_transform || (parent < m_positions.size() && m_positions[parent] != no_transform), "Parent transform does not exist!");
+
+		u32 node = 0;
+
+		if (!m_free_nodes.empty())
+		{
+			node = m_free_nodes.back();
+			m_free_nodes.pop_back();
+		}
+		else
+		{
+			node = static_cast<u32>(m_positions.size());
+			m_positions.push_back(no_transform);
+			m_child_counts.push_back(0);
+		}
+
+		const u32 parent_position = parent == no_transform ? no_transform : m_positions[parent];
+		const u32 depth           = parent == no_transform ? 0 : m_depths[parent_position] + 1;
+		const auto position       = static_cast<u32>(m_nodes.size());
+
+		m_positions[node] = position;
+
+		m_nodes.push_back(node);
+		m_parents.push_back(parent_position);
+		m_depths.push_back(depth);
+		m_locals.push_back(local);
+
+		// Right for now, so get_world() is sensible before the next update().
+		m_worlds.push_back(parent == no_transform ? local : m_worlds[parent_position] * local);
+
+		if (parent != no_transform)
+		{
+			++m_child_counts[parent];
+		}
+
+		++m_count;
+
+		// Appending to the deepest depth, or opening a new one, keeps the order.
+		const auto depth_count = static_cast<u32>(m_depth_starts.size() - 1);
+
+		if (m_unsorted || depth + 1 < depth_count)
+		{
+			m_unsorted = true;
+		}
+		else if (depth + 1 == depth_count)
+		{
+			m_depth_starts.back() = position + 1;
+		}
+		else
+		{
+			m_depth_starts.push_back(position + 1);
+		}
+
+		return node;
+	}
+
+	void transform_hierarchy::remove(u32 node)
+	{
+		ensure(node < m_positions.size() && m_positions[node] != no_transform, "Removed a transform that does not exist!");
+		ensure(m_child_counts[node] == 0, "Removed a transform that still has children!");
+
+		const u32 position        = m_positions[node];
+		const u32 parent_position = m_parents[position];
+
+		if (parent_position != no_transform)
+		{
+			--m_child_counts[m_nodes[parent_position]];
+		}
+
+		m_nodes[position] = no_transform;
+		m_positions[node] = no_transform;
+		m_free_nodes.push_back(node);
+
+		--m_count;
+		m_unsorted = true;
+	}
+
+	void transform_hierarchy::set_local(u32 node, const glm::mat4& local)
+	{
+		m_locals[m_positions[node]] = local;
+	}
+
+	const glm::mat4& transform_hierarchy::get_local(u32 node) const
+	{
+		return m_locals[m_positions[node]];
+	}
+
+	const glm::mat4& transform_hierarchy::get_world(u32 node) const
+	{
+		return m_worlds[m_positions[node]];
+	}
+
+	u32 transform_hierarchy::get_parent(u32 node) const
+	{
+		const u32 parent_position = m_parents[m_positions[node]];
+		return parent_position == no_transform ? no_transform : m_nodes[parent_position];
+	}
+
+	void transform_hierarchy::update(job_system* p_job_system, simd_level level)
+	{
+		cc_profile_zone("transform_hierarchy::update");
+
+		if (m_unsorted)
+		{
+			sort();
+		}
+
+		for (std::size_t depth = 0; depth + 1 < m_depth_starts.size(); ++depth)
+		{
+			const u32 begin = m_depth_starts[depth];
+			const u32 end   = m_depth_starts[depth + 1];
+
+			if (p_job_system == nullptr || end - begin < parallel_threshold)
+			{
+				propagate_transforms(m_parents.data(), m_locals.data(), m_worlds.data(), begin, end, level);
+				continue;
+			}
+
+			p_job_system->parallel_for(end - begin, parallel_threshold / 4, [this, begin, level](u32 first, u32 last) {
+				propagate_transforms(m_parents.data(), m_locals.data(), m_worlds.data(), begin + first, begin + last, level);
+			});
+		}
+	}
+
+	u32 transform_hierarchy::get_count() const noexcept
+	{
+		return m_count;
+	}
+
+	u32 transform_hierarchy::get_depth_count() const noexcept
+	{
+		return static_cast<u32>(m_depth_starts.size() - 1);
+	}
+
+	const u32* transform_hierarchy::get_sorted_nodes() const noexcept
+	{
+		return m_nodes.data();
+	}
+
+	const glm::mat4* transform_hierarchy::get_sorted_worlds() const noexcept
+	{
+		return m_worlds.data();
+	}
+
+	void transform_hierarchy::sort()
+	{
+		cc_profile_zone("transform_hierarchy::sort");
+
+		// A stable counting sort, which keeps siblings in the order they were added.
+		u32 depth_count = 0;
+
+		for (std::size_t position = 0; position < m_nodes.size(); ++position)
+		{
+			if (m_nodes[position] != no_transform)
+			{
+				depth_count = std::max(depth_count, m_depths[position] + 1);
+			}
+		}
+
+		m_depth_starts.assign(depth_count + 1, 0);
+
+		for (std::size_t position = 0; position < m_nodes.size(); ++position)
+		{
+			if (m_nodes[position] != no_transform)
+			{
+				++m_depth_starts[m_depths[position] + 1];
+			}
+		}
+
+		for (u32 depth = 0; depth < depth_count; ++depth)
+		{
+			m_depth_starts[depth + 1] += m_depth_starts[depth];
+		}
+
+		std::vector<u32> nodes(m_count);
+		std::vector<u32> parents(m_count);
+		std::vector<u32> depths(m_count);
+		std::vector<glm::mat4> locals(m_count);
+		std::vector<glm::mat4> worlds(m_count);
+		std::vector<u32> cursors(m_depth_starts.begin(), m_depth_starts.end() - 1);
+
+		for (std::size_t position = 0; position < m_nodes.size(); ++position)
+		{
+			const u32 node = m_nodes[position];
+
+			if (node == no_transform)
+			{
+				continue;
+			}
+
+			const u32 sorted = cursors[m_depths[position]]++;
+
+			nodes[sorted]  = node;
+			depths[sorted] = m_depths[position];
+			locals[sorted] = m_locals[position];
+			worlds[sorted] = m_worlds[position];
+
+			// The parent's id for now, translated into its new position once every node has one.
+			parents[sorted] = m_parents[position] == no_transform ? no_transform : m_nodes[m_parents[position]];
+		}
+
+		for (u32 sorted = 0; sorted < m_count; ++sorted)
+		{
+			m_positions[nodes[sorted]] = sorted;
+		}
+
+		for (u32& parent: parents)
+		{
+			parent = parent == no_transform ? no_transform : m_positions[parent];
+		}
+
+		m_nodes    = std::move(nodes);
+		m_parents  = std::move(parents);
+		m_depths   = std::move(depths);
+		m_locals   = std::move(locals);
+		m_worlds   = std::move(worlds);
+		m_unsorted = false;
+	}
+} // namespace cc::math
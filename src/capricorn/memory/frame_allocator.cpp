@@ -0,0 +1,60 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/memory/frame_allocator.hpp"
+
+namespace cc
+{
+	frame_allocator::frame_allocator(const frame_allocator_create_info& create_info)
+	{
+		for (auto& arena: m_arenas)
+		{
+			arena = std::make_unique<linear_arena>(linear_arena_create_info{ .capacity = create_info.capacity_per_frame, .tag = memory_tag::frame });
+		}
+	}
+
+	std::shared_ptr<frame_allocator> frame_allocator::create(const frame_allocator_create_info& create_info)
+	{
+		return std::make_shared<frame_allocator>(create_info);
+	}
+
+	void frame_allocator::begin_frame() noexcept
+	{
+		m_current = (m_current + 1) % frame_count;
+		m_arenas[m_current]->reset();
+	}
+
+	linear_arena& frame_allocator::get_current() noexcept
+	{
+		return *m_arenas[m_current];
+	}
+
+	std::pmr::memory_resource* frame_allocator::get_resource() noexcept
+	{
+		return m_arenas[m_current].get();
+	}
+
+	std::size_t frame_allocator::get_peak() const noexcept
+	{
+		std::size_t peak = 0;
+
+		for (const auto& arena: m_arenas)
+		{
+			peak = std::max(peak, arena->get_peak());
+		}
+
+		return peak;
+	}
+
+	u64 frame_allocator::get_overflow_count() const noexcept
+	{
+		u64 overflow_count = 0;
+
+		for (const auto& arena: m_arenas)
+		{
+			overflow_count += arena->get_overflow_count();
+		}
+
+		return overflow_count;
+	}
+} // namespace cc
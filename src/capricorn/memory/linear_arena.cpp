@@ -0,0 +1,146 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/memory/linear_arena.hpp"
+
+namespace cc
+{
+	namespace details
+	{
+		constexpr std::size_t arena_buffer_alignment = 64;
+
+		constexpr std::size_t align_up(std::size_t value, std::size_t alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+	} // namespace details
+
+	linear_arena::linear_arena(const linear_arena_create_info& create_info)
+	    : m_create_info(create_info)
+	{
+		if (m_create_info.capacity != 0)
+		{
+			m_buffer = static_cast<std::byte*>(::operator new(m_create_info.capacity, std::align_val_t{ details::arena_buffer_alignment }));
+		}
+	}
+
+	linear_arena::~linear_arena()
+	{
+		reset();
+
+		if (m_buffer != nullptr)
+		{
+			::operator delete(m_buffer, std::align_val_t{ details::arena_buffer_alignment });
+		}
+	}
+
+	void linear_arena::reset() noexcept
+	{
+		publish_usage(m_offset + m_overflowed, m_allocations);
+		release_overflow(nullptr);
+
+		m_offset      = 0;
+		m_allocations = 0;
+	}
+
+	linear_arena::marker linear_arena::get_marker() const noexcept
+	{
+		return { .offset = m_offset, .overflowed = m_overflowed, .p_overflow = m_overflow, .allocations = m_allocations };
+	}
+
+	void linear_arena::rewind(const marker& marker) noexcept
+	{
+		publish_usage(m_offset - marker.offset + m_overflowed - marker.overflowed, m_allocations - marker.allocations);
+		release_overflow(static_cast<const overflow_block*>(marker.p_overflow));
+
+		m_offset      = marker.offset;
+		m_allocations = marker.allocations;
+	}
+
+	std::size_t linear_arena::get_used() const noexcept
+	{
+		return m_offset + m_overflowed;
+	}
+
+	std::size_t linear_arena::get_capacity() const noexcept
+	{
+		return m_create_info.capacity;
+	}
+
+	std::size_t linear_arena::get_peak() const noexcept
+	{
+		return std::max(m_peak, m_offset + m_overflowed);
+	}
+
+	u64 linear_arena::get_overflow_count() const noexcept
+	{
+		return m_overflow_count;
+	}
+
+	void* linear_arena::do_allocate(std::size_t bytes, std::size_t alignment)
+	{
+		++m_allocations;
+
+		// Align the address rather than the offset so alignments above the buffer's own still hold.
+		const auto base         = reinterpret_cast<std::uintptr_t>(m_buffer);
+		const std::size_t begin = details::align_up(base + m_offset, alignment) - base;
+
+		if (m_buffer != nullptr && begin + bytes <= m_create_info.capacity)
+		{
+			m_offset = begin + bytes;
+			return m_buffer + begin;
+		}
+
+		return allocate_overflow(bytes, alignment);
+	}
+
+	void linear_arena::do_deallocate(cc_unused void* p_memory, cc_unused std::size_t bytes, cc_unused std::size_t alignment)
+	{
+		// Memory is reclaimed by reset() and rewind().
+	}
+
+	b8 linear_arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+	{
+		return this == &other;
+	}
+
+	void* linear_arena::allocate_overflow(std::size_t bytes, std::size_t alignment)
+	{
+		alignment                = std::max(alignment, alignof(overflow_block));
+		const std::size_t header = details::align_up(sizeof(overflow_block), alignment);
+		const std::size_t size   = header + bytes;
+
+		auto* p_block      = static_cast<overflow_block*>(::operator new(size, std::align_val_t{ alignment }));
+		p_block->p_next    = m_overflow;
+		p_block->size      = size;
+		p_block->alignment = alignment;
+
+		m_overflow = p_block;
+		m_overflowed += bytes;
+		++m_overflow_count;
+
+		return reinterpret_cast<std::byte*>(p_block) + header;
+	}
+
+	void linear_arena::release_overflow(const overflow_block* p_until) noexcept
+	{
+		while (m_overflow != nullptr && m_overflow != p_until)
+		{
+			overflow_block* p_block = m_overflow;
+			m_overflow              = p_block->p_next;
+			m_overflowed -= p_block->size - details::align_up(sizeof(overflow_block), p_block->alignment);
+
+			::operator delete(p_block, std::align_val_t{ p_block->alignment });
+		}
+	}
+
+	void linear_arena::publish_usage(std::size_t used, u64 allocations) noexcept
+	{
+		m_peak = std::max(m_peak, m_offset + m_overflowed);
+
+		if (allocations != 0)
+		{
+			memory_tracker::record_transient(m_create_info.tag, used, allocations);
+		}
+	}
+} // namespace cc
@@ -0,0 +1,86 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/memory/memory_tracker.hpp"
+
+namespace cc
+{
+	std::array<memory_tracker::counters, static_cast<std::size_t>(memory_tag::count)> memory_tracker::s_counters;
+
+	void memory_tracker::allocated(memory_tag tag, u64 size) noexcept
+	{
+		counters& counters = s_counters[static_cast<std::size_t>(tag)];
+
+		const u64 current = counters.current.fetch_add(size, std::memory_order_relaxed) + size;
+		counters.allocations.fetch_add(1, std::memory_order_relaxed);
+
+		raise_peak(counters, current);
+	}
+
+	void memory_tracker::freed(memory_tag tag, u64 size) noexcept
+	{
+		s_counters[static_cast<std::size_t>(tag)].current.fetch_sub(size, std::memory_order_relaxed);
+	}
+
+	void memory_tracker::record_transient(memory_tag tag, u64 size, u64 allocations) noexcept
+	{
+		counters& counters = s_counters[static_cast<std::size_t>(tag)];
+
+		counters.allocations.fetch_add(allocations, std::memory_order_relaxed);
+
+		raise_peak(counters, counters.current.load(std::memory_order_relaxed) + size);
+	}
+
+	memory_tag_statistics memory_tracker::get_statistics(memory_tag tag) noexcept
+	{
+		const counters& counters = s_counters[static_cast<std::size_t>(tag)];
+
+		return {
+		        .current     = counters.current.load(std::memory_order_relaxed),
+		        .peak        = counters.peak.load(std::memory_order_relaxed),
+		        .allocations = counters.allocations.load(std::memory_order_relaxed),
+		};
+	}
+
+	const char* memory_tracker::get_name(memory_tag tag) noexcept
+	{
+		switch (tag)
+		{
+			case memory_tag::general:
+				return "general";
+			case memory_tag::frame:
+				return "frame";
+			case memory_tag::scratch:
+				return "scratch";
+			case memory_tag::ecs:
+				return "ecs";
+			default:
+				return "unknown";
+		}
+	}
+
+	void memory_tracker::log_statistics()
+	{
+		for (std::size_t index = 0; index < s_counters.size(); ++index)
+		{
+			const auto tag                         = static_cast<memory_tag>(index);
+			const memory_tag_statistics statistics = get_statistics(tag);
+
+			if (statistics.allocations == 0)
+			{
+				continue;
+			}
+
+			log::info(log_source::application, "Memory [{}]: peak {} bytes, {} bytes outstanding, {} allocations.", get_name(tag), statistics.peak, statistics.current, statistics.allocations);
+		}
+	}
+
+	void memory_tracker::raise_peak(counters& counters, u64 value) noexcept
+	{
+		u64 peak = counters.peak.load(std::memory_order_relaxed);
+
+		while (value > peak && !counters.peak.compare_exchange_weak(peak, value, std::memory_order_relaxed))
+		{
+		}
+	}
+} // namespace cc
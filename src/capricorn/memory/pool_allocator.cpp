@@ -0,0 +1,142 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/memory/pool_allocator.hpp"
+
+#include <bit>
+
+namespace cc
+{
+	pool_allocator::pool_allocator(const pool_allocator_create_info& create_info)
+	    : m_create_info(create_info)
+	{
+		ensure(std::has_single_bit(m_create_info.block_alignment), "Pool block alignment must be a power of two!");
+		ensure(m_create_info.blocks_per_chunk > 0, "Pool chunks must hold at least one block!");
+
+		// Every free block stores the free-list link, and blocks must stay aligned back to back.
+		m_create_info.block_alignment = std::max(m_create_info.block_alignment, alignof(free_block));
+		m_create_info.block_size      = std::max(m_create_info.block_size, sizeof(free_block));
+		m_create_info.block_size      = (m_create_info.block_size + m_create_info.block_alignment - 1) & ~(m_create_info.block_alignment - 1);
+	}
+
+	pool_allocator::~pool_allocator()
+	{
+		if (m_blocks_in_use != 0)
+		{
+			log::warning(log_source::application, "Pool of {} byte blocks destroyed with {} blocks still in use.", m_create_info.block_size, m_blocks_in_use);
+		}
+
+		for (std::byte* p_chunk: m_chunks)
+		{
+			::operator delete(p_chunk, std::align_val_t{ m_create_info.block_alignment });
+		}
+
+		memory_tracker::freed(m_create_info.tag, m_blocks_in_use * m_create_info.block_size);
+	}
+
+	std::size_t pool_allocator::get_block_size() const noexcept
+	{
+		return m_create_info.block_size;
+	}
+
+	u64 pool_allocator::get_blocks_in_use() const noexcept
+	{
+		return m_blocks_in_use;
+	}
+
+	u64 pool_allocator::get_peak_blocks_in_use() const noexcept
+	{
+		return m_peak_blocks_in_use;
+	}
+
+	std::size_t pool_allocator::get_reserved() const noexcept
+	{
+		return m_chunks.size() * m_create_info.blocks_per_chunk * m_create_info.block_size;
+	}
+
+	void* pool_allocator::do_allocate(std::size_t bytes, std::size_t alignment)
+	{
+		if (!fits(bytes, alignment))
+		{
+			return std::pmr::get_default_resource()->allocate(bytes, alignment);
+		}
+
+		if (m_create_info.thread_safe)
+		{
+			std::lock_guard const lock(m_mutex);
+			return pop_block();
+		}
+
+		return pop_block();
+	}
+
+	void pool_allocator::do_deallocate(void* p_memory, std::size_t bytes, std::size_t alignment)
+	{
+		if (!fits(bytes, alignment))
+		{
+			std::pmr::get_default_resource()->deallocate(p_memory, bytes, alignment);
+			return;
+		}
+
+		if (m_create_info.thread_safe)
+		{
+			std::lock_guard const lock(m_mutex);
+			push_block(p_memory);
+			return;
+		}
+
+		push_block(p_memory);
+	}
+
+	b8 pool_allocator::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+	{
+		return this == &other;
+	}
+
+	b8 pool_allocator::fits(std::size_t bytes, std::size_t alignment) const noexcept
+	{
+		return bytes <= m_create_info.block_size && alignment <= m_create_info.block_alignment;
+	}
+
+	void* pool_allocator::pop_block()
+	{
+		if (m_free_list == nullptr)
+		{
+			grow();
+		}
+
+		free_block* p_block = m_free_list;
+		m_free_list         = p_block->p_next;
+
+		m_peak_blocks_in_use = std::max(m_peak_blocks_in_use, ++m_blocks_in_use);
+		memory_tracker::allocated(m_create_info.tag, m_create_info.block_size);
+
+		return p_block;
+	}
+
+	void pool_allocator::push_block(void* p_memory) noexcept
+	{
+		auto* p_block   = static_cast<free_block*>(p_memory);
+		p_block->p_next = m_free_list;
+		m_free_list     = p_block;
+
+		--m_blocks_in_use;
+		memory_tracker::freed(m_create_info.tag, m_create_info.block_size);
+	}
+
+	void pool_allocator::grow()
+	{
+		const std::size_t chunk_size = m_create_info.block_size * m_create_info.blocks_per_chunk;
+
+		auto* p_chunk = static_cast<std::byte*>(::operator new(chunk_size, std::align_val_t{ m_create_info.block_alignment }));
+		m_chunks.push_back(p_chunk);
+
+		// Thread the new blocks in address order so consecutive allocations stay adjacent.
+		for (u32 index = m_create_info.blocks_per_chunk; index-- > 0;)
+		{
+			auto* p_block   = reinterpret_cast<free_block*>(p_chunk + index * m_create_info.block_size);
+			p_block->p_next = m_free_list;
+			m_free_list     = p_block;
+		}
+	}
+} // namespace cc
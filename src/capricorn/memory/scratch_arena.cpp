@@ -0,0 +1,37 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/memory/scratch_arena.hpp"
+
+namespace cc
+{
+	namespace details
+	{
+		linear_arena& get_thread_scratch_arena()
+		{
+			thread_local linear_arena arena({ .capacity = scratch_arena::capacity, .tag = memory_tag::scratch });
+			return arena;
+		}
+	} // namespace details
+
+	scratch_arena::scratch_arena()
+	    : m_arena(details::get_thread_scratch_arena()),
+	      m_marker(m_arena.get_marker())
+	{
+	}
+
+	scratch_arena::~scratch_arena()
+	{
+		m_arena.rewind(m_marker);
+	}
+
+	std::pmr::memory_resource* scratch_arena::get_resource() const noexcept
+	{
+		return &m_arena;
+	}
+
+	linear_arena& scratch_arena::get_arena() const noexcept
+	{
+		return m_arena;
+	}
+} // namespace cc
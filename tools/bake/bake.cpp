@@ -0,0 +1,393 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/assets/asset_pack_format.hpp"
+#include "capricorn/base/hash.hpp"
+#include "capricorn/base/log.hpp"
+#include "capricorn/graphics/texture/block_compression.hpp"
+#include "capricorn/jobs/job_system.hpp"
+
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <lz4.h>
+#include <lz4hc.h>
+#include <zstd.h>
+
+namespace cc::bake
+{
+	enum class texture_mode : u8
+	{
+		rgba8 = 0,
+		bc1,
+		bc7,
+		automatic, // BC1 for opaque textures, BC7 for the rest.
+	};
+
+	struct options
+	{
+		std::filesystem::path input;
+		std::filesystem::path output;
+		asset_pack_format::compression compression = asset_pack_format::compression::lz4;
+		texture_mode textures                      = texture_mode::rgba8;
+		b8 srgb                                    = true;
+	};
+
+	struct baked_entry
+	{
+		std::filesystem::path file;
+		std::string name; // Relative to the asset directory, with forward slashes.
+		asset_pack_format::entry_kind kind         = asset_pack_format::entry_kind::raw;
+		asset_pack_format::compression compression = asset_pack_format::compression::none;
+		std::vector<u8> stored;
+		u64 size  = 0;
+		b8 failed = false;
+	};
+
+	// Compression has to save at least this share of an entry to be worth giving up zero-copy access to it.
+	constexpr u64 minimum_saving_divisor = 8;
+
+	std::vector<u8> read_file(const std::filesystem::path& path)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			return {};
+		}
+
+		std::vector<u8> contents(static_cast<std::size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+
+		return contents;
+	}
+
+	// Empty when the compressed form is not worth keeping.
+	std::vector<u8> compress(std::span<const u8> data, asset_pack_format::compression compression)
+	{
+		std::vector<u8> compressed;
+
+		switch (compression)
+		{
+			case asset_pack_format::compression::lz4:
+			{
+				if (data.size() > static_cast<std::size_t>(LZ4_MAX_INPUT_SIZE))
+				{
+					return {};
+				}
+
+				compressed.resize(static_cast<std::size_t>(LZ4_compressBound(static_cast<int>(data.size()))));
+
+				// Baking is offline, so spend the time on the ratio; decompression speed is the same either way.
+				const int size = LZ4_compress_HC(reinterpret_cast<const char*>(data.data()),
+				                                 reinterpret_cast<char*>(compressed.data()),
+				                                 static_cast<int>(data.size()),
+				                                 static_cast<int>(compressed.size()),
+				                                 LZ4HC_CLEVEL_MAX);
+				compressed.resize(size > 0 ? static_cast<std::size_t>(size) : 0);
+				break;
+			}
+			case asset_pack_format::compression::zstd:
+			{
+				compressed.resize(ZSTD_compressBound(data.size()));
+
+				const std::size_t size = ZSTD_compress(compressed.data(), compressed.size(), data.data(), data.size(), 19);
+				compressed.resize(ZSTD_isError(size) == 0 ? size : 0);
+				break;
+			}
+			default:
+				return {};
+		}
+
+		if (compressed.empty() || compressed.size() > data.size() - data.size() / minimum_saving_divisor)
+		{
+			return {};
+		}
+
+		return compressed;
+	}
+
+	// PNGs become GPU-ready mip chains, everything else is stored as is.
+	void bake_entry(const options& options, baked_entry& entry)
+	{
+		std::vector<u8> payload = read_file(entry.file);
+
+		if (payload.empty() && !std::filesystem::is_empty(entry.file))
+		{
+			std::fprintf(stderr, "Failed to read %s.\n", entry.file.string().c_str());
+			entry.failed = true;
+			return;
+		}
+
+		if (entry.file.extension() == ".png")
+		{
+			std::optional<texture_data> texture = decode_png(payload);
+
+			if (!texture.has_value())
+			{
+				std::fprintf(stderr, "Failed to decode %s.\n", entry.file.string().c_str());
+				entry.failed = true;
+				return;
+			}
+
+			generate_mips(*texture, options.srgb);
+
+			texture_encoding encoding = texture_encoding::rgba8;
+
+			switch (options.textures)
+			{
+				case texture_mode::bc1:
+					encoding = texture_encoding::bc1;
+					break;
+				case texture_mode::bc7:
+					encoding = texture_encoding::bc7;
+					break;
+				case texture_mode::automatic:
+					encoding = is_opaque(*texture) ? texture_encoding::bc1 : texture_encoding::bc7;
+					break;
+				default:
+					break;
+			}
+
+			if (encoding != texture_encoding::rgba8)
+			{
+				*texture = compress_texture(*texture, encoding);
+			}
+
+			payload    = serialize_texture(*texture, options.srgb);
+			entry.kind = asset_pack_format::entry_kind::texture;
+		}
+
+		entry.size = payload.size();
+
+		std::vector<u8> compressed = compress(payload, options.compression);
+
+		if (!compressed.empty())
+		{
+			entry.compression = options.compression;
+			entry.stored      = std::move(compressed);
+		}
+		else
+		{
+			entry.stored = std::move(payload);
+		}
+	}
+
+	void pad(std::ofstream& file, u64 alignment)
+	{
+		static constexpr std::array<char, asset_pack_format::payload_alignment> zeros = {};
+
+		const auto position = static_cast<u64>(file.tellp());
+		const u64 padding   = (alignment - position % alignment) % alignment;
+
+		file.write(zeros.data(), static_cast<std::streamsize>(padding));
+	}
+
+	template<typename T>
+	void write(std::ofstream& file, std::span<const T> values)
+	{
+		file.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size_bytes()));
+	}
+
+	b8 write_pack(const options& options, const std::vector<baked_entry>& entries)
+	{
+		using namespace asset_pack_format;
+
+		std::ofstream file(options.output, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			std::fprintf(stderr, "Failed to open %s.\n", options.output.string().c_str());
+			return false;
+		}
+
+		file_header header = {};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		std::vector<entry> table;
+		std::string names;
+
+		for (const baked_entry& baked: entries)
+		{
+			pad(file, payload_alignment);
+
+			table.push_back({
+			        .name_hash   = fnv1a(baked.name.data(), baked.name.size()),
+			        .offset      = static_cast<u64>(file.tellp()),
+			        .stored_size = baked.stored.size(),
+			        .size        = baked.size,
+			        .name_offset = static_cast<u32>(names.size()),
+			        .name_length = static_cast<u32>(baked.name.size()),
+			        .kind        = baked.kind,
+			        .compression = baked.compression,
+			        .reserved    = {},
+			});
+
+			names += baked.name;
+			write(file, std::span<const u8>(baked.stored));
+		}
+
+		// At most half full, so a probe rarely passes more than a slot or two.
+		const u32 slot_count = table.empty() ? 0 : std::bit_ceil(static_cast<u32>(table.size()) * 2);
+		std::vector<u32> slots(slot_count, empty_slot);
+
+		for (u32 index = 0; index < table.size(); index++)
+		{
+			u32 slot = static_cast<u32>(table[index].name_hash) & (slot_count - 1);
+
+			while (slots[slot] != empty_slot)
+			{
+				slot = (slot + 1) & (slot_count - 1);
+			}
+
+			slots[slot] = index;
+		}
+
+		pad(file, alignof(entry));
+		header.entries_offset = static_cast<u64>(file.tellp());
+		write(file, std::span<const entry>(table));
+
+		header.slots_offset = static_cast<u64>(file.tellp());
+		write(file, std::span<const u32>(slots));
+
+		header.names_offset = static_cast<u64>(file.tellp());
+		header.names_size   = names.size();
+		file.write(names.data(), static_cast<std::streamsize>(names.size()));
+
+		u64 checksum = fnv1a(table.data(), table.size() * sizeof(entry));
+		checksum     = fnv1a(slots.data(), slots.size() * sizeof(u32), checksum);
+		checksum     = fnv1a(names.data(), names.size(), checksum);
+
+		header.magic           = magic;
+		header.version         = version;
+		header.byte_order_mark = byte_order;
+		header.entry_count     = static_cast<u32>(table.size());
+		header.slot_count      = slot_count;
+		header.table_checksum  = checksum;
+
+		file.seekp(0);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		return static_cast<bool>(file);
+	}
+
+	b8 parse_options(int argc, char** argv, options& options)
+	{
+		if (argc < 3)
+		{
+			return false;
+		}
+
+		options.input  = argv[1];
+		options.output = argv[2];
+
+		for (int index = 3; index < argc; ++index)
+		{
+			const std::string_view argument = argv[index];
+			const std::string_view value    = index + 1 < argc ? argv[index + 1] : "";
+
+			if (argument == "--linear")
+			{
+				options.srgb = false;
+			}
+			else if (argument == "--compression" && (value == "none" || value == "lz4" || value == "zstd"))
+			{
+				options.compression = value == "none" ? asset_pack_format::compression::none : (value == "lz4" ? asset_pack_format::compression::lz4 : asset_pack_format::compression::zstd);
+				++index;
+			}
+			else if (argument == "--textures" && (value == "rgba8" || value == "bc1" || value == "bc7" || value == "auto"))
+			{
+				options.textures = value == "rgba8" ? texture_mode::rgba8 : (value == "bc1" ? texture_mode::bc1 : (value == "bc7" ? texture_mode::bc7 : texture_mode::automatic));
+				++index;
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+} // namespace cc::bake
+
+int main(int argc, char** argv)
+{
+	cc::bake::options options;
+
+	if (!cc::bake::parse_options(argc, argv, options))
+	{
+		std::fprintf(stderr, "Usage: capricorn_bake <asset directory> <output.ccpack> [--compression none|lz4|zstd] [--textures rgba8|bc1|bc7|auto] [--linear]\n");
+		return 1;
+	}
+
+	if (!std::filesystem::is_directory(options.input))
+	{
+		std::fprintf(stderr, "%s is not a directory.\n", options.input.string().c_str());
+		return 1;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<cc::bake::baked_entry> entries;
+
+	for (const std::filesystem::directory_entry& file: std::filesystem::recursive_directory_iterator(options.input))
+	{
+		if (file.is_regular_file())
+		{
+			entries.push_back({ .file = file.path(), .name = std::filesystem::relative(file.path(), options.input).generic_string(), .stored = {} });
+		}
+	}
+
+	// Keeps packs reproducible whatever order the file system lists the files in.
+	std::sort(entries.begin(), entries.end(), [](const cc::bake::baked_entry& left, const cc::bake::baked_entry& right) {
+		return left.name < right.name;
+	});
+
+	cc::log::initialize();
+
+	{
+		const auto jobs = cc::job_system::create({});
+
+		jobs->parallel_for(static_cast<u32>(entries.size()), 1, [&options, &entries](u32 begin, u32 end) {
+			for (u32 index = begin; index < end; index++)
+			{
+				cc::bake::bake_entry(options, entries[index]);
+			}
+		});
+	}
+
+	cc::log::shutdown();
+
+	const b8 failed = std::any_of(entries.begin(), entries.end(), [](const cc::bake::baked_entry& entry) {
+		return entry.failed;
+	});
+
+	if (failed || !cc::bake::write_pack(options, entries))
+	{
+		std::filesystem::remove(options.output);
+		return 1;
+	}
+
+	u64 size       = 0;
+	u64 compressed = 0;
+	for (const cc::bake::baked_entry& entry: entries)
+	{
+		size += entry.size;
+		compressed += entry.compression != cc::asset_pack_format::compression::none ? 1 : 0;
+	}
+
+	std::printf("Baked %zu assets (%llu compressed) into %s: %.2f MiB of payloads, %.2f MiB on disk, in %.2f s.\n",
+	            entries.size(),
+	            static_cast<unsigned long long>(compressed),
+	            options.output.string().c_str(),
+	            static_cast<f64>(size) / (1024.0 * 1024.0),
+	            static_cast<f64>(std::filesystem::file_size(options.output)) / (1024.0 * 1024.0),
+	            std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count());
+
+	return 0;
+}
@@ -0,0 +1,301 @@
+// Copyright (c) 2022 Milan Dierick | This source file is licensed under GNU GPLv3.
+// A copy of this license has been included in this project's root directory.
+
+#include "capricorn/base/binary_log_format.hpp"
+#include "capricorn/base/log.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fmt/args.h>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cc::logdecode
+{
+	struct site
+	{
+		spdlog::level::level_enum level = spdlog::level::info;
+		log_source source               = log_source::none;
+		std::uint32_t line              = 0;
+		std::vector<binary_log_format::argument_type> argument_types;
+		std::string file;
+		std::string format;
+	};
+
+	class reader
+	{
+	public:
+		explicit reader(std::vector<char> data)
+		    : m_data(std::move(data))
+		{
+		}
+
+		template<typename T>
+		T read()
+		{
+			T value{};
+			require(sizeof(T));
+			std::memcpy(&value, m_data.data() + m_offset, sizeof(T));
+			m_offset += sizeof(T);
+			return value;
+		}
+
+		std::string read_string()
+		{
+			const auto length = read<std::uint32_t>();
+			require(length);
+			std::string string(m_data.data() + m_offset, length);
+			m_offset += length;
+			return string;
+		}
+
+		void read_bytes(void* p_destination, std::size_t size)
+		{
+			require(size);
+			std::memcpy(p_destination, m_data.data() + m_offset, size);
+			m_offset += size;
+		}
+
+		[[nodiscard]] bool at_end() const noexcept
+		{
+			return m_offset >= m_data.size();
+		}
+
+		[[nodiscard]] std::size_t offset() const noexcept
+		{
+			return m_offset;
+		}
+
+	private:
+		void require(std::size_t size) const
+		{
+			if (m_offset + size > m_data.size())
+			{
+				throw std::runtime_error("Binary log stream is truncated.");
+			}
+		}
+
+		std::vector<char> m_data;
+		std::size_t m_offset = 0;
+	};
+
+	void push_argument(fmt::dynamic_format_arg_store<fmt::format_context>& store, binary_log_format::argument_type type, reader& input)
+	{
+		using argument_type = binary_log_format::argument_type;
+
+		switch (type)
+		{
+			case argument_type::boolean:
+				store.push_back(input.read<bool>());
+				break;
+			case argument_type::character:
+				store.push_back(input.read<char>());
+				break;
+			case argument_type::int8:
+				store.push_back(input.read<std::int8_t>());
+				break;
+			case argument_type::int16:
+				store.push_back(input.read<std::int16_t>());
+				break;
+			case argument_type::int32:
+				store.push_back(input.read<std::int32_t>());
+				break;
+			case argument_type::int64:
+				store.push_back(input.read<std::int64_t>());
+				break;
+			case argument_type::uint8:
+				store.push_back(input.read<std::uint8_t>());
+				break;
+			case argument_type::uint16:
+				store.push_back(input.read<std::uint16_t>());
+				break;
+			case argument_type::uint32:
+				store.push_back(input.read<std::uint32_t>());
+				break;
+			case argument_type::uint64:
+				store.push_back(input.read<std::uint64_t>());
+				break;
+			case argument_type::float32:
+				store.push_back(input.read<float>());
+				break;
+			case argument_type::float64:
+				store.push_back(input.read<double>());
+				break;
+			case argument_type::string:
+				store.push_back(input.read_string());
+				break;
+			case argument_type::pointer:
+				store.push_back(reinterpret_cast<const void*>(static_cast<std::uintptr_t>(input.read<std::uint64_t>())));
+				break;
+			default:
+				throw std::runtime_error("Unknown argument type in binary log stream.");
+		}
+	}
+
+	std::string format_time(std::int64_t time_ns)
+	{
+		const std::time_t seconds = static_cast<std::time_t>(time_ns / 1'000'000'000);
+		const auto microseconds   = static_cast<long>((time_ns / 1'000) % 1'000'000);
+
+		std::tm local_time = {};
+#ifdef _WIN32
+		localtime_s(&local_time, &seconds);
+#else
+		localtime_r(&seconds, &local_time);
+#endif
+
+		return fmt::format("{:02}:{:02}:{:02}.{:06}", local_time.tm_hour, local_time.tm_min, local_time.tm_sec, microseconds);
+	}
+
+	int decode(reader& input, std::FILE* p_output)
+	{
+		const auto header = input.read<binary_log_format::file_header>();
+
+		if (header.magic != binary_log_format::magic)
+		{
+			std::fprintf(stderr, "Input is not a Capricorn binary log stream.\n");
+			return 1;
+		}
+
+		if (header.byte_order_mark != binary_log_format::byte_order)
+		{
+			std::fprintf(stderr, "Binary log stream was written with a different byte order.\n");
+			return 1;
+		}
+
+		if (header.version != binary_log_format::version)
+		{
+			std::fprintf(stderr, "Unsupported binary log stream version %u.\n", header.version);
+			return 1;
+		}
+
+		std::unordered_map<std::uint32_t, site> sites;
+
+		while (!input.at_end())
+		{
+			const auto tag = input.read<binary_log_format::entry_tag>();
+
+			if (tag == binary_log_format::entry_tag::site)
+			{
+				const auto id = input.read<std::uint32_t>();
+				site& entry   = sites[id];
+
+				entry.level  = static_cast<spdlog::level::level_enum>(input.read<std::uint8_t>());
+				entry.source = static_cast<log_source>(input.read<std::uint8_t>());
+				entry.line   = input.read<std::uint32_t>();
+
+				entry.argument_types.resize(input.read<std::uint8_t>());
+				input.read_bytes(entry.argument_types.data(), entry.argument_types.size());
+
+				entry.file   = input.read_string();
+				entry.format = input.read_string();
+			}
+			else if (tag == binary_log_format::entry_tag::record)
+			{
+				const auto id             = input.read<std::uint32_t>();
+				const auto timestamp_ns   = input.read<std::uint64_t>();
+				const auto argument_bytes = input.read<std::uint32_t>();
+
+				const auto it = sites.find(id);
+				if (it == sites.end())
+				{
+					std::fprintf(stderr, "Record at offset %zu references unknown site %u.\n", input.offset(), id);
+					return 1;
+				}
+
+				const site& entry              = it->second;
+				const std::size_t record_start = input.offset();
+
+				fmt::dynamic_format_arg_store<fmt::format_context> store;
+				for (const auto type: entry.argument_types)
+				{
+					push_argument(store, type, input);
+				}
+
+				if (input.offset() - record_start != argument_bytes)
+				{
+					std::fprintf(stderr, "Record at offset %zu does not match the layout of %s:%u.\n", record_start, entry.file.c_str(), entry.line);
+					return 1;
+				}
+
+				std::string message;
+				try
+				{
+					message = fmt::vformat(entry.format, store);
+				}
+				catch (const fmt::format_error& error)
+				{
+					message = fmt::format("<{}: {}>", error.what(), entry.format);
+				}
+
+				const spdlog::string_view_t level = spdlog::level::to_string_view(entry.level);
+
+				fmt::print(p_output,
+				           "[{}] [{}] {}{}\n",
+				           format_time(header.start_time_ns + static_cast<std::int64_t>(timestamp_ns)),
+				           std::string_view(level.data(), level.size()),
+				           log_source_to_string(entry.source),
+				           message);
+			}
+			else
+			{
+				std::fprintf(stderr, "Unknown entry tag at offset %zu.\n", input.offset() - 1);
+				return 1;
+			}
+		}
+
+		return 0;
+	}
+} // namespace cc::logdecode
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 3)
+	{
+		std::fprintf(stderr, "Usage: capricorn_logdecode <input.cclog> [output.log]\n");
+		return 1;
+	}
+
+	std::ifstream file(argv[1], std::ios::binary);
+	if (!file)
+	{
+		std::fprintf(stderr, "Failed to open %s.\n", argv[1]);
+		return 1;
+	}
+
+	std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	std::FILE* p_output = stdout;
+	if (argc == 3)
+	{
+		p_output = std::fopen(argv[2], "w");
+		if (p_output == nullptr)
+		{
+			std::fprintf(stderr, "Failed to open %s.\n", argv[2]);
+			return 1;
+		}
+	}
+
+	int result = 1;
+
+	try
+	{
+		cc::logdecode::reader input(std::move(data));
+		result = cc::logdecode::decode(input, p_output);
+	}
+	catch (const std::exception& exception)
+	{
+		std::fprintf(stderr, "%s\n", exception.what());
+	}
+
+	if (p_output != stdout)
+	{
+		std::fclose(p_output);
+	}
+
+	return result;
+}